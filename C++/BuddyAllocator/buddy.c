@@ -5,9 +5,18 @@
 #include <assert.h>
 #include <string.h>
 
-#define max(a, b) ((a) > (b) ? (a) : (b))
+/*
+ * Free blocks of every order are kept in a doubly linked list, indexed by
+ * offset, so alloc and free are O(1) plus the splits and merges. The state
+ * of a block lives at its first unit: 0 inside a block, otherwise the order
+ * + 1 with BLOCK_FREE for a free block; the buddy of a block is always a
+ * block start, so a merge only needs to look at it.
+ */
 
-static inline int isPowerOf2(int i) 
+#define BLOCK_FREE 0x80
+#define BLOCK_ORDER_MASK 0x7f
+
+static inline int isPowerOf2(int i)
 {
     return !(i & (i - 1));
 }
@@ -28,29 +37,45 @@ static inline int toCeilPowerOf2(int i)
 
 struct buddy {
 	int level;
-    char freeLevel[1];
+    unsigned nonEmpty; // bit k is set if the list of order k is not empty
+    int heads[32];
+    int *next, *prev;
+    unsigned char *blocks;
 };
 
-static inline int getNodeSize(struct buddy *self, int idx, int freeLevel)
+static inline void pushFree(struct buddy *self, int order, int off)
 {
-    return 1 << (freeLevel - 1);
+    int head = self->heads[order];
+    self->next[off] = head;
+    self->prev[off] = -1;
+    if (head >= 0) self->prev[head] = off;
+    self->heads[order] = off;
+    self->nonEmpty |= 1u << order;
+    self->blocks[off] = BLOCK_FREE | (order + 1);
 }
-static inline int getNodeOffset(struct buddy *self, int idx, int freeLevel)
+static inline void removeFree(struct buddy *self, int order, int off)
 {
-    return (idx - (1 << (self->level + 1 - freeLevel))) * getNodeSize(self, idx, freeLevel);
+    int next = self->next[off], prev = self->prev[off];
+    if (next >= 0) self->prev[next] = prev;
+    if (prev >= 0) self->next[prev] = next;
+    else self->heads[order] = next;
+    if (self->heads[order] < 0) self->nonEmpty &= ~(1u << order);
 }
 
-struct buddy * 
+struct buddy *
 buddy_new(int level) {
+    assert(level >= 0 && level < 31);
     int size = 1 << level;
-    struct buddy *self = malloc(sizeof(struct buddy) + size * 2 - 1);
+    struct buddy *self = malloc(sizeof(struct buddy) + size * (2 * sizeof(int) + 1));
     self->level = level;
+    self->nonEmpty = 0;
+    for (int i = 0; i < 32; ++i) self->heads[i] = -1;
+    self->next = (int*)(self + 1);
+    self->prev = self->next + size;
+    self->blocks = (unsigned char*)(self->prev + size);
+    memset(self->blocks, 0, size);
 
-    int freeLevel = level + 2;
-    for (int i = 1; i < size * 2; ++i) {
-        if (isPowerOf2(i)) --freeLevel;
-        self->freeLevel[i] = freeLevel;
-    }
+    pushFree(self, level, 0);
     return self;
 }
 
@@ -59,72 +84,64 @@ buddy_delete(struct buddy * self) {
     free(self);
 }
 
-int 
+int
 buddy_alloc(struct buddy * self , int s) {
     if (s == 0) s = 1;
-    int freeLevel = toCeilPowerOf2(s) + 1;
-    if (self->freeLevel[1] < freeLevel) return -1;
-    int idx = 1;
-    for (int i = 0; i < (self->level + 1 - freeLevel); ++i) { 
-        idx *= 2;
-        if (self->freeLevel[idx] < freeLevel) ++idx;
-    }
-    self->freeLevel[idx] = 0;
-    int off = getNodeOffset(self, idx, freeLevel);
-    while (idx > 1) {
-        idx /= 2;
-        self->freeLevel[idx] = max(self->freeLevel[2 * idx], self->freeLevel[2 * idx + 1]);
+    if (s > (1 << self->level)) return -1;
+    int order = toCeilPowerOf2(s);
+    unsigned fit = self->nonEmpty >> order;
+    if (fit == 0) return -1;
+
+    int freeOrder = order + __builtin_ctz(fit);
+    int off = self->heads[freeOrder];
+    removeFree(self, freeOrder, off);
+    while (freeOrder > order) {
+        --freeOrder;
+        pushFree(self, freeOrder, off + (1 << freeOrder));
     }
+    self->blocks[off] = order + 1;
     return off;
 }
 void
 buddy_free(struct buddy * self, int offset) {
-    int idx = offset + (1 << self->level);
-    int freeLevel = 1;
-    for (; self->freeLevel[idx]; idx /= 2, ++freeLevel);
-    self->freeLevel[idx] = freeLevel;
-    for (;idx > 1; ++freeLevel) {
-        idx /= 2;
-        int leftFL = self->freeLevel[idx * 2], rightFL = self->freeLevel[idx * 2 + 1];
-        if (leftFL == rightFL && leftFL == freeLevel) {
-            self->freeLevel[idx] = freeLevel + 1;
-        }
-        else self->freeLevel[idx] = max(self->freeLevel[2 * idx], self->freeLevel[2 * idx + 1]);
+    unsigned char block = self->blocks[offset];
+    assert(block != 0 && (block & BLOCK_FREE) == 0);
+    int order = block - 1;
+    self->blocks[offset] = 0;
+
+    for (; order < self->level; ++order) {
+        int buddyOffset = offset ^ (1 << order);
+        if (self->blocks[buddyOffset] != (BLOCK_FREE | (order + 1))) break;
+        removeFree(self, order, buddyOffset);
+        self->blocks[buddyOffset] = 0;
+        offset &= ~(1 << order);
     }
+    pushFree(self, order, offset);
 }
 
 int
 buddy_size(struct buddy * self, int offset) {
-    int size = 1;
-    for (int idx = offset + (1 << self->level); self->freeLevel[idx]; idx /= 2, size *= 2);
-    return size;
+    return 1 << ((self->blocks[offset] & BLOCK_ORDER_MASK) - 1);
 }
 
-static void dump(struct buddy *self, int idx, int freeLevel)
+static void dump(struct buddy *self, int offset, int order)
 {
-    if (self->freeLevel[idx] == freeLevel) {
-        printf("(%d,%d)", getNodeOffset(self, idx, freeLevel), getNodeSize(self, idx, freeLevel));
-    }
-    else if (self->freeLevel[idx] == 0) {
-        if (freeLevel > 1 && self->freeLevel[idx * 2] == 0) {
-            printf("{");
-            dump(self, idx * 2, freeLevel - 1);
-            dump(self, idx * 2 + 1, freeLevel - 1);
-            printf("}");
-        }
-        else printf("[%d,%d]", getNodeOffset(self, idx, freeLevel), getNodeSize(self, idx, freeLevel));
+    unsigned char block = self->blocks[offset];
+    if (block != 0 && (block & BLOCK_ORDER_MASK) == order + 1) {
+        if (block & BLOCK_FREE) printf("(%d,%d)", offset, 1 << order);
+        else printf("[%d,%d]", offset, 1 << order);
     }
-    else if (self->freeLevel[idx] < freeLevel) {
+    else {
+        assert(order > 0);
         printf("{");
-        dump(self, idx * 2, freeLevel - 1);
-        dump(self, idx * 2 + 1, freeLevel - 1);
+        dump(self, offset, order - 1);
+        dump(self, offset + (1 << (order - 1)), order - 1);
         printf("}");
     }
-    else assert(0);
 }
 
 void
 buddy_dump(struct buddy * self) {
-    dump(self, 1, self->level + 1);
+    dump(self, 0, self->level);
     printf("\n");
 }
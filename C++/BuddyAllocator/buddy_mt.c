@@ -0,0 +1,268 @@
+#define _GNU_SOURCE
+#include "buddy_mt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <unistd.h>
+
+/*
+ * Node i of the tree has the children 2i and 2i+1, and a status byte:
+ * BUSY if the node is allocated as a whole, OCC_LEFT/OCC_RIGHT if a block
+ * is allocated under the left/right child, COAL_LEFT/COAL_RIGHT while a
+ * free under that child is clearing the OCC bits of its ancestors.
+ *
+ * An alloc takes a free node with a CAS, then sets the OCC bit of its side
+ * in every ancestor, and gives up (undoing its marks) on a BUSY ancestor.
+ * A free first sets the COAL bits up to the first ancestor whose other side
+ * is occupied, releases the node, then clears OCC and COAL on the way up as
+ * long as its COAL bit is still there: an alloc under the same ancestor
+ * clears it, which stops the free from unmarking a subtree in use again.
+ */
+
+#define OCC_RIGHT 0x1
+#define OCC_LEFT 0x2
+#define COAL_RIGHT 0x4
+#define COAL_LEFT 0x8
+#define BUSY 0x10
+
+#define CACHE_ORDER_COUNT 4
+#define CACHE_CAPACITY 32
+#define CACHE_REFILL 8
+
+#define isLeft(node) (((node) & 1) == 0)
+#define occBit(node) (isLeft(node) ? OCC_LEFT : OCC_RIGHT)
+#define coalBit(node) (isLeft(node) ? COAL_LEFT : COAL_RIGHT)
+#define occBuddyBit(node) (isLeft(node) ? OCC_RIGHT : OCC_LEFT)
+#define coalBuddyBit(node) (isLeft(node) ? COAL_RIGHT : COAL_LEFT)
+
+struct cpu_cache {
+    atomic_flag lock;
+    int counts[CACHE_ORDER_COUNT];
+    int offsets[CACHE_ORDER_COUNT][CACHE_CAPACITY];
+} __attribute__((aligned(64)));
+
+struct buddy_mt {
+    int level;
+    int cacheCount;
+    _Atomic unsigned char *tree;
+    unsigned char *orders; // order of the block allocated at each offset
+    struct cpu_cache *caches;
+};
+
+static inline int toCeilLog2(int i)
+{
+    assert(i > 0);
+    return i == 1 ? 0 : 32 - __builtin_clz(i - 1);
+}
+static inline int getDepth(int node)
+{
+    return 31 - __builtin_clz(node);
+}
+static inline int getOrder(struct buddy_mt *self, int node)
+{
+    return self->level - getDepth(node);
+}
+static inline int getNode(struct buddy_mt *self, int offset, int order)
+{
+    return (1 << (self->level - order)) + (offset >> order);
+}
+static inline int getOffset(struct buddy_mt *self, int node)
+{
+    int depth = getDepth(node);
+    return (node - (1 << depth)) << (self->level - depth);
+}
+
+static void unmark(struct buddy_mt *self, int node, int upperOrder)
+{
+    int current = node, child;
+    unsigned char old, newValue;
+    do {
+        child = current;
+        current >>= 1;
+        old = atomic_load(&self->tree[current]);
+        do {
+            if ((old & coalBit(child)) == 0) return;
+            newValue = old & ~(coalBit(child) | occBit(child));
+        } while (!atomic_compare_exchange_weak(&self->tree[current], &old, newValue));
+    } while (getOrder(self, current) < upperOrder && (newValue & occBuddyBit(child)) == 0);
+}
+// releases node, and the OCC bits of its ancestors up to upperOrder
+static void freeNode(struct buddy_mt *self, int node, int upperOrder)
+{
+    int runner = node, current = node >> 1;
+    while (getOrder(self, runner) < upperOrder) {
+        unsigned char old = atomic_fetch_or(&self->tree[current], coalBit(runner));
+        if ((old & occBuddyBit(runner)) && (old & coalBuddyBit(runner)) == 0) break;
+        runner = current;
+        current >>= 1;
+    }
+    atomic_store(&self->tree[node], 0);
+    if (getOrder(self, node) != upperOrder) unmark(self, node, upperOrder);
+}
+// 0 on success, otherwise the node which made it fail
+static int tryAllocNode(struct buddy_mt *self, int node)
+{
+    unsigned char expected = 0;
+    if (!atomic_compare_exchange_strong(&self->tree[node], &expected, BUSY)) return node;
+
+    int current = node;
+    while (current > 1) {
+        int child = current;
+        current >>= 1;
+        unsigned char old = atomic_load(&self->tree[current]), newValue;
+        do {
+            if (old & BUSY) {
+                freeNode(self, node, getOrder(self, child));
+                return current;
+            }
+            newValue = (old & ~coalBit(child)) | occBit(child);
+        } while (!atomic_compare_exchange_weak(&self->tree[current], &old, newValue));
+    }
+    return 0;
+}
+static int allocNodeInRange(struct buddy_mt *self, int begin, int end, int depth)
+{
+    for (int node = begin; node < end; ) {
+        if (atomic_load_explicit(&self->tree[node], memory_order_relaxed) != 0) {
+            ++node;
+            continue;
+        }
+        int failed = tryAllocNode(self, node);
+        if (failed == 0) return node;
+        // every node under the one which failed is unavailable too
+        node = (failed + 1) << (depth - getDepth(failed));
+    }
+    return 0;
+}
+static int treeAlloc(struct buddy_mt *self, int order, int hint)
+{
+    int depth = self->level - order;
+    int first = 1 << depth, end = first * 2;
+    // threads start at different places to spread the CAS
+    int start = first + (int)(((int64_t)hint << depth) / self->cacheCount);
+    int node = allocNodeInRange(self, start, end, depth);
+    if (node == 0) node = allocNodeInRange(self, first, start, depth);
+    if (node == 0) return -1;
+
+    int offset = getOffset(self, node);
+    self->orders[offset] = (unsigned char)order;
+    return offset;
+}
+static void treeFree(struct buddy_mt *self, int offset)
+{
+    freeNode(self, getNode(self, offset, self->orders[offset]), self->level);
+}
+
+static int getCpu(struct buddy_mt *self)
+{
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    if (cpu >= 0) return cpu % self->cacheCount;
+#endif
+    static _Thread_local int s_cpu = -1;
+    static atomic_int s_nextCpu;
+    if (s_cpu < 0) s_cpu = atomic_fetch_add(&s_nextCpu, 1) % self->cacheCount;
+    return s_cpu;
+}
+
+struct buddy_mt *
+buddy_mt_new(int level) {
+    assert(level >= 0 && level < 30);
+    struct buddy_mt *self = malloc(sizeof(struct buddy_mt));
+    self->level = level;
+    self->tree = calloc((size_t)2 << level, 1);
+    self->orders = calloc((size_t)1 << level, 1);
+
+    long cpuCount = sysconf(_SC_NPROCESSORS_CONF);
+    self->cacheCount = cpuCount > 0 ? (int)cpuCount : 1;
+    self->caches = aligned_alloc(64, sizeof(struct cpu_cache) * self->cacheCount);
+    for (int i = 0; i < self->cacheCount; ++i) {
+        atomic_flag_clear(&self->caches[i].lock);
+        memset(self->caches[i].counts, 0, sizeof(self->caches[i].counts));
+    }
+    return self;
+}
+
+void
+buddy_mt_delete(struct buddy_mt * self) {
+    free(self->caches);
+    free(self->orders);
+    free((void*)self->tree);
+    free(self);
+}
+
+int
+buddy_mt_alloc(struct buddy_mt * self, int s) {
+    if (s <= 0) s = 1;
+    if (s > (1 << self->level)) return -1;
+    int order = toCeilLog2(s);
+    int cpu = getCpu(self);
+
+    if (order < CACHE_ORDER_COUNT) {
+        struct cpu_cache *cache = &self->caches[cpu];
+        // a busy cache means another thread runs on this cpu, go to the tree
+        if (!atomic_flag_test_and_set_explicit(&cache->lock, memory_order_acquire)) {
+            int offset = -1;
+            int *count = &cache->counts[order];
+            if (*count == 0) {
+                for (; *count < CACHE_REFILL; ++*count) {
+                    int refill = treeAlloc(self, order, cpu);
+                    if (refill < 0) break;
+                    cache->offsets[order][*count] = refill;
+                }
+            }
+            if (*count > 0) offset = cache->offsets[order][--*count];
+            atomic_flag_clear_explicit(&cache->lock, memory_order_release);
+            if (offset >= 0) return offset;
+        }
+    }
+
+    int offset = treeAlloc(self, order, cpu);
+    if (offset < 0) {
+        // the caches may hold the buddies needed for a merge
+        buddy_mt_drain(self);
+        offset = treeAlloc(self, order, cpu);
+    }
+    return offset;
+}
+
+void
+buddy_mt_free(struct buddy_mt * self, int offset) {
+    int order = self->orders[offset];
+    if (order < CACHE_ORDER_COUNT) {
+        struct cpu_cache *cache = &self->caches[getCpu(self)];
+        if (!atomic_flag_test_and_set_explicit(&cache->lock, memory_order_acquire)) {
+            int *count = &cache->counts[order];
+            if (*count == CACHE_CAPACITY) {
+                for (; *count > CACHE_CAPACITY / 2; --*count) treeFree(self, cache->offsets[order][*count - 1]);
+            }
+            cache->offsets[order][(*count)++] = offset;
+            atomic_flag_clear_explicit(&cache->lock, memory_order_release);
+            return;
+        }
+    }
+    treeFree(self, offset);
+}
+
+int
+buddy_mt_size(struct buddy_mt * self, int offset) {
+    return 1 << self->orders[offset];
+}
+
+void
+buddy_mt_drain(struct buddy_mt * self) {
+    for (int i = 0; i < self->cacheCount; ++i) {
+        struct cpu_cache *cache = &self->caches[i];
+        while (atomic_flag_test_and_set_explicit(&cache->lock, memory_order_acquire)) sched_yield();
+        for (int order = 0; order < CACHE_ORDER_COUNT; ++order) {
+            for (; cache->counts[order] > 0; --cache->counts[order]) {
+                treeFree(self, cache->offsets[order][cache->counts[order] - 1]);
+            }
+        }
+        atomic_flag_clear_explicit(&cache->lock, memory_order_release);
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef BUDDY_MEMORY_ALLOCATION_MT_H
+#define BUDDY_MEMORY_ALLOCATION_MT_H
+
+/*
+ * Thread safe buddy allocator of offsets: the tree is updated with CAS only
+ * (non-blocking buddy system), and every CPU caches some free blocks of the
+ * smallest orders.
+ */
+
+struct buddy_mt;
+
+struct buddy_mt * buddy_mt_new(int level);
+void buddy_mt_delete(struct buddy_mt *);
+int buddy_mt_alloc(struct buddy_mt *, int size);
+void buddy_mt_free(struct buddy_mt *, int offset);
+int buddy_mt_size(struct buddy_mt *, int offset);
+// gives the blocks of the CPU caches back to the tree
+void buddy_mt_drain(struct buddy_mt *);
+
+#endif
@@ -1,14 +1,163 @@
 #include "buddy.h"
+#include "buddy_mt.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
 
-int main()
+#define BENCH_LEVEL 20
+#define BENCH_WINDOW 256
+
+struct bench {
+    struct buddy *buddy; // the single threaded one behind a mutex, or NULL
+    pthread_mutex_t lock;
+    struct buddy_mt *buddyMT;
+    atomic_uchar *owners; // with check, the thread holding every unit
+    int opCount;
+    atomic_int failCount;
+};
+struct bench_thread {
+    struct bench *bench;
+    int id;
+    pthread_t thread;
+};
+
+static int benchAlloc(struct bench *b, int size)
+{
+    if (b->buddyMT) return buddy_mt_alloc(b->buddyMT, size);
+    pthread_mutex_lock(&b->lock);
+    int offset = buddy_alloc(b->buddy, size);
+    pthread_mutex_unlock(&b->lock);
+    return offset;
+}
+static void benchFree(struct bench *b, int offset)
+{
+    if (b->buddyMT) {
+        buddy_mt_free(b->buddyMT, offset);
+        return;
+    }
+    pthread_mutex_lock(&b->lock);
+    buddy_free(b->buddy, offset);
+    pthread_mutex_unlock(&b->lock);
+}
+static void checkOwners(struct bench *b, int offset, int size, unsigned char from, unsigned char to)
+{
+    if (!b->owners) return;
+    for (int i = 0; i < size; ++i) {
+        if (atomic_exchange(&b->owners[offset + i], to) != from) {
+            printf("unit %d of block (%d,%d) is shared\n", offset + i, offset, size);
+            exit(1);
+        }
+    }
+}
+// mostly small blocks, like the objects carved from a shared region
+static int randomSize(unsigned *seed)
+{
+    int r = rand_r(seed) % 100;
+    if (r < 80) return rand_r(seed) % 8 + 1;
+    if (r < 95) return rand_r(seed) % 248 + 9;
+    return rand_r(seed) % 3840 + 257;
+}
+static void* benchThread(void *arg)
+{
+    struct bench_thread *t = arg;
+    struct bench *b = t->bench;
+    unsigned seed = t->id * 7919 + 1;
+    int offsets[BENCH_WINDOW], sizes[BENCH_WINDOW];
+    for (int i = 0; i < BENCH_WINDOW; ++i) offsets[i] = -1;
+
+    for (int op = 0; op < b->opCount; ++op) {
+        int i = rand_r(&seed) % BENCH_WINDOW;
+        if (offsets[i] >= 0) {
+            checkOwners(b, offsets[i], sizes[i], t->id + 1, 0);
+            benchFree(b, offsets[i]);
+            offsets[i] = -1;
+        } else {
+            sizes[i] = randomSize(&seed);
+            if ((offsets[i] = benchAlloc(b, sizes[i])) < 0) {
+                atomic_fetch_add(&b->failCount, 1);
+                continue;
+            }
+            checkOwners(b, offsets[i], sizes[i], 0, t->id + 1);
+        }
+    }
+    for (int i = 0; i < BENCH_WINDOW; ++i) {
+        if (offsets[i] < 0) continue;
+        checkOwners(b, offsets[i], sizes[i], t->id + 1, 0);
+        benchFree(b, offsets[i]);
+    }
+    return NULL;
+}
+static double runBench(struct bench *b, int threadCount)
+{
+    struct bench_thread threads[64];
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int i = 0; i < threadCount; ++i) {
+        threads[i].bench = b;
+        threads[i].id = i;
+        pthread_create(&threads[i].thread, NULL, benchThread, &threads[i]);
+    }
+    for (int i = 0; i < threadCount; ++i) pthread_join(threads[i].thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+}
+// multi-threaded alloc/free stress of the locked and the concurrent buddy, every run must give back the whole region
+static void bench(int maxThreadCount, int opCount, int check)
+{
+    printf("%d ops per thread over %d units%s\n", opCount, 1 << BENCH_LEVEL, check ? ", checking overlaps" : "");
+    for (int threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2) {
+        for (int concurrent = 0; concurrent < 2; ++concurrent) {
+            struct bench b;
+            memset(&b, 0, sizeof(b));
+            b.opCount = opCount;
+            if (concurrent) b.buddyMT = buddy_mt_new(BENCH_LEVEL);
+            else {
+                b.buddy = buddy_new(BENCH_LEVEL);
+                pthread_mutex_init(&b.lock, NULL);
+            }
+            if (check) b.owners = calloc(1 << BENCH_LEVEL, 1);
+
+            double seconds = runBench(&b, threadCount);
+
+            int whole;
+            if (concurrent) {
+                buddy_mt_drain(b.buddyMT);
+                whole = buddy_mt_alloc(b.buddyMT, 1 << BENCH_LEVEL);
+                buddy_mt_delete(b.buddyMT);
+            } else {
+                whole = buddy_alloc(b.buddy, 1 << BENCH_LEVEL);
+                buddy_delete(b.buddy);
+                pthread_mutex_destroy(&b.lock);
+            }
+            free(b.owners);
+
+            printf("%d threads, %-14s: %.3fs, %.0f Kops/s, %d failed allocs%s\n", threadCount,
+                concurrent ? "buddy_mt" : "buddy + mutex", seconds, threadCount * (double)opCount / seconds / 1e3,
+                atomic_load(&b.failCount), whole == 0 ? "" : ", LEAKED");
+            if (whole != 0) exit(1);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
 {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int threadCount = argc > 2 ? atoi(argv[2]) : 4;
+        int opCount = argc > 3 ? atoi(argv[3]) : 1000000;
+        int check = argc > 4 && strcmp(argv[4], "check") == 0;
+        if (threadCount < 1 || threadCount > 64) threadCount = 4;
+        bench(threadCount, opCount, check);
+        return 0;
+    }
+
     struct buddy *mem = buddy_new(10);
     char cmd[32] = "";
     int arg0 = 0;
-    while (scanf("%s %d", cmd, &arg0)) {
+    while (scanf("%31s %d", cmd, &arg0) == 2) {
         printf("command : %s %d\n", cmd, arg0);
         if (strcmp(cmd, "alloc") == 0) {
             printf("-> %d\n", buddy_alloc(mem, arg0));
@@ -2,8 +2,13 @@
 
 #include <stdarg.h>
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <sys/time.h>
 #include <sys/mman.h>
 
@@ -23,6 +28,8 @@ static double getTime() {
     return tv.tv_sec + double(tv.tv_usec) / 1000000;
 }
 
+static const int DIRECT_ALIGN = 4096;
+
 #define timeit(cmds) { double start = getTime(); cmds; printf("timeit line=%d : %.3f\n", __LINE__, getTime() - start); }
 //////////////////////////////
 struct IFile {
@@ -42,10 +49,10 @@ struct IFile {
 
 class OSFile: public IFile {
 public:
-    OSFile(const char *path, const char *mode): mFd(-1) { 
+    OSFile(const char *path, const char *mode): mFd(-1), mDirect(false) { 
         open(path, mode);
     }
-    OSFile(int fd): mFd(fd) {
+    OSFile(int fd): mFd(fd), mDirect(false) {
     }
     ~OSFile() { 
         close();
@@ -65,17 +72,33 @@ public:
                 case 'w': flag |= O_WRONLY | O_CREAT; break;
                 case 'a': flag = (flag | O_APPEND) & ~O_CREAT; break;
                 case '+': flag |= O_RDWR; break;
+                // bypasses the page cache: buffers, lengths and offsets aligned to DIRECT_ALIGN
+                case 'd': flag |= O_DIRECT; break;
                 default: break;
             }
         }
         mFd = ::open(path, flag, S_IRUSR | S_IWUSR);
+        mDirect = (flag & O_DIRECT) != 0;
         return mFd;
     }
     virtual int read(void *buf, int len) {
-        return ::read(mFd, buf, len);
+        int n = ::read(mFd, buf, len);
+        if (n < 0 && errno == EINVAL && mDirect) {
+            setDirect(false);
+            n = ::read(mFd, buf, len);
+            setDirect(true);
+        }
+        return n;
     }
     virtual int write(const void *buf, int len) {
-        return ::write(mFd, buf, len);
+        int n = ::write(mFd, buf, len);
+        // the unaligned tail of a file
+        if (n < 0 && errno == EINVAL && mDirect) {
+            setDirect(false);
+            n = ::write(mFd, buf, len);
+            setDirect(true);
+        }
+        return n;
     }
     virtual int tell() {
         return seek(A_Cur, 0);
@@ -96,11 +119,17 @@ public:
             mFd = -1;
         }
     }
+private:
+    void setDirect(bool direct) {
+        int flag = fcntl(mFd, F_GETFL);
+        fcntl(mFd, F_SETFL, direct ? flag | O_DIRECT : flag & ~O_DIRECT);
+    }
 private:
     OSFile(const OSFile&);
     OSFile& operator = (const OSFile&);
 private:
     int mFd;
+    bool mDirect;
 };
 
 class BufferedFile: public IFile {
@@ -197,11 +226,249 @@ private:
     bool mIsInputBuf;
 };
 
+// Reads ahead or writes behind in a background thread, through a ring of buffers: the caller works on one buffer while
+// the thread does the I/O of the others. The block size doubles, up to maxBufLen, whenever the caller has to wait for
+// the thread. The buffers are aligned for the files opened with O_DIRECT ('d' mode of OSFile).
+class AsyncBufferedFile: public IFile {
+public:
+    AsyncBufferedFile(IFile *file, bool isInputBuf = true, int bufCount = 4, int minBufLen = 64 * 1024, int maxBufLen = 1024 * 1024):
+        mFile(file), mBufs(bufCount), mBlockLen(minBufLen), mMaxBufLen(maxBufLen), mIsInputBuf(isInputBuf), mStallCount(0) {
+        assert(bufCount >= 2 && minBufLen % DIRECT_ALIGN == 0 && minBufLen <= maxBufLen);
+        for (Buffer &b : mBufs) {
+            void *p = nullptr;
+            if (posix_memalign(&p, DIRECT_ALIGN, mMaxBufLen) != 0) perror("AsyncBufferedFile, alloc failed:");
+            b.data = (char*)p;
+            b.len = 0;
+        }
+        start();
+    }
+    ~AsyncBufferedFile() {
+        close();
+        for (Buffer &b : mBufs) ::free(b.data);
+        delete mFile;
+    }
+    virtual int open(const char *path, const char *mode) {
+        close();
+        int r = mFile->open(path, mode);
+        start();
+        return r;
+    }
+    virtual void close() {
+        if (!mThread.joinable()) return;
+        if (!mIsInputBuf) flush();
+        {
+            lock_guard<mutex> lock(mMutex);
+            mStop = true;
+        }
+        mCond.notify_all();
+        mThread.join();
+        mFile->close();
+    }
+    virtual int tell() {
+        return mPos;
+    }
+    virtual int seek(Anchor a, int off) {
+        if (!mIsInputBuf) {
+            flush();
+            return mPos = mFile->seek(a, off);
+        }
+
+        unique_lock<mutex> lock(mMutex);
+        mPaused = true;
+        mCond.wait(lock, [this]() { return !mIoBusy; });
+        // the file is ahead of the caller
+        mPos = a == A_Cur ? mFile->seek(A_Begin, mPos + off) : mFile->seek(a, off);
+        mConsumed = mProduced;
+        mCur = nullptr;
+        mCurLen = 0;
+        mEof = mPaused = false;
+        mCond.notify_all();
+        return mPos;
+    }
+    virtual int write(const void *buf, int len) {
+        assert(!mIsInputBuf);
+
+        const char *_buf = (const char*)buf;
+        int leftLen = len;
+
+        while (leftLen > 0) {
+            if (mCur == nullptr) nextOutputBuffer();
+
+            int n = min(leftLen, mCurCapacity - mCur->len);
+            memcpy(mCur->data + mCur->len, _buf, n);
+            _buf += n;
+            leftLen -= n;
+            mCur->len += n;
+            if (mCur->len == mCurCapacity) submitOutputBuffer();
+        }
+
+        mPos += len;
+        return len;
+    }
+    virtual int read(void *buf, int len) {
+        assert(mIsInputBuf);
+
+        char *_buf = (char*)buf;
+        int leftLen = len;
+
+        while (leftLen > 0) {
+            if (mCurLen == 0 && !nextInputBuffer()) break;
+
+            int n = min(mCurLen, leftLen);
+            memcpy(_buf, mCurData, n);
+            _buf += n;
+            leftLen -= n;
+            mCurData += n;
+            mCurLen -= n;
+        }
+
+        mPos += len - leftLen;
+        return len - leftLen;
+    }
+    // waits until every written byte is in the file
+    void flush() {
+        assert(!mIsInputBuf);
+
+        if (mCur != nullptr && mCur->len > 0) submitOutputBuffer();
+        unique_lock<mutex> lock(mMutex);
+        mCond.wait(lock, [this]() { return mConsumed == mProduced; });
+    }
+    int getBlockLen() const { return mBlockLen; }
+    int getStallCount() const { return mStallCount; }
+private:
+    AsyncBufferedFile(const AsyncBufferedFile&);
+    AsyncBufferedFile& operator = (const AsyncBufferedFile&);
+private:
+    struct Buffer {
+        char *data;
+        int len; // 0 for the end of an input file
+    };
+
+    void start() {
+        mProduced = mConsumed = 0;
+        mCur = nullptr;
+        mCurData = nullptr;
+        mCurLen = 0;
+        mPos = max(mFile->tell(), 0);
+        mStop = mPaused = mIoBusy = mEof = false;
+        mThread = thread([this]() {
+            if (mIsInputBuf) readAhead();
+            else writeBehind();
+        });
+    }
+    void onStall() {
+        ++mStallCount;
+        // the buffers hold mMaxBufLen bytes, which needn't be a power of two times the first block
+        mBlockLen = min(mBlockLen * 2, mMaxBufLen) / DIRECT_ALIGN * DIRECT_ALIGN;
+    }
+    // buffers [mConsumed, mProduced) are ready for the consumer, the producer may fill mProduced while it is less
+    // than mConsumed + bufCount
+    bool nextInputBuffer() {
+        unique_lock<mutex> lock(mMutex);
+        if (mCur != nullptr) {
+            mCur = nullptr;
+            ++mConsumed;
+            mCond.notify_all();
+        }
+        if (mConsumed == mProduced) {
+            onStall();
+            mCond.wait(lock, [this]() { return mConsumed < mProduced; });
+        }
+
+        Buffer &b = mBufs[mConsumed % mBufs.size()];
+        // the end stays in the ring, for the next reads
+        if (b.len == 0) return false;
+        mCur = &b;
+        mCurData = b.data;
+        mCurLen = b.len;
+        return true;
+    }
+    void nextOutputBuffer() {
+        unique_lock<mutex> lock(mMutex);
+        if (mProduced - mConsumed == (long)mBufs.size()) {
+            onStall();
+            mCond.wait(lock, [this]() { return mProduced - mConsumed < (long)mBufs.size(); });
+        }
+        mCur = &mBufs[mProduced % mBufs.size()];
+        mCur->len = 0;
+        mCurCapacity = mBlockLen;
+    }
+    void submitOutputBuffer() {
+        {
+            lock_guard<mutex> lock(mMutex);
+            mCur = nullptr;
+            ++mProduced;
+        }
+        mCond.notify_all();
+    }
+    void readAhead() {
+        unique_lock<mutex> lock(mMutex);
+        for (;;) {
+            mCond.wait(lock, [this]() {
+                return mStop || (!mPaused && !mEof && mProduced - mConsumed < (long)mBufs.size());
+            });
+            if (mStop) break;
+
+            Buffer &b = mBufs[mProduced % mBufs.size()];
+            int len = mBlockLen;
+            mIoBusy = true;
+            lock.unlock();
+            int n = mFile->read(b.data, len);
+            lock.lock();
+            mIoBusy = false;
+
+            b.len = max(n, 0);
+            mEof = b.len == 0;
+            ++mProduced;
+            mCond.notify_all();
+        }
+    }
+    void writeBehind() {
+        unique_lock<mutex> lock(mMutex);
+        for (;;) {
+            mCond.wait(lock, [this]() { return mStop || mConsumed < mProduced; });
+            if (mConsumed == mProduced) break;
+
+            Buffer &b = mBufs[mConsumed % mBufs.size()];
+            lock.unlock();
+            for (char *p = b.data, *end = b.data + b.len; p < end; ) {
+                int n = mFile->write(p, int(end - p));
+                if (n <= 0) {
+                    perror("AsyncBufferedFile, write failed:");
+                    break;
+                }
+                p += n;
+            }
+            lock.lock();
+
+            ++mConsumed;
+            mCond.notify_all();
+        }
+    }
+private:
+    IFile *mFile;
+    vector<Buffer> mBufs;
+    long mProduced, mConsumed;
+    int mBlockLen, mMaxBufLen;
+    // the buffer of the caller
+    Buffer *mCur;
+    char *mCurData;
+    int mCurLen, mCurCapacity;
+    int mPos;
+    bool mIsInputBuf;
+    bool mStop, mPaused, mIoBusy, mEof;
+    int mStallCount;
+    mutex mMutex;
+    condition_variable mCond;
+    thread mThread;
+};
+
 //////////////////////////////
-static int createEmptyFile(const char *path, int pageCount) {
-    return ::system(format("dd if=/dev/zero of=%s bs=4K count=%d", path, pageCount));
+// random bytes, so a copy which drops or reorders blocks doesn't pass checkSameFile
+static int createRandomFile(const char *path, int pageCount) {
+    return ::system(format("dd if=/dev/urandom of=%s bs=4K count=%d", path, pageCount));
 }
-static int rmEmptyFile(const char *path) {
+static int rmFile(const char *path) {
     return ::system(format("rm %s", path));
 }
 static void checkSameFile(const char *path1, const char *path2) {
@@ -219,6 +486,15 @@ static void checkSameFile(const char *path1, const char *path2) {
     fclose(f2);
 }
 
+// evicts the pages of path from the page cache, so the next read goes to the disk
+static void dropFileCache(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd == -1) return;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
 static void copyFile_mmap(int fdi, int fdo, int bufLen) {
     if (fdi == -1 || fdo == -1) perror("copyFile_mmap, invalid file:");
 
@@ -262,6 +538,27 @@ static void copyFile_ANSICfread(FILE *fi, FILE *fo, vector<char>& buf) {
     }
 }
 
+// a busy consumer, a few cycles per byte
+static unsigned consumeData(const char *buf, int len) {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; ++i) h = (h ^ (unsigned char)buf[i]) * 16777619u;
+    return h;
+}
+static unsigned readFile_IFile(IFile *fi, vector<char>& buf) {
+    unsigned h = 0;
+    while (int n = fi->read(&buf[0], (int)buf.size())) {
+        h += consumeData(&buf[0], n);
+    }
+    return h;
+}
+static unsigned readFile_ANSICfread(FILE *fi, vector<char>& buf) {
+    unsigned h = 0;
+    while (int n = fread(&buf[0], 1, buf.size(), fi)) {
+        h += consumeData(&buf[0], n);
+    }
+    return h;
+}
+
 int main(int argc, char* argv[]) {
     int pageCount = argc > 1 ? atoi(argv[1]) : 1234;
 
@@ -270,7 +567,7 @@ int main(int argc, char* argv[]) {
     const int MAX_BUF_LEN = 1 << 14;
 
     {
-        createEmptyFile("1.txt", pageCount);
+        createRandomFile("1.txt", pageCount);
         FILE *fi = fopen("1.txt", "rb");
         FILE *fo = fopen("2.txt", "wb");
         puts("copyFile_ANSICfgetc:");
@@ -284,14 +581,14 @@ int main(int argc, char* argv[]) {
         fclose(fi);
         fclose(fo);
         checkSameFile("1.txt", "2.txt");
-        rmEmptyFile("1.txt");
-        rmEmptyFile("2.txt");
+        rmFile("1.txt");
+        rmFile("2.txt");
     }
     puts("finish!\n\n");
 
     for (int i = 0; i < 4; ++i)
     {
-        createEmptyFile("1.txt", pageCount);
+        createRandomFile("1.txt", pageCount);
         int fdi = ::open("1.txt", O_RDONLY);
         int fdo = ::open("2.txt", O_RDWR | O_CREAT, S_IRUSR |S_IWUSR);
         const int BUFF_LENS[] = {1 << 12, 1 << 13, 1 << 20, 1 << 21};
@@ -307,14 +604,14 @@ int main(int argc, char* argv[]) {
         ::close(fdi);
         ::close(fdo);
         checkSameFile("1.txt", "2.txt");
-        rmEmptyFile("1.txt");
-        rmEmptyFile("2.txt");
+        rmFile("1.txt");
+        rmFile("2.txt");
     }
     puts("finish!\n\n");
 
     for (int i = MIN_BUF_LEN; i <= MAX_BUF_LEN; i <<= 1)
     {
-        createEmptyFile("1.txt", pageCount);
+        createRandomFile("1.txt", pageCount);
         FILE *fi = fopen("1.txt", "rb");
         FILE *fo = fopen("2.txt", "wb");
         vector<char> buf(i);
@@ -329,14 +626,14 @@ int main(int argc, char* argv[]) {
         fclose(fi);
         fclose(fo);
         checkSameFile("1.txt", "2.txt");
-        rmEmptyFile("1.txt");
-        rmEmptyFile("2.txt");
+        rmFile("1.txt");
+        rmFile("2.txt");
     }
     puts("finish!\n\n");
 
     for (int i = MIN_BUF_LEN; i <= MAX_BUF_LEN; i <<= 1)
     {
-        createEmptyFile("1.txt", pageCount);
+        createRandomFile("1.txt", pageCount);
         {
             OSFile fi("1.txt", "r"), fo("2.txt", "w");
             vector<char> buf(i);
@@ -350,14 +647,14 @@ int main(int argc, char* argv[]) {
                   );
         }
         checkSameFile("1.txt", "2.txt");
-        rmEmptyFile("1.txt");
-        rmEmptyFile("2.txt");
+        rmFile("1.txt");
+        rmFile("2.txt");
     }
     puts("finish!\n\n");
 
     for (int i = MIN_BUF_LEN; i <= MAX_BUF_LEN; i <<= 1)
     {
-        createEmptyFile("1.txt", pageCount);
+        createRandomFile("1.txt", pageCount);
         {
             BufferedFile fi(new OSFile("1.txt", "r"));
             BufferedFile fo(new OSFile("2.txt", "w"), false);
@@ -373,8 +670,90 @@ int main(int argc, char* argv[]) {
                   );
         }
         checkSameFile("1.txt", "2.txt");
-        rmEmptyFile("1.txt");
-        rmEmptyFile("2.txt");
+        rmFile("1.txt");
+        rmFile("2.txt");
+    }
+    puts("finish!\n\n");
+
+    for (int direct = 0; direct < 2; ++direct)
+    for (int i = MIN_BUF_LEN; i <= MAX_BUF_LEN; i <<= 4)
+    {
+        createRandomFile("1.txt", pageCount);
+        {
+            AsyncBufferedFile fi(new OSFile("1.txt", direct ? "rd" : "r"));
+            // the largest block isn't a power of two times the first one
+            AsyncBufferedFile fo(new OSFile("2.txt", direct ? "wd" : "w"), false, 4, 64 * 1024, 3 * 64 * 1024);
+            vector<char> buf(i);
+            printf("copyFile_AsyncBufferedFile%s :%.3fK\n", direct ? "(O_DIRECT)" : "", float(buf.size()) / 1024);
+            timeit(
+                    for (int i = 0; i < COPY_TIME; ++i) {
+                    fi.seek(IFile::A_Begin, 0);
+                    fo.seek(IFile::A_Begin, 0);
+                    copyFile_IFile(&fi, &fo, buf);
+                    fo.flush();
+                    }
+                  );
+        }
+        checkSameFile("1.txt", "2.txt");
+        rmFile("1.txt");
+        rmFile("2.txt");
+    }
+    puts("finish!\n\n");
+
+    // reading from the disk while the consumer is busy: at best, the slower of the two alone
+    {
+        createRandomFile("1.txt", pageCount);
+        vector<char> buf(64 * 1024);
+        double mb = pageCount * 4096.0 / 1024 / 1024;
+        auto report = [mb](const char *name, double seconds) {
+            printf("readFile_busy_%s: %.3fs, %.3fMB/s\n", name, seconds, mb / seconds);
+        };
+        unsigned h = 0;
+        double start = getTime();
+        for (int i = 0; i < pageCount; i += (int)buf.size() / 4096) h += consumeData(&buf[0], (int)buf.size());
+        report("consumer_only", getTime() - start);
+        {
+            dropFileCache("1.txt");
+            OSFile fi("1.txt", "rd");
+            char *p = nullptr;
+            if (posix_memalign((void**)&p, DIRECT_ALIGN, 1 << 20) != 0) perror("posix_memalign failed:");
+            start = getTime();
+            while (fi.read(p, 1 << 20) > 0);
+            report("disk_only", getTime() - start);
+            ::free(p);
+        }
+        {
+            dropFileCache("1.txt");
+            FILE *fi = fopen("1.txt", "rb");
+            start = getTime();
+            h += readFile_ANSICfread(fi, buf);
+            report("ANSICfread", getTime() - start);
+            fclose(fi);
+        }
+        {
+            dropFileCache("1.txt");
+            OSFile fi("1.txt", "r");
+            start = getTime();
+            h += readFile_IFile(&fi, buf);
+            report("OSFile", getTime() - start);
+        }
+        {
+            dropFileCache("1.txt");
+            BufferedFile fi(new OSFile("1.txt", "r"));
+            start = getTime();
+            h += readFile_IFile(&fi, buf);
+            report("BufferedFile", getTime() - start);
+        }
+        for (int direct = 0; direct < 2; ++direct) {
+            dropFileCache("1.txt");
+            AsyncBufferedFile fi(new OSFile("1.txt", direct ? "rd" : "r"));
+            start = getTime();
+            h += readFile_IFile(&fi, buf);
+            report(direct ? "AsyncBufferedFile(O_DIRECT)" : "AsyncBufferedFile", getTime() - start);
+            printf("\tblock=%.3fK, stalls=%d\n", fi.getBlockLen() / 1024.0, fi.getStallCount());
+        }
+        printf("hash=%u\n", h);
+        rmFile("1.txt");
     }
     puts("finish!\n\n");
 }
@@ -2,6 +2,10 @@
 
 #include <chrono>
 #include <fstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <climits>
 
 #include <unistd.h>
 //////////////////////////////
@@ -14,13 +18,18 @@ private:
         char data[1];
     };
 public:
-    StackMemPool(int chunkAlign): mChunks(nullptr), mData(nullptr), mDataEnd(nullptr), mChunkAlign(chunkAlign) {
+    StackMemPool(int chunkAlign): mChunks(nullptr), mData(nullptr), mDataEnd(nullptr), mChunkAlign(chunkAlign), mUsedSize(0) {
     }
     ~StackMemPool() {
+        clear();
+    }
+    void clear() {
         for (Chunk *next; mChunks != nullptr; mChunks = next) {
             next = mChunks->next;
             ::free(mChunks);
         }
+        mData = mDataEnd = nullptr;
+        mUsedSize = 0;
     }
     void* alloc(int size, int align) {
         assert(((align - 1) & align) == 0);
@@ -34,6 +43,7 @@ public:
         p += (align - ((long)p & (align - 1))) & (align - 1);
         assert((long)p % align == 0);
         assert(p + size - mData <= safeSize);
+        mUsedSize += p + size - mData;
         mData = p + size;
         return p;
     }
@@ -42,7 +52,10 @@ public:
         std::swap(mData, o.mData);
         std::swap(mDataEnd, o.mDataEnd);
         std::swap(mChunkAlign, o.mChunkAlign);
+        std::swap(mUsedSize, o.mUsedSize);
     }
+    // bytes handed out, the garbage of destroyed objects included
+    size_t getUsedSize() const { return mUsedSize; }
 private:
     void allocChunk(int size) {
         int memSize = ((sizeof(Chunk) - 1 + size) + mChunkAlign - 1) / mChunkAlign * mChunkAlign;
@@ -56,6 +69,7 @@ private:
     Chunk *mChunks;
     char *mData, *mDataEnd;
     int mChunkAlign;
+    size_t mUsedSize;
 };
 
 template<int N>
@@ -109,48 +123,122 @@ private:
 };
 
 
+// What a handle points to: the address of the object, and its pin count with the MOVING bit while the compaction
+// copies it.
+struct HandleNode {
+    static const unsigned MOVING = 1u << 31;
+
+    atomic<void*> p;
+    atomic<unsigned> state;
+    HandleNode(void *_p): p(_p), state(0) {}
+
+    void* pin() {
+        for (unsigned s = state.load(memory_order_relaxed); ; ) {
+            if (s & MOVING) {
+                this_thread::yield();
+                s = state.load(memory_order_relaxed);
+            } else if (state.compare_exchange_weak(s, s + 1, memory_order_acquire, memory_order_relaxed)) {
+                return p.load(memory_order_relaxed);
+            }
+        }
+    }
+    void unpin() {
+        state.fetch_sub(1, memory_order_release);
+    }
+    // fails if pinned
+    bool beginMove() {
+        unsigned expected = 0;
+        return state.compare_exchange_strong(expected, MOVING, memory_order_acquire, memory_order_relaxed);
+    }
+    void endMove(void *newP) {
+        p.store(newP, memory_order_release);
+        state.store(0, memory_order_release);
+    }
+};
+
+// The object may move and its old copy be freed any time the compaction thread runs, so it is only reached through a
+// Pin, which holds it in place; operator * copies it out under a pin as short as the copy.
 template<typename T>
 class Handle {
 public:
+    class Pin {
+    public:
+        explicit Pin(const Handle &h): mNode(h.mNode), mP((T*)h.mNode->pin()) {}
+        ~Pin() { mNode->unpin(); }
+        operator T*() const { return mP; }
+        T& operator * () const { return *mP; }
+        T* operator -> () const { return mP; }
+
+        Pin(const Pin&) = delete;
+        Pin& operator = (const Pin&) = delete;
+    private:
+        HandleNode *mNode;
+        T *mP;
+    };
+
     Handle(): mNode(nullptr){}
-    operator T*() { return *mNode; }
-    operator const T*() const { return *mNode; }
+    T operator * () const { return *Pin(*this); }
 private:
     friend class HandleManager;
-    explicit Handle(T **node): mNode(node){}
+    explicit Handle(HandleNode *node): mNode(node){}
 private:
-    T **mNode;
+    HandleNode *mNode;
 };
 
+struct CompactionStats {
+    int cycles, steps;
+    size_t movedBytes;
+    double totalPause, maxPause; // seconds spent in steps, mutators are blocked for at most one
+};
+
+// compact() moves the live objects to a new pool in the list order. compactStep() does the same incrementally, moving
+// at most maxBytes per call, and the compaction thread calls it in the background when the fragmentation gets high.
 class HandleManager {
 private:
-    struct Node {
-        void *p;
+    struct Node: public HandleNode {
         Node *prev, *next;
-        int size : 28;
-        int align : 4;
-        Node(void *_p, int _size, int _align, Node *_prev, Node *_next): p(_p), prev(_prev), next(_next), size(_size), align(_align) {}
+        int size;
+        short align;
+        unsigned char space; // which pool holds p while compacting
+        Node(void *_p, int _size, int _align, int _space, Node *_prev, Node *_next):
+            HandleNode(_p), prev(_prev), next(_next), size(_size), align(_align), space(_space) {}
     };
 public:
     template<typename T, typename ...ArgsT>
     Handle<T> create(ArgsT&& ...args) {
+        lock_guard<mutex> lock(mMutex);
         int size = sizeof(T), align = alignof(T);
-        void *p = size >= LARGE_OBJ_SIZE ? ::malloc(size) : mStackPool.alloc(size, align);
+        void *p;
+        if (size >= LARGE_OBJ_SIZE) p = ::malloc(size);
+        else {
+            p = (mCursor != nullptr ? mToPool : mStackPool).alloc(size, align);
+            mLiveSize += size;
+            ++mSmallCount;
+        }
         new (p) T(forward<ArgsT>(args)...);
         Node *n = createNode(p, size, align);
-        return Handle<T>((T**)n);
+        return Handle<T>(n);
     }
     template<typename T>
     void destroy(Handle<T> h) {
+        lock_guard<mutex> lock(mMutex);
         Node *n = (Node*)h.mNode;
-        ((T*)h)->~T();
+        // the compaction takes the lock to move it
+        ((T*)n->p.load(memory_order_relaxed))->~T();
         if (n->size >= LARGE_OBJ_SIZE) ::free(n->p);
+        else {
+            mLiveSize -= n->size;
+            --mSmallCount;
+            if (mCursor != nullptr && n->space != mToSpace) --mUnmovedCount;
+        }
         destroyNode(n);
     }
     template<typename T>
     void setRelative(const Handle<T> &a, const Handle<T> &b) {
+        lock_guard<mutex> lock(mMutex);
         Node *an = (Node*)a.mNode;
         Node *bn = (Node*)b.mNode;
+        if (bn == mCursor) mCursor = bn->next;
         bn->next->prev = bn->prev;
         bn->prev->next = bn->next;
         bn->next = an->next;
@@ -159,39 +247,122 @@ public:
         an->next = bn;
     }
     void compact() {
-        StackMemPool newPool(STACK_POOL_CHUNK_ALIGN);
-        for (Node *n = mHead.next; n != &mHead; n = n->next) {
-            if (n->size >= LARGE_OBJ_SIZE) continue;
-            void *p = newPool.alloc(n->size, n->align);
-            memcpy(p, n->p, n->size);
-            n->p = p;
-        }
-        mStackPool.swap(newPool);
+        while (!compactStep(INT_MAX)) this_thread::yield();
+    }
+    // true when a whole cycle is done
+    bool compactStep(int maxBytes) {
+        lock_guard<mutex> lock(mMutex);
+        auto start = chrono::high_resolution_clock::now();
+        bool done = doCompactStep(maxBytes);
+        double pause = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+        ++mStats.steps;
+        mStats.totalPause += pause;
+        mStats.maxPause = max(mStats.maxPause, pause);
+        return done;
+    }
+    void startCompactionThread(int stepBytes, double maxFragmentation, int intervalUs) {
+        assert(!mCompactionThread.joinable());
+        mStopCompaction = false;
+        mCompactionThread = thread([this, stepBytes, maxFragmentation, intervalUs]() {
+            while (!mStopCompaction.load()) {
+                bool compacting;
+                {
+                    lock_guard<mutex> lock(mMutex);
+                    compacting = mCursor != nullptr || getFragmentationLocked() > maxFragmentation;
+                }
+                if (compacting) compactStep(stepBytes);
+                this_thread::sleep_for(chrono::microseconds(intervalUs));
+            }
+        });
+    }
+    void stopCompactionThread() {
+        if (!mCompactionThread.joinable()) return;
+        mStopCompaction = true;
+        mCompactionThread.join();
+    }
+    // pool bytes per live byte, large objects excluded
+    double getFragmentation() {
+        lock_guard<mutex> lock(mMutex);
+        return getFragmentationLocked();
+    }
+    CompactionStats getStats() {
+        lock_guard<mutex> lock(mMutex);
+        return mStats;
     }
 
-    HandleManager(): mStackPool(STACK_POOL_CHUNK_ALIGN), mNodePool(2 * PAGE_SIZE), mHead(nullptr, 0, 0, &mHead, &mHead) {
+    HandleManager(): mStackPool(STACK_POOL_CHUNK_ALIGN), mToPool(STACK_POOL_CHUNK_ALIGN),
+        mNodePool(2 * PAGE_SIZE), mHead(nullptr, 0, 0, 0, &mHead, &mHead), mCursor(nullptr), mSpace(0), mToSpace(0), mLiveSize(0),
+        mSmallCount(0), mUnmovedCount(0), mStats(), mStopCompaction(false) {
     }
     ~HandleManager() {
+        stopCompactionThread();
         assert(mHead.next == &mHead);
         assert(mHead.prev == &mHead);
     }
 private:
     Node* createNode(void *p, int size, int align) {
-         Node* n = new (mNodePool.alloc()) Node(p, size, align, &mHead, mHead.next);
+         Node* n = new (mNodePool.alloc()) Node(p, size, align, mCursor != nullptr ? mToSpace : mSpace, &mHead, mHead.next);
          mHead.next->prev = n;
          mHead.next = n;
          return n;
     }
     void destroyNode(Node *n) {
+        if (n == mCursor) mCursor = n->next;
         n->next->prev = n->prev;
         n->prev->next = n->next;
         n->~Node();
         mNodePool.free(n);
     }
+    bool moveNode(Node *n) {
+        if (!n->beginMove()) return false;
+        void *p = mToPool.alloc(n->size, n->align);
+        memcpy(p, n->p.load(memory_order_relaxed), n->size);
+        n->space = mToSpace;
+        n->endMove(p);
+        mStats.movedBytes += n->size;
+        --mUnmovedCount;
+        return true;
+    }
+    bool doCompactStep(int maxBytes) {
+        if (mCursor == nullptr) {
+            mCursor = mHead.next;
+            mToSpace = mSpace ^ 1;
+            mUnmovedCount = mSmallCount;
+        }
+        // walking a node costs like moving a pointer
+        for (int bytes = 0; mUnmovedCount > 0 && bytes < maxBytes; ) {
+            // pinned objects, or ones relinked behind the cursor, are left for another pass
+            if (mCursor == &mHead) mCursor = mHead.next;
+            Node *n = mCursor;
+            if (n->space != mToSpace && n->size < LARGE_OBJ_SIZE && moveNode(n)) bytes += n->size;
+            else bytes += sizeof(void*);
+            mCursor = n->next;
+        }
+        if (mUnmovedCount > 0) return false;
+
+        // every object has been moved under its pin, nothing can point into the old pool any more
+        mCursor = nullptr;
+        mSpace = mToSpace;
+        mStackPool.clear();
+        mStackPool.swap(mToPool);
+        ++mStats.cycles;
+        return true;
+    }
+    double getFragmentationLocked() const {
+        if (mLiveSize == 0) return 1;
+        return double(mStackPool.getUsedSize() + mToPool.getUsedSize()) / mLiveSize;
+    }
 private:
-    StackMemPool mStackPool;
+    mutex mMutex; // for the list and the pools, not for the dereferences
+    StackMemPool mStackPool, mToPool;
     NodeMemPool<sizeof(Node)> mNodePool;
     Node mHead;
+    Node *mCursor; // next node to move, nullptr if not compacting
+    int mSpace, mToSpace;
+    size_t mLiveSize, mSmallCount, mUnmovedCount;
+    CompactionStats mStats;
+    thread mCompactionThread;
+    atomic<bool> mStopCompaction;
     static const int LARGE_OBJ_SIZE = PAGE_SIZE;
     static const int STACK_POOL_CHUNK_ALIGN = PAGE_SIZE * 4;
 };
@@ -225,6 +396,9 @@ static void getMemUsage(double& vm_usage, double& resident_set)
 }
 
 //////////////////////////////
+static void setValue(int *p, int v) { *p = v; }
+static void setValue(const Handle<int> &h, int v) { *Handle<int>::Pin(h) = v; }
+
 template<typename PtrT>
 class SortBenchmark {
 public:
@@ -251,7 +425,7 @@ public:
                     break;
                 case 3: case 4: case 5: case 6:
                     mData.push_back(allocPtr());
-                    *mData.back() = rand() % mData.size();
+                    setValue(mData.back(), rand() % mData.size());
                     break;
                 default: break;
             }
@@ -264,6 +438,8 @@ public:
         preparing();
         printf("\tpreparing:%.3fs\n", chrono::duration<double>(chrono::high_resolution_clock::now() - start).count());
 
+        printStats();
+
         double vm, pm;
         getMemUsage(vm, pm);
         printf("\tmemory usage: %.3fMB, %.3fMB\n", vm, pm);
@@ -284,6 +460,7 @@ public:
     virtual PtrT allocPtr() = 0;
     virtual void freePtr(PtrT p) = 0;
     virtual void preparing() = 0;
+    virtual void printStats() {}
 protected:
     vector<PtrT> mData;
 };
@@ -295,27 +472,62 @@ class SortBenchmark_Default: public SortBenchmark<int*> {
     virtual void preparing() {}
 };
 
-class SortBenchmark_Handle: public SortBenchmark<Handle<int>> {
-    virtual const char* getName() { return "handle compaction"; }
+class SortBenchmark_HandleBase: public SortBenchmark<Handle<int>> {
+protected:
     virtual Handle<int> allocPtr() { return mMgr.create<int>(); }
     virtual void freePtr(Handle<int> p) { mMgr.destroy(p); }
     virtual void preparing() {
-        mMgr.compact();
+        mFragmentation = mMgr.getFragmentation();
+        compact();
+    }
+    virtual void printStats() {
+        CompactionStats stats = mMgr.getStats();
+        printf("\tfragmentation: %.3f -> %.3f\n", mFragmentation, mMgr.getFragmentation());
+        printf("\tpause: cycles=%d, steps=%d, max=%.3fms, total=%.3fms, moved=%.3fMB\n",
+                stats.cycles, stats.steps, stats.maxPause * 1000, stats.totalPause * 1000, stats.movedBytes / 1024.0 / 1024.0);
     }
+    virtual void compact() = 0;
     HandleManager mMgr;
+    double mFragmentation;
 };
 
-class SortBenchmark_HandleRelative: public SortBenchmark<Handle<int>> {
+class SortBenchmark_Handle: public SortBenchmark_HandleBase {
+    virtual const char* getName() { return "handle compaction"; }
+    virtual void compact() {
+        mMgr.compact();
+    }
+};
+
+class SortBenchmark_HandleRelative: public SortBenchmark_HandleBase {
     virtual const char* getName() { return "handle relative compaction"; }
-    virtual Handle<int> allocPtr() { return mMgr.create<int>(); }
-    virtual void freePtr(Handle<int> p) { mMgr.destroy(p); }
-    virtual void preparing() {
+    virtual void compact() {
         for (int i = 0; i < (int)mData.size() - 1; ++i) {
             mMgr.setRelative(mData[i], mData[i + 1]);
         }
         mMgr.compact();
     }
-    HandleManager mMgr;
+};
+
+class SortBenchmark_HandleIncremental: public SortBenchmark_HandleBase {
+    virtual const char* getName() { return "handle incremental compaction"; }
+    virtual void compact() {
+        while (!mMgr.compactStep(STEP_BYTES));
+    }
+    static const int STEP_BYTES = 64 * 1024;
+};
+
+// the compaction thread runs while generating and sorting
+class SortBenchmark_HandleConcurrent: public SortBenchmark_HandleBase {
+public:
+    SortBenchmark_HandleConcurrent() {
+        mMgr.startCompactionThread(STEP_BYTES, MAX_FRAGMENTATION, INTERVAL_US);
+    }
+private:
+    virtual const char* getName() { return "handle concurrent compaction"; }
+    virtual void compact() {}
+    static const int STEP_BYTES = 64 * 1024;
+    static constexpr double MAX_FRAGMENTATION = 1.5;
+    static const int INTERVAL_US = 100;
 };
 //////////////////////////////
 template<typename T>
@@ -332,5 +544,7 @@ int main() {
         go<SortBenchmark_Default>(size);
         go<SortBenchmark_Handle>(size);
         go<SortBenchmark_HandleRelative>(size);
+        go<SortBenchmark_HandleIncremental>(size);
+        go<SortBenchmark_HandleConcurrent>(size);
     }
 }
@@ -0,0 +1,603 @@
+#ifndef XML_PULL_PARSER_H
+#define XML_PULL_PARSER_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// ==================== streaming xml parser
+/*
+   next() yields one event at a time from a bounded buffer which is refilled from an IXmlInputStream,
+   so memory doesn't depend on the document size. Names and values are views into the buffer, valid
+   until the next call of next(); they are copied only if entities have to be decoded.
+   A start tag yields StartElement followed by one Attribute per attribute, an empty element tag
+   yields an EndElement after them. Text longer than the buffer is yielded in several Text events,
+   and text of white spaces only is skipped; white spaces at the start of a text longer than the
+   buffer are held back until the text turns out not to be blank, so the events don't depend on
+   the buffer size.
+*/
+
+struct XmlStringRef
+{
+    const char *ptr;
+    size_t size;
+    XmlStringRef(): ptr(NULL), size(0) {}
+    XmlStringRef(const char *_ptr, size_t _size): ptr(_ptr), size(_size) {}
+    bool operator == (const char *s) const { return strlen(s) == size && memcmp(ptr, s, size) == 0; }
+    std::string toString() const { return std::string(ptr, size); }
+};
+
+enum XmlEventType
+{
+    XET_StartElement,
+    XET_Attribute,
+    XET_EndElement,
+    XET_Text,
+    XET_Comment,
+    XET_Declare,
+    XET_EndDocument,
+    XET_Error,
+};
+
+struct IXmlInputStream
+{
+    virtual ~IXmlInputStream() {}
+    // returns 0 at the end
+    virtual size_t read(char *buf, size_t size) = 0;
+};
+
+class XmlFileInputStream:
+    public IXmlInputStream
+{
+public:
+    explicit XmlFileInputStream(FILE *f): m_f(f) {}
+    virtual size_t read(char *buf, size_t size) { return fread(buf, 1, size, m_f); }
+private:
+    FILE *m_f;
+};
+
+// the first '<' or '&' in [p, end), or end
+inline const char* findXmlMarkupOrEntity(const char *p, const char *end)
+{
+#ifdef __SSE2__
+    for (; p + 16 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('<')), _mm_cmpeq_epi8(v, _mm_set1_epi8('&'))));
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p < end && *p != '<' && *p != '&'; ++p);
+    return p;
+}
+
+inline void appendXmlUTF8(std::string &out, unsigned cp)
+{
+    if (cp < 0x80) {
+        out.push_back((char)cp);
+    } else if (cp < 0x800) {
+        out.push_back((char)(0xc0 | (cp >> 6)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+        out.push_back((char)(0xe0 | (cp >> 12)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    } else {
+        out.push_back((char)(0xf0 | (cp >> 18)));
+        out.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    }
+}
+
+// appends [p, end) with the entities replaced, unknown entities are kept as they are
+inline void decodeXmlEntities(const char *p, const char *end, std::string &out)
+{
+    for (;;) {
+        const char *amp = p;
+        for (; amp < end && *amp != '&'; ++amp);
+        out.append(p, amp);
+        if (amp == end) return;
+
+        const char *semicolon = amp + 1;
+        for (; semicolon < end && semicolon - amp <= 10 && *semicolon != ';'; ++semicolon);
+        p = amp + 1;
+        if (semicolon >= end || *semicolon != ';') {
+            out.push_back('&');
+            continue;
+        }
+
+        std::string name(amp + 1, semicolon);
+        if (name == "lt") out.push_back('<');
+        else if (name == "gt") out.push_back('>');
+        else if (name == "amp") out.push_back('&');
+        else if (name == "quot") out.push_back('"');
+        else if (name == "apos") out.push_back('\'');
+        else if (name.size() > 1 && name[0] == '#') {
+            bool isHex = name[1] == 'x';
+            unsigned cp = (unsigned)strtoul(name.c_str() + (isHex ? 2 : 1), NULL, isHex ? 16 : 10);
+            appendXmlUTF8(out, cp);
+        } else {
+            out.push_back('&');
+            continue;
+        }
+        p = semicolon + 1;
+    }
+}
+
+class XmlPullParser
+{
+public:
+    // refill the buffer from input
+    XmlPullParser(IXmlInputStream *input, size_t bufferSize = 64 * 1024):
+        m_input(input), m_buf(NULL), m_pos(0), m_end(0), m_capacity(bufferSize), m_isEOF(false), m_baseOffset(0)
+    {
+        init();
+        m_storage.resize(m_capacity);
+        m_buf = &m_storage[0];
+    }
+    // parse [data, data + size) directly, without copying
+    XmlPullParser(const char *data, size_t size):
+        m_input(NULL), m_buf(const_cast<char*>(data)), m_pos(0), m_end(size), m_capacity(size), m_isEOF(true), m_baseOffset(0)
+    {
+        init();
+    }
+
+    XmlEventType next();
+
+    // element, attribute or declaration name
+    XmlStringRef getName() const { return m_name; }
+    // attribute value, text or comment
+    XmlStringRef getValue() const { return m_value; }
+    int getDepth() const { return (int)m_openNameOffs.size() - m_unmatchedEndCount; }
+    const std::string& getError() const { return m_error; }
+    // offset in the document of the next unread byte
+    size_t getOffset() const { return m_baseOffset + m_pos; }
+
+    // fragment mode: the document is a slice of a bigger one, end tags without start tags are allowed
+    void setFragment(size_t stopOffset)
+    {
+        m_isFragment = true;
+        m_stopOffset = stopOffset;
+    }
+    const std::vector<std::string>& getUnmatchedEndTags() const { return m_unmatchedEndTags; }
+    std::vector<std::string> getOpenTags() const
+    {
+        std::vector<std::string> r;
+        for (size_t i = 0; i < m_openNameOffs.size(); ++i) {
+            size_t end = i + 1 < m_openNameOffs.size() ? m_openNameOffs[i + 1] : m_openNames.size();
+            r.push_back(m_openNames.substr(m_openNameOffs[i], end - m_openNameOffs[i]));
+        }
+        return r;
+    }
+
+private:
+    struct Attribute
+    {
+        XmlStringRef name;
+        XmlStringRef value;
+        size_t decodedOff; // offset in m_decodeBuffer, or -1 if the value is a view of the buffer
+    };
+
+private:
+    void init()
+    {
+        m_attriIndex = 0;
+        m_hasPendingEnd = false;
+        m_isFragment = false;
+        m_stopOffset = (size_t)-1;
+        m_unmatchedEndCount = 0;
+        m_isTextContinued = false;
+    }
+    XmlEventType error(const std::string &msg)
+    {
+        char buf[64];
+        sprintf(buf, " (offset %lu)", (unsigned long)getOffset());
+        m_error = msg + buf;
+        return XET_Error;
+    }
+    // keeps [m_pos, m_end) and reads more after it, returns false at the end of input
+    bool requireMore()
+    {
+        if (m_input == NULL || m_isEOF) return false;
+        if (m_pos > 0) {
+            memmove(m_buf, m_buf + m_pos, m_end - m_pos);
+            m_end -= m_pos;
+            m_baseOffset += m_pos;
+            m_pos = 0;
+        }
+        if (m_end == m_capacity) {
+            // a single markup larger than the buffer
+            m_capacity *= 2;
+            m_storage.resize(m_capacity);
+            m_buf = &m_storage[0];
+        }
+        size_t n = m_input->read(m_buf + m_end, m_capacity - m_end);
+        if (n == 0) m_isEOF = true;
+        m_end += n;
+        return n > 0;
+    }
+    // the position of pattern after m_pos + from, refilling as needed; -1 if not found
+    size_t findInToken(size_t from, const char *pattern)
+    {
+        size_t len = strlen(pattern);
+        for (;;) {
+            for (size_t i = m_pos + from; i + len <= m_end; ++i) {
+                if (m_buf[i] == pattern[0] && memcmp(m_buf + i, pattern, len) == 0) return i - m_pos;
+            }
+            // continue from where the pattern may start
+            from = m_end - m_pos >= len ? m_end - m_pos - len + 1 : from;
+            if (!requireMore()) return (size_t)-1;
+        }
+    }
+    // the closing '>' of a tag, skipping quoted values
+    size_t findTagEnd(size_t from)
+    {
+        char quote = 0;
+        for (;;) {
+            for (; m_pos + from < m_end; ++from) {
+                char c = m_buf[m_pos + from];
+                if (quote != 0) {
+                    if (c == quote) quote = 0;
+                } else if (c == '"' || c == '\'') {
+                    quote = c;
+                } else if (c == '>') {
+                    return from;
+                }
+            }
+            if (!requireMore()) return (size_t)-1;
+        }
+    }
+
+    XmlEventType parseText();
+    XmlEventType parseMarkup();
+    XmlEventType parseTag(const char *p, const char *end, bool isDeclare);
+    XmlEventType parseEndTag(const char *p, const char *end);
+    void setAttributeEvent();
+
+private:
+    IXmlInputStream *m_input;
+    std::vector<char> m_storage;
+    char *m_buf;
+    size_t m_pos, m_end, m_capacity;
+    bool m_isEOF;
+    size_t m_baseOffset;
+
+    XmlStringRef m_name, m_value;
+    std::string m_decodeBuffer;
+    std::vector<Attribute> m_attris;
+    size_t m_attriIndex;
+    bool m_hasPendingEnd;
+    // name of the self-closing element the pending end belongs to, m_name points here
+    std::string m_pendingEndName;
+
+    // the last Text event was a part of a text which goes on after the buffer
+    bool m_isTextContinued;
+    // white spaces which started a text that doesn't fit in the buffer
+    std::string m_pendingBlank;
+
+    // names of the open elements, concatenated
+    std::string m_openNames;
+    std::vector<size_t> m_openNameOffs;
+
+    bool m_isFragment;
+    size_t m_stopOffset;
+    int m_unmatchedEndCount;
+    std::vector<std::string> m_unmatchedEndTags;
+
+    std::string m_error;
+};
+
+inline XmlEventType XmlPullParser::next()
+{
+    if (m_attriIndex < m_attris.size()) {
+        setAttributeEvent();
+        return XET_Attribute;
+    }
+    m_attris.clear();
+    m_attriIndex = 0;
+    if (m_hasPendingEnd) {
+        m_hasPendingEnd = false;
+        m_pendingEndName = m_openNames.substr(m_openNameOffs.back());
+        m_name = XmlStringRef(m_pendingEndName.c_str(), m_pendingEndName.size());
+        m_openNames.resize(m_openNameOffs.back());
+        m_openNameOffs.pop_back();
+        return XET_EndElement;
+    }
+
+    for (;;) {
+        if (getOffset() >= m_stopOffset) return XET_EndDocument;
+        if (m_pos == m_end && !requireMore()) {
+            if (!m_openNameOffs.empty() && !m_isFragment) return error("unclosed element " + getOpenTags().back());
+            return XET_EndDocument;
+        }
+
+        // XET_EndDocument here means white spaces or a doctype were skipped
+        XmlEventType type = m_buf[m_pos] == '<' ? parseMarkup() : parseText();
+        if (type != XET_EndDocument) return type;
+    }
+}
+
+inline XmlEventType XmlPullParser::parseText()
+{
+    const char *p, *end;
+    bool hasEntity = false, isPartial = false;
+    for (;;) {
+        p = m_buf + m_pos;
+        end = findXmlMarkupOrEntity(p, m_buf + m_end);
+        while (end < m_buf + m_end && *end == '&') {
+            hasEntity = true;
+            end = findXmlMarkupOrEntity(end + 1, m_buf + m_end);
+        }
+        if (end < m_buf + m_end) break;
+        if (m_end - m_pos < m_capacity && requireMore()) continue;
+        if (m_isEOF) break;
+        // the buffer is full of text, yield a part of it, but don't split an entity
+        isPartial = true;
+        if (hasEntity) {
+            const char *amp = end;
+            while (amp > p && amp[-1] != '&' && end - amp < 10) --amp;
+            if (amp > p && amp[-1] == '&' && memchr(amp, ';', end - amp) == NULL) end = amp - 1;
+        }
+        break;
+    }
+    m_pos = end - m_buf;
+
+    bool isBlank = true;
+    for (const char *q = p; q < end && isBlank; ++q) isBlank = isspace((unsigned char)*q) != 0;
+    if (isBlank && !m_isTextContinued) {
+        // skipped if the whole text is blank
+        if (isPartial) m_pendingBlank.append(p, end);
+        else m_pendingBlank.clear();
+        return XET_EndDocument;
+    }
+    m_isTextContinued = isPartial;
+
+    if (hasEntity || !m_pendingBlank.empty()) {
+        m_decodeBuffer.swap(m_pendingBlank);
+        m_pendingBlank.clear();
+        if (hasEntity) decodeXmlEntities(p, end, m_decodeBuffer);
+        else m_decodeBuffer.append(p, end);
+        m_value = XmlStringRef(m_decodeBuffer.c_str(), m_decodeBuffer.size());
+    } else {
+        m_value = XmlStringRef(p, end - p);
+    }
+    return XET_Text;
+}
+
+inline XmlEventType XmlPullParser::parseMarkup()
+{
+    // a markup ends the text before it
+    m_isTextContinued = false;
+    m_pendingBlank.clear();
+
+    // enough to classify it
+    while (m_end - m_pos < 9 && requireMore());
+    const char *p = m_buf + m_pos;
+    size_t left = m_end - m_pos;
+
+    if (left >= 4 && memcmp(p, "<!--", 4) == 0) {
+        size_t end = findInToken(4, "-->");
+        if (end == (size_t)-1) return error("unclosed comment");
+        p = m_buf + m_pos;
+        m_value = XmlStringRef(p + 4, end - 4);
+        m_pos += end + 3;
+        return XET_Comment;
+    }
+    if (left >= 9 && memcmp(p, "<![CDATA[", 9) == 0) {
+        size_t end = findInToken(9, "]]>");
+        if (end == (size_t)-1) return error("unclosed CDATA");
+        p = m_buf + m_pos;
+        m_value = XmlStringRef(p + 9, end - 9);
+        m_pos += end + 3;
+        return XET_Text;
+    }
+    if (left >= 2 && p[1] == '!') {
+        // doctype, skipped
+        size_t end = findTagEnd(2);
+        if (end == (size_t)-1) return error("unclosed declaration");
+        m_pos += end + 1;
+        return XET_EndDocument;
+    }
+    if (left >= 2 && p[1] == '?') {
+        size_t end = findInToken(2, "?>");
+        if (end == (size_t)-1) return error("unclosed declaration");
+        p = m_buf + m_pos;
+        m_pos += end + 2;
+        return parseTag(p + 2, p + end, true);
+    }
+
+    size_t end = findTagEnd(1);
+    if (end == (size_t)-1) return error("unclosed tag");
+    p = m_buf + m_pos;
+    m_pos += end + 1;
+    if (p[1] == '/') return parseEndTag(p + 2, p + end);
+    if (p[end - 1] == '/') {
+        m_hasPendingEnd = true;
+        return parseTag(p + 1, p + end - 1, false);
+    }
+    return parseTag(p + 1, p + end, false);
+}
+
+inline bool isXmlNameChar(char c)
+{
+    return isalnum((unsigned char)c) || c == ':' || c == '-' || c == '_' || c == '.' || (unsigned char)c >= 0x80;
+}
+
+inline XmlEventType XmlPullParser::parseTag(const char *p, const char *end, bool isDeclare)
+{
+    const char *nameBegin = p;
+    while (p < end && isXmlNameChar(*p)) ++p;
+    if (p == nameBegin) return error("tag name expected");
+    m_name = XmlStringRef(nameBegin, p - nameBegin);
+
+    m_decodeBuffer.clear();
+    for (;;) {
+        while (p < end && isspace((unsigned char)*p)) ++p;
+        if (p == end) break;
+
+        Attribute attri;
+        const char *attriBegin = p;
+        while (p < end && isXmlNameChar(*p)) ++p;
+        if (p == attriBegin) return error("attribute name expected");
+        attri.name = XmlStringRef(attriBegin, p - attriBegin);
+        while (p < end && isspace((unsigned char)*p)) ++p;
+        if (p == end || *p != '=') return error("'=' expected");
+        ++p;
+        while (p < end && isspace((unsigned char)*p)) ++p;
+        if (p == end || (*p != '"' && *p != '\'')) return error("attribute value expected");
+        char quote = *p++;
+        const char *valueBegin = p;
+        while (p < end && *p != quote) ++p;
+        if (p == end) return error("unclosed attribute value");
+        attri.value = XmlStringRef(valueBegin, p - valueBegin);
+        attri.decodedOff = (size_t)-1;
+        if (memchr(valueBegin, '&', p - valueBegin) != NULL) {
+            attri.decodedOff = m_decodeBuffer.size();
+            decodeXmlEntities(valueBegin, p, m_decodeBuffer);
+            attri.value.size = m_decodeBuffer.size() - attri.decodedOff;
+        }
+        ++p;
+        m_attris.push_back(attri);
+    }
+
+    if (isDeclare) return XET_Declare;
+    m_openNameOffs.push_back(m_openNames.size());
+    m_openNames.append(m_name.ptr, m_name.size);
+    return XET_StartElement;
+}
+
+inline XmlEventType XmlPullParser::parseEndTag(const char *p, const char *end)
+{
+    while (end > p && isspace((unsigned char)end[-1])) --end;
+    m_name = XmlStringRef(p, end - p);
+    if (m_openNameOffs.empty()) {
+        if (!m_isFragment) return error("unexpected end tag " + m_name.toString());
+        ++m_unmatchedEndCount;
+        m_unmatchedEndTags.push_back(m_name.toString());
+        return XET_EndElement;
+    }
+    size_t off = m_openNameOffs.back();
+    if (m_openNames.size() - off != m_name.size || memcmp(m_openNames.c_str() + off, m_name.ptr, m_name.size) != 0) {
+        return error("end tag " + m_name.toString() + " doesn't match " + m_openNames.substr(off));
+    }
+    m_openNames.resize(off);
+    m_openNameOffs.pop_back();
+    return XET_EndElement;
+}
+
+inline void XmlPullParser::setAttributeEvent()
+{
+    const Attribute &attri = m_attris[m_attriIndex++];
+    m_name = attri.name;
+    m_value = attri.value;
+    if (attri.decodedOff != (size_t)-1) m_value.ptr = m_decodeBuffer.c_str() + attri.decodedOff;
+}
+
+// ==================== parallel parse of an in-memory document
+/*
+   The document is cut into threadCount slices at guessed tag boundaries ('<' followed by a name or '/'),
+   and each slice is parsed in a fragment mode parser by its own thread. A guess is wrong if the
+   previous slice doesn't end exactly at it (the '<' was inside a comment, CDATA or an attribute value);
+   such a slice is parsed again from where the previous one really ended.
+   handler(slice, parser, event) is called from the worker threads, and discardSlice(slice) before a
+   slice is parsed again, so the results should be collected per slice and merged in slice order.
+   Returns false if any slice fails or the tags don't match across slices.
+*/
+typedef std::function<void(int slice, XmlPullParser &parser, XmlEventType event)> XmlSliceHandler;
+
+inline size_t guessXmlTagBoundary(const char *data, size_t size, size_t off)
+{
+    for (; off < size; ++off) {
+        if (data[off] != '<' || off + 1 == size) continue;
+        char c = data[off + 1];
+        if (c == '/' || isalpha((unsigned char)c) || c == '_') return off;
+    }
+    return size;
+}
+
+inline bool parseXmlInParallel(const char *data, size_t size, int threadCount,
+        const XmlSliceHandler &handler, const std::function<void(int slice)> &discardSlice, std::string &error)
+{
+    std::vector<size_t> starts(threadCount + 1, size);
+    starts[0] = 0;
+    for (int i = 1; i < threadCount; ++i) {
+        starts[i] = guessXmlTagBoundary(data, size, std::max(starts[i - 1], size / threadCount * i));
+    }
+
+    struct SliceResult
+    {
+        size_t endOffset;
+        bool isOk;
+        std::string error;
+        std::vector<std::string> unmatchedEndTags, openTags;
+    };
+    std::vector<SliceResult> results(threadCount);
+    auto parseSlice = [&](int i, size_t begin) {
+        XmlPullParser parser(data + begin, size - begin);
+        parser.setFragment(starts[i + 1] - begin);
+        SliceResult &r = results[i];
+        r.isOk = true;
+        for (;;) {
+            XmlEventType event = parser.next();
+            if (event == XET_EndDocument) break;
+            if (event == XET_Error) {
+                r.isOk = false;
+                r.error = parser.getError();
+                break;
+            }
+            handler(i, parser, event);
+        }
+        r.endOffset = begin + parser.getOffset();
+        r.unmatchedEndTags = parser.getUnmatchedEndTags();
+        r.openTags = parser.getOpenTags();
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i) threads.push_back(std::thread(parseSlice, i, starts[i]));
+    for (auto &t : threads) t.join();
+
+    std::vector<std::string> openTags;
+    for (int i = 0; i < threadCount; ++i) {
+        if (i > 0 && results[i - 1].endOffset != starts[i]) {
+            // misspeculated, the previous slice already consumed a part of this one
+            discardSlice(i);
+            if (results[i - 1].endOffset >= starts[i + 1]) {
+                // nothing left of this slice, the next one has to start where the previous ended
+                results[i].endOffset = results[i - 1].endOffset;
+                continue;
+            }
+            starts[i] = results[i - 1].endOffset;
+            parseSlice(i, starts[i]);
+        }
+        const SliceResult &r = results[i];
+        if (!r.isOk) {
+            error = r.error;
+            return false;
+        }
+        for (auto &tag : r.unmatchedEndTags) {
+            if (openTags.empty() || openTags.back() != tag) {
+                error = "end tag " + tag + " doesn't match";
+                return false;
+            }
+            openTags.pop_back();
+        }
+        openTags.insert(openTags.end(), r.openTags.begin(), r.openTags.end());
+    }
+    if (!openTags.empty()) {
+        error = "unclosed element " + openTags.back();
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -6,8 +6,10 @@
 #include <sstream>
 #include <memory>
 #include <map>
+#include <chrono>
 
 #include "common.h"
+#include "XmlPullParser.h"
 
 // xml syntax
 /*
@@ -472,11 +474,93 @@ private:
     int m_d;
 };
 
-int main()
+struct XmlStatistics
+{
+    size_t elementCount, attributeCount, textSize;
+    int maxDepth;
+    XmlStatistics(): elementCount(0), attributeCount(0), textSize(0), maxDepth(0) {}
+    void onEvent(XmlPullParser &parser, XmlEventType event)
+    {
+        switch (event) {
+            case XET_StartElement: ++elementCount; maxDepth = std::max(maxDepth, parser.getDepth()); break;
+            case XET_Attribute: ++attributeCount; break;
+            case XET_Text: textSize += parser.getValue().size; break;
+            default: break;
+        }
+    }
+    void print(double seconds, size_t fileSize) const
+    {
+        printf("elements: %lu, attributes: %lu, text: %lu bytes, max depth: %d, %.1f MB/s\n",
+                (unsigned long)elementCount, (unsigned long)attributeCount, (unsigned long)textSize, maxDepth,
+                fileSize / 1024.0 / 1024.0 / seconds);
+    }
+};
+
+// constant memory whatever the file size
+void streamXml(const std::string& fname)
+{
+    FILE *f = fopen(fname.c_str(), "rb");
+    if (f == NULL) {
+        cout << "Can't open " << fname << endl;
+        return;
+    }
+    XmlFileInputStream input(f);
+    XmlPullParser parser(&input);
+    XmlStatistics stats;
+    auto start = std::chrono::steady_clock::now();
+    for (;;) {
+        XmlEventType event = parser.next();
+        if (event == XET_EndDocument) break;
+        if (event == XET_Error) {
+            cout << "Error : " << parser.getError() << endl;
+            break;
+        }
+        stats.onEvent(parser, event);
+    }
+    stats.print(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), parser.getOffset());
+    fclose(f);
+}
+
+void parseXmlFileInParallel(const std::string& fname, int threadCount)
+{
+    std::string src = readFile(fname);
+    std::vector<XmlStatistics> stats(threadCount);
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    bool isOk = parseXmlInParallel(src.c_str(), src.size(), threadCount,
+            [&](int slice, XmlPullParser &parser, XmlEventType event) { stats[slice].onEvent(parser, event); },
+            [&](int slice) { stats[slice] = XmlStatistics(); },
+            error);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!isOk) {
+        cout << "Error : " << error << endl;
+        return;
+    }
+    XmlStatistics total;
+    for (auto &s : stats) {
+        total.elementCount += s.elementCount;
+        total.attributeCount += s.attributeCount;
+        total.textSize += s.textSize;
+    }
+    // the depth of a slice is relative to where it starts
+    total.maxDepth = -1;
+    total.print(seconds, src.size());
+}
+
+int main(int argc, char *argv[])
 {
     try 
     {
-        std::string fname = "1.xml";
+        std::string fname = argc > 1 ? argv[1] : "1.xml";
+        if (argc > 2 && argv[2] == std::string("-stream")) {
+            streamXml(fname);
+            return 0;
+        }
+        if (argc > 3 && argv[2] == std::string("-parallel")) {
+            parseXmlFileInParallel(fname, atoi(argv[3]));
+            return 0;
+        }
+
         XmlParser p(fname, readFile(fname));
 
         std::ofstream("2.xml") << NodeVisitor_Xml().apply(p.getRoot());
@@ -6,18 +6,7 @@
 #include "RegParser.h"
 #include "DFAMatch.h"
 #include "DynamicBitset.h"
-
-struct RegexpInfo
-{
-    RegNodePtr rootNode;
-    RegNodePtr acceptNode;
-    std::vector<RegNode_Charset*> ID2Node;
-    std::unordered_map<RegNode_Charset*, int> node2ID;
-    std::vector<DynamicBitset> followNodes;
-    std::unordered_map<IRegNode*, bool> nullable;
-    std::unordered_map<IRegNode*, DynamicBitset> firstNodes;
-    std::unordered_map<IRegNode*, DynamicBitset> lastNodes;
-};
+#include "RegexpInfo.h"
 
 class RegNodeVisitor_RegexpInfoBuilder:
     public IRegNodeVisitor
@@ -98,7 +87,7 @@ private:
         v->node->acceptVisitor(this);
         switch (m_state) {
             case S_SetNullable:
-                m_info.nullable[v] = v->min == 0;
+                m_info.nullable[v] = v->min == 0 || m_info.nullable[v->node.get()];
                 break;
             case S_SetFirstNodes: 
                 m_info.firstNodes[v] = m_info.firstNodes[v->node.get()];
@@ -227,10 +216,15 @@ static void buildDFAInstance(DFAInstance& ins, RegexpInfo& info)
     ins.setAcceptStates(acceptStates);
 }
 
+void buildRegexpInfo(RegexpInfo& info, const RegNodePtr& node)
+{
+    RegNodeVisitor_RegexpInfoBuilder(info, node);
+}
+
 bool compile(DFAInstancePtr &dfa, const RegNodePtr &node)
 {
     RegexpInfo info;
-    RegNodeVisitor_RegexpInfoBuilder(info, node);
+    buildRegexpInfo(info, RegNodeVisitor_Normalizer().apply(node));
     dfa.reset(new DFAInstance);
     buildDFAInstance(*dfa, info);
     return true;
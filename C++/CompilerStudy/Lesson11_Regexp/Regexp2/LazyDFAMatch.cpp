@@ -0,0 +1,221 @@
+#include "pch.h"
+
+#include <string.h>
+
+#include <map>
+#include <algorithm>
+
+#include "RegParser.h"
+#include "RegexpInfo.h"
+#include "LazyDFAMatch.h"
+
+size_t LazyDFAInstance::KeyHash::operator () (const std::vector<int>& key) const
+{
+    size_t r = 2166136261U;
+    for (int i = 0; i < (int)key.size(); ++i) r = (r ^ (size_t)key[i]) * 16777619U;
+    return r;
+}
+
+LazyDFAInstance::LazyDFAInstance(const RegNodePtr& node, int maxStateCount):
+    m_maxStateCount(std::max(maxStateCount, 8)), m_flushCount(0)
+{
+    RegexpInfo info;
+    buildRegexpInfo(info, node);
+
+    int positionCount = (int)info.ID2Node.size();
+    m_acceptPosition = info.node2ID[(RegNode_Charset*)info.acceptNode.get()];
+    m_charsets.resize(positionCount);
+    m_followPositions.resize(positionCount);
+    for (int i = 0; i < positionCount; ++i) {
+        m_charsets[i] = info.ID2Node[i]->sets;
+        info.followNodes[i].toInts(m_followPositions[i]);
+    }
+    info.firstNodes[info.rootNode.get()].toInts(m_firstPositions);
+    m_seenPositions.resize(positionCount, 0);
+
+    // chars which no position tells apart share a column of the transition table
+    std::map<std::vector<bool>, int> signature2Class;
+    for (int c = 0; c < 256; ++c) {
+        std::vector<bool> signature(positionCount, false);
+        for (int i = 0; c < 128 && i < positionCount; ++i) signature[i] = m_charsets[i].test(c);
+        if (signature2Class.count(signature) == 0) {
+            signature2Class[signature] = (int)m_classChars.size();
+            m_classChars.push_back(c);
+        }
+        m_charClass[c] = signature2Class[signature];
+    }
+    m_classCount = (int)m_classChars.size();
+
+    for (std::vector<int> positions = m_firstPositions; positions.size() == 1; ) {
+        int pos = positions[0];
+        if (pos == m_acceptPosition || m_charsets[pos].count() != 1) break;
+        for (int c = 0; c < 128; ++c) {
+            if (m_charsets[pos].test(c)) m_literalPrefix.push_back((char)c);
+        }
+        positions = m_followPositions[pos];
+    }
+
+    flush();
+    m_flushCount = 0;
+}
+
+void LazyDFAInstance::flush()
+{
+    ++m_flushCount;
+    m_stateKeys.clear();
+    m_key2State.clear();
+    m_transMap.clear();
+    m_acceptStates.clear();
+
+    std::vector<int> key(1, GROUP_END);
+    getState(key);
+    for (int unanchored = 0; unanchored < 2; ++unanchored) {
+        key.assign(1, unanchored ? F_Unanchored : 0);
+        key.insert(key.end(), m_firstPositions.begin(), m_firstPositions.end());
+        key.push_back(GROUP_END);
+        m_startStates[unanchored] = getState(key);
+    }
+}
+
+// key: flags, then the position groups each ended with GROUP_END
+int LazyDFAInstance::getState(std::vector<int>& key)
+{
+    if (key[0] != GROUP_END) {
+        bool accept = false;
+        for (int i = 1; i < (int)key.size(); ++i) {
+            if (key[i] == m_acceptPosition) accept = true;
+            else if (key[i] == GROUP_END && accept) {
+                // threads started later than this match can't be leftmost any more
+                key.resize(i + 1);
+                if (key[0] & F_Unanchored) key[0] |= F_Matched;
+                break;
+            }
+        }
+        if (key.size() == 1 && (key[0] & F_Unanchored) == 0) return DEAD_STATE;
+        if (key.size() == 1 && (key[0] & F_Matched) != 0) return DEAD_STATE;
+    }
+
+    std::unordered_map<std::vector<int>, int, KeyHash>::const_iterator iter = m_key2State.find(key);
+    if (iter != m_key2State.end()) return iter->second;
+
+    int state = (int)m_stateKeys.size();
+    bool accept = std::find(key.begin() + 1, key.end(), m_acceptPosition) != key.end();
+    m_stateKeys.push_back(key);
+    m_key2State[key] = state;
+    m_transMap.resize(m_transMap.size() + m_classCount, state == DEAD_STATE ? DEAD_STATE : (int)UNKNOWN_STATE);
+    m_acceptStates.push_back(accept && state != DEAD_STATE);
+    return state;
+}
+
+int LazyDFAInstance::buildTrans(int state, char c)
+{
+    if ((int)m_stateKeys.size() >= m_maxStateCount) {
+        std::vector<int> key = m_stateKeys[state];
+        flush();
+        state = getState(key);
+    }
+
+    const std::vector<int> &key = m_stateKeys[state];
+    int cls = m_charClass[(unsigned char)c], ch = m_classChars[cls];
+    std::vector<int> tkey(1, key[0]);
+    for (int i = 1; i < (int)key.size(); ++i) {
+        int groupBegin = (int)tkey.size();
+        for (; key[i] != GROUP_END; ++i) {
+            int pos = key[i];
+            if (ch >= 128 || !m_charsets[pos].test(ch)) continue;
+            const std::vector<int> &follow = m_followPositions[pos];
+            for (int j = 0; j < (int)follow.size(); ++j) {
+                if (m_seenPositions[follow[j]]) continue;
+                m_seenPositions[follow[j]] = 1;
+                tkey.push_back(follow[j]);
+            }
+        }
+        if ((int)tkey.size() == groupBegin) continue;
+        std::sort(tkey.begin() + groupBegin, tkey.end());
+        tkey.push_back(GROUP_END);
+    }
+    if (tkey[0] == F_Unanchored) {
+        // a new thread starts after every char until something matched
+        int groupBegin = (int)tkey.size();
+        for (int i = 0; i < (int)m_firstPositions.size(); ++i) {
+            if (!m_seenPositions[m_firstPositions[i]]) tkey.push_back(m_firstPositions[i]);
+        }
+        if ((int)tkey.size() > groupBegin) tkey.push_back(GROUP_END);
+    }
+    for (int i = 1; i < (int)tkey.size(); ++i) {
+        if (tkey[i] != GROUP_END) m_seenPositions[tkey[i]] = 0;
+    }
+
+    int tstate = getState(tkey);
+    m_transMap[state * m_classCount + cls] = tstate;
+    return tstate;
+}
+
+LazyDFA::LazyDFA(const RegNodePtr& node, int maxStateCount):
+    forward(RegNodeVisitor_Normalizer().apply(node), maxStateCount),
+    backward(RegNodeVisitor_Normalizer(true).apply(node), maxStateCount)
+{
+}
+
+bool compile(LazyDFAPtr &dfa, const RegNodePtr &node, int maxStateCount)
+{
+    dfa.reset(new LazyDFA(node, maxStateCount));
+    return true;
+}
+
+bool match(const LazyDFAPtr &dfa, const std::string& src)
+{
+    LazyDFAInstance &ins = dfa->forward;
+    int state = ins.getStartState(false);
+    for (int i = 0; i < (int)src.size(); ++i) {
+        state = ins.getTrans(state, src[i]);
+        if (ins.isDeadState(state)) return false;
+    }
+    return ins.isAcceptState(state);
+}
+
+static const char* findLiteral(const char *begin, const char *end, const std::string& literal)
+{
+    for (;;) {
+        if (end - begin < (int)literal.size()) return NULL;
+        begin = (const char*)memchr(begin, literal[0], end - begin - literal.size() + 1);
+        if (begin == NULL) return NULL;
+        if (memcmp(begin + 1, literal.c_str() + 1, literal.size() - 1) == 0) return begin;
+        ++begin;
+    }
+}
+
+bool search(const LazyDFAPtr &dfa, const char *begin, const char *end, const char *&matchBegin, const char *&matchEnd)
+{
+    // the forward pass finds where the leftmost longest match ends
+    LazyDFAInstance &fw = dfa->forward;
+    const std::string &prefix = fw.getLiteralPrefix();
+    const char *e = NULL;
+    int state = fw.getStartState(true);
+    if (fw.isAcceptState(state)) e = begin;
+    for (const char *p = begin; p < end; ++p) {
+        if (!prefix.empty() && state == fw.getStartState(true)) {
+            // no thread in progress, so nothing can match before the next occurrence of the prefix
+            p = findLiteral(p, end, prefix);
+            if (p == NULL) break;
+        }
+        state = fw.getTrans(state, *p);
+        if (fw.isDeadState(state)) break;
+        if (fw.isAcceptState(state)) e = p + 1;
+    }
+    if (e == NULL) return false;
+
+    // then the longest match of the reversed regexp backward from there is where it begins
+    LazyDFAInstance &bw = dfa->backward;
+    const char *b = e;
+    state = bw.getStartState(false);
+    for (const char *p = e; p > begin; ) {
+        state = bw.getTrans(state, *--p);
+        if (bw.isDeadState(state)) break;
+        if (bw.isAcceptState(state)) b = p;
+    }
+
+    matchBegin = b;
+    matchEnd = e;
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef LAZY_DFA_MATCH_H
+#define LAZY_DFA_MATCH_H
+
+#include <memory>
+#include <bitset>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "RegParser.h"
+
+// A DFA whose states are built on demand from the regexp positions while matching, and cached in a
+// bounded table which is flushed when it's full.
+// In unanchored mode the positions of a state are grouped by the start of their thread, earliest first,
+// and the groups behind the first one reaching accept are dropped, which gives leftmost longest match.
+class LazyDFAInstance
+{
+public:
+    LazyDFAInstance(const RegNodePtr& node, int maxStateCount);
+    int getStartState(bool unanchored) const { return m_startStates[unanchored]; }
+    int getTrans(int state, char c)
+    {
+        int tstate = m_transMap[state * m_classCount + m_charClass[(unsigned char)c]];
+        return tstate == UNKNOWN_STATE ? buildTrans(state, c) : tstate;
+    }
+    bool isDeadState(int state) const { return state == DEAD_STATE; }
+    bool isAcceptState(int state) const { return m_acceptStates[state] != 0; }
+    const std::string& getLiteralPrefix() const { return m_literalPrefix; }
+    int getStateCount() const { return (int)m_stateKeys.size(); }
+    int getFlushCount() const { return m_flushCount; }
+private:
+    enum
+    {
+        DEAD_STATE = 0,
+        UNKNOWN_STATE = -1,
+        GROUP_END = -1,
+        F_Unanchored = 1,
+        F_Matched = 2,
+    };
+    struct KeyHash
+    {
+        size_t operator () (const std::vector<int>& key) const;
+    };
+private:
+    int buildTrans(int state, char c);
+    int getState(std::vector<int>& key);
+    void flush();
+private:
+    std::vector<std::bitset<128> > m_charsets;
+    std::vector<std::vector<int> > m_followPositions;
+    std::vector<int> m_firstPositions;
+    int m_acceptPosition;
+    std::string m_literalPrefix;
+
+    int m_charClass[256];
+    std::vector<int> m_classChars;
+    int m_classCount;
+
+    int m_maxStateCount;
+    int m_flushCount;
+    int m_startStates[2];
+    std::vector<std::vector<int> > m_stateKeys;
+    std::unordered_map<std::vector<int>, int, KeyHash> m_key2State;
+    std::vector<int> m_transMap;
+    std::vector<char> m_acceptStates;
+    std::vector<char> m_seenPositions;
+};
+
+struct LazyDFA
+{
+    LazyDFAInstance forward;
+    LazyDFAInstance backward; // runs over the reversed regexp to find where a match begins
+    LazyDFA(const RegNodePtr& node, int maxStateCount);
+};
+typedef std::shared_ptr<LazyDFA> LazyDFAPtr;
+
+bool compile(LazyDFAPtr &dfa, const RegNodePtr &node, int maxStateCount = 1024);
+bool match(const LazyDFAPtr &dfa, const std::string& src);
+// find the leftmost longest match in [begin, end)
+bool search(const LazyDFAPtr &dfa, const char *begin, const char *end, const char *&matchBegin, const char *&matchEnd);
+
+#endif
@@ -144,7 +144,7 @@ private:
 
 bool compile(NFANodePtr &nfa, const RegNodePtr &node)
 {
-    nfa = RegNodeVisior_NFABuilder().apply(node);
+    nfa = RegNodeVisior_NFABuilder().apply(RegNodeVisitor_Normalizer().apply(node));
     return nfa != NULL;
 }
 
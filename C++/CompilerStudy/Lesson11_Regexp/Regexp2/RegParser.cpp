@@ -86,8 +86,8 @@ private:
             int min = 0, max = 0;
             assert(sa_int(min));
             max = min;
-            if (tryConsume(',')) {
-                sa_int(max);
+            if (tryConsume(',') && !sa_int(max)) {
+                max = REPEAT_MAX;
             }
             consumeToken('}');
             RegNode_Repeat *repeat = new RegNode_Repeat(min, max, true, r);
@@ -437,3 +437,99 @@ std::string RegNodeVisitor_LogicPrinter::apply(RegNodePtr node)
 {
     return m_impl->apply(node);
 }
+//====================
+// RegNodeVisitor_NormalizerImpl
+//====================
+class RegNodeVisitor_NormalizerImpl:
+    public IRegNodeVisitor
+{
+public:
+    RegNodeVisitor_NormalizerImpl(bool reverse): m_reverse(reverse){}
+    RegNodePtr apply(const RegNodePtr& node)
+    {
+        node->acceptVisitor(this);
+        return m_node;
+    }
+private:
+    virtual void visit(RegNode_Charset *v)
+    {
+        RegNode_Charset *p = new RegNode_Charset();
+        p->sets = v->sets;
+        m_node.reset(p);
+    }
+    virtual void visit(RegNode_Capture *v)
+    {
+        v->node->acceptVisitor(this);
+        m_node.reset(new RegNode_Capture(m_node));
+    }
+    virtual void visit(RegNode_Repeat *v)
+    {
+        assert(v->min <= v->max);
+        if (v->max == 0) {
+            // x{0} matches only the empty string: an optional charset that accepts nothing
+            RegNodePtr none(new RegNode_Charset());
+            m_node.reset(new RegNode_Repeat(0, 1, v->gready, none));
+            return;
+        }
+        if (v->min <= 1 && (v->max == 1 || v->max == REPEAT_MAX)) {
+            v->node->acceptVisitor(this);
+            m_node.reset(new RegNode_Repeat(v->min, v->max, v->gready, m_node));
+            return;
+        }
+
+        // x{m,n} -> x..x x?..x?, x{m,} -> x..x x+
+        RegNodePtr r;
+        int fixedCount = v->max == REPEAT_MAX ? v->min - 1 : v->min;
+        for (int i = 0; i < fixedCount; ++i) {
+            v->node->acceptVisitor(this);
+            r = concat(r, m_node);
+        }
+        if (v->max == REPEAT_MAX) {
+            v->node->acceptVisitor(this);
+            r = concat(r, RegNodePtr(new RegNode_Repeat(1, REPEAT_MAX, v->gready, m_node)));
+        }
+        else {
+            for (int i = v->min; i < v->max; ++i) {
+                v->node->acceptVisitor(this);
+                r = concat(r, RegNodePtr(new RegNode_Repeat(0, 1, v->gready, m_node)));
+            }
+        }
+        m_node = r;
+    }
+    virtual void visit(RegNode_Concat *v)
+    {
+        v->left->acceptVisitor(this);
+        RegNodePtr left = m_node;
+        v->right->acceptVisitor(this);
+        m_node = concat(left, m_node);
+    }
+    virtual void visit(RegNode_Or *v)
+    {
+        v->left->acceptVisitor(this);
+        RegNodePtr left = m_node;
+        v->right->acceptVisitor(this);
+        m_node.reset(new RegNode_Or(left, m_node));
+    }
+private:
+    RegNodePtr concat(const RegNodePtr& left, const RegNodePtr& right)
+    {
+        if (!left) return right;
+        if (m_reverse) return RegNodePtr(new RegNode_Concat(right, left));
+        return RegNodePtr(new RegNode_Concat(left, right));
+    }
+private:
+    bool m_reverse;
+    RegNodePtr m_node;
+};
+
+RegNodeVisitor_Normalizer::RegNodeVisitor_Normalizer(bool reverse):
+    m_impl(new RegNodeVisitor_NormalizerImpl(reverse))
+{ }
+RegNodeVisitor_Normalizer::~RegNodeVisitor_Normalizer()
+{
+    delete m_impl;
+}
+RegNodePtr RegNodeVisitor_Normalizer::apply(RegNodePtr node)
+{
+    return m_impl->apply(node);
+}
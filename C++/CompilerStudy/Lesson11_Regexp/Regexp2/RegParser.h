@@ -97,4 +97,15 @@ private:
     class RegNodeVisitor_LogicPrinterImpl *m_impl;
 };
 
+// deep copy in which x{m,n} is expanded into ?,*,+ repeats, concatenations are swapped when reverse is set
+class RegNodeVisitor_Normalizer
+{
+public:
+    RegNodeVisitor_Normalizer(bool reverse = false);
+    ~RegNodeVisitor_Normalizer();
+    RegNodePtr apply(RegNodePtr node);
+private:
+    class RegNodeVisitor_NormalizerImpl *m_impl;
+};
+
 #endif
@@ -0,0 +1,25 @@
+#ifndef REGEXP_INFO_H
+#define REGEXP_INFO_H
+
+#include <unordered_map>
+
+#include "RegParser.h"
+#include "DynamicBitset.h"
+
+// positions of the regexp, which are its charset nodes, the extra acceptNode ends the regexp
+struct RegexpInfo
+{
+    RegNodePtr rootNode;
+    RegNodePtr acceptNode;
+    std::vector<RegNode_Charset*> ID2Node;
+    std::unordered_map<RegNode_Charset*, int> node2ID;
+    std::vector<DynamicBitset> followNodes;
+    std::unordered_map<IRegNode*, bool> nullable;
+    std::unordered_map<IRegNode*, DynamicBitset> firstNodes;
+    std::unordered_map<IRegNode*, DynamicBitset> lastNodes;
+};
+
+// node should have been normalized, see RegNodeVisitor_Normalizer
+void buildRegexpInfo(RegexpInfo& info, const RegNodePtr& node);
+
+#endif
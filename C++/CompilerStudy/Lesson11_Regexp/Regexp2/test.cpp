@@ -6,6 +6,7 @@
 #include "RegParser.h"
 #include "NFAMatch.h"
 #include "DFAMatch.h"
+#include "LazyDFAMatch.h"
 
 #ifdef _DEBUG
 #define PERF_LOOP 100
@@ -80,6 +81,30 @@ private:
     NFANodePtr m_nfa;
 };
 
+class LazyDFAReg:
+    public IReg
+{
+public:
+    LazyDFAReg(int maxStateCount = 1024): m_maxStateCount(maxStateCount){}
+    bool compile(const std::string& reg)
+    {
+        RegParser parser(reg);
+        return ::compile(m_dfa, parser.getNode(), m_maxStateCount);
+    }
+    bool match(const std::string& src) 
+    {
+        return ::match(m_dfa, src);
+    }
+    bool search(const char *begin, const char *end, const char *&matchBegin, const char *&matchEnd)
+    {
+        return ::search(m_dfa, begin, end, matchBegin, matchEnd);
+    }
+    int getFlushCount() { return m_dfa->forward.getFlushCount();}
+private:
+    int m_maxStateCount;
+    LazyDFAPtr m_dfa;
+};
+
 RegPtr createReg(const std::string& name, const std::string& pattern)
 {
     if (name == "NFA") {
@@ -117,6 +142,11 @@ RegPtr createReg(const std::string& name, const std::string& pattern)
         RegPtr _(p);
         return RegPtr(pd);
     }
+    else if (name == "LazyDFA") {
+        LazyDFAReg *p = new LazyDFAReg();
+        p->compile(pattern);
+        return RegPtr(p);
+    }
     else return RegPtr();
 }
 
@@ -177,14 +207,151 @@ void regTest5(const char* name)
     }
 }
 
+void regTest6(const char* name)
+{
+    RegPtr reg(createReg(name, "(a|b)*a(a|b){3}"));
+    assert(reg->match("abbb"));
+    assert(reg->match("bbbaaab"));
+    assert(!reg->match("bbbab"));
+    assert(!reg->match("abbbb"));
+    assert(!reg->match("aaa"));
+}
+void regTest7(const char* name)
+{
+    RegPtr reg(createReg(name, "a(b?)+c"));
+    assert(reg->match("ac"));
+    assert(reg->match("abbc"));
+    assert(!reg->match("a"));
+    reg = createReg(name, "ab{2,}c");
+    assert(reg->match("abbc"));
+    assert(reg->match("abbbbbc"));
+    assert(!reg->match("abc"));
+    reg = createReg(name, "ab{0}c");
+    assert(reg->match("ac"));
+    assert(!reg->match("abc"));
+}
+
 void test(const char *name)
 {
     void (*funcs[])(const char*) = {
-        &regTest1, &regTest2, &regTest3, &regTest4, &regTest5,
+        &regTest1, &regTest2, &regTest3, &regTest4, &regTest5, &regTest6, &regTest7,
     };
     for (int i = 0; i < sizeof(funcs) / sizeof(funcs[0]); ++i) funcs[i](name);
 }
 
+static std::string searchFirst(LazyDFAReg& reg, const std::string& src)
+{
+    const char *b, *e;
+    if (!reg.search(src.c_str(), src.c_str() + src.size(), b, e)) return "<none>";
+    return std::string(b, e);
+}
+void searchTest()
+{
+    LazyDFAReg reg1;
+    reg1.compile("abcd|c");
+    assert(searchFirst(reg1, "xxabcd") == "abcd");
+    assert(searchFirst(reg1, "xxabce") == "c");
+    assert(searchFirst(reg1, "xxabde") == "<none>");
+    LazyDFAReg reg2;
+    reg2.compile("(a|b)*abb");
+    assert(searchFirst(reg2, "cccaababbzz") == "aababb");
+    assert(searchFirst(reg2, "abbabbc") == "abbabb");
+    LazyDFAReg reg3;
+    reg3.compile("\\d+\\.\\d+");
+    assert(searchFirst(reg3, "v 12.5 and 3.14") == "12.5");
+    assert(searchFirst(reg3, "v 12. and 3.14") == "3.14");
+    LazyDFAReg reg4;
+    reg4.compile("ERROR [\\w_]+");
+    assert(searchFirst(reg4, "INFO ok; ERRO x; ERROR disk_full; ERROR y") == "ERROR disk_full");
+    LazyDFAReg reg5;
+    reg5.compile("a*");
+    assert(searchFirst(reg5, "baa") == "");
+
+    // a tiny cache has to be flushed all the time, but the answers stay the same
+    LazyDFAReg reg6(8);
+    reg6.compile("(a|b)*a(a|b){6}");
+    NFAReg nfa;
+    nfa.compile("(a|b)*a(a|b){6}");
+    std::string src;
+    for (int i = 0; i < 200; ++i) {
+        src.push_back("ab"[(i * 7 + i / 3) % 2]);
+        assert(reg6.match(src) == nfa.match(src));
+    }
+    assert(reg6.getFlushCount() > 0);
+}
+
+static std::string randomString(int len, const char *chars)
+{
+    std::string r;
+    int n = (int)strlen(chars);
+    unsigned seed = 1;
+    for (int i = 0; i < len; ++i) {
+        seed = seed * 1103515245 + 12345;
+        r.push_back(chars[(seed >> 16) % n]);
+    }
+    return r;
+}
+void perfPathological()
+{
+    // the eager DFA of (a|b)*a(a|b){n} has 2^(n+1) states
+    std::string src = randomString(100000, "ab");
+    const char *names[] = {"NFA", "DFA", "LazyDFA",};
+    int ns[] = {4, 8, 12, 20};
+    for (int i = 0; i < sizeof(ns) / sizeof(ns[0]); ++i) {
+        char pattern[64];
+        sprintf(pattern, "(a|b)*a(a|b){%d}", ns[i]);
+        for (int j = 0; j < sizeof(names) / sizeof(names[0]); ++j) {
+            if (ns[i] > 12 && std::string(names[j]) == "DFA") continue;
+            Timer _t(std::string(names[j]) + "," + pattern + ",compile+match 100K");
+            RegPtr reg(createReg(names[j], pattern));
+            reg->match(src);
+        }
+    }
+}
+void perfLog()
+{
+    std::string log;
+    const char *levels[] = {"INFO", "DEBUG", "WARN", "ERROR",};
+    char line[256];
+    for (int i = 0; i < 100000; ++i) {
+        sprintf(line, "2018-02-24 12:%02d:%02d [%s] GET /static/img%d.png from 192.168.%d.%d\n", 
+                i / 60 % 60, i % 60, levels[i % 7 == 0 ? 3 : i % 3], i, i / 256 % 256, i % 256);
+        log += line;
+    }
+    std::vector<std::string> lines;
+    for (size_t begin = 0, end; (end = log.find('\n', begin)) != std::string::npos; begin = end + 1) {
+        lines.push_back(log.substr(begin, end - begin));
+    }
+
+    const char *pattern = ".*\\[ERROR\\] GET .*from 192\\.168\\.\\d+\\.\\d+";
+    const char *names[] = {"NFA", "DFA", "LazyDFA",};
+    for (int j = 0; j < sizeof(names) / sizeof(names[0]); ++j) {
+        RegPtr reg(createReg(names[j], pattern));
+        int n = 0;
+        {
+            Timer _t(std::string(names[j]) + ",match error lines");
+            for (int i = 0; i < (int)lines.size(); ++i) n += reg->match(lines[i]);
+        }
+        printf("\t%d lines\n", n);
+    }
+
+    const char *searchPatterns[] = {"\\[ERROR\\] GET [^\\s]+", "\\d+\\.\\d+\\.\\d+\\.\\d+",};
+    for (int j = 0; j < sizeof(searchPatterns) / sizeof(searchPatterns[0]); ++j) {
+        LazyDFAReg reg;
+        reg.compile(searchPatterns[j]);
+        int n = 0;
+        {
+            Timer _t(std::string("LazyDFA,search all ") + searchPatterns[j]);
+            const char *p = log.c_str(), *end = p + log.size(), *b, *e;
+            while (reg.search(p, end, b, e)) {
+                ++n;
+                p = e > b ? e : b + 1;
+            }
+        }
+        printf("\t%d matches\n", n);
+    }
+}
+
 int main()
 {
     test("NFA");
@@ -192,4 +359,8 @@ int main()
     test("NFA2DFA");
     test("DFAop");
     test("NFA2DFAop");
+    test("LazyDFA");
+    searchTest();
+    perfPathological();
+    perfLog();
 }
@@ -515,6 +515,25 @@ void LALRParser::build()
     }
 }
 
+////////// StaticLRTable
+// row displacement compressed tables generated by yacc.py, see genTables
+struct StaticLRTable
+{
+    // 0 is error, n > 0 shifts to state n - 1, n < 0 reduces product -n - 1
+    static int getAction(int state, int term)
+    {
+        int i = g_lrActionBase[state] + term;
+        if (g_lrActionCheck[i] == state) return g_lrActionValue[i];
+        return g_lrActionDefault[state];
+    }
+    static int getNextState(int state, int product)
+    {
+        int i = g_lrGotoBase[state] + g_lrProductHead[product];
+        ASSERT(g_lrGotoCheck[i] == state);
+        return g_lrGotoValue[i];
+    }
+};
+
 ////////// ParserImpl
 class SyntaxParserImpl
 {
@@ -522,25 +541,31 @@ public:
     SyntaxParserImpl(Scanner *scanner);
     ~SyntaxParserImpl();
     bool parse();
+private:
+    void reserveStack(int top);
 private:
     Scanner *m_scanner;
+    // preallocated, grown only when the parse nests deeper than ever
+    vector<int> m_stateStack;
+    vector<YYSTYPE> m_valueStack;
 };
 SyntaxParserImpl::SyntaxParserImpl(Scanner *scanner):
-    m_scanner(scanner)
+    m_scanner(scanner), m_stateStack(256), m_valueStack(256)
 {
-    LALRParser::instance()->build();
 }
 SyntaxParserImpl::~SyntaxParserImpl()
 {
 }
+void SyntaxParserImpl::reserveStack(int top)
+{
+    if (top < (int)m_stateStack.size()) return;
+    m_stateStack.resize(m_stateStack.size() * 2);
+    m_valueStack.resize(m_valueStack.size() * 2);
+}
 bool SyntaxParserImpl::parse()
 {
-    vector<YYSTYPE> valueStack;
-    vector<int> stateStack;
-    stateStack.push_back(0);
-
-    GotoTable *gotoTable = LALRParser::instance()->getGotoTable();
-    ActionTable* actionTable = LALRParser::instance()->getActionTable();
+    int top = 0;
+    m_stateStack[0] = 0;
 
     bool useLastToken = false;
     Token t;
@@ -554,36 +579,62 @@ bool SyntaxParserImpl::parse()
         }
 
         for (;;) {
-            Action act = actionTable->getAction(stateStack.back(), t.type);
-            if (act.type == Action::T_Shift) {
+            int act = StaticLRTable::getAction(m_stateStack[top], t.type);
+            if (act > 0) {
                 if (t.type == ESS_Term_Begin) { 
-                    stateStack.clear();
+                    top = -1;
                     break;
                 }
-                stateStack.push_back(act.value);
-                valueStack.push_back(yylval);
+                reserveStack(++top);
+                m_stateStack[top] = act - 1;
+                m_valueStack[top] = move(yylval);
                 break;
             }
-            else if (act.type == Action::T_Reduce) {
-                auto& body = getProductBody(act.value);
+            else if (act < 0) {
+                int pid = -act - 1;
+                int bodyLen = g_lrProductBodyLen[pid];
                 YYSTYPE head;
                 g_lrproductionHead = &head;
-                g_lrproductionBody = body.empty() ? &head : &valueStack[valueStack.size() - body.size()];
-                getProductionAction(act.value)();
-                valueStack.erase(valueStack.end() - body.size(), valueStack.end());
-                valueStack.push_back(head);
-                stateStack.erase(stateStack.end() - body.size(), stateStack.end());
-                int nstate = gotoTable->getNextState(stateStack.back(), getProductHead(act.value));
-                stateStack.push_back(nstate);
+                g_lrproductionBody = bodyLen == 0 ? &head : &m_valueStack[top - bodyLen + 1];
+                getProductionAction(pid)();
+                top -= bodyLen;
+                int nstate = StaticLRTable::getNextState(m_stateStack[top], pid);
+                reserveStack(++top);
+                m_stateStack[top] = nstate;
+                m_valueStack[top] = move(head);
             }
             else ASSERT(0);
         }
     }
-    ASSERT(stateStack.empty());
+    ASSERT(top == -1);
 
     return true;
 }
 //////////
+template<typename GetActionT, typename GetNextStateT>
+static bool recognizeTokens(const vector<int>& tokens, GetActionT getAction, GetNextStateT getNextState)
+{
+    vector<int> stateStack(1, 0);
+    for (int i = 0; i <= (int)tokens.size(); ++i) {
+        int term = i < (int)tokens.size() ? tokens[i] : ESS_Term_Begin;
+        for (;;) {
+            int act = getAction(stateStack.back(), term);
+            if (act > 0) {
+                if (term == ESS_Term_Begin) return true;
+                stateStack.push_back(act - 1);
+                break;
+            }
+            else if (act < 0) {
+                int pid = -act - 1;
+                stateStack.resize(stateStack.size() - getProductBody(pid).size());
+                stateStack.push_back(getNextState(stateStack.back(), pid));
+            }
+            else return false;
+        }
+    }
+    return false;
+}
+//////////
 SyntaxParser::SyntaxParser(Scanner *scanner):
     m_impl(new SyntaxParserImpl(scanner))
 {
@@ -596,3 +647,25 @@ bool SyntaxParser::parse()
 {
     return m_impl->parse();
 }
+bool SyntaxParser::recognize(const vector<int>& tokens, bool useRuntimeTables)
+{
+    if (!useRuntimeTables) {
+        return recognizeTokens(tokens, &StaticLRTable::getAction, &StaticLRTable::getNextState);
+    }
+
+    LALRParser *parser = LALRParser::instance();
+    static bool s_built = (parser->build(), true);
+    (void)s_built;
+    ActionTable *actionTable = parser->getActionTable();
+    GotoTable *gotoTable = parser->getGotoTable();
+    return recognizeTokens(tokens, 
+        [actionTable](int state, int term) {
+            Action act = actionTable->getAction(state, term);
+            if (act.type == Action::T_Shift) return act.value + 1;
+            if (act.type == Action::T_Reduce) return -act.value - 1;
+            return 0;
+        },
+        [gotoTable](int state, int pid) {
+            return gotoTable->getNextState(state, getProductHead(pid));
+        });
+}
@@ -9,6 +9,8 @@ public:
     SyntaxParser(Scanner *scanner);
     ~SyntaxParser();
     bool parse();
+    // run the tables over a token stream without semantic actions, the runtime ones are built by LALRParser
+    static bool recognize(const vector<int>& tokens, bool useRuntimeTables);
 private:
     class SyntaxParserImpl *m_impl;
 };
@@ -54,9 +54,39 @@ void syntaxParserTest()
     parser.parse();
 }
 
+void syntaxParserBenchmark()
+{
+    puts("UnitTest----------> syntaxParserBenchmark");
+    vector<int> tokens;
+    {
+        Scanner scanner(readFile("source.js"));
+        Token t;
+        while (scanner.getNext(t)) tokens.push_back(t.type);
+    }
+    vector<int> largeTokens;
+    for (int i = 0; i < 1000; ++i) {
+        largeTokens.insert(largeTokens.end(), tokens.begin(), tokens.end());
+    }
+    cout << "t count :" << largeTokens.size() << endl;
+
+    {
+        Timer _timer("LALR build");
+        ASSERT(SyntaxParser::recognize(vector<int>(), true) == false);
+    }
+    {
+        Timer _timer("runtime tables");
+        ASSERT(SyntaxParser::recognize(largeTokens, true));
+    }
+    {
+        Timer _timer("static compressed tables");
+        ASSERT(SyntaxParser::recognize(largeTokens, false));
+    }
+}
+
 void unitTest()
 {
     // regParserTest();
     // scannerTest();
     // syntaxParserTest();
+    // syntaxParserBenchmark();
 }
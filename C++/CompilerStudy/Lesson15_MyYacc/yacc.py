@@ -298,6 +298,223 @@ class Parser(object):
         self.m_cfile.write('\treturn s_table[productID];\n')
         self.m_cfile.write('}\n')
 
+        symIDs = {}
+        for i, (k, _) in enumerate(sortedTerm):
+            symIDs[k] = 256 + i
+        for i, (k, _) in enumerate(nonTerms):
+            symIDs[k] = (1 << 16) + i
+        self.genTables(productID, productID2Data, productID2Head, symIDs)
+
+    def genTables(self, productCount, productID2Data, productID2Head, symIDs):
+        # LALR(1) tables built like LALRParser::build in SyntaxParser.cpp, emitted row displacement compressed
+        def _symID(sym):
+            if sym.startswith('\''): return ord(sym[1])
+            return symIDs[sym]
+        termEnd = 256 + len(self.m_terms)
+        nonTermBegin = 1 << 16
+        def _isNonTerm(sym): return sym >= nonTermBegin
+        bodies = [[_symID(sym) for sym in productID2Data[pid][:-2]] for pid in range(productCount)]
+        heads = [symIDs[productID2Head[pid]] for pid in range(productCount)]
+        products = {}
+        for pid in range(productCount):
+            products.setdefault(heads[pid], []).append(pid)
+
+        nullable = set()
+        first = dict((nt, set()) for nt in products)
+        changed = True
+        while changed:
+            changed = False
+            for pid in range(productCount):
+                head = heads[pid]
+                allNullable = True
+                for sym in bodies[pid]:
+                    f = first[sym] if _isNonTerm(sym) else set([sym])
+                    if not f.issubset(first[head]):
+                        first[head] |= f
+                        changed = True
+                    if sym not in nullable:
+                        allNullable = False
+                        break
+                if allNullable and head not in nullable:
+                    nullable.add(head)
+                    changed = True
+        def _firstOfSeq(seq):
+            r = set()
+            for sym in seq:
+                if not _isNonTerm(sym):
+                    r.add(sym)
+                    return r
+                r |= first[sym]
+                if sym not in nullable: return r
+            return r
+
+        # LR(0) family, states are identified by kernel items
+        def _closure0(kernel):
+            items = set(kernel)
+            stack = list(kernel)
+            while stack:
+                pid, pos = stack.pop()
+                if pos < len(bodies[pid]) and _isNonTerm(bodies[pid][pos]):
+                    for npid in products[bodies[pid][pos]]:
+                        if (npid, 0) not in items:
+                            items.add((npid, 0))
+                            stack.append((npid, 0))
+            return items
+        kernels = [frozenset([(0, 0)])]
+        kernel2State = {kernels[0]: 0}
+        trans = []
+        state = 0
+        while state < len(kernels):
+            nexts = {}
+            for pid, pos in sorted(_closure0(kernels[state])):
+                if pos < len(bodies[pid]):
+                    nexts.setdefault(bodies[pid][pos], set()).add((pid, pos + 1))
+            m = {}
+            for sym, kernel in sorted(nexts.items()):
+                kernel = frozenset(kernel)
+                if kernel not in kernel2State:
+                    kernel2State[kernel] = len(kernels)
+                    kernels.append(kernel)
+                m[sym] = kernel2State[kernel]
+            trans.append(m)
+            state += 1
+        stateCount = len(kernels)
+
+        # lookaheads: spontaneous generation and propagation, with -1 as the dummy lookahead
+        def _closure1(pid, pos):
+            items = set([(pid, pos, -1)])
+            stack = [(pid, pos, -1)]
+            while stack:
+                pid, pos, la = stack.pop()
+                body = bodies[pid]
+                if pos < len(body) and _isNonTerm(body[pos]):
+                    las = _firstOfSeq(body[pos + 1:] + [la])
+                    for npid in products[body[pos]]:
+                        for nla in las:
+                            if (npid, 0, nla) not in items:
+                                items.add((npid, 0, nla))
+                                stack.append((npid, 0, nla))
+            return items
+        lookaheads = {}
+        propagation = {}
+        for state in range(stateCount):
+            for kpid, kpos in kernels[state]:
+                src = (state, kpid, kpos)
+                for pid, pos, la in _closure1(kpid, kpos):
+                    if pos < len(bodies[pid]):
+                        dst = (trans[state][bodies[pid][pos]], pid, pos + 1)
+                    elif pos == 0:
+                        dst = (state, pid, pos)
+                    else:
+                        continue
+                    if la == -1: propagation.setdefault(src, set()).add(dst)
+                    else: lookaheads.setdefault(dst, set()).add(la)
+        unhandled = set(lookaheads.keys())
+        while unhandled:
+            src = unhandled.pop()
+            for dst in propagation.get(src, ()):
+                las = lookaheads.setdefault(dst, set())
+                if not lookaheads[src].issubset(las):
+                    las |= lookaheads[src]
+                    unhandled.add(dst)
+
+        # actions: 0 is error, n > 0 shifts to state n - 1, n < 0 reduces product -n - 1
+        def _conflictPrior(pid):
+            token = productID2Data[pid][-2]
+            if not token:
+                raise Exception('conflict without precedence - %s' % productID2Head[pid])
+            return token, self.m_terms[token]
+        actions = []
+        for state in range(stateCount):
+            row = {}
+            for sym, nstate in trans[state].items():
+                if not _isNonTerm(sym): row[sym] = nstate + 1
+            reduces = set()
+            for kpid, kpos in kernels[state]:
+                if kpos == len(bodies[kpid]): reduces.add((kpid, kpos))
+            for pid, pos in _closure0(kernels[state]):
+                if pos == 0 and len(bodies[pid]) == 0: reduces.add((pid, pos))
+            for pid, pos in sorted(reduces):
+                for term in lookaheads.get((state, pid, pos), ()):
+                    act = row.get(term, 0)
+                    if act == 0:
+                        row[term] = -pid - 1
+                        continue
+                    sterm, sprop = _conflictPrior(pid)
+                    if act > 0:
+                        shiftPids = [item[0] for item in kernels[act - 1]]
+                        assert len(shiftPids) == 1
+                        dterm, dprop = _conflictPrior(shiftPids[0])
+                        if sterm == dterm:
+                            if sprop['assoc'] == 'l': row[term] = -pid - 1
+                        elif sprop['prior'] > dprop['prior']: row[term] = -pid - 1
+                    else:
+                        dterm, dprop = _conflictPrior(-act - 1)
+                        assert sterm != dterm
+                        if sprop['prior'] > dprop['prior']: row[term] = -pid - 1
+            actions.append(row)
+
+        # the most frequent reduce of a state becomes its default action, which drops most entries
+        defaults = []
+        for row in actions:
+            counts = {}
+            for act in row.values():
+                if act < 0: counts[act] = counts.get(act, 0) + 1
+            default = 0
+            if counts:
+                default = max(sorted(counts.keys()), key = lambda act: counts[act])
+                for term in [term for term, act in row.items() if act == default]:
+                    del row[term]
+            defaults.append(default)
+        gotos = []
+        for state in range(stateCount):
+            gotos.append(dict((sym - nonTermBegin, nstate) for sym, nstate in trans[state].items() if _isNonTerm(sym)))
+
+        def _compress(rows, columnCount):
+            base = [0] * len(rows)
+            check, value = [], []
+            rowIDs = sorted(range(len(rows)), key = lambda i: -len(rows[i]))
+            for i in rowIDs:
+                cols = sorted(rows[i].keys())
+                b = 0
+                while True:
+                    if all(b + c >= len(check) or check[b + c] == -1 for c in cols): break
+                    b += 1
+                need = b + columnCount
+                if len(check) < need:
+                    check.extend([-1] * (need - len(check)))
+                    value.extend([0] * (need - len(value)))
+                for c in cols:
+                    check[b + c] = i
+                    value[b + c] = rows[i][c]
+                base[i] = b
+            return base, check, value
+
+        def _writeArray(name, values):
+            self.m_cfile.write('const int %s[] = {' % name)
+            for i, v in enumerate(values):
+                if i % 16 == 0: self.m_cfile.write('\n\t')
+                self.m_cfile.write('%d, ' % v)
+            self.m_cfile.write('\n};\n')
+        actionBase, actionCheck, actionValue = _compress(actions, termEnd)
+        gotoBase, gotoCheck, gotoValue = _compress(gotos, len(products))
+
+        self.m_hfile.write('#define LR_STATE_COUNT %d\n' % stateCount)
+        for name in ['g_lrActionBase', 'g_lrActionDefault', 'g_lrActionCheck', 'g_lrActionValue',
+                'g_lrGotoBase', 'g_lrGotoCheck', 'g_lrGotoValue', 'g_lrProductHead', 'g_lrProductBodyLen']:
+            self.m_hfile.write('extern const int %s[];\n' % name)
+        self.m_cfile.write('// LALR tables: %d states, %d action + %d goto entries instead of %d dense ones\n' % (
+            stateCount, len(actionCheck), len(gotoCheck), stateCount * (termEnd + len(products))))
+        _writeArray('g_lrActionBase', actionBase)
+        _writeArray('g_lrActionDefault', defaults)
+        _writeArray('g_lrActionCheck', actionCheck)
+        _writeArray('g_lrActionValue', actionValue)
+        _writeArray('g_lrGotoBase', gotoBase)
+        _writeArray('g_lrGotoCheck', gotoCheck)
+        _writeArray('g_lrGotoValue', gotoValue)
+        _writeArray('g_lrProductHead', [head - nonTermBegin for head in heads])
+        _writeArray('g_lrProductBodyLen', [len(body) for body in bodies])
+
 if len(sys.argv) == 1:
     print 'Usage : %s file' % (sys.argv[0])
 else:
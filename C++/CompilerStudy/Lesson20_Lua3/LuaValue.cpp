@@ -9,21 +9,18 @@
 #include "LuaTable.h"
 #include "LuaStack.h"
 
-LuaValue::LuaValue(const char *str):
-    m_type(LVT_String) {
-    m_data.str = LuaVM::instance()->getStringPool()->createString(str);
+LuaValue::LuaValue(const char *str) {
+    m_data.bits = fromPointer(LVT_String, LuaVM::instance()->getStringPool()->createString(str));
 }
-LuaValue::LuaValue(const char *str, int size):
-    m_type(LVT_String) {
-    m_data.str = LuaVM::instance()->getStringPool()->createString(str, size);
+LuaValue::LuaValue(const char *str, int size) {
+    m_data.bits = fromPointer(LVT_String, LuaVM::instance()->getStringPool()->createString(str, size));
 }
 
 void LuaValue::_lessFrom(const LuaValue& l, const LuaValue& r) {
-    if (l.m_type == r.m_type) {
-        m_type = LVT_Boolean;
-        switch (l.m_type) {
-        case LVT_String: m_data.b = l.m_data.str->isContentLess(*r.m_data.str); break;
-        case LVT_Table: *this = meta_lt(l.m_data.table, r); break;
+    if (l.getType() == r.getType()) {
+        switch (l.getType()) {
+        case LVT_String: *this = fromBoolean(l.getString()->isContentLess(*r.getString())); break;
+        case LVT_Table: *this = meta_lt(l.getTable(), r); break;
         default: ASSERT(0);
         }
     } else {
@@ -31,11 +28,10 @@ void LuaValue::_lessFrom(const LuaValue& l, const LuaValue& r) {
     }
 }
 void LuaValue::_lessEqFrom(const LuaValue& l, const LuaValue& r) {
-    if (l.m_type == r.m_type) {
-        m_type = LVT_Boolean;
-        switch (l.m_type) {
-        case LVT_String: m_data.b = l.m_data.str == r.m_data.str || l.m_data.str->isContentLess(*r.m_data.str); break;
-        case LVT_Table: *this = meta_le(l.m_data.table, r); break;
+    if (l.getType() == r.getType()) {
+        switch (l.getType()) {
+        case LVT_String: *this = fromBoolean(l.getString() == r.getString() || l.getString()->isContentLess(*r.getString())); break;
+        case LVT_Table: *this = meta_le(l.getTable(), r); break;
         default: ASSERT(0);
         }
     } else {
@@ -43,34 +39,34 @@ void LuaValue::_lessEqFrom(const LuaValue& l, const LuaValue& r) {
     }
 }
 
-GCObject* LuaValue::gcAccess() const {
-    switch (m_type) {
-        case LVT_String: return m_data.str->gcAccess();
-        case LVT_Table: return m_data.table->gcAccess();
-        case LVT_Function: return m_data.func->gcAccess();
-        case LVT_Stack: return m_data.stack->gcAccess();
+GCObject* LuaValue::_gcAccess() const {
+    switch (getType()) {
+        case LVT_String: return getString()->gcAccess();
+        case LVT_Table: return getTable()->gcAccess();
+        case LVT_Function: return getFunction()->gcAccess();
+        case LVT_Stack: return getStack()->gcAccess();
         default: return NULL;
     }
 }
 
 string LuaValue::toString() const {
-    switch (m_type) {
+    switch (getType()) {
     case LVT_Nil: return "nil";
-    case LVT_Boolean: return m_data.b ? "true" : "false";
+    case LVT_Boolean: return getBoolean() ? "true" : "false";
     case LVT_Number: return m_data.num == int(m_data.num) ? format("%d", int(m_data.num)) : format("%f", m_data.num);
-    case LVT_String: return m_data.str->buf();
-    case LVT_Table: return format("table: %p", m_data.table);
-    case LVT_Function: return format("function: %p", m_data.func);
-    case LVT_Stack: return format("thread: %p", m_data.stack);
-    case LVT_LightUserData: return format("lightuserdata: %p", m_data.lud);
+    case LVT_String: return getString()->buf();
+    case LVT_Table: return format("table: %p", getTable());
+    case LVT_Function: return format("function: %p", getFunction());
+    case LVT_Stack: return format("thread: %p", getStack());
+    case LVT_LightUserData: return format("lightuserdata: %p", getLightUserData());
     default: ASSERT(0);
     }
 }
 
 int LuaValue::getSize() const {
-    switch (m_type) {
-        case LVT_String: return m_data.str->size();
-        case LVT_Table: return m_data.table->size();
+    switch (getType()) {
+        case LVT_String: return getString()->size();
+        case LVT_Table: return getTable()->size();
         default: ASSERT(0);
     }
     return 0;
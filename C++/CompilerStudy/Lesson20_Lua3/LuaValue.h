@@ -27,20 +27,20 @@ enum LuaValueType {
     LVT_Stack,
     LVT_LightUserData,
 };
+// NaN-boxing: a LuaValue is 8 bytes. Numbers are stored as raw IEEE-754 bits;
+// every other type lives in the payload of a negative quiet NaN, tagged by the
+// top 16 bits (0xfff9 ~ 0xffff). The NaNs produced by hardware (0x7ff8.../0xfff8...)
+// never reach the tag space, so a number test is a single unsigned compare.
 class LuaValue {
 public:
-    LuaValue(): m_type(LVT_Nil){}
-    explicit LuaValue(NumberType num): m_type(LVT_Number) { m_data.num = num; }
+    LuaValue() { m_data.bits = NIL_BITS; }
+    explicit LuaValue(NumberType num) { setNumber(num); }
     explicit LuaValue(const char *str);
     LuaValue(const char *str, int size);
-    explicit LuaValue(LuaTable* table): m_type(LVT_Table){ m_data.table = table; }
-    explicit LuaValue(Function* func): m_type(LVT_Function) { m_data.func = func; }
-    explicit LuaValue(LuaStack* stack): m_type(LVT_Stack) { m_data.stack = stack; }
-    explicit LuaValue(LightUserData lud): m_type(LVT_LightUserData) { m_data.lud = lud; }
-    ~LuaValue(){ m_type = LVT_Nil; }
-
-    // LuaValue(const LuaValue& o);
-    // LuaValue& operator = (const LuaValue& o);
+    explicit LuaValue(LuaTable* table) { m_data.bits = fromPointer(LVT_Table, table); }
+    explicit LuaValue(Function* func) { m_data.bits = fromPointer(LVT_Function, func); }
+    explicit LuaValue(LuaStack* stack) { m_data.bits = fromPointer(LVT_Stack, stack); }
+    explicit LuaValue(LightUserData lud) { m_data.bits = fromPointer(LVT_LightUserData, lud); }
 
     void addFrom(const LuaValue& l, const LuaValue& r);
     void subFrom(const LuaValue& l, const LuaValue& r);
@@ -73,22 +73,28 @@ public:
     LuaValue operator / (const LuaValue& o) const;
     LuaValue operator % (const LuaValue& o) const;
 
-    LuaValueType getType() const { return m_type; }
-    bool isTypeOf(LuaValueType t) const { return m_type == t; }
-    bool isNil() const { return m_type == LVT_Nil; }
-    bool getBoolean() const { 
-        if (isTypeOf(LVT_Boolean)) return m_data.b;
-        else if (isNil()) return false;
-        else return true;
+    LuaValueType getType() const { 
+        if (isNumber()) return LVT_Number;
+        int i = int(m_data.bits >> TAG_SHIFT) - TAG_BASE;
+        return LuaValueType(i < LVT_Number ? i : i + 1);
+    }
+    bool isTypeOf(LuaValueType t) const { 
+        if (t == LVT_Number) return isNumber();
+        return (m_data.bits & TAG_MASK) == tagOf(t);
     }
-    NumberType getNumber() const { ASSERT(isTypeOf(LVT_Number)); return m_data.num; }
-    LuaString* getString() const { ASSERT(isTypeOf(LVT_String)); return m_data.str;}
-    LuaTable* getTable() const { ASSERT(isTypeOf(LVT_Table)); return m_data.table; }
-    Function* getFunction() const { ASSERT(isTypeOf(LVT_Function)); return m_data.func;}
-    LuaStack* getStack() const { ASSERT(isTypeOf(LVT_Stack)); return m_data.stack;}
-    LightUserData getLightUserData() const { ASSERT(isTypeOf(LVT_LightUserData)); return m_data.lud; }
+    bool isNil() const { return m_data.bits == NIL_BITS; }
+    bool getBoolean() const { return m_data.bits != NIL_BITS && m_data.bits != FALSE_BITS; }
+    NumberType getNumber() const { ASSERT(isNumber()); return m_data.num; }
+    LuaString* getString() const { ASSERT(isTypeOf(LVT_String)); return (LuaString*)toPointer();}
+    LuaTable* getTable() const { ASSERT(isTypeOf(LVT_Table)); return (LuaTable*)toPointer(); }
+    Function* getFunction() const { ASSERT(isTypeOf(LVT_Function)); return (Function*)toPointer();}
+    LuaStack* getStack() const { ASSERT(isTypeOf(LVT_Stack)); return (LuaStack*)toPointer();}
+    LightUserData getLightUserData() const { ASSERT(isTypeOf(LVT_LightUserData)); return (LightUserData)toPointer(); }
 
-    GCObject* gcAccess() const;
+    // String, Table, Function and Stack have adjacent tags, so the collector 
+    // can skip everything else with one range test.
+    bool isGCObject() const { return m_data.bits >= tagOf(LVT_String) && m_data.bits < tagOf(LVT_LightUserData); }
+    GCObject* gcAccess() const { return isGCObject() ? _gcAccess() : NULL; }
 
     int getHash() const;
     int getSize() const;
@@ -99,23 +105,42 @@ public:
     static LuaValue FALSE;
 
 private:
+    static const int TAG_SHIFT = 48;
+    static const int TAG_BASE = 0xfff9;
+    static const uint64_t TAG_MASK = 0xffff000000000000ULL;
+    static const uint64_t PAYLOAD_MASK = 0x0000ffffffffffffULL;
+    static const uint64_t NAN_BITS = 0x7ff8000000000000ULL;
+    static const uint64_t NIL_BITS = uint64_t(TAG_BASE + LVT_Nil) << TAG_SHIFT;
+    static const uint64_t FALSE_BITS = uint64_t(TAG_BASE + LVT_Boolean) << TAG_SHIFT;
+
+    static uint64_t tagOf(LuaValueType t) {
+        return uint64_t(TAG_BASE + (t < LVT_Number ? t : t - 1)) << TAG_SHIFT;
+    }
+    static uint64_t fromPointer(LuaValueType t, const void *p) {
+        assert((uint64_t(size_t(p)) & ~PAYLOAD_MASK) == 0);
+        return tagOf(t) | uint64_t(size_t(p));
+    }
+    void* toPointer() const { return (void*)size_t(m_data.bits & PAYLOAD_MASK); }
+    bool isNumber() const { return m_data.bits < uint64_t(TAG_BASE) << TAG_SHIFT; }
+    bool isBoolean() const { return (m_data.bits & TAG_MASK) == FALSE_BITS; }
+    // A computed NaN may carry any payload, including one in the tag space
+    void setNumber(NumberType num) {
+        m_data.num = num;
+        if (num != num) m_data.bits = NAN_BITS;
+    }
+
     static LuaValue fromBoolean(bool b) {
-        LuaValue r; r.m_type = LVT_Boolean; r.m_data.b = b;
+        LuaValue r; r.m_data.bits = FALSE_BITS | uint64_t(b);
         return r;
     }
 
+    GCObject* _gcAccess() const;
     void _lessFrom(const LuaValue& l, const LuaValue& r);
     void _lessEqFrom(const LuaValue& l, const LuaValue& r);
 private:
-    LuaValueType m_type;
     union {
-        bool b;
+        uint64_t bits;
         NumberType num;
-        LuaString* str;
-        LuaTable* table;
-        Function* func;
-        LuaStack* stack;
-        LightUserData lud;
     } m_data;
 };
 
@@ -134,8 +159,7 @@ extern LuaValue meta_unm(LuaTable *table);
 FORCE_INLINE void LuaValue::addFrom(const LuaValue& l, const LuaValue& r) {
     if (l.isTypeOf(LVT_Number)) {
         ASSERT(r.isTypeOf(LVT_Number));
-        m_type = LVT_Number;
-        m_data.num = l.m_data.num + r.m_data.num;
+        setNumber(l.m_data.num + r.m_data.num);
     } else {
         *this = meta_add(l.getTable(), r);
     }
@@ -143,8 +167,7 @@ FORCE_INLINE void LuaValue::addFrom(const LuaValue& l, const LuaValue& r) {
 FORCE_INLINE void LuaValue::subFrom(const LuaValue& l, const LuaValue& r) {
     if (l.isTypeOf(LVT_Number)) {
         ASSERT(r.isTypeOf(LVT_Number));
-        m_type = LVT_Number;
-        m_data.num = l.m_data.num - r.m_data.num;
+        setNumber(l.m_data.num - r.m_data.num);
     } else {
         *this = meta_sub(l.getTable(), r);
     }
@@ -152,8 +175,7 @@ FORCE_INLINE void LuaValue::subFrom(const LuaValue& l, const LuaValue& r) {
 FORCE_INLINE void LuaValue::mulFrom(const LuaValue& l, const LuaValue& r) {
     if (l.isTypeOf(LVT_Number)) {
         ASSERT(r.isTypeOf(LVT_Number));
-        m_type = LVT_Number;
-        m_data.num = l.m_data.num * r.m_data.num;
+        setNumber(l.m_data.num * r.m_data.num);
     } else {
         *this = meta_mul(l.getTable(), r);
     }
@@ -161,8 +183,7 @@ FORCE_INLINE void LuaValue::mulFrom(const LuaValue& l, const LuaValue& r) {
 FORCE_INLINE void LuaValue::divFrom(const LuaValue& l, const LuaValue& r) {
     if (l.isTypeOf(LVT_Number)) {
         ASSERT(r.isTypeOf(LVT_Number));
-        m_type = LVT_Number;
-        m_data.num = l.m_data.num / r.m_data.num;
+        setNumber(l.m_data.num / r.m_data.num);
     } else {
         *this = meta_div(l.getTable(), r);
     }
@@ -170,8 +191,7 @@ FORCE_INLINE void LuaValue::divFrom(const LuaValue& l, const LuaValue& r) {
 FORCE_INLINE void LuaValue::modFrom(const LuaValue& l, const LuaValue& r) {
     if (l.isTypeOf(LVT_Number)) {
         ASSERT(r.isTypeOf(LVT_Number));
-        m_type = LVT_Number;
-        m_data.num = ::fmod(l.m_data.num, r.m_data.num);
+        setNumber(::fmod(l.m_data.num, r.m_data.num));
     } else {
         *this = meta_mod(l.getTable(), r);
     }
@@ -179,25 +199,21 @@ FORCE_INLINE void LuaValue::modFrom(const LuaValue& l, const LuaValue& r) {
 FORCE_INLINE void LuaValue::powFrom(const LuaValue& l, const LuaValue& r) {
     if (l.isTypeOf(LVT_Number)) {
         ASSERT(r.isTypeOf(LVT_Number));
-        m_type = LVT_Number;
-        m_data.num = ::pow(l.m_data.num, r.m_data.num);
+        setNumber(::pow(l.m_data.num, r.m_data.num));
     } else {
         *this = meta_pow(l.getTable(), r);
     }
 }
 
 FORCE_INLINE void LuaValue::notFrom(const LuaValue& l) {
-    m_type = LVT_Boolean;
-    m_data.b = !l.getBoolean();
+    m_data.bits = FALSE_BITS | uint64_t(!l.getBoolean());
 }
 FORCE_INLINE void LuaValue::lenFrom(const LuaValue& l) {
-    m_type = LVT_Number;
     m_data.num = l.getSize();
 }
 FORCE_INLINE void LuaValue::minusFrom(const LuaValue& l) {
     if (l.isTypeOf(LVT_Number)) {
-        m_type = LVT_Number;
-        m_data.num = -l.m_data.num;
+        setNumber(-l.m_data.num);
     } else {
         *this = meta_unm(l.getTable());
     }
@@ -206,8 +222,7 @@ FORCE_INLINE void LuaValue::minusFrom(const LuaValue& l) {
 FORCE_INLINE void LuaValue::lessFrom(const LuaValue& l, const LuaValue& r) {
     if (l.isTypeOf(LVT_Number)) {
         ASSERT(r.isTypeOf(LVT_Number));
-        m_type = LVT_Boolean;
-        m_data.b = l.m_data.num < r.m_data.num;
+        m_data.bits = FALSE_BITS | uint64_t(l.m_data.num < r.m_data.num);
     } else {
         _lessFrom(l, r);
     }
@@ -215,8 +230,7 @@ FORCE_INLINE void LuaValue::lessFrom(const LuaValue& l, const LuaValue& r) {
 FORCE_INLINE void LuaValue::lessEqFrom(const LuaValue& l, const LuaValue& r) {
     if (l.isTypeOf(LVT_Number)) {
         ASSERT(r.isTypeOf(LVT_Number));
-        m_type = LVT_Boolean;
-        m_data.b = l.m_data.num <= r.m_data.num;
+        m_data.bits = FALSE_BITS | uint64_t(l.m_data.num <= r.m_data.num);
     } else {
         _lessEqFrom(l, r);
     }
@@ -228,41 +242,24 @@ FORCE_INLINE void LuaValue::greaterEqFrom(const LuaValue& l, const LuaValue& r)
     lessEqFrom(r, l);
 }
 FORCE_INLINE void LuaValue::equalFrom(const LuaValue& l, const LuaValue& r) {
-    m_type = LVT_Boolean;
-    if (l.m_type == r.m_type) {
-        switch (l.m_type) {
-        case LVT_Nil: m_data.b = true; break;
-        case LVT_Boolean: m_data.b = l.m_data.b == r.m_data.b; break;
-        case LVT_Number: m_data.b = l.m_data.num == r.m_data.num; break;
-        case LVT_String: m_data.b = l.m_data.str == r.m_data.str; break;
-        case LVT_Table: *this = meta_eq(l.m_data.table, r); break;
-        case LVT_Function: m_data.b = l.m_data.func == r.m_data.func; break;
-        case LVT_Stack: m_data.b = l.m_data.stack == r.m_data.stack; break;
-        case LVT_LightUserData: m_data.b = l.m_data.lud == r.m_data.lud; break;
-        default: ASSERT(0);
-        }
+    if (l.isNumber() && r.isNumber()) {
+        m_data.bits = FALSE_BITS | uint64_t(l.m_data.num == r.m_data.num);
+    } else if (l.isTypeOf(LVT_Table) && r.isTypeOf(LVT_Table)) {
+        *this = meta_eq(l.getTable(), r);
     } else {
-        m_data.b = false;
+        // Non-number values with different tags or payloads are never equal
+        m_data.bits = FALSE_BITS | uint64_t(l.m_data.bits == r.m_data.bits);
     }
 }
 FORCE_INLINE void LuaValue::nequalFrom(const LuaValue& l, const LuaValue& r) {
     equalFrom(l, r);
-    m_data.b = !m_data.b;
+    m_data.bits = FALSE_BITS | uint64_t(!getBoolean());
 }
 
 inline int LuaValue::getHash() const {
-    switch (m_type) {
-        case LVT_Nil: ASSERT(0);
-        case LVT_Boolean: return (int)hash<bool>()(m_data.b);
-        case LVT_Number: return (int)hash<NumberType>()(m_data.num);
-        case LVT_String: return (int)hash<LuaString*>()(m_data.str);
-        case LVT_Table: return (int)hash<LuaTable*>()(m_data.table);
-        case LVT_Function: return (int)hash<Function*>()(m_data.func);
-        case LVT_Stack: return (int)hash<LuaStack*>()(m_data.stack);
-        case LVT_LightUserData: return (int)hash<LightUserData>()(m_data.lud);
-        default: ASSERT(0);
-    }
-    return 0;
+    ASSERT(!isNil());
+    if (isNumber()) return (int)hash<NumberType>()(m_data.num);
+    return (int)hash<uint64_t>()(m_data.bits);
 }
 
 inline bool LuaValue::operator == (const LuaValue& o) const {
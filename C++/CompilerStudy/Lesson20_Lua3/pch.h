@@ -16,6 +16,8 @@
 
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
 
 #include <algorithm>
 #include <memory>
@@ -35,7 +35,7 @@ struct VarID {
     string toString(FuncMeta *meta) const {
         if (m_id >> 7) {
             auto v = meta->constTable[m_id & 0x3f];
-            if (v.type == JSVT_String) return format("'%s'", v.data.str->buf);
+            if (v.isTypeOf(JSVT_String)) return format("'%s'", v.getString()->buf);
             else return v.toString();
         }
         else return format("l_%d", m_id & 0x3f);
@@ -147,8 +147,7 @@ struct ByteCodeHandler<BC_Not> {
         DECODE_2(BIT_W_VAR_ID, BIT_W_VAR_ID, destID, srcID);
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto src = VarID(srcID).toValue(frame->localConstPtr);
-        dest->data.b = !src->getBoolean();
-        dest->type = JSVT_Boolean;
+        *dest = JSValue::fromBoolean(!src->getBoolean());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_2(BIT_W_VAR_ID, BIT_W_VAR_ID, destID, srcID);
@@ -164,9 +163,8 @@ struct ByteCodeHandler<BC_Len> {
         DECODE_2(BIT_W_VAR_ID, BIT_W_VAR_ID, destID, srcID);
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto src = VarID(srcID).toValue(frame->localConstPtr);
-        ASSERT(src->type == JSVT_Array);
-        dest->data.num = (int)src->data.array->array.size();
-        dest->type = JSVT_Number;
+        ASSERT(src->isTypeOf(JSVT_Array));
+        *dest = JSValue::fromNumber((int)src->getArray()->array.size());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_2(BIT_W_VAR_ID, BIT_W_VAR_ID, destID, srcID);
@@ -182,9 +180,8 @@ struct ByteCodeHandler<BC_Minus> {
         DECODE_2(BIT_W_VAR_ID, BIT_W_VAR_ID, destID, srcID);
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto src = VarID(srcID).toValue(frame->localConstPtr);
-        ASSERT(src->type == JSVT_Number);
-        dest->data.num = -src->data.num;
-        dest->type = JSVT_Number;
+        ASSERT(src->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromNumber(-src->getNumber());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_2(BIT_W_VAR_ID, BIT_W_VAR_ID, destID, srcID);
@@ -233,12 +230,11 @@ struct ByteCodeHandler<BC_Add> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        if (l->type == JSVT_Number) {
-            ASSERT(r->type == JSVT_Number);
-            dest->data.num = l->data.num + r->data.num;
-            dest->type = JSVT_Number;
-        } else if (l->type == JSVT_String) {
-            *dest = JSValue::fromString((string(l->data.str->buf) + r->toString()).c_str());
+        if (l->isTypeOf(JSVT_Number)) {
+            ASSERT(r->isTypeOf(JSVT_Number));
+            *dest = JSValue::fromNumber(l->getNumber() + r->getNumber());
+        } else if (l->isTypeOf(JSVT_String)) {
+            *dest = JSValue::fromString((string(l->getString()->buf) + r->toString()).c_str());
         } else {
             ASSERT(0);
         }
@@ -258,9 +254,8 @@ struct ByteCodeHandler<BC_Sub> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.num = l->data.num - r->data.num;
-        dest->type = JSVT_Number;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromNumber(l->getNumber() - r->getNumber());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -277,9 +272,8 @@ struct ByteCodeHandler<BC_Mul> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.num = l->data.num * r->data.num;
-        dest->type = JSVT_Number;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromNumber(l->getNumber() * r->getNumber());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -296,9 +290,8 @@ struct ByteCodeHandler<BC_Div> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.num = l->data.num / r->data.num;
-        dest->type = JSVT_Number;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromNumber(l->getNumber() / r->getNumber());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -315,9 +308,8 @@ struct ByteCodeHandler<BC_Mod> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.num = ::fmod(l->data.num, r->data.num);
-        dest->type = JSVT_Number;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromNumber(::fmod(l->getNumber(), r->getNumber()));
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -334,9 +326,8 @@ struct ByteCodeHandler<BC_Pow> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.num = ::pow(l->data.num, r->data.num);
-        dest->type = JSVT_Number;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromNumber(::pow(l->getNumber(), r->getNumber()));
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -353,9 +344,8 @@ struct ByteCodeHandler<BC_Less> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.b = l->data.num < r->data.num;
-        dest->type = JSVT_Boolean;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromBoolean(l->getNumber() < r->getNumber());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -372,9 +362,8 @@ struct ByteCodeHandler<BC_LessEq> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.b = l->data.num <= r->data.num;
-        dest->type = JSVT_Boolean;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromBoolean(l->getNumber() <= r->getNumber());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -391,9 +380,8 @@ struct ByteCodeHandler<BC_Greater> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.b = l->data.num > r->data.num;
-        dest->type = JSVT_Boolean;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromBoolean(l->getNumber() > r->getNumber());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -410,9 +398,8 @@ struct ByteCodeHandler<BC_GreaterEq> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.b = l->data.num >= r->data.num;
-        dest->type = JSVT_Boolean;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromBoolean(l->getNumber() >= r->getNumber());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -429,9 +416,8 @@ struct ByteCodeHandler<BC_Equal> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.b = l->data.num == r->data.num;
-        dest->type = JSVT_Boolean;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromBoolean(l->getNumber() == r->getNumber());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -448,9 +434,8 @@ struct ByteCodeHandler<BC_NEqual> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto l = VarID(lID).toValue(frame->localConstPtr);
         auto r = VarID(rID).toValue(frame->localConstPtr);
-        ASSERT(l->type == JSVT_Number && r->type == JSVT_Number);
-        dest->data.b = l->data.num != r->data.num;
-        dest->type = JSVT_Boolean;
+        ASSERT(l->isTypeOf(JSVT_Number) && r->isTypeOf(JSVT_Number));
+        *dest = JSValue::fromBoolean(l->getNumber() != r->getNumber());
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, BIT_W_VAR_ID, destID, lID, rID);
@@ -467,9 +452,9 @@ struct ByteCodeHandler<BC_SetArray> {
         auto array = VarID(arrayID).toValue(frame->localConstPtr);
         auto k = VarID(kID).toValue(frame->localConstPtr);
         auto v = VarID(vID).toValue(frame->localConstPtr);
-        ASSERT(array->type == JSVT_Array && k->type == JSVT_Number);
-        int i = (int)k->data.num;
-        auto &vec = array->data.array->array;
+        ASSERT(array->isTypeOf(JSVT_Array) && k->isTypeOf(JSVT_Number));
+        int i = (int)k->getNumber();
+        auto &vec = array->getArray()->array;
         ASSERT(i >= 0 && i < (int)vec.size());
         vec[i] = *v;
     }
@@ -488,9 +473,9 @@ struct ByteCodeHandler<BC_GetArray> {
         auto dest = VarID(destID).toValue(frame->localConstPtr);
         auto array = VarID(arrayID).toValue(frame->localConstPtr);
         auto k = VarID(kID).toValue(frame->localConstPtr);
-        ASSERT(array->type == JSVT_Array && k->type == JSVT_Number);
-        int i = (int)k->data.num;
-        auto &vec = array->data.array->array;
+        ASSERT(array->isTypeOf(JSVT_Array) && k->isTypeOf(JSVT_Number));
+        int i = (int)k->getNumber();
+        auto &vec = array->getArray()->array;
         ASSERT(i >= 0 && i < (int)vec.size());
         *dest = vec[i];
     }
@@ -552,8 +537,8 @@ struct ByteCodeHandler<BC_Call> {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, 8, funcID, argID, argCount);
         auto func = VarID(funcID).toValue(frame->localConstPtr);
         auto args = VarID(argID).toValue(frame->localConstPtr);
-        ASSERT(func->type == JSVT_Function);
-        func->data.func->callFromVM(args, args + argCount);
+        ASSERT(func->isTypeOf(JSVT_Function));
+        func->getFunction()->callFromVM(args, args + argCount);
     }
     FORCE_INLINE static string disassemble(int code, FuncMeta* meta) {
         DECODE_3(BIT_W_VAR_ID, BIT_W_VAR_ID, 8, funcID, argID, argCount);
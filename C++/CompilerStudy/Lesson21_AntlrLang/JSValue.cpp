@@ -5,30 +5,29 @@
 #include "JSArray.h"
 #include "JSFunction.h"
 
-GCObject* JSValue::gcAccess() const {
-    switch (type) {
-        case JSVT_String: return data.str->gcAccess();
-        case JSVT_Array: return data.array->gcAccess();
-        case JSVT_Function: return data.func->gcAccess();
+GCObject* JSValue::_gcAccess() const {
+    switch (getType()) {
+        case JSVT_String: return getString()->gcAccess();
+        case JSVT_Array: return getArray()->gcAccess();
+        case JSVT_Function: return getFunction()->gcAccess();
         default: return NULL;
     }
 }
 
 JSValue JSValue::fromString(const char *str) {
     JSValue r;
-    r.type = JSVT_String;
-    r.data.str = JSStringManager::instance()->get(str); 
+    r.bits = fromPointer(JSVT_String, JSStringManager::instance()->get(str));
     return r;
 }
 
 string JSValue::toString() const {
-    switch (type) {
+    switch (getType()) {
         case JSVT_Nil: return "nil";
-        case JSVT_Boolean: return data.b ? "true" : "false";
-        case JSVT_Number: return (int)data.num == data.num ? format("%d", (int)data.num) : format("%lf", data.num);
-        case JSVT_String: return data.str->buf;
-        case JSVT_Array: return format("[array %p]", data.array);
-        case JSVT_Function: return format("[function %p]", data.func);
+        case JSVT_Boolean: return getBoolean() ? "true" : "false";
+        case JSVT_Number: return (int)num == num ? format("%d", (int)num) : format("%lf", num);
+        case JSVT_String: return getString()->buf;
+        case JSVT_Array: return format("[array %p]", getArray());
+        case JSVT_Function: return format("[function %p]", getFunction());
         default: ASSERT(0); return "";
     }
 }
@@ -19,68 +19,94 @@ enum JSValueType {
 #undef TRUE
 #undef FALSE
 
+// NaN-boxing: a JSValue is 8 bytes. Numbers are stored as raw IEEE-754 bits,
+// the other types live in the payload of a negative quiet NaN tagged by the top 
+// 16 bits, so every type test is a mask and compare.
 struct JSValue {
-    union {
-        JSString *str;
-        JSArray *array;
-        Function *func;
-        double num;
-        bool b;
-    } data;
-    JSValueType type;
-
-    bool isNil() const { return type == JSVT_Nil; }
-    bool getBoolean() const {
-        if (type == JSVT_Nil || (type == JSVT_Boolean && !data.b)) return false;
-        return true;
+    JSValueType getType() const {
+        if (isNumber()) return JSVT_Number;
+        int i = int(bits >> TAG_SHIFT) - TAG_BASE;
+        return JSValueType(i < JSVT_Number ? i : i + 1);
+    }
+    bool isTypeOf(JSValueType t) const {
+        if (t == JSVT_Number) return isNumber();
+        return (bits & TAG_MASK) == tagOf(t);
     }
-    GCObject* gcAccess() const;
+    bool isNumber() const { return bits < (uint64_t(TAG_BASE) << TAG_SHIFT); }
+    bool isNil() const { return bits == NIL_BITS; }
+    bool getBoolean() const { return bits != NIL_BITS && bits != FALSE_BITS; }
+    double getNumber() const { ASSERT(isNumber()); return num; }
+    JSString* getString() const { ASSERT(isTypeOf(JSVT_String)); return (JSString*)toPointer(); }
+    JSArray* getArray() const { ASSERT(isTypeOf(JSVT_Array)); return (JSArray*)toPointer(); }
+    Function* getFunction() const { ASSERT(isTypeOf(JSVT_Function)); return (Function*)toPointer(); }
+    // String, Array and Function occupy the highest tags
+    bool isGCObject() const { return bits >= tagOf(JSVT_String); }
+    GCObject* gcAccess() const { return isGCObject() ? _gcAccess() : NULL; }
     string toString() const;
 
-    JSValue(): type(JSVT_Nil){}
-    static JSValue fromBoolean(bool b){ JSValue r; r.type = JSVT_Boolean; r.data.b = b;  return r;}
-    static JSValue fromNumber(double num) { JSValue r; r.type = JSVT_Number; r.data.num = num;  return r;}
+    JSValue(): bits(NIL_BITS){}
+    static JSValue fromBoolean(bool b){ JSValue r; r.bits = FALSE_BITS | uint64_t(b);  return r;}
+    static JSValue fromNumber(double num) { 
+        JSValue r; r.num = num;  
+        if (num != num) r.bits = NAN_BITS;
+        return r;
+    }
     static JSValue fromString(const char *str);
-    static JSValue fromArray(JSArray *array) { JSValue r; r.type = JSVT_Array; r.data.array = array;  return r;}
-    static JSValue fromFunction(Function *func) { JSValue r; r.type = JSVT_Function; r.data.func = func;  return r;}
+    static JSValue fromArray(JSArray *array) { JSValue r; r.bits = fromPointer(JSVT_Array, array);  return r;}
+    static JSValue fromFunction(Function *func) { JSValue r; r.bits = fromPointer(JSVT_Function, func);  return r;}
 
     bool operator == (const JSValue& o) const;
     bool operator != (const JSValue& o) const { return !(*this == o);}
+    int getHash() const;
 
     static JSValue NIL;
     static JSValue TRUE;
     static JSValue FALSE;
+
+private:
+    static const int TAG_SHIFT = 48;
+    static const int TAG_BASE = 0xfff9;
+    static const uint64_t TAG_MASK = 0xffff000000000000ULL;
+    static const uint64_t PAYLOAD_MASK = 0x0000ffffffffffffULL;
+    static const uint64_t NAN_BITS = 0x7ff8000000000000ULL;
+    static const uint64_t NIL_BITS = uint64_t(TAG_BASE + JSVT_Nil) << TAG_SHIFT;
+    static const uint64_t FALSE_BITS = uint64_t(TAG_BASE + JSVT_Boolean) << TAG_SHIFT;
+
+    static uint64_t tagOf(JSValueType t) {
+        return uint64_t(TAG_BASE + (t < JSVT_Number ? t : t - 1)) << TAG_SHIFT;
+    }
+    static uint64_t fromPointer(JSValueType t, const void *p) {
+        assert((uint64_t(size_t(p)) & ~PAYLOAD_MASK) == 0);
+        return tagOf(t) | uint64_t(size_t(p));
+    }
+    void* toPointer() const { return (void*)size_t(bits & PAYLOAD_MASK); }
+    GCObject* _gcAccess() const;
+
+private:
+    union {
+        uint64_t bits;
+        double num;
+    };
 };
 
 namespace std {
 template<>
 struct hash<JSValue> {
     int operator () (const JSValue& v) const {
-        switch (v.type) {
-            case JSVT_Nil: ASSERT(0);
-            case JSVT_Boolean: return (int)std::hash<bool>()(v.data.b);
-            case JSVT_Number: return (int)std::hash<double>()(v.data.num);
-            case JSVT_String: return (int)std::hash<JSString*>()(v.data.str);
-            case JSVT_Array: return (int)std::hash<JSArray*>()(v.data.array);
-            case JSVT_Function: return (int)std::hash<Function*>()(v.data.func);
-            default: ASSERT(0);
-        }
-        return 0;
+        return v.getHash();
     }
 };
 }
 
+inline int JSValue::getHash() const {
+    ASSERT(!isNil());
+    if (isNumber()) return (int)std::hash<double>()(num);
+    return (int)std::hash<uint64_t>()(bits);
+}
+
 inline bool JSValue::operator == (const JSValue& o) const {
-    if (type != o.type) return false;
-    switch (type) {
-        case JSVT_Nil: return true;
-        case JSVT_Boolean: return data.b == o.data.b;
-        case JSVT_Number: return data.num == o.data.num;
-        case JSVT_String: return data.str == o.data.str;
-        case JSVT_Array: return data.array == o.data.array;
-        case JSVT_Function: return data.func == o.data.func;
-        default: ASSERT(0);
-    }
+    if (isNumber() && o.isNumber()) return num == o.num;
+    return bits == o.bits;
 }
 
 #endif
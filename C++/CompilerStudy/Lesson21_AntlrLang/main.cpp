@@ -31,8 +31,8 @@ static int buildin_println(JSValue* begin, JSValue *end) {
     return 0;
 }
 static int buildin_format(JSValue *begin, JSValue *end) {
-    ASSERT(end - begin >= 1 && begin->type == JSVT_String);
-    const char *fmt = begin->data.str->buf;
+    ASSERT(end - begin >= 1 && begin->isTypeOf(JSVT_String));
+    const char *fmt = begin->getString()->buf;
     string r, buf;
     int i = 1;
     for (; *fmt; ++fmt) {
@@ -47,9 +47,9 @@ static int buildin_format(JSValue *begin, JSValue *end) {
             if (i + begin < end) v = begin[i];
 
             switch (*fmt) {
-                case 'd': r += format(buf.c_str(), (int)v.data.num); break;
-                case 's': r += format(buf.c_str(), v.data.str->buf); break;
-                case 'f': r += format(buf.c_str(), v.data.num); break;
+                case 'd': r += format(buf.c_str(), (int)v.getNumber()); break;
+                case 's': r += format(buf.c_str(), v.getString()->buf); break;
+                case 'f': r += format(buf.c_str(), v.getNumber()); break;
                 default: ASSERT(0); break;
             }
 
@@ -74,8 +74,8 @@ static int buildin_disassemble(JSValue *begin, JSValue *end) {
     if (end == begin) {
         func = JSVM::instance()->topFrame()->func;
     } else {
-        ASSERT(begin->type == JSVT_Function && begin->data.func->funcType == Function::FT_JS);
-        func = static_cast<JSFunction*>(begin->data.func);
+        ASSERT(begin->isTypeOf(JSVT_Function) && begin->getFunction()->funcType == Function::FT_JS);
+        func = static_cast<JSFunction*>(begin->getFunction());
     }
     disassemble(so, func->meta, 0);
     *begin = JSValue::fromString(so.str().c_str());
@@ -90,8 +90,8 @@ static int buildin_collectgarbage(JSValue *begin, JSValue *end) {
 }
 static int buildin_readfile(JSValue *begin, JSValue *end) {
     ASSERT(end - begin >= 1);
-    ASSERT(begin[0].type == JSVT_String);
-    ifstream fi(begin[0].data.str->buf);
+    ASSERT(begin[0].isTypeOf(JSVT_String));
+    ifstream fi(begin[0].getString()->buf);
     string r;
     for (string line; getline(fi, line); r += line + '\n');
     *begin = JSValue::fromString(r.c_str());
@@ -99,20 +99,20 @@ static int buildin_readfile(JSValue *begin, JSValue *end) {
 }
 static int buildin_writefile(JSValue *begin, JSValue *end) {
     ASSERT(end - begin >= 2);
-    ASSERT(begin[0].type == JSVT_String && begin[1].type == JSVT_String);
-    ofstream(begin[0].data.str->buf) << begin[1].data.str->buf;
+    ASSERT(begin[0].isTypeOf(JSVT_String) && begin[1].isTypeOf(JSVT_String));
+    ofstream(begin[0].getString()->buf) << begin[1].getString()->buf;
     return 0;
 }
 static int buildin_loadfile(JSValue *begin, JSValue *end) {
     ASSERT(end - begin >= 1);
-    ASSERT(begin[0].type == JSVT_String);
-    *begin = loadFile(begin->data.str->buf);
+    ASSERT(begin[0].isTypeOf(JSVT_String));
+    *begin = loadFile(begin->getString()->buf);
     return 1;
 }
 static int buildin_type(JSValue *begin, JSValue *end) {
     ASSERT(end > begin);
     string str;
-    switch (begin->type) {
+    switch (begin->getType()) {
         case JSVT_Nil: str = "nil"; break;
         case JSVT_Boolean: str = "boolean"; break;
         case JSVT_Number: str = "number"; break;
@@ -129,29 +129,29 @@ static int buildin_insert(JSValue *begin, JSValue *end) {
     int pos;
     if (end - begin == 2) {
         array = begin, value = begin + 1;
-        ASSERT(array->type == JSVT_Array);
-        pos = (int)array->data.array->array.size();
+        ASSERT(array->isTypeOf(JSVT_Array));
+        pos = (int)array->getArray()->array.size();
     } else if (end - begin > 2) {
         array = begin, value = begin + 2;
-        ASSERT(array->type == JSVT_Array);
-        ASSERT(begin[1].type == JSVT_Number);
-        pos = (int)begin[1].data.num;
+        ASSERT(array->isTypeOf(JSVT_Array));
+        ASSERT(begin[1].isTypeOf(JSVT_Number));
+        pos = (int)begin[1].getNumber();
     } else {
         ASSERT(0);
     }
-    array->data.array->array.insert(array->data.array->array.begin() + pos, *value);
+    array->getArray()->array.insert(array->getArray()->array.begin() + pos, *value);
     return 0;
 }
 static int buildin_remove(JSValue *begin, JSValue *end) {
     ASSERT(end - begin >= 1);
     JSValue *array = begin;
-    ASSERT(array->type == JSVT_Array);
-    int pos = (int)array->data.array->array.size() - 1;
+    ASSERT(array->isTypeOf(JSVT_Array));
+    int pos = (int)array->getArray()->array.size() - 1;
     if (end - begin > 1) {
-        ASSERT(begin[1].type == JSVT_Number);
-        pos = (int)begin[1].data.num;
+        ASSERT(begin[1].isTypeOf(JSVT_Number));
+        pos = (int)begin[1].getNumber();
     }
-    array->data.array->array.erase(array->data.array->array.begin() + pos);
+    array->getArray()->array.erase(array->getArray()->array.begin() + pos);
     return 0;
 }
 static int buildin_tostring(JSValue *begin, JSValue *end) {
@@ -161,8 +161,8 @@ static int buildin_tostring(JSValue *begin, JSValue *end) {
 }
 static int buildin_srand(JSValue *begin, JSValue *end) {
     ASSERT(end > begin);
-    ASSERT(begin->type == JSVT_Number);
-    ::srand((int)begin->data.num);
+    ASSERT(begin->isTypeOf(JSVT_Number));
+    ::srand((int)begin->getNumber());
     return 0;
 }
 static int buildin_random(JSValue *begin, JSValue *end) {
@@ -197,7 +197,7 @@ static void runFile(int argc, char *argv[]) {
         args.push_back(JSValue::fromString(argv[i]));
     }
     if (args.empty()) args.push_back(JSValue::NIL);
-    loadFile(argv[1]).data.func->callFromC(&args[0], &args[0] + args.size());
+    loadFile(argv[1]).getFunction()->callFromC(&args[0], &args[0] + args.size());
 
     JSVM::destroyInstance();
 }
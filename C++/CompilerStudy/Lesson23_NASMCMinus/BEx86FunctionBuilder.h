@@ -173,9 +173,12 @@ public:
 
     void endBuild();
 
-private:
+    // for back ends which allocate registers by themselves
     void pushInstruction(const BEx86Instruction &ins);
     int getStackAlignmentFix(int n);
+    BEx86BasicBlock* getRetBasicBlock() { return m_retBasicBlock; }
+
+private:
 
     BERegister* findLFURegister(int excludeRegFlags); // find least frequently use register
     BERegister* makeRegisterFree(BERegister *reg);
@@ -326,23 +326,28 @@ static void encodeInstruction_SUB(ExecMemoryStream *out, ia32_InstructionOperand
         ASSERT(0);
     }
 }
+static void encodeInstruction_PUSH(ExecMemoryStream *out, ia32_InstructionOperand to, ia32_InstructionOperand from);
+static void encodeInstruction_POP(ExecMemoryStream *out, ia32_InstructionOperand to, ia32_InstructionOperand from);
+// always the two operand IMUL r32, r/m32 (or r32, r/m32, imm32); a memory destination goes
+// through a scratch register, saved on the stack since the caller may have it live
 static void encodeInstruction_MUL(ExecMemoryStream *out, ia32_InstructionOperand to, ia32_InstructionOperand from) {
-    if (from.type == ia32_AT_Register && to.type == ia32_AT_Register && from.reg == x86RT_EAX) {
-        BitOutStream(out).push("1111 0111 1110 1").push(reg2BitString(to.reg));
-    } else if (from.type == ia32_AT_Register && isMemoryAddressType(to.type) && from.reg == x86RT_EAX) {
-        BitOutStream(out).push("1111 0111");
-        encodeMemoryWithModRM(out, "101", to);
-    } else if (from.type == ia32_AT_Register && to.type == ia32_AT_Register) {
-        BitOutStream(out).push("0000 1111 1010 1111 11").push(reg2BitString(from.reg)).push(reg2BitString(to.reg));
-    } else if (from.type == ia32_AT_Register && isMemoryAddressType(to.type)) {
+    if (from.type == ia32_AT_Register && to.type == ia32_AT_Register) {
+        BitOutStream(out).push("0000 1111 1010 1111 11").push(reg2BitString(to.reg)).push(reg2BitString(from.reg));
+    } else if (isMemoryAddressType(from.type) && to.type == ia32_AT_Register) {
         BitOutStream(out).push("0000 1111 1010 1111");
-        encodeMemoryWithModRM(out, reg2BitString(from.reg), to);
+        encodeMemoryWithModRM(out, reg2BitString(to.reg), from);
     } else if (from.type == ia32_AT_Immediate32 && to.type == ia32_AT_Register) {
         BitOutStream(out).push("0110 1001 11").push(reg2BitString(to.reg)).push(reg2BitString(to.reg));
         out->pushInt32(from.displacement);
-    } else if (isMemoryAddressType(from.type) && to.type == ia32_AT_Register) {
-        BitOutStream(out).push("0000 1111 1010 1111");
-        encodeMemoryWithModRM(out, reg2BitString(to.reg), from);
+    } else if (isMemoryAddressType(to.type)) {
+        // memory operands are [ebp+n] or absolute, so the push doesn't move them
+        ia32_InstructionOperand scratch = {ia32_AT_Register, x86RT_EAX, 0};
+        if (from.type == ia32_AT_Register && from.reg == x86RT_EAX) scratch.reg = x86RT_ECX;
+        encodeInstruction_PUSH(out, scratch, ia32_InstructionOperand());
+        encodeInstruction_MOV(out, scratch, to);
+        encodeInstruction_MUL(out, scratch, from);
+        encodeInstruction_MOV(out, to, scratch);
+        encodeInstruction_POP(out, scratch, ia32_InstructionOperand());
     } else {
         ASSERT(0);
     }
@@ -0,0 +1,637 @@
+#include "pch.h"
+#include "BESymbolTable.h"
+#include "BEType.h"
+#include "BEConstant.h"
+#include "BEStorage.h"
+#include "BEx86SSACodeGenerator.h"
+#include "BEx86FileBuilder.h"
+#include "BEx86FunctionBuilder.h"
+#include "SourceFileProto.h"
+#include "SSA.h"
+#include "SSABuilder.h"
+#include "SSAOptimizer.h"
+
+/*
+   The SSA is lowered to a two address like IR on virtual registers first: phis become copies at the end of
+   the preds (critical edges are split before), constants become immediates, and a compare only used by the
+   following conditional jump is fused into it.
+   Then Chaitin-Briggs optimistic coloring assigns ECX, EBX, ESI, EDI. EAX and EDX are kept as scratch
+   registers, so a spilled value is simply used from its stack slot.
+ * */
+struct LIROperand {
+    int vreg;
+    BEConstant *constant;
+    LIROperand(int _vreg): vreg(_vreg), constant(NULL){}
+    LIROperand(BEConstant *_constant): vreg(-1), constant(_constant){}
+};
+struct LIRInstruction {
+    SSAOpCode op; // SSAOC_Copy for moves
+    int def;
+    vector<LIROperand> uses;
+    BESymbol *symbol;
+    SSAOpCode cmpOp; // for SSAOC_CJmp: jump to succs[0] if (uses[0] cmpOp uses[1])
+    LIRInstruction(SSAOpCode _op, int _def = -1): op(_op), def(_def), symbol(NULL), cmpOp(SSAOC_Ne){}
+};
+struct LIRBasicBlock {
+    SSABasicBlock *ssaBlock;
+    BEx86BasicBlock *x86Block;
+    vector<LIRInstruction> instructions;
+    vector<int> succs;
+    set<int> liveIn, liveOut;
+};
+struct VirtualRegister {
+    BESymbol *argSymbol;
+    BESymbol *home; // the stack slot if spilled
+    int color; // register type, -1 if spilled
+    bool crossesCall;
+    double spillCost;
+    set<int> neighbors;
+    vector<int> copyPartners;
+    VirtualRegister(): argSymbol(NULL), home(NULL), color(-1), crossesCall(false), spillCost(0){}
+};
+
+static const BEx86RegisterType ALLOCATABLE_REGISTERS[] = {x86RT_ECX, x86RT_EBX, x86RT_ESI, x86RT_EDI};
+static const int ALLOCATABLE_REGISTER_COUNT = 4;
+// the callee may change ECX, EAX and EDX, see BEx86FunctionBuilder::endBuild
+static bool isCalleeSaved(int regType) {
+    return regType == x86RT_EBX || regType == x86RT_ESI || regType == x86RT_EDI;
+}
+
+class BEx86SSAFunctionLowering {
+public:
+    BEx86SSAFunctionLowering(BEx86FunctionBuilder *builder, SSAFunction *func, SSAOptimizeStats *stats):
+        m_builder(builder), m_pool(builder->getParent()->getConstantPool()), m_divisorSlot(NULL) {
+        func->splitCriticalEdges();
+        func->computeDominators();
+        func->computeLoopDepth();
+
+        lower(func);
+        computeLiveness();
+        buildInterferenceGraph();
+        colorGraph();
+
+        m_builder->beginScope();
+        emit();
+        m_builder->endScope();
+
+        if (stats != NULL) {
+            stats->vregCount += (int)m_vregs.size();
+            for (auto &vreg : m_vregs) {
+                if (vreg.color == -1) ++stats->spillCount;
+            }
+        }
+    }
+private:
+    int createVReg(SSAInstruction *ins) {
+        int vreg = (int)m_vregs.size();
+        m_vregs.push_back(VirtualRegister());
+        if (ins != NULL) m_ssa2VReg[ins] = vreg;
+        return vreg;
+    }
+    LIROperand getOperand(SSAInstruction *ins) {
+        if (ins->op == SSAOC_Const) return LIROperand(ins->constant);
+        auto iter = m_ssa2VReg.find(ins);
+        ASSERT(iter != m_ssa2VReg.end());
+        return LIROperand(iter->second);
+    }
+
+    void lower(SSAFunction *func) {
+        auto users = func->computeUsers();
+        map<SSABasicBlock*, int> blockIndexs;
+        for (auto block : func->getBasicBlocks()) {
+            blockIndexs[block] = (int)m_blocks.size();
+            m_blocks.push_back(LIRBasicBlock());
+            m_blocks.back().ssaBlock = block;
+            m_blocks.back().x86Block = m_builder->createBasicBlock(block->name);
+            for (auto ins : block->instructions) {
+                if (!ins->hasValue() || ins->op == SSAOC_Const) continue;
+                if (ins->op == SSAOC_Call && users[ins].empty()) continue;
+                createVReg(ins);
+            }
+        }
+
+        set<SSAInstruction*> fusedCompares;
+        for (auto &lblock : m_blocks) {
+            SSABasicBlock *block = lblock.ssaBlock;
+            for (auto succ : block->succs) lblock.succs.push_back(blockIndexs[succ]);
+
+            SSAInstruction *cjmp = block->getTerminator();
+            if (cjmp != NULL && cjmp->op == SSAOC_CJmp) {
+                SSAInstruction *cond = cjmp->operands[0];
+                if (cond->isCompare() && cond->block == block && users[cond].size() == 1) fusedCompares.insert(cond);
+            }
+
+            for (auto ins : block->instructions) {
+                if (fusedCompares.count(ins) > 0) continue;
+                switch (ins->op) {
+                    case SSAOC_Const:
+                    case SSAOC_Phi:
+                        break;
+                    case SSAOC_Arg: {
+                            LIRInstruction lins(SSAOC_Arg, m_ssa2VReg[ins]);
+                            lins.symbol = ins->symbol;
+                            m_vregs[lins.def].argSymbol = ins->symbol;
+                            lblock.instructions.push_back(lins);
+                        }
+                        break;
+                    case SSAOC_LoadGlobal: {
+                            LIRInstruction lins(SSAOC_LoadGlobal, m_ssa2VReg[ins]);
+                            lins.symbol = ins->symbol;
+                            lblock.instructions.push_back(lins);
+                        }
+                        break;
+                    case SSAOC_StoreGlobal: {
+                            LIRInstruction lins(SSAOC_StoreGlobal);
+                            lins.symbol = ins->symbol;
+                            lins.uses.push_back(getOperand(ins->operands[0]));
+                            lblock.instructions.push_back(lins);
+                        }
+                        break;
+                    case SSAOC_Call: {
+                            auto iter = m_ssa2VReg.find(ins);
+                            LIRInstruction lins(SSAOC_Call, iter == m_ssa2VReg.end() ? -1 : iter->second);
+                            lins.symbol = ins->symbol;
+                            for (auto operand : ins->operands) lins.uses.push_back(getOperand(operand));
+                            lblock.instructions.push_back(lins);
+                        }
+                        break;
+                    case SSAOC_Jmp:
+                        lowerPhiCopies(lblock, block);
+                        lblock.instructions.push_back(LIRInstruction(SSAOC_Jmp));
+                        break;
+                    case SSAOC_CJmp: {
+                            LIRInstruction lins(SSAOC_CJmp);
+                            SSAInstruction *cond = ins->operands[0];
+                            if (fusedCompares.count(cond) > 0) {
+                                lins.cmpOp = cond->op;
+                                lins.uses.push_back(getOperand(cond->operands[0]));
+                                lins.uses.push_back(getOperand(cond->operands[1]));
+                            } else {
+                                lins.uses.push_back(getOperand(cond));
+                                lins.uses.push_back(LIROperand(m_pool->get(0)));
+                            }
+                            lblock.instructions.push_back(lins);
+                        }
+                        break;
+                    case SSAOC_Ret: {
+                            LIRInstruction lins(SSAOC_Ret);
+                            if (!ins->operands.empty()) lins.uses.push_back(getOperand(ins->operands[0]));
+                            lblock.instructions.push_back(lins);
+                        }
+                        break;
+                    default: {
+                            LIRInstruction lins(ins->op, m_ssa2VReg[ins]);
+                            for (auto operand : ins->operands) lins.uses.push_back(getOperand(operand));
+                            lblock.instructions.push_back(lins);
+                        }
+                        break;
+                }
+            }
+        }
+    }
+    void lowerPhiCopies(LIRBasicBlock &lblock, SSABasicBlock *block) {
+        SSABasicBlock *succ = block->succs[0];
+        int predIndex = block->getEdgePredIndex(0);
+        vector<pair<int, LIROperand> > copies;
+        set<int> dests;
+        for (auto ins : succ->instructions) {
+            if (ins->op != SSAOC_Phi) break;
+            LIROperand src = getOperand(ins->operands[predIndex]);
+            int dest = m_ssa2VReg[ins];
+            if (src.vreg == dest) continue;
+            copies.push_back(make_pair(dest, src));
+            dests.insert(dest);
+        }
+
+        bool isParallel = false;
+        for (auto &copy : copies) {
+            if (copy.second.vreg != -1 && dests.count(copy.second.vreg) > 0) isParallel = true;
+        }
+        if (isParallel) {
+            // the phis read their operands at the same time, read all of them before any write
+            for (auto &copy : copies) {
+                if (copy.second.vreg == -1) continue;
+                LIRInstruction lins(SSAOC_Copy, createVReg(NULL));
+                lins.uses.push_back(copy.second);
+                lblock.instructions.push_back(lins);
+                copy.second = LIROperand(lins.def);
+            }
+        }
+        for (auto &copy : copies) {
+            LIRInstruction lins(SSAOC_Copy, copy.first);
+            lins.uses.push_back(copy.second);
+            lblock.instructions.push_back(lins);
+        }
+    }
+
+    void computeLiveness() {
+        vector<set<int> > uses(m_blocks.size()), defs(m_blocks.size());
+        for (int i = 0; i < (int)m_blocks.size(); ++i) {
+            for (auto &ins : m_blocks[i].instructions) {
+                for (auto &use : ins.uses) {
+                    if (use.vreg != -1 && defs[i].count(use.vreg) == 0) uses[i].insert(use.vreg);
+                }
+                if (ins.def != -1) defs[i].insert(ins.def);
+            }
+        }
+        for (bool changed = true; changed; ) {
+            changed = false;
+            for (int i = (int)m_blocks.size() - 1; i >= 0; --i) {
+                LIRBasicBlock &block = m_blocks[i];
+                for (auto succ : block.succs) block.liveOut.insert(m_blocks[succ].liveIn.begin(), m_blocks[succ].liveIn.end());
+                set<int> liveIn(uses[i]);
+                for (auto vreg : block.liveOut) {
+                    if (defs[i].count(vreg) == 0) liveIn.insert(vreg);
+                }
+                if (liveIn.size() != block.liveIn.size()) {
+                    block.liveIn.swap(liveIn);
+                    changed = true;
+                }
+            }
+        }
+    }
+    void buildInterferenceGraph() {
+        for (auto &block : m_blocks) {
+            double weight = 1;
+            for (int i = 0; i < min(block.ssaBlock->loopDepth, 6); ++i) weight *= 10;
+
+            set<int> live(block.liveOut);
+            for (auto iter = block.instructions.rbegin(); iter != block.instructions.rend(); ++iter) {
+                LIRInstruction &ins = *iter;
+                if (ins.def != -1) {
+                    int copySrc = ins.op == SSAOC_Copy ? ins.uses[0].vreg : -1;
+                    for (auto vreg : live) {
+                        // a copy doesn't make its dest and source interfere, so they can be coalesced
+                        if (vreg == ins.def || vreg == copySrc) continue;
+                        m_vregs[vreg].neighbors.insert(ins.def);
+                        m_vregs[ins.def].neighbors.insert(vreg);
+                    }
+                    if (copySrc != -1) {
+                        m_vregs[copySrc].copyPartners.push_back(ins.def);
+                        m_vregs[ins.def].copyPartners.push_back(copySrc);
+                    }
+                    m_vregs[ins.def].spillCost += weight;
+                    live.erase(ins.def);
+                }
+                if (ins.op == SSAOC_Call) {
+                    for (auto vreg : live) m_vregs[vreg].crossesCall = true;
+                }
+                for (auto &use : ins.uses) {
+                    if (use.vreg == -1) continue;
+                    m_vregs[use.vreg].spillCost += weight;
+                    live.insert(use.vreg);
+                }
+            }
+        }
+    }
+    int getAvailableColorCount(int vreg) {
+        return m_vregs[vreg].crossesCall ? ALLOCATABLE_REGISTER_COUNT - 1 : ALLOCATABLE_REGISTER_COUNT;
+    }
+    void colorGraph() {
+        int n = (int)m_vregs.size();
+        vector<int> degrees(n), stack;
+        vector<bool> removed(n, false);
+        for (int i = 0; i < n; ++i) degrees[i] = (int)m_vregs[i].neighbors.size();
+
+        for (int left = n; left > 0; --left) {
+            int picked = -1;
+            for (int i = 0; i < n && picked == -1; ++i) {
+                if (!removed[i] && degrees[i] < getAvailableColorCount(i)) picked = i;
+            }
+            if (picked == -1) {
+                // optimistic: it may still get a color if its neighbors share some
+                double minCost = 0;
+                for (int i = 0; i < n; ++i) {
+                    if (removed[i]) continue;
+                    double cost = m_vregs[i].spillCost / (degrees[i] + 1);
+                    if (picked == -1 || cost < minCost) picked = i, minCost = cost;
+                }
+            }
+            removed[picked] = true;
+            stack.push_back(picked);
+            for (auto neighbor : m_vregs[picked].neighbors) --degrees[neighbor];
+        }
+
+        for (auto iter = stack.rbegin(); iter != stack.rend(); ++iter) {
+            VirtualRegister &vreg = m_vregs[*iter];
+            set<int> usedColors;
+            for (auto neighbor : vreg.neighbors) {
+                if (m_vregs[neighbor].color != -1) usedColors.insert(m_vregs[neighbor].color);
+            }
+            auto isAvailable = [&](int color) {
+                return usedColors.count(color) == 0 && (!vreg.crossesCall || isCalleeSaved(color));
+            };
+            for (auto partner : vreg.copyPartners) {
+                int color = m_vregs[partner].color;
+                if (color != -1 && isAvailable(color)) {
+                    vreg.color = color;
+                    break;
+                }
+            }
+            for (int i = 0; i < ALLOCATABLE_REGISTER_COUNT && vreg.color == -1; ++i) {
+                if (isAvailable(ALLOCATABLE_REGISTERS[i])) vreg.color = ALLOCATABLE_REGISTERS[i];
+            }
+        }
+    }
+
+private:
+    struct Location {
+        int reg;
+        BESymbol *mem;
+        BEConstant *imm;
+        Location(): reg(-1), mem(NULL), imm(NULL){}
+        bool operator == (const Location &o) const { return reg == o.reg && mem == o.mem && imm == o.imm; }
+        bool isMemory() const { return mem != NULL; }
+        bool isImmediate() const { return imm != NULL; }
+    };
+    Location getRegisterLocation(int regType) {
+        Location r;
+        r.reg = regType;
+        return r;
+    }
+    Location getLocation(const LIROperand &operand) {
+        Location r;
+        if (operand.vreg == -1) {
+            r.imm = operand.constant;
+        } else {
+            VirtualRegister &vreg = m_vregs[operand.vreg];
+            if (vreg.color != -1) r.reg = vreg.color;
+            else r.mem = vreg.home;
+        }
+        return r;
+    }
+    Location getLocation(int vreg) {
+        return getLocation(LIROperand(vreg));
+    }
+    BEx86Operand toOperand(const Location &loc) {
+        if (loc.reg != -1) return BEx86Operand(m_builder->getRegister(loc.reg));
+        if (loc.mem != NULL) return BEx86Operand(loc.mem);
+        return BEx86Operand(loc.imm);
+    }
+    void pushInstruction(BEx86InstructionType type, const Location &a) {
+        m_builder->pushInstruction(BEx86Instruction(type, toOperand(a)));
+    }
+    void pushInstruction(BEx86InstructionType type, const Location &a, const Location &b) {
+        m_builder->pushInstruction(BEx86Instruction(type, toOperand(a), toOperand(b)));
+    }
+    void pushJmp(BEx86InstructionType type, BEx86BasicBlock *target) {
+        m_builder->pushInstruction(BEx86Instruction(type, target));
+    }
+    void pushMove(const Location &dest, const Location &src) {
+        if (dest == src) return;
+        if (dest.isMemory() && src.isMemory()) {
+            Location eax = getRegisterLocation(x86RT_EAX);
+            pushInstruction(x86IT_MOV, eax, src);
+            pushInstruction(x86IT_MOV, dest, eax);
+        } else {
+            pushInstruction(x86IT_MOV, dest, src);
+        }
+    }
+
+    void emit() {
+        const BEType *intType = BETypeManager::instance()->get("int");
+        for (int i = 0; i < (int)m_vregs.size(); ++i) {
+            VirtualRegister &vreg = m_vregs[i];
+            if (vreg.color != -1) {
+                m_builder->getRegister(vreg.color)->isWritten |= isCalleeSaved(vreg.color);
+            } else if (vreg.argSymbol != NULL) {
+                vreg.home = vreg.argSymbol;
+            } else {
+                vreg.home = m_builder->getTopLocalSymbolTable()->declare(format("spill_%d", i), intType);
+            }
+        }
+
+        for (int i = 0; i < (int)m_blocks.size(); ++i) {
+            m_builder->pushBasicBlock(m_blocks[i].x86Block);
+            m_nextBlock = i + 1 < (int)m_blocks.size() ? m_blocks[i + 1].x86Block : m_builder->getRetBasicBlock();
+            for (auto &ins : m_blocks[i].instructions) emitInstruction(m_blocks[i], ins);
+        }
+    }
+    void emitInstruction(LIRBasicBlock &block, LIRInstruction &ins) {
+        Location eax = getRegisterLocation(x86RT_EAX);
+        switch (ins.op) {
+            case SSAOC_Arg:
+                if (m_vregs[ins.def].color != -1) pushInstruction(x86IT_MOV, getLocation(ins.def), getArgLocation(ins.symbol));
+                break;
+            case SSAOC_LoadGlobal: {
+                    Location dest = getLocation(ins.def), global;
+                    global.mem = ins.symbol;
+                    if (dest.isMemory()) {
+                        pushInstruction(x86IT_MOV, eax, global);
+                        pushInstruction(x86IT_MOV, dest, eax);
+                    } else {
+                        pushInstruction(x86IT_MOV, dest, global);
+                    }
+                }
+                break;
+            case SSAOC_StoreGlobal: {
+                    Location global;
+                    global.mem = ins.symbol;
+                    pushMove(global, getLocation(ins.uses[0]));
+                }
+                break;
+            case SSAOC_Copy:
+                pushMove(getLocation(ins.def), getLocation(ins.uses[0]));
+                break;
+            case SSAOC_Add:
+            case SSAOC_Sub:
+            case SSAOC_Mul:
+            case SSAOC_Sal:
+            case SSAOC_Sar:
+            case SSAOC_And:
+            case SSAOC_Or:
+                emitArithmetic(ins);
+                break;
+            case SSAOC_Div:
+            case SSAOC_Mod: {
+                    Location edx = getRegisterLocation(x86RT_EDX), divisor = getLocation(ins.uses[1]);
+                    pushMove(eax, getLocation(ins.uses[0]));
+                    if (divisor.isImmediate()) {
+                        Location slot;
+                        slot.mem = getDivisorSlot();
+                        pushInstruction(x86IT_MOV, slot, divisor);
+                        divisor = slot;
+                    }
+                    pushInstruction(x86IT_XOR, edx, edx);
+                    pushInstruction(x86IT_DIV, divisor);
+                    pushMove(getLocation(ins.def), ins.op == SSAOC_Div ? eax : edx);
+                }
+                break;
+            case SSAOC_Lt:
+            case SSAOC_Le:
+            case SSAOC_Gt:
+            case SSAOC_Ge:
+            case SSAOC_Eq:
+            case SSAOC_Ne: {
+                    BEx86InstructionType jcc = emitCompare(ins.op, ins.uses[0], ins.uses[1]);
+                    BEx86BasicBlock *setBlock = m_builder->createBasicBlock("label_compare_set");
+                    pushInstruction(x86IT_MOV, eax, getImmediate(1));
+                    pushJmp(jcc, setBlock);
+                    pushInstruction(x86IT_MOV, eax, getImmediate(0));
+                    m_builder->pushBasicBlock(setBlock);
+                    pushMove(getLocation(ins.def), eax);
+                }
+                break;
+            case SSAOC_Call: {
+                    int n = (int)ins.uses.size();
+                    int stackFix = m_builder->getStackAlignmentFix(n * 4);
+                    Location esp = getRegisterLocation(x86RT_ESP);
+                    if (stackFix > 0) pushInstruction(x86IT_SUB, esp, getImmediate(stackFix));
+                    for (int i = n - 1; i >= 0; --i) pushInstruction(x86IT_PUSH, getLocation(ins.uses[i]));
+                    m_builder->pushInstruction(BEx86Instruction(x86IT_CALL, ins.symbol));
+                    if (n * 4 + stackFix > 0) pushInstruction(x86IT_ADD, esp, getImmediate(n * 4 + stackFix));
+                    if (ins.def != -1) pushMove(getLocation(ins.def), eax);
+                }
+                break;
+            case SSAOC_Jmp: {
+                    BEx86BasicBlock *target = m_blocks[block.succs[0]].x86Block;
+                    if (target != m_nextBlock) pushJmp(x86IT_JMP, target);
+                }
+                break;
+            case SSAOC_CJmp: {
+                    BEx86InstructionType jcc = emitCompare(ins.cmpOp, ins.uses[0], ins.uses[1]);
+                    BEx86BasicBlock *trueBlock = m_blocks[block.succs[0]].x86Block;
+                    BEx86BasicBlock *falseBlock = m_blocks[block.succs[1]].x86Block;
+                    if (trueBlock == m_nextBlock) {
+                        pushJmp(getInverseJmp(jcc), falseBlock);
+                    } else {
+                        pushJmp(jcc, trueBlock);
+                        if (falseBlock != m_nextBlock) pushJmp(x86IT_JMP, falseBlock);
+                    }
+                }
+                break;
+            case SSAOC_Ret:
+                if (!ins.uses.empty()) pushMove(eax, getLocation(ins.uses[0]));
+                if (m_builder->getRetBasicBlock() != m_nextBlock) pushJmp(x86IT_JMP, m_builder->getRetBasicBlock());
+                break;
+            default: ASSERT(0); break;
+        }
+    }
+    void emitArithmetic(LIRInstruction &ins) {
+        BEx86InstructionType type = x86IT_ADD;
+        switch (ins.op) {
+            case SSAOC_Add: type = x86IT_ADD; break;
+            case SSAOC_Sub: type = x86IT_SUB; break;
+            case SSAOC_Mul: type = x86IT_MUL; break;
+            case SSAOC_Sal: type = x86IT_SAL; break;
+            case SSAOC_Sar: type = x86IT_SAR; break;
+            case SSAOC_And: type = x86IT_AND; break;
+            case SSAOC_Or: type = x86IT_OR; break;
+            default: ASSERT(0); break;
+        }
+        Location dest = getLocation(ins.def), a = getLocation(ins.uses[0]), b = getLocation(ins.uses[1]);
+        bool isCommutative = type == x86IT_ADD || type == x86IT_MUL || type == x86IT_AND || type == x86IT_OR;
+        if (isCommutative && (dest == b || a.isImmediate()) && !(dest == a)) swap(a, b);
+        if (type == x86IT_SAL || type == x86IT_SAR) {
+            ASSERT(b.isImmediate());
+        }
+
+        // two address form: dest = a; dest op= b, unless that would overwrite b first, or dest is in memory
+        bool throughEAX = dest.isMemory() || (dest == b && !(dest == a));
+        Location r = throughEAX ? getRegisterLocation(x86RT_EAX) : dest;
+        pushMove(r, a);
+        int n = b.isImmediate() ? getImmediateInt(b) : 0;
+        if (b.isImmediate() && (n == 1 || n == -1) && (type == x86IT_ADD || type == x86IT_SUB)) {
+            pushInstruction((type == x86IT_ADD) == (n == 1) ? x86IT_INC : x86IT_DEC, r);
+        } else {
+            pushInstruction(type, r, b);
+        }
+        if (throughEAX) pushMove(dest, r);
+    }
+    // returns the jump taken when the compare holds
+    BEx86InstructionType emitCompare(SSAOpCode cmpOp, const LIROperand &left, const LIROperand &right) {
+        Location a = getLocation(left), b = getLocation(right);
+        if (a.isImmediate() && !b.isImmediate()) {
+            swap(a, b);
+            switch (cmpOp) {
+                case SSAOC_Lt: cmpOp = SSAOC_Gt; break;
+                case SSAOC_Le: cmpOp = SSAOC_Ge; break;
+                case SSAOC_Gt: cmpOp = SSAOC_Lt; break;
+                case SSAOC_Ge: cmpOp = SSAOC_Le; break;
+                default: break;
+            }
+        }
+        if (a.isImmediate() || (a.isMemory() && b.isMemory())) {
+            Location eax = getRegisterLocation(x86RT_EAX);
+            pushInstruction(x86IT_MOV, eax, a);
+            a = eax;
+        }
+        pushInstruction(x86IT_CMP, a, b);
+        switch (cmpOp) {
+            case SSAOC_Lt: return x86IT_JL;
+            case SSAOC_Le: return x86IT_JLE;
+            case SSAOC_Gt: return x86IT_JG;
+            case SSAOC_Ge: return x86IT_JGE;
+            case SSAOC_Eq: return x86IT_JE;
+            case SSAOC_Ne: return x86IT_JNE;
+            default: ASSERT(0); return x86IT_JE;
+        }
+    }
+    static BEx86InstructionType getInverseJmp(BEx86InstructionType type) {
+        switch (type) {
+            case x86IT_JL: return x86IT_JGE;
+            case x86IT_JLE: return x86IT_JG;
+            case x86IT_JG: return x86IT_JLE;
+            case x86IT_JGE: return x86IT_JL;
+            case x86IT_JE: return x86IT_JNE;
+            case x86IT_JNE: return x86IT_JE;
+            default: ASSERT(0); return x86IT_JMP;
+        }
+    }
+    Location getImmediate(int n) {
+        Location r;
+        r.imm = m_pool->get(n);
+        return r;
+    }
+    static int getImmediateInt(const Location &loc) {
+        auto p = dynamic_cast<BEConstantInt*>(loc.imm);
+        return p == NULL ? 0 : p->num;
+    }
+    Location getArgLocation(BESymbol *symbol) {
+        Location r;
+        r.mem = symbol;
+        return r;
+    }
+    BESymbol* getDivisorSlot() {
+        if (m_divisorSlot == NULL) {
+            m_divisorSlot = m_builder->getTopLocalSymbolTable()->declare("divisor", BETypeManager::instance()->get("int"));
+        }
+        return m_divisorSlot;
+    }
+private:
+    BEx86FunctionBuilder *m_builder;
+    BEConstantPool *m_pool;
+    vector<LIRBasicBlock> m_blocks;
+    vector<VirtualRegister> m_vregs;
+    map<SSAInstruction*, int> m_ssa2VReg;
+    BESymbol *m_divisorSlot;
+    BEx86BasicBlock *m_nextBlock;
+};
+
+void generatex86CodeFromSSA(BEx86FileBuilder *fileBuilder, SourceFileProto *fileProto, int ssaOptTypeFlag, SSAOptimizeStats *stats, ostream *dumpStream) {
+    for (auto func : fileProto->externFuncs) {
+        const BEType *type = BETypeManager::instance()->getFunc();
+        fileBuilder->getGlobalSymbolTable()->declare(func->name, type);
+        fileBuilder->setAsExternSymbol(func->name);
+    }
+
+    for (auto _stmt : fileProto->globalVars) {
+        auto stmt = static_cast<StmtNode_DefineVariable*>(_stmt.get());
+        const BEType *type = BETypeManager::instance()->get(stmt->type);
+        fileBuilder->getGlobalSymbolTable()->declare(stmt->name, type);
+    }
+
+    for (auto func : fileProto->funcs) {
+        fileBuilder->getGlobalSymbolTable()->declare(func->name, BETypeManager::instance()->getFunc());
+    }
+
+    for (auto func : fileProto->funcs) {
+        BEx86FunctionBuilder *builder = fileBuilder->createFunctionBuilder(func->name);
+        builder->beginBuild();
+        SSAFunctionPtr ssaFunc = buildSSAFunction(builder, func.get());
+        optimizeSSA(ssaFunc.get(), fileBuilder->getConstantPool(), ssaOptTypeFlag, stats);
+        if (dumpStream != NULL) ssaFunc->dump(*dumpStream);
+        BEx86SSAFunctionLowering(builder, ssaFunc.get(), stats);
+        builder->endBuild();
+    }
+}
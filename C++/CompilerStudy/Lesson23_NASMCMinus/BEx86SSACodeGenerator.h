@@ -0,0 +1,12 @@
+#ifndef BE_x86_SSA_CODE_GENERATOR_H
+#define BE_x86_SSA_CODE_GENERATOR_H
+
+class BEx86FileBuilder;
+struct SourceFileProto;
+struct SSAOptimizeStats;
+
+// AST -> SSA -> SSA optimizations -> graph coloring register allocation -> x86,
+// dumpStream receives the optimized SSA if not NULL
+void generatex86CodeFromSSA(BEx86FileBuilder *fileBuilder, SourceFileProto *fileProto, int ssaOptTypeFlag, SSAOptimizeStats *stats, ostream *dumpStream);
+
+#endif
@@ -0,0 +1,303 @@
+#include "pch.h"
+#include "SSA.h"
+#include "BEConstant.h"
+#include "BESymbolTable.h"
+#include "IDGenerator.h"
+
+bool SSAInstruction::tryGetInt(int &n) const {
+    if (op != SSAOC_Const) return false;
+    if (auto p = dynamic_cast<BEConstantInt*>(constant)) {
+        n = p->num;
+        return true;
+    }
+    return false;
+}
+
+int SSABasicBlock::getPredIndex(SSABasicBlock *pred) const {
+    auto iter = find(preds.begin(), preds.end(), pred);
+    ASSERT(iter != preds.end());
+    return int(iter - preds.begin());
+}
+int SSABasicBlock::getEdgePredIndex(int succIndex) const {
+    SSABasicBlock *to = succs[succIndex];
+    int nth = (int)count(succs.begin(), succs.begin() + succIndex, to);
+    for (int i = 0; i < (int)to->preds.size(); ++i) {
+        if (to->preds[i] == this && nth-- == 0) return i;
+    }
+    ASSERT(0);
+    return -1;
+}
+//==============================
+SSAFunction::SSAFunction(const string &name): m_name(name) {
+}
+SSAFunction::~SSAFunction() {
+    for (auto block : m_allBasicBlocks) delete block;
+    for (auto ins : m_allInstructions) delete ins;
+}
+
+SSABasicBlock* SSAFunction::createBasicBlock(const string &name) {
+    SSABasicBlock *block = new SSABasicBlock((int)m_allBasicBlocks.size(), IDGenerator::instance()->generateName(name));
+    m_allBasicBlocks.push_back(block);
+    m_basicBlocks.push_back(block);
+    return block;
+}
+SSAInstruction* SSAFunction::createInstruction(SSAOpCode op) {
+    SSAInstruction *ins = new SSAInstruction(op, (int)m_allInstructions.size());
+    m_allInstructions.push_back(ins);
+    return ins;
+}
+void SSAFunction::pushInstruction(SSABasicBlock *block, SSAInstruction *ins) {
+    ASSERT(block->getTerminator() == NULL);
+    ins->block = block;
+    block->instructions.push_back(ins);
+}
+void SSAFunction::insertInstruction(SSABasicBlock *block, int pos, SSAInstruction *ins) {
+    ins->block = block;
+    block->instructions.insert(block->instructions.begin() + pos, ins);
+}
+void SSAFunction::insertBeforeTerminator(SSABasicBlock *block, SSAInstruction *ins) {
+    int pos = (int)block->instructions.size();
+    if (block->getTerminator() != NULL) --pos;
+    insertInstruction(block, pos, ins);
+}
+void SSAFunction::removeInstruction(SSAInstruction *ins) {
+    auto &instructions = ins->block->instructions;
+    auto iter = find(instructions.begin(), instructions.end(), ins);
+    ASSERT(iter != instructions.end());
+    instructions.erase(iter);
+    ins->block = NULL;
+}
+
+void SSAFunction::addEdge(SSABasicBlock *from, SSABasicBlock *to) {
+    from->succs.push_back(to);
+    to->preds.push_back(from);
+}
+void SSAFunction::removeEdge(SSABasicBlock *to, int predIndex) {
+    SSABasicBlock *from = to->preds[predIndex];
+    to->preds.erase(to->preds.begin() + predIndex);
+    for (auto ins : to->instructions) {
+        if (ins->op != SSAOC_Phi) break;
+        ins->operands.erase(ins->operands.begin() + predIndex);
+    }
+    auto iter = find(from->succs.begin(), from->succs.end(), to);
+    ASSERT(iter != from->succs.end());
+    from->succs.erase(iter);
+}
+SSABasicBlock* SSAFunction::splitEdge(SSABasicBlock *from, int succIndex) {
+    SSABasicBlock *to = from->succs[succIndex];
+    int predIndex = from->getEdgePredIndex(succIndex);
+    SSABasicBlock *mid = createBasicBlock("label_split");
+    from->succs[succIndex] = mid;
+    to->preds[predIndex] = mid;
+    mid->preds.push_back(from);
+    mid->succs.push_back(to);
+    pushInstruction(mid, createInstruction(SSAOC_Jmp));
+    mid->loopDepth = min(from->loopDepth, to->loopDepth);
+    return mid;
+}
+int SSAFunction::splitCriticalEdges() {
+    int n = 0;
+    vector<SSABasicBlock*> blocks(m_basicBlocks);
+    for (auto block : blocks) {
+        if (block->succs.size() < 2) continue;
+        for (int i = 0; i < (int)block->succs.size(); ++i) {
+            if (block->succs[i]->preds.size() < 2) continue;
+            splitEdge(block, i);
+            ++n;
+        }
+    }
+    return n;
+}
+
+void SSAFunction::replaceUses(const map<SSAInstruction*, SSAInstruction*> &replacements) {
+    if (replacements.empty()) return;
+    for (auto block : m_basicBlocks) {
+        for (auto ins : block->instructions) {
+            for (auto &operand : ins->operands) {
+                for (auto iter = replacements.find(operand); iter != replacements.end(); iter = replacements.find(operand)) {
+                    operand = iter->second;
+                }
+            }
+        }
+    }
+}
+map<SSAInstruction*, vector<SSAInstruction*> > SSAFunction::computeUsers() {
+    map<SSAInstruction*, vector<SSAInstruction*> > users;
+    for (auto block : m_basicBlocks) {
+        for (auto ins : block->instructions) {
+            for (auto operand : ins->operands) users[operand].push_back(ins);
+        }
+    }
+    return users;
+}
+
+int SSAFunction::removeUnreachableBlocks() {
+    set<SSABasicBlock*> reached;
+    vector<SSABasicBlock*> unscaned(1, getEntry());
+    while (!unscaned.empty()) {
+        SSABasicBlock *block = unscaned.back();
+        unscaned.pop_back();
+        if (!reached.insert(block).second) continue;
+        for (auto succ : block->succs) unscaned.push_back(succ);
+    }
+
+    int n = 0;
+    vector<SSABasicBlock*> newBasicBlocks;
+    for (auto block : m_basicBlocks) {
+        if (reached.count(block) > 0) {
+            newBasicBlocks.push_back(block);
+            continue;
+        }
+        ++n;
+        while (!block->succs.empty()) {
+            SSABasicBlock *succ = block->succs.back();
+            removeEdge(succ, succ->getPredIndex(block));
+        }
+    }
+    m_basicBlocks = newBasicBlocks;
+    return n;
+}
+void SSAFunction::computeDominators() {
+    removeUnreachableBlocks();
+
+    // reverse post order
+    vector<SSABasicBlock*> postOrder;
+    {
+        set<SSABasicBlock*> visited;
+        vector<pair<SSABasicBlock*, int> > stack(1, make_pair(getEntry(), 0));
+        visited.insert(getEntry());
+        while (!stack.empty()) {
+            auto &top = stack.back();
+            if (top.second < (int)top.first->succs.size()) {
+                SSABasicBlock *succ = top.first->succs[top.second++];
+                if (visited.insert(succ).second) stack.push_back(make_pair(succ, 0));
+            } else {
+                postOrder.push_back(top.first);
+                stack.pop_back();
+            }
+        }
+    }
+    m_basicBlocks.assign(postOrder.rbegin(), postOrder.rend());
+    for (int i = 0; i < (int)m_basicBlocks.size(); ++i) {
+        m_basicBlocks[i]->rpoIndex = i;
+        m_basicBlocks[i]->idom = NULL;
+        m_basicBlocks[i]->domChildren.clear();
+    }
+
+    // Cooper, Harvey, Kennedy: "A Simple, Fast Dominance Algorithm"
+    SSABasicBlock *entry = getEntry();
+    entry->idom = entry;
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int i = 1; i < (int)m_basicBlocks.size(); ++i) {
+            SSABasicBlock *block = m_basicBlocks[i];
+            SSABasicBlock *newIdom = NULL;
+            for (auto pred : block->preds) {
+                if (pred->idom == NULL) continue;
+                if (newIdom == NULL) {
+                    newIdom = pred;
+                    continue;
+                }
+                SSABasicBlock *a = pred, *b = newIdom;
+                while (a != b) {
+                    while (a->rpoIndex > b->rpoIndex) a = a->idom;
+                    while (b->rpoIndex > a->rpoIndex) b = b->idom;
+                }
+                newIdom = a;
+            }
+            if (block->idom != newIdom) {
+                block->idom = newIdom;
+                changed = true;
+            }
+        }
+    }
+    entry->idom = NULL;
+    for (int i = 1; i < (int)m_basicBlocks.size(); ++i) {
+        m_basicBlocks[i]->idom->domChildren.push_back(m_basicBlocks[i]);
+    }
+}
+bool SSAFunction::dominates(SSABasicBlock *a, SSABasicBlock *b) const {
+    for (; b != NULL; b = b->idom) {
+        if (a == b) return true;
+    }
+    return false;
+}
+void SSAFunction::computeLoopDepth() {
+    for (auto block : m_basicBlocks) block->loopDepth = 0;
+    for (auto header : m_basicBlocks) {
+        set<SSABasicBlock*> body;
+        body.insert(header);
+        vector<SSABasicBlock*> unscaned;
+        for (auto pred : header->preds) {
+            if (dominates(header, pred)) unscaned.push_back(pred);
+        }
+        if (unscaned.empty()) continue;
+        while (!unscaned.empty()) {
+            SSABasicBlock *block = unscaned.back();
+            unscaned.pop_back();
+            if (!body.insert(block).second) continue;
+            for (auto pred : block->preds) unscaned.push_back(pred);
+        }
+        for (auto block : body) ++block->loopDepth;
+    }
+}
+
+int SSAFunction::getInstructionCount() const {
+    int n = 0;
+    for (auto block : m_basicBlocks) n += (int)block->instructions.size();
+    return n;
+}
+void SSAFunction::dump(ostream &so) {
+    so << format("function %s:\n", m_name.c_str());
+    for (auto block : m_basicBlocks) {
+        so << format(" %s: ; preds", block->name.c_str());
+        for (auto pred : block->preds) so << " " << pred->name;
+        so << "\n";
+        for (auto ins : block->instructions) {
+            string s = ins->hasValue() ? format("\t%%%d = %s", ins->id, getSSAOpCodeName(ins->op)) : format("\t%s", getSSAOpCodeName(ins->op));
+            if (ins->symbol != NULL) s += " " + ins->symbol->name;
+            if (ins->constant != NULL) {
+                int n;
+                if (ins->tryGetInt(n)) s += format(" %d", n);
+                else s += " " + ins->constant->name;
+            }
+            for (auto operand : ins->operands) s += format(" %%%d", operand->id);
+            if (ins->isTerminator()) {
+                for (auto succ : block->succs) s += " " + succ->name;
+            }
+            so << s << "\n";
+        }
+    }
+}
+
+const char* getSSAOpCodeName(SSAOpCode op) {
+    switch (op) {
+        case SSAOC_Arg: return "arg";
+        case SSAOC_Const: return "const";
+        case SSAOC_LoadGlobal: return "load";
+        case SSAOC_StoreGlobal: return "store";
+        case SSAOC_Phi: return "phi";
+        case SSAOC_Copy: return "copy";
+        case SSAOC_Add: return "add";
+        case SSAOC_Sub: return "sub";
+        case SSAOC_Mul: return "mul";
+        case SSAOC_Div: return "div";
+        case SSAOC_Mod: return "mod";
+        case SSAOC_Sal: return "sal";
+        case SSAOC_Sar: return "sar";
+        case SSAOC_And: return "and";
+        case SSAOC_Or: return "or";
+        case SSAOC_Lt: return "lt";
+        case SSAOC_Le: return "le";
+        case SSAOC_Gt: return "gt";
+        case SSAOC_Ge: return "ge";
+        case SSAOC_Eq: return "eq";
+        case SSAOC_Ne: return "ne";
+        case SSAOC_Call: return "call";
+        case SSAOC_Jmp: return "jmp";
+        case SSAOC_CJmp: return "cjmp";
+        case SSAOC_Ret: return "ret";
+        default: ASSERT(0);
+    }
+    return "";
+}
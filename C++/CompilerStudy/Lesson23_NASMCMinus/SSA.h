@@ -0,0 +1,121 @@
+#ifndef SSA_H
+#define SSA_H
+
+struct BESymbol;
+struct BEConstant;
+struct SSABasicBlock;
+
+enum SSAOpCode {
+    SSAOC_Arg, // symbol: the argument slot
+    SSAOC_Const, // constant
+    SSAOC_LoadGlobal, // symbol
+    SSAOC_StoreGlobal, // symbol = operands[0]
+    SSAOC_Phi, // operands[i] comes from block->preds[i]
+    SSAOC_Copy,
+
+    SSAOC_Add,
+    SSAOC_Sub,
+    SSAOC_Mul,
+    SSAOC_Div,
+    SSAOC_Mod,
+    SSAOC_Sal,
+    SSAOC_Sar,
+    SSAOC_And,
+    SSAOC_Or,
+
+    SSAOC_Lt,
+    SSAOC_Le,
+    SSAOC_Gt,
+    SSAOC_Ge,
+    SSAOC_Eq,
+    SSAOC_Ne,
+
+    SSAOC_Call, // symbol: the function, operands: the arguments
+
+    SSAOC_Jmp, // block->succs[0]
+    SSAOC_CJmp, // operands[0] != 0 ? block->succs[0] : block->succs[1]
+    SSAOC_Ret, // operands[0] if any
+};
+
+struct SSAInstruction {
+    SSAOpCode op;
+    int id;
+    SSABasicBlock *block;
+    vector<SSAInstruction*> operands;
+    BEConstant *constant;
+    BESymbol *symbol;
+
+    SSAInstruction(SSAOpCode _op, int _id): op(_op), id(_id), block(NULL), constant(NULL), symbol(NULL){}
+    bool isTerminator() const { return op == SSAOC_Jmp || op == SSAOC_CJmp || op == SSAOC_Ret; }
+    bool isCompare() const { return op >= SSAOC_Lt && op <= SSAOC_Ne; }
+    bool isArithmetic() const { return op >= SSAOC_Add && op <= SSAOC_Or; }
+    bool isCommutative() const { return op == SSAOC_Add || op == SSAOC_Mul || op == SSAOC_And || op == SSAOC_Or || op == SSAOC_Eq || op == SSAOC_Ne; }
+    // no side effect and doesn't read memory, so it can be numbered, moved or removed
+    bool isPure() const { return op == SSAOC_Const || op == SSAOC_Copy || isArithmetic() || isCompare(); }
+    bool hasValue() const { return !isTerminator() && op != SSAOC_StoreGlobal; }
+    bool tryGetInt(int &n) const;
+};
+
+struct SSABasicBlock {
+    int id;
+    string name;
+    vector<SSAInstruction*> instructions; // phis first, the terminator last
+    vector<SSABasicBlock*> preds, succs;
+
+    SSABasicBlock *idom;
+    vector<SSABasicBlock*> domChildren;
+    int rpoIndex;
+    int loopDepth;
+
+    SSABasicBlock(int _id, const string &_name): id(_id), name(_name), idom(NULL), rpoIndex(-1), loopDepth(0){}
+    SSAInstruction* getTerminator() { return instructions.empty() || !instructions.back()->isTerminator() ? NULL : instructions.back(); }
+    int getPredIndex(SSABasicBlock *pred) const;
+    // index in succs[succIndex]->preds of that edge, a conditional jump may reach one block twice
+    int getEdgePredIndex(int succIndex) const;
+};
+
+class SSAFunction: public Noncopyable {
+public:
+    SSAFunction(const string &name);
+    ~SSAFunction();
+
+    const string& getName() const { return m_name; }
+    SSABasicBlock* getEntry() { return m_basicBlocks[0]; }
+    vector<SSABasicBlock*>& getBasicBlocks() { return m_basicBlocks; }
+
+    SSABasicBlock* createBasicBlock(const string &name);
+    SSAInstruction* createInstruction(SSAOpCode op);
+    void pushInstruction(SSABasicBlock *block, SSAInstruction *ins);
+    void insertInstruction(SSABasicBlock *block, int pos, SSAInstruction *ins);
+    void insertBeforeTerminator(SSABasicBlock *block, SSAInstruction *ins);
+    void removeInstruction(SSAInstruction *ins);
+
+    void addEdge(SSABasicBlock *from, SSABasicBlock *to);
+    // removes the i-th pred of 'to' and its phi operands, and the matching succ of the pred
+    void removeEdge(SSABasicBlock *to, int predIndex);
+    SSABasicBlock* splitEdge(SSABasicBlock *from, int succIndex);
+    int splitCriticalEdges();
+
+    // replacements may be chained, every use of a key is replaced by its final value
+    void replaceUses(const map<SSAInstruction*, SSAInstruction*> &replacements);
+    map<SSAInstruction*, vector<SSAInstruction*> > computeUsers();
+
+    // drops unreachable blocks, orders the others in reverse post order and builds the dominator tree
+    int removeUnreachableBlocks();
+    void computeDominators();
+    bool dominates(SSABasicBlock *a, SSABasicBlock *b) const;
+    void computeLoopDepth();
+
+    int getInstructionCount() const;
+    void dump(ostream &so);
+private:
+    string m_name;
+    vector<SSABasicBlock*> m_basicBlocks;
+    vector<SSABasicBlock*> m_allBasicBlocks;
+    vector<SSAInstruction*> m_allInstructions;
+};
+typedef shared_ptr<SSAFunction> SSAFunctionPtr;
+
+const char* getSSAOpCodeName(SSAOpCode op);
+
+#endif
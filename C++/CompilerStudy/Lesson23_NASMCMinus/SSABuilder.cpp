@@ -0,0 +1,348 @@
+#include "pch.h"
+#include "SSABuilder.h"
+#include "BESymbolTable.h"
+#include "BEType.h"
+#include "BEConstant.h"
+#include "BEStorage.h"
+#include "BEx86FileBuilder.h"
+#include "BEx86FunctionBuilder.h"
+#include "SourceFileProto.h"
+#include "AST.h"
+
+class SSAFunctionBuilder: public IStmtNodeVisitor, public IExprNodeVisitor {
+public:
+    SSAFunctionBuilder(BEx86FunctionBuilder *builder, FunctionProto *func):
+        m_builder(builder), m_func(new SSAFunction(func->name)), m_value(NULL), m_varCount(0) {
+
+        m_current = m_func->createBasicBlock("label_entry");
+        sealBlock(m_current);
+
+        m_scopes.push_back(map<string, int>());
+        for (auto typeID : func->argsTypeID) {
+            const BEType *type = BETypeManager::instance()->get(typeID.first);
+            BEVariablePtr var = m_builder->declareArgVariable(typeID.second, type);
+            SSAInstruction *arg = m_func->createInstruction(SSAOC_Arg);
+            arg->symbol = static_cast<BELeftValueVariable*>(var.get())->symbol;
+            m_func->pushInstruction(m_current, arg);
+            writeVariable(declareVariable(typeID.second), m_current, arg);
+        }
+
+        func->body->acceptVisitor(this);
+        if (m_current->getTerminator() == NULL) m_func->pushInstruction(m_current, m_func->createInstruction(SSAOC_Ret));
+        m_scopes.pop_back();
+
+        ASSERT(m_incompletePhis.empty());
+        m_func->removeUnreachableBlocks();
+    }
+    SSAFunctionPtr getFunction() { return m_func; }
+private:
+    virtual void visit(StmtNode_Block *node) {
+        m_scopes.push_back(map<string, int>());
+        for (auto stmt : node->stmts) stmt->acceptVisitor(this);
+        m_scopes.pop_back();
+    }
+    virtual void visit(StmtNode_Stmts *node) {
+        for (auto stmt : node->stmts) stmt->acceptVisitor(this);
+    }
+    virtual void visit(StmtNode_Expr *node) {
+        visitExpr(node->expr);
+    }
+    virtual void visit(StmtNode_DefineVariable *node) {
+        declareVariable(node->name);
+    }
+    virtual void visit(StmtNode_Continue *node) {
+        createJmp(m_continueBlocks.back());
+        startUnreachableBlock();
+    }
+    virtual void visit(StmtNode_Break *node) {
+        createJmp(m_breakBlocks.back());
+        startUnreachableBlock();
+    }
+    virtual void visit(StmtNode_Return *node) {
+        SSAInstruction *ret = m_func->createInstruction(SSAOC_Ret);
+        if (node->expr != NULL) ret->operands.push_back(visitExpr(node->expr));
+        m_func->pushInstruction(m_current, ret);
+        startUnreachableBlock();
+    }
+    virtual void visit(StmtNode_IfThenElse *node) {
+        SSABasicBlock *thenBlock = m_func->createBasicBlock("label_then");
+        SSABasicBlock *elseBlock = m_func->createBasicBlock("label_else");
+        SSABasicBlock *endBlock = m_func->createBasicBlock("label_endif");
+        createCJmp(visitExpr(node->cond), thenBlock, elseBlock);
+        sealBlock(thenBlock);
+        sealBlock(elseBlock);
+
+        m_current = thenBlock;
+        if (node->thenStmt != NULL) node->thenStmt->acceptVisitor(this);
+        createJmp(endBlock);
+        m_current = elseBlock;
+        if (node->elseStmt != NULL) node->elseStmt->acceptVisitor(this);
+        createJmp(endBlock);
+        sealBlock(endBlock);
+        m_current = endBlock;
+    }
+    virtual void visit(StmtNode_For *node) {
+        if (node->first != NULL) node->first->acceptVisitor(this);
+
+        SSABasicBlock *loopBlock = m_func->createBasicBlock("label_loop");
+        SSABasicBlock *bodyBlock = m_func->createBasicBlock("label_body");
+        SSABasicBlock *continueBlock = m_func->createBasicBlock("label_continue");
+        SSABasicBlock *breakBlock = m_func->createBasicBlock("label_break");
+        m_continueBlocks.push_back(continueBlock);
+        m_breakBlocks.push_back(breakBlock);
+
+        // the loop header gets its back edge last, so it stays unsealed until then
+        createJmp(loopBlock);
+        m_current = loopBlock;
+        createCJmp(node->second != NULL ? visitExpr(node->second) : getConstant(1), bodyBlock, breakBlock);
+        sealBlock(bodyBlock);
+
+        m_current = bodyBlock;
+        if (node->body != NULL) node->body->acceptVisitor(this);
+        createJmp(continueBlock);
+        sealBlock(continueBlock);
+
+        m_current = continueBlock;
+        if (node->third != NULL) visitExpr(node->third);
+        createJmp(loopBlock);
+        sealBlock(loopBlock);
+        sealBlock(breakBlock);
+        m_current = breakBlock;
+
+        m_continueBlocks.pop_back();
+        m_breakBlocks.pop_back();
+    }
+private:
+    virtual void visit(ExprNode_StringLiteral *node) {
+        m_value = getConstant(m_builder->getParent()->getConstantPool()->get(node->str));
+    }
+    virtual void visit(ExprNode_IntLiteral *node) {
+        m_value = getConstant(node->number);
+    }
+    virtual void visit(ExprNode_FloatLiteral *node) {
+        ASSERT(0);
+    }
+    virtual void visit(ExprNode_Variable *node) {
+        int var = lookupVariable(node->name);
+        if (var != -1) {
+            m_value = readVariable(var, m_current);
+        } else {
+            SSAInstruction *load = m_func->createInstruction(SSAOC_LoadGlobal);
+            load->symbol = getGlobalSymbol(node->name);
+            m_func->pushInstruction(m_current, load);
+            m_value = load;
+        }
+    }
+    virtual void visit(ExprNode_Assignment *node) {
+        SSAInstruction *value = visitExpr(node->right);
+        int var = lookupVariable(node->left);
+        if (var != -1) {
+            writeVariable(var, m_current, value);
+        } else {
+            SSAInstruction *store = m_func->createInstruction(SSAOC_StoreGlobal);
+            store->symbol = getGlobalSymbol(node->left);
+            store->operands.push_back(value);
+            m_func->pushInstruction(m_current, store);
+        }
+        m_value = value;
+    }
+    virtual void visit(ExprNode_BinaryOp *node) {
+        if (node->op == ExprNode_BinaryOp::OT_And || node->op == ExprNode_BinaryOp::OT_Or) {
+            /*
+               cjmp left label_logic_right label_logic_end (&&)
+               cjmp left label_logic_end label_logic_right (||)
+label_logic_right:
+               temp = ne right, 0
+               jmp label_logic_end
+label_logic_end:
+               phi (0 or 1), temp
+             * */
+            bool isAnd = node->op == ExprNode_BinaryOp::OT_And;
+            SSABasicBlock *rightBlock = m_func->createBasicBlock("label_logic_right");
+            SSABasicBlock *endBlock = m_func->createBasicBlock("label_logic_end");
+            SSAInstruction *left = visitExpr(node->left);
+            if (isAnd) createCJmp(left, rightBlock, endBlock);
+            else createCJmp(left, endBlock, rightBlock);
+            sealBlock(rightBlock);
+
+            m_current = rightBlock;
+            SSAInstruction *right = createBinaryOp(SSAOC_Ne, visitExpr(node->right), getConstant(0));
+            createJmp(endBlock);
+            sealBlock(endBlock);
+
+            m_current = endBlock;
+            ASSERT(endBlock->preds.size() == 2 && endBlock->preds[1] != endBlock->preds[0]);
+            SSAInstruction *phi = m_func->createInstruction(SSAOC_Phi);
+            phi->operands.push_back(getConstant(isAnd ? 0 : 1));
+            phi->operands.push_back(right);
+            m_func->insertInstruction(endBlock, 0, phi);
+            m_value = phi;
+            return;
+        }
+
+        SSAOpCode op = SSAOC_Add;
+        switch (node->op) {
+            case ExprNode_BinaryOp::OT_Add: op = SSAOC_Add; break;
+            case ExprNode_BinaryOp::OT_Sub: op = SSAOC_Sub; break;
+            case ExprNode_BinaryOp::OT_Mul: op = SSAOC_Mul; break;
+            case ExprNode_BinaryOp::OT_Div: op = SSAOC_Div; break;
+            case ExprNode_BinaryOp::OT_Mod: op = SSAOC_Mod; break;
+            case ExprNode_BinaryOp::OT_Less: op = SSAOC_Lt; break;
+            case ExprNode_BinaryOp::OT_LessEq: op = SSAOC_Le; break;
+            case ExprNode_BinaryOp::OT_Greater: op = SSAOC_Gt; break;
+            case ExprNode_BinaryOp::OT_GreaterEq: op = SSAOC_Ge; break;
+            case ExprNode_BinaryOp::OT_Equal: op = SSAOC_Eq; break;
+            case ExprNode_BinaryOp::OT_NEqual: op = SSAOC_Ne; break;
+            case ExprNode_BinaryOp::OT_LShift: op = SSAOC_Sal; break;
+            case ExprNode_BinaryOp::OT_RShift: op = SSAOC_Sar; break;
+            case ExprNode_BinaryOp::OT_BitAnd: op = SSAOC_And; break;
+            case ExprNode_BinaryOp::OT_BitOr: op = SSAOC_Or; break;
+            default: ASSERT(0); break;
+        }
+        SSAInstruction *left = visitExpr(node->left);
+        m_value = createBinaryOp(op, left, visitExpr(node->right));
+    }
+    virtual void visit(ExprNode_UnaryOp *node) {
+        switch (node->op) {
+            case ExprNode_UnaryOp::OT_Minus:
+                m_value = createBinaryOp(SSAOC_Sub, getConstant(0), visitExpr(node->expr));
+                break;
+            case ExprNode_UnaryOp::OT_Not:
+                m_value = createBinaryOp(SSAOC_Eq, visitExpr(node->expr), getConstant(0));
+                break;
+            default: ASSERT(0); break;
+        }
+    }
+    virtual void visit(ExprNode_TypeCast *node) {
+        ASSERT(0);
+    }
+    virtual void visit(ExprNode_Call *node) {
+        SSAInstruction *call = m_func->createInstruction(SSAOC_Call);
+        call->symbol = getGlobalSymbol(node->funcName);
+        call->operands.resize(node->args.size());
+        // keep the evaluation order of the stack machine: the last arg first
+        for (int i = (int)node->args.size() - 1; i >= 0; --i) {
+            call->operands[i] = visitExpr(node->args[i]);
+        }
+        m_func->pushInstruction(m_current, call);
+        m_value = call;
+    }
+private:
+    SSAInstruction* visitExpr(ExprNodePtr expr) {
+        expr->acceptVisitor(this);
+        return m_value;
+    }
+    SSAInstruction* createBinaryOp(SSAOpCode op, SSAInstruction *left, SSAInstruction *right) {
+        SSAInstruction *ins = m_func->createInstruction(op);
+        ins->operands.push_back(left);
+        ins->operands.push_back(right);
+        m_func->pushInstruction(m_current, ins);
+        return ins;
+    }
+    void createJmp(SSABasicBlock *to) {
+        m_func->pushInstruction(m_current, m_func->createInstruction(SSAOC_Jmp));
+        m_func->addEdge(m_current, to);
+    }
+    void createCJmp(SSAInstruction *cond, SSABasicBlock *trueBlock, SSABasicBlock *falseBlock) {
+        SSAInstruction *cjmp = m_func->createInstruction(SSAOC_CJmp);
+        cjmp->operands.push_back(cond);
+        m_func->pushInstruction(m_current, cjmp);
+        m_func->addEdge(m_current, trueBlock);
+        m_func->addEdge(m_current, falseBlock);
+    }
+    // code after return/break/continue goes to a block which nobody jumps to
+    void startUnreachableBlock() {
+        m_current = m_func->createBasicBlock("label_unreachable");
+        sealBlock(m_current);
+    }
+
+    SSAInstruction* getConstant(int num) {
+        return getConstant(m_builder->getParent()->getConstantPool()->get(num));
+    }
+    SSAInstruction* getConstant(BEConstant *constant) {
+        SSAInstruction *&ins = m_constants[constant];
+        if (ins == NULL) {
+            // the entry has no preds, so no phi, and dominates every use
+            ins = m_func->createInstruction(SSAOC_Const);
+            ins->constant = constant;
+            m_func->insertInstruction(m_func->getEntry(), 0, ins);
+        }
+        return ins;
+    }
+    BESymbol* getGlobalSymbol(const string &name) {
+        BESymbol *symbol = m_builder->getParent()->getGlobalSymbolTable()->get(name);
+        ASSERT1(symbol != NULL, name);
+        return symbol;
+    }
+
+    int declareVariable(const string &name) {
+        ASSERT1(m_scopes.back().count(name) == 0, name);
+        return m_scopes.back()[name] = m_varCount++;
+    }
+    int lookupVariable(const string &name) {
+        for (auto iter = m_scopes.rbegin(); iter != m_scopes.rend(); ++iter) {
+            auto varIter = iter->find(name);
+            if (varIter != iter->end()) return varIter->second;
+        }
+        return -1;
+    }
+    void writeVariable(int var, SSABasicBlock *block, SSAInstruction *value) {
+        m_currentDefs[block][var] = value;
+    }
+    SSAInstruction* readVariable(int var, SSABasicBlock *block) {
+        auto &defs = m_currentDefs[block];
+        auto iter = defs.find(var);
+        if (iter != defs.end()) return iter->second;
+
+        SSAInstruction *value = NULL;
+        if (m_sealedBlocks.count(block) == 0) {
+            value = createPhi(block);
+            m_incompletePhis[block][var] = value;
+        } else if (block->preds.empty()) {
+            // read before written
+            value = getConstant(0);
+        } else if (block->preds.size() == 1) {
+            value = readVariable(var, block->preds[0]);
+        } else {
+            value = createPhi(block);
+            writeVariable(var, block, value);
+            addPhiOperands(var, value);
+        }
+        writeVariable(var, block, value);
+        return value;
+    }
+    SSAInstruction* createPhi(SSABasicBlock *block) {
+        SSAInstruction *phi = m_func->createInstruction(SSAOC_Phi);
+        m_func->insertInstruction(block, 0, phi);
+        return phi;
+    }
+    void addPhiOperands(int var, SSAInstruction *phi) {
+        for (auto pred : phi->block->preds) phi->operands.push_back(readVariable(var, pred));
+    }
+    void sealBlock(SSABasicBlock *block) {
+        ASSERT(m_sealedBlocks.count(block) == 0);
+        auto iter = m_incompletePhis.find(block);
+        if (iter != m_incompletePhis.end()) {
+            for (auto p : iter->second) addPhiOperands(p.first, p.second);
+            m_incompletePhis.erase(iter);
+        }
+        m_sealedBlocks.insert(block);
+    }
+private:
+    BEx86FunctionBuilder *m_builder;
+    SSAFunctionPtr m_func;
+    SSAInstruction *m_value;
+    SSABasicBlock *m_current;
+    vector<SSABasicBlock*> m_breakBlocks, m_continueBlocks;
+
+    vector<map<string, int> > m_scopes;
+    int m_varCount;
+    map<SSABasicBlock*, map<int, SSAInstruction*> > m_currentDefs;
+    map<SSABasicBlock*, map<int, SSAInstruction*> > m_incompletePhis;
+    set<SSABasicBlock*> m_sealedBlocks;
+    map<BEConstant*, SSAInstruction*> m_constants;
+};
+
+SSAFunctionPtr buildSSAFunction(BEx86FunctionBuilder *builder, FunctionProto *func) {
+    return SSAFunctionBuilder(builder, func).getFunction();
+}
@@ -0,0 +1,13 @@
+#ifndef SSA_BUILDER_H
+#define SSA_BUILDER_H
+
+#include "SSA.h"
+
+class BEx86FunctionBuilder;
+struct FunctionProto;
+
+// builds pruned SSA straight from the AST (Braun et al. "Simple and Efficient Construction of SSA Form"),
+// the args are declared in builder, which must be between beginBuild and endBuild
+SSAFunctionPtr buildSSAFunction(BEx86FunctionBuilder *builder, FunctionProto *func);
+
+#endif
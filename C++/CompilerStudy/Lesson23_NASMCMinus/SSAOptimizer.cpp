@@ -0,0 +1,475 @@
+#include "pch.h"
+
+#include <time.h>
+
+#include "SSA.h"
+#include "SSAOptimizer.h"
+#include "BEConstant.h"
+
+// the entry has no phi, and dominates everything
+static SSAInstruction* createIntConstant(SSAFunction *func, BEConstantPool *constantPool, int n) {
+    SSAInstruction *ins = func->createInstruction(SSAOC_Const);
+    ins->constant = constantPool->get(n);
+    func->insertInstruction(func->getEntry(), 0, ins);
+    return ins;
+}
+static SSAInstruction* resolveReplacement(const map<SSAInstruction*, SSAInstruction*> &replacements, SSAInstruction *ins) {
+    for (auto iter = replacements.find(ins); iter != replacements.end(); iter = replacements.find(ins)) {
+        ins = iter->second;
+    }
+    return ins;
+}
+// follows the semantics of the generated code: 32 bit wrap around, and div only folded where it's unambiguous
+static bool foldIntOperation(SSAOpCode op, int a, int b, int &r) {
+    switch (op) {
+        case SSAOC_Add: r = int((unsigned)a + (unsigned)b); return true;
+        case SSAOC_Sub: r = int((unsigned)a - (unsigned)b); return true;
+        case SSAOC_Mul: r = int((unsigned)a * (unsigned)b); return true;
+        case SSAOC_Div:
+            if (a < 0 || b <= 0) return false;
+            r = a / b; return true;
+        case SSAOC_Mod:
+            if (a < 0 || b <= 0) return false;
+            r = a % b; return true;
+        case SSAOC_Sal:
+            if (b < 0 || b > 31) return false;
+            r = int((unsigned)a << b); return true;
+        case SSAOC_Sar:
+            if (b < 0 || b > 31) return false;
+            r = a >> b; return true;
+        case SSAOC_And: r = a & b; return true;
+        case SSAOC_Or: r = a | b; return true;
+        case SSAOC_Lt: r = a < b; return true;
+        case SSAOC_Le: r = a <= b; return true;
+        case SSAOC_Gt: r = a > b; return true;
+        case SSAOC_Ge: r = a >= b; return true;
+        case SSAOC_Eq: r = a == b; return true;
+        case SSAOC_Ne: r = a != b; return true;
+        default: ASSERT(0); return false;
+    }
+}
+//==============================
+class SSAOptimizer_CopyPropagation {
+public:
+    SSAOptimizer_CopyPropagation(SSAFunction *func): m_changeCount(0) {
+        map<SSAInstruction*, SSAInstruction*> replacements;
+        for (bool changed = true; changed; ) {
+            changed = false;
+            for (auto block : func->getBasicBlocks()) {
+                vector<SSAInstruction*> instructions(block->instructions);
+                for (auto ins : instructions) {
+                    SSAInstruction *value = NULL;
+                    if (ins->op == SSAOC_Copy) {
+                        value = resolveReplacement(replacements, ins->operands[0]);
+                    } else if (ins->op == SSAOC_Phi) {
+                        // trivial if it merges only itself and one other value
+                        for (auto operand : ins->operands) {
+                            operand = resolveReplacement(replacements, operand);
+                            if (operand == ins || operand == value) continue;
+                            if (value != NULL) {
+                                value = NULL;
+                                break;
+                            }
+                            value = operand;
+                        }
+                    }
+                    if (value == NULL || value == ins) continue;
+                    replacements[ins] = value;
+                    func->removeInstruction(ins);
+                    changed = true;
+                    ++m_changeCount;
+                }
+            }
+        }
+        func->replaceUses(replacements);
+    }
+    int getChangeCount() const { return m_changeCount; }
+private:
+    int m_changeCount;
+};
+//==============================
+class SSAOptimizer_SCCP {
+public:
+    SSAOptimizer_SCCP(SSAFunction *func, BEConstantPool *constantPool): m_changeCount(0) {
+        int maxID = 0;
+        for (auto block : func->getBasicBlocks()) {
+            m_executableEdges[block].assign(block->preds.size(), false);
+            for (auto ins : block->instructions) maxID = max(maxID, ins->id);
+        }
+        m_values.assign(maxID + 1, Lattice());
+        m_users = func->computeUsers();
+
+        m_flowWorkList.push_back(make_pair(func->getEntry(), -1));
+        while (!m_flowWorkList.empty() || !m_ssaWorkList.empty()) {
+            while (!m_flowWorkList.empty()) {
+                SSABasicBlock *block = m_flowWorkList.back().first;
+                int predIndex = m_flowWorkList.back().second;
+                m_flowWorkList.pop_back();
+                if (predIndex >= 0) {
+                    if (m_executableEdges[block][predIndex]) continue;
+                    m_executableEdges[block][predIndex] = true;
+                }
+                bool firstVisit = m_visitedBlocks.insert(block).second;
+                for (auto ins : block->instructions) {
+                    if (!firstVisit && ins->op != SSAOC_Phi) break;
+                    visitInstruction(ins);
+                }
+            }
+            while (!m_ssaWorkList.empty()) {
+                SSAInstruction *ins = m_ssaWorkList.back();
+                m_ssaWorkList.pop_back();
+                if (m_visitedBlocks.count(ins->block) > 0) visitInstruction(ins);
+            }
+        }
+
+        rewrite(func, constantPool);
+    }
+    int getChangeCount() const { return m_changeCount; }
+private:
+    enum LatticeType {
+        LT_Top,
+        LT_Const,
+        LT_Bottom,
+    };
+    struct Lattice {
+        LatticeType type;
+        int value;
+        Lattice(LatticeType _type = LT_Top, int _value = 0): type(_type), value(_value){}
+        bool operator == (const Lattice &o) const { return type == o.type && value == o.value; }
+        bool operator != (const Lattice &o) const { return !(*this == o); }
+    };
+    static Lattice meet(const Lattice &a, const Lattice &b) {
+        if (a.type == LT_Top) return b;
+        if (b.type == LT_Top) return a;
+        if (a == b) return a;
+        return Lattice(LT_Bottom);
+    }
+
+    void visitInstruction(SSAInstruction *ins) {
+        SSABasicBlock *block = ins->block;
+        if (ins->op == SSAOC_Jmp) {
+            addFlowEdge(block, 0);
+        } else if (ins->op == SSAOC_CJmp) {
+            const Lattice &cond = m_values[ins->operands[0]->id];
+            if (cond.type == LT_Bottom) {
+                addFlowEdge(block, 0);
+                addFlowEdge(block, 1);
+            } else if (cond.type == LT_Const) {
+                addFlowEdge(block, cond.value != 0 ? 0 : 1);
+            }
+        } else if (ins->hasValue()) {
+            Lattice value = evaluate(ins);
+            if (value != m_values[ins->id]) {
+                m_values[ins->id] = value;
+                auto iter = m_users.find(ins);
+                if (iter != m_users.end()) m_ssaWorkList.insert(m_ssaWorkList.end(), iter->second.begin(), iter->second.end());
+            }
+        }
+    }
+    void addFlowEdge(SSABasicBlock *block, int succIndex) {
+        m_flowWorkList.push_back(make_pair(block->succs[succIndex], block->getEdgePredIndex(succIndex)));
+    }
+    Lattice evaluate(SSAInstruction *ins) {
+        switch (ins->op) {
+            case SSAOC_Const: {
+                    int n;
+                    if (ins->tryGetInt(n)) return Lattice(LT_Const, n);
+                    return Lattice(LT_Bottom);
+                }
+            case SSAOC_Copy:
+                return m_values[ins->operands[0]->id];
+            case SSAOC_Phi: {
+                    Lattice r;
+                    const vector<bool> &executable = m_executableEdges[ins->block];
+                    for (int i = 0; i < (int)ins->operands.size(); ++i) {
+                        if (executable[i]) r = meet(r, m_values[ins->operands[i]->id]);
+                    }
+                    return r;
+                }
+            default:
+                break;
+        }
+        if (!ins->isArithmetic() && !ins->isCompare()) return Lattice(LT_Bottom);
+
+        const Lattice &a = m_values[ins->operands[0]->id], &b = m_values[ins->operands[1]->id];
+        if (a.type == LT_Bottom || b.type == LT_Bottom) return Lattice(LT_Bottom);
+        if (a.type == LT_Top || b.type == LT_Top) return Lattice(LT_Top);
+        int r;
+        if (foldIntOperation(ins->op, a.value, b.value, r)) return Lattice(LT_Const, r);
+        return Lattice(LT_Bottom);
+    }
+
+    void rewrite(SSAFunction *func, BEConstantPool *constantPool) {
+        // the lattice is indexed by the ids of the original instructions, so the dropped successor of
+        // each folded jump is decided before its condition is replaced by a new constant
+        vector<SSAInstruction*> foldedValues;
+        vector<pair<SSAInstruction*, int> > foldedJmps;
+        for (auto block : func->getBasicBlocks()) {
+            if (m_visitedBlocks.count(block) == 0) continue;
+            for (auto ins : block->instructions) {
+                if (ins->op == SSAOC_CJmp && m_values[ins->operands[0]->id].type == LT_Const) {
+                    foldedJmps.push_back(make_pair(ins, m_values[ins->operands[0]->id].value != 0 ? 1 : 0));
+                } else if (ins->hasValue() && ins->op != SSAOC_Const && m_values[ins->id].type == LT_Const) {
+                    foldedValues.push_back(ins);
+                }
+            }
+        }
+
+        map<SSAInstruction*, SSAInstruction*> replacements;
+        map<int, SSAInstruction*> constants;
+        for (auto ins : foldedValues) {
+            int n = m_values[ins->id].value;
+            if (constants.count(n) == 0) constants[n] = createIntConstant(func, constantPool, n);
+            replacements[ins] = constants[n];
+            func->removeInstruction(ins);
+        }
+        func->replaceUses(replacements);
+
+        for (auto &jmp : foldedJmps) {
+            SSAInstruction *ins = jmp.first;
+            SSABasicBlock *block = ins->block;
+            int dropIndex = jmp.second;
+            func->removeEdge(block->succs[dropIndex], block->getEdgePredIndex(dropIndex));
+            ins->op = SSAOC_Jmp;
+            ins->operands.clear();
+        }
+        func->removeUnreachableBlocks();
+
+        m_changeCount = int(foldedValues.size() + foldedJmps.size());
+    }
+private:
+    vector<Lattice> m_values;
+    map<SSAInstruction*, vector<SSAInstruction*> > m_users;
+    map<SSABasicBlock*, vector<bool> > m_executableEdges;
+    set<SSABasicBlock*> m_visitedBlocks;
+    vector<pair<SSABasicBlock*, int> > m_flowWorkList;
+    vector<SSAInstruction*> m_ssaWorkList;
+    int m_changeCount;
+};
+//==============================
+class SSAOptimizer_GVN {
+public:
+    SSAOptimizer_GVN(SSAFunction *func): m_func(func), m_changeCount(0) {
+        func->computeDominators();
+        numberBlock(func->getEntry());
+        // phis may use values which are defined later in the dominator tree
+        func->replaceUses(m_replacements);
+    }
+    int getChangeCount() const { return m_changeCount; }
+private:
+    typedef vector<size_t> Key;
+
+    void numberBlock(SSABasicBlock *block) {
+        vector<Key> addedKeys;
+        vector<SSAInstruction*> instructions(block->instructions);
+        for (auto ins : instructions) {
+            for (auto &operand : ins->operands) operand = resolveReplacement(m_replacements, operand);
+            if (ins->op == SSAOC_Copy) {
+                replace(ins, ins->operands[0]);
+                continue;
+            }
+            if (!ins->isPure() && ins->op != SSAOC_Phi) continue;
+
+            Key key;
+            key.push_back(ins->op);
+            key.push_back((size_t)ins->constant);
+            key.push_back((size_t)ins->symbol);
+            key.push_back(ins->op == SSAOC_Phi ? (size_t)block : 0);
+            for (auto operand : ins->operands) key.push_back((size_t)operand);
+            if (ins->isCommutative()) sort(key.begin() + 4, key.end());
+
+            auto iter = m_table.find(key);
+            if (iter != m_table.end()) {
+                replace(ins, iter->second);
+            } else {
+                m_table[key] = ins;
+                addedKeys.push_back(key);
+            }
+        }
+
+        for (auto child : block->domChildren) numberBlock(child);
+
+        for (auto &key : addedKeys) m_table.erase(key);
+    }
+    void replace(SSAInstruction *ins, SSAInstruction *value) {
+        m_replacements[ins] = value;
+        m_func->removeInstruction(ins);
+        ++m_changeCount;
+    }
+private:
+    SSAFunction *m_func;
+    map<Key, SSAInstruction*> m_table;
+    map<SSAInstruction*, SSAInstruction*> m_replacements;
+    int m_changeCount;
+};
+//==============================
+class SSAOptimizer_LICM {
+public:
+    SSAOptimizer_LICM(SSAFunction *func): m_func(func), m_changeCount(0) {
+        func->computeDominators();
+        // inner loops come later in reverse post order, hoist out of them first
+        vector<SSABasicBlock*> blocks(func->getBasicBlocks());
+        for (auto iter = blocks.rbegin(); iter != blocks.rend(); ++iter) {
+            SSABasicBlock *header = *iter;
+            vector<SSABasicBlock*> body = findLoopBody(header);
+            if (!body.empty()) hoistLoop(header, body);
+        }
+        func->computeDominators();
+    }
+    int getChangeCount() const { return m_changeCount; }
+private:
+    vector<SSABasicBlock*> findLoopBody(SSABasicBlock *header) {
+        set<SSABasicBlock*> body;
+        vector<SSABasicBlock*> unscaned;
+        for (auto pred : header->preds) {
+            if (pred->rpoIndex >= 0 && m_func->dominates(header, pred)) unscaned.push_back(pred);
+        }
+        if (unscaned.empty()) return vector<SSABasicBlock*>();
+
+        body.insert(header);
+        while (!unscaned.empty()) {
+            SSABasicBlock *block = unscaned.back();
+            unscaned.pop_back();
+            if (!body.insert(block).second) continue;
+            for (auto pred : block->preds) unscaned.push_back(pred);
+        }
+        vector<SSABasicBlock*> r(body.begin(), body.end());
+        sort(r.begin(), r.end(), [](SSABasicBlock *a, SSABasicBlock *b){ return a->rpoIndex < b->rpoIndex; });
+        return r;
+    }
+    bool isHoistable(SSAInstruction *ins, const set<SSABasicBlock*> &body) {
+        if (!ins->isPure() || ins->op == SSAOC_Const) return false;
+        if (ins->op == SSAOC_Div || ins->op == SSAOC_Mod) {
+            // it may run where it didn't before, so it must not trap
+            int n;
+            if (!ins->operands[1]->tryGetInt(n) || n == 0 || n == -1) return false;
+        }
+        for (auto operand : ins->operands) {
+            if (body.count(operand->block) > 0) return false;
+        }
+        return true;
+    }
+    void hoistLoop(SSABasicBlock *header, const vector<SSABasicBlock*> &bodyBlocks) {
+        set<SSABasicBlock*> body(bodyBlocks.begin(), bodyBlocks.end());
+        vector<SSAInstruction*> invariants;
+        for (auto block : bodyBlocks) {
+            for (auto ins : vector<SSAInstruction*>(block->instructions)) {
+                if (!isHoistable(ins, body)) continue;
+                // later instructions see it as outside the loop already
+                m_func->removeInstruction(ins);
+                invariants.push_back(ins);
+            }
+        }
+        if (invariants.empty()) return;
+
+        SSABasicBlock *preheader = getPreheader(header, body);
+        for (auto ins : invariants) m_func->insertBeforeTerminator(preheader, ins);
+        m_changeCount += (int)invariants.size();
+    }
+    SSABasicBlock* getPreheader(SSABasicBlock *header, const set<SSABasicBlock*> &body) {
+        vector<int> outsides, insides;
+        for (int i = 0; i < (int)header->preds.size(); ++i) {
+            if (body.count(header->preds[i]) > 0) insides.push_back(i);
+            else outsides.push_back(i);
+        }
+        ASSERT(!outsides.empty());
+        if (outsides.size() == 1 && header->preds[outsides[0]]->succs.size() == 1) return header->preds[outsides[0]];
+
+        SSABasicBlock *preheader = m_func->createBasicBlock("label_preheader");
+        preheader->rpoIndex = header->rpoIndex;
+        for (auto ins : vector<SSAInstruction*>(header->instructions)) {
+            if (ins->op != SSAOC_Phi) break;
+            SSAInstruction *outsideValue = ins->operands[outsides[0]];
+            if (outsides.size() > 1) {
+                outsideValue = m_func->createInstruction(SSAOC_Phi);
+                for (auto i : outsides) outsideValue->operands.push_back(ins->operands[i]);
+                m_func->pushInstruction(preheader, outsideValue);
+            }
+            vector<SSAInstruction*> operands;
+            for (auto i : insides) operands.push_back(ins->operands[i]);
+            operands.push_back(outsideValue);
+            ins->operands = operands;
+        }
+
+        vector<SSABasicBlock*> preds;
+        for (auto i : insides) preds.push_back(header->preds[i]);
+        for (auto i : outsides) {
+            SSABasicBlock *pred = header->preds[i];
+            *find(pred->succs.begin(), pred->succs.end(), header) = preheader;
+            preheader->preds.push_back(pred);
+        }
+        preds.push_back(preheader);
+        header->preds = preds;
+        preheader->succs.push_back(header);
+        m_func->pushInstruction(preheader, m_func->createInstruction(SSAOC_Jmp));
+        return preheader;
+    }
+private:
+    SSAFunction *m_func;
+    int m_changeCount;
+};
+//==============================
+class SSAOptimizer_DeadCodeCleaner {
+public:
+    SSAOptimizer_DeadCodeCleaner(SSAFunction *func): m_changeCount(0) {
+        set<SSAInstruction*> live;
+        vector<SSAInstruction*> unscaned;
+        for (auto block : func->getBasicBlocks()) {
+            for (auto ins : block->instructions) {
+                if (ins->isTerminator() || ins->op == SSAOC_StoreGlobal || ins->op == SSAOC_Call) unscaned.push_back(ins);
+            }
+        }
+        while (!unscaned.empty()) {
+            SSAInstruction *ins = unscaned.back();
+            unscaned.pop_back();
+            if (!live.insert(ins).second) continue;
+            unscaned.insert(unscaned.end(), ins->operands.begin(), ins->operands.end());
+        }
+
+        for (auto block : func->getBasicBlocks()) {
+            vector<SSAInstruction*> instructions;
+            for (auto ins : block->instructions) {
+                if (live.count(ins) > 0) instructions.push_back(ins);
+                else {
+                    ins->block = NULL;
+                    ++m_changeCount;
+                }
+            }
+            block->instructions.swap(instructions);
+        }
+    }
+    int getChangeCount() const { return m_changeCount; }
+private:
+    int m_changeCount;
+};
+//==============================
+void SSAOptimizeStats::dump(ostream &so) {
+    static const char *names[] = {"copy propagation", "sccp", "gvn", "licm", "dead code"};
+    static_assert(sizeof(names) / sizeof(names[0]) == SSAOT_Count, "");
+    for (int i = 0; i < SSAOT_Count; ++i) {
+        so << format("%-16s: %6d changes, %.3fms\n", names[i], changeCounts[i], seconds[i] * 1000);
+    }
+    so << format("%-16s: %6d vregs, %d spilled\n", "register alloc", vregCount, spillCount);
+}
+
+void optimizeSSA(SSAFunction *func, BEConstantPool *constantPool, int optTypeFlag, SSAOptimizeStats *stats) {
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < SSAOT_Count; ++i) {
+            if (((1 << i) & optTypeFlag) == 0) continue;
+            clock_t start = clock();
+            int changeCount = 0;
+            switch (1 << i) {
+                case SSAOT_CopyPropagation: changeCount = SSAOptimizer_CopyPropagation(func).getChangeCount(); break;
+                case SSAOT_SCCP: changeCount = SSAOptimizer_SCCP(func, constantPool).getChangeCount(); break;
+                case SSAOT_GVN: changeCount = SSAOptimizer_GVN(func).getChangeCount(); break;
+                case SSAOT_LICM: changeCount = SSAOptimizer_LICM(func).getChangeCount(); break;
+                case SSAOT_DeadCode: changeCount = SSAOptimizer_DeadCodeCleaner(func).getChangeCount(); break;
+                default: ASSERT(0); break;
+            }
+            if (stats != NULL) {
+                stats->changeCounts[i] += changeCount;
+                stats->seconds[i] += double(clock() - start) / CLOCKS_PER_SEC;
+            }
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef SSA_OPTIMIZER_H
+#define SSA_OPTIMIZER_H
+
+class SSAFunction;
+class BEConstantPool;
+
+enum SSAOptimizeType {
+    SSAOT_CopyPropagation = 1 << 0,
+    SSAOT_SCCP = 1 << 1, // sparse conditional constant propagation
+    SSAOT_GVN = 1 << 2, // global value numbering
+    SSAOT_LICM = 1 << 3, // loop invariant code motion
+    SSAOT_DeadCode = 1 << 4,
+
+    SSAOT_All = 0x1f,
+    SSAOT_Count = 5,
+};
+
+struct SSAOptimizeStats {
+    int changeCounts[SSAOT_Count];
+    double seconds[SSAOT_Count];
+    int vregCount, spillCount; // filled by the register allocator
+    SSAOptimizeStats(): vregCount(0), spillCount(0) {
+        for (int i = 0; i < SSAOT_Count; ++i) changeCounts[i] = 0, seconds[i] = 0;
+    }
+    void dump(ostream &so);
+};
+
+void optimizeSSA(SSAFunction *func, BEConstantPool *constantPool, int optTypeFlag, SSAOptimizeStats *stats);
+
+#endif
@@ -6,28 +6,35 @@
 #include "ASTOptimizer.h"
 #include "BEx86FileBuilder.h"
 #include "BEx86CodeGenerator.h"
+#include "BEx86SSACodeGenerator.h"
+#include "SSAOptimizer.h"
 #include "BEx86CodeOptimizer.h"
 #include "BEx86ASMSerializer.h"
 #include "BEx86JITEngine.h"
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
-        printf("%s file [-O] [-v]\n" 
+        printf("%s file [-O] [-v] [-JIT] [-SSA] [-stat]\n" 
              "-O: optimize\n"
              "-v: dump bytecode\n"
-             "-JIT: directly run with JIT\n", argv[0]);
+             "-JIT: directly run with JIT\n"
+             "-SSA: generate code through SSA and graph coloring register allocation\n"
+             "-stat: print SSA optimization statistics\n", argv[0]);
         return 0;
     }
 
     bool isOptimize = false;
     bool isDumpByteCode = false;
     bool isJIT = false;
+    bool isSSA = false;
+    bool isStat = false;
     for (int i = 2; i < argc; ++i) {
         if (argv[i] == string("-v")) isDumpByteCode = true;
         else if (argv[i] == string("-O")) isOptimize = true;
         else if (argv[i] == string("-JIT")) isJIT = true;
+        else if (argv[i] == string("-SSA")) isSSA = true;
+        else if (argv[i] == string("-stat")) isStat = true;
     }
-    (void)isDumpByteCode;
 
 
 #ifdef CHECK_MEMORY_LEAKS
@@ -49,7 +56,13 @@ int main(int argc, char *argv[]) {
 #ifdef __APPLE__
         builder->getBuildConfig()->stackAlignment = 16;
 #endif
-        generatex86Code(builder.get(), fileProto.get());
+        if (isSSA) {
+            SSAOptimizeStats stats;
+            generatex86CodeFromSSA(builder.get(), fileProto.get(), isOptimize ? SSAOT_All : 0, &stats, isDumpByteCode ? &cout : NULL);
+            if (isStat) stats.dump(cout);
+        } else {
+            generatex86Code(builder.get(), fileProto.get());
+        }
 
         if (isOptimize) optimizex86Code(builder.get(), x86IOT_All);
 
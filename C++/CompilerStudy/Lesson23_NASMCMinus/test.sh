@@ -0,0 +1,26 @@
+#! /bin/bash
+
+# runs every test/*.c through the JIT with each back end, with and without -O, and diffs the outputs
+# against the same program built by the host C compiler as the reference
+
+set -e
+
+cc=${CC:-gcc}
+failed=0
+for srcfile in test/*.c; do
+    if [ $srcfile = test/performance.c ]; then continue; fi
+    $cc -w -include stdbool.h -x c $srcfile -o __reference.exe
+    ./__reference.exe | grep -v "times:" > __expected.txt
+    for flags in "" "-O" "-SSA" "-O -SSA"; do
+        ./main $srcfile -JIT $flags | grep -v "times:" > __actual.txt
+        if diff __expected.txt __actual.txt; then
+            echo "ok $srcfile -JIT $flags"
+        else
+            echo "FAILED $srcfile -JIT $flags"
+            failed=1
+        fi
+    done
+done
+
+rm -f __reference.exe __expected.txt __actual.txt
+exit $failed
@@ -0,0 +1,37 @@
+extern int printf(char* fmt, ...);
+
+// branches whose conditions fold to constants, only after other values fold
+int constBranch(int n) {
+    int x = 4, y = 0;
+    if (x > 3) y = 10;
+    else y = n;
+    return y;
+}
+int constElse(int n) {
+    int x = 4 * 2 - 8, y = 0;
+    if (x) y = n;
+    else y = 20;
+    return y;
+}
+int constLoop(int n) {
+    int s = 0, step = 2 + 1;
+    for (int i = 0; i < 10; ++i) {
+        if (step == 3) s = s + i;
+        else s = s + n;
+    }
+    return s;
+}
+int constPhi(int n) {
+    int a = 5, b = 0;
+    if (n > 0) b = a + 1;
+    else b = 12 / 2;
+    if (b != 6) return n;
+    return b * 7;
+}
+int main() {
+    printf("constBranch %d\n", constBranch(99));
+    printf("constElse %d\n", constElse(99));
+    printf("constLoop %d\n", constLoop(99));
+    printf("constPhi %d,%d\n", constPhi(1), constPhi(-1));
+    return 0;
+}
@@ -10,6 +10,7 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <algorithm>
 using namespace std;
 //============================== 
 #define _TO_STRING(e) #e
@@ -89,7 +90,7 @@ static map<string, Token> setupBuildinTokens() {
         "int", "string", "void",
         "true", "false",
     };
-    for (int i = 0; i < ARRAY_SIZE(lexemes); ++i) tokens[lexemes[i]] = Token((TokenID)i);
+    for (int i = 0; i < (int)ARRAY_SIZE(lexemes); ++i) tokens[lexemes[i]] = Token((TokenID)i);
     return tokens; 
 }
 static Token* getBuildinToken(const string &lexeme) {
@@ -223,232 +224,741 @@ static char* os_findSymbol(const char *funcName) {
 }
 #endif
 //============================== code generator
-#define MAX_TEXT_SECTION_SIZE (4096 * 8)
+// FunctionParser drives x64FunctionBuilder like a stack machine, the builder records it as IR on
+// virtual registers, then optimizes, allocates registers by linear scan and emits x86-64 SysV code.
+#define MAX_TEXT_SECTION_SIZE (4096 * 16)
 #define MAX_LOCAL_COUNT 64
-class x86FunctionBuilder;
-class x86JITEngine {
+#define REG_ARG_COUNT 6
+class x64FunctionBuilder;
+class x64JITEngine {
 public:
-    x86JITEngine(): m_textSectionSize(0) {
+    x64JITEngine(): m_textSectionSize(0), m_allocRegisters(true) {
         m_textSection = os_mallocExecutable(MAX_TEXT_SECTION_SIZE);
     }
-    ~x86JITEngine() { os_freeExecutable(m_textSection); }
+    ~x64JITEngine() { os_freeExecutable(m_textSection); }
     char* getFunction(const string &name) { return *_getFunctionEntry(name); }
+    // without register allocation every value lives in the stack frame, like the old stack machine code
+    void setAllocRegisters(bool b) { m_allocRegisters = b; }
+    bool getAllocRegisters() const { return m_allocRegisters; }
 
     void beginBuild();
     char** _getFunctionEntry(const string &name) { return &m_funcEntries[name]; }
     const char* _getLiteralStringLoc(const string &literalStr) { return m_literalStrs.insert(literalStr).first->c_str();}
-    x86FunctionBuilder* beginBuildFunction();
-    void endBuildFunction(x86FunctionBuilder *builder);
+    x64FunctionBuilder* beginBuildFunction();
+    void endBuildFunction(x64FunctionBuilder *builder);
     void endBuild();
 private:
     char *m_textSection;
     int m_textSectionSize;
+    bool m_allocRegisters;
     map<string, char*> m_funcEntries;
     set<string> m_literalStrs;
 };
-class x86Label { 
+class IRLabel {
 public:
-    x86Label(): m_address(NULL){}
-    ~x86Label() { ASSERT(m_address != NULL); }
-    void mark(char *address) {
-        ASSERT(m_address == NULL);
-        m_address = address;
-        bindRefs();
-    }
-    void addRef(char *ref) {
-        m_refs.push_back(ref);
-        bindRefs();
-    }
-private:
-    void bindRefs() {
-        if (m_address == NULL) return;
-        for (int i = 0; i < (int)m_refs.size(); ++i) {
-            *(int*)m_refs[i] = int(m_address - (m_refs[i] + 4));
-        }
-        m_refs.clear();
-    }
-private:
-    char *m_address;
-    vector<char*> m_refs;
+    IRLabel(): id(-1) {}
+    int id;
+};
+enum IROpCode {
+    IOC_Args, // args = arguments
+    IOC_Imm, // dst = imm
+    IOC_Mov, // dst = a
+    IOC_Arith, // dst = a tid b
+    IOC_Cmp, // dst = a tid b ? 1 : 0
+    IOC_Label,
+    IOC_Jmp,
+    IOC_JmpIf, // if ((a != 0) == jmpIfTrue) goto label
+    IOC_Ret, // return a
+    IOC_Call, // dst = entry(args...)
 };
-class x86FunctionBuilder {
+struct IRInstr {
+    IROpCode op;
+    TokenID tid;
+    int dst, a, b;
+    bool bIsImm, jmpIfTrue, is64;
+    long long imm;
+    int label;
+    char **entry;
+    vector<int> args;
+    IRInstr(IROpCode _op): op(_op), tid(TID_EOF), dst(-1), a(-1), b(-1), bIsImm(false), jmpIfTrue(false), is64(false), imm(0), label(-1), entry(NULL) {}
+};
+enum x64Reg { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15, };
+// the arguments after these are passed on the stack, the 7th at the lowest address
+static const int ARG_REGS[REG_ARG_COUNT] = { RDI, RSI, RDX, RCX, R8, R9, };
+// rax, rdx and r11 are scratch registers of the emitter
+static const int CALLER_SAVED_REGS[] = { RCX, RSI, RDI, R8, R9, R10, };
+static const int CALLEE_SAVED_REGS[] = { RBX, R12, R13, R14, R15, };
+class x64FunctionBuilder {
 public:
-    x86FunctionBuilder(x86JITEngine *parent, char *codeBuf): m_parent(parent), m_codeBuf(codeBuf), m_codePtr(codeBuf) {}
+    x64FunctionBuilder(x64JITEngine *parent): m_parent(parent), m_vregCount(0), m_reachable(true) {}
     string& getFuncName() { return m_funcName;}
-    int getCodeSize() const{ return m_codePtr - m_codeBuf;}
+    const vector<char>& getCode() const { return m_code; }
 
     void beginBuild(){
-        emit(0x52, -1); // push edx
-        emit(0x55, -1); // push ebp
-        emit(0x8b, 0xec, -1); // mov ebp, esp
-        emit(0x81, 0xec, -1); emitValue(MAX_LOCAL_COUNT * 4); // sub esp, MAX_LOCAL_COUNT * 4
+        m_instrs.push_back(IRInstr(IOC_Args));
     }
     void endBuild(){
-        markLabel(&m_retLabel);
-        emit(0x8b, 0xe5, -1);  // mov esp,ebp 
-        emit(0x5d, -1); // pop ebp  
-        emit(0x5a, -1); // pop edx  
-        emit(0xc3, -1); // ret
+        IRInstr &args = m_instrs[0];
+        for (int i = 0; ; ++i) {
+            map<int, int>::iterator iter = m_localVRegs.find(-(i + 1));
+            if (iter == m_localVRegs.end()) break;
+            args.args.push_back(iter->second);
+        }
+        m_instrs.push_back(IRInstr(IOC_Ret));
+
+        optimize();
+        allocRegisters();
+        emitFunction();
     }
 
     void loadImm(int imm){
-        emit(0x68, -1); emitValue(imm); // push imm
+        IRInstr &instr = pushInstr(IOC_Imm, pushValue());
+        instr.imm = imm;
     }
     void loadLiteralStr(const string &literalStr){
-        const char *loc = m_parent->_getLiteralStringLoc(literalStr);
-        emit(0x68, -1); emitValue(loc); // push loc
+        IRInstr &instr = pushInstr(IOC_Imm, pushValue());
+        instr.imm = (long long)m_parent->_getLiteralStringLoc(literalStr);
+        instr.is64 = true;
     }
     void loadLocal(int idx){
-        emit(0xff, 0xb5, -1); emitValue(localIdx2EbpOff(idx)); // push dword ptr [ebp + idxOff]
+        pushInstr(IOC_Mov, pushValue()).a = getLocalVReg(idx);
     }
     void storeLocal(int idx) {
-        emit(0x8b, 0x04, 0x24, -1); // mov eax, dword ptr [esp]
-        emit(0x89, 0x85, -1); emitValue(localIdx2EbpOff(idx)); // mov dword ptr [ebp + idxOff], eax
-        emit(0x83, 0xc4, -1); emitValue((char)4); // add esp, 4
+        pushInstr(IOC_Mov, getLocalVReg(idx)).a = popVReg();
     }
     void incLocal(int idx) {
-        emit(0xff, 0x85, -1); emitValue(localIdx2EbpOff(idx)); // inc dword ptr [ebp + idxOff]
+        IRInstr &instr = pushInstr(IOC_Arith, getLocalVReg(idx));
+        instr.tid = TID_OP_ADD, instr.a = instr.dst, instr.bIsImm = true, instr.imm = 1;
     }
     void decLocal(int idx) {
-        emit(0xff, 0x8d, -1); emitValue(localIdx2EbpOff(idx)); // dec dword ptr [ebp + idxOff]
+        IRInstr &instr = pushInstr(IOC_Arith, getLocalVReg(idx));
+        instr.tid = TID_OP_SUB, instr.a = instr.dst, instr.bIsImm = true, instr.imm = 1;
     }
     void pop(int n){
-        emit(0x81, 0xc4, -1); emitValue(n * 4); // add esp, n * 4
+        m_stack.resize(m_stack.size() - n);
     }
     void dup(){
-        emit(0xff, 0x34, 0x24, -1); // push dword ptr [esp]
+        m_stack.push_back(m_stack.back());
     }
 
     void doArithmeticOp(TokenID opType) {
-        emit(0x8b, 0x44, 0x24, 0x04, -1); // mov eax, dword ptr [esp+4]
-        switch (opType) {
-            case TID_OP_ADD: 
-                emit(0x03, 0x04, 0x24, -1); // add eax, dword ptr [esp]
-                break;
-            case TID_OP_SUB: 
-                emit(0x2b, 0x04, 0x24, -1); // sub eax, dword ptr [esp]
-                break;
-            case TID_OP_MUL: 
-                emit(0x0f, 0xaf, 0x04, 0x24, -1); // imul eax, dword ptr [esp]
-                break;
-            case TID_OP_DIV: 
-            case TID_OP_MOD: 
-                emit(0x33, 0xd2, -1); // xor edx, edx
-                emit(0xf7, 0x3c, 0x24, -1); // idiv dword ptr [esp]
-                if (opType == TID_OP_MOD) {
-                    emit(0x8b, 0xc2, -1); // mov eax, edx
-                }
-                break;  
-            default: ASSERT(0); break;
-        }
-        emit(0x89, 0x44, 0x24, 0x04, -1); // mov dword ptr [esp+4], eax
-        emit(0x83, 0xc4, 0x04, -1); // add esp, 4
+        int b = popVReg(), a = popVReg();
+        IRInstr &instr = pushInstr(IOC_Arith, pushValue());
+        instr.tid = opType, instr.a = a, instr.b = b;
     }
     void cmp(TokenID cmpType) {
-        x86Label label_1, label_0, label_end;
-        emit(0x8b, 0x44, 0x24, 0x04, -1); // mov eax, dword ptr [esp+4] 
-        emit(0x8b, 0x14, 0x24, -1); // mov edx, dword ptr[esp]
-        emit(0x83, 0xc4, -1); emitValue((char)8);// add esp, 8
-        emit(0x3b, 0xc2, -1); // cmp eax, edx
-        condJmp(cmpType, &label_1);
-        jmp(&label_0);
-        markLabel(&label_1);
-        emit(0x6a, 0x01, -1); // push 1
-        jmp(&label_end);
-        markLabel(&label_0);
-        emit(0x6a, 0x00, -1); // push 0
-        markLabel(&label_end);
-    }
-
-    void markLabel(x86Label *label){ label->mark(m_codePtr); }
-    void jmp(x86Label *label) { 
-        emit(0xe9, -1);
-        char *ref = m_codePtr;
-        emitValue(NULL);
-        label->addRef(ref); 
-    }
-    void trueJmp(x86Label *label) {
-        emit(0x8b, 0x04, 0x24, -1); // mov eax, dword ptr [esp]
-        emit(0x83, 0xc4, 0x04, -1); // add esp, 4
-        emit(0x85, 0xc0, -1); // test eax, eax
-        condJmp(TID_OP_NEQUAL, label); 
-    }
-    void falseJmp(x86Label *label) {
-        emit(0x8b, 0x04, 0x24, -1); // mov eax, dword ptr [esp]
-        emit(0x83, 0xc4, 0x04, -1); // add esp, 4
-        emit(0x85, 0xc0, -1); // test eax, eax
-        condJmp(TID_OP_EQUAL, label); 
-    }
-    void ret() { jmp(&m_retLabel); }
+        int b = popVReg(), a = popVReg();
+        IRInstr &instr = pushInstr(IOC_Cmp, pushValue());
+        instr.tid = cmpType, instr.a = a, instr.b = b;
+    }
+
+    void markLabel(IRLabel *label){
+        int id = getLabelID(label);
+        if (m_reachable) mergeStack(id);
+        m_labelStackSet[id] = true;
+        m_stack = m_labelStacks[id];
+        m_reachable = true;
+        pushInstr(IOC_Label, -1).label = id;
+    }
+    void jmp(IRLabel *label) {
+        int id = getLabelID(label);
+        mergeStack(id);
+        pushInstr(IOC_Jmp, -1).label = id;
+        m_reachable = false;
+    }
+    void trueJmp(IRLabel *label) {
+        condJmp(label, true);
+    }
+    void falseJmp(IRLabel *label) {
+        condJmp(label, false);
+    }
+    void ret() {
+        pushInstr(IOC_Ret, -1);
+        m_reachable = false;
+    }
     void retExpr() {
-        emit(0x8b, 0x04, 0x24, -1); // mov eax, dword ptr [esp]
-        emit(0x83, 0xc4, 0x04, -1); // add esp, 4
-        jmp(&m_retLabel);
+        pushInstr(IOC_Ret, -1).a = popVReg();
+        m_reachable = false;
     }
 
     int beginCall(){
-        return 0;
+        return (int)m_stack.size();
     }
     void endCall(const string &funcName, int callID, int paramCount){
-        char ** entry = m_parent->_getFunctionEntry(funcName);
-        for (int i = 0; i < paramCount - 1; ++i) {
-            emit(0xff, 0xb4, 0x24, -1); emitValue(((i + 1) * 2 - 1) * 4); // push dword ptr [esp+4*i]
+        ASSERT(callID + paramCount == (int)m_stack.size());
+        vector<int> args(m_stack.end() - paramCount, m_stack.end());
+        pop(paramCount);
+        IRInstr &instr = pushInstr(IOC_Call, pushValue());
+        instr.entry = m_parent->_getFunctionEntry(funcName);
+        instr.args = args;
+    }
+private:
+    int newVReg() { return m_vregCount++; }
+    int popVReg() {
+        int r = m_stack.back();
+        m_stack.pop_back();
+        return r;
+    }
+    int getLocalVReg(int idx) {
+        map<int, int>::iterator iter = m_localVRegs.find(idx);
+        if (iter != m_localVRegs.end()) return iter->second;
+        if (idx < 0) {
+            for (int i = -1; i > idx; --i) getLocalVReg(i);
         }
-        emit(0xff, 0x15, -1); emitValue(entry); // call [entry]
-        pop(paramCount + (paramCount > 0 ? paramCount - 1 : 0));
-        emit(0x50, -1); // push eax
+        return m_localVRegs[idx] = newVReg();
+    }
+    int pushValue() {
+        m_stack.push_back(newVReg());
+        return m_stack.back();
+    }
+    IRInstr& pushInstr(IROpCode op, int dst) {
+        m_instrs.push_back(IRInstr(op));
+        m_instrs.back().dst = dst;
+        return m_instrs.back();
+    }
+    int getLabelID(IRLabel *label) {
+        if (label->id == -1) {
+            label->id = (int)m_labelStacks.size();
+            m_labelStacks.push_back(vector<int>());
+            m_labelStackSet.push_back(false);
+        }
+        return label->id;
+    }
+    // the operand stack has to be held in the same vregs by all the paths reaching a label
+    void mergeStack(int label) {
+        if (!m_labelStackSet[label]) {
+            m_labelStackSet[label] = true;
+            m_labelStacks[label] = m_stack;
+            return;
+        }
+        vector<int> &stack = m_labelStacks[label];
+        ASSERT(stack.size() == m_stack.size());
+        for (int i = 0; i < (int)stack.size(); ++i) {
+            if (stack[i] == m_stack[i]) continue;
+            m_instrs.push_back(IRInstr(IOC_Mov));
+            m_instrs.back().dst = stack[i], m_instrs.back().a = m_stack[i];
+        }
+    }
+    void condJmp(IRLabel *label, bool jmpIfTrue) {
+        int a = popVReg();
+        int id = getLabelID(label);
+        mergeStack(id);
+        IRInstr &instr = pushInstr(IOC_JmpIf, -1);
+        instr.a = a, instr.label = id, instr.jmpIfTrue = jmpIfTrue;
     }
 private:
+    static bool isBlockEnd(const IRInstr &instr) {
+        return instr.op == IOC_Jmp || instr.op == IOC_JmpIf || instr.op == IOC_Ret;
+    }
+    static void getUses(const IRInstr &instr, vector<int> &uses) {
+        if (instr.op == IOC_Call) uses.insert(uses.end(), instr.args.begin(), instr.args.end());
+        if (instr.a != -1) uses.push_back(instr.a);
+        if (instr.b != -1 && !instr.bIsImm) uses.push_back(instr.b);
+    }
+    static void getDefs(const IRInstr &instr, vector<int> &defs) {
+        if (instr.op == IOC_Args) defs.insert(defs.end(), instr.args.begin(), instr.args.end());
+        if (instr.dst != -1) defs.push_back(instr.dst);
+    }
+    void countDefUses(vector<int> &defCounts, vector<int> &useCounts) {
+        defCounts.assign(m_vregCount, 0);
+        useCounts.assign(m_vregCount, 0);
+        vector<int> v;
+        for (int i = 0; i < (int)m_instrs.size(); ++i) {
+            v.clear(); getUses(m_instrs[i], v);
+            for (int j = 0; j < (int)v.size(); ++j) ++useCounts[v[j]];
+            v.clear(); getDefs(m_instrs[i], v);
+            for (int j = 0; j < (int)v.size(); ++j) ++defCounts[v[j]];
+        }
+    }
+    // the index of the only use of vreg following instruction i in its block, or -1
+    int findUseInBlock(int i, int vreg, int redefinedVReg) {
+        vector<int> v;
+        for (int j = i + 1; j < (int)m_instrs.size() && m_instrs[j].op != IOC_Label; ++j) {
+            v.clear(); getUses(m_instrs[j], v);
+            if (find(v.begin(), v.end(), vreg) != v.end()) return j;
+            v.clear(); getDefs(m_instrs[j], v);
+            if (find(v.begin(), v.end(), redefinedVReg) != v.end()) return -1;
+            if (isBlockEnd(m_instrs[j])) return -1;
+        }
+        return -1;
+    }
+    static void replaceUse(IRInstr &instr, int from, int to) {
+        if (instr.a == from) instr.a = to;
+        if (instr.b == from && !instr.bIsImm) instr.b = to;
+        replace(instr.args.begin(), instr.args.end(), from, to);
+    }
+    void optimize() {
+        vector<int> defCounts, useCounts;
+        for (bool changed = true; changed; ) {
+            changed = false;
+            countDefUses(defCounts, useCounts);
+            for (int i = 0; i < (int)m_instrs.size(); ++i) {
+                IRInstr &instr = m_instrs[i];
+                if (instr.op == IOC_Args || instr.op == IOC_Call || instr.op == IOC_Label || isBlockEnd(instr)) continue;
+                if (useCounts[instr.dst] == 0) {
+                    // dead value
+                    m_instrs.erase(m_instrs.begin() + i--);
+                    changed = true;
+                    continue;
+                }
+                if (defCounts[instr.dst] != 1 || useCounts[instr.dst] != 1) continue;
+                if (i + 1 < (int)m_instrs.size() && m_instrs[i + 1].op == IOC_Mov && m_instrs[i + 1].a == instr.dst) {
+                    // t = op ...; local = t  =>  local = op ...
+                    instr.dst = m_instrs[i + 1].dst;
+                    m_instrs.erase(m_instrs.begin() + i + 1);
+                    changed = true;
+                    break;
+                }
+                if (instr.op == IOC_Mov) {
+                    // t = local; ... op t ...  =>  ... op local ...
+                    int j = findUseInBlock(i, instr.dst, instr.a);
+                    if (j == -1) continue;
+                    replaceUse(m_instrs[j], instr.dst, instr.a);
+                    m_instrs.erase(m_instrs.begin() + i);
+                    changed = true;
+                    break;
+                }
+                if (instr.op == IOC_Imm && !instr.is64) {
+                    // t = imm; a op t  =>  a op imm
+                    int j = findUseInBlock(i, instr.dst, -1);
+                    if (j == -1) continue;
+                    IRInstr &user = m_instrs[j];
+                    if ((user.op != IOC_Arith && user.op != IOC_Cmp) || user.bIsImm) continue;
+                    if (user.a == instr.dst && user.b != instr.dst) {
+                        if (user.op == IOC_Cmp) user.tid = mirrorCmp(user.tid);
+                        else if (user.tid != TID_OP_ADD && user.tid != TID_OP_MUL) continue;
+                        swap(user.a, user.b);
+                    }
+                    if (user.b != instr.dst || user.a == instr.dst) continue;
+                    if (user.tid == TID_OP_DIV || user.tid == TID_OP_MOD) continue;
+                    user.bIsImm = true, user.imm = instr.imm;
+                    m_instrs.erase(m_instrs.begin() + i);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    static TokenID mirrorCmp(TokenID tid) {
+        switch (tid) {
+            case TID_OP_LESS: return TID_OP_GREATER;
+            case TID_OP_LESSEQ: return TID_OP_GREATEREQ;
+            case TID_OP_GREATER: return TID_OP_LESS;
+            case TID_OP_GREATEREQ: return TID_OP_LESSEQ;
+            default: return tid;
+        }
+    }
+private:
+    // live ranges are [first, last] instruction index, widened over blocks by liveness
+    void computeLiveRanges(vector<int> &starts, vector<int> &ends) {
+        int n = (int)m_instrs.size();
+        vector<int> blockStarts, labelBlocks(m_labelStacks.size(), -1);
+        for (int i = 0; i < n; ++i) {
+            if (i == 0 || m_instrs[i].op == IOC_Label || isBlockEnd(m_instrs[i - 1])) blockStarts.push_back(i);
+            if (m_instrs[i].op == IOC_Label) labelBlocks[m_instrs[i].label] = (int)blockStarts.size() - 1;
+        }
+        int blockCount = (int)blockStarts.size();
+        blockStarts.push_back(n);
+
+        vector<vector<bool> > uses(blockCount, vector<bool>(m_vregCount)), defs(uses), liveIns(uses), liveOuts(uses);
+        vector<vector<int> > succs(blockCount);
+        vector<int> v;
+        for (int b = 0; b < blockCount; ++b) {
+            for (int i = blockStarts[b]; i < blockStarts[b + 1]; ++i) {
+                v.clear(); getUses(m_instrs[i], v);
+                for (int j = 0; j < (int)v.size(); ++j) if (!defs[b][v[j]]) uses[b][v[j]] = true;
+                v.clear(); getDefs(m_instrs[i], v);
+                for (int j = 0; j < (int)v.size(); ++j) defs[b][v[j]] = true;
+            }
+            const IRInstr &last = m_instrs[blockStarts[b + 1] - 1];
+            if (last.op == IOC_Jmp || last.op == IOC_JmpIf) succs[b].push_back(labelBlocks[last.label]);
+            if (last.op != IOC_Jmp && last.op != IOC_Ret && b + 1 < blockCount) succs[b].push_back(b + 1);
+        }
+        for (bool changed = true; changed; ) {
+            changed = false;
+            for (int b = blockCount - 1; b >= 0; --b) {
+                for (int r = 0; r < m_vregCount; ++r) {
+                    bool out = false;
+                    for (int s = 0; s < (int)succs[b].size() && !out; ++s) out = liveIns[succs[b][s]][r];
+                    bool in = uses[b][r] || (out && !defs[b][r]);
+                    if (out != liveOuts[b][r] || in != liveIns[b][r]) changed = true;
+                    liveOuts[b][r] = out, liveIns[b][r] = in;
+                }
+            }
+        }
+
+        starts.assign(m_vregCount, n);
+        ends.assign(m_vregCount, -1);
+        for (int i = 0; i < n; ++i) {
+            v.clear(); getUses(m_instrs[i], v); getDefs(m_instrs[i], v);
+            for (int j = 0; j < (int)v.size(); ++j) {
+                starts[v[j]] = min(starts[v[j]], i);
+                ends[v[j]] = max(ends[v[j]], i);
+            }
+        }
+        for (int b = 0; b < blockCount; ++b) {
+            for (int r = 0; r < m_vregCount; ++r) {
+                if (liveIns[b][r]) starts[r] = min(starts[r], blockStarts[b]);
+                if (liveOuts[b][r]) ends[r] = max(ends[r], blockStarts[b + 1] - 1);
+            }
+        }
+    }
+    struct LiveRangeStartLess {
+        const vector<int> *starts;
+        bool operator () (int a, int b) const { return (*starts)[a] < (*starts)[b]; }
+    };
+    void allocRegisters() {
+        vector<int> starts, ends;
+        computeLiveRanges(starts, ends);
+        m_locs.assign(m_vregCount, -1);
+        m_usedCalleeSaved.clear();
+        m_spillSlotCount = 0;
+
+        vector<int> callPoses;
+        for (int i = 0; i < (int)m_instrs.size(); ++i) {
+            if (m_instrs[i].op == IOC_Call) callPoses.push_back(i);
+        }
+        vector<int> ranges;
+        for (int r = 0; r < m_vregCount; ++r) {
+            if (ends[r] >= 0) ranges.push_back(r);
+        }
+        LiveRangeStartLess less = { &starts };
+        stable_sort(ranges.begin(), ranges.end(), less);
+
+        vector<int> active;
+        vector<bool> freeRegs(16, false);
+        for (int i = 0; i < (int)ARRAY_SIZE(CALLER_SAVED_REGS); ++i) freeRegs[CALLER_SAVED_REGS[i]] = true;
+        for (int i = 0; i < (int)ARRAY_SIZE(CALLEE_SAVED_REGS); ++i) freeRegs[CALLEE_SAVED_REGS[i]] = true;
+        for (int i = 0; i < (int)ranges.size(); ++i) {
+            int r = ranges[i];
+            for (int j = 0; j < (int)active.size(); ++j) {
+                if (ends[active[j]] < starts[r]) {
+                    freeRegs[m_locs[active[j]]] = true;
+                    active.erase(active.begin() + j--);
+                }
+            }
+            if (!m_parent->getAllocRegisters()) {
+                m_locs[r] = -(++m_spillSlotCount);
+                continue;
+            }
+
+            bool crossCall = false;
+            for (int j = 0; j < (int)callPoses.size() && !crossCall; ++j) {
+                crossCall = starts[r] < callPoses[j] && callPoses[j] < ends[r];
+            }
+            int reg = -1;
+            for (int j = 0; j < (int)ARRAY_SIZE(CALLER_SAVED_REGS) && reg == -1 && !crossCall; ++j) {
+                if (freeRegs[CALLER_SAVED_REGS[j]]) reg = CALLER_SAVED_REGS[j];
+            }
+            for (int j = 0; j < (int)ARRAY_SIZE(CALLEE_SAVED_REGS) && reg == -1; ++j) {
+                if (freeRegs[CALLEE_SAVED_REGS[j]]) reg = CALLEE_SAVED_REGS[j];
+            }
+            if (reg == -1) {
+                // spill the active range which ends last, if it ends after r and its register suits r
+                int victim = -1;
+                for (int j = 0; j < (int)active.size(); ++j) {
+                    int a = active[j];
+                    if (crossCall && find(CALLEE_SAVED_REGS, CALLEE_SAVED_REGS + ARRAY_SIZE(CALLEE_SAVED_REGS), m_locs[a]) == CALLEE_SAVED_REGS + ARRAY_SIZE(CALLEE_SAVED_REGS)) continue;
+                    if (ends[a] > ends[r] && (victim == -1 || ends[a] > ends[victim])) victim = a;
+                }
+                if (victim == -1) {
+                    m_locs[r] = -(++m_spillSlotCount);
+                    continue;
+                }
+                reg = m_locs[victim];
+                m_locs[victim] = -(++m_spillSlotCount);
+                active.erase(find(active.begin(), active.end(), victim));
+            }
+            freeRegs[reg] = false;
+            m_locs[r] = reg;
+            active.push_back(r);
+            if (find(CALLEE_SAVED_REGS, CALLEE_SAVED_REGS + ARRAY_SIZE(CALLEE_SAVED_REGS), reg) != CALLEE_SAVED_REGS + ARRAY_SIZE(CALLEE_SAVED_REGS) &&
+                    find(m_usedCalleeSaved.begin(), m_usedCalleeSaved.end(), reg) == m_usedCalleeSaved.end()) {
+                m_usedCalleeSaved.push_back(reg);
+            }
+        }
+    }
+private:
+    void emitFunction() {
+        m_labelOffs.assign(m_labelStacks.size(), -1);
+        m_labelRefs.clear();
+
+        emit(0x55, -1); // push rbp
+        emit(0x48, 0x89, 0xe5, -1); // mov rbp, rsp
+        for (int i = 0; i < (int)m_usedCalleeSaved.size(); ++i) emitPushPop(0x50, m_usedCalleeSaved[i]);
+        // keep rsp 16 byte aligned at call sites
+        m_frameSize = m_spillSlotCount * 8 + (m_usedCalleeSaved.size() + m_spillSlotCount) % 2 * 8;
+        if (m_frameSize > 0) {
+            emit(0x48, 0x81, 0xec, -1); emitValue(m_frameSize); // sub rsp, frameSize
+        }
+
+        for (int i = 0; i < (int)m_instrs.size(); ++i) {
+            const IRInstr &instr = m_instrs[i];
+            switch (instr.op) {
+                case IOC_Args: {
+                        int regArgCount = min((int)instr.args.size(), REG_ARG_COUNT);
+                        for (int j = 0; j < regArgCount; ++j) emitPushPop(0x50, ARG_REGS[j]);
+                        for (int j = regArgCount - 1; j >= 0; --j) emitPopLoc(instr.args[j]);
+                        for (int j = regArgCount; j < (int)instr.args.size(); ++j) {
+                            emit(0x48, 0x8b, 0x85, -1); emitValue(16 + 8 * (j - REG_ARG_COUNT)); // mov rax, qword ptr [rbp + 16 + off]
+                            emitStore(instr.args[j], RAX);
+                        }
+                    } break;
+                case IOC_Imm:
+                    if (instr.is64) {
+                        emitRex(true, 0, RAX); emit(0xb8, -1); emitValue(instr.imm); // mov rax, imm64
+                        emitStore(instr.dst, RAX);
+                    } else if (isReg(instr.dst)) {
+                        emitRex(false, 0, reg(instr.dst)); emit(0xb8 + (reg(instr.dst) & 7), -1); emitValue((int)instr.imm); // mov r32, imm32
+                    } else {
+                        emit(0x48, 0xc7, 0x85, -1); emitValue(slotOff(instr.dst)); emitValue((int)instr.imm); // mov qword ptr [rbp + off], imm32
+                    }
+                    break;
+                case IOC_Mov:
+                    if (instr.dst == instr.a) break;
+                    if (isReg(instr.dst)) emitLoad(reg(instr.dst), instr.a);
+                    else emitStore(instr.dst, useReg(instr.a, RAX));
+                    break;
+                case IOC_Arith: emitArith(instr); break;
+                case IOC_Cmp:
+                    if (i + 1 < (int)m_instrs.size() && m_instrs[i + 1].op == IOC_JmpIf && m_instrs[i + 1].a == instr.dst && isDeadAfter(instr.dst, i + 1)) {
+                        // compare and branch
+                        emitCmp(instr);
+                        const IRInstr &jmpInstr = m_instrs[++i];
+                        int cc = getConditionCode(instr.tid);
+                        emitJcc(jmpInstr.jmpIfTrue ? cc : cc ^ 1, jmpInstr.label);
+                    } else {
+                        emitCmp(instr);
+                        emit(0x0f, 0x90 + getConditionCode(instr.tid), 0xc0, -1); // setcc al
+                        emit(0x0f, 0xb6, 0xc0, -1); // movzx eax, al
+                        emitStore(instr.dst, RAX);
+                    }
+                    break;
+                case IOC_Label: m_labelOffs[instr.label] = (int)m_code.size(); break;
+                case IOC_Jmp:
+                    if (i + 1 < (int)m_instrs.size() && m_instrs[i + 1].op == IOC_Label && m_instrs[i + 1].label == instr.label) break;
+                    emit(0xe9, -1);
+                    addLabelRef(instr.label);
+                    break;
+                case IOC_JmpIf: {
+                        int r = useReg(instr.a, RAX);
+                        emitRex(false, r, r); emit(0x85, 0xc0 | (r & 7) << 3 | (r & 7), -1); // test r32, r32
+                        emitJcc(instr.jmpIfTrue ? 0x5 : 0x4, instr.label);
+                    } break;
+                case IOC_Ret:
+                    if (instr.a != -1) emitLoad(RAX, instr.a);
+                    emit(0x48, 0x8d, 0x65, -1); emitValue((char)(-8 * (int)m_usedCalleeSaved.size())); // lea rsp, [rbp - calleeSavedSize]
+                    for (int j = (int)m_usedCalleeSaved.size() - 1; j >= 0; --j) emitPushPop(0x58, m_usedCalleeSaved[j]);
+                    emit(0x5d, -1); // pop rbp
+                    emit(0xc3, -1); // ret
+                    break;
+                case IOC_Call: {
+                        int regArgCount = min((int)instr.args.size(), REG_ARG_COUNT);
+                        int stackArgCount = (int)instr.args.size() - regArgCount;
+                        int stackArgSize = (stackArgCount + stackArgCount % 2) * 8;
+                        if (stackArgCount % 2) {
+                            emit(0x48, 0x83, 0xec, 0x08, -1); // sub rsp, 8
+                        }
+                        for (int j = (int)instr.args.size() - 1; j >= regArgCount; --j) emitPushLoc(instr.args[j]);
+                        for (int j = 0; j < regArgCount; ++j) emitPushLoc(instr.args[j]);
+                        for (int j = regArgCount - 1; j >= 0; --j) emitPushPop(0x58, ARG_REGS[j]);
+                        emit(0x49, 0xbb, -1); emitValue(instr.entry); // mov r11, entry
+                        emit(0x31, 0xc0, -1); // xor eax, eax, no vector register arguments for varargs
+                        emit(0x41, 0xff, 0x13, -1); // call qword ptr [r11]
+                        if (stackArgSize > 0) {
+                            emit(0x48, 0x81, 0xc4, -1); emitValue(stackArgSize); // add rsp, stackArgSize
+                        }
+                        emitStore(instr.dst, RAX);
+                    } break;
+                default: ASSERT(0); break;
+            }
+        }
+
+        for (int i = 0; i < (int)m_labelRefs.size(); ++i) {
+            int off = m_labelOffs[m_labelRefs[i].first], ref = m_labelRefs[i].second;
+            ASSERT(off != -1);
+            *(int*)&m_code[ref] = off - (ref + 4);
+        }
+    }
+    bool isDeadAfter(int vreg, int i) {
+        vector<int> v;
+        for (int j = 0; j < (int)m_instrs.size(); ++j) {
+            if (j == i) continue;
+            v.clear(); getUses(m_instrs[j], v);
+            if (find(v.begin(), v.end(), vreg) != v.end()) return false;
+        }
+        return true;
+    }
+    void emitArith(const IRInstr &instr) {
+        if (instr.tid == TID_OP_DIV || instr.tid == TID_OP_MOD) {
+            emitLoad(RAX, instr.a);
+            emit(0x99, -1); // cdq
+            if (isReg(instr.b)) {
+                emitRex(false, 0, reg(instr.b)); emit(0xf7, 0xf8 | (reg(instr.b) & 7), -1); // idiv r32
+            } else {
+                emit(0xf7, 0xbd, -1); emitValue(slotOff(instr.b)); // idiv dword ptr [rbp + off]
+            }
+            emitStore(instr.dst, instr.tid == TID_OP_DIV ? RAX : RDX);
+            return;
+        }
+
+        int rd = isReg(instr.dst) ? reg(instr.dst) : RAX;
+        if (!instr.bIsImm && isReg(instr.b) && reg(instr.b) == rd && instr.a != instr.b) {
+            if (instr.tid == TID_OP_ADD || instr.tid == TID_OP_MUL) {
+                emitAluRegLoc(instr.tid, rd, instr.a);
+            } else {
+                emitLoad(R11, instr.a);
+                emitAluRegLoc(instr.tid, R11, instr.b);
+                emitMovRegReg(rd, R11);
+            }
+        } else {
+            emitLoad(rd, instr.a);
+            if (instr.bIsImm) emitAluRegImm(instr.tid, rd, (int)instr.imm);
+            else emitAluRegLoc(instr.tid, rd, instr.b);
+        }
+        if (!isReg(instr.dst)) emitStore(instr.dst, rd);
+    }
+    void emitCmp(const IRInstr &instr) {
+        int ra = useReg(instr.a, R11);
+        if (instr.bIsImm) emitAluRegImm(TID_OP_EQUAL, ra, (int)instr.imm);
+        else emitAluRegLoc(TID_OP_EQUAL, ra, instr.b);
+    }
+    static int getConditionCode(TokenID tid) {
+        switch (tid) {
+            case TID_OP_LESS: return 0xc;
+            case TID_OP_LESSEQ: return 0xe;
+            case TID_OP_GREATER: return 0xf;
+            case TID_OP_GREATEREQ: return 0xd;
+            case TID_OP_EQUAL: return 0x4;
+            case TID_OP_NEQUAL: return 0x5;
+            default: ASSERT(0); return 0;
+        }
+    }
+    void emitJcc(int cc, int label) {
+        emit(0x0f, 0x80 + cc, -1);
+        addLabelRef(label);
+    }
+    void addLabelRef(int label) {
+        m_labelRefs.push_back(make_pair(label, (int)m_code.size()));
+        emitValue(0);
+    }
+    // op r32, r/m32 where the comparisons use cmp
+    void emitAluRegLoc(TokenID tid, int r, int vreg) {
+        int rm = isReg(vreg) ? reg(vreg) : RBP;
+        emitRex(false, r, rm);
+        switch (tid) {
+            case TID_OP_ADD: emit(0x03, -1); break;
+            case TID_OP_SUB: emit(0x2b, -1); break;
+            case TID_OP_MUL: emit(0x0f, 0xaf, -1); break;
+            default: emit(0x3b, -1); break;
+        }
+        emitModRM(r, vreg);
+    }
+    void emitAluRegImm(TokenID tid, int r, int imm) {
+        emitRex(false, r, r);
+        switch (tid) {
+            case TID_OP_ADD: emit(0x81, 0xc0 | (r & 7), -1); break;
+            case TID_OP_SUB: emit(0x81, 0xe8 | (r & 7), -1); break;
+            case TID_OP_MUL: emit(0x69, 0xc0 | (r & 7) << 3 | (r & 7), -1); break;
+            default: emit(0x81, 0xf8 | (r & 7), -1); break;
+        }
+        emitValue(imm);
+    }
+    void emitModRM(int r, int vreg) {
+        if (isReg(vreg)) emit(0xc0 | (r & 7) << 3 | (reg(vreg) & 7), -1);
+        else {
+            emit(0x85 | (r & 7) << 3, -1); emitValue(slotOff(vreg));
+        }
+    }
+    void emitLoad(int r, int vreg) {
+        if (isReg(vreg) && reg(vreg) == r) return;
+        emitRex(true, r, isReg(vreg) ? reg(vreg) : RBP);
+        emit(0x8b, -1); emitModRM(r, vreg); // mov r64, r/m64
+    }
+    void emitStore(int vreg, int r) {
+        if (isReg(vreg) && reg(vreg) == r) return;
+        emitRex(true, r, isReg(vreg) ? reg(vreg) : RBP);
+        emit(0x89, -1); emitModRM(r, vreg); // mov r/m64, r64
+    }
+    void emitMovRegReg(int dst, int src) {
+        emitRex(true, src, dst);
+        emit(0x89, 0xc0 | (src & 7) << 3 | (dst & 7), -1);
+    }
+    int useReg(int vreg, int scratch) {
+        if (isReg(vreg)) return reg(vreg);
+        emitLoad(scratch, vreg);
+        return scratch;
+    }
+    void emitPushPop(int op, int r) {
+        if (r >= R8) emit(0x41, -1);
+        emit(op + (r & 7), -1);
+    }
+    void emitPushLoc(int vreg) {
+        if (isReg(vreg)) emitPushPop(0x50, reg(vreg));
+        else {
+            emit(0xff, 0xb5, -1); emitValue(slotOff(vreg)); // push qword ptr [rbp + off]
+        }
+    }
+    void emitPopLoc(int vreg) {
+        if (isReg(vreg)) emitPushPop(0x58, reg(vreg));
+        else {
+            emit(0x8f, 0x85, -1); emitValue(slotOff(vreg)); // pop qword ptr [rbp + off]
+        }
+    }
+    void emitRex(bool w, int r, int rm) {
+        int rex = 0x40 | (w ? 8 : 0) | (r >= R8 ? 4 : 0) | (rm >= R8 ? 1 : 0);
+        if (rex != 0x40) emit(rex, -1);
+    }
+    bool isReg(int vreg) const { return m_locs[vreg] >= 0; }
+    int reg(int vreg) const { return m_locs[vreg]; }
+    int slotOff(int vreg) const { return -8 * (int)m_usedCalleeSaved.size() + 8 * m_locs[vreg]; }
     void emit(int c, ...) {
         va_list args;
         va_start(args, c);
-        *m_codePtr++ = c;
-        for (c = va_arg(args, int); c != -1; c = va_arg(args, int)) *m_codePtr++ = c;
+        m_code.push_back((char)c);
+        for (c = va_arg(args, int); c != -1; c = va_arg(args, int)) m_code.push_back((char)c);
         va_end(args);
     }
     template<typename T>
     void emitValue(T val) {
-        memcpy(m_codePtr, &val, sizeof(val));
-        m_codePtr += sizeof(val);
-    }
-private:
-    void condJmp(TokenID tid, x86Label *label) {
-        switch (tid) {
-            case TID_OP_LESS: emit(0x0f, 0x8c, -1); break;
-            case TID_OP_LESSEQ: emit(0x0f, 0x8e, -1); break;
-            case TID_OP_GREATER: emit(0x0f, 0x8f, -1); break;
-            case TID_OP_GREATEREQ: emit(0x0f, 0x8d, -1); break;
-            case TID_OP_EQUAL: emit(0x0f, 0x84, -1); break;
-            case TID_OP_NEQUAL: emit(0x0f, 0x85, -1); break;
-            default: ASSERT(0); break;
-        }
-        char *ref = m_codePtr;
-        emitValue(NULL);
-        label->addRef(ref);
+        m_code.insert(m_code.end(), (char*)&val, (char*)&val + sizeof(val));
     }
 private:
-    int localIdx2EbpOff(int idx) { return idx < 0 ? 8 - idx * 4 : -(1 + idx) * 4; }
-private:
-    x86JITEngine *m_parent;
-    char *m_codeBuf;
-    char *m_codePtr;
+    x64JITEngine *m_parent;
     string m_funcName;
-    x86Label m_retLabel;
+    vector<IRInstr> m_instrs;
+    int m_vregCount;
+    map<int, int> m_localVRegs;
+    vector<int> m_stack;
+    bool m_reachable;
+    vector<vector<int> > m_labelStacks;
+    vector<bool> m_labelStackSet;
+
+    vector<int> m_locs; // register, or -slot for spilled vreg
+    vector<int> m_usedCalleeSaved;
+    int m_spillSlotCount;
+    int m_frameSize;
+
+    vector<char> m_code;
+    vector<int> m_labelOffs;
+    vector<pair<int, int> > m_labelRefs;
 };
-void x86JITEngine::beginBuild() { }
-x86FunctionBuilder* x86JITEngine::beginBuildFunction() {
-    x86FunctionBuilder *r = new x86FunctionBuilder(this, m_textSection + m_textSectionSize);
+void x64JITEngine::beginBuild() { }
+x64FunctionBuilder* x64JITEngine::beginBuildFunction() {
+    x64FunctionBuilder *r = new x64FunctionBuilder(this);
     r->beginBuild();
     return r;
 }
-void x86JITEngine::endBuildFunction(x86FunctionBuilder *builder) {
+void x64JITEngine::endBuildFunction(x64FunctionBuilder *builder) {
     builder->endBuild();
+    const vector<char> &code = builder->getCode();
+    ASSERT(m_textSectionSize + (int)code.size() <= MAX_TEXT_SECTION_SIZE);
+    memcpy(m_textSection + m_textSectionSize, &code[0], code.size());
     *_getFunctionEntry(builder->getFuncName()) = m_textSection + m_textSectionSize;
-    m_textSectionSize += builder->getCodeSize();
-    ASSERT(m_textSectionSize <= MAX_TEXT_SECTION_SIZE);
+    m_textSectionSize += (int)code.size();
     delete builder;
 }
-void x86JITEngine::endBuild() {
+void x64JITEngine::endBuild() {
     for (map<string, char*>::iterator iter = m_funcEntries.begin(); iter != m_funcEntries.end(); ++iter) {
         if (iter->second == NULL) {
             char *f = os_findSymbol(iter->first.c_str());
@@ -460,7 +970,7 @@ void x86JITEngine::endBuild() {
 //============================== syntax analysis
 class FunctionParser {
 public:
-    FunctionParser(x86FunctionBuilder *builder, Scanner *scanner): m_builder(builder), m_scanner(scanner) {}
+    FunctionParser(x64FunctionBuilder *builder, Scanner *scanner): m_builder(builder), m_scanner(scanner) {}
     void parse() { _function_define(); }
 private:
     void _function_define() {
@@ -468,8 +978,8 @@ private:
         m_builder->getFuncName() = m_scanner->next(1).lexeme;
         ASSERT(m_scanner->next(1).tid == TID_LP);
         while (m_scanner->LA(1).tid != TID_RP) {
-            string type = m_scanner->next(1).lexeme;
-            declareArg(m_scanner->next(1).lexeme, type);
+            m_scanner->next(1); // type
+            declareArg(m_scanner->next(1).lexeme);
             if (m_scanner->LA(1).tid == TID_COMMA) m_scanner->next(1);
         }
         ASSERT(m_scanner->next(1).tid == TID_RP);
@@ -505,7 +1015,7 @@ private:
         }
     }
     void _if() {
-        x86Label label_true, label_false, label_end;
+        IRLabel label_true, label_false, label_end;
 
         m_scanner->next(2);
         _expr(0);
@@ -526,7 +1036,7 @@ private:
         m_builder->markLabel(&label_end);
     }
     void _while() {
-        x86Label *label_break = pushBreakLabel(), *label_continue = pushContinueLabel();
+        IRLabel *label_break = pushBreakLabel(), *label_continue = pushContinueLabel();
 
         m_builder->markLabel(label_continue);
         m_scanner->next(2);
@@ -542,8 +1052,8 @@ private:
     }
     void _for() {
         pushScope();
-        x86Label *label_continue = pushContinueLabel(), *label_break = pushBreakLabel();
-        x86Label label_loop, label_body;
+        IRLabel *label_continue = pushContinueLabel(), *label_break = pushBreakLabel();
+        IRLabel label_loop, label_body;
 
         m_scanner->next(2);
         switch (m_scanner->LA(1).tid) {
@@ -576,17 +1086,17 @@ private:
         popScope();
     }
     void _local_define_list() {
-        string type = m_scanner->next(1).lexeme;
-        _id_or_assignment(type);
+        m_scanner->next(1); // type
+        _id_or_assignment();
         while (m_scanner->LA(1).tid == TID_COMMA) {
             m_scanner->next(1);
-            _id_or_assignment(type);
+            _id_or_assignment();
         }
         ASSERT(m_scanner->next(1).tid == TID_SEMICELON);
     }
-    void _id_or_assignment(const string &type) {
+    void _id_or_assignment() {
         Token idToken = m_scanner->next(1);
-        declareLocal(idToken.lexeme, type);
+        declareLocal(idToken.lexeme);
         if (m_scanner->LA(1).tid == TID_OP_ASSIGN) {
             m_scanner->next(1);
             _expr(0);
@@ -635,7 +1145,7 @@ private:
         Token opToken = m_scanner->next(1);
         switch (opToken.tid) {
             case TID_OP_AND: case TID_OP_OR: {
-                    x86Label label_end;
+                    IRLabel label_end;
                     m_builder->dup();
                     if (opToken.tid == TID_OP_AND) m_builder->falseJmp(&label_end);
                     else m_builder->trueJmp(&label_end);
@@ -687,12 +1197,12 @@ private:
 private:
     void pushScope() { m_nestedLocals.resize(m_nestedLocals.size() + 1); }
     void popScope() { m_nestedLocals.pop_back(); }
-    int declareArg(const string &name, const string &type) {
+    int declareArg(const string &name) {
         ASSERT(m_args.count(name) == 0);
         int idx = -((int)m_args.size() + 1);
         return m_args[name] = idx;
     }
-    int declareLocal(const string &name, const string &type) {
+    int declareLocal(const string &name) {
         ASSERT(m_nestedLocals.back().count(name) == 0);
         int idx = 0;
         for (int i = 0; i < (int)m_nestedLocals.size(); ++i) idx += (int)m_nestedLocals[i].size();
@@ -709,27 +1219,27 @@ private:
         ASSERT(iter != m_args.end());
         return iter->second;
     }
-    x86Label* pushContinueLabel() { m_continueLabels.push_back(new x86Label()); return m_continueLabels.back(); }
+    IRLabel* pushContinueLabel() { m_continueLabels.push_back(new IRLabel()); return m_continueLabels.back(); }
     void popContinueLabel() { delete m_continueLabels.back(); m_continueLabels.pop_back();}
-    x86Label* getLastContinueLabel() { return m_continueLabels.back(); }
-    x86Label* pushBreakLabel(){ m_breakLabels.push_back(new x86Label()); return m_breakLabels.back(); }
+    IRLabel* getLastContinueLabel() { return m_continueLabels.back(); }
+    IRLabel* pushBreakLabel(){ m_breakLabels.push_back(new IRLabel()); return m_breakLabels.back(); }
     void popBreakLabel(){ delete m_breakLabels.back(); m_breakLabels.pop_back();}
-    x86Label* getLastBreakLabel() { return m_breakLabels.back(); }
+    IRLabel* getLastBreakLabel() { return m_breakLabels.back(); }
 private:
-    x86FunctionBuilder *m_builder;
+    x64FunctionBuilder *m_builder;
     Scanner *m_scanner;
     vector<map<string, int> > m_nestedLocals;
     map<string, int> m_args;
-    vector<x86Label*> m_continueLabels, m_breakLabels;
+    vector<IRLabel*> m_continueLabels, m_breakLabels;
 };
 class FileParser {
 public:
-    FileParser(x86JITEngine *engine, Scanner *scanner): m_engine(engine), m_scanner(scanner) {}
+    FileParser(x64JITEngine *engine, Scanner *scanner): m_engine(engine), m_scanner(scanner) {}
     void parse() { while (parseFunction()); }
 private:
     bool parseFunction() {
         if (m_scanner->LA(1).tid != TID_EOF) {
-            x86FunctionBuilder *builder = m_engine->beginBuildFunction();
+            x64FunctionBuilder *builder = m_engine->beginBuildFunction();
             FunctionParser(builder, m_scanner).parse();
             m_engine->endBuildFunction(builder);
             return true;
@@ -737,11 +1247,11 @@ private:
         return false;
     }
 private:
-    x86JITEngine *m_engine;
+    x64JITEngine *m_engine;
     Scanner *m_scanner;
 };
 //============================== 
-static x86JITEngine* g_jitEngine;
+static x64JITEngine* g_jitEngine;
 static int loadFile(const char *fileName) {
     try {
         g_jitEngine->beginBuild();
@@ -756,13 +1266,18 @@ static int loadFile(const char *fileName) {
     }
 }
 int main(int argc, char *argv[]) {
-    x86JITEngine _engine;
+    x64JITEngine _engine;
 
     g_jitEngine = &_engine;
     *g_jitEngine->_getFunctionEntry("loadFile") = (char*)loadFile;
 
-    if (argc >= 2) {
-        int erro = loadFile(argv[1]);
+    int argi = 1;
+    if (argi < argc && string(argv[argi]) == "-noregalloc") {
+        g_jitEngine->setAllocRegisters(false);
+        ++argi;
+    }
+    if (argi < argc) {
+        int erro = loadFile(argv[argi]);
         return erro ? erro : ((int(*)())g_jitEngine->getFunction("main"))();
     }
 
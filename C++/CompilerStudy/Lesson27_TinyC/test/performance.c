@@ -42,12 +42,23 @@ void perform3() {
     for (int i = 0; i < 30; ++i) feb(i);
     printf("perform3: %d\n", clock() - start);
 }
+int factorial(int n) {
+    if (n <= 1) return 1;
+    return n * factorial(n - 1);
+}
+void perform4() {
+    int start = clock();
+    int sum = 0;
+    for (int i = 0; i < 1000000; ++i) sum = sum + factorial(i % 12) % 7;
+    printf("perform4: %d, sum=%d\n", clock() - start, sum);
+}
 int main()  {
     printPrime(10000);
     perform();
     perform_1_5();
     perform2();
     perform3();
+    perform4();
     return 0;
 }
 
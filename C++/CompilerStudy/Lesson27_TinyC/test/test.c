@@ -66,6 +66,15 @@ void print9x9() {
         printf("\n");
     }
 }
+int sum8(int a, int b, int c, int d, int e, int f, int g, int h) {
+    return a - b + c - d + e - f + g * 10 - h;
+}
+void testManyArgs() {
+    printf("========== testManyArgs ==========\n");
+    int x = 100;
+    printf("%d %d %d %d %d %d %d %d %d\n", 1, 2, 3, 4, 5, 6, 7, sum8(1, 2, 3, 4, 5, 6, 7, 8), x);
+    printf("%d %d %d %d %d %d %d %d\n", 1, 2, 3, 4, 5, 6, 7, sum8(x, 2, 3, 4, 5, 6, sum8(1, 1, 1, 1, 1, 1, 1, 1), 8));
+}
 void perform() {
     printf("========== perform ==========\n");
     int start = clock();
@@ -81,6 +90,7 @@ int main()  {
     printFeb1();
     printFeb2();
     print9x9();
+    testManyArgs();
     perform();
     printf("15-3*(2*2+(7-2)) = %d\n", 15-3*(2*2+(7-2)));
     return 0;
@@ -0,0 +1,682 @@
+#include "pch.h"
+
+#include <stdlib.h>
+#include <limits.h>
+
+#include "FastJsonParser.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifdef __PCLMUL__
+#include <wmmintrin.h>
+#endif
+
+//==============================
+// stage 1: structural index
+
+struct JsonBlockBits {
+    uint64_t quote, backslash, whitespace, op;
+};
+
+static void classifyBlock(const char *p, JsonBlockBits &bits) {
+#if defined(__AVX2__)
+    bits.quote = bits.backslash = bits.whitespace = bits.op = 0;
+    for (int i = 0; i < 64; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        __m256i op = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        bits.quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << i;
+        bits.backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << i;
+        bits.whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << i;
+        bits.op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << i;
+    }
+#elif defined(__SSE2__)
+    bits.quote = bits.backslash = bits.whitespace = bits.op = 0;
+    for (int i = 0; i < 64; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        // '[' | 0x20 == '{', ']' | 0x20 == '}'
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        __m128i op = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        bits.quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << i;
+        bits.backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+        bits.whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << i;
+        bits.op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << i;
+    }
+#else
+    bits.quote = bits.backslash = bits.whitespace = bits.op = 0;
+    for (int i = 0; i < 64; ++i) {
+        uint64_t bit = 1ULL << i;
+        switch (p[i]) {
+            case '"': bits.quote |= bit; break;
+            case '\\': bits.backslash |= bit; break;
+            case ' ': case '\t': case '\n': case '\r': bits.whitespace |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': bits.op |= bit; break;
+            default: break;
+        }
+    }
+#endif
+}
+
+// bit i of the result is the xor of bits 0..i
+static uint64_t prefixXor(uint64_t x) {
+#ifdef __PCLMUL__
+    return (uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)x), _mm_set1_epi8((char)0xff), 0));
+#else
+    x ^= x << 1; x ^= x << 2; x ^= x << 4;
+    x ^= x << 8; x ^= x << 16; x ^= x << 32;
+    return x;
+#endif
+}
+
+// characters preceded by an odd number of backslashes; backslashes are rare, so just walk them
+static uint64_t findEscaped(uint64_t backslash, uint64_t &prevEscaped) {
+    uint64_t escaped = prevEscaped;
+    prevEscaped = 0;
+    backslash &= ~escaped;
+    while (backslash != 0) {
+        int i = __builtin_ctzll(backslash);
+        if (i == 63) {
+            prevEscaped = 1;
+            break;
+        }
+        escaped |= 2ULL << i;
+        backslash &= ~(3ULL << i);
+    }
+    return escaped;
+}
+
+bool buildJsonStructuralIndex(const char *data, size_t size, vector<uint32_t> &indexs, uint32_t &count) {
+    // only grows, so a reused buffer is not cleared again; 64 more for the unrolled writes
+    if (indexs.size() < size + 64 + 2) indexs.resize(size + 64 + 2);
+    uint32_t *begin = &indexs[0], *out = begin;
+
+    uint64_t prevEscaped = 0, prevInString = 0, prevScalar = 0;
+    char lastBlock[64];
+    for (size_t base = 0; base < size; base += 64) {
+        const char *p = data + base;
+        if (size - base < 64) {
+            memset(lastBlock, ' ', sizeof(lastBlock));
+            memcpy(lastBlock, p, size - base);
+            p = lastBlock;
+        }
+
+        JsonBlockBits bits;
+        classifyBlock(p, bits);
+
+        uint64_t quote = bits.quote;
+        if (bits.backslash != 0 || prevEscaped != 0) quote &= ~findEscaped(bits.backslash, prevEscaped);
+        // includes the opening quote, excludes the closing one
+        uint64_t inString = prefixXor(quote) ^ prevInString;
+        prevInString = (uint64_t)((int64_t)inString >> 63);
+
+        // the first character of a literal or a number, or an opening quote
+        uint64_t scalar = ~(bits.op | bits.whitespace);
+        uint64_t nonQuoteScalar = scalar & ~quote;
+        uint64_t followsNonQuoteScalar = (nonQuoteScalar << 1) | prevScalar;
+        prevScalar = nonQuoteScalar >> 63;
+        uint64_t stringTail = inString ^ quote;
+        uint64_t structurals = (bits.op | (scalar & ~followsNonQuoteScalar)) & ~stringTail;
+
+        // write 8 at a time without branching on each bit, the extra ones are overwritten later
+        int bitCount = __builtin_popcountll(structurals);
+        uint32_t *next = out + bitCount;
+        while (structurals != 0) {
+            for (int i = 0; i < 8; ++i) {
+                // ctz(0) is undefined, the high bit keeps the argument non zero
+                out[i] = (uint32_t)(base + __builtin_ctzll(structurals | (1ULL << 63)));
+                structurals &= structurals - 1;
+            }
+            out += 8;
+        }
+        out = next;
+    }
+
+    count = uint32_t(out - begin);
+    out[0] = out[1] = (uint32_t)size;
+    return prevInString == 0;
+}
+
+//==============================
+// shared scalar parsing
+
+static bool isJsonTerminator(char c) {
+    switch (c) {
+        case ' ': case '\t': case '\n': case '\r':
+        case ',': case ':': case ']': case '}': case 0:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static int parseHex4(const char *p) {
+    int r = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = p[i];
+        r <<= 4;
+        if (c >= '0' && c <= '9') r |= c - '0';
+        else if (c >= 'a' && c <= 'f') r |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') r |= c - 'A' + 10;
+        else return -1;
+    }
+    return r;
+}
+
+static void appendUTF8(string &out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back((char)cp);
+    } else if (cp < 0x800) {
+        out.push_back((char)(0xc0 | (cp >> 6)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+        out.push_back((char)(0xe0 | (cp >> 12)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    } else {
+        out.push_back((char)(0xf0 | (cp >> 18)));
+        out.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (cp & 0x3f)));
+    }
+}
+
+// p points after the opening quote; returns the closing quote or the first backslash
+static const char* findQuoteOrBackslash(const char *p, const char *end) {
+#ifdef __SSE2__
+    for (; p + 16 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p < end && *p != '"' && *p != '\\'; ++p);
+    return p;
+}
+
+// p points to the first backslash, appends until the closing quote; returns the closing quote or NULL
+static const char* unescapeJsonString(const char *p, const char *end, string &out) {
+    for (;;) {
+        const char *q = findQuoteOrBackslash(p, end);
+        out.append(p, q);
+        if (q >= end) return NULL;
+        if (*q == '"') return q;
+
+        p = q + 2;
+        switch (q[1]) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                    if (end - p < 4) return NULL;
+                    int cp = parseHex4(p);
+                    if (cp < 0) return NULL;
+                    p += 4;
+                    if (cp >= 0xd800 && cp < 0xdc00) {
+                        if (end - p < 6 || p[0] != '\\' || p[1] != 'u') return NULL;
+                        int low = parseHex4(p + 2);
+                        if (low < 0xdc00 || low >= 0xe000) return NULL;
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                        p += 6;
+                    } else if (cp >= 0xdc00 && cp < 0xe000) {
+                        return NULL;
+                    }
+                    appendUTF8(out, (uint32_t)cp);
+                }
+                break;
+            default: return NULL;
+        }
+    }
+}
+
+// p points to '-' or a digit, end receives the first character after the number
+static bool parseJsonNumber(const char *p, const char *&end, bool &isDouble, int64_t &i, double &d) {
+    const char *begin = p;
+    bool isNegative = *p == '-';
+    if (isNegative) ++p;
+    const char *digitBegin = p;
+    uint64_t v = 0;
+    for (; *p >= '0' && *p <= '9'; ++p) v = v * 10 + (*p - '0');
+    int digitCount = int(p - digitBegin);
+    if (digitCount == 0 || (digitCount > 1 && *digitBegin == '0')) return false;
+
+    isDouble = *p == '.' || *p == 'e' || *p == 'E';
+    if (!isDouble && digitCount <= 19 && v <= (uint64_t)INT64_MAX + isNegative) {
+        i = isNegative ? (int64_t)(0 - v) : (int64_t)v;
+        end = p;
+        return isJsonTerminator(*end);
+    }
+
+    // exact when the mantissa fits in 53 bits and the power of 10 is exact too (Clinger's fast path)
+    int exponent = 0;
+    if (*p == '.') {
+        const char *fractionBegin = ++p;
+        for (; *p >= '0' && *p <= '9'; ++p) v = v * 10 + (*p - '0');
+        if (p == fractionBegin) return false;
+        digitCount += int(p - fractionBegin);
+        exponent = -int(p - fractionBegin);
+    }
+    if (*p == 'e' || *p == 'E') {
+        ++p;
+        bool isExpNegative = *p == '-';
+        if (*p == '-' || *p == '+') ++p;
+        if (*p < '0' || *p > '9') return false;
+        int e = 0;
+        for (; *p >= '0' && *p <= '9'; ++p) if (e < 10000) e = e * 10 + (*p - '0');
+        exponent += isExpNegative ? -e : e;
+    }
+    static const double POW10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    end = p;
+    isDouble = true;
+    if (digitCount <= 19 && v < (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        d = exponent < 0 ? double(v) / POW10[-exponent] : double(v) * POW10[exponent];
+        if (isNegative) d = -d;
+    } else {
+        d = strtod(begin, NULL);
+    }
+    return isJsonTerminator(*end);
+}
+
+//==============================
+// stage 2: tape
+/*
+   Every entry is a 64 bits word, the type in the highest byte:
+   '{' '[' : index after the matching close entry
+   '}' ']' : index of the open entry
+   '"' 'k' : string / object key, offset into the input (or string buffer), the next word is the size
+   'l' 'd' : the next word is the int64 / double
+   't' 'f' 'n'
+ * */
+static const uint64_t TAPE_PAYLOAD_MASK = (1ULL << 55) - 1;
+static const uint64_t TAPE_STRING_IN_BUFFER = 1ULL << 55;
+static const char TAPE_KEY = 'k';
+
+static uint64_t makeTapeWord(char type, uint64_t payload) {
+    return ((uint64_t)(uint8_t)type << 56) | payload;
+}
+static char getTapeType(uint64_t word) {
+    return (char)(word >> 56);
+}
+
+JsonDocument::JsonDocument(): m_data(NULL), m_size(0), m_indexCount(0) {
+}
+
+bool JsonDocument::parse(const char *data, size_t size) {
+    m_data = data;
+    m_size = size;
+    m_tape.clear();
+    m_stringBuffer.clear();
+    m_openStack.clear();
+    m_error.clear();
+    if (size >= UINT_MAX) return setError("document too large", 0);
+    if (!buildJsonStructuralIndex(data, size, m_indexs, m_indexCount)) return setError("unclosed string", (uint32_t)size);
+    return buildTape();
+}
+
+bool JsonDocument::setError(const char *msg, uint32_t off) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s at %u", msg, off);
+    m_error = buf;
+    m_tape.clear();
+    return false;
+}
+
+bool JsonDocument::buildTape() {
+    const uint32_t *indexs = &m_indexs[0];
+    uint32_t n = m_indexCount;
+    uint32_t i = 0;
+
+    // key ':'
+    auto parseKey = [&]() -> bool {
+        if (m_data[indexs[i]] != '"') return setError("key expected", indexs[i]);
+        m_tape.push_back(makeTapeWord(TAPE_KEY, 0));
+        if (!parseString(indexs[i++])) return false;
+        if (m_data[indexs[i]] != ':') return setError("':' expected", indexs[i]);
+        ++i;
+        return true;
+    };
+
+    for (;;) {
+        // a value
+        if (i >= n) return setError("value expected", (uint32_t)m_size);
+        uint32_t off = indexs[i++];
+        char c = m_data[off];
+        switch (c) {
+            case '{':
+            case '[':
+                m_openStack.push_back((uint32_t)m_tape.size());
+                m_tape.push_back(makeTapeWord(c, 0));
+                if (m_data[indexs[i]] == (c == '{' ? '}' : ']')) break;
+                if (c == '{' && !parseKey()) return false;
+                continue;
+            case '"':
+                m_tape.push_back(makeTapeWord('"', 0));
+                if (!parseString(off)) return false;
+                break;
+            case 't': case 'f': case 'n':
+                if (!parseAtom(off)) return false;
+                break;
+            case '-':
+            case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9':
+                if (!parseNumber(off)) return false;
+                break;
+            default:
+                return setError("value expected", off);
+        }
+
+        // close the finished containers, until there is another element
+        for (;;) {
+            if (m_openStack.empty()) {
+                if (i != n) return setError("end of document expected", indexs[i]);
+                return true;
+            }
+            uint32_t openPos = m_openStack.back();
+            char open = getTapeType(m_tape[openPos]);
+            char close = open == '{' ? '}' : ']';
+            c = m_data[indexs[i]];
+            if (c == ',') {
+                ++i;
+                if (open == '{' && !parseKey()) return false;
+                break;
+            }
+            if (c != close) return setError(open == '{' ? "',' or '}' expected" : "',' or ']' expected", indexs[i]);
+            ++i;
+            m_openStack.pop_back();
+            m_tape[openPos] |= m_tape.size() + 1;
+            m_tape.push_back(makeTapeWord(close, openPos));
+        }
+    }
+}
+
+// the type word was pushed by the caller
+bool JsonDocument::parseString(uint32_t off) {
+    const char *begin = m_data + off + 1, *end = m_data + m_size;
+    const char *p = findQuoteOrBackslash(begin, end);
+    if (p >= end) return setError("unclosed string", off);
+    if (*p == '"') {
+        m_tape.back() |= uint64_t(begin - m_data);
+        m_tape.push_back(uint64_t(p - begin));
+        return true;
+    }
+
+    size_t bufferOff = m_stringBuffer.size();
+    m_stringBuffer.append(begin, p);
+    if (unescapeJsonString(p, end, m_stringBuffer) == NULL) return setError("invalid escape", uint32_t(p - m_data));
+    m_tape.back() |= TAPE_STRING_IN_BUFFER | bufferOff;
+    m_tape.push_back(m_stringBuffer.size() - bufferOff);
+    return true;
+}
+
+bool JsonDocument::parseNumber(uint32_t off) {
+    const char *end;
+    bool isDouble;
+    int64_t i;
+    double d;
+    if (!parseJsonNumber(m_data + off, end, isDouble, i, d)) return setError("invalid number", off);
+    if (isDouble) {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        m_tape.push_back(makeTapeWord(JT_Double, 0));
+        m_tape.push_back(bits);
+    } else {
+        m_tape.push_back(makeTapeWord(JT_Int64, 0));
+        m_tape.push_back((uint64_t)i);
+    }
+    return true;
+}
+
+bool JsonDocument::parseAtom(uint32_t off) {
+    const char *p = m_data + off;
+    size_t left = m_size - off;
+    if (left >= 4 && memcmp(p, "true", 4) == 0 && isJsonTerminator(p[4])) {
+        m_tape.push_back(makeTapeWord(JT_True, 0));
+    } else if (left >= 5 && memcmp(p, "false", 5) == 0 && isJsonTerminator(p[5])) {
+        m_tape.push_back(makeTapeWord(JT_False, 0));
+    } else if (left >= 4 && memcmp(p, "null", 4) == 0 && isJsonTerminator(p[4])) {
+        m_tape.push_back(makeTapeWord(JT_Null, 0));
+    } else {
+        return setError("invalid literal", off);
+    }
+    return true;
+}
+
+//==============================
+JsonType JsonValue::getType() const {
+    if (m_doc == NULL) return JT_Invalid;
+    return (JsonType)getTapeType(m_doc->m_tape[m_pos]);
+}
+int64_t JsonValue::getInt64() const {
+    switch (getType()) {
+        case JT_Int64: return (int64_t)m_doc->m_tape[m_pos + 1];
+        case JT_Double: return (int64_t)getDouble();
+        default: return 0;
+    }
+}
+double JsonValue::getDouble() const {
+    switch (getType()) {
+        case JT_Int64: return (double)(int64_t)m_doc->m_tape[m_pos + 1];
+        case JT_Double: {
+                double d;
+                memcpy(&d, &m_doc->m_tape[m_pos + 1], sizeof(d));
+                return d;
+            }
+        default: return 0;
+    }
+}
+JsonStringRef JsonValue::getString() const {
+    if (getType() != JT_String) return JsonStringRef();
+    uint64_t word = m_doc->m_tape[m_pos];
+    const char *base = (word & TAPE_STRING_IN_BUFFER) ? m_doc->m_stringBuffer.c_str() : m_doc->m_data;
+    return JsonStringRef(base + (word & TAPE_PAYLOAD_MASK), (size_t)m_doc->m_tape[m_pos + 1]);
+}
+JsonStringRef JsonValue::getKey() const {
+    if (m_doc == NULL || m_pos < 2 || getTapeType(m_doc->m_tape[m_pos - 2]) != TAPE_KEY) return JsonStringRef();
+    uint64_t word = m_doc->m_tape[m_pos - 2];
+    const char *base = (word & TAPE_STRING_IN_BUFFER) ? m_doc->m_stringBuffer.c_str() : m_doc->m_data;
+    return JsonStringRef(base + (word & TAPE_PAYLOAD_MASK), (size_t)m_doc->m_tape[m_pos - 1]);
+}
+uint32_t JsonValue::getNextPos() const {
+    uint64_t word = m_doc->m_tape[m_pos];
+    switch (getTapeType(word)) {
+        case JT_Object: case JT_Array: return uint32_t(word & TAPE_PAYLOAD_MASK);
+        case JT_String: case JT_Int64: case JT_Double: return m_pos + 2;
+        default: return m_pos + 1;
+    }
+}
+JsonValue JsonValue::getFirstChild() const {
+    JsonType type = getType();
+    if (type != JT_Object && type != JT_Array) return JsonValue();
+    uint32_t pos = m_pos + 1;
+    char c = getTapeType(m_doc->m_tape[pos]);
+    if (c == '}' || c == ']') return JsonValue();
+    return JsonValue(m_doc, c == TAPE_KEY ? pos + 2 : pos);
+}
+JsonValue JsonValue::getNextSibling() const {
+    if (m_doc == NULL) return JsonValue();
+    uint32_t pos = getNextPos();
+    if (pos >= m_doc->m_tape.size()) return JsonValue();
+    char c = getTapeType(m_doc->m_tape[pos]);
+    if (c == '}' || c == ']') return JsonValue();
+    return JsonValue(m_doc, c == TAPE_KEY ? pos + 2 : pos);
+}
+JsonValue JsonValue::operator [] (const char *key) const {
+    if (getType() != JT_Object) return JsonValue();
+    for (JsonValue child = getFirstChild(); child.isValid(); child = child.getNextSibling()) {
+        if (child.getKey() == key) return child;
+    }
+    return JsonValue();
+}
+int JsonValue::getChildCount() const {
+    int n = 0;
+    for (JsonValue child = getFirstChild(); child.isValid(); child = child.getNextSibling()) ++n;
+    return n;
+}
+
+static void printTabs(ostream& so, int n) {
+    for (int i = 0; i < n; ++i) so << '\t';
+}
+void JsonValue::print(ostream &so, int depth) const {
+    switch (getType()) {
+        case JT_Null: so << "null"; break;
+        case JT_True: so << "true"; break;
+        case JT_False: so << "false"; break;
+        case JT_Int64: so << getInt64(); break;
+        case JT_Double: so << getDouble(); break;
+        case JT_String: so << '"' << getString().toString() << '"'; break;
+        case JT_Array:
+        case JT_Object: {
+                bool isObject = getType() == JT_Object;
+                so << (isObject ? "{\n" : "[\n");
+                for (JsonValue child = getFirstChild(); child.isValid(); child = child.getNextSibling()) {
+                    printTabs(so, depth + 1);
+                    if (isObject) so << '"' << child.getKey().toString() << "\" : ";
+                    child.print(so, depth + 1);
+                    so << ",\n";
+                }
+                printTabs(so, depth); so << (isObject ? '}' : ']');
+            }
+            break;
+        default: break;
+    }
+}
+
+//==============================
+// on-demand
+
+bool JsonOnDemandDocument::parse(const char *data, size_t size) {
+    m_data = data;
+    if (size >= UINT_MAX || !buildJsonStructuralIndex(data, size, m_indexs, m_indexCount) || m_indexCount == 0) {
+        m_indexCount = 0;
+        return false;
+    }
+    return true;
+}
+
+const char* JsonOnDemandValue::getPtr() const {
+    return m_doc->m_data + m_doc->m_indexs[m_index];
+}
+JsonType JsonOnDemandValue::getType() const {
+    if (m_doc == NULL) return JT_Invalid;
+    const char *p = getPtr();
+    switch (p[0]) {
+        case '{': return JT_Object;
+        case '[': return JT_Array;
+        case '"': return JT_String;
+        case 't': return JT_True;
+        case 'f': return JT_False;
+        case 'n': return JT_Null;
+        default: {
+                const char *end;
+                bool isDouble;
+                int64_t i;
+                double d;
+                if (!parseJsonNumber(p, end, isDouble, i, d)) return JT_Invalid;
+                return isDouble ? JT_Double : JT_Int64;
+            }
+    }
+}
+int64_t JsonOnDemandValue::getInt64() const {
+    if (m_doc == NULL) return 0;
+    const char *end;
+    bool isDouble;
+    int64_t i;
+    double d;
+    if (!parseJsonNumber(getPtr(), end, isDouble, i, d)) return 0;
+    return isDouble ? (int64_t)d : i;
+}
+double JsonOnDemandValue::getDouble() const {
+    if (m_doc == NULL) return 0;
+    const char *end;
+    bool isDouble;
+    int64_t i;
+    double d;
+    if (!parseJsonNumber(getPtr(), end, isDouble, i, d)) return 0;
+    return isDouble ? d : (double)i;
+}
+JsonStringRef JsonOnDemandValue::getString(string &buffer) const {
+    if (m_doc == NULL) return JsonStringRef();
+    const char *begin = getPtr();
+    if (begin[0] != '"') return JsonStringRef();
+    ++begin;
+    // the closing quote is before the next structural
+    const char *end = m_doc->m_data + m_doc->m_indexs[m_index + 1];
+    const char *p = findQuoteOrBackslash(begin, end);
+    if (p >= end) return JsonStringRef();
+    if (*p == '"') return JsonStringRef(begin, p - begin);
+
+    buffer.assign(begin, p);
+    if (unescapeJsonString(p, end, buffer) == NULL) return JsonStringRef();
+    return JsonStringRef(buffer.c_str(), buffer.size());
+}
+
+uint32_t JsonOnDemandValue::skipValue(uint32_t index) const {
+    const char *data = m_doc->m_data;
+    const uint32_t *indexs = &m_doc->m_indexs[0];
+    char c = data[indexs[index++]];
+    if (c != '{' && c != '[') return index;
+    // strings are single structurals, so brackets inside them are not counted
+    uint32_t n = m_doc->m_indexCount;
+    for (int depth = 1; depth > 0 && index < n; ++index) {
+        c = data[indexs[index]];
+        if (c == '{' || c == '[') ++depth;
+        else if (c == '}' || c == ']') --depth;
+    }
+    return index;
+}
+JsonOnDemandValue JsonOnDemandValue::operator [] (const char *key) const {
+    if (m_doc == NULL) return JsonOnDemandValue();
+    const char *data = m_doc->m_data;
+    const uint32_t *indexs = &m_doc->m_indexs[0];
+    if (data[indexs[m_index]] != '{') return JsonOnDemandValue();
+
+    size_t keySize = strlen(key);
+    uint32_t index = m_index + 1;
+    while (data[indexs[index]] == '"' && data[indexs[index + 1]] == ':') {
+        const char *p = data + indexs[index] + 1;
+        if (memcmp(p, key, keySize) == 0 && p[keySize] == '"') return JsonOnDemandValue(m_doc, index + 2);
+        index = skipValue(index + 2);
+        if (data[indexs[index]] != ',') break;
+        ++index;
+    }
+    return JsonOnDemandValue();
+}
+JsonOnDemandValue JsonOnDemandValue::getFirstChild() const {
+    if (m_doc == NULL) return JsonOnDemandValue();
+    const char *data = m_doc->m_data;
+    const uint32_t *indexs = &m_doc->m_indexs[0];
+    char c = data[indexs[m_index]], next = data[indexs[m_index + 1]];
+    if (c == '[' && next != ']') return JsonOnDemandValue(m_doc, m_index + 1);
+    if (c == '{' && next == '"') return JsonOnDemandValue(m_doc, m_index + 3);
+    return JsonOnDemandValue();
+}
+JsonOnDemandValue JsonOnDemandValue::getNextSibling() const {
+    if (m_doc == NULL) return JsonOnDemandValue();
+    const char *data = m_doc->m_data;
+    const uint32_t *indexs = &m_doc->m_indexs[0];
+    uint32_t index = skipValue(m_index);
+    if (index >= m_doc->m_indexCount || data[indexs[index]] != ',') return JsonOnDemandValue();
+    ++index;
+    if (data[indexs[index]] == '"' && data[indexs[index + 1]] == ':') index += 2;
+    return JsonOnDemandValue(m_doc, index);
+}
@@ -0,0 +1,145 @@
+#ifndef FAST_JSON_PARSER_H
+#define FAST_JSON_PARSER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+/*
+   Two stages parser for standard json:
+   stage 1 classifies 64 bytes at a time into bitmasks (quote, backslash, whitespace, structural) and
+   flattens the structurals outside strings into an index of offsets;
+   stage 2 walks the index and writes every value into one contiguous tape, strings without escapes are
+   views into the input.
+   The input must be readable at data[size] (a terminating 0 is expected), and must outlive the document.
+ * */
+
+struct JsonStringRef {
+    const char *ptr;
+    size_t size;
+    JsonStringRef(): ptr(NULL), size(0){}
+    JsonStringRef(const char *_ptr, size_t _size): ptr(_ptr), size(_size){}
+    bool operator == (const char *s) const { return strlen(s) == size && memcmp(ptr, s, size) == 0; }
+    std::string toString() const { return std::string(ptr, size); }
+};
+
+// offsets of the count structurals, followed by 2 sentinels of value size; fails if a string is not closed
+bool buildJsonStructuralIndex(const char *data, size_t size, std::vector<uint32_t> &indexs, uint32_t &count);
+
+enum JsonType {
+    JT_Null = 'n',
+    JT_True = 't',
+    JT_False = 'f',
+    JT_Int64 = 'l',
+    JT_Double = 'd',
+    JT_String = '"',
+    JT_Array = '[',
+    JT_Object = '{',
+    JT_Invalid = 0,
+};
+
+class JsonDocument;
+// a view to a tape entry, valid as long as the document is not parsed again
+class JsonValue {
+public:
+    JsonValue(): m_doc(NULL), m_pos(0){}
+    JsonValue(const JsonDocument *doc, uint32_t pos): m_doc(doc), m_pos(pos){}
+
+    bool isValid() const { return m_doc != NULL; }
+    JsonType getType() const;
+    bool getBoolean() const { return getType() == JT_True; }
+    int64_t getInt64() const;
+    double getDouble() const;
+    JsonStringRef getString() const;
+
+    // the member of an object named key, invalid if not found
+    JsonValue operator [] (const char *key) const;
+    JsonValue getFirstChild() const;
+    // the next element of the containing array or object, invalid at the end
+    JsonValue getNextSibling() const;
+    // the key of an object member
+    JsonStringRef getKey() const;
+    int getChildCount() const;
+
+    void print(std::ostream &so, int depth = 0) const;
+private:
+    uint32_t getNextPos() const;
+private:
+    const JsonDocument *m_doc;
+    uint32_t m_pos;
+};
+
+class JsonDocument {
+public:
+    JsonDocument();
+    // buffers are reused between parses
+    bool parse(const char *data, size_t size);
+    bool parse(const std::string &s) { return parse(s.c_str(), s.size()); }
+    const std::string& getError() const { return m_error; }
+    JsonValue getRoot() const { return JsonValue(this, 0); }
+    size_t getTapeSize() const { return m_tape.size(); }
+private:
+    bool buildTape();
+    bool parseString(uint32_t off);
+    bool parseNumber(uint32_t off);
+    bool parseAtom(uint32_t off);
+    bool setError(const char *msg, uint32_t off);
+private:
+    friend class JsonValue;
+    const char *m_data;
+    size_t m_size;
+    std::vector<uint32_t> m_indexs;
+    uint32_t m_indexCount;
+    std::vector<uint64_t> m_tape;
+    std::string m_stringBuffer;
+    std::vector<uint32_t> m_openStack;
+    std::string m_error;
+};
+
+/*
+   Lazy cursor over the structural index: nothing is materialized, values which are not asked for are
+   skipped by counting brackets in the index. Only the parts which are accessed are validated.
+ * */
+class JsonOnDemandDocument;
+class JsonOnDemandValue {
+public:
+    JsonOnDemandValue(): m_doc(NULL), m_index(0){}
+    JsonOnDemandValue(const JsonOnDemandDocument *doc, uint32_t index): m_doc(doc), m_index(index){}
+
+    bool isValid() const { return m_doc != NULL; }
+    JsonType getType() const;
+    bool getBoolean() const { return getType() == JT_True; }
+    int64_t getInt64() const;
+    double getDouble() const;
+    // raw string between the quotes if it has no escapes, otherwise unescaped into buffer
+    JsonStringRef getString(std::string &buffer) const;
+
+    // keys are compared without unescaping
+    JsonOnDemandValue operator [] (const char *key) const;
+    JsonOnDemandValue getFirstChild() const;
+    JsonOnDemandValue getNextSibling() const;
+private:
+    uint32_t skipValue(uint32_t index) const;
+    const char* getPtr() const;
+private:
+    const JsonOnDemandDocument *m_doc;
+    uint32_t m_index;
+};
+
+class JsonOnDemandDocument {
+public:
+    JsonOnDemandDocument(): m_data(NULL), m_indexCount(0){}
+    bool parse(const char *data, size_t size);
+    bool parse(const std::string &s) { return parse(s.c_str(), s.size()); }
+    JsonOnDemandValue getRoot() const { return m_indexCount == 0 ? JsonOnDemandValue() : JsonOnDemandValue(this, 0); }
+private:
+    friend class JsonOnDemandValue;
+    const char *m_data;
+    std::vector<uint32_t> m_indexs;
+    uint32_t m_indexCount;
+};
+
+#endif
@@ -15,6 +15,8 @@ using namespace std;
 #include <memory>
 #include <unordered_map>
 
+#include "FastJsonParser.h"
+
 static void printSpace(ostream& so, int n) {
     for (int i = 0; i < n; ++i) so << '\t';
 }
@@ -174,7 +176,89 @@ static JsonNodePtr parse_json(const char *str) {
     return parse_hashtable(str);
 }
 
-int main() {
+// telemetry like records
+static string generateDocument(int recordCount) {
+    string s = "{\"records\": [\n";
+    char buf[512];
+    for (int i = 0; i < recordCount; ++i) {
+        snprintf(buf, sizeof(buf), 
+                "  {\"id\": %d, \"host\": \"server-%03d.example.com\", \"timestamp\": %d.%03d, \"enabled\": %s, "
+                "\"tags\": [\"region-%d\", \"rack-%d\", null], "
+                "\"metrics\": {\"cpu\": %d.%02d, \"memory\": %d, \"latency_ms\": [%d, %d, %d, %d]}, "
+                "\"message\": \"request served in %d ms by worker %d\"}%s\n",
+                i, i % 997, 1600000000 + i, i % 1000, i % 3 ? "true" : "false",
+                i % 7, i % 41, i % 100, i % 97, i * 7919 % 1000003, i % 13, i % 29, i % 31, i % 37,
+                i % 211, i % 16, i + 1 < recordCount ? "," : "");
+        s += buf;
+    }
+    s += "]}";
+    return s;
+}
+
+static void benchmark(int recordCount, int loop) {
+    string doc = generateDocument(recordCount);
+    string quoteDoc(doc);
+    for (auto &c : quoteDoc) if (c == '"') c = '\'';
+    double mb = doc.size() / 1024.0 / 1024.0 * loop;
+    printf("document: %.2f MB, %d records\n", doc.size() / 1024.0 / 1024.0, recordCount);
+
+    clock_t start = clock();
+    for (int i = 0; i < loop; ++i) {
+        JsonNodePtr p = parse_json(quoteDoc.c_str());
+        assert(p);
+    }
+    double seconds = double(clock() - start) / CLOCKS_PER_SEC;
+    printf("recursive descent   : %8.1f MB/s\n", mb / seconds);
+
+    vector<uint32_t> indexs;
+    uint32_t indexCount;
+    start = clock();
+    for (int i = 0; i < loop; ++i) buildJsonStructuralIndex(doc.c_str(), doc.size(), indexs, indexCount);
+    seconds = double(clock() - start) / CLOCKS_PER_SEC;
+    printf("stage 1 index       : %8.1f MB/s\n", mb / seconds);
+
+    JsonDocument dom;
+    int64_t sum = 0;
+    start = clock();
+    for (int i = 0; i < loop; ++i) {
+        if (!dom.parse(doc)) {
+            printf("error: %s\n", dom.getError().c_str());
+            return;
+        }
+        for (JsonValue r = dom.getRoot()["records"].getFirstChild(); r.isValid(); r = r.getNextSibling()) {
+            sum += r["metrics"]["memory"].getInt64();
+        }
+    }
+    seconds = double(clock() - start) / CLOCKS_PER_SEC;
+    printf("tape                : %8.1f MB/s (tape %d words, sum %lld)\n", mb / seconds, (int)dom.getTapeSize(), (long long)sum);
+
+    JsonOnDemandDocument onDemand;
+    sum = 0;
+    start = clock();
+    for (int i = 0; i < loop; ++i) {
+        onDemand.parse(doc);
+        for (JsonOnDemandValue r = onDemand.getRoot()["records"].getFirstChild(); r.isValid(); r = r.getNextSibling()) {
+            sum += r["metrics"]["memory"].getInt64();
+        }
+    }
+    seconds = double(clock() - start) / CLOCKS_PER_SEC;
+    printf("on-demand           : %8.1f MB/s (sum %lld)\n", mb / seconds, (long long)sum);
+}
+
+int main(int argc, char *argv[]) {
     JsonNodePtr p = parse_json("{'a':true, 'array': [null, 1, 2, 3, 4, {'a':'b', 'c': 'd', 'e':[3,6,9]}]}");
     if (p) p->print(cout, 0);
+    cout << endl;
+
+    // the document refers to the input, which must outlive it
+    string input("{\"a\":true, \"array\": [null, 1, -2.5e3, \"\\u4e2d\\n\", {\"a\":\"b\", \"c\": \"d\", \"e\":[3,6,9]}]}");
+    JsonDocument doc;
+    if (doc.parse(input)) {
+        doc.getRoot().print(cout, 0);
+        cout << endl;
+    } else {
+        cout << doc.getError() << endl;
+    }
+
+    benchmark(argc > 1 ? atoi(argv[1]) : 100000, 5);
 }
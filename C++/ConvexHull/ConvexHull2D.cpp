@@ -0,0 +1,167 @@
+#include "pch.h"
+
+#include "ConvexHull2D.h"
+
+// > 0 if o, a, b turn counter clockwise; in double, where the products of float differences are
+// exact enough for the sign to be right on anything but nearly collinear points
+static inline double cross(const Point2& o, const Point2& a, const Point2& b)
+{
+    return (double(a.x) - o.x) * (double(b.y) - o.y) - (double(a.y) - o.y) * (double(b.x) - o.x);
+}
+
+static const int DIRECTION_COUNT = 8;
+
+// Akl-Toussaint directions in counter clockwise order, starting from -x
+static inline float directionScore(const Point2& p, int dir)
+{
+    switch (dir) {
+        case 0: return -p.x;
+        case 1: return -p.x - p.y;
+        case 2: return -p.y;
+        case 3: return p.x - p.y;
+        case 4: return p.x;
+        case 5: return p.x + p.y;
+        case 6: return p.y;
+        default: return p.y - p.x;
+    }
+}
+
+struct Extremes
+{
+    int index[DIRECTION_COUNT];
+
+    void init() { for (int i = 0; i < DIRECTION_COUNT; ++i) index[i] = -1; }
+
+    // ties go to the lowest index, so the result doesn't depend on how the points were split
+    void add(const std::vector<Point2>& points, int i)
+    {
+        for (int d = 0; d < DIRECTION_COUNT; ++d) {
+            int &e = index[d];
+            if (e < 0) {
+                e = i;
+                continue;
+            }
+            float a = directionScore(points[i], d), b = directionScore(points[e], d);
+            if (a > b || (a == b && i < e)) e = i;
+        }
+    }
+};
+
+// A point with its index, sorted by value so the chain doesn't chase indices around memory
+struct IndexedPoint
+{
+    Point2 pt;
+    int index;
+
+    bool operator < (const IndexedPoint& o) const
+    {
+        if (pt.x != o.pt.x) return pt.x < o.pt.x;
+        if (pt.y != o.pt.y) return pt.y < o.pt.y;
+        return index < o.index;
+    }
+};
+
+// Andrew's monotone chain; points is sorted and deduplicated in place first
+static void monotoneChain(std::vector<IndexedPoint>& points, std::vector<IndexedPoint>& hull)
+{
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end(), [](const IndexedPoint& a, const IndexedPoint& b) {
+        return a.pt.x == b.pt.x && a.pt.y == b.pt.y;
+    }), points.end());
+
+    int n = (int)points.size();
+    if (n < 3) {
+        hull = points;
+        return;
+    }
+
+    hull.resize(2 * n);
+    int k = 0;
+    for (int i = 0; i < n; ++i) {
+        while (k >= 2 && cross(hull[k - 2].pt, hull[k - 1].pt, points[i].pt) <= 0) --k;
+        hull[k++] = points[i];
+    }
+    for (int i = n - 2, lower = k + 1; i >= 0; --i) {
+        while (k >= lower && cross(hull[k - 2].pt, hull[k - 1].pt, points[i].pt) <= 0) --k;
+        hull[k++] = points[i];
+    }
+    hull.resize(k - 1);
+}
+
+// Each thread filters its range against the extreme point polygon and runs the monotone chain on
+// what is left; the hull of the union of those partial hulls is the hull of all the points, and
+// there are few enough of them for the merge to be one more chain on the calling thread.
+void calcConvexHull2D(const std::vector<Point2>& points, std::vector<int>& hull,
+        int threadCount, ConvexHullStats *stats)
+{
+    const size_t MIN_POINTS_PER_THREAD = 1 << 14;
+
+    size_t n = points.size();
+    threadCount = hullThreadCount(threadCount);
+    if ((size_t)threadCount > n / MIN_POINTS_PER_THREAD) {
+        threadCount = std::max<int>(1, (int)(n / MIN_POINTS_PER_THREAD));
+    }
+
+    std::vector<Extremes> threadExtremes(threadCount);
+    parallelRanges(n, threadCount, [&](int t, size_t begin, size_t end) {
+        Extremes &e = threadExtremes[t];
+        e.init();
+        for (size_t i = begin; i < end; ++i) e.add(points, (int)i);
+    });
+
+    Extremes extremes;
+    extremes.init();
+    for (int t = 0; t < threadCount; ++t) {
+        for (int d = 0; d < DIRECTION_COUNT; ++d) {
+            if (threadExtremes[t].index[d] >= 0) extremes.add(points, threadExtremes[t].index[d]);
+        }
+    }
+
+    // the extremes are the corners of a convex polygon, counter clockwise; points strictly
+    // inside can't be on the hull
+    std::vector<int> polygon;
+    for (int d = 0; d < DIRECTION_COUNT && n > 0; ++d) {
+        int i = extremes.index[d];
+        if (polygon.empty() || (i != polygon.back() && i != polygon.front())) polygon.push_back(i);
+    }
+    bool filter = polygon.size() >= 3;
+    for (size_t i = 0; filter && i < polygon.size(); ++i) {
+        const Point2 &a = points[polygon[i]], &b = points[polygon[(i + 1) % polygon.size()]];
+        const Point2 &c = points[polygon[(i + 2) % polygon.size()]];
+        if (cross(a, b, c) <= 0) filter = false;
+    }
+
+    std::vector<std::vector<IndexedPoint> > threadHulls(threadCount);
+    std::vector<size_t> threadFiltered(threadCount);
+    parallelRanges(n, threadCount, [&](int t, size_t begin, size_t end) {
+        std::vector<IndexedPoint> survivors;
+        for (size_t i = begin; i < end; ++i) {
+            const Point2 &p = points[i];
+            bool inside = filter;
+            for (size_t j = 0; inside && j < polygon.size(); ++j) {
+                inside = cross(points[polygon[j]], points[polygon[(j + 1) % polygon.size()]], p) > 0;
+            }
+            if (!inside) {
+                IndexedPoint s = {p, (int)i};
+                survivors.push_back(s);
+            }
+        }
+        threadFiltered[t] = survivors.size();
+        monotoneChain(survivors, threadHulls[t]);
+    });
+
+    std::vector<IndexedPoint> merged, mergedHull;
+    for (int t = 0; t < threadCount; ++t) {
+        merged.insert(merged.end(), threadHulls[t].begin(), threadHulls[t].end());
+    }
+    monotoneChain(merged, mergedHull);
+    hull.resize(mergedHull.size());
+    for (size_t i = 0; i < mergedHull.size(); ++i) hull[i] = mergedHull[i].index;
+
+    if (stats != NULL) {
+        stats->inputCount = n;
+        stats->filteredCount = 0;
+        for (int t = 0; t < threadCount; ++t) stats->filteredCount += threadFiltered[t];
+        stats->hullCount = hull.size();
+    }
+}
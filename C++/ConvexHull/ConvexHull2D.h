@@ -0,0 +1,21 @@
+#ifndef CONVEX_HULL_2D_H
+#define CONVEX_HULL_2D_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "ConvexHullUtils.h"
+
+struct Point2
+{
+    float x, y;
+};
+
+// Indices of the hull vertices of points, counter clockwise starting from the lowest x (then y)
+// one; collinear points on hull edges are left out, and of duplicated points only the lowest index
+// is kept. threadCount <= 0 uses every hardware thread; the result is the same for any count.
+void calcConvexHull2D(const std::vector<Point2>& points, std::vector<int>& hull,
+        int threadCount = 0, ConvexHullStats *stats = NULL);
+
+#endif
@@ -0,0 +1,420 @@
+#include "pch.h"
+
+#include <float.h>
+#include <math.h>
+
+#include "ConvexHull3D.h"
+
+struct Plane
+{
+    double nx, ny, nz;      // unit normal, pointing out of the hull
+    double ox, oy, oz;      // a point on the plane
+
+    double distance(const Point3& p) const
+    {
+        return nx * (p.x - ox) + ny * (p.y - oy) + nz * (p.z - oz);
+    }
+};
+
+// The plane through a, b, c with the normal (b - a) x (c - a); false if they are collinear
+static bool makePlane(const Point3& a, const Point3& b, const Point3& c, Plane& plane)
+{
+    double ux = double(b.x) - a.x, uy = double(b.y) - a.y, uz = double(b.z) - a.z;
+    double vx = double(c.x) - a.x, vy = double(c.y) - a.y, vz = double(c.z) - a.z;
+    double nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+    double len = sqrt(nx * nx + ny * ny + nz * nz);
+    plane.ox = a.x, plane.oy = a.y, plane.oz = a.z;
+    if (len == 0) {
+        plane.nx = plane.ny = plane.nz = 0;
+        return false;
+    }
+    plane.nx = nx / len, plane.ny = ny / len, plane.nz = nz / len;
+    return true;
+}
+
+static double distanceSqr(const Point3& a, const Point3& b)
+{
+    double dx = double(a.x) - b.x, dy = double(a.y) - b.y, dz = double(a.z) - b.z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+// Squared distance of p from the line through a and b
+static double lineDistanceSqr(const Point3& a, const Point3& b, const Point3& p)
+{
+    double ux = double(b.x) - a.x, uy = double(b.y) - a.y, uz = double(b.z) - a.z;
+    double vx = double(p.x) - a.x, vy = double(p.y) - a.y, vz = double(p.z) - a.z;
+    double cx = uy * vz - uz * vy, cy = uz * vx - ux * vz, cz = ux * vy - uy * vx;
+    return (cx * cx + cy * cy + cz * cz) / (ux * ux + uy * uy + uz * uz);
+}
+
+static inline float axisValue(const Point3& p, int axis)
+{
+    return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+}
+
+// Index of the lowest and highest point along each axis, ties to the lowest index
+struct AxisExtremes
+{
+    int index[3][2];
+
+    void init() { for (int a = 0; a < 3; ++a) index[a][0] = index[a][1] = -1; }
+
+    void add(const std::vector<Point3>& points, int i)
+    {
+        for (int a = 0; a < 3; ++a) {
+            float v = axisValue(points[i], a);
+            int &lo = index[a][0], &hi = index[a][1];
+            if (lo < 0 || v < axisValue(points[lo], a) || (v == axisValue(points[lo], a) && i < lo)) lo = i;
+            if (hi < 0 || v > axisValue(points[hi], a) || (v == axisValue(points[hi], a) && i < hi)) hi = i;
+        }
+    }
+};
+
+struct Face
+{
+    int v[3];
+    int adj[3];                 // the face across the edge v[i] -> v[(i + 1) % 3]
+    Plane plane;
+    std::vector<int> conflicts; // points above this face, each in the list of only one face
+    int visited;
+    bool visible;
+    bool alive;
+};
+
+// Points are copied into m_points in input order after the octahedron filter; m_ids maps back.
+// The conflict graph is the face -> points lists, every point outside the current hull being
+// in the list of one face it is above. A step takes the farthest point of a face, walks the face
+// adjacency from there to find the faces it sees and their horizon, replaces them by a fan of
+// faces to the point, and hands the visible faces' points to the fan or drops them as inside.
+class QuickHull3D
+{
+public:
+    QuickHull3D(const std::vector<Point3>& input, int threadCount):
+        m_input(input), m_threadCount(threadCount), m_eps(0), m_iteration(0) {}
+
+    bool build(std::vector<HullTriangle>& tris, ConvexHullStats *stats);
+
+private:
+    void filterPoints();
+    bool createSimplex();
+    void addFace(int p0, int p1, int p2);
+    void assignPoints(const std::vector<int>& points, int firstFace, int faceCount);
+    void addPoint(int face);
+    void findVisible(int face, const Point3& eye);
+
+private:
+    static const size_t MIN_POINTS_PER_THREAD = 1 << 14;
+
+    const std::vector<Point3>& m_input;
+    int m_threadCount;
+    double m_eps;
+    int m_iteration;
+    int m_extremes[6];
+
+    std::vector<Point3> m_points;
+    std::vector<int> m_ids;
+    std::vector<Face> m_faces;
+    std::vector<int> m_pending;
+
+    std::vector<int> m_visible;
+    std::vector<int> m_horizon;     // (face, edge) of the visible side, flattened
+    std::vector<int> m_edgeStart;   // new face by the start vertex of its horizon edge
+};
+
+bool QuickHull3D::build(std::vector<HullTriangle>& tris, ConvexHullStats *stats)
+{
+    tris.clear();
+    filterPoints();
+
+    bool ok = createSimplex();
+    while (ok && !m_pending.empty()) {
+        int f = m_pending.back();
+        m_pending.pop_back();
+        if (m_faces[f].alive && !m_faces[f].conflicts.empty()) addPoint(f);
+    }
+
+    for (int f = 0; ok && f < (int)m_faces.size(); ++f) {
+        const Face &face = m_faces[f];
+        if (!face.alive) continue;
+        HullTriangle tri = {m_ids[face.v[0]], m_ids[face.v[1]], m_ids[face.v[2]]};
+        tris.push_back(tri);
+    }
+
+    if (stats != NULL) {
+        stats->inputCount = m_input.size();
+        stats->filteredCount = m_points.size();
+        stats->hullCount = tris.size();
+    }
+    return ok;
+}
+
+// The axis extremes span an octahedron of input points: anything strictly inside all of its
+// 8 faces is inside the hull. Cheap to test and, for points filling a ball, a third of them.
+void QuickHull3D::filterPoints()
+{
+    size_t n = m_input.size();
+    int threadCount = m_threadCount;
+    if ((size_t)threadCount > n / MIN_POINTS_PER_THREAD) {
+        threadCount = std::max<int>(1, (int)(n / MIN_POINTS_PER_THREAD));
+    }
+
+    std::vector<AxisExtremes> threadExtremes(threadCount);
+    parallelRanges(n, threadCount, [&](int t, size_t begin, size_t end) {
+        AxisExtremes &e = threadExtremes[t];
+        e.init();
+        for (size_t i = begin; i < end; ++i) e.add(m_input, (int)i);
+    });
+    AxisExtremes extremes;
+    extremes.init();
+    for (int t = 0; t < threadCount; ++t) {
+        for (int a = 0; a < 3; ++a) {
+            for (int s = 0; s < 2; ++s) {
+                if (threadExtremes[t].index[a][s] >= 0) extremes.add(m_input, threadExtremes[t].index[a][s]);
+            }
+        }
+    }
+    for (int a = 0; a < 3; ++a) {
+        m_extremes[2 * a] = extremes.index[a][0];
+        m_extremes[2 * a + 1] = extremes.index[a][1];
+    }
+    if (n == 0) return;
+
+    double maxAbs = 0;
+    for (int a = 0; a < 3; ++a) {
+        maxAbs += std::max(fabs(axisValue(m_input[extremes.index[a][0]], a)),
+                fabs(axisValue(m_input[extremes.index[a][1]], a)));
+    }
+    m_eps = 3 * DBL_EPSILON * maxAbs;
+
+    // face (x, y, z) of the octant with signs (sx, sy, sz), flipped for an odd number of minuses
+    // to stay counter clockwise from outside
+    Plane planes[8];
+    bool filter = true;
+    Point3 center = {0, 0, 0};
+    for (int i = 0; i < 6; ++i) {
+        const Point3 &p = m_input[m_extremes[i]];
+        center.x += p.x / 6, center.y += p.y / 6, center.z += p.z / 6;
+    }
+    for (int octant = 0; octant < 8 && filter; ++octant) {
+        int sx = octant & 1, sy = (octant >> 1) & 1, sz = (octant >> 2) & 1;
+        const Point3 &x = m_input[m_extremes[sx]], &y = m_input[m_extremes[2 + sy]];
+        const Point3 &z = m_input[m_extremes[4 + sz]];
+        bool flip = ((3 - sx - sy - sz) & 1) != 0;
+        filter = flip ? makePlane(x, z, y, planes[octant]) : makePlane(x, y, z, planes[octant]);
+        filter = filter && planes[octant].distance(center) < -m_eps;
+    }
+
+    std::vector<std::vector<int> > survivors(threadCount);
+    parallelRanges(n, threadCount, [&](int t, size_t begin, size_t end) {
+        std::vector<int> &s = survivors[t];
+        for (size_t i = begin; i < end; ++i) {
+            bool inside = filter;
+            for (int f = 0; inside && f < 8; ++f) inside = planes[f].distance(m_input[i]) < -m_eps;
+            if (!inside) s.push_back((int)i);
+        }
+    });
+
+    size_t count = 0;
+    for (int t = 0; t < threadCount; ++t) count += survivors[t].size();
+    m_ids.reserve(count);
+    for (int t = 0; t < threadCount; ++t) m_ids.insert(m_ids.end(), survivors[t].begin(), survivors[t].end());
+    m_points.resize(count);
+    for (size_t i = 0; i < count; ++i) m_points[i] = m_input[m_ids[i]];
+}
+
+// The two most distant axis extremes, the point farthest from their line and the point farthest
+// from that plane. false if there is no such tetrahedron.
+bool QuickHull3D::createSimplex()
+{
+    int n = (int)m_points.size();
+    if (n < 4) return false;
+
+    // the extremes always survive the filter: find them in m_points
+    int extremes[6];
+    for (int i = 0; i < 6; ++i) {
+        extremes[i] = (int)(std::lower_bound(m_ids.begin(), m_ids.end(), m_extremes[i]) - m_ids.begin());
+    }
+
+    int a = extremes[0], b = extremes[1];
+    double best = -1;
+    for (int i = 0; i < 6; ++i) {
+        for (int j = i + 1; j < 6; ++j) {
+            double d = distanceSqr(m_points[extremes[i]], m_points[extremes[j]]);
+            if (d > best) best = d, a = extremes[i], b = extremes[j];
+        }
+    }
+    if (best <= m_eps * m_eps) return false;
+
+    int c = -1;
+    best = 0;
+    for (int i = 0; i < n; ++i) {
+        double d = lineDistanceSqr(m_points[a], m_points[b], m_points[i]);
+        if (d > best) best = d, c = i;
+    }
+    if (c < 0 || best <= m_eps * m_eps) return false;
+
+    Plane plane;
+    makePlane(m_points[a], m_points[b], m_points[c], plane);
+    int d = -1;
+    best = 0;
+    for (int i = 0; i < n; ++i) {
+        double dis = fabs(plane.distance(m_points[i]));
+        if (dis > best) best = dis, d = i;
+    }
+    if (d < 0 || best <= m_eps) return false;
+
+    if (plane.distance(m_points[d]) > 0) {
+        addFace(a, c, b), addFace(a, b, d), addFace(b, c, d), addFace(c, a, d);
+    } else {
+        addFace(a, b, c), addFace(b, a, d), addFace(c, b, d), addFace(a, c, d);
+    }
+    for (int f = 0; f < 4; ++f) {
+        for (int e = 0; e < 3; ++e) {
+            int u = m_faces[f].v[e], v = m_faces[f].v[(e + 1) % 3];
+            for (int g = 0; g < 4; ++g) {
+                for (int k = 0; k < 3; ++k) {
+                    if (m_faces[g].v[k] == v && m_faces[g].v[(k + 1) % 3] == u) m_faces[f].adj[e] = g;
+                }
+            }
+        }
+    }
+
+    std::vector<int> points;
+    points.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        if (i != a && i != b && i != c && i != d) points.push_back(i);
+    }
+    assignPoints(points, 0, 4);
+
+    m_edgeStart.assign(n, -1);
+    return true;
+}
+
+void QuickHull3D::addFace(int p0, int p1, int p2)
+{
+    Face face;
+    face.v[0] = p0, face.v[1] = p1, face.v[2] = p2;
+    face.adj[0] = face.adj[1] = face.adj[2] = -1;
+    makePlane(m_points[p0], m_points[p1], m_points[p2], face.plane);
+    face.visited = -1;
+    face.visible = false;
+    face.alive = true;
+    m_faces.push_back(face);
+}
+
+// Each point goes to the face in [firstFace, firstFace + faceCount) it is farthest above, or
+// nowhere. The choice only depends on the point, so big batches are split across threads and
+// the lists still come out in the same order.
+void QuickHull3D::assignPoints(const std::vector<int>& points, int firstFace, int faceCount)
+{
+    size_t n = points.size();
+    int threadCount = m_threadCount;
+    if ((size_t)threadCount > n / MIN_POINTS_PER_THREAD) {
+        threadCount = std::max<int>(1, (int)(n / MIN_POINTS_PER_THREAD));
+    }
+
+    std::vector<int> faceOf(n);
+    parallelRanges(n, threadCount, [&](int, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const Point3 &p = m_points[points[i]];
+            int best = -1;
+            double bestDistance = m_eps;
+            for (int f = firstFace; f < firstFace + faceCount; ++f) {
+                double d = m_faces[f].plane.distance(p);
+                if (d > bestDistance) bestDistance = d, best = f;
+            }
+            faceOf[i] = best;
+        }
+    });
+
+    for (size_t i = 0; i < n; ++i) {
+        if (faceOf[i] >= 0) m_faces[faceOf[i]].conflicts.push_back(points[i]);
+    }
+    for (int f = firstFace; f < firstFace + faceCount; ++f) {
+        if (!m_faces[f].conflicts.empty()) m_pending.push_back(f);
+    }
+}
+
+void QuickHull3D::findVisible(int face, const Point3& eye)
+{
+    m_visible.clear();
+    m_horizon.clear();
+
+    m_faces[face].visited = m_iteration;
+    m_faces[face].visible = true;
+    std::vector<int> stack(1, face);
+    while (!stack.empty()) {
+        int f = stack.back();
+        stack.pop_back();
+        m_visible.push_back(f);
+        for (int e = 0; e < 3; ++e) {
+            Face &nb = m_faces[m_faces[f].adj[e]];
+            if (nb.visited != m_iteration) {
+                nb.visited = m_iteration;
+                nb.visible = nb.plane.distance(eye) > m_eps;
+                if (nb.visible) stack.push_back(m_faces[f].adj[e]);
+            }
+            if (!nb.visible) {
+                m_horizon.push_back(f);
+                m_horizon.push_back(e);
+            }
+        }
+    }
+}
+
+void QuickHull3D::addPoint(int face)
+{
+    ++m_iteration;
+
+    int eye = -1;
+    double best = -1;
+    const std::vector<int> &conflicts = m_faces[face].conflicts;
+    for (size_t i = 0; i < conflicts.size(); ++i) {
+        double d = m_faces[face].plane.distance(m_points[conflicts[i]]);
+        if (d > best) best = d, eye = conflicts[i];
+    }
+
+    findVisible(face, m_points[eye]);
+
+    // a fan of faces from the horizon edges to the eye; the horizon edge u -> v of a visible face
+    // keeps its direction in the new face (u, v, eye)
+    int firstFace = (int)m_faces.size();
+    for (size_t h = 0; h < m_horizon.size(); h += 2) {
+        int f = m_horizon[h], e = m_horizon[h + 1];
+        int u = m_faces[f].v[e], v = m_faces[f].v[(e + 1) % 3], nb = m_faces[f].adj[e];
+        int nf = (int)m_faces.size();
+        addFace(u, v, eye);
+        m_faces[nf].adj[0] = nb;
+        for (int k = 0; k < 3; ++k) {
+            if (m_faces[nb].v[k] == v) m_faces[nb].adj[k] = nf;
+        }
+        m_edgeStart[u] = nf;
+    }
+    int faceCount = (int)m_faces.size() - firstFace;
+
+    // (u, v, eye) meets the fan face starting at v along v -> eye
+    for (int nf = firstFace; nf < firstFace + faceCount; ++nf) {
+        int next = m_edgeStart[m_faces[nf].v[1]];
+        m_faces[nf].adj[1] = next;
+        m_faces[next].adj[2] = nf;
+    }
+    for (int nf = firstFace; nf < firstFace + faceCount; ++nf) m_edgeStart[m_faces[nf].v[0]] = -1;
+
+    std::vector<int> orphans;
+    for (size_t i = 0; i < m_visible.size(); ++i) {
+        Face &f = m_faces[m_visible[i]];
+        f.alive = false;
+        for (size_t j = 0; j < f.conflicts.size(); ++j) {
+            if (f.conflicts[j] != eye) orphans.push_back(f.conflicts[j]);
+        }
+        std::vector<int>().swap(f.conflicts);
+    }
+    assignPoints(orphans, firstFace, faceCount);
+}
+
+bool calcConvexHull3D(const std::vector<Point3>& points, std::vector<HullTriangle>& tris,
+        int threadCount, ConvexHullStats *stats)
+{
+    QuickHull3D hull(points, hullThreadCount(threadCount));
+    return hull.build(tris, stats);
+}
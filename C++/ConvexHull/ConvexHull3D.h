@@ -0,0 +1,26 @@
+#ifndef CONVEX_HULL_3D_H
+#define CONVEX_HULL_3D_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "ConvexHullUtils.h"
+
+struct Point3
+{
+    float x, y, z;
+};
+
+// Indices of a hull triangle, counter clockwise seen from outside
+struct HullTriangle
+{
+    int p0, p1, p2;
+};
+
+// QuickHull: the triangles of the hull of points, with coplanar points dropped. Returns false,
+// leaving tris empty, if the points are all coplanar. threadCount <= 0 uses every hardware thread.
+bool calcConvexHull3D(const std::vector<Point3>& points, std::vector<HullTriangle>& tris,
+        int threadCount = 0, ConvexHullStats *stats = NULL);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef CONVEX_HULL_UTILS_H
+#define CONVEX_HULL_UTILS_H
+
+#include <stddef.h>
+
+#include <thread>
+#include <vector>
+
+struct ConvexHullStats
+{
+    size_t inputCount;
+    size_t filteredCount;   // points left after dropping the ones inside the extreme point polygon/octahedron
+    size_t hullCount;       // hull vertices in 2D, triangles in 3D
+};
+
+inline int hullThreadCount(int threadCount)
+{
+    if (threadCount > 0) return threadCount;
+    int n = (int)std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+// Splits [0, count) into threadCount contiguous ranges and runs f(thread, begin, end) for each,
+// the last one on the calling thread. Range t always gets the same points for the same
+// threadCount, so per-thread results concatenated in thread order are deterministic.
+template<typename FuncT>
+void parallelRanges(size_t count, int threadCount, FuncT f)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        size_t begin = count * t / threadCount, end = count * (t + 1) / threadCount;
+        if (t == threadCount - 1) {
+            f(t, begin, end);
+        } else {
+            threads.push_back(std::thread([=]() { f(t, begin, end); }));
+        }
+    }
+    for (int t = 0; t < (int)threads.size(); ++t) {
+        threads[t].join();
+    }
+}
+
+#endif
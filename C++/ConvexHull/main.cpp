@@ -0,0 +1,207 @@
+#include "pch.h"
+
+#include <math.h>
+
+#include <chrono>
+#include <random>
+#include <set>
+#include <utility>
+
+#include "ConvexHull2D.h"
+#include "ConvexHull3D.h"
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum Distribution { IN_SQUARE, IN_DISK, ON_CIRCLE, IN_GRID };
+
+static const char* distributionName(Distribution d)
+{
+    static const char *names[] = {"box", "ball", "sphere", "grid"};
+    return names[d];
+}
+
+// Points in [-1, 1]^dim, in the unit ball, on the unit sphere, or on a coarse grid with lots of
+// duplicates and coplanar points
+template<typename PointT, int DIM>
+static void genPoints(vector<PointT>& points, int n, Distribution d, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> uniform(-1, 1);
+    std::normal_distribution<float> normal;
+    points.resize(n);
+    for (int i = 0; i < n; ++i) {
+        float v[3] = {0, 0, 0};
+        if (d == IN_GRID) {
+            for (int k = 0; k < DIM; ++k) v[k] = (int)(gen() % 21) / 10.f - 1;
+        } else if (d == ON_CIRCLE) {
+            float len = 0;
+            while (len == 0) {
+                for (int k = 0; k < DIM; ++k) v[k] = normal(gen);
+                len = 0;
+                for (int k = 0; k < DIM; ++k) len += v[k] * v[k];
+            }
+            for (int k = 0; k < DIM; ++k) v[k] /= sqrt(len);
+        } else {
+            for (;;) {
+                float len = 0;
+                for (int k = 0; k < DIM; ++k) v[k] = uniform(gen), len += v[k] * v[k];
+                if (d == IN_SQUARE || len <= 1) break;
+            }
+        }
+        memcpy(&points[i], v, sizeof(PointT));
+    }
+}
+
+#ifndef NDEBUG
+
+static double cross2D(const Point2& o, const Point2& a, const Point2& b)
+{
+    return (double(a.x) - o.x) * (double(b.y) - o.y) - (double(a.y) - o.y) * (double(b.x) - o.x);
+}
+
+// strictly convex, counter clockwise, and nothing outside
+static void checkHull2D(const vector<Point2>& points, const vector<int>& hull)
+{
+    int h = (int)hull.size();
+    assert(h >= 3);
+    for (int i = 0; i < h; ++i) {
+        assert(cross2D(points[hull[i]], points[hull[(i + 1) % h]], points[hull[(i + 2) % h]]) > 0);
+    }
+    for (int i = 0; i < h; ++i) {
+        const Point2 &a = points[hull[i]], &b = points[hull[(i + 1) % h]];
+        for (int j = 0; j < (int)points.size(); ++j) {
+            assert(cross2D(a, b, points[j]) >= -1e-9);
+        }
+    }
+}
+
+static double planeDistance(const vector<Point3>& points, const HullTriangle& tri, const Point3& p)
+{
+    const Point3 &a = points[tri.p0], &b = points[tri.p1], &c = points[tri.p2];
+    double ux = double(b.x) - a.x, uy = double(b.y) - a.y, uz = double(b.z) - a.z;
+    double vx = double(c.x) - a.x, vy = double(c.y) - a.y, vz = double(c.z) - a.z;
+    double nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+    double len = sqrt(nx * nx + ny * ny + nz * nz);
+    return (nx * (p.x - a.x) + ny * (p.y - a.y) + nz * (p.z - a.z)) / len;
+}
+
+// a closed 2-manifold (every edge once in each direction, V - E + F = 2) with every point
+// on or below every face
+static void checkHull3D(const vector<Point3>& points, const vector<HullTriangle>& tris, int pointStep)
+{
+    set<pair<int, int> > edges;
+    set<int> vertices;
+    for (int i = 0; i < (int)tris.size(); ++i) {
+        const int *p = &tris[i].p0;
+        for (int k = 0; k < 3; ++k) {
+            bool inserted = edges.insert(make_pair(p[k], p[(k + 1) % 3])).second;
+            assert(inserted);
+            vertices.insert(p[k]);
+        }
+    }
+    for (set<pair<int, int> >::const_iterator iter = edges.begin(); iter != edges.end(); ++iter) {
+        assert(edges.count(make_pair(iter->second, iter->first)));
+    }
+    assert((int)vertices.size() - (int)edges.size() / 2 + (int)tris.size() == 2);
+
+    for (int i = 0; i < (int)tris.size(); ++i) {
+        for (int j = 0; j < (int)points.size(); j += pointStep) {
+            assert(planeDistance(points, tris[i], points[j]) <= 1e-5);
+        }
+    }
+}
+
+static void testHull2D()
+{
+    Distribution dists[] = {IN_SQUARE, IN_DISK, ON_CIRCLE, IN_GRID};
+    int sizes[] = {3, 10, 100, 1000, 50000};
+    vector<Point2> points;
+    vector<int> hull, hull1;
+    for (Distribution d : dists) {
+        for (int n : sizes) {
+            genPoints<Point2, 2>(points, n, d, n);
+            calcConvexHull2D(points, hull1, 1);
+            calcConvexHull2D(points, hull, 4);
+            assert(hull == hull1);
+            if (d != ON_CIRCLE || n <= 1000) checkHull2D(points, hull);
+        }
+    }
+}
+
+static void testHull3D()
+{
+    Distribution dists[] = {IN_SQUARE, IN_DISK, ON_CIRCLE, IN_GRID};
+    int sizes[] = {4, 10, 100, 1000, 50000};
+    vector<Point3> points;
+    vector<HullTriangle> tris, tris1;
+    for (Distribution d : dists) {
+        for (int n : sizes) {
+            genPoints<Point3, 3>(points, n, d, n);
+            bool ok1 = calcConvexHull3D(points, tris1, 1);
+            bool ok = calcConvexHull3D(points, tris, 4);
+            assert(ok == ok1 && tris.size() == tris1.size());
+            assert(memcmp(tris.data(), tris1.data(), tris.size() * sizeof(HullTriangle)) == 0);
+            if (ok) checkHull3D(points, tris, n > 1000 ? 97 : 1);
+        }
+    }
+
+    // all on one plane
+    points.clear();
+    for (int i = 0; i < 100; ++i) {
+        Point3 p = {(float)(i % 10), (float)(i / 10), 1};
+        points.push_back(p);
+    }
+    assert(!calcConvexHull3D(points, tris));
+    assert(tris.empty());
+}
+
+#endif
+
+template<typename PointT, int DIM, typename HullT>
+static void benchmark(const char *name, int n, Distribution d, int threadCount,
+        bool (*calc)(const vector<PointT>&, HullT&, int, ConvexHullStats*))
+{
+    vector<PointT> points;
+    genPoints<PointT, DIM>(points, n, d, 1);
+
+    HullT hull;
+    ConvexHullStats stats;
+    double start = now();
+    calc(points, hull, threadCount, &stats);
+    double seconds = now() - start;
+    printf("%s %-6s n=%-10d threads=%-2d filtered=%-10d hull=%-8d %8.3fs %10.4g points/s\n",
+            name, distributionName(d), n, threadCount, (int)stats.filteredCount, (int)stats.hullCount,
+            seconds, n / seconds);
+}
+
+static bool calcHull2D(const vector<Point2>& points, vector<int>& hull, int threadCount, ConvexHullStats *stats)
+{
+    calcConvexHull2D(points, hull, threadCount, stats);
+    return true;
+}
+
+// usage: main [log10 of the largest benchmark, 6-8]
+int main(int argc, char *argv[])
+{
+#ifndef NDEBUG
+    puts("test: 2d");
+    testHull2D();
+    puts("test: 3d");
+    testHull3D();
+#endif
+
+    int maxLog10 = argc > 1 ? atoi(argv[1]) : 7;
+    int threadCount = hullThreadCount(0);
+    for (int e = 6, n = 1000000; e <= maxLog10; ++e, n *= 10) {
+        benchmark<Point2, 2>("2d", n, IN_SQUARE, threadCount, calcHull2D);
+        benchmark<Point2, 2>("2d", n, IN_DISK, threadCount, calcHull2D);
+        benchmark<Point2, 2>("2d", n, ON_CIRCLE, threadCount, calcHull2D);
+        benchmark<Point3, 3>("3d", n, IN_SQUARE, threadCount, calcConvexHull3D);
+        benchmark<Point3, 3>("3d", n, IN_DISK, threadCount, calcConvexHull3D);
+        // every point is a hull vertex, so the size is bounded by the faces' memory instead
+        if (e == 6) benchmark<Point3, 3>("3d", n, ON_CIRCLE, threadCount, calcConvexHull3D);
+    }
+}
@@ -12,6 +12,8 @@
 
 #include <gl/glut.h>
 
+#include "../ConvexHull/ConvexHull2D.h"
+
 const int WIDTH = 400, HEIGHT = 300;
 
 inline bool fequal(float a, float b)
@@ -103,59 +105,18 @@ void ConvexHull::genPoints(int n)
 
 void ConvexHull::calcConvexHull()
 {
-    m_convexHull.clear();
-
-    std::sort(m_points.begin(), m_points.end());
-    m_points.erase(std::unique(m_points.begin(), m_points.end()), m_points.end());
-
-    struct PointInfo
-    {
-        Vector2 pt;
-        float cosA;
-        float dis;
-    };
-    std::vector<PointInfo> points;
-    for (int i = 1; i < (int)m_points.size(); ++i) {
-        PointInfo info = {m_points[i]};
-        info.dis = (info.pt - m_points[0]).length();
-        info.cosA = (info.pt - m_points[0]).dot(Vector2::AXIS_X) / info.dis;
-        points.push_back(info);
+    std::vector<Point2> points(m_points.size());
+    for (int i = 0; i < (int)m_points.size(); ++i) {
+        points[i].x = m_points[i].x;
+        points[i].y = m_points[i].y;
     }
 
-    struct Comparer
-    {
-        bool operator () (const PointInfo& l, const PointInfo& r) const
-        {
-            if (fequal(l.cosA, r.cosA)) {
-                return l.dis > r.dis;
-            }
-            return l.cosA < r.cosA;
-        }
-    };
-    std::sort(points.begin(), points.end(), Comparer());
+    std::vector<int> hull;
+    calcConvexHull2D(points, hull);
 
-    int sz = (int)points.size();
-    for (int i = 0; i < (int)points.size() - 1; ++i) {
-        if (fequal(points[i].cosA, points[i + 1].cosA)) {
-            points.erase(points.begin() + i + 1);
-        }
-    }
-    cout << "trim same angle:" << sz - points.size() << endl;
-
-    m_convexHull.push_back(m_points[0]);
-    m_convexHull.push_back(points[0].pt);
-    m_convexHull.push_back(points[1].pt);
-    for (int i = 2; i < (int)points.size(); ++i) {
-        for (;;) {
-            const Vector2& pt0 = m_convexHull[m_convexHull.size() - 2];
-            const Vector2& pt1 = m_convexHull[m_convexHull.size() - 1];
-            const Vector2& pt2 = points[i].pt;
-            if ((pt2 - pt1).cross(pt0 - pt1) > 0.0001) {
-                break;
-            }
-            m_convexHull.pop_back();
-        }
-        m_convexHull.push_back(points[i].pt);
+    m_convexHull.clear();
+    for (int i = 0; i < (int)hull.size(); ++i) {
+        m_convexHull.push_back(m_points[hull[i]]);
     }
 }
 
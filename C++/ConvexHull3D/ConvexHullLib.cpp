@@ -0,0 +1,6 @@
+// vim:fileencoding=gbk
+
+#include "pch.h"
+
+// the demo builds the hull library from its sources, so its project only needs the files here
+#include "../ConvexHull/ConvexHull3D.cpp"
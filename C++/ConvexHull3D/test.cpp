@@ -8,12 +8,12 @@
 
 #include <exception>
 #include <vector>
-#include <set>
 #include <algorithm>
-#include <functional>
 
 #include <gl/glut.h>
 
+#include "../ConvexHull/ConvexHull3D.h"
+
 float EPSILON = 0.0001f;
 
 inline bool fequal(float a, float b)
@@ -135,16 +135,6 @@ struct Triangle
     {
         return (o - pts[p0]).dot(norm);
     }
-    int edge(int i) const
-    {
-        const int *p = &p0;
-        return (p[i] << 16) | p[(i + 1) % 3];
-    }
-    int redge(int i) const
-    {
-        int e = edge(i);
-        return (e << 16) | ((e >> 16) & 0xffff);
-    }
 };
 
 class ConvexHull3D
@@ -204,82 +194,21 @@ void ConvexHull3D::drawHull()
 
 bool ConvexHull3D::calcHull()
 {
-    std::sort(m_points.begin(), m_points.end());
-    m_points.erase(std::unique(m_points.begin(), m_points.end()), m_points.end());
-    if (m_points.size() < 4) return false;
-
-    // the first 3 point is in the same line
-    {
-        Vector3 v01(m_points[1] - m_points[0]);
-        Vector3 v02(m_points[2] - m_points[0]);
-        if (fequal(fabs(v01.dot(v02)),
-                    v01.length() * v02.length())) {
-            return false;
-        }
-    }
-
-    // the fourth point is in the same plane
-    {
-        Triangle tri(0, 1, 2, &m_points[0]);
-        float dis = tri.disOfPoint(m_points[3]);
-        if (fequal(dis, 0)) return false;
-        if (dis > 0) {
-            std::swap(m_points[1], m_points[2]);
-        }
+    std::vector<Point3> points(m_points.size());
+    for (int i = 0; i < (int)m_points.size(); ++i) {
+        points[i].x = m_points[i].x;
+        points[i].y = m_points[i].y;
+        points[i].z = m_points[i].z;
     }
 
-    std::vector<Triangle> tris;
-    tris.push_back(Triangle(0, 1, 2, &m_points[0]));
-    tris.push_back(Triangle(0, 3, 1, &m_points[0]));
-    tris.push_back(Triangle(0, 2, 3, &m_points[0]));
-    tris.push_back(Triangle(3, 2, 1, &m_points[0]));
+    std::vector<HullTriangle> hull;
+    if (!calcConvexHull3D(points, hull)) return false;
 
-    struct Front:
-        std::unary_function<Triangle, bool>
-    {
-        Front(const Vector3& _pt): pt(_pt){}
-        bool operator () (const Triangle& tri) const
-        {
-            return tri.disOfPoint(pt) > EPSILON;
-        }
-        Vector3 pt;
-    };
-
-    for (int i = 4; i < (int)m_points.size(); ++i) {
-        std::vector<Triangle>::iterator iter = std::remove_if(tris.begin(), tris.end(), Front(m_points[i]));
-        if (iter == tris.end()) {
-            continue;
-        }
-
-        tris.erase(iter, tris.end());
-
-        std::set<int> edges;
-        for (int j = 0; j < (int)tris.size(); ++j) {
-            const Triangle& tri = tris[j];
-            for (int k = 0; k < 3; ++k) {
-                int re = tri.redge(k);
-                if (edges.count(re)) {
-                    edges.erase(re);
-                    continue;
-                }
-                edges.insert(tri.edge(k));
-            }
-        }
-
-        for (std::set<int>::const_iterator iter = edges.begin();
-                iter != edges.end();
-                ++iter) {
-            int e = *iter;
-            tris.push_back(Triangle(e & 0xffff, (e >> 16) & 0xffff, i, &m_points[0]));
-        }
-    }
-
-    for (int i = 0; i < (int)m_points.size(); ++i) {
-        assert(std::remove_if(tris.begin(), tris.end(), Front(m_points[i])) == tris.end());
+    m_tris.clear();
+    for (int i = 0; i < (int)hull.size(); ++i) {
+        m_tris.push_back(Triangle(hull[i].p0, hull[i].p1, hull[i].p2, &m_points[0]));
     }
 
-    m_tris = tris;
-
     return true;
 }
 
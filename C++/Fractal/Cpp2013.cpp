@@ -9,6 +9,7 @@
 #include "OpenMPFractalRenderer.h"
 #include "OpenCLFractalRenderer.h"
 #include "CppAMPFractalRenderer.h"
+#include "PerturbationFractalRenderer.h"
 
 extern IFractalRenderer* CreateCUDAFractalRenderer(int width, int height);
 extern IFractalRenderer* CreateOpenGLFractalRenderer();
@@ -28,6 +29,11 @@ private:
     TFloat mMinY = -2;
     TFloat mMaxY = 2;
     int mMaxIteration = 32;
+    // The perturbation renderer zooms on its own view: the center in FixedPoint and the half sizes in
+    // double, because mMinX..mMaxY are TFloat and run out of precision around 1e-7 of the center.
+    PerturbationFractalRenderer *mDeepRenderer = nullptr;
+    FixedPoint mDeepCenterX, mDeepCenterY;
+    double mDeepHalfX = 2, mDeepHalfY = 2;
 
 public:
     FractalRenderWindow()
@@ -44,8 +50,27 @@ public:
     {
     }
 
+    // Matches the center precision to the pixel size and keeps the TFloat view (Julia sets, other
+    // renderers) close to the deep one.
+    void UpdateDeepView()
+    {
+        double pixelSize = std::min(mDeepHalfX * 2 / GetWidth(), mDeepHalfY * 2 / GetHeight());
+        int fractionLimbs = FixedPoint::FractionLimbsForPixelSize(pixelSize);
+        mDeepCenterX = mDeepCenterX.WithFractionLimbs(fractionLimbs);
+        mDeepCenterY = mDeepCenterY.WithFractionLimbs(fractionLimbs);
+
+        double midX = mDeepCenterX.ToDouble(), midY = mDeepCenterY.ToDouble();
+        mMinX = TFloat(midX - mDeepHalfX), mMaxX = TFloat(midX + mDeepHalfX);
+        mMinY = TFloat(midY - mDeepHalfY), mMaxY = TFloat(midY + mDeepHalfY);
+    }
+
     virtual void KeyDown(int key) override
     {
+        if (key >= '1' && key <= '5')
+        {
+            mDeepRenderer = nullptr;
+        }
+
         if (key == 'W')
         {
             ++mMaxIteration;
@@ -98,6 +123,20 @@ public:
             mRenderer.reset(CreateOpenGLFractalRenderer());
             cout << "Switch to OpenGL renderer" << endl;
         }
+        else if (key == '6')
+        {
+            if (mDeepRenderer == nullptr)
+            {
+                mDeepHalfX = (mMaxX - mMinX) / 2.0, mDeepHalfY = (mMaxY - mMinY) / 2.0;
+                mDeepCenterX = FixedPoint::FromDouble((mMinX + mMaxX) / 2.0, 2);
+                mDeepCenterY = FixedPoint::FromDouble((mMinY + mMaxY) / 2.0, 2);
+                UpdateDeepView();
+            }
+            auto renderer = make_unique<PerturbationFractalRenderer>();
+            mDeepRenderer = renderer.get();
+            mRenderer = std::move(renderer);
+            cout << "Switch to perturbation renderer" << endl;
+        }
     }
 
     virtual void KeyUp(int k) override
@@ -135,6 +174,19 @@ public:
             mJuliaCy += dy;
             cout << "cx:" << mJuliaCx << ", cy" << mJuliaCy << endl;
         }
+        else if (mDeepRenderer != nullptr && mPressedMouseButton == MouseButton::Left)
+        {
+            mDeepCenterX -= FixedPoint::FromDouble(dx * mDeepHalfY, mDeepCenterX.FractionLimbs());
+            mDeepCenterY -= FixedPoint::FromDouble(dy * mDeepHalfY, mDeepCenterY.FractionLimbs());
+            UpdateDeepView();
+            cout << "centerX:" << mDeepCenterX.ToDouble() << ", centerY:" << mDeepCenterY.ToDouble() << endl;
+        }
+        else if (mDeepRenderer != nullptr)
+        {
+            mDeepHalfX *= 1 + dy, mDeepHalfY *= 1 + dy;
+            UpdateDeepView();
+            cout << "scale:" << std::setw(32) << 2 / mDeepHalfY << endl;
+        }
         else if (mPressedMouseButton == MouseButton::Left)
         {
             TFloat moveScale = 1 / GetScale() * 2;
@@ -179,6 +231,12 @@ public:
         switch (((mRenderShape % 8) + 8) % 8)
         {
         case 0:
+            if (mDeepRenderer != nullptr)
+            {
+                mDeepRenderer->RenderMandelbrotDeep(
+                    buffer, width, height, mMaxIteration, mDeepCenterX, mDeepCenterY, mDeepHalfX, mDeepHalfY);
+                break;
+            }
             mRenderer->RenderMandelbrot(buffer, width, height, mMaxIteration, mMinX, mMaxX, mMinY, mMaxY);
             break;
         case 1:
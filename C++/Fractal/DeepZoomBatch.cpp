@@ -0,0 +1,89 @@
+// Headless deep zoom: renders a Mandelbrot zoom sequence with PerturbationFractalRenderer to PPM files.
+// Doesn't need a window or GPU, e.g. on Linux:
+//   g++ -std=c++11 -O2 -mavx2 -fopenmp DeepZoomBatch.cpp -o DeepZoomBatch
+// Usage:
+//   DeepZoomBatch centerX centerY [startRadius endRadius frameCount maxIteration width height prefix]
+// The center is a plain decimal string with as many digits as the zoom needs; the radius is the
+// half height of the view and shrinks geometrically from startRadius to endRadius.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PerturbationFractalRenderer.h"
+
+static bool SavePPM(char const *fileName, int const *buffer, int width, int height)
+{
+    FILE *f = fopen(fileName, "wb");
+    if (f == nullptr) return false;
+
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> line(width * 3);
+    for (int y = height - 1; y >= 0; --y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            int c = buffer[y * width + x];
+            line[x * 3] = (c >> 16) & 0xff;
+            line[x * 3 + 1] = (c >> 8) & 0xff;
+            line[x * 3 + 2] = c & 0xff;
+        }
+        fwrite(&line[0], 1, line.size(), f);
+    }
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cout << "usage: " << argv[0]
+            << " centerX centerY [startRadius endRadius frameCount maxIteration width height prefix]" << std::endl;
+        return 1;
+    }
+
+    char const *centerX = argv[1], *centerY = argv[2];
+    double startRadius = argc > 3 ? atof(argv[3]) : 2;
+    double endRadius = argc > 4 ? atof(argv[4]) : 1e-30;
+    int frameCount = argc > 5 ? atoi(argv[5]) : 30;
+    int maxIteration = argc > 6 ? atoi(argv[6]) : 10000;
+    int width = argc > 7 ? atoi(argv[7]) : 640;
+    int height = argc > 8 ? atoi(argv[8]) : 480;
+    std::string prefix = argc > 9 ? argv[9] : "zoom_";
+
+    std::vector<int> buffer(width * height);
+    PerturbationFractalRenderer renderer;
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        double t = frameCount > 1 ? double(frame) / (frameCount - 1) : 0;
+        double radius = startRadius * pow(endRadius / startRadius, t);
+        int fractionLimbs = FixedPoint::FractionLimbsForPixelSize(radius * 2 / height);
+
+        renderer.RenderMandelbrotDeep(
+            &buffer[0], width, height, maxIteration,
+            FixedPoint::FromString(centerX, fractionLimbs), FixedPoint::FromString(centerY, fractionLimbs),
+            radius * width / height, radius);
+
+        char fileName[32];
+        sprintf(fileName, "%04d.ppm", frame);
+        std::string path = prefix + fileName;
+        if (!SavePPM(path.c_str(), &buffer[0], width, height))
+        {
+            std::cout << "failed to save " << path << std::endl;
+            return 1;
+        }
+
+        PerturbationFractalRenderer::FrameInfo const &info = renderer.GetLastFrameInfo();
+        std::cout << path << ": radius " << radius
+            << ", " << info.fractionLimbs * 32 << " fraction bits"
+            << ", reference " << info.referenceLength
+            << ", skipped " << info.skippedIterations
+            << ", " << info.seconds << "s" << std::endl;
+    }
+}
@@ -0,0 +1,198 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <cassert>
+#include <cstdint>
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
+// Signed fixed-point number for deep zoom reference orbits: two's complement over
+// 32-bit limbs (little endian), the top limb is the integer part and the other
+// FractionLimbs() limbs are the fraction.
+class FixedPoint
+{
+public:
+    explicit FixedPoint(int fractionLimbs = 2)
+        : mLimbs(fractionLimbs + 1, 0)
+    {
+    }
+
+    // Enough fraction limbs to resolve pixelSize with some guard bits for the orbit iteration.
+    static int FractionLimbsForPixelSize(double pixelSize)
+    {
+        int bits = pixelSize > 0 ? -std::ilogb(pixelSize) + 64 : 64;
+        return bits < 64 ? 2 : (bits + 31) / 32;
+    }
+
+    static FixedPoint FromDouble(double v, int fractionLimbs)
+    {
+        FixedPoint r(fractionLimbs);
+        double m = std::fabs(v);
+        double intPart = std::floor(m);
+        r.mLimbs.back() = static_cast<uint32_t>(intPart);
+        m -= intPart;
+        for (int i = fractionLimbs - 1; i >= 0 && m > 0; --i)
+        {
+            m *= 4294967296.0;
+            double limb = std::floor(m);
+            r.mLimbs[i] = static_cast<uint32_t>(limb);
+            m -= limb;
+        }
+        if (v < 0) r.Negate();
+        return r;
+    }
+
+    // Plain decimal like "-0.74364388703715870475", no exponent.
+    static FixedPoint FromString(char const *str, int fractionLimbs)
+    {
+        FixedPoint r(fractionLimbs);
+        bool negative = *str == '-';
+        if (*str == '-' || *str == '+') ++str;
+
+        uint32_t intPart = 0;
+        for (; *str >= '0' && *str <= '9'; ++str) intPart = intPart * 10 + (*str - '0');
+
+        if (*str == '.')
+        {
+            char const *first = ++str;
+            while (*str >= '0' && *str <= '9') ++str;
+            // Horner from the last digit: x = (x + d) / 10
+            for (char const *p = str; p != first; )
+            {
+                r.mLimbs.back() += *--p - '0';
+                r.DivideMagnitude(10);
+            }
+        }
+        r.mLimbs.back() += intPart;
+        if (negative) r.Negate();
+        return r;
+    }
+
+    int FractionLimbs() const
+    {
+        return static_cast<int>(mLimbs.size()) - 1;
+    }
+
+    // Same value with fractionLimbs fraction limbs: new low limbs are zero, dropped ones truncate.
+    FixedPoint WithFractionLimbs(int fractionLimbs) const
+    {
+        FixedPoint r(fractionLimbs);
+        int shift = fractionLimbs - FractionLimbs();
+        for (int i = 0; i < static_cast<int>(mLimbs.size()); ++i)
+        {
+            if (i + shift >= 0) r.mLimbs[i + shift] = mLimbs[i];
+        }
+        return r;
+    }
+
+    bool IsNegative() const
+    {
+        return (mLimbs.back() >> 31) != 0;
+    }
+
+    double ToDouble() const
+    {
+        FixedPoint m(*this);
+        if (IsNegative()) m.Negate();
+        double r = 0;
+        for (int i = 0; i < static_cast<int>(m.mLimbs.size()); ++i)
+        {
+            r += std::ldexp(static_cast<double>(m.mLimbs[i]), 32 * (i - FractionLimbs()));
+        }
+        return IsNegative() ? -r : r;
+    }
+
+    FixedPoint& operator += (FixedPoint const &o)
+    {
+        assert(mLimbs.size() == o.mLimbs.size());
+        uint64_t carry = 0;
+        for (size_t i = 0; i < mLimbs.size(); ++i)
+        {
+            carry += uint64_t(mLimbs[i]) + o.mLimbs[i];
+            mLimbs[i] = static_cast<uint32_t>(carry);
+            carry >>= 32;
+        }
+        return *this;
+    }
+
+    FixedPoint& operator -= (FixedPoint const &o)
+    {
+        assert(mLimbs.size() == o.mLimbs.size());
+        int64_t borrow = 0;
+        for (size_t i = 0; i < mLimbs.size(); ++i)
+        {
+            int64_t d = int64_t(mLimbs[i]) - o.mLimbs[i] + borrow;
+            mLimbs[i] = static_cast<uint32_t>(d);
+            borrow = d < 0 ? -1 : 0;
+        }
+        return *this;
+    }
+
+    // Truncates the magnitude of the product to FractionLimbs() limbs.
+    friend FixedPoint operator * (FixedPoint const &a, FixedPoint const &b)
+    {
+        assert(a.mLimbs.size() == b.mLimbs.size());
+        FixedPoint ma(a), mb(b);
+        if (a.IsNegative()) ma.Negate();
+        if (b.IsNegative()) mb.Negate();
+
+        size_t n = ma.mLimbs.size();
+        std::vector<uint32_t> product(n * 2, 0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < n; ++j)
+            {
+                carry += uint64_t(ma.mLimbs[i]) * mb.mLimbs[j] + product[i + j];
+                product[i + j] = static_cast<uint32_t>(carry);
+                carry >>= 32;
+            }
+            product[i + n] = static_cast<uint32_t>(carry);
+        }
+
+        FixedPoint r(a.FractionLimbs());
+        std::copy(product.begin() + (n - 1), product.begin() + (2 * n - 1), r.mLimbs.begin());
+        if (a.IsNegative() != b.IsNegative()) r.Negate();
+        return r;
+    }
+
+private:
+    void Negate()
+    {
+        uint64_t carry = 1;
+        for (size_t i = 0; i < mLimbs.size(); ++i)
+        {
+            carry += uint32_t(~mLimbs[i]);
+            mLimbs[i] = static_cast<uint32_t>(carry);
+            carry >>= 32;
+        }
+    }
+
+    void DivideMagnitude(uint32_t d)
+    {
+        uint64_t rem = 0;
+        for (int i = static_cast<int>(mLimbs.size()) - 1; i >= 0; --i)
+        {
+            uint64_t cur = (rem << 32) | mLimbs[i];
+            mLimbs[i] = static_cast<uint32_t>(cur / d);
+            rem = cur % d;
+        }
+    }
+
+private:
+    std::vector<uint32_t> mLimbs;
+};
+
+inline FixedPoint operator + (FixedPoint a, FixedPoint const &b)
+{
+    return a += b;
+}
+
+inline FixedPoint operator - (FixedPoint a, FixedPoint const &b)
+{
+    return a -= b;
+}
+
+#endif
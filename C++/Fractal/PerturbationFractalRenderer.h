@@ -0,0 +1,405 @@
+#ifndef PERTURBATION_FRACTAL_RENDERER_H
+#define PERTURBATION_FRACTAL_RENDERER_H
+
+#include <cmath>
+
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+#include <omp.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "FractalRenderer.h"
+#include "FixedPoint.h"
+
+// Deep zoom Mandelbrot on CPU:
+//  1. one reference orbit at the view center in FixedPoint, stored as double
+//  2. series approximation skips the first iterations shared by the whole view
+//  3. every pixel iterates its double offset from the reference (4 pixels per AVX2 vector),
+//     and rebases onto the start of the orbit when the offset outgrows the orbit
+// Tiles are handed to threads dynamically. Doesn't need a window, so it can run headless.
+class PerturbationFractalRenderer : public IFractalRenderer
+{
+public:
+    struct FrameInfo
+    {
+        int referenceLength;
+        int skippedIterations;
+        int fractionLimbs;
+        double seconds;
+    };
+
+public:
+    explicit PerturbationFractalRenderer(int tileSize = 32)
+        : mTileSize(tileSize)
+    {
+        mLastFrame = FrameInfo{ 0, 0, 0, 0 };
+    }
+
+    virtual void ResetBuffer(int, int) override
+    {
+    }
+
+    virtual void RenderMandelbrot(
+        int *buffer, int width, int height, int maxIteration,
+        TFloat minX, TFloat maxX, TFloat minY, TFloat maxY) override
+    {
+        double pixelSize = std::fmin((maxX - minX) / width, (maxY - minY) / height);
+        int fractionLimbs = FixedPoint::FractionLimbsForPixelSize(pixelSize);
+        RenderMandelbrotDeep(
+            buffer, width, height, maxIteration,
+            FixedPoint::FromDouble((minX + maxX) / 2.0, fractionLimbs),
+            FixedPoint::FromDouble((minY + maxY) / 2.0, fractionLimbs),
+            (maxX - minX) / 2.0, (maxY - minY) / 2.0);
+    }
+
+    // Center in FixedPoint, so the view can be far smaller than a double ulp of the center.
+    // Offsets are doubles, which limits the half sizes to about 1e-300.
+    void RenderMandelbrotDeep(
+        int *buffer, int width, int height, int maxIteration,
+        FixedPoint const &centerX, FixedPoint const &centerY, double halfWidth, double halfHeight)
+    {
+        double start = omp_get_wtime();
+
+        mPixelSizeX = halfWidth * 2 / width;
+        mPixelSizeY = halfHeight * 2 / height;
+        mMaxIteration = maxIteration;
+        BuildReferenceOrbit(centerX, centerY, maxIteration);
+        BuildSeries(width, height);
+
+        int tileCountX = (width + mTileSize - 1) / mTileSize;
+        int tileCount = tileCountX * ((height + mTileSize - 1) / mTileSize);
+
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int tile = 0; tile < tileCount; ++tile)
+        {
+            int x0 = tile % tileCountX * mTileSize, y0 = tile / tileCountX * mTileSize;
+            RenderMandelbrotTile(buffer, width, height, x0, y0,
+                std::min(x0 + mTileSize, width), std::min(y0 + mTileSize, height));
+        }
+
+        mLastFrame.referenceLength = static_cast<int>(mRef.size());
+        mLastFrame.skippedIterations = mSkip;
+        mLastFrame.fractionLimbs = centerX.FractionLimbs();
+        mLastFrame.seconds = omp_get_wtime() - start;
+    }
+
+    // Only the Mandelbrot set zooms deep; Julia sets are iterated directly in double with the
+    // same tile scheduling.
+    virtual void RenderJuliaSet(
+        int *buffer, int width, int height, int maxIteration, TFloat cx, TFloat cy,
+        TFloat minX, TFloat maxX, TFloat minY, TFloat maxY) override
+    {
+        double fdy = 1.0 / height * (maxY - minY), fdx = 1.0 / width * (maxX - minX);
+        int tileCountX = (width + mTileSize - 1) / mTileSize;
+        int tileCount = tileCountX * ((height + mTileSize - 1) / mTileSize);
+
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int tile = 0; tile < tileCount; ++tile)
+        {
+            int x0 = tile % tileCountX * mTileSize, y0 = tile / tileCountX * mTileSize;
+            int x1 = std::min(x0 + mTileSize, width), y1 = std::min(y0 + mTileSize, height);
+            for (int y = y0; y < y1; ++y)
+            {
+                for (int x = x0; x < x1; ++x)
+                {
+                    double zx = minX + fdx * x, zy = minY + fdy * y;
+                    int iteration = 0;
+                    for (; iteration < maxIteration && zx * zx + zy * zy < 4; ++iteration)
+                    {
+                        double newZx = zx * zx - zy * zy + cx;
+                        zy = 2 * zx * zy + cy;
+                        zx = newZx;
+                    }
+                    buffer[y * width + x] = Colorize(iteration, maxIteration, zx, zy);
+                }
+            }
+        }
+    }
+
+    FrameInfo const& GetLastFrameInfo() const
+    {
+        return mLastFrame;
+    }
+
+private:
+    typedef std::complex<double> Complex;
+
+    // Z(n+1) = Z(n)^2 + C until escape or maxIteration; Z(0) = 0 is kept so rebasing can restart at index 0.
+    void BuildReferenceOrbit(FixedPoint const &cx, FixedPoint const &cy, int maxIteration)
+    {
+        mRef.clear();
+
+        FixedPoint zx(cx.FractionLimbs()), zy(cx.FractionLimbs());
+        for (int i = 0; i <= maxIteration; ++i)
+        {
+            double x = zx.ToDouble(), y = zy.ToDouble();
+            mRef.push_back(Complex(x, y));
+            if (x * x + y * y >= 4) break;
+
+            FixedPoint xy = zx * zy;
+            zx = zx * zx - zy * zy + cx;
+            zy = xy + xy + cy;
+        }
+    }
+
+    // delta(n) = A(n) dc + B(n) dc^2 + C(n) dc^3 for every pixel while the cubic term is negligible
+    // against the distance between neighbour pixels; the view corners then check the result against
+    // plain perturbation and halve the skip until they agree.
+    void BuildSeries(int width, int height)
+    {
+        double radius = std::hypot(mPixelSizeX * width / 2, mPixelSizeY * height / 2);
+        double pixelSize = std::fmin(mPixelSizeX, mPixelSizeY);
+        int refLength = static_cast<int>(mRef.size());
+
+        mA.assign(1, Complex(0));
+        mB.assign(1, Complex(0));
+        mC.assign(1, Complex(0));
+        for (int n = 0; n + 1 < refLength - 1; ++n)
+        {
+            Complex z2 = 2.0 * mRef[n];
+            Complex a = z2 * mA[n] + 1.0;
+            Complex b = z2 * mB[n] + mA[n] * mA[n];
+            Complex c = z2 * mC[n] + 2.0 * mA[n] * mB[n];
+            if (std::abs(c) * radius * radius * radius > 1e-9 * std::abs(a) * pixelSize) break;
+            mA.push_back(a);
+            mB.push_back(b);
+            mC.push_back(c);
+        }
+        mSkip = static_cast<int>(mA.size()) - 1;
+
+        double cornerX[] = { -width / 2.0, width / 2.0, -width / 2.0, width / 2.0 };
+        double cornerY[] = { -height / 2.0, -height / 2.0, height / 2.0, height / 2.0 };
+        for (int i = 0; i < 4 && mSkip > 0; ++i)
+        {
+            Complex dc(cornerX[i] * mPixelSizeX, cornerY[i] * mPixelSizeY);
+            while (mSkip > 0)
+            {
+                Complex delta = 0;
+                int n = 0;
+                for (; n < mSkip; ++n)
+                {
+                    Complex const &z = mRef[n];
+                    if (std::norm(z + delta) >= 4) break;
+                    delta = 2.0 * z * delta + delta * delta + dc;
+                }
+                if (n == mSkip && std::abs(SeriesDelta(dc) - delta) <= 1e-6 * std::abs(delta)) break;
+                mSkip = std::min(n, mSkip) / 2;
+            }
+        }
+    }
+
+    Complex SeriesDelta(Complex const &dc) const
+    {
+        return ((mC[mSkip] * dc + mB[mSkip]) * dc + mA[mSkip]) * dc;
+    }
+
+    void RenderMandelbrotTile(int *buffer, int width, int height, int x0, int y0, int x1, int y1) const
+    {
+        for (int y = y0; y < y1; ++y)
+        {
+            double dcy = (y - height / 2.0) * mPixelSizeY;
+            for (int x = x0; x < x1; x += 4)
+            {
+                double dcx[4], dx[4], dy[4], iteration[4], zx[4], zy[4];
+                int laneCount = std::min(4, x1 - x);
+                for (int i = 0; i < 4; ++i)
+                {
+                    dcx[i] = (x + i - width / 2.0) * mPixelSizeX;
+                    Complex delta = SeriesDelta(Complex(dcx[i], dcy));
+                    dx[i] = delta.real(), dy[i] = delta.imag();
+                }
+                IteratePixels4(dcx, dcy, dx, dy, laneCount, iteration, zx, zy);
+                for (int i = 0; i < laneCount; ++i)
+                {
+                    buffer[y * width + x + i] = Colorize(static_cast<int>(iteration[i]), mMaxIteration, zx[i], zy[i]);
+                }
+            }
+        }
+    }
+
+#if defined(__AVX2__)
+    // z(n) = Z(ref) + delta; delta' = 2 Z(ref) delta + delta^2 + dc. Lanes keep their own reference
+    // index because of rebasing. All lanes step every iteration and a lane's result is taken when it
+    // finishes, so the only loop-carried chain is the delta recurrence; rebasing is rare and branches.
+    void IteratePixels4(
+        double const *dcx, double dcy, double const *dx, double const *dy, int laneCount,
+        double *iteration, double *zx, double *zy) const
+    {
+        double const *ref = reinterpret_cast<double const*>(&mRef[0]);
+        __m256d vdcx = _mm256_loadu_pd(dcx), vdcy = _mm256_set1_pd(dcy);
+        __m256d vdx = _mm256_loadu_pd(dx), vdy = _mm256_loadu_pd(dy);
+        __m128i index = _mm_set1_epi32(mSkip);
+        __m128i refLast = _mm_set1_epi32(static_cast<int>(mRef.size()) - 1);
+        int active = (1 << laneCount) - 1;
+        __m256d resultIter = _mm256_setzero_pd(), resultX = resultIter, resultY = resultIter;
+        __m256d four = _mm256_set1_pd(4), zero = _mm256_setzero_pd();
+
+        for (int iter = mSkip; ; ++iter)
+        {
+            // Gather instructions are slow, load the (x, y) pairs and transpose instead
+            __m256d ref02 = _mm256_insertf128_pd(
+                _mm256_castpd128_pd256(_mm_loadu_pd(ref + 2 * _mm_cvtsi128_si32(index))),
+                _mm_loadu_pd(ref + 2 * _mm_extract_epi32(index, 2)), 1);
+            __m256d ref13 = _mm256_insertf128_pd(
+                _mm256_castpd128_pd256(_mm_loadu_pd(ref + 2 * _mm_extract_epi32(index, 1))),
+                _mm_loadu_pd(ref + 2 * _mm_extract_epi32(index, 3)), 1);
+            __m256d refX = _mm256_unpacklo_pd(ref02, ref13);
+            __m256d refY = _mm256_unpackhi_pd(ref02, ref13);
+            __m256d vzx = _mm256_add_pd(refX, vdx), vzy = _mm256_add_pd(refY, vdy);
+            __m256d mag = _mm256_add_pd(_mm256_mul_pd(vzx, vzx), _mm256_mul_pd(vzy, vzy));
+
+            int done = iter >= mMaxIteration ? active : active & _mm256_movemask_pd(_mm256_cmp_pd(mag, four, _CMP_GE_OQ));
+            if (done != 0)
+            {
+                __m256d doneMask = LaneMask(done);
+                resultIter = _mm256_blendv_pd(resultIter, _mm256_set1_pd(iter), doneMask);
+                resultX = _mm256_blendv_pd(resultX, vzx, doneMask);
+                resultY = _mm256_blendv_pd(resultY, vzy, doneMask);
+                active &= ~done;
+                if (active == 0) break;
+            }
+
+            // Rebase when the pixel is closer to 0 than its offset, or the reference ran out
+            __m256d deltaMag = _mm256_add_pd(_mm256_mul_pd(vdx, vdx), _mm256_mul_pd(vdy, vdy));
+            int rebase = _mm256_movemask_pd(_mm256_cmp_pd(mag, deltaMag, _CMP_LT_OQ)) |
+                _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(index, refLast)));
+            if (rebase != 0)
+            {
+                __m256d rebaseMask = LaneMask(rebase);
+                vdx = _mm256_blendv_pd(vdx, vzx, rebaseMask);
+                vdy = _mm256_blendv_pd(vdy, vzy, rebaseMask);
+                refX = _mm256_blendv_pd(refX, zero, rebaseMask);
+                refY = _mm256_blendv_pd(refY, zero, rebaseMask);
+                index = _mm_andnot_si128(_mm_set_epi32(
+                    -((rebase >> 3) & 1), -((rebase >> 2) & 1), -((rebase >> 1) & 1), -(rebase & 1)), index);
+            }
+
+            // real: (2 Zx + dx) dx - (2 Zy + dy) dy + dcx, imag: 2 ((Zx + dx) dy + Zy dx) + dcy
+            __m256d newDx = _mm256_sub_pd(
+                _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(refX, refX), vdx), vdx),
+                _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(refY, refY), vdy), vdy));
+            __m256d newDy = _mm256_add_pd(
+                _mm256_mul_pd(_mm256_add_pd(refX, vdx), vdy), _mm256_mul_pd(refY, vdx));
+            vdx = _mm256_add_pd(newDx, vdcx);
+            vdy = _mm256_add_pd(_mm256_add_pd(newDy, newDy), vdcy);
+            index = _mm_add_epi32(index, _mm_set1_epi32(1));
+        }
+
+        _mm256_storeu_pd(iteration, resultIter);
+        _mm256_storeu_pd(zx, resultX);
+        _mm256_storeu_pd(zy, resultY);
+    }
+
+    static __m256d LaneMask(int bits)
+    {
+        return _mm256_castsi256_pd(_mm256_set_epi64x(
+            -((bits >> 3) & 1), -((bits >> 2) & 1), -((bits >> 1) & 1), -(bits & 1)));
+    }
+#else
+    // Scalar fallback of the AVX2 version above, one lane at a time.
+    void IteratePixels4(
+        double const *dcx, double dcy, double const *dx, double const *dy, int laneCount,
+        double *iteration, double *zx, double *zy) const
+    {
+        int refLast = static_cast<int>(mRef.size()) - 1;
+        for (int i = 0; i < laneCount; ++i)
+        {
+            double deltaX = dx[i], deltaY = dy[i];
+            int index = mSkip, iter = mSkip;
+            for (;;)
+            {
+                double refX = mRef[index].real(), refY = mRef[index].imag();
+                double x = refX + deltaX, y = refY + deltaY;
+                double mag = x * x + y * y;
+                if (mag >= 4 || iter >= mMaxIteration)
+                {
+                    iteration[i] = iter, zx[i] = x, zy[i] = y;
+                    break;
+                }
+
+                if (mag < deltaX * deltaX + deltaY * deltaY || index >= refLast)
+                {
+                    deltaX = x, deltaY = y;
+                    refX = refY = 0;
+                    index = 0;
+                }
+
+                double newDx = (refX + refX + deltaX) * deltaX - (refY + refY + deltaY) * deltaY + dcx[i];
+                double newDy = (refX + deltaX) * deltaY + refY * deltaX;
+                deltaY = newDy + newDy + dcy;
+                deltaX = newDx;
+                ++index, ++iter;
+            }
+        }
+    }
+#endif
+
+    // Same smooth coloring as the other renderers
+    static int Colorize(int iteration, int maxIteration, double zx, double zy)
+    {
+        double smoothIteration = iteration;
+        if (iteration < maxIteration)
+        {
+            double logZn = log(zx * zx + zy * zy) / 2;
+            double nu = log(logZn / log(2.0)) / log(2.0);
+            smoothIteration = smoothIteration + 1 - nu;
+        }
+
+        double value = smoothIteration / maxIteration;
+        return HSV2RGB(value, 1 - value * value, sqrt(value));
+    }
+
+    static int HSV2RGB(double H, double S, double V)
+    {
+        double C = V * S;
+        double H1 = H * 6;
+        double X = C * (1 - fabs(fmod(H1, 2) - 1));
+        double R1, G1, B1;
+        switch ((int)H1)
+        {
+        case 0:
+            R1 = C; G1 = X; B1 = 0;
+            break;
+        case 1:
+            R1 = X; G1 = C; B1 = 0;
+            break;
+        case 2:
+            R1 = 0; G1 = C; B1 = X;
+            break;
+        case 3:
+            R1 = 0; G1 = X; B1 = C;
+            break;
+        case 4:
+            R1 = X; G1 = 0; B1 = C;
+            break;
+        case 5:
+            R1 = C; G1 = 0; B1 = X;
+            break;
+        default:
+            R1 = 0; G1 = 0; B1 = 0;
+            break;
+        }
+
+        double m = V - C;
+        int r = (int)((R1 + m) * 255);
+        int g = (int)((G1 + m) * 255);
+        int b = (int)((B1 + m) * 255);
+        return (0 << 24) | (r << 16) | (g << 8) | (b << 0);
+    }
+
+private:
+    int mTileSize;
+    int mMaxIteration = 0;
+    int mSkip = 0;
+    double mPixelSizeX = 0, mPixelSizeY = 0;
+    std::vector<Complex> mRef;
+    std::vector<Complex> mA, mB, mC;
+    FrameInfo mLastFrame;
+};
+
+#endif
@@ -0,0 +1,400 @@
+#include "pch.h"
+
+#include <stdint.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "SlabAllocator.h"
+
+static const int CHUNK_SIZE = 2 << 20;
+static const int SLAB_SIZE = 64 << 10;
+static const size_t ARENA_SIZE = sizeof(void*) == 8 ? (size_t)16 << 30 : (size_t)256 << 20;
+static const int MAGAZINE_SIZE = 64;
+static const int MAX_SMALL_SIZE = 1024;
+static const int SIZE_CLASSES[] = {16,32,48,64,80,96,112,128,160,192,224,256,320,384,448,512,640,768,896,1024};
+static const int SIZE_CLASS_COUNT = COUNT_OF(SIZE_CLASSES);
+
+static inline int countTrailingZeros(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return (int)i;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+static char* reserveArena(size_t size)
+{
+#ifdef _WIN32
+    return (char*)VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_READWRITE);
+#else
+    // over reserve to align the arena to a chunk, pages are only backed when touched
+    char *p = (char*)mmap(NULL, size + CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    char *aligned = (char*)(((uintptr_t)p + CHUNK_SIZE - 1) & ~(uintptr_t)(CHUNK_SIZE - 1));
+    if (aligned > p) munmap(p, aligned - p);
+    munmap(aligned + size, p + CHUNK_SIZE - aligned);
+    return aligned;
+#endif
+}
+static void releaseArena(char *p, size_t size)
+{
+#ifdef _WIN32
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, size);
+#endif
+}
+static bool commitChunk(char *p)
+{
+#ifdef _WIN32
+    return VirtualAlloc(p, CHUNK_SIZE, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+#ifdef MADV_HUGEPAGE
+    madvise(p, CHUNK_SIZE, MADV_HUGEPAGE);
+#endif
+    return true;
+#endif
+}
+//====================
+struct Slab
+{
+    uint64_t summary; // bit i is set if words[i] has a free slot
+    uint64_t words[64]; // bit j of words[i] is set if slot i * 64 + j is free
+    Slab *prev, *next;
+    int classIdx;
+    int slotSize;
+    int slotCount;
+    int freeCount;
+
+    void reset(int _classIdx);
+    char* getSlot(int idx);
+    int getSlotIdx(void *p);
+    int allocSlots(void **ptrs, int n);
+    void freeSlot(void *p);
+    bool isEmpty() const { return freeCount == slotCount; }
+    bool isFull() const { return freeCount == 0; }
+};
+static const int SLAB_HEADER_SIZE = (sizeof(Slab) + 63) / 64 * 64;
+
+void Slab::reset(int _classIdx)
+{
+    classIdx = _classIdx;
+    slotSize = SIZE_CLASSES[classIdx];
+    slotCount = (SLAB_SIZE - SLAB_HEADER_SIZE) / slotSize;
+    assert(slotCount <= 64 * 64);
+    freeCount = slotCount;
+    prev = next = NULL;
+
+    summary = 0;
+    memset(words, 0, sizeof(words));
+    for (int i = 0; i < slotCount / 64; ++i) words[i] = ~0ULL;
+    if (slotCount % 64 != 0) words[slotCount / 64] = (1ULL << (slotCount % 64)) - 1;
+    for (int i = 0; i < (slotCount + 63) / 64; ++i) summary |= 1ULL << i;
+}
+char* Slab::getSlot(int idx)
+{
+    return (char*)this + SLAB_HEADER_SIZE + idx * slotSize;
+}
+int Slab::getSlotIdx(void *p)
+{
+    return int((char*)p - (char*)this - SLAB_HEADER_SIZE) / slotSize;
+}
+int Slab::allocSlots(void **ptrs, int n)
+{
+    int count = 0;
+    while (count < n && summary != 0) {
+        int i = countTrailingZeros(summary);
+        uint64_t word = words[i];
+        for (; word != 0 && count < n; word &= word - 1) {
+            ptrs[count++] = getSlot(i * 64 + countTrailingZeros(word));
+        }
+        words[i] = word;
+        if (word == 0) summary &= ~(1ULL << i);
+    }
+    freeCount -= count;
+    return count;
+}
+void Slab::freeSlot(void *p)
+{
+    int idx = getSlotIdx(p);
+    assert(getSlot(idx) == p);
+    assert((words[idx / 64] & (1ULL << (idx % 64))) == 0);
+    words[idx / 64] |= 1ULL << (idx % 64);
+    summary |= 1ULL << (idx / 64);
+    ++freeCount;
+}
+
+static Slab* getSlab(void *p)
+{
+    return (Slab*)((uintptr_t)p & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+//====================
+struct SizeClass
+{
+    std::mutex lock;
+    Slab partial; // sentinel of the slabs with free slots
+    int emptySlabCount;
+
+    SizeClass(): emptySlabCount(0)
+    {
+        partial.prev = partial.next = &partial;
+    }
+    void link(Slab *slab)
+    {
+        slab->next = partial.next;
+        slab->prev = &partial;
+        partial.next->prev = slab;
+        partial.next = slab;
+    }
+    void unlink(Slab *slab)
+    {
+        slab->prev->next = slab->next;
+        slab->next->prev = slab->prev;
+        slab->prev = slab->next = NULL;
+    }
+};
+
+static int size2ClassIdx(int size)
+{
+    // SIZE_CLASSES for every multiple of 16
+    static struct Table
+    {
+        unsigned char idxs[MAX_SMALL_SIZE / 16 + 1];
+        Table()
+        {
+            for (int i = 0, classIdx = 0; i <= MAX_SMALL_SIZE / 16; ++i) {
+                while (SIZE_CLASSES[classIdx] < i * 16) ++classIdx;
+                idxs[i] = (unsigned char)classIdx;
+            }
+        }
+    } s_table;
+    return s_table.idxs[(size + 15) / 16];
+}
+//====================
+struct Magazine
+{
+    int count;
+    void *ptrs[MAGAZINE_SIZE];
+};
+struct SlabThreadMagazines
+{
+    Magazine *loaded[SIZE_CLASS_COUNT];
+    Magazine *previous[SIZE_CLASS_COUNT];
+    Magazine storage[SIZE_CLASS_COUNT * 2];
+
+    SlabThreadMagazines()
+    {
+        for (int i = 0; i < SIZE_CLASS_COUNT; ++i) {
+            loaded[i] = &storage[i * 2];
+            previous[i] = &storage[i * 2 + 1];
+            loaded[i]->count = previous[i]->count = 0;
+        }
+    }
+    ~SlabThreadMagazines()
+    {
+        SlabAllocator *allocator = SlabAllocator::instance();
+        for (int i = 0; i < SIZE_CLASS_COUNT; ++i) {
+            allocator->freeToSlabs(i, loaded[i]->ptrs, loaded[i]->count);
+            allocator->freeToSlabs(i, previous[i]->ptrs, previous[i]->count);
+            loaded[i]->count = previous[i]->count = 0;
+        }
+        t_magazinesExited = true;
+    }
+    static thread_local bool t_magazinesExited;
+};
+thread_local bool SlabThreadMagazines::t_magazinesExited;
+static thread_local SlabThreadMagazines t_magazines;
+//====================
+SlabAllocator::SlabAllocator(bool useMagazines):
+    m_useMagazines(useMagazines), m_arenaSize(ARENA_SIZE), m_arenaUsed(0), m_freeSlabs(NULL)
+{
+    m_sizeClasses = new SizeClass[SIZE_CLASS_COUNT];
+    m_arena = reserveArena(m_arenaSize);
+    if (m_arena == NULL) m_arenaSize = 0;
+}
+SlabAllocator::~SlabAllocator()
+{
+    if (m_arena != NULL) releaseArena(m_arena, m_arenaSize);
+    delete[] m_sizeClasses;
+}
+SlabThreadMagazines* SlabAllocator::getMagazines()
+{
+    // objects freed by the destructors of other thread locals go straight to the slabs
+    if (!m_useMagazines || SlabThreadMagazines::t_magazinesExited) return NULL;
+    return &t_magazines;
+}
+Slab* SlabAllocator::allocSlab(int classIdx)
+{
+    Slab *slab;
+    {
+        lock_guard<mutex> guard(m_arenaLock);
+        if (m_freeSlabs != NULL) {
+            slab = m_freeSlabs;
+            m_freeSlabs = slab->next;
+        } else {
+            if (m_arenaUsed % CHUNK_SIZE == 0) {
+                if (m_arenaUsed + CHUNK_SIZE > m_arenaSize) return NULL;
+                if (!commitChunk(m_arena + m_arenaUsed)) return NULL;
+            }
+            slab = (Slab*)(m_arena + m_arenaUsed);
+            m_arenaUsed += SLAB_SIZE;
+        }
+    }
+    slab->reset(classIdx);
+    return slab;
+}
+int SlabAllocator::allocFromSlabs(int classIdx, void **ptrs, int n)
+{
+    SizeClass &sizeClass = m_sizeClasses[classIdx];
+    lock_guard<mutex> guard(sizeClass.lock);
+
+    int count = 0;
+    while (count < n) {
+        Slab *slab = sizeClass.partial.next;
+        if (slab == &sizeClass.partial) {
+            if ((slab = allocSlab(classIdx)) == NULL) break;
+            sizeClass.link(slab);
+            ++sizeClass.emptySlabCount;
+        }
+        if (slab->isEmpty()) --sizeClass.emptySlabCount;
+        count += slab->allocSlots(ptrs + count, n - count);
+        if (slab->isFull()) sizeClass.unlink(slab);
+    }
+    return count;
+}
+void SlabAllocator::freeToSlabs(int classIdx, void **ptrs, int n)
+{
+    if (n == 0) return;
+    SizeClass &sizeClass = m_sizeClasses[classIdx];
+    Slab *freeSlabs = NULL;
+    {
+        lock_guard<mutex> guard(sizeClass.lock);
+        for (int i = 0; i < n; ++i) {
+            Slab *slab = getSlab(ptrs[i]);
+            assert(slab->classIdx == classIdx);
+            if (slab->isFull()) sizeClass.link(slab);
+            slab->freeSlot(ptrs[i]);
+            if (!slab->isEmpty()) continue;
+
+            // keep one empty slab per size class, the others can be taken by any size class
+            if (sizeClass.emptySlabCount == 0) {
+                ++sizeClass.emptySlabCount;
+            } else {
+                sizeClass.unlink(slab);
+                slab->next = freeSlabs;
+                freeSlabs = slab;
+            }
+        }
+    }
+    if (freeSlabs != NULL) {
+        lock_guard<mutex> guard(m_arenaLock);
+        while (freeSlabs != NULL) {
+            Slab *slab = freeSlabs;
+            freeSlabs = slab->next;
+            slab->next = m_freeSlabs;
+            m_freeSlabs = slab;
+        }
+    }
+}
+void* SlabAllocator::alloc(int size)
+{
+    if (size > MAX_SMALL_SIZE) return ::malloc(size);
+
+    int classIdx = size2ClassIdx(size);
+    SlabThreadMagazines *magazines = getMagazines();
+    if (magazines == NULL) {
+        void *p;
+        return allocFromSlabs(classIdx, &p, 1) == 1 ? p : NULL;
+    }
+
+    Magazine *loaded = magazines->loaded[classIdx];
+    if (loaded->count == 0) {
+        Magazine *previous = magazines->previous[classIdx];
+        if (previous->count > 0) {
+            magazines->loaded[classIdx] = previous;
+            magazines->previous[classIdx] = loaded;
+            loaded = previous;
+        } else {
+            loaded->count = allocFromSlabs(classIdx, loaded->ptrs, MAGAZINE_SIZE);
+            if (loaded->count == 0) return NULL;
+        }
+    }
+    return loaded->ptrs[--loaded->count];
+}
+void SlabAllocator::free(void *p)
+{
+    if (p == NULL) return;
+    if (!isInArena(p)) {
+        ::free(p);
+        return;
+    }
+
+    int classIdx = getSlab(p)->classIdx;
+    SlabThreadMagazines *magazines = getMagazines();
+    if (magazines == NULL) {
+        freeToSlabs(classIdx, &p, 1);
+        return;
+    }
+
+    Magazine *loaded = magazines->loaded[classIdx];
+    if (loaded->count == MAGAZINE_SIZE) {
+        // both full: the previous one goes back to the slabs and the loaded one becomes previous
+        Magazine *previous = magazines->previous[classIdx];
+        if (previous->count > 0) {
+            freeToSlabs(classIdx, previous->ptrs, previous->count);
+            previous->count = 0;
+        }
+        magazines->loaded[classIdx] = previous;
+        magazines->previous[classIdx] = loaded;
+        loaded = previous;
+    }
+    loaded->ptrs[loaded->count++] = p;
+}
+int SlabAllocator::allocBulk(int size, void **ptrs, int n)
+{
+    if (size > MAX_SMALL_SIZE) {
+        for (int i = 0; i < n; ++i) {
+            if ((ptrs[i] = ::malloc(size)) == NULL) return i;
+        }
+        return n;
+    }
+
+    int classIdx = size2ClassIdx(size);
+    int count = 0;
+    if (SlabThreadMagazines *magazines = getMagazines()) {
+        Magazine *loaded = magazines->loaded[classIdx];
+        int m = min(n, loaded->count);
+        loaded->count -= m;
+        memcpy(ptrs, loaded->ptrs + loaded->count, m * sizeof(void*));
+        count = m;
+    }
+    return count + allocFromSlabs(classIdx, ptrs + count, n - count);
+}
+void SlabAllocator::freeBulk(void **ptrs, int n)
+{
+    int begin = 0;
+    while (begin < n) {
+        void *p = ptrs[begin];
+        if (p == NULL || !isInArena(p)) {
+            ::free(p);
+            ++begin;
+            continue;
+        }
+
+        int classIdx = getSlab(p)->classIdx;
+        int end = begin + 1;
+        while (end < n && ptrs[end] != NULL && isInArena(ptrs[end]) && getSlab(ptrs[end])->classIdx == classIdx) ++end;
+        freeToSlabs(classIdx, ptrs + begin, end - begin);
+        begin = end;
+    }
+}
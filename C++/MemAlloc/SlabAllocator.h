@@ -0,0 +1,48 @@
+
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+#include <mutex>
+
+/*
+   Slab allocator for objects up to 1K: 2M chunks (the huge page size) are cut into 64K slabs of one size class,
+   every slab keeps a 64 x 64 bits free map and a 64 bits summary of its non empty words, so a free slot is found
+   with two count-trailing-zeros. The allocator of instance() also keeps two magazines of free objects per size
+   class and per thread, which serve most of the calls without taking the lock of the size class.
+   Larger objects go to ::malloc.
+ * */
+class SlabAllocator
+{
+public:
+    SlabAllocator(bool useMagazines = false);
+    ~SlabAllocator();
+    static SlabAllocator* instance()
+    {
+        static SlabAllocator s_ins(true);
+        return &s_ins;
+    }
+
+    void* alloc(int size);
+    void free(void *p);
+    // allocates n objects of size into ptrs, returns the count allocated
+    int allocBulk(int size, void **ptrs, int n);
+    // the objects may be of any size, runs of the same size class take the lock once
+    void freeBulk(void **ptrs, int n);
+private:
+    friend struct SlabThreadMagazines;
+    struct Slab* allocSlab(int classIdx);
+    int allocFromSlabs(int classIdx, void **ptrs, int n);
+    void freeToSlabs(int classIdx, void **ptrs, int n);
+    bool isInArena(void *p) const { return (size_t)((char*)p - m_arena) < m_arenaSize; }
+    struct SlabThreadMagazines* getMagazines();
+private:
+    struct SizeClass *m_sizeClasses;
+    bool m_useMagazines;
+    char *m_arena;
+    size_t m_arenaSize;
+    size_t m_arenaUsed;
+    struct Slab *m_freeSlabs;
+    std::mutex m_arenaLock;
+};
+
+#endif
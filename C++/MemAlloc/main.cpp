@@ -2,8 +2,12 @@
 
 #include <time.h>
 
+#include <chrono>
+#include <thread>
+
 #include "FixsizeAllocator.h"
 #include "BitVectorAllocator.h"
+#include "SlabAllocator.h"
 
 static void* alloc0(int sz) { return ::malloc(sz);}
 static void free0(void *p){ ::free(p);}
@@ -11,6 +15,15 @@ static void* alloc1(int sz) { return FixsizeAllocator::instance()->malloc(sz);}
 static void free1(void *p){ FixsizeAllocator::instance()->free(p);}
 static void* alloc2(int sz) { return BitVectorAllocator::instance()->alloc(sz);}
 static void free2(void *p){ BitVectorAllocator::instance()->free(p);}
+static void* alloc3(int sz) { return SlabAllocator::instance()->alloc(sz);}
+static void free3(void *p){ SlabAllocator::instance()->free(p);}
+
+static const char *names[] = {"malloc", "FixsizeAllocator", "BitVectorAllocator", "SlabAllocator"};
+
+static double getTime()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 static int genRanSize()
 {
@@ -30,8 +43,8 @@ static int genRanSize()
 
 static void test()
 {
-    void* (*allocas[])(int) = {&alloc0, &alloc1, &alloc2};
-    void (*frees[])(void*) = {&free0, &free1, &free2};
+    void* (*allocas[])(int) = {&alloc0, &alloc1, &alloc2, &alloc3};
+    void (*frees[])(void*) = {&free0, &free1, &free2, &free3};
 
     vector<int> ranSizes;
     for (int i = 0; i < (1<<15); ++i) ranSizes.push_back(genRanSize());
@@ -60,13 +73,104 @@ static void test()
             total += t2 + t1;
         }
 
-        printf("%d : %f\n", i, total / float(CLOCKS_PER_SEC));
+        printf("%s : %f\n", names[i], total / float(CLOCKS_PER_SEC));
     } 
 }
 
+// batches of one size, allocBulk/freeBulk against a loop of alloc/free
+static void testBulk()
+{
+    const int BATCH = 256;
+    const int ROUND = 20000;
+    void *ptrs[BATCH];
+    SlabAllocator *slab = SlabAllocator::instance();
+
+    for (int size = 16; size <= 256; size *= 4) {
+        double t = getTime();
+        for (int i = 0; i < ROUND; ++i) {
+            for (int j = 0; j < BATCH; ++j) ptrs[j] = ::malloc(size);
+            for (int j = 0; j < BATCH; ++j) ::free(ptrs[j]);
+        }
+        double tMalloc = getTime() - t;
+
+        t = getTime();
+        for (int i = 0; i < ROUND; ++i) {
+            for (int j = 0; j < BATCH; ++j) ptrs[j] = slab->alloc(size);
+            for (int j = 0; j < BATCH; ++j) slab->free(ptrs[j]);
+        }
+        double tLoop = getTime() - t;
+
+        t = getTime();
+        for (int i = 0; i < ROUND; ++i) {
+            int n = slab->allocBulk(size, ptrs, BATCH);
+            assert(n == BATCH);
+            slab->freeBulk(ptrs, n);
+        }
+        double tBulk = getTime() - t;
+
+        printf("size %d x %d : malloc %f, alloc/free %f, allocBulk/freeBulk %f\n", size, BATCH, tMalloc, tLoop, tBulk);
+    }
+}
+
+// malloc and the slab magazines on several threads, a quarter of the objects is freed by the next thread
+static void testThreads()
+{
+    const int ROUND = 100;
+    const int COUNT = 1 << 14;
+
+    for (int threadCount = 1; threadCount <= 4; threadCount *= 2) {
+        for (int i = 0; i < 4; i += 3) {
+            auto alloc = i == 0 ? &alloc0 : &alloc3;
+            auto free = i == 0 ? &free0 : &free3;
+            vector<vector<void*>> handoffs(threadCount);
+            vector<mutex> locks(threadCount);
+            vector<thread> threads;
+
+            double t = getTime();
+            for (int id = 0; id < threadCount; ++id) {
+                threads.push_back(thread([&, id]() {
+                    vector<void*> pts;
+                    vector<int> ranSizes;
+                    unsigned seed = id * 7919 + 1;
+                    for (int j = 0; j < COUNT; ++j) {
+                        seed = seed * 1103515245 + 12345;
+                        ranSizes.push_back((seed >> 16) % 128 + 4);
+                    }
+                    for (int round = 0; round < ROUND; ++round) {
+                        for (auto sz : ranSizes) pts.push_back(alloc(sz));
+                        for (auto p : pts) *(char*)p = 23;
+
+                        int next = (id + 1) % threadCount;
+                        {
+                            lock_guard<mutex> guard(locks[next]);
+                            handoffs[next].insert(handoffs[next].end(), pts.begin(), pts.begin() + pts.size() / 4);
+                        }
+                        for (size_t j = pts.size() / 4; j < pts.size(); ++j) free(pts[j]);
+                        pts.clear();
+
+                        {
+                            lock_guard<mutex> guard(locks[id]);
+                            pts.swap(handoffs[id]);
+                        }
+                        for (auto p : pts) free(p);
+                        pts.clear();
+                    }
+                }));
+            }
+            for (auto &th : threads) th.join();
+            for (auto &handoff : handoffs) for (auto p : handoff) free(p);
+            t = getTime() - t;
+
+            printf("%d threads, %s : %f\n", threadCount, names[i], t);
+        }
+    }
+}
+
 int main()
 {
     srand((int)time(NULL));
 
     test();
+    testBulk();
+    testThreads();
 }
@@ -0,0 +1,502 @@
+/*
+ * mtdriver.c - Multi-threaded driver for the thread caching allocator in
+ * scan_tcmalloc_mt.h, compared against the libc malloc.
+ *
+ * For every thread count, a child process runs the workload on that many
+ * threads, while the main thread samples the resident set size. The
+ * workers publish the bytes they hold after every operation and sum them
+ * up whenever their own count reaches a new high, so the peak of the held
+ * bytes is seen even in runs shorter than the sampling period. The
+ * reported fragmentation is the peak growth of the resident set divided by
+ * the peak of the held bytes.
+ *
+ * Workloads:
+ *   - synthetic (default): every thread keeps a window of blocks with a
+ *     mix of small, medium and large sizes, and hands a part of its frees
+ *     to the next thread, which frees them remotely;
+ *   - trace (-f): every thread replays a .rep trace on its own ids.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "scan_tcmalloc_mt.h"
+
+/**********************
+ * Constants and types
+ **********************/
+
+#define MAX_THREADS 64
+#define WINDOW_SIZE 4096     /* live block slots of a synthetic thread */
+#define HANDOFF_BATCH 64     /* blocks sent to another thread at once */
+#define SAMPLE_USECS 2000    /* period of the memory sampler */
+
+typedef struct {
+    char type;   /* 'a' alloc, 'f' free, 'r' realloc */
+    int index;   /* id of the block */
+    int size;    /* bytes for alloc and realloc */
+} traceop_t;
+
+typedef struct {
+    int num_ids;
+    std::vector<traceop_t> ops;
+} trace_t;
+
+typedef struct {
+    void *(*malloc)(size_t);
+    void (*free)(void *);
+    void *(*realloc)(void *, size_t);
+    const char *name;
+} allocator_t;
+
+typedef struct {
+    int threads;
+    double ops;
+    double secs;
+    double peak_live;  /* bytes */
+    double peak_rss;   /* bytes over the rss before the run */
+} result_t;
+
+/* one per thread, on its own cache line */
+struct alignas(64) thread_state_t {
+    std::atomic<long long> live;  /* bytes allocated minus freed by this thread, written by it only */
+    std::mutex inbox_lock;
+    std::vector<void *> inbox;    /* blocks handed over by the previous thread */
+    std::vector<int> inbox_sizes;
+};
+
+/******************
+ * Global variables
+ ******************/
+
+static allocator_t allocator;
+static trace_t *trace = NULL;
+static int trace_repeat = 1;
+static long ops_per_thread = 1000000;
+static int remote_percent = 10;
+static thread_state_t states[MAX_THREADS];
+static int nthreads;
+static std::atomic<long long> peak_live(0);
+
+/*********************
+ * Function prototypes
+ *********************/
+
+static trace_t *read_trace(const char *filename);
+static void synthetic_worker(int id);
+static void trace_worker(int id);
+static result_t run(int threads);
+static void publish_live(thread_state_t *st, long long live, long long *thread_peak);
+static long read_rss(void);
+static double now_secs(void);
+static void usage(void);
+
+static void libc_free(void *ptr) { free(ptr); }
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    int c, i;
+    int thread_counts[MAX_THREADS], num_thread_counts = 0;
+
+    allocator.malloc = tcmt::tc_malloc;
+    allocator.free = tcmt::tc_free;
+    allocator.realloc = tcmt::tc_realloc;
+    allocator.name = "tc_malloc";
+
+    while ((c = getopt(argc, argv, "f:t:n:r:k:lh")) != EOF) {
+        switch (c) {
+        case 'f': /* replay a trace file in every thread */
+            trace = read_trace(optarg);
+            break;
+        case 't': /* comma separated thread counts */
+            for (char *s = strtok(optarg, ","); s != NULL && num_thread_counts < MAX_THREADS; s = strtok(NULL, ",")) {
+                int n = atoi(s);
+                if (n < 1 || n > MAX_THREADS) {
+                    fprintf(stderr, "thread count must be in 1..%d\n", MAX_THREADS);
+                    exit(1);
+                }
+                thread_counts[num_thread_counts++] = n;
+            }
+            break;
+        case 'n': /* operations per thread of the synthetic workload */
+            ops_per_thread = atol(optarg);
+            break;
+        case 'r': /* percent of the synthetic frees done by another thread */
+            remote_percent = atoi(optarg);
+            break;
+        case 'k': /* times every thread replays the trace */
+            trace_repeat = atoi(optarg);
+            break;
+        case 'l': /* run libc malloc */
+            allocator.malloc = malloc;
+            allocator.free = libc_free;
+            allocator.realloc = realloc;
+            allocator.name = "libc malloc";
+            break;
+        case 'h':
+            usage();
+            exit(0);
+        default:
+            usage();
+            exit(1);
+        }
+    }
+    if (num_thread_counts == 0) {
+        int defaults[] = {1, 2, 4, 8};
+        for (i = 0; i < 4; ++i) thread_counts[num_thread_counts++] = defaults[i];
+    }
+
+    if (trace != NULL)
+        printf("%s, trace of %d ops replayed %d times per thread\n", allocator.name, (int)trace->ops.size(), trace_repeat);
+    else
+        printf("%s, synthetic workload of %ld ops per thread, %d%% remote frees\n", allocator.name, ops_per_thread, remote_percent);
+    printf("%8s %12s %10s %10s %8s %12s %12s %6s\n",
+           "threads", "ops", "secs", "Kops/s", "scaling", "peak live", "peak rss", "frag");
+
+    double base_throughput = 0;
+    for (i = 0; i < num_thread_counts; ++i) {
+        /* a fresh process for every run, so the rss of a run doesn't include the heap of the previous one */
+        int fds[2];
+        if (pipe(fds) < 0) {
+            perror("pipe");
+            exit(1);
+        }
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            result_t r = run(thread_counts[i]);
+            if (write(fds[1], &r, sizeof(r)) != (ssize_t)sizeof(r)) _exit(1);
+            _exit(0);
+        }
+        close(fds[1]);
+        result_t r;
+        int status;
+        ssize_t got = read(fds[0], &r, sizeof(r));
+        close(fds[0]);
+        waitpid(pid, &status, 0);
+        if (got != (ssize_t)sizeof(r) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "run with %d threads failed\n", thread_counts[i]);
+            exit(1);
+        }
+
+        double throughput = r.ops / r.secs;
+        if (base_throughput == 0) base_throughput = throughput / r.threads;
+        printf("%8d %12.0f %10.3f %10.0f %8.2f %10.0fKB %10.0fKB %6.2f\n",
+               r.threads, r.ops, r.secs, throughput / 1e3, throughput / base_throughput,
+               r.peak_live / 1024, r.peak_rss / 1024, r.peak_live > 0 ? r.peak_rss / r.peak_live : 0);
+    }
+    printf("scaling is the throughput over the per thread throughput of the first run\n");
+    return 0;
+}
+
+/*****************************************************************
+ * run - runs the workload on the given thread count and samples
+ * the memory until the workers finish
+ ****************************************************************/
+static result_t run(int threads)
+{
+    result_t r;
+    std::vector<std::thread> workers;
+    std::atomic<int> done(0);
+    long base_rss = read_rss();
+    double peak_rss = 0;
+
+    nthreads = threads;
+    double start = now_secs();
+    for (int i = 0; i < threads; ++i) {
+        workers.push_back(std::thread([i, &done]() {
+            if (trace != NULL) trace_worker(i);
+            else synthetic_worker(i);
+            done.fetch_add(1);
+        }));
+    }
+    while (done.load() < threads) {
+        peak_rss = std::max(peak_rss, (double)(read_rss() - base_rss));
+        usleep(SAMPLE_USECS);
+    }
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+    double secs = now_secs() - start;
+    peak_rss = std::max(peak_rss, (double)(read_rss() - base_rss));
+
+    /* blocks handed over after their receiver exited */
+    for (int i = 0; i < threads; ++i) {
+        for (size_t j = 0; j < states[i].inbox.size(); ++j) allocator.free(states[i].inbox[j]);
+    }
+
+    r.threads = threads;
+    r.ops = trace != NULL ? (double)trace->ops.size() * trace_repeat * threads : (double)ops_per_thread * threads;
+    r.secs = secs;
+    r.peak_live = (double)peak_live.load();
+    r.peak_rss = peak_rss;
+    return r;
+}
+
+/*****************************************************************
+ * publish_live - stores the bytes held by a thread, and records
+ * the total of all the threads when the thread reaches a new high
+ ****************************************************************/
+static void publish_live(thread_state_t *st, long long live, long long *thread_peak)
+{
+    st->live.store(live, std::memory_order_relaxed);
+    if (live < *thread_peak) return;
+    *thread_peak = live;
+
+    long long total = 0;
+    for (int i = 0; i < nthreads; ++i) total += states[i].live.load(std::memory_order_relaxed);
+    long long peak = peak_live.load(std::memory_order_relaxed);
+    while (total > peak && !peak_live.compare_exchange_weak(peak, total, std::memory_order_relaxed));
+}
+
+/* xorshift64, good enough to pick sizes and slots */
+static inline unsigned long long next_random(unsigned long long *state)
+{
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/* writes a byte per page, so the resident set follows what is held */
+static inline void touch(char *p, int size)
+{
+    for (int i = 0; i < size; i += 4096) p[i] = (char)i;
+    if (size > 0) p[size - 1] = 1;
+}
+
+/* 70% up to 128 bytes, 20% up to 1K, 8% up to 16K, 2% up to 256K */
+static inline int random_size(unsigned long long *state)
+{
+    unsigned long long r = next_random(state);
+    int bucket = (int)(r % 100);
+    r >>= 8;
+    if (bucket < 70) return 8 + (int)(r % 121);
+    if (bucket < 90) return 128 + (int)(r % 897);
+    if (bucket < 98) return 1024 + (int)(r % (15 * 1024 + 1));
+    return 16 * 1024 + (int)(r % (240 * 1024 + 1));
+}
+
+/* returns the bytes freed */
+static long long free_inbox(thread_state_t *st)
+{
+    std::vector<void *> blocks;
+    std::vector<int> sizes;
+    {
+        std::lock_guard<std::mutex> guard(st->inbox_lock);
+        blocks.swap(st->inbox);
+        sizes.swap(st->inbox_sizes);
+    }
+    long long bytes = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        allocator.free(blocks[i]);
+        bytes += sizes[i];
+    }
+    return bytes;
+}
+
+static void send_blocks(int to, std::vector<void *> &blocks, std::vector<int> &sizes)
+{
+    thread_state_t *st = &states[to];
+    std::lock_guard<std::mutex> guard(st->inbox_lock);
+    st->inbox.insert(st->inbox.end(), blocks.begin(), blocks.end());
+    st->inbox_sizes.insert(st->inbox_sizes.end(), sizes.begin(), sizes.end());
+    blocks.clear();
+    sizes.clear();
+}
+
+/*****************************************************************
+ * synthetic_worker - allocates into random empty slots and frees
+ * random full slots, a part of the frees goes to the next thread
+ ****************************************************************/
+static void synthetic_worker(int id)
+{
+    thread_state_t *st = &states[id];
+    std::vector<void *> slots(WINDOW_SIZE, (void *)NULL);
+    std::vector<int> slot_sizes(WINDOW_SIZE, 0);
+    std::vector<void *> outbox;
+    std::vector<int> outbox_sizes;
+    unsigned long long rng = 0x9E3779B97F4A7C15ULL * (id + 1);
+    int to = (id + 1) % nthreads;
+    long long live = 0, thread_peak = 0;
+
+    for (long op = 0; op < ops_per_thread; ++op) {
+        int slot = (int)(next_random(&rng) % WINDOW_SIZE);
+        if (slots[slot] == NULL) {
+            int size = random_size(&rng);
+            char *p = (char *)allocator.malloc(size);
+            if (p == NULL) {
+                fprintf(stderr, "out of memory\n");
+                _exit(1);
+            }
+            touch(p, size);
+            slots[slot] = p;
+            slot_sizes[slot] = size;
+            live += size;
+        } else if (nthreads > 1 && (int)(next_random(&rng) % 100) < remote_percent) {
+            /* the receiver accounts for the bytes when it frees them */
+            outbox.push_back(slots[slot]);
+            outbox_sizes.push_back(slot_sizes[slot]);
+            slots[slot] = NULL;
+            if (outbox.size() == HANDOFF_BATCH) send_blocks(to, outbox, outbox_sizes);
+        } else {
+            allocator.free(slots[slot]);
+            slots[slot] = NULL;
+            live -= slot_sizes[slot];
+        }
+        if ((op & 63) == 0) live -= free_inbox(st);
+        publish_live(st, live, &thread_peak);
+    }
+
+    if (!outbox.empty()) send_blocks(to, outbox, outbox_sizes);
+    for (int i = 0; i < WINDOW_SIZE; ++i) {
+        if (slots[i] != NULL) {
+            allocator.free(slots[i]);
+            live -= slot_sizes[i];
+        }
+    }
+    live -= free_inbox(st);
+    st->live.store(live, std::memory_order_relaxed);
+}
+
+/*****************************************************************
+ * trace_worker - replays the trace on blocks of its own
+ ****************************************************************/
+static void trace_worker(int id)
+{
+    thread_state_t *st = &states[id];
+    std::vector<char *> blocks(trace->num_ids, (char *)NULL);
+    std::vector<int> sizes(trace->num_ids, 0);
+    long long live = 0, thread_peak = 0;
+
+    for (int k = 0; k < trace_repeat; ++k) {
+        for (size_t i = 0; i < trace->ops.size(); ++i) {
+            const traceop_t &op = trace->ops[i];
+            char *p;
+            switch (op.type) {
+            case 'a':
+                if ((p = (char *)allocator.malloc(op.size)) == NULL && op.size > 0) {
+                    fprintf(stderr, "out of memory\n");
+                    _exit(1);
+                }
+                touch(p, op.size);
+                blocks[op.index] = p;
+                sizes[op.index] = op.size;
+                live += op.size;
+                break;
+            case 'r':
+                if ((p = (char *)allocator.realloc(blocks[op.index], op.size)) == NULL && op.size > 0) {
+                    fprintf(stderr, "out of memory\n");
+                    _exit(1);
+                }
+                blocks[op.index] = p;
+                live += op.size - sizes[op.index];
+                sizes[op.index] = op.size;
+                break;
+            case 'f':
+                allocator.free(blocks[op.index]);
+                blocks[op.index] = NULL;
+                live -= sizes[op.index];
+                sizes[op.index] = 0;
+                break;
+            }
+            publish_live(st, live, &thread_peak);
+        }
+        /* blocks the trace never frees */
+        for (int i = 0; i < trace->num_ids; ++i) {
+            if (blocks[i] != NULL) {
+                allocator.free(blocks[i]);
+                blocks[i] = NULL;
+                live -= sizes[i];
+                sizes[i] = 0;
+            }
+        }
+    }
+    st->live.store(live, std::memory_order_relaxed);
+}
+
+/*
+ * read_trace - read a trace file in the format of mdriver
+ */
+static trace_t *read_trace(const char *filename)
+{
+    FILE *tracefile;
+    trace_t *trace = new trace_t();
+    int heap_size, num_ops, weight;
+    char type[16];
+    traceop_t op;
+
+    if ((tracefile = fopen(filename, "r")) == NULL) {
+        fprintf(stderr, "Could not open %s in read_trace\n", filename);
+        exit(1);
+    }
+    if (fscanf(tracefile, "%d %d %d %d", &heap_size, &trace->num_ids, &num_ops, &weight) != 4) {
+        fprintf(stderr, "Bad header in %s\n", filename);
+        exit(1);
+    }
+    while (fscanf(tracefile, "%15s", type) == 1) {
+        op.type = type[0];
+        op.size = 0;
+        switch (op.type) {
+        case 'a':
+        case 'r':
+            if (fscanf(tracefile, "%d %d", &op.index, &op.size) != 2) op.type = 0;
+            break;
+        case 'f':
+            if (fscanf(tracefile, "%d", &op.index) != 1) op.type = 0;
+            break;
+        default:
+            op.type = 0;
+            break;
+        }
+        if (op.type == 0 || op.index < 0 || op.index >= trace->num_ids) {
+            fprintf(stderr, "Bad op in %s\n", filename);
+            exit(1);
+        }
+        trace->ops.push_back(op);
+    }
+    fclose(tracefile);
+    return trace;
+}
+
+/* resident set size in bytes */
+static long read_rss(void)
+{
+    long pages = 0, rss = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL) return 0;
+    if (fscanf(f, "%ld %ld", &pages, &rss) != 2) rss = 0;
+    fclose(f);
+    return rss * sysconf(_SC_PAGESIZE);
+}
+
+static double now_secs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mtdriver [-hl] [-f <file>] [-k <n>] [-t <n,n,...>] [-n <ops>] [-r <percent>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-f <file>  Replay <file> in every thread.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-k <n>     Replay the trace <n> times per thread.\n");
+    fprintf(stderr, "\t-l         Run libc malloc instead of tc_malloc.\n");
+    fprintf(stderr, "\t-n <ops>   Operations per thread of the synthetic workload.\n");
+    fprintf(stderr, "\t-r <pct>   Percent of the synthetic frees done by another thread.\n");
+    fprintf(stderr, "\t-t <n,..>  Thread counts to run, 1,2,4,8 by default.\n");
+}
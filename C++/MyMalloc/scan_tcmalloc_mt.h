@@ -0,0 +1,716 @@
+#ifndef SCAN_TCMALLOC_MT_H
+#define SCAN_TCMALLOC_MT_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+/*
+   Thread caching allocator for real threads (it doesn't use memlib, the heap is a range of reserved virtual memory):
+   - every thread owns a ThreadCache of singly linked free lists, one per size class, malloc/free touch no lock;
+   - a free list which grows past its max length gives a batch back to the CentralFreeList of the class, an empty one
+     fetches a batch from it. Full batches are kept as is in a few transfer slots, so a batch freed by a consumer
+     thread goes to a producer thread without walking the objects;
+   - when the central lock is busy, or the thread has no cache any more (it is exiting), freed objects are pushed
+     onto a lock free stack of the central list, which is drained by the next fetch;
+   - the central lists carve objects from spans of the PageHeap, which coalesces free spans and returns the largest
+     ones to the OS with madvise when too many free pages are kept.
+ * */
+
+namespace tcmt {
+
+#ifndef ASSERT
+#define ASSERT assert
+#endif
+
+//////////////////////////////
+static constexpr size_t roundUp(size_t align, size_t n) {
+    return (n + align - 1) / align * align;
+}
+//////////////////////////////
+// malloc has to return memory aligned for any type: 16 bytes on 64 bit (long double, SSE)
+static const int ALIGN_SIZE = sizeof(void*) == 8 ? 16 : 8;
+
+static const int PAGE_SIZE_BITW = 12;
+static const size_t PAGE_SIZE = (size_t)1 << PAGE_SIZE_BITW;
+static const size_t RESERVE_SIZE = sizeof(void*) == 8 ? (size_t)16 << 30 : (size_t)1 << 30;
+static const size_t RESERVE_PAGE_COUNT = RESERVE_SIZE / PAGE_SIZE;
+static constexpr size_t toPageCount(size_t size) {
+    return roundUp(PAGE_SIZE, size) / PAGE_SIZE;
+}
+
+// the spacing of scan_tcmalloc_cpp.h in ALIGN_SIZE units up to 2K, then coarser classes up to 32K
+static const int BLOCK_CLASS_SPACE_0 = ALIGN_SIZE;
+static const int BLOCK_CLASS_SPACE_1 = ALIGN_SIZE * 2;
+static const int BLOCK_CLASS_SPACE_2 = ALIGN_SIZE * 4;
+static const int BLOCK_CLASS_SPACE_3 = ALIGN_SIZE * 32;
+static const int BLOCK_CLASS_SPACE_4 = ALIGN_SIZE * 256;
+static const int BLOCK_CLASS_FENCE_0 = PAGE_SIZE * 2 / 8;
+static const int BLOCK_CLASS_FENCE_1 = PAGE_SIZE * 3 / 8;
+static const int BLOCK_CLASS_FENCE_2 = PAGE_SIZE * 4 / 8;
+static const int BLOCK_CLASS_FENCE_3 = PAGE_SIZE * 2;
+static const int BLOCK_CLASS_FENCE_4 = PAGE_SIZE * 8;
+static const int BLOCK_CLASS_COUNT_0 = BLOCK_CLASS_FENCE_0 / BLOCK_CLASS_SPACE_0;
+static const int BLOCK_CLASS_COUNT_01 = (BLOCK_CLASS_FENCE_1 - BLOCK_CLASS_FENCE_0) / BLOCK_CLASS_SPACE_1 + BLOCK_CLASS_COUNT_0;
+static const int BLOCK_CLASS_COUNT_012 = (BLOCK_CLASS_FENCE_2 - BLOCK_CLASS_FENCE_1) / BLOCK_CLASS_SPACE_2 + BLOCK_CLASS_COUNT_01;
+static const int BLOCK_CLASS_COUNT_0123 = (BLOCK_CLASS_FENCE_3 - BLOCK_CLASS_FENCE_2) / BLOCK_CLASS_SPACE_3 + BLOCK_CLASS_COUNT_012;
+static const int BLOCK_CLASS_COUNT = (BLOCK_CLASS_FENCE_4 - BLOCK_CLASS_FENCE_3) / BLOCK_CLASS_SPACE_4 + BLOCK_CLASS_COUNT_0123;
+static const int MAX_BLOCK_SIZE = BLOCK_CLASS_FENCE_4;
+static const int LARGE_CLASS_IDX = -1;
+
+static const int MAX_SPAN_PAGE_COUNT = 64;
+static const int MAX_BATCH_SIZE = 32;
+static const int BATCH_BYTES = 64 * 1024;
+static const int TRANSFER_SLOT_COUNT = 64;
+static const int MAX_FREE_LIST_LENGTH = 8192;
+static const int MAX_LIST_OVERAGES = 3;
+static const size_t MAX_THREAD_CACHE_SIZE = 4 << 20;
+
+static const int MPAGE_CLASS_COUNT = 256;
+static const size_t MAX_FREE_PAGE_COUNT = (32 << 20) / PAGE_SIZE;
+static const size_t KEEP_FREE_PAGE_COUNT = MAX_FREE_PAGE_COUNT / 2;
+//////////////////////////////
+struct Block {
+    Block *next;
+};
+struct Span {
+    enum State {
+        InUse,
+        Free,
+    };
+    size_t pageIdx;
+    size_t pageCount;
+    int classIdx;
+    int state;
+    bool released;
+    Block *freeList;
+    int allocatedCount;
+    Span *prev, *next;
+};
+class SpanList {
+public:
+    static void init(Span *head) { head->prev = head->next = head; }
+    static bool isEmpty(Span *head) { return head->next == head; }
+    static void insert(Span *head, Span *span) {
+        span->next = head->next;
+        span->prev = head;
+        head->next->prev = span;
+        head->next = span;
+    }
+    static void remove(Span *span) {
+        span->prev->next = span->next;
+        span->next->prev = span->prev;
+        span->prev = span->next = NULL;
+    }
+};
+//////////////////////////////
+// fixed size objects carved from mmap chunks, the owner does the locking
+template<typename T>
+class MetaArena {
+public:
+    MetaArena(): mFreeList(NULL), mChunk(NULL), mChunkLeft(0) {}
+    T* alloc() {
+        if (mFreeList != NULL) {
+            void *p = mFreeList;
+            mFreeList = mFreeList->next;
+            return (T*)p;
+        }
+        if (mChunkLeft < sizeof(T)) {
+            mChunk = (char*)mmap(NULL, CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mChunk == MAP_FAILED) return NULL;
+            mChunkLeft = CHUNK_SIZE;
+        }
+        T *p = (T*)mChunk;
+        mChunk += roundUp(64, sizeof(T));
+        mChunkLeft -= std::min(mChunkLeft, roundUp(64, sizeof(T)));
+        return p;
+    }
+    void free(T *p) {
+        Block *block = (Block*)p;
+        block->next = mFreeList;
+        mFreeList = block;
+    }
+private:
+    static const size_t CHUNK_SIZE = 256 * 1024;
+    Block *mFreeList;
+    char *mChunk;
+    size_t mChunkLeft;
+};
+//////////////////////////////
+class SizeClassTable {
+public:
+    SizeClassTable() {
+        for (int classIdx = 0; classIdx < BLOCK_CLASS_COUNT; ++classIdx) {
+            int size = classIdx2Size(classIdx);
+            mSizes[classIdx] = size;
+            mBatchSizes[classIdx] = std::max(2, std::min(MAX_BATCH_SIZE, BATCH_BYTES / size));
+
+            // smallest span holding 8 objects with less than 1/8 of tail waste
+            int pageCount = 1;
+            for (; pageCount < MAX_SPAN_PAGE_COUNT; ++pageCount) {
+                size_t bytes = pageCount * PAGE_SIZE;
+                if (bytes / size >= 8 && bytes % size <= bytes / 8) break;
+            }
+            mSpanPageCounts[classIdx] = pageCount;
+        }
+        for (int i = 0, classIdx = 0; i <= MAX_BLOCK_SIZE / ALIGN_SIZE; ++i) {
+            while (mSizes[classIdx] < i * ALIGN_SIZE) ++classIdx;
+            mClassIdxs[i] = (uint8_t)classIdx;
+        }
+    }
+    int size2ClassIdx(size_t size) const {
+        ASSERT(size <= (size_t)MAX_BLOCK_SIZE);
+        int classIdx = mClassIdxs[(size + ALIGN_SIZE - 1) / ALIGN_SIZE];
+        return classIdx;
+    }
+    int getSize(int classIdx) const { return mSizes[classIdx]; }
+    int getBatchSize(int classIdx) const { return mBatchSizes[classIdx]; }
+    int getSpanPageCount(int classIdx) const { return mSpanPageCounts[classIdx]; }
+private:
+    static int classIdx2Size(int classIdx) {
+        if (classIdx < BLOCK_CLASS_COUNT_0) {
+            return (classIdx + 1) * BLOCK_CLASS_SPACE_0;
+        } else if (classIdx < BLOCK_CLASS_COUNT_01) {
+            return (classIdx + 1 - BLOCK_CLASS_COUNT_0) * BLOCK_CLASS_SPACE_1 + BLOCK_CLASS_FENCE_0;
+        } else if (classIdx < BLOCK_CLASS_COUNT_012) {
+            return (classIdx + 1 - BLOCK_CLASS_COUNT_01) * BLOCK_CLASS_SPACE_2 + BLOCK_CLASS_FENCE_1;
+        } else if (classIdx < BLOCK_CLASS_COUNT_0123) {
+            return (classIdx + 1 - BLOCK_CLASS_COUNT_012) * BLOCK_CLASS_SPACE_3 + BLOCK_CLASS_FENCE_2;
+        } else {
+            return (classIdx + 1 - BLOCK_CLASS_COUNT_0123) * BLOCK_CLASS_SPACE_4 + BLOCK_CLASS_FENCE_3;
+        }
+    }
+private:
+    int mSizes[BLOCK_CLASS_COUNT];
+    int mBatchSizes[BLOCK_CLASS_COUNT];
+    int mSpanPageCounts[BLOCK_CLASS_COUNT];
+    uint8_t mClassIdxs[MAX_BLOCK_SIZE / ALIGN_SIZE + 1];
+};
+static_assert(BLOCK_CLASS_COUNT <= 256, "class index must fit in uint8_t");
+//////////////////////////////
+struct TCMallocStats {
+    size_t heapBytes; // pages ever taken from the reserved range
+    size_t releasedBytes; // free pages given back with madvise
+    size_t pageHeapFreeBytes; // free pages still backed by memory
+    size_t releaseCount;
+};
+//////////////////////////////
+// all methods except getSpan expect getLock() to be held
+class PageHeap {
+public:
+    PageHeap(): mBase(NULL), mPageMap(NULL), mTopPageIdx(0), mFreePageCount(0), mReleasedPageCount(0), mReleaseCount(0) {
+        for (int i = 0; i < MPAGE_CLASS_COUNT; ++i) {
+            SpanList::init(&mFreeLists[0][i]);
+            SpanList::init(&mFreeLists[1][i]);
+        }
+        mBase = (char*)mmap(NULL, RESERVE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        mPageMap = (Span**)mmap(NULL, RESERVE_PAGE_COUNT * sizeof(Span*), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        ASSERT(mBase != MAP_FAILED && mPageMap != MAP_FAILED);
+    }
+    std::mutex& getLock() { return mLock; }
+    // the span of an allocated pointer, safe without the lock because the entries of a live span don't change,
+    // pages which were never used map to NULL
+    Span* getSpan(const void *ptr) const {
+        size_t pageIdx = ((const char*)ptr - mBase) >> PAGE_SIZE_BITW;
+        return pageIdx < RESERVE_PAGE_COUNT ? mPageMap[pageIdx] : NULL;
+    }
+    char* getPagePtr(size_t pageIdx) const { return mBase + (pageIdx << PAGE_SIZE_BITW); }
+
+    Span* allocSpan(size_t pageCount) {
+        // backed spans first, released ones cost page faults
+        Span *span = NULL;
+        for (int i = pageCount2ClassIdx(pageCount); i < MPAGE_CLASS_COUNT - 1 && span == NULL; ++i) {
+            if (!SpanList::isEmpty(&mFreeLists[0][i])) span = mFreeLists[0][i].next;
+            else if (!SpanList::isEmpty(&mFreeLists[1][i])) span = mFreeLists[1][i].next;
+        }
+        if (span == NULL && (span = findBestFit(&mFreeLists[0][MPAGE_CLASS_COUNT - 1], pageCount)) == NULL) {
+            span = findBestFit(&mFreeLists[1][MPAGE_CLASS_COUNT - 1], pageCount);
+        }
+        if (span == NULL) {
+            if ((span = createSpan(pageCount)) == NULL) return NULL;
+        } else {
+            unlink(span);
+        }
+
+        if (span->pageCount > pageCount) {
+            Span *rest = mSpanArena.alloc();
+            if (rest == NULL) {
+                link(span);
+                return NULL;
+            }
+            rest->pageIdx = span->pageIdx + pageCount;
+            rest->pageCount = span->pageCount - pageCount;
+            rest->released = span->released;
+            span->pageCount = pageCount;
+            setBoundary(span);
+            link(rest);
+        }
+        // released pages come back zero filled on the first touch
+        span->released = false;
+        span->state = Span::InUse;
+        span->classIdx = LARGE_CLASS_IDX;
+        span->freeList = NULL;
+        span->allocatedCount = 0;
+        return span;
+    }
+    void freeSpan(Span *span) {
+        ASSERT(span->state == Span::InUse);
+        span->released = false;
+        mergeAndLink(span);
+        if (mFreePageCount > MAX_FREE_PAGE_COUNT) releaseFreePages(KEEP_FREE_PAGE_COUNT);
+    }
+    // every page of a small object span maps to it
+    void registerSpan(Span *span) {
+        for (size_t i = 0; i < span->pageCount; ++i) mPageMap[span->pageIdx + i] = span;
+    }
+    // give back the largest free spans until only keepPageCount free pages are backed by memory
+    void releaseFreePages(size_t keepPageCount) {
+        for (int i = MPAGE_CLASS_COUNT - 1; i >= 0 && mFreePageCount > keepPageCount; --i) {
+            Span *head = &mFreeLists[0][i];
+            while (!SpanList::isEmpty(head) && mFreePageCount > keepPageCount) {
+                Span *span = head->next;
+                unlink(span);
+                madvise(getPagePtr(span->pageIdx), span->pageCount * PAGE_SIZE, MADV_DONTNEED);
+                ++mReleaseCount;
+                span->released = true;
+                mergeAndLink(span);
+            }
+        }
+    }
+    void getStats(TCMallocStats *stats) const {
+        stats->heapBytes = mTopPageIdx * PAGE_SIZE;
+        stats->releasedBytes = mReleasedPageCount * PAGE_SIZE;
+        stats->pageHeapFreeBytes = mFreePageCount * PAGE_SIZE;
+        stats->releaseCount = mReleaseCount;
+    }
+private:
+    static int pageCount2ClassIdx(size_t pageCount) {
+        if (pageCount >= (size_t)MPAGE_CLASS_COUNT) return MPAGE_CLASS_COUNT - 1;
+        return (int)pageCount - 1;
+    }
+    static Span* findBestFit(Span *head, size_t pageCount) {
+        Span *span = NULL;
+        for (Span *s = head->next; s != head; s = s->next) {
+            if (s->pageCount >= pageCount && (span == NULL || s->pageCount < span->pageCount)) span = s;
+        }
+        return span;
+    }
+    Span* createSpan(size_t pageCount) {
+        if (mTopPageIdx + pageCount > RESERVE_PAGE_COUNT) return NULL;
+        Span *span = mSpanArena.alloc();
+        if (span == NULL) return NULL;
+        span->pageIdx = mTopPageIdx;
+        span->pageCount = pageCount;
+        span->released = false;
+        mTopPageIdx += pageCount;
+        setBoundary(span);
+        return span;
+    }
+    void setBoundary(Span *span) {
+        mPageMap[span->pageIdx] = span;
+        mPageMap[span->pageIdx + span->pageCount - 1] = span;
+    }
+    Span* getFreeNeighbour(size_t pageIdx, bool released) {
+        if (pageIdx >= mTopPageIdx) return NULL;
+        Span *span = mPageMap[pageIdx];
+        // only spans in the same state are merged, so the released page count stays exact
+        return span != NULL && span->state == Span::Free && span->released == released ? span : NULL;
+    }
+    void mergeAndLink(Span *span) {
+        if (span->pageIdx > 0) {
+            if (Span *prev = getFreeNeighbour(span->pageIdx - 1, span->released)) {
+                unlink(prev);
+                span->pageIdx = prev->pageIdx;
+                span->pageCount += prev->pageCount;
+                mSpanArena.free(prev);
+            }
+        }
+        if (Span *next = getFreeNeighbour(span->pageIdx + span->pageCount, span->released)) {
+            unlink(next);
+            span->pageCount += next->pageCount;
+            mSpanArena.free(next);
+        }
+        link(span);
+    }
+    void link(Span *span) {
+        span->state = Span::Free;
+        setBoundary(span);
+        SpanList::insert(&mFreeLists[span->released][pageCount2ClassIdx(span->pageCount)], span);
+        if (span->released) mReleasedPageCount += span->pageCount;
+        else mFreePageCount += span->pageCount;
+    }
+    void unlink(Span *span) {
+        SpanList::remove(span);
+        if (span->released) mReleasedPageCount -= span->pageCount;
+        else mFreePageCount -= span->pageCount;
+    }
+private:
+    std::mutex mLock;
+    char *mBase;
+    Span **mPageMap;
+    size_t mTopPageIdx;
+    size_t mFreePageCount;
+    size_t mReleasedPageCount;
+    size_t mReleaseCount;
+    Span mFreeLists[2][MPAGE_CLASS_COUNT]; // backed and released spans
+    MetaArena<Span> mSpanArena;
+};
+//////////////////////////////
+static SizeClassTable *g_sizeClassTable;
+static PageHeap *g_pageHeap;
+static class CentralFreeList *g_centralFreeLists;
+//////////////////////////////
+class alignas(64) CentralFreeList {
+public:
+    void init(int classIdx) {
+        mClassIdx = classIdx;
+        mTransferCount = 0;
+        mRemoteFrees.store(NULL, std::memory_order_relaxed);
+        SpanList::init(&mNonEmptySpans);
+    }
+    // fetches up to n objects as a NULL terminated list, returns the count
+    int removeRange(Block **head, int n) {
+        std::lock_guard<std::mutex> guard(mLock);
+        if (n == g_sizeClassTable->getBatchSize(mClassIdx) && mTransferCount > 0) {
+            *head = mTransferSlots[--mTransferCount];
+            return n;
+        }
+
+        releaseToSpans(mRemoteFrees.exchange(NULL, std::memory_order_acquire));
+
+        Block *list = NULL;
+        int count = 0;
+        while (count < n) {
+            if (SpanList::isEmpty(&mNonEmptySpans) && !populate()) break;
+            Span *span = mNonEmptySpans.next;
+            for (; count < n && span->freeList != NULL; ++count) {
+                Block *block = span->freeList;
+                span->freeList = block->next;
+                block->next = list;
+                list = block;
+                ++span->allocatedCount;
+            }
+            if (span->freeList == NULL) SpanList::remove(span);
+        }
+        *head = list;
+        return count;
+    }
+    // takes back the n objects from head to tail
+    void insertRange(Block *head, Block *tail, int n) {
+        if (!mLock.try_lock()) {
+            pushRemote(head, tail);
+            return;
+        }
+        if (n == g_sizeClassTable->getBatchSize(mClassIdx) && mTransferCount < TRANSFER_SLOT_COUNT) {
+            tail->next = NULL;
+            mTransferSlots[mTransferCount++] = head;
+        } else {
+            tail->next = NULL;
+            releaseToSpans(head);
+        }
+        mLock.unlock();
+    }
+    // lock free path for frees which can't wait for the lock, drained by the next removeRange
+    void pushRemote(Block *head, Block *tail) {
+        Block *old = mRemoteFrees.load(std::memory_order_relaxed);
+        do {
+            tail->next = old;
+        } while (!mRemoteFrees.compare_exchange_weak(old, head, std::memory_order_release, std::memory_order_relaxed));
+    }
+    void drainRemote() {
+        std::lock_guard<std::mutex> guard(mLock);
+        releaseToSpans(mRemoteFrees.exchange(NULL, std::memory_order_acquire));
+    }
+    // hands the transfer slots back to the spans, so empty spans can go back to the page heap
+    void flushTransferSlots() {
+        std::lock_guard<std::mutex> guard(mLock);
+        releaseToSpans(mRemoteFrees.exchange(NULL, std::memory_order_acquire));
+        while (mTransferCount > 0) releaseToSpans(mTransferSlots[--mTransferCount]);
+    }
+private:
+    bool populate() {
+        Span *span;
+        {
+            std::lock_guard<std::mutex> guard(g_pageHeap->getLock());
+            span = g_pageHeap->allocSpan(g_sizeClassTable->getSpanPageCount(mClassIdx));
+            if (span == NULL) return false;
+            span->classIdx = mClassIdx;
+            g_pageHeap->registerSpan(span);
+        }
+
+        int size = g_sizeClassTable->getSize(mClassIdx);
+        char *ptr = g_pageHeap->getPagePtr(span->pageIdx);
+        size_t bytes = span->pageCount * PAGE_SIZE;
+        Block **tail = &span->freeList;
+        for (size_t off = 0; off + size <= bytes; off += size) {
+            Block *block = (Block*)(ptr + off);
+            *tail = block;
+            tail = &block->next;
+        }
+        *tail = NULL;
+        SpanList::insert(&mNonEmptySpans, span);
+        return true;
+    }
+    void releaseToSpans(Block *list) {
+        while (list != NULL) {
+            Block *block = list;
+            list = list->next;
+
+            Span *span = g_pageHeap->getSpan(block);
+            ASSERT(span != NULL && span->classIdx == mClassIdx);
+            if (span->freeList == NULL) SpanList::insert(&mNonEmptySpans, span);
+            block->next = span->freeList;
+            span->freeList = block;
+            if (--span->allocatedCount == 0) {
+                SpanList::remove(span);
+                std::lock_guard<std::mutex> guard(g_pageHeap->getLock());
+                g_pageHeap->freeSpan(span);
+            }
+        }
+    }
+private:
+    std::mutex mLock;
+    int mClassIdx;
+    int mTransferCount;
+    Block* mTransferSlots[TRANSFER_SLOT_COUNT];
+    Span mNonEmptySpans;
+    std::atomic<Block*> mRemoteFrees;
+};
+//////////////////////////////
+class ThreadCache {
+public:
+    ThreadCache(): mSize(0) {
+        for (int i = 0; i < BLOCK_CLASS_COUNT; ++i) {
+            mFreeLists[i].head = NULL;
+            mFreeLists[i].length = 0;
+            mFreeLists[i].maxLength = 1;
+            mFreeLists[i].overages = 0;
+        }
+    }
+    void* allocMem(int classIdx) {
+        FreeList &freeList = mFreeLists[classIdx];
+        Block *block = freeList.head;
+        if (block == NULL) return fetchFromCentral(classIdx);
+        freeList.head = block->next;
+        --freeList.length;
+        mSize -= g_sizeClassTable->getSize(classIdx);
+        return block;
+    }
+    void freeMem(void *ptr, int classIdx) {
+        FreeList &freeList = mFreeLists[classIdx];
+        Block *block = (Block*)ptr;
+        block->next = freeList.head;
+        freeList.head = block;
+        mSize += g_sizeClassTable->getSize(classIdx);
+        if (++freeList.length > freeList.maxLength) {
+            listTooLong(classIdx);
+        } else if (mSize > MAX_THREAD_CACHE_SIZE) {
+            scavenge();
+        }
+    }
+    void flush() {
+        for (int classIdx = 0; classIdx < BLOCK_CLASS_COUNT; ++classIdx) {
+            while (mFreeLists[classIdx].length > 0) {
+                releaseToCentral(classIdx, std::min(mFreeLists[classIdx].length, g_sizeClassTable->getBatchSize(classIdx)));
+            }
+        }
+    }
+private:
+    // slow start: the max length grows by one per fetch up to a batch, then by a batch per fetch
+    void* fetchFromCentral(int classIdx) {
+        FreeList &freeList = mFreeLists[classIdx];
+        int batchSize = g_sizeClassTable->getBatchSize(classIdx);
+        int count = g_centralFreeLists[classIdx].removeRange(&freeList.head, std::min(freeList.maxLength, batchSize));
+        if (count == 0) return NULL;
+
+        if (freeList.maxLength < batchSize) {
+            ++freeList.maxLength;
+        } else {
+            freeList.maxLength = std::min(freeList.maxLength + batchSize, MAX_FREE_LIST_LENGTH - MAX_FREE_LIST_LENGTH % batchSize);
+        }
+
+        Block *block = freeList.head;
+        freeList.head = block->next;
+        freeList.length = count - 1;
+        mSize += (size_t)(count - 1) * g_sizeClassTable->getSize(classIdx);
+        return block;
+    }
+    void listTooLong(int classIdx) {
+        FreeList &freeList = mFreeLists[classIdx];
+        int batchSize = g_sizeClassTable->getBatchSize(classIdx);
+        releaseToCentral(classIdx, std::min(freeList.length, batchSize));
+
+        if (freeList.maxLength < batchSize) {
+            ++freeList.maxLength;
+        } else if (++freeList.overages > MAX_LIST_OVERAGES) {
+            freeList.maxLength = std::max(batchSize, freeList.maxLength - batchSize);
+            freeList.overages = 0;
+        }
+    }
+    void releaseToCentral(int classIdx, int n) {
+        FreeList &freeList = mFreeLists[classIdx];
+        ASSERT(n > 0 && n <= freeList.length);
+        Block *head = freeList.head, *tail = head;
+        for (int i = 1; i < n; ++i) tail = tail->next;
+        freeList.head = tail->next;
+        freeList.length -= n;
+        mSize -= (size_t)n * g_sizeClassTable->getSize(classIdx);
+        g_centralFreeLists[classIdx].insertRange(head, tail, n);
+    }
+    // the cache is over its byte budget, give back half of every list
+    void scavenge() {
+        for (int classIdx = 0; classIdx < BLOCK_CLASS_COUNT; ++classIdx) {
+            FreeList &freeList = mFreeLists[classIdx];
+            int n = (freeList.length + 1) / 2;
+            int batchSize = g_sizeClassTable->getBatchSize(classIdx);
+            while (n > 0) {
+                int count = std::min(n, batchSize);
+                releaseToCentral(classIdx, count);
+                n -= count;
+            }
+            freeList.maxLength = std::max(1, std::min(freeList.maxLength, std::max(freeList.length, batchSize)));
+        }
+    }
+private:
+    struct FreeList {
+        Block *head;
+        int length;
+        int maxLength;
+        int overages;
+    };
+    FreeList mFreeLists[BLOCK_CLASS_COUNT];
+    size_t mSize;
+};
+//////////////////////////////
+static std::once_flag g_initFlag;
+static MetaArena<ThreadCache> g_threadCacheArena;
+static thread_local ThreadCache *t_threadCache;
+static thread_local bool t_threadCacheDestroyed;
+
+static inline void initGlobals() {
+    static SizeClassTable sizeClassTable;
+    alignas(PageHeap) static char pageHeapBuf[sizeof(PageHeap)];
+    alignas(CentralFreeList) static char centralFreeListsBuf[sizeof(CentralFreeList) * BLOCK_CLASS_COUNT];
+
+    g_sizeClassTable = &sizeClassTable;
+    g_pageHeap = new (pageHeapBuf) PageHeap();
+    g_centralFreeLists = (CentralFreeList*)centralFreeListsBuf;
+    for (int i = 0; i < BLOCK_CLASS_COUNT; ++i) {
+        new (&g_centralFreeLists[i]) CentralFreeList();
+        g_centralFreeLists[i].init(i);
+    }
+}
+
+struct ThreadCacheDestroyer {
+    ~ThreadCacheDestroyer() {
+        ThreadCache *cache = t_threadCache;
+        if (cache == NULL) return;
+        t_threadCache = NULL;
+        t_threadCacheDestroyed = true;
+
+        cache->flush();
+        cache->~ThreadCache();
+        std::lock_guard<std::mutex> guard(g_pageHeap->getLock());
+        g_threadCacheArena.free(cache);
+    }
+    bool registered;
+};
+static thread_local ThreadCacheDestroyer t_threadCacheDestroyer;
+
+// NULL once the thread is exiting, the frees then take the remote path
+static inline ThreadCache* getThreadCache() {
+    ThreadCache *cache = t_threadCache;
+    if (cache != NULL || t_threadCacheDestroyed) return cache;
+
+    std::call_once(g_initFlag, initGlobals);
+    {
+        std::lock_guard<std::mutex> guard(g_pageHeap->getLock());
+        void *p = g_threadCacheArena.alloc();
+        if (p == NULL) return NULL;
+        cache = new (p) ThreadCache();
+    }
+    t_threadCache = cache;
+    t_threadCacheDestroyer.registered = true;
+    return cache;
+}
+//////////////////////////////
+static inline void* allocLarge(size_t size) {
+    std::lock_guard<std::mutex> guard(g_pageHeap->getLock());
+    Span *span = g_pageHeap->allocSpan(toPageCount(size));
+    return span == NULL ? NULL : g_pageHeap->getPagePtr(span->pageIdx);
+}
+
+static inline void* tc_malloc(size_t size) {
+    ThreadCache *cache = getThreadCache();
+    if (size > (size_t)MAX_BLOCK_SIZE) return allocLarge(size);
+
+    int classIdx = g_sizeClassTable->size2ClassIdx(size == 0 ? 1 : size);
+    if (cache != NULL) return cache->allocMem(classIdx);
+
+    Block *block;
+    return g_centralFreeLists[classIdx].removeRange(&block, 1) == 1 ? block : NULL;
+}
+
+static inline void tc_free(void *ptr) {
+    if (ptr == NULL) return;
+
+    Span *span = g_pageHeap->getSpan(ptr);
+    ASSERT(span != NULL && span->state == Span::InUse);
+    if (span->classIdx == LARGE_CLASS_IDX) {
+        std::lock_guard<std::mutex> guard(g_pageHeap->getLock());
+        g_pageHeap->freeSpan(span);
+    } else if (ThreadCache *cache = getThreadCache()) {
+        cache->freeMem(ptr, span->classIdx);
+    } else {
+        g_centralFreeLists[span->classIdx].pushRemote((Block*)ptr, (Block*)ptr);
+    }
+}
+
+static inline size_t tc_getAllocatedSize(void *ptr) {
+    Span *span = g_pageHeap->getSpan(ptr);
+    if (span->classIdx == LARGE_CLASS_IDX) return span->pageCount * PAGE_SIZE;
+    return g_sizeClassTable->getSize(span->classIdx);
+}
+
+static inline void* tc_realloc(void *ptr, size_t size) {
+    if (ptr == NULL) return tc_malloc(size);
+    if (size == 0) {
+        tc_free(ptr);
+        return NULL;
+    }
+
+    // shrinking keeps the block unless it would waste more than half of it
+    size_t oldSize = tc_getAllocatedSize(ptr);
+    if (size <= oldSize && size >= oldSize / 2) return ptr;
+
+    void *newPtr = tc_malloc(size);
+    if (newPtr == NULL) return NULL;
+    memcpy(newPtr, ptr, std::min(oldSize, size));
+    tc_free(ptr);
+    return newPtr;
+}
+
+// returns cached memory of the calling thread and of the central lists, then gives every free page back to the OS
+static inline void tc_releaseFreeMemory() {
+    if (ThreadCache *cache = getThreadCache()) cache->flush();
+    for (int i = 0; i < BLOCK_CLASS_COUNT; ++i) g_centralFreeLists[i].flushTransferSlots();
+
+    std::lock_guard<std::mutex> guard(g_pageHeap->getLock());
+    g_pageHeap->releaseFreePages(0);
+}
+
+static inline void tc_getStats(TCMallocStats *stats) {
+    std::call_once(g_initFlag, initGlobals);
+    std::lock_guard<std::mutex> guard(g_pageHeap->getLock());
+    g_pageHeap->getStats(stats);
+}
+
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef MONTE_CARLO_H
+#define MONTE_CARLO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <chrono>
+#include <vector>
+
+template<typename ResultT>
+struct MonteCarloReport {
+    ResultT result;
+    uint64_t sampleCount;
+    double seconds;
+
+    double samplesPerSecond() const { return seconds > 0 ? sampleCount / seconds : 0; }
+};
+
+// Runs kernel(random, count) -> ResultT over sampleCount samples split into blocks of blockSize.
+// Block b always draws from RandomT(seed, b) and its partial result goes to slot b; the partials
+// are added in block order after the parallel loop. Which thread ran which block never shows in
+// the result, so it is bit-identical for any threadCount, floating point results included.
+// blockSize is part of the experiment like the seed: changing it changes the result.
+template<typename RandomT, typename ResultT, typename KernelT>
+MonteCarloReport<ResultT> runMonteCarlo(
+    uint64_t sampleCount, uint64_t seed, int threadCount, KernelT kernel,
+    ResultT zero = ResultT(), uint64_t blockSize = 1 << 16) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    int blockCount = int((sampleCount + blockSize - 1) / blockSize);
+    std::vector<ResultT> partials(blockCount, zero);
+
+#pragma omp parallel for num_threads(threadCount) schedule(dynamic)
+    for (int b = 0; b < blockCount; ++b) {
+        uint64_t first = uint64_t(b) * blockSize;
+        uint64_t count = sampleCount - first < blockSize ? sampleCount - first : blockSize;
+        RandomT random(seed, uint64_t(b));
+        partials[b] = kernel(random, count);
+    }
+    (void)threadCount;
+
+    MonteCarloReport<ResultT> report;
+    report.result = zero;
+    for (int b = 0; b < blockCount; ++b) report.result = report.result + partials[b];
+    report.sampleCount = sampleCount;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+#endif
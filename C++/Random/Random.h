@@ -0,0 +1,438 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// Counter based generators (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"):
+// block b of stream s is bijection(counter = {b, s}, key = seed), so any output can be computed
+// directly, streams never overlap and a batch of blocks is just as many independent lanes.
+// Output i of a stream is word i % 4 of block i / 4, whichever path produced it.
+
+// Lanes of uint32_t that the bijections are written against: one for the scalar path,
+// 8 with AVX2 and 16 with AVX-512.
+struct RandomLanesScalar {
+    typedef uint32_t V;
+    enum { kWidth = 1 };
+    static V set1(uint32_t a) { return a; }
+    static V indices(uint32_t start) { return start; }
+    static V add(V a, V b) { return a + b; }
+    static V xor_(V a, V b) { return a ^ b; }
+    static V rotl(V a, int r) { return (a << r) | (a >> (32 - r)); }
+    static V mulhilo(V a, uint32_t m, V &hi) {
+        uint64_t p = uint64_t(a) * m;
+        hi = uint32_t(p >> 32);
+        return uint32_t(p);
+    }
+    // words of kWidth consecutive blocks to out in block order
+    static void storeBlocks(uint32_t *out, const V x[4]) {
+        out[0] = x[0], out[1] = x[1], out[2] = x[2], out[3] = x[3];
+    }
+};
+
+#if defined(__AVX2__)
+struct RandomLanesAVX2 {
+    typedef __m256i V;
+    enum { kWidth = 8 };
+    static V set1(uint32_t a) { return _mm256_set1_epi32(int(a)); }
+    static V indices(uint32_t start) {
+        return _mm256_add_epi32(set1(start), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    }
+    static V add(V a, V b) { return _mm256_add_epi32(a, b); }
+    static V xor_(V a, V b) { return _mm256_xor_si256(a, b); }
+    static V rotl(V a, int r) {
+        return _mm256_or_si256(_mm256_slli_epi32(a, r), _mm256_srli_epi32(a, 32 - r));
+    }
+    // mul_epu32 only multiplies the even lanes, so the odd ones are shifted down for a second one
+    static V mulhilo(V a, uint32_t m, V &hi) {
+        V mm = set1(m);
+        V even = _mm256_mul_epu32(a, mm);
+        V odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), mm);
+        hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+        return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+    }
+    static void storeBlocks(uint32_t *out, const V x[4]) {
+        V t0 = _mm256_unpacklo_epi32(x[0], x[1]), t1 = _mm256_unpackhi_epi32(x[0], x[1]);
+        V t2 = _mm256_unpacklo_epi32(x[2], x[3]), t3 = _mm256_unpackhi_epi32(x[2], x[3]);
+        V u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+        V u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+        _mm256_storeu_si256((V*)out, _mm256_permute2x128_si256(u0, u1, 0x20));
+        _mm256_storeu_si256((V*)(out + 8), _mm256_permute2x128_si256(u2, u3, 0x20));
+        _mm256_storeu_si256((V*)(out + 16), _mm256_permute2x128_si256(u0, u1, 0x31));
+        _mm256_storeu_si256((V*)(out + 24), _mm256_permute2x128_si256(u2, u3, 0x31));
+    }
+};
+#endif
+
+#if defined(__AVX512F__)
+struct RandomLanesAVX512 {
+    typedef __m512i V;
+    enum { kWidth = 16 };
+    static V set1(uint32_t a) { return _mm512_set1_epi32(int(a)); }
+    static V indices(uint32_t start) {
+        return _mm512_add_epi32(set1(start),
+            _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    }
+    static V add(V a, V b) { return _mm512_add_epi32(a, b); }
+    static V xor_(V a, V b) { return _mm512_xor_si512(a, b); }
+    static V rotl(V a, int r) {
+        return _mm512_or_si512(_mm512_slli_epi32(a, unsigned(r)), _mm512_srli_epi32(a, unsigned(32 - r)));
+    }
+    static V mulhilo(V a, uint32_t m, V &hi) {
+        V mm = set1(m);
+        V even = _mm512_mul_epu32(a, mm);
+        V odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), mm);
+        hi = _mm512_mask_blend_epi32(0xaaaa, _mm512_srli_epi64(even, 32), odd);
+        return _mm512_mask_blend_epi32(0xaaaa, even, _mm512_slli_epi64(odd, 32));
+    }
+    // the two halves are 8 blocks each, transposed like the AVX2 lanes
+    static void storeBlocks(uint32_t *out, const V x[4]) {
+        __m256i lo[4], hi[4];
+        for (int i = 0; i < 4; ++i) {
+            lo[i] = _mm512_castsi512_si256(x[i]);
+            hi[i] = _mm512_extracti64x4_epi64(x[i], 1);
+        }
+        RandomLanesAVX2::storeBlocks(out, lo);
+        RandomLanesAVX2::storeBlocks(out + 32, hi);
+    }
+};
+#endif
+
+// Philox4x32-10: 10 rounds of two 32x32->64 multiplies, the key bumped by Weyl constants.
+struct Philox4x32 {
+    enum { kKeyWords = 2 };
+
+    template<typename L>
+    static void blocks(typename L::V x[4], const uint32_t key[kKeyWords]) {
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; ++round) {
+            typename L::V hi0, hi1;
+            typename L::V lo0 = L::mulhilo(x[0], 0xD2511F53, hi0);
+            typename L::V lo1 = L::mulhilo(x[2], 0xCD9E8D57, hi1);
+            x[0] = L::xor_(L::xor_(hi1, x[1]), L::set1(k0));
+            x[1] = lo1;
+            x[2] = L::xor_(L::xor_(hi0, x[3]), L::set1(k1));
+            x[3] = lo0;
+            k0 += 0x9E3779B9, k1 += 0xBB67AE85;
+        }
+    }
+};
+
+// Threefry4x32-20: the Threefish add/rotate/xor mix, with the key injected every 4 rounds.
+struct Threefry4x32 {
+    enum { kKeyWords = 4 };
+
+    template<typename L>
+    static void blocks(typename L::V x[4], const uint32_t key[kKeyWords]) {
+        static const int kRotations[8][2] = {
+            {10, 26}, {11, 21}, {13, 27}, {23, 5}, {6, 20}, {17, 11}, {25, 10}, {18, 20},
+        };
+        uint32_t ks[5] = {key[0], key[1], key[2], key[3], 0x1BD11BDA ^ key[0] ^ key[1] ^ key[2] ^ key[3]};
+
+        for (int i = 0; i < 4; ++i) x[i] = L::add(x[i], L::set1(ks[i]));
+        for (int round = 0; round < 20; ++round) {
+            const int *r = kRotations[round % 8];
+            if (round % 2 == 0) {
+                x[0] = L::add(x[0], x[1]), x[1] = L::xor_(L::rotl(x[1], r[0]), x[0]);
+                x[2] = L::add(x[2], x[3]), x[3] = L::xor_(L::rotl(x[3], r[1]), x[2]);
+            } else {
+                x[0] = L::add(x[0], x[3]), x[3] = L::xor_(L::rotl(x[3], r[0]), x[0]);
+                x[2] = L::add(x[2], x[1]), x[1] = L::xor_(L::rotl(x[1], r[1]), x[2]);
+            }
+            if (round % 4 == 3) {
+                uint32_t s = uint32_t(round / 4 + 1);
+                for (int i = 0; i < 4; ++i) x[i] = L::add(x[i], L::set1(ks[(s + i) % 5]));
+                x[3] = L::add(x[3], L::set1(s));
+            }
+        }
+    }
+};
+
+// Uniform [0, 1) floats from the top 24 bits, doubles from the top 53 bits of two outputs.
+inline float randomToFloat(uint32_t u) {
+    return float(u >> 8) * (1.0f / 16777216.0f);
+}
+inline double randomToDouble(uint32_t lo, uint32_t hi) {
+    return double(((uint64_t(hi) << 32) | lo) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Stream `stream` of the generator keyed by `seed`. The block counter is 64 bits, so a stream
+// has 2^66 outputs; seek() jumps anywhere in it.
+template<typename BijectionT>
+class RandomCounter {
+public:
+    RandomCounter(uint64_t seed, uint64_t stream = 0): mBlock(0), mStream(stream), mUsed(4) {
+        for (int i = 0; i < BijectionT::kKeyWords; ++i) mKey[i] = 0;
+        mKey[0] = uint32_t(seed), mKey[1] = uint32_t(seed >> 32);
+    }
+
+    uint32_t next() {
+        if (mUsed == 4) {
+            generateBlocks<RandomLanesScalar>(mBuffer);
+            mUsed = 0;
+        }
+        return mBuffer[mUsed++];
+    }
+    uint32_t max() const { return 0xffffffff; }
+
+    void seek(uint64_t index) {
+        mBlock = index / 4;
+        mUsed = 4;
+        if (index % 4 != 0) {
+            generateBlocks<RandomLanesScalar>(mBuffer);
+            mUsed = int(index % 4);
+        }
+    }
+
+    // The next n outputs, the same ones n calls to next() would return.
+    void fill(uint32_t *out, size_t n) {
+        for (; n > 0 && mUsed < 4; --n) *out++ = mBuffer[mUsed++];
+#if defined(__AVX512F__)
+        fillBlocks<RandomLanesAVX512>(out, n);
+#endif
+#if defined(__AVX2__)
+        fillBlocks<RandomLanesAVX2>(out, n);
+#endif
+        fillBlocks<RandomLanesScalar>(out, n);
+        for (; n > 0; --n) *out++ = next();
+    }
+
+    void fillUniform(float *out, size_t n) {
+        uint32_t buffer[256];
+        while (n > 0) {
+            size_t count = n < 256 ? n : 256;
+            fill(buffer, count);
+            for (size_t i = 0; i < count; ++i) out[i] = randomToFloat(buffer[i]);
+            out += count, n -= count;
+        }
+    }
+
+    // The bijection itself, for known answer tests.
+    static void block(uint32_t out[4], const uint32_t counter[4], const uint32_t key[BijectionT::kKeyWords]) {
+        uint32_t x[4] = {counter[0], counter[1], counter[2], counter[3]};
+        BijectionT::template blocks<RandomLanesScalar>(x, key);
+        out[0] = x[0], out[1] = x[1], out[2] = x[2], out[3] = x[3];
+    }
+
+private:
+    // L::kWidth consecutive blocks from mBlock on, in lane order
+    template<typename L>
+    void generateBlocks(uint32_t *out) {
+        typename L::V x[4] = {
+            L::indices(uint32_t(mBlock)), L::set1(uint32_t(mBlock >> 32)),
+            L::set1(uint32_t(mStream)), L::set1(uint32_t(mStream >> 32)),
+        };
+        BijectionT::template blocks<L>(x, mKey);
+        L::storeBlocks(out, x);
+        mBlock += L::kWidth;
+    }
+
+    // whole batches only, and not across a carry into the high counter word
+    template<typename L>
+    void fillBlocks(uint32_t *&out, size_t &n) {
+        while (n >= 4 * L::kWidth && uint32_t(mBlock) <= 0xffffffffu - L::kWidth) {
+            generateBlocks<L>(out);
+            out += 4 * L::kWidth, n -= 4 * L::kWidth;
+        }
+    }
+
+private:
+    uint32_t mKey[BijectionT::kKeyWords];
+    uint64_t mBlock;
+    uint64_t mStream;
+    uint32_t mBuffer[4];
+    int mUsed;
+};
+
+typedef RandomCounter<Philox4x32> RandomPhilox;
+typedef RandomCounter<Threefry4x32> RandomThreefry;
+
+// SplitMix64, used to expand a 64 bit seed into xoshiro states.
+inline uint64_t randomSplitMix64(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+inline uint64_t randomRotl64(uint64_t a, int r) {
+    return (a << r) | (a >> (64 - r));
+}
+
+// xoshiro256** (Blackman & Vigna). jump() advances 2^128 outputs and longJump() 2^192, so
+// copies jumped 0, 1, 2... times are non-overlapping per-thread streams. A (seed, stream) pair
+// seeds through SplitMix64 instead, which is cheap for any stream but only overlaps with
+// negligible probability rather than never.
+class RandomXoshiro256 {
+public:
+    RandomXoshiro256(uint64_t seed, uint64_t stream = 0): mLast(0), mHalf(false) {
+        uint64_t state = seed ^ randomSplitMix64(stream);
+        for (int i = 0; i < 4; ++i) mState[i] = randomSplitMix64(state);
+    }
+
+    uint64_t next64() {
+        uint64_t result = randomRotl64(mState[1] * 5, 7) * 9;
+        uint64_t t = mState[1] << 17;
+        mState[2] ^= mState[0];
+        mState[3] ^= mState[1];
+        mState[1] ^= mState[2];
+        mState[0] ^= mState[3];
+        mState[2] ^= t;
+        mState[3] = randomRotl64(mState[3], 45);
+        return result;
+    }
+
+    // the low then the high half of each 64 bit output
+    uint32_t next() {
+        if (mHalf) {
+            mHalf = false;
+            return uint32_t(mLast >> 32);
+        }
+        mLast = next64();
+        mHalf = true;
+        return uint32_t(mLast);
+    }
+    uint32_t max() const { return 0xffffffff; }
+
+    void jump() {
+        static const uint64_t kJump[] = {
+            0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull,
+        };
+        jump(kJump);
+    }
+    void longJump() {
+        static const uint64_t kLongJump[] = {
+            0x76e15d3efefdcbbfull, 0xc5004e441c522fb3ull, 0x77710069854ee241ull, 0x39109bb02acbe635ull,
+        };
+        jump(kLongJump);
+    }
+
+    const uint64_t* state() const { return mState; }
+
+private:
+    void jump(const uint64_t polynomial[4]) {
+        uint64_t s[4] = {0, 0, 0, 0};
+        for (int i = 0; i < 4; ++i) {
+            for (int b = 0; b < 64; ++b) {
+                if (polynomial[i] & (1ull << b)) {
+                    for (int j = 0; j < 4; ++j) s[j] ^= mState[j];
+                }
+                next64();
+            }
+        }
+        for (int j = 0; j < 4; ++j) mState[j] = s[j];
+        // a half of an output from before the jump would leak into the new stream
+        mLast = 0;
+        mHalf = false;
+    }
+
+private:
+    uint64_t mState[4];
+    uint64_t mLast;
+    bool mHalf;
+};
+
+// 8 xoshiro256** lanes, lane i jumped i times from the seeded state, interleaved: output j is
+// lane j % 8's (j / 8)th 64 bit output, as 32 bit halves low first. The lane count is fixed so
+// the scalar, AVX2 (two registers) and AVX-512 (one register) paths give the same sequence.
+class RandomXoshiro256x8 {
+public:
+    enum { kLanes = 8 };
+
+    RandomXoshiro256x8(uint64_t seed, uint64_t stream = 0): mUsed(2 * kLanes) {
+        RandomXoshiro256 lane(seed, stream);
+        for (int i = 0; i < kLanes; ++i) {
+            for (int j = 0; j < 4; ++j) mState[j][i] = lane.state()[j];
+            lane.jump();
+        }
+    }
+
+    uint32_t next() {
+        if (mUsed == 2 * kLanes) {
+            step(mBuffer);
+            mUsed = 0;
+        }
+        return mBuffer[mUsed++];
+    }
+    uint32_t max() const { return 0xffffffff; }
+
+    // The next n outputs, the same ones n calls to next() would return.
+    void fill(uint32_t *out, size_t n) {
+        for (; n > 0 && mUsed < 2 * kLanes; --n) *out++ = mBuffer[mUsed++];
+        for (; n >= 2 * kLanes; n -= 2 * kLanes, out += 2 * kLanes) step(out);
+        for (; n > 0; --n) *out++ = next();
+    }
+
+    void fillUniform(float *out, size_t n) {
+        uint32_t buffer[256];
+        while (n > 0) {
+            size_t count = n < 256 ? n : 256;
+            fill(buffer, count);
+            for (size_t i = 0; i < count; ++i) out[i] = randomToFloat(buffer[i]);
+            out += count, n -= count;
+        }
+    }
+
+private:
+    // one output of every lane, 2 * kLanes words
+    void step(uint32_t *out) {
+#if defined(__AVX512F__)
+        __m512i s[4];
+        for (int j = 0; j < 4; ++j) s[j] = _mm512_loadu_si512(mState[j]);
+        __m512i x5 = _mm512_add_epi64(_mm512_slli_epi64(s[1], 2), s[1]);
+        __m512i r = _mm512_rol_epi64(x5, 7);
+        __m512i result = _mm512_add_epi64(_mm512_slli_epi64(r, 3), r);
+        __m512i t = _mm512_slli_epi64(s[1], 17);
+        s[2] = _mm512_xor_si512(s[2], s[0]);
+        s[3] = _mm512_xor_si512(s[3], s[1]);
+        s[1] = _mm512_xor_si512(s[1], s[2]);
+        s[0] = _mm512_xor_si512(s[0], s[3]);
+        s[2] = _mm512_xor_si512(s[2], t);
+        s[3] = _mm512_rol_epi64(s[3], 45);
+        for (int j = 0; j < 4; ++j) _mm512_storeu_si512(mState[j], s[j]);
+        _mm512_storeu_si512(out, result);
+#elif defined(__AVX2__)
+        // no 64 bit multiply or rotate: x * 5 = (x << 2) + x, x * 9 = (x << 3) + x
+        for (int h = 0; h < kLanes; h += 4) {
+            __m256i s[4];
+            for (int j = 0; j < 4; ++j) s[j] = _mm256_loadu_si256((const __m256i*)(mState[j] + h));
+            __m256i x5 = _mm256_add_epi64(_mm256_slli_epi64(s[1], 2), s[1]);
+            __m256i r = _mm256_or_si256(_mm256_slli_epi64(x5, 7), _mm256_srli_epi64(x5, 57));
+            __m256i result = _mm256_add_epi64(_mm256_slli_epi64(r, 3), r);
+            __m256i t = _mm256_slli_epi64(s[1], 17);
+            s[2] = _mm256_xor_si256(s[2], s[0]);
+            s[3] = _mm256_xor_si256(s[3], s[1]);
+            s[1] = _mm256_xor_si256(s[1], s[2]);
+            s[0] = _mm256_xor_si256(s[0], s[3]);
+            s[2] = _mm256_xor_si256(s[2], t);
+            s[3] = _mm256_or_si256(_mm256_slli_epi64(s[3], 45), _mm256_srli_epi64(s[3], 19));
+            for (int j = 0; j < 4; ++j) _mm256_storeu_si256((__m256i*)(mState[j] + h), s[j]);
+            _mm256_storeu_si256((__m256i*)(out + 2 * h), result);
+        }
+#else
+        for (int i = 0; i < kLanes; ++i) {
+            uint64_t result = randomRotl64(mState[1][i] * 5, 7) * 9;
+            uint64_t t = mState[1][i] << 17;
+            mState[2][i] ^= mState[0][i];
+            mState[3][i] ^= mState[1][i];
+            mState[1][i] ^= mState[2][i];
+            mState[0][i] ^= mState[3][i];
+            mState[2][i] ^= t;
+            mState[3][i] = randomRotl64(mState[3][i], 45);
+            out[2 * i] = uint32_t(result);
+            out[2 * i + 1] = uint32_t(result >> 32);
+        }
+#endif
+    }
+
+private:
+    uint64_t mState[4][kLanes];
+    uint32_t mBuffer[2 * kLanes];
+    int mUsed;
+};
+
+#endif
@@ -1,5 +1,10 @@
 #include "pch.h"
 
+#include <math.h>
+
+#include "Random.h"
+#include "MonteCarlo.h"
+
 class RandomANSIC {
 public:
     RandomANSIC(int seed) { srand(seed); }
@@ -57,6 +62,99 @@ static void testRandom(int seed) {
     }
 }
 
+// Random123's known answer vectors for the counter, key => output of one block.
+static void testKnownAnswers() {
+    struct Answer { uint32_t counter[4], key[4], output[4]; };
+    const uint32_t kOnes = 0xffffffff;
+    const Answer philox[] = {
+        {{0, 0, 0, 0}, {0, 0}, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+        {{kOnes, kOnes, kOnes, kOnes}, {kOnes, kOnes}, {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+        {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0},
+            {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+    };
+    const Answer threefry[] = {
+        {{0, 0, 0, 0}, {0, 0, 0, 0}, {0x9c6ca96a, 0xe17eae66, 0xfc10ecd4, 0x5256a7d8}},
+        {{kOnes, kOnes, kOnes, kOnes}, {kOnes, kOnes, kOnes, kOnes}, {0x2a881696, 0x57012287, 0xf6c7446e, 0xa16a6732}},
+        {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0, 0x082efa98, 0xec4e6c89},
+            {0x59cd1dbb, 0xb8879579, 0x86b5d00c, 0xac8b6d84}},
+    };
+
+    uint32_t out[4];
+    for (const Answer &a : philox) {
+        RandomPhilox::block(out, a.counter, a.key);
+        assert(memcmp(out, a.output, sizeof(out)) == 0);
+    }
+    for (const Answer &a : threefry) {
+        RandomThreefry::block(out, a.counter, a.key);
+        assert(memcmp(out, a.output, sizeof(out)) == 0);
+    }
+}
+
+// fill() in uneven pieces must continue the sequence next() gives, whichever SIMD path it takes.
+template<typename RandomT>
+static void testFill(int seed) {
+    const int N = 5000;
+    RandomT expected(seed, 3), random(seed, 3);
+    vector<uint32_t> a(N), b(N);
+    for (int i = 0; i < N; ++i) a[i] = expected.next();
+
+    int sizes[] = {1, 3, 64, 7, 129, 1000, 31, 2};
+    int pos = 0;
+    for (int i = 0; pos < N; ++i) {
+        int n = min(sizes[i % 8], N - pos);
+        if (i % 3 == 0) b[pos++] = random.next();
+        else random.fill(&b[pos], n), pos += n;
+    }
+    assert(a == b);
+}
+
+static void testSeek(int seed) {
+    RandomPhilox expected(seed, 1);
+    vector<uint32_t> a(1000);
+    expected.fill(&a[0], a.size());
+    for (int i : {0, 1, 5, 127, 999}) {
+        RandomPhilox random(seed, 1);
+        random.seek(i);
+        assert(random.next() == a[i]);
+    }
+}
+
+static uint64_t countInCircle(RandomPhilox &random, uint64_t count) {
+    float xy[512];
+    uint64_t inside = 0;
+    for (uint64_t i = 0; i < count; i += 256) {
+        int n = (int)min<uint64_t>(256, count - i);
+        random.fillUniform(xy, 2 * n);
+        for (int j = 0; j < n; ++j) inside += xy[2 * j] * xy[2 * j] + xy[2 * j + 1] * xy[2 * j + 1] < 1;
+    }
+    return inside;
+}
+
+static double sumQuarterCircle(RandomThreefry &random, uint64_t count) {
+    double sum = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        double x = randomToDouble(random.next(), random.next());
+        sum += sqrt(1 - x * x);
+    }
+    return sum;
+}
+
+// The same seed must give the same bits on 1 thread as on many.
+static void testMonteCarlo(int seed) {
+    const uint64_t N = 1 << 22;
+    auto pi1 = runMonteCarlo<RandomPhilox>(N, seed, 1, countInCircle, uint64_t(0));
+    auto area1 = runMonteCarlo<RandomThreefry>(N, seed, 1, sumQuarterCircle, 0.0, 1000);
+    for (int threads : {2, 3, 8}) {
+        auto pi = runMonteCarlo<RandomPhilox>(N, seed, threads, countInCircle, uint64_t(0));
+        auto area = runMonteCarlo<RandomThreefry>(N, seed, threads, sumQuarterCircle, 0.0, 1000);
+        assert(pi.result == pi1.result);
+        assert(memcmp(&area.result, &area1.result, sizeof(double)) == 0);
+    }
+    assert(fabs(pi1.result * 4.0 / N - acos(-1.0)) < 0.01);
+    assert(fabs(area1.result * 4.0 / N - acos(-1.0)) < 0.01);
+    printf("pi: %.8f, %.4g samples/s\n", pi1.result * 4.0 / N, pi1.samplesPerSecond());
+}
+
 #define TEST(type, seed) puts("test: " #type); testRandom<type>(seed);
 
 int main() {
@@ -65,4 +163,18 @@ int main() {
     TEST(RandomANSIC, seed);
     TEST(RandomVC, seed);
     TEST(RandomGCC, seed);
+    TEST(RandomPhilox, seed);
+    TEST(RandomThreefry, seed);
+    TEST(RandomXoshiro256, seed);
+    TEST(RandomXoshiro256x8, seed);
+
+    puts("test: known answers");
+    testKnownAnswers();
+    puts("test: fill");
+    testFill<RandomPhilox>(seed);
+    testFill<RandomThreefry>(seed);
+    testFill<RandomXoshiro256x8>(seed);
+    testSeek(seed);
+    puts("test: monte carlo");
+    testMonteCarlo(seed);
 }
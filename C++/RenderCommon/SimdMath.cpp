@@ -0,0 +1,136 @@
+// vim: fileencoding=gbk
+#include "pch.h"
+
+#include <cmath>
+
+#include "SimdMath.h"
+#include "Geometry.h"
+
+// ÿԪչ4ݣSoA任ʱֱӳ
+struct SplatMat
+{
+    __m128 m[4][4];
+
+    explicit SplatMat(const Matrix4x4& mat)
+    {
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) m[i][j] = _mm_set1_ps(mat[i][j]);
+        }
+    }
+    // jк(x, y, z, w)ĵwΪ10ʱʡ˷
+    __m128 dot3(int j, const Vec3x4& v) const
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(v.x, m[0][j]), _mm_mul_ps(v.y, m[1][j])), _mm_mul_ps(v.z, m[2][j]));
+    }
+    __m128 dotPoint(int j, const Vec3x4& v) const { return _mm_add_ps(dot3(j, v), m[3][j]); }
+};
+
+void transformPoints(const Vector3* src, Vector3* dst, int n, const Matrix4x4& mat)
+{
+    SplatMat sm(mat);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        Vec3x4 v, r;
+        v.load(src + i);
+        r.x = sm.dotPoint(0, v);
+        r.y = sm.dotPoint(1, v);
+        r.z = sm.dotPoint(2, v);
+        r.store(dst + i);
+    }
+    for (; i < n; ++i) {
+        Vector4 v4(src[i], 1);
+        transform(v4, mat);
+        dst[i] = Vector3(v4.x, v4.y, v4.z);
+    }
+}
+void transformPoints(const Vector3* src, Vector4* dst, int n, const Matrix4x4& mat)
+{
+    SplatMat sm(mat);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        Vec3x4 v;
+        v.load(src + i);
+        __m128 x = sm.dotPoint(0, v), y = sm.dotPoint(1, v);
+        __m128 z = sm.dotPoint(2, v), w = sm.dotPoint(3, v);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(dst[i].data(), x);
+        _mm_storeu_ps(dst[i + 1].data(), y);
+        _mm_storeu_ps(dst[i + 2].data(), z);
+        _mm_storeu_ps(dst[i + 3].data(), w);
+    }
+    for (; i < n; ++i) {
+        dst[i] = Vector4(src[i], 1);
+        transform(dst[i], mat);
+    }
+}
+void transformPoints(const Vector4* src, Vector4* dst, int n, const Matrix4x4& mat)
+{
+    // AoSֱVec4һһ㣬4
+    Mat4 m(mat);
+    for (int i = 0; i < n; ++i) {
+        transform(Vec4(src[i]), m).store(dst[i]);
+    }
+}
+void transformNormals(const Vector3* src, Vector3* dst, int n, const Matrix4x4& mat)
+{
+    SplatMat sm(mat);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        Vec3x4 v, r;
+        v.load(src + i);
+        r.x = sm.dot3(0, v);
+        r.y = sm.dot3(1, v);
+        r.z = sm.dot3(2, v);
+        // Vector3::operator /=һٳˣλһ
+        __m128 invLen = _mm_div_ps(_mm_set1_ps(1), _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+                            _mm_mul_ps(r.x, r.x), _mm_mul_ps(r.y, r.y)), _mm_mul_ps(r.z, r.z))));
+        r.x = _mm_mul_ps(r.x, invLen);
+        r.y = _mm_mul_ps(r.y, invLen);
+        r.z = _mm_mul_ps(r.z, invLen);
+        r.store(dst + i);
+    }
+    for (; i < n; ++i) {
+        Vector4 v4(src[i], 0);
+        transform(v4, mat);
+        Vector3 d(v4.x, v4.y, v4.z);
+        dst[i] = d / d.length();
+    }
+}
+
+void frustumCullAABBs(const AABB* aabbs, int n, const Plane* planes, int planeCnt, char* culled)
+{
+    // 8ƽһ߷Ǹȡminȡmaxȫ
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const AABB *a = aabbs + i;
+        __m128 minX = _mm_set_ps(a[3].minPt.x, a[2].minPt.x, a[1].minPt.x, a[0].minPt.x);
+        __m128 minY = _mm_set_ps(a[3].minPt.y, a[2].minPt.y, a[1].minPt.y, a[0].minPt.y);
+        __m128 minZ = _mm_set_ps(a[3].minPt.z, a[2].minPt.z, a[1].minPt.z, a[0].minPt.z);
+        __m128 maxX = _mm_set_ps(a[3].maxPt.x, a[2].maxPt.x, a[1].maxPt.x, a[0].maxPt.x);
+        __m128 maxY = _mm_set_ps(a[3].maxPt.y, a[2].maxPt.y, a[1].maxPt.y, a[0].maxPt.y);
+        __m128 maxZ = _mm_set_ps(a[3].maxPt.z, a[2].maxPt.z, a[1].maxPt.z, a[0].maxPt.z);
+        __m128 out = _mm_setzero_ps();
+        for (int j = 0; j < planeCnt; ++j) {
+            const Vector3 &norm = planes[j].normal;
+            __m128 dis = _mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(norm.x >= 0 ? minX : maxX, _mm_set1_ps(norm.x)),
+                        _mm_mul_ps(norm.y >= 0 ? minY : maxY, _mm_set1_ps(norm.y))),
+                    _mm_mul_ps(norm.z >= 0 ? minZ : maxZ, _mm_set1_ps(norm.z)));
+            out = _mm_or_ps(out, _mm_cmpge_ps(dis, _mm_set1_ps(planes[j].d)));
+        }
+        int mask = _mm_movemask_ps(out);
+        for (int k = 0; k < 4; ++k) culled[i + k] = (char)(mask >> k & 1);
+    }
+    for (; i < n; ++i) {
+        const AABB &a = aabbs[i];
+        culled[i] = 0;
+        for (int j = 0; j < planeCnt && !culled[i]; ++j) {
+            const Plane &p = planes[j];
+            Vector3 pt(
+                    p.normal.x >= 0 ? a.minPt.x : a.maxPt.x,
+                    p.normal.y >= 0 ? a.minPt.y : a.maxPt.y,
+                    p.normal.z >= 0 ? a.minPt.z : a.maxPt.z);
+            culled[i] = distance(p, pt) >= 0;
+        }
+    }
+}
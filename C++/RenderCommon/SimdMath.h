@@ -0,0 +1,97 @@
+// vim: fileencoding=gbk
+
+#ifndef SIMDMATH_H
+#define SIMDMATH_H
+
+#include <xmmintrin.h>
+
+// Ⱦ͹׷ٹãVector.hȡԹ
+#include "Vector.h"
+#include "Matrix.h"
+
+struct Plane;
+struct AABB;
+
+//----------------------------------------
+// SSEVector4Matrix4x4һ˾
+//----------------------------------------
+struct Vec4
+{
+    __m128 v;
+
+    Vec4(){}
+    explicit Vec4(__m128 _v): v(_v){}
+    explicit Vec4(const Vector4& o): v(_mm_loadu_ps(o.data())){}
+    Vec4(const Vector3& o, float w): v(_mm_set_ps(w, o.z, o.y, o.x)){}
+
+    void store(Vector4& o) const { _mm_storeu_ps(o.data(), v); }
+};
+inline Vec4 operator + (const Vec4& a, const Vec4& b) { return Vec4(_mm_add_ps(a.v, b.v)); }
+inline Vec4 operator - (const Vec4& a, const Vec4& b) { return Vec4(_mm_sub_ps(a.v, b.v)); }
+inline Vec4 operator * (const Vec4& a, float f) { return Vec4(_mm_mul_ps(a.v, _mm_set1_ps(f))); }
+
+struct Mat4
+{
+    __m128 rows[4];
+
+    explicit Mat4(const Matrix4x4& m)
+    {
+        for (int i = 0; i < 4; ++i) rows[i] = _mm_loadu_ps(m[i]);
+    }
+};
+inline Vec4 transform(const Vec4& v, const Mat4& m)
+{
+    __m128 r = _mm_mul_ps(_mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(0, 0, 0, 0)), m.rows[0]);
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(1, 1, 1, 1)), m.rows[1]));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(2, 2, 2, 2)), m.rows[2]));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(3, 3, 3, 3)), m.rows[3]));
+    return Vec4(r);
+}
+
+//----------------------------------------
+// SoA4Vector3xyzһĴ
+// ԭ8һAVXֻSSE24
+//----------------------------------------
+struct Vec3x4
+{
+    __m128 x, y, z;
+
+    // д4Vector3м3x4ת
+    void load(const Vector3* vs)
+    {
+        const float *p = vs[0].data();
+        __m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+        __m128 t0 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2)); // x2 y2 x3 y3
+        __m128 t1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1)); // y0 z0 y1 z1
+        x = _mm_shuffle_ps(a, t0, _MM_SHUFFLE(2, 0, 3, 0));
+        y = _mm_shuffle_ps(t1, t0, _MM_SHUFFLE(3, 1, 2, 0));
+        z = _mm_shuffle_ps(t1, c, _MM_SHUFFLE(3, 0, 3, 1));
+    }
+    void store(Vector3* vs) const
+    {
+        float *p = vs[0].data();
+        __m128 xy01 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 0, 1, 0));
+        __m128 zx01 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0));
+        _mm_storeu_ps(p, _mm_shuffle_ps(xy01, zx01, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128 yz1 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 xy2 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2));
+        _mm_storeu_ps(p + 4, _mm_shuffle_ps(yz1, xy2, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128 zx23 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2));
+        __m128 yz3 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3));
+        _mm_storeu_ps(p + 8, _mm_shuffle_ps(zx23, yz3, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+};
+
+//----------------------------------------
+// ӿڣ4һSSEµİtransformһ(ڸ)
+//----------------------------------------
+// w1dstԺsrcͬ
+void transformPoints(const Vector3* src, Vector3* dst, int n, const Matrix4x4& mat);
+void transformPoints(const Vector3* src, Vector4* dst, int n, const Matrix4x4& mat);
+void transformPoints(const Vector4* src, Vector4* dst, int n, const Matrix4x4& mat);
+// w0任淶transformDirectionһdstԺsrcͬ
+void transformNormals(const Vector3* src, Vector3* dst, int n, const Matrix4x4& mat);
+// AABB8㶼ĳ()ʱculled[i]Ϊ1Ϊ0intersect(PlaneList, aabb.getCorners())һ
+void frustumCullAABBs(const AABB* aabbs, int n, const Plane* planes, int planeCnt, char* culled);
+
+#endif // #ifndef SIMDMATH_H
@@ -0,0 +1,320 @@
+// vim: fileencoding=gbk
+
+#ifndef TEXTUREFIXED_H
+#define TEXTUREFIXED_H
+
+#include <cassert>
+
+#include <algorithm>
+
+#include <emmintrin.h>
+
+// Ⱦ͹׷ٵSamplerãTexture.hȡԹ
+#include "RenderStateEnums.h"
+#include "Texture.h"
+#include "Util.h"
+#include "Vector.h"
+
+//----------------------------------------
+// غȨض8λһص4ͨһSSE2Ĵ416λ
+//----------------------------------------
+template<E_TextureAddressingMode mode>
+inline int addressTexel(int a, int r)
+{
+    bool power2 = (r & (r - 1)) == 0;
+    switch (mode) {
+        case ETAM_clamp:
+            return a < 0 ? 0 : (a >= r ? r - 1 : a);
+        case ETAM_repeat:
+            if (power2) return a & (r - 1);
+            a %= r;
+            return a < 0 ? a + r : a;
+        case ETAM_mirror:
+            {
+                int period = r * 2;
+                a = power2 ? a & (period - 1) : a % period;
+                if (a < 0) a += period;
+                return a < r ? a : period - 1 - a;
+            }
+        default:
+            assert(0);
+            return 0;
+    }
+}
+static inline int floorInt(float f)
+{
+    int i = (int)f;
+    return f < i ? i - 1 : i;
+}
+
+// uvǱꣻPointFilterMethodһȡڵ
+template<E_TextureAddressingMode uMode, E_TextureAddressingMode vMode>
+__m128i pointFixed(const Texture::SwizzledLevel& tex, float u, float v)
+{
+    int x = addressTexel<uMode>(floorInt(u), tex.w);
+    int y = addressTexel<vMode>(floorInt(v), tex.h);
+    unsigned int texel = tex.data[swizzledTexelIndex(x, y, tex.tileCntX)];
+    return _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)texel), _mm_setzero_si128());
+}
+// BilinearFilterMethodһ
+template<E_TextureAddressingMode uMode, E_TextureAddressingMode vMode>
+__m128i bilinearFixed(const Texture::SwizzledLevel& tex, float u, float v)
+{
+    int fu = floorInt(u * 256), fv = floorInt(v * 256);
+    int fx = fu & 255, fy = fv & 255;
+    int x0 = addressTexel<uMode>(fu >> 8, tex.w), x1 = addressTexel<uMode>((fu >> 8) + 1, tex.w);
+    int y0 = addressTexel<vMode>(fv >> 8, tex.h), y1 = addressTexel<vMode>((fv >> 8) + 1, tex.h);
+    const unsigned int *data = tex.data;
+    int tileCntX = tex.tileCntX;
+    __m128i texels = _mm_set_epi32(
+            (int)data[swizzledTexelIndex(x1, y1, tileCntX)], (int)data[swizzledTexelIndex(x0, y1, tileCntX)],
+            (int)data[swizzledTexelIndex(x1, y0, tileCntX)], (int)data[swizzledTexelIndex(x0, y0, tileCntX)]);
+
+    // ȨغΪ256˻Ͳ255*25616λ
+    short w00 = (short)((256 - fx) * (256 - fy) >> 8), w01 = (short)(fx * (256 - fy) >> 8);
+    short w10 = (short)((256 - fx) * fy >> 8), w11 = 256 - w00 - w01 - w10;
+    __m128i zero = _mm_setzero_si128();
+    __m128i top = _mm_mullo_epi16(_mm_unpacklo_epi8(texels, zero),
+            _mm_set_epi16(w01, w01, w01, w01, w00, w00, w00, w00));
+    __m128i bottom = _mm_mullo_epi16(_mm_unpackhi_epi8(texels, zero),
+            _mm_set_epi16(w11, w11, w11, w11, w10, w10, w10, w10));
+    __m128i sum = _mm_add_epi16(top, bottom);
+    sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+    return _mm_srli_epi16(sum, 8);
+}
+
+// 4һصַr2ݣǯλҪ
+template<E_TextureAddressingMode mode>
+inline __m128i addressTexel4(__m128i a, int r)
+{
+    __m128i rMinus1 = _mm_set1_epi32(r - 1);
+    switch (mode) {
+        case ETAM_clamp:
+            {
+                __m128i over = _mm_cmpgt_epi32(a, rMinus1);
+                a = _mm_or_si128(_mm_andnot_si128(over, a), _mm_and_si128(over, rMinus1));
+                return _mm_andnot_si128(_mm_cmplt_epi32(a, _mm_setzero_si128()), a);
+            }
+        case ETAM_repeat:
+            return _mm_and_si128(a, rMinus1);
+        case ETAM_mirror:
+            {
+                __m128i periodMinus1 = _mm_set1_epi32(r * 2 - 1);
+                a = _mm_and_si128(a, periodMinus1);
+                __m128i over = _mm_cmpgt_epi32(a, rMinus1);
+                return _mm_or_si128(_mm_andnot_si128(over, a), _mm_and_si128(over, _mm_sub_epi32(periodMinus1, a)));
+            }
+        default:
+            assert(0);
+            return a;
+    }
+}
+inline __m128 floor4(__m128 f)
+{
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(f));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, f), _mm_set1_ps(1)));
+}
+// swizzledTexelIndexֻuйءֻvйص֣4һ㣬Ӿ±
+inline __m128i spreadBits3(__m128i a)
+{
+    return _mm_or_si128(_mm_or_si128(_mm_and_si128(a, _mm_set1_epi32(1)),
+                _mm_slli_epi32(_mm_and_si128(a, _mm_set1_epi32(2)), 1)),
+            _mm_slli_epi32(_mm_and_si128(a, _mm_set1_epi32(4)), 2));
+}
+inline __m128i swizzledColumnIndex4(__m128i u)
+{
+    return _mm_add_epi32(_mm_slli_epi32(_mm_srai_epi32(u, 3), 6), spreadBits3(u));
+}
+inline __m128i swizzledRowIndex4(__m128i v, int tileCntX)
+{
+    // кųÿпSSE2û32λ˷ڸˣ2^24Ǿȷ
+    __m128i tileRow = _mm_cvttps_epi32(_mm_mul_ps(
+                _mm_cvtepi32_ps(_mm_srai_epi32(v, 3)), _mm_set1_ps((float)tileCntX)));
+    return _mm_add_epi32(_mm_slli_epi32(tileRow, 6), _mm_slli_epi32(spreadBits3(v), 1));
+}
+// ±λȡڴ棬дٱĴ洢תʧ
+inline __m128i gatherTexels4(const unsigned int *data, __m128i indices)
+{
+    int i0 = _mm_cvtsi128_si32(indices);
+    int i1 = _mm_cvtsi128_si32(_mm_srli_si128(indices, 4));
+    int i2 = _mm_cvtsi128_si32(_mm_srli_si128(indices, 8));
+    int i3 = _mm_cvtsi128_si32(_mm_srli_si128(indices, 12));
+    return _mm_unpacklo_epi64(
+            _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)data[i0]), _mm_cvtsi32_si128((int)data[i1])),
+            _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)data[i2]), _mm_cvtsi32_si128((int)data[i3])));
+}
+// ÿһ32λȨչ16λlo014hi234
+inline void expandWeights4(__m128i w, __m128i &lo, __m128i &hi)
+{
+    __m128i w16 = _mm_packs_epi32(w, w);
+    w16 = _mm_unpacklo_epi16(w16, w16);
+    lo = _mm_unpacklo_epi32(w16, w16);
+    hi = _mm_unpackhi_epi32(w16, w16);
+}
+
+// 4һĵ˫ԣlo01hi23ÿ416λͨ
+template<E_TextureAddressingMode uMode, E_TextureAddressingMode vMode>
+void pointFixed4(const Texture::SwizzledLevel& tex, const __m128& u, const __m128& v, __m128i& lo, __m128i& hi)
+{
+    __m128i x = addressTexel4<uMode>(_mm_cvttps_epi32(floor4(u)), tex.w);
+    __m128i y = addressTexel4<vMode>(_mm_cvttps_epi32(floor4(v)), tex.h);
+    __m128i texels = gatherTexels4(tex.data,
+            _mm_add_epi32(swizzledColumnIndex4(x), swizzledRowIndex4(y, tex.tileCntX)));
+    lo = _mm_unpacklo_epi8(texels, _mm_setzero_si128());
+    hi = _mm_unpackhi_epi8(texels, _mm_setzero_si128());
+}
+template<E_TextureAddressingMode uMode, E_TextureAddressingMode vMode>
+void bilinearFixed4(const Texture::SwizzledLevel& tex, const __m128& u, const __m128& v, __m128i& lo, __m128i& hi)
+{
+    __m128 floorU = floor4(u), floorV = floor4(v);
+    __m128 fx = _mm_sub_ps(u, floorU), fy = _mm_sub_ps(v, floorV);
+    __m128i iu = _mm_cvttps_epi32(floorU), iv = _mm_cvttps_epi32(floorV);
+    __m128i one = _mm_set1_epi32(1);
+    __m128i x0 = addressTexel4<uMode>(iu, tex.w), x1 = addressTexel4<uMode>(_mm_add_epi32(iu, one), tex.w);
+    __m128i y0 = addressTexel4<vMode>(iv, tex.h), y1 = addressTexel4<vMode>(_mm_add_epi32(iv, one), tex.h);
+
+    // 8λȨأΪ256
+    __m128 scale = _mm_set1_ps(256), oneF = _mm_set1_ps(1);
+    __m128 invFx = _mm_sub_ps(oneF, fx), invFy = _mm_sub_ps(oneF, fy);
+    __m128i w00 = _mm_cvtps_epi32(_mm_mul_ps(_mm_mul_ps(invFx, invFy), scale));
+    __m128i w01 = _mm_cvtps_epi32(_mm_mul_ps(_mm_mul_ps(fx, invFy), scale));
+    __m128i w10 = _mm_cvtps_epi32(_mm_mul_ps(_mm_mul_ps(invFx, fy), scale));
+    __m128i w11 = _mm_sub_epi32(_mm_set1_epi32(256), _mm_add_epi32(_mm_add_epi32(w00, w01), w10));
+
+    __m128i col0 = swizzledColumnIndex4(x0), col1 = swizzledColumnIndex4(x1);
+    __m128i row0 = swizzledRowIndex4(y0, tex.tileCntX), row1 = swizzledRowIndex4(y1, tex.tileCntX);
+    const __m128i indices[4] = {
+        _mm_add_epi32(col0, row0), _mm_add_epi32(col1, row0),
+        _mm_add_epi32(col0, row1), _mm_add_epi32(col1, row1),
+    };
+    const __m128i ws[4] = {w00, w01, w10, w11};
+    __m128i zero = _mm_setzero_si128();
+    lo = hi = zero;
+    for (int i = 0; i < 4; ++i) {
+        __m128i texels = gatherTexels4(tex.data, indices[i]);
+        __m128i wLo, wHi;
+        expandWeights4(ws[i], wLo, wHi);
+        // ˻Ͳ255*25616λ޷Ź
+        lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(texels, zero), wLo));
+        hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(texels, zero), wHi));
+    }
+    lo = _mm_srli_epi16(lo, 8);
+    hi = _mm_srli_epi16(hi, 8);
+}
+
+typedef __m128i (*FixedFilterFunc)(const Texture::SwizzledLevel& tex, float u, float v);
+typedef void (*FixedFilter4Func)(const Texture::SwizzledLevel& tex, const __m128& u, const __m128& v, __m128i& lo, __m128i& hi);
+// [uѰַʽ][vѰַʽ]
+static const FixedFilterFunc g_pointFixedFuncs[3][3] = {
+    {pointFixed<ETAM_clamp, ETAM_clamp>, pointFixed<ETAM_clamp, ETAM_repeat>, pointFixed<ETAM_clamp, ETAM_mirror>},
+    {pointFixed<ETAM_repeat, ETAM_clamp>, pointFixed<ETAM_repeat, ETAM_repeat>, pointFixed<ETAM_repeat, ETAM_mirror>},
+    {pointFixed<ETAM_mirror, ETAM_clamp>, pointFixed<ETAM_mirror, ETAM_repeat>, pointFixed<ETAM_mirror, ETAM_mirror>},
+};
+static const FixedFilterFunc g_bilinearFixedFuncs[3][3] = {
+    {bilinearFixed<ETAM_clamp, ETAM_clamp>, bilinearFixed<ETAM_clamp, ETAM_repeat>, bilinearFixed<ETAM_clamp, ETAM_mirror>},
+    {bilinearFixed<ETAM_repeat, ETAM_clamp>, bilinearFixed<ETAM_repeat, ETAM_repeat>, bilinearFixed<ETAM_repeat, ETAM_mirror>},
+    {bilinearFixed<ETAM_mirror, ETAM_clamp>, bilinearFixed<ETAM_mirror, ETAM_repeat>, bilinearFixed<ETAM_mirror, ETAM_mirror>},
+};
+static const FixedFilter4Func g_pointFixed4Funcs[3][3] = {
+    {pointFixed4<ETAM_clamp, ETAM_clamp>, pointFixed4<ETAM_clamp, ETAM_repeat>, pointFixed4<ETAM_clamp, ETAM_mirror>},
+    {pointFixed4<ETAM_repeat, ETAM_clamp>, pointFixed4<ETAM_repeat, ETAM_repeat>, pointFixed4<ETAM_repeat, ETAM_mirror>},
+    {pointFixed4<ETAM_mirror, ETAM_clamp>, pointFixed4<ETAM_mirror, ETAM_repeat>, pointFixed4<ETAM_mirror, ETAM_mirror>},
+};
+static const FixedFilter4Func g_bilinearFixed4Funcs[3][3] = {
+    {bilinearFixed4<ETAM_clamp, ETAM_clamp>, bilinearFixed4<ETAM_clamp, ETAM_repeat>, bilinearFixed4<ETAM_clamp, ETAM_mirror>},
+    {bilinearFixed4<ETAM_repeat, ETAM_clamp>, bilinearFixed4<ETAM_repeat, ETAM_repeat>, bilinearFixed4<ETAM_repeat, ETAM_mirror>},
+    {bilinearFixed4<ETAM_mirror, ETAM_clamp>, bilinearFixed4<ETAM_mirror, ETAM_repeat>, bilinearFixed4<ETAM_mirror, ETAM_mirror>},
+};
+
+// 1/2^levelֱƴָÿ2x2ضҪ㣬ó
+static inline float levelScale(int level)
+{
+    union { float f; int i; } bits;
+    bits.i = (127 - level) << 23;
+    return bits.f;
+}
+// һLODҪɵļ͹˺2x2عһ
+struct FixedSamplePlan
+{
+    FixedFilterFunc filter;
+    FixedFilter4Func filter4; // 2ҪظʱΪNULLֻز
+    int levelCnt;
+    const Texture::SwizzledLevel *levels[2];
+    float scales[2], offsets[2]; // 0scaleoffsetõ
+    short weight1; // ʱڶȨأ0~256
+};
+inline void planFixedSample(
+        const Texture *tex, E_TextureFilterType minFilterType, E_TextureFilterType magFilterType,
+        E_TextureAddressingMode uMode, E_TextureAddressingMode vMode,
+        float lod, FixedSamplePlan& plan)
+{
+    int maxLevel = tex->maxMipmapLevel();
+    E_TextureFilterType filterType = lod <= 0 ? magFilterType : minFilterType;
+    int level = lod <= 0 ? 0 : std::min((int)lod, maxLevel);
+    bool point = filterType == ETFT_point || filterType == ETFT_mipmapDbg;
+    plan.filter = point ? g_pointFixedFuncs[uMode][vMode] : g_bilinearFixedFuncs[uMode][vMode];
+    plan.filter4 = point ? g_pointFixed4Funcs[uMode][vMode] : g_bilinearFixed4Funcs[uMode][vMode];
+    if ((uMode != ETAM_clamp && !isPower2(tex->width(0))) || (vMode != ETAM_clamp && !isPower2(tex->height(0)))) {
+        plan.filter4 = NULL;
+    }
+    // ԣlodСֻ
+    bool trilinear = !point && filterType != ETFT_bilinear && lod > 0 && level < maxLevel;
+    plan.levelCnt = trilinear ? 2 : 1;
+    plan.weight1 = trilinear ? (short)((lod - level) * 256) : 0;
+    for (int i = 0; i < plan.levelCnt; ++i) {
+        plan.levels[i] = &tex->swizzledLevel(level + i);
+        plan.scales[i] = levelScale(level + i);
+        // ˫ԵϣͷֱʵļҪ뵽0
+        plan.offsets[i] = point ? 0 : plan.scales[i] * 0.5f - 0.5f;
+    }
+}
+static inline __m128i blendLevels(__m128i clr0, __m128i clr1, short weight1)
+{
+    return _mm_srli_epi16(_mm_add_epi16(
+                _mm_mullo_epi16(clr0, _mm_set1_epi16(256 - weight1)),
+                _mm_mullo_epi16(clr1, _mm_set1_epi16(weight1))), 8);
+}
+static inline __m128i sampleFixed(const FixedSamplePlan& plan, float u, float v)
+{
+    __m128i clr = plan.filter(*plan.levels[0],
+            u * plan.scales[0] + plan.offsets[0], v * plan.scales[0] + plan.offsets[0]);
+    if (plan.levelCnt == 1) return clr;
+    __m128i clr1 = plan.filter(*plan.levels[1],
+            u * plan.scales[1] + plan.offsets[1], v * plan.scales[1] + plan.offsets[1]);
+    return blendLevels(clr, clr1, plan.weight1);
+}
+static inline void sampleFixed4(const FixedSamplePlan& plan, const __m128& u, const __m128& v, __m128i& lo, __m128i& hi)
+{
+    __m128 scale = _mm_set1_ps(plan.scales[0]), offset = _mm_set1_ps(plan.offsets[0]);
+    plan.filter4(*plan.levels[0],
+            _mm_add_ps(_mm_mul_ps(u, scale), offset), _mm_add_ps(_mm_mul_ps(v, scale), offset), lo, hi);
+    if (plan.levelCnt == 1) return;
+    scale = _mm_set1_ps(plan.scales[1]), offset = _mm_set1_ps(plan.offsets[1]);
+    __m128i lo1, hi1;
+    plan.filter4(*plan.levels[1],
+            _mm_add_ps(_mm_mul_ps(u, scale), offset), _mm_add_ps(_mm_mul_ps(v, scale), offset), lo1, hi1);
+    lo = blendLevels(lo, lo1, plan.weight1);
+    hi = blendLevels(hi, hi1, plan.weight1);
+}
+
+static inline void fixed2Color4(__m128i lo, __m128i hi, Vector3* clrs)
+{
+    // ÿ4ͨתɸ㣬Aͨǰ棬
+    float fs[16];
+    __m128 inv255 = _mm_set1_ps(1 / 255.f);
+    __m128i zero = _mm_setzero_si128();
+    _mm_storeu_ps(fs, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), inv255));
+    _mm_storeu_ps(fs + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), inv255));
+    _mm_storeu_ps(fs + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), inv255));
+    _mm_storeu_ps(fs + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), inv255));
+    for (int i = 0; i < 4; ++i) clrs[i] = Vector3(fs + i * 4 + 1);
+}
+static inline Vector3 fixed2Color(__m128i clr)
+{
+    __m128 f = _mm_cvtepi32_ps(_mm_unpacklo_epi16(clr, _mm_setzero_si128()));
+    float fs[4];
+    _mm_storeu_ps(fs, _mm_mul_ps(f, _mm_set1_ps(1 / 255.f)));
+    return Vector3(fs + 1);
+}
+
+#endif // #ifndef TEXTUREFIXED_H
@@ -0,0 +1,211 @@
+// vim: fileencoding=gbk
+#include "pch.h"
+
+// GdiplusͼƬдLinuxȷWindowsƽ̨BMPPPM(P6)дPPMPNG
+#ifndef _WIN32
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static int readLE(const unsigned char *p, int n)
+{
+    int r = 0;
+    for (int i = n - 1; i >= 0; --i) r = (r << 8) | p[i];
+    return r;
+}
+static bool endsWith(const char *s, const char *ext)
+{
+    int n = (int)strlen(s), m = (int)strlen(ext);
+    if (n < m) return false;
+    for (int i = 0; i < m; ++i) {
+        if (tolower(s[n - m + i]) != ext[i]) return false;
+    }
+    return true;
+}
+
+// δѹ24/32λBMP
+static char* loadBMP(FILE *f, void*(*fmalloc)(int), int &w, int &h)
+{
+    unsigned char header[54];
+    if (fread(header, 1, 54, f) != 54 || header[0] != 'B' || header[1] != 'M') return NULL;
+    int offset = readLE(header + 10, 4);
+    w = readLE(header + 18, 4);
+    h = readLE(header + 22, 4);
+    int bpp = readLE(header + 28, 2);
+    int compression = readLE(header + 30, 4);
+    if ((bpp != 24 && bpp != 32) || (compression != 0 && compression != 3) || w <= 0) return NULL;
+    bool bottomUp = h > 0;
+    if (h < 0) h = -h;
+
+    int srcPitch = (w * (bpp / 8) + 3) & ~3;
+    std::vector<unsigned char> line(srcPitch);
+    char *buf = (char*)fmalloc(w * h * 4);
+    fseek(f, offset, SEEK_SET);
+    for (int y = 0; y < h; ++y) {
+        if (fread(&line[0], 1, srcPitch, f) != (size_t)srcPitch) break;
+        unsigned char *dest = (unsigned char*)buf + (bottomUp ? h - 1 - y : y) * w * 4;
+        for (int x = 0; x < w; ++x) {
+            const unsigned char *src = &line[x * (bpp / 8)];
+            dest[0] = src[0], dest[1] = src[1], dest[2] = src[2];
+            dest[3] = bpp == 32 ? src[3] : 255;
+            dest += 4;
+        }
+    }
+    return buf;
+}
+static bool readPPMInt(FILE *f, int &val)
+{
+    int c = fgetc(f);
+    for (;;) {
+        while (c != EOF && isspace(c)) c = fgetc(f);
+        if (c != '#') break;
+        while (c != EOF && c != '\n') c = fgetc(f);
+    }
+    if (c == EOF || !isdigit(c)) return false;
+    val = 0;
+    for (; c != EOF && isdigit(c); c = fgetc(f)) val = val * 10 + (c - '0');
+    return true;
+}
+static char* loadPPM(FILE *f, void*(*fmalloc)(int), int &w, int &h)
+{
+    int maxVal;
+    if (fgetc(f) != 'P' || fgetc(f) != '6') return NULL;
+    if (!readPPMInt(f, w) || !readPPMInt(f, h) || !readPPMInt(f, maxVal) || maxVal != 255) return NULL;
+    std::vector<unsigned char> line(w * 3);
+    char *buf = (char*)fmalloc(w * h * 4);
+    unsigned char *dest = (unsigned char*)buf;
+    for (int y = 0; y < h; ++y) {
+        if (fread(&line[0], 1, w * 3, f) != (size_t)w * 3) break;
+        for (int x = 0; x < w; ++x) {
+            dest[0] = line[x * 3 + 2], dest[1] = line[x * 3 + 1], dest[2] = line[x * 3];
+            dest[3] = 255;
+            dest += 4;
+        }
+    }
+    return buf;
+}
+
+// GdiplusһÿBGRAֽڵͼļͷжϸʽչ
+char* loadImage(const char *fname, void*(*fmalloc)(int), int &w, int &h)
+{
+    FILE *f = fopen(fname, "rb");
+    if (f == NULL) return NULL;
+    char magic[2] = {0, 0};
+    fread(magic, 1, 2, f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = NULL;
+    if (magic[0] == 'B' && magic[1] == 'M') buf = loadBMP(f, fmalloc, w, h);
+    else if (magic[0] == 'P' && magic[1] == '6') buf = loadPPM(f, fmalloc, w, h);
+    else cout << "unsupported image format (bmp, ppm only): " << fname << endl;
+    fclose(f);
+    return buf;
+}
+
+static void savePPM(FILE *f, const char *buf, int w, int h, int pitch)
+{
+    fprintf(f, "P6\n%d %d\n255\n", w, h);
+    std::vector<unsigned char> line(w * 3);
+    for (int y = 0; y < h; ++y) {
+        const unsigned char *src = (const unsigned char*)buf + y * pitch;
+        for (int x = 0; x < w; ++x) {
+            line[x * 3] = src[x * 4 + 2], line[x * 3 + 1] = src[x * 4 + 1], line[x * 3 + 2] = src[x * 4];
+        }
+        fwrite(&line[0], 1, w * 3, f);
+    }
+}
+
+static unsigned int crc32(unsigned int crc, const unsigned char *p, int n)
+{
+    static unsigned int s_table[256];
+    if (s_table[1] == 0) {
+        for (unsigned int i = 0; i < 256; ++i) {
+            unsigned int c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            s_table[i] = c;
+        }
+    }
+    crc = ~crc;
+    for (int i = 0; i < n; ++i) crc = s_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+static void pushBE(std::vector<unsigned char>& v, unsigned int i)
+{
+    v.push_back((unsigned char)(i >> 24));
+    v.push_back((unsigned char)(i >> 16));
+    v.push_back((unsigned char)(i >> 8));
+    v.push_back((unsigned char)i);
+}
+static void writePNGChunk(FILE *f, const char *type, const std::vector<unsigned char>& data)
+{
+    std::vector<unsigned char> chunk;
+    pushBE(chunk, (unsigned int)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    pushBE(chunk, crc32(0, &chunk[4], (int)chunk.size() - 4));
+    fwrite(&chunk[0], 1, chunk.size(), f);
+}
+// ѹPNGzlibֻstored飬ʡdeflateʵ
+static void savePNG(FILE *f, const char *buf, int w, int h, int pitch)
+{
+    static const unsigned char s_signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    fwrite(s_signature, 1, 8, f);
+
+    std::vector<unsigned char> ihdr;
+    pushBE(ihdr, w);
+    pushBE(ihdr, h);
+    unsigned char ihdrTail[5] = {8, 2, 0, 0, 0}; // 8λRGB
+    ihdr.insert(ihdr.end(), ihdrTail, ihdrTail + 5);
+    writePNGChunk(f, "IHDR", ihdr);
+
+    std::vector<unsigned char> raw;
+    raw.reserve((w * 3 + 1) * h);
+    for (int y = 0; y < h; ++y) {
+        const unsigned char *src = (const unsigned char*)buf + y * pitch;
+        raw.push_back(0); // 
+        for (int x = 0; x < w; ++x) {
+            raw.push_back(src[x * 4 + 2]);
+            raw.push_back(src[x * 4 + 1]);
+            raw.push_back(src[x * 4]);
+        }
+    }
+
+    std::vector<unsigned char> idat;
+    idat.push_back(0x78), idat.push_back(0x01);
+    int n = (int)raw.size();
+    for (int i = 0; i < n || i == 0; i += 65535) {
+        int len = std::min(65535, n - i);
+        idat.push_back(i + len >= n ? 1 : 0);
+        idat.push_back((unsigned char)len), idat.push_back((unsigned char)(len >> 8));
+        idat.push_back((unsigned char)~len), idat.push_back((unsigned char)(~len >> 8));
+        idat.insert(idat.end(), raw.begin() + i, raw.begin() + i + len);
+    }
+    unsigned int a = 1, b = 0;
+    for (int i = 0; i < n; ++i) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    pushBE(idat, (b << 16) | a);
+    writePNGChunk(f, "IDAT", idat);
+    writePNGChunk(f, "IEND", std::vector<unsigned char>());
+}
+
+// չд.ppm.pngеļȾÿ鶼дͬһļ
+bool saveImage(const char *fname, const char *buf, int w, int h, int pitch)
+{
+    bool ppm = endsWith(fname, ".ppm");
+    if (!ppm && !endsWith(fname, ".png")) return false;
+    FILE *f = fopen(fname, "wb");
+    if (f == NULL) return false;
+    if (ppm) savePPM(f, buf, w, h, pitch);
+    else savePNG(f, buf, w, h, pitch);
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+#endif // #ifndef _WIN32
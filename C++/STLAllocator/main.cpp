@@ -3,10 +3,18 @@
 #include <forward_list>
 #include <unordered_set>
 #include <set>
+#include <map>
+#include <tuple>
+#include <utility>
 #include <memory>
 #include <fstream>
 #include <chrono>
 #include <functional>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
 
 #include <unistd.h>
 
@@ -189,6 +197,394 @@ public:
     }
 };
 //////////////////////////////
+// Stateful memory resources behind one allocator type, so the memory of a container can be chosen per instance,
+// and the containers nested inside it get the same resource.
+class MemoryResource {
+public:
+    static const size_t MAX_ALIGN = alignof(max_align_t);
+
+    virtual ~MemoryResource() {}
+    void* allocate(size_t size, size_t align = MAX_ALIGN) { return doAllocate(size, align); }
+    void deallocate(void *p, size_t size, size_t align = MAX_ALIGN) { doDeallocate(p, size, align); }
+    bool isEqual(const MemoryResource& o) const { return this == &o || doIsEqual(o); }
+protected:
+    virtual void* doAllocate(size_t size, size_t align) = 0;
+    virtual void doDeallocate(void *p, size_t size, size_t align) = 0;
+    virtual bool doIsEqual(const MemoryResource&) const { return false; }
+};
+
+class MallocResource: public MemoryResource {
+public:
+    static MallocResource* instance() {
+        static MallocResource s_ins;
+        return &s_ins;
+    }
+protected:
+    virtual void* doAllocate(size_t size, size_t align) {
+        void *p = nullptr;
+        if (align <= MAX_ALIGN) p = ::malloc(size);
+        else if (posix_memalign(&p, align, size) != 0) p = nullptr;
+        if (p == nullptr) throw bad_alloc();
+        return p;
+    }
+    virtual void doDeallocate(void *p, size_t, size_t) {
+        ::free(p);
+    }
+    virtual bool doIsEqual(const MemoryResource& o) const {
+        return dynamic_cast<const MallocResource*>(&o) != nullptr;
+    }
+};
+
+static MemoryResource* getDefaultResource() {
+    return MallocResource::instance();
+}
+
+static char* alignUp(char *p, size_t align) {
+    return (char*)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+// Bump allocation from geometrically growing chunks, deallocate does nothing: release() or the destructor
+// drops everything at once, in a time depending on the chunk count only.
+class MonotonicBufferResource: public MemoryResource {
+public:
+    explicit MonotonicBufferResource(size_t initialSize = PAGE_SIZE, MemoryResource *upstream = getDefaultResource()):
+        mUpstream(upstream), mChunks(nullptr), mBuffer(nullptr), mBufferSize(0),
+        mInitialSize(max(initialSize, (size_t)64)) {
+        release();
+    }
+    // allocates from buffer first, a stack array for example
+    MonotonicBufferResource(void *buffer, size_t size, MemoryResource *upstream = getDefaultResource()):
+        mUpstream(upstream), mChunks(nullptr), mBuffer((char*)buffer), mBufferSize(size),
+        mInitialSize(max(size * 2, (size_t)64)) {
+        release();
+    }
+    ~MonotonicBufferResource() { release(); }
+
+    void release() {
+        while (mChunks != nullptr) {
+            Chunk *next = mChunks->next;
+            mUpstream->deallocate(mChunks, mChunks->size);
+            mChunks = next;
+        }
+        mData = mBuffer;
+        mDataEnd = mBuffer + mBufferSize;
+        mNextChunkSize = mInitialSize;
+    }
+
+    MonotonicBufferResource(const MonotonicBufferResource&) = delete;
+    MonotonicBufferResource& operator = (const MonotonicBufferResource&) = delete;
+protected:
+    virtual void* doAllocate(size_t size, size_t align) {
+        if (size == 0) size = 1;
+        char *p = alignUp(mData, align);
+        if (mData == nullptr || p > mDataEnd || (size_t)(mDataEnd - p) < size) {
+            allocChunk(size + align);
+            p = alignUp(mData, align);
+        }
+        mData = p + size;
+        return p;
+    }
+    virtual void doDeallocate(void*, size_t, size_t) {}
+private:
+    struct Chunk {
+        Chunk *next;
+        size_t size;
+    };
+    static const size_t MAX_CHUNK_SIZE = 32 * 1024 * 1024;
+
+    void allocChunk(size_t minSize) {
+        size_t size = max(mNextChunkSize, minSize + sizeof(Chunk));
+        Chunk *chunk = (Chunk*)mUpstream->allocate(size);
+        chunk->next = mChunks;
+        chunk->size = size;
+        mChunks = chunk;
+        mData = (char*)(chunk + 1);
+        mDataEnd = (char*)chunk + size;
+        mNextChunkSize = min(mNextChunkSize * 2, (size_t)MAX_CHUNK_SIZE);
+    }
+private:
+    MemoryResource *mUpstream;
+    Chunk *mChunks;
+    char *mBuffer;
+    size_t mBufferSize;
+    char *mData, *mDataEnd;
+    size_t mInitialSize, mNextChunkSize;
+};
+
+// Free lists of size classes, 8 bytes apart up to 512, then powers of 2 up to largestBlock. Larger or over-aligned
+// blocks go to the upstream, linked to be freed by release() too.
+class UnsynchronizedPoolResource: public MemoryResource {
+public:
+    explicit UnsynchronizedPoolResource(size_t largestBlock = 64 * 1024, MemoryResource *upstream = getDefaultResource()):
+        mUpstream(upstream), mChunks(nullptr), mLarges(nullptr) {
+        largestBlock = min(max(largestBlock, (size_t)SMALL_LIMIT * 2), (size_t)MAX_CHUNK_SIZE / 8);
+        mLargestBlock = SMALL_LIMIT * 2;
+        while (mLargestBlock < largestBlock) mLargestBlock *= 2;
+        mPools.resize(getPoolIndex(mLargestBlock) + 1);
+        for (int i = 0; i < (int)mPools.size(); ++i) {
+            Pool &pool = mPools[i];
+            pool.freeList = nullptr;
+            pool.data = pool.dataEnd = nullptr;
+            pool.blockSize = i < SMALL_POOL_COUNT ? (i + 1) * SMALL_STEP : SMALL_LIMIT << (i - SMALL_POOL_COUNT + 1);
+            pool.nextChunkSize = max((size_t)PAGE_SIZE, pool.blockSize * 8);
+        }
+    }
+    ~UnsynchronizedPoolResource() { release(); }
+
+    void release() {
+        while (mChunks != nullptr) {
+            Chunk *next = mChunks->next;
+            mUpstream->deallocate(mChunks, mChunks->size);
+            mChunks = next;
+        }
+        while (mLarges != nullptr) {
+            Large *next = mLarges->next;
+            freeLarge(mLarges);
+            mLarges = next;
+        }
+        for (Pool &pool : mPools) {
+            pool.freeList = nullptr;
+            pool.data = pool.dataEnd = nullptr;
+            pool.nextChunkSize = max((size_t)PAGE_SIZE, pool.blockSize * 8);
+        }
+    }
+
+    UnsynchronizedPoolResource(const UnsynchronizedPoolResource&) = delete;
+    UnsynchronizedPoolResource& operator = (const UnsynchronizedPoolResource&) = delete;
+protected:
+    virtual void* doAllocate(size_t size, size_t align) {
+        if (size > mLargestBlock || align > MAX_ALIGN) return allocLarge(size, align);
+
+        // a block size multiple of align keeps every block of a chunk aligned
+        size = (size + align - 1) & ~(align - 1);
+        Pool &pool = mPools[getPoolIndex(size)];
+        if (pool.freeList != nullptr) {
+            Node *n = pool.freeList;
+            pool.freeList = n->next;
+            return n;
+        }
+        if (pool.data == pool.dataEnd) allocChunk(pool);
+        void *p = pool.data;
+        pool.data += pool.blockSize;
+        return p;
+    }
+    virtual void doDeallocate(void *p, size_t size, size_t align) {
+        if (size > mLargestBlock || align > MAX_ALIGN) {
+            Large *large = (Large*)p - 1;
+            if (large->prev != nullptr) large->prev->next = large->next;
+            else mLarges = large->next;
+            if (large->next != nullptr) large->next->prev = large->prev;
+            freeLarge(large);
+            return;
+        }
+
+        size = (size + align - 1) & ~(align - 1);
+        Pool &pool = mPools[getPoolIndex(size)];
+        Node *n = (Node*)p;
+        n->next = pool.freeList;
+        pool.freeList = n;
+    }
+private:
+    struct Node {
+        Node *next;
+    };
+    struct Chunk {
+        Chunk *next;
+        size_t size;
+    };
+    struct Large {
+        Large *prev, *next;
+        size_t size, align;
+    };
+    struct Pool {
+        Node *freeList;
+        char *data, *dataEnd; // not carved yet
+        size_t blockSize, nextChunkSize;
+    };
+    static const int SMALL_STEP = 8;
+    static const int SMALL_LIMIT = 512;
+    static const int SMALL_POOL_COUNT = SMALL_LIMIT / SMALL_STEP;
+    static const size_t MAX_CHUNK_SIZE = 1024 * 1024;
+
+    static int getPoolIndex(size_t size) {
+        if (size <= (size_t)SMALL_LIMIT) return size == 0 ? 0 : (int)((size - 1) / SMALL_STEP);
+        return SMALL_POOL_COUNT + (64 - __builtin_clzll(size - 1)) - 10;
+    }
+    void allocChunk(Pool &pool) {
+        Chunk *chunk = (Chunk*)mUpstream->allocate(sizeof(Chunk) + pool.nextChunkSize);
+        chunk->next = mChunks;
+        chunk->size = sizeof(Chunk) + pool.nextChunkSize;
+        mChunks = chunk;
+        pool.data = (char*)(chunk + 1);
+        pool.dataEnd = pool.data + pool.nextChunkSize / pool.blockSize * pool.blockSize;
+        pool.nextChunkSize = min(pool.nextChunkSize * 2, max((size_t)MAX_CHUNK_SIZE, pool.blockSize));
+    }
+    void* allocLarge(size_t size, size_t align) {
+        align = max(align, (size_t)MAX_ALIGN);
+        size_t headerSize = max(align, sizeof(Large));
+        char *p = (char*)mUpstream->allocate(headerSize + size, align) + headerSize;
+        Large *large = (Large*)p - 1;
+        large->prev = nullptr;
+        large->next = mLarges;
+        large->size = size;
+        large->align = align;
+        if (mLarges != nullptr) mLarges->prev = large;
+        mLarges = large;
+        return p;
+    }
+    void freeLarge(Large *large) {
+        size_t headerSize = max(large->align, sizeof(Large));
+        mUpstream->deallocate((char*)(large + 1) - headerSize, headerSize + large->size, large->align);
+    }
+private:
+    MemoryResource *mUpstream;
+    vector<Pool> mPools;
+    Chunk *mChunks;
+    Large *mLarges;
+    size_t mLargestBlock;
+};
+
+class SynchronizedPoolResource: public MemoryResource {
+public:
+    explicit SynchronizedPoolResource(size_t largestBlock = 64 * 1024, MemoryResource *upstream = getDefaultResource()):
+        mPool(largestBlock, upstream) {}
+
+    void release() {
+        lock_guard<mutex> lock(mMutex);
+        mPool.release();
+    }
+protected:
+    virtual void* doAllocate(size_t size, size_t align) {
+        lock_guard<mutex> lock(mMutex);
+        return mPool.allocate(size, align);
+    }
+    virtual void doDeallocate(void *p, size_t size, size_t align) {
+        lock_guard<mutex> lock(mMutex);
+        mPool.deallocate(p, size, align);
+    }
+private:
+    mutex mMutex;
+    UnsynchronizedPoolResource mPool;
+};
+
+template<size_t ...I> struct IndexSequence {};
+template<size_t N, size_t ...I> struct MakeIndexSequence: MakeIndexSequence<N - 1, N - 1, I...> {};
+template<size_t ...I> struct MakeIndexSequence<0, I...> { typedef IndexSequence<I...> type; };
+
+template<typename T> struct IsPair: false_type {};
+template<typename T1, typename T2> struct IsPair<pair<T1, T2>>: true_type {};
+
+// Containers constructed by a PolymorphicAllocator get it too (uses-allocator construction), so the strings of a
+// set<PmrString> live in the resource of the set. Both halves of a pair get it as well, so do the keys and values
+// of a map. Copying a container takes the default resource, like std::pmr.
+template<typename T>
+class PolymorphicAllocator {
+public:
+    typedef T value_type;
+
+    PolymorphicAllocator(): mResource(getDefaultResource()) {}
+    PolymorphicAllocator(MemoryResource *resource): mResource(resource) {}
+    template <class U> PolymorphicAllocator(const PolymorphicAllocator<U>& o): mResource(o.resource()) {}
+
+    T* allocate(size_t n) {
+        return (T*)mResource->allocate(n * sizeof(T), alignof(T));
+    }
+    void deallocate(T *p, size_t n) {
+        mResource->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    template<typename U, typename ...Args>
+    void construct(U *p, Args&& ...args) {
+        constructMaybePair(IsPair<U>(), p, forward<Args>(args)...);
+    }
+    template<typename U>
+    void destroy(U *p) {
+        p->~U();
+    }
+
+    PolymorphicAllocator select_on_container_copy_construction() const { return PolymorphicAllocator(); }
+    MemoryResource* resource() const { return mResource; }
+private:
+    template<typename U, typename ...Args>
+    void constructMaybePair(false_type, U *p, Args&& ...args) {
+        constructWith(integral_constant<int, getKind<U, Args...>()>(), p, forward<Args>(args)...);
+    }
+    // 0: no allocator, 1: after allocator_arg, 2: last
+    template<typename U, typename ...Args>
+    static constexpr int getKind() {
+        return !uses_allocator<U, PolymorphicAllocator>::value ? 0 :
+            is_constructible<U, allocator_arg_t, const PolymorphicAllocator&, Args...>::value ? 1 : 2;
+    }
+
+    // the pair overloads of std::pmr::polymorphic_allocator::construct: everything goes piecewise, and each half's
+    // arguments get the allocator the way a whole object's would
+    template<typename T1, typename T2, typename ...Args1, typename ...Args2>
+    void constructMaybePair(true_type, pair<T1, T2> *p, piecewise_construct_t, tuple<Args1...> x, tuple<Args2...> y) {
+        ::new((void*)p) pair<T1, T2>(piecewise_construct,
+                addAllocator<T1>(integral_constant<int, getKind<T1, Args1...>()>(), move(x)),
+                addAllocator<T2>(integral_constant<int, getKind<T2, Args2...>()>(), move(y)));
+    }
+    template<typename T1, typename T2>
+    void constructMaybePair(true_type, pair<T1, T2> *p) {
+        constructMaybePair(true_type(), p, piecewise_construct, tuple<>(), tuple<>());
+    }
+    template<typename T1, typename T2, typename U, typename V>
+    void constructMaybePair(true_type, pair<T1, T2> *p, U&& x, V&& y) {
+        constructMaybePair(true_type(), p, piecewise_construct, forward_as_tuple(forward<U>(x)), forward_as_tuple(forward<V>(y)));
+    }
+    template<typename T1, typename T2, typename U, typename V>
+    void constructMaybePair(true_type, pair<T1, T2> *p, const pair<U, V>& o) {
+        constructMaybePair(true_type(), p, piecewise_construct, forward_as_tuple(o.first), forward_as_tuple(o.second));
+    }
+    template<typename T1, typename T2, typename U, typename V>
+    void constructMaybePair(true_type, pair<T1, T2> *p, pair<U, V>&& o) {
+        constructMaybePair(true_type(), p, piecewise_construct,
+                forward_as_tuple(forward<U>(o.first)), forward_as_tuple(forward<V>(o.second)));
+    }
+
+    template<typename U, typename ...Args>
+    tuple<Args&&...> addAllocator(integral_constant<int, 0>, tuple<Args...>&& args) {
+        return forwardTuple(move(args), typename MakeIndexSequence<sizeof...(Args)>::type());
+    }
+    template<typename U, typename ...Args>
+    tuple<allocator_arg_t, const PolymorphicAllocator&, Args&&...> addAllocator(integral_constant<int, 1>, tuple<Args...>&& args) {
+        return tuple_cat(tuple<allocator_arg_t, const PolymorphicAllocator&>(allocator_arg, *this),
+                forwardTuple(move(args), typename MakeIndexSequence<sizeof...(Args)>::type()));
+    }
+    template<typename U, typename ...Args>
+    tuple<Args&&..., const PolymorphicAllocator&> addAllocator(integral_constant<int, 2>, tuple<Args...>&& args) {
+        return tuple_cat(forwardTuple(move(args), typename MakeIndexSequence<sizeof...(Args)>::type()),
+                tuple<const PolymorphicAllocator&>(*this));
+    }
+    template<typename ...Args, size_t ...I>
+    static tuple<Args&&...> forwardTuple(tuple<Args...>&& args, IndexSequence<I...>) {
+        return tuple<Args&&...>(forward<Args>(get<I>(args))...);
+    }
+
+    template<typename U, typename ...Args>
+    void constructWith(integral_constant<int, 0>, U *p, Args&& ...args) {
+        ::new((void*)p) U(forward<Args>(args)...);
+    }
+    template<typename U, typename ...Args>
+    void constructWith(integral_constant<int, 1>, U *p, Args&& ...args) {
+        ::new((void*)p) U(allocator_arg, *this, forward<Args>(args)...);
+    }
+    template<typename U, typename ...Args>
+    void constructWith(integral_constant<int, 2>, U *p, Args&& ...args) {
+        ::new((void*)p) U(forward<Args>(args)..., *this);
+    }
+private:
+    MemoryResource *mResource;
+};
+template<typename T, typename U>
+static bool operator == (const PolymorphicAllocator<T>& a, const PolymorphicAllocator<U>& b) {
+    return a.resource()->isEqual(*b.resource());
+}
+template<typename T, typename U>
+static bool operator != (const PolymorphicAllocator<T>& a, const PolymorphicAllocator<U>& b) {
+    return !(a == b);
+}
+//////////////////////////////
 static void getMemUsage(double& vm_usage, double& resident_set)
 {
     vm_usage     = 0.0;
@@ -274,6 +670,41 @@ struct TemporalStringHash {
     }
 };
 
+typedef basic_string<char, char_traits<char>, PolymorphicAllocator<char>> PmrString;
+
+struct PmrStringHash {
+    size_t operator () (const PmrString& a) const {
+        return rangeHash(a.c_str(), a.c_str() + a.size());
+    }
+};
+
+#ifndef NDEBUG
+// Every way std::map builds its pair has to give the allocator to both strings; they are longer than the short
+// string buffer, so a string which missed it would live in the default resource.
+static void checkPmrMap() {
+    typedef PolymorphicAllocator<pair<const PmrString, PmrString>> Allocator;
+    MonotonicBufferResource resource;
+    map<PmrString, PmrString, less<PmrString>, Allocator> m{Allocator(&resource)};
+
+    string longKey(64, 'k'), longValue(64, 'v');
+    m.emplace((longKey + "1").c_str(), (longValue + "1").c_str());
+    m.emplace(piecewise_construct, forward_as_tuple((longKey + "2").c_str()), forward_as_tuple(100, 'x'));
+    m.insert(make_pair(PmrString((longKey + "3").c_str()), PmrString((longValue + "3").c_str())));
+    const pair<const PmrString, PmrString> kv((longKey + "4").c_str(), (longValue + "4").c_str());
+    m.insert(kv);
+    m[PmrString((longKey + "5").c_str())] = (longValue + "5").c_str();
+
+    assert(m.size() == 5);
+    assert(m[PmrString((longKey + "2").c_str())] == PmrString(100, 'x'));
+    assert(m[PmrString((longKey + "4").c_str())] == (longValue + "4").c_str());
+    assert(m[PmrString((longKey + "5").c_str())] == (longValue + "5").c_str());
+    for (auto &kv : m) {
+        assert(kv.first.get_allocator().resource() == &resource);
+        assert(kv.second.get_allocator().resource() == &resource);
+    }
+}
+#endif
+
 template<typename KT>
 class DummySet {
 public:
@@ -302,28 +733,52 @@ public:
 };
 
 template<typename SetT>
-static void go(const char *name) {
-    auto start = chrono::high_resolution_clock::now();
-
-    SetT set;
-    for (string line; getline(cin, line); ) set.insert(line.c_str());
-
+static void printResult(const char *name, double seconds, SetT& set) {
     printf("%-60s:", name);
-    printf("(%s=%.3fs)", "time", chrono::duration<double>(chrono::high_resolution_clock::now() - start).count());
+    printf("(%s=%.3fs)", "time", seconds);
 
     double vm, pm;
     getMemUsage(vm, pm);
     printf("(%s=%.3f)", "vm", vm);
     printf("(%s=%.3f)", "pm", pm);
     printf("(%s=%d)", "uniq", (int)set.size());
+}
+
+template<typename SetT>
+static void go(const char *name) {
+    auto start = chrono::high_resolution_clock::now();
+
+    SetT *set = new SetT();
+    for (string line; getline(cin, line); ) set->insert(line.c_str());
+    printResult(name, chrono::duration<double>(chrono::high_resolution_clock::now() - start).count(), *set);
+
+    start = chrono::high_resolution_clock::now();
+    delete set;
+    printf("(%s=%.3fs)", "free", chrono::duration<double>(chrono::high_resolution_clock::now() - start).count());
+    puts("");
+}
+
+// A per request arena: the set and everything in it live in the resource, so the set is never destroyed, dropping
+// the resource frees it all.
+template<typename SetT, typename ResourceT>
+static void goScoped(const char *name) {
+    auto start = chrono::high_resolution_clock::now();
+
+    ResourceT *resource = new ResourceT();
+    SetT *set = new (resource->allocate(sizeof(SetT), alignof(SetT))) SetT(typename SetT::allocator_type(resource));
+    for (string line; getline(cin, line); ) set->insert(line.c_str());
+    printResult(name, chrono::duration<double>(chrono::high_resolution_clock::now() - start).count(), *set);
+
+    start = chrono::high_resolution_clock::now();
+    delete resource;
+    printf("(%s=%.3fs)", "free", chrono::duration<double>(chrono::high_resolution_clock::now() - start).count());
     puts("");
 }
 
 template<typename Allocator>
-static void benchmarkAllocator(const char *name) {
+static void benchmarkAllocator(const char *name, Allocator a = Allocator()) {
     auto start = chrono::high_resolution_clock::now();
 
-    Allocator a;
 
     const int SIZE = 1024 * 1024;
     vector<int*> data;
@@ -358,9 +813,25 @@ static void benchmark() {
     benchmarkAllocator<allocator<int>>("allocator");
     benchmarkAllocator<TemporalAllocator<int>>("TemporalAllocator");
     benchmarkAllocator<NodeOptimalAllocator<int>>("NodeOptimalAllocator");
+    {
+        MonotonicBufferResource resource;
+        benchmarkAllocator("PolymorphicAllocator(Monotonic)", PolymorphicAllocator<int>(&resource));
+    }
+    {
+        UnsynchronizedPoolResource resource;
+        benchmarkAllocator("PolymorphicAllocator(UnsynchronizedPool)", PolymorphicAllocator<int>(&resource));
+    }
+    {
+        SynchronizedPoolResource resource;
+        benchmarkAllocator("PolymorphicAllocator(SynchronizedPool)", PolymorphicAllocator<int>(&resource));
+    }
 }
 
 int main(int argc, char *argv[]) {
+#ifndef NDEBUG
+    checkPmrMap();
+#endif
+
     if (argc < 2) {
         benchmark();
         return 0;
@@ -386,6 +857,16 @@ int main(int argc, char *argv[]) {
                         "unordered_set<SimpleString,less,TemporalAllocator>"); break;
         case 10: go<unordered_set<SimpleString, SimpleStringHash, equal_to<SimpleString>, NodeOptimalAllocator<SimpleString>>>(
                         "unordered_set<SimpleString,less,NodeOptimalAllocator>"); break;
+        case 11: goScoped<set<PmrString, less<PmrString>, PolymorphicAllocator<PmrString>>, MonotonicBufferResource>(
+                        "set<PmrString,less,Monotonic>"); break;
+        case 12: goScoped<unordered_set<PmrString, PmrStringHash, equal_to<PmrString>, PolymorphicAllocator<PmrString>>, MonotonicBufferResource>(
+                        "unordered_set<PmrString,less,Monotonic>"); break;
+        case 13: goScoped<set<PmrString, less<PmrString>, PolymorphicAllocator<PmrString>>, UnsynchronizedPoolResource>(
+                        "set<PmrString,less,UnsynchronizedPool>"); break;
+        case 14: goScoped<unordered_set<PmrString, PmrStringHash, equal_to<PmrString>, PolymorphicAllocator<PmrString>>, UnsynchronizedPoolResource>(
+                        "unordered_set<PmrString,less,UnsynchronizedPool>"); break;
+        case 15: goScoped<set<PmrString, less<PmrString>, PolymorphicAllocator<PmrString>>, SynchronizedPoolResource>(
+                        "set<PmrString,less,SynchronizedPool>"); break;
         default:
             fprintf(stderr, "%s\n", "Invalid algo type!");
             return 1;
@@ -13,6 +13,14 @@
     ScanFFT::Transform(name1##Reals, name1##Imags, name0##Reals, name0##Imags, log2OfSize)
 #define SCANFFT_INVERSE_TRANSFORM(name1, name0, log2OfSize) \
     ScanFFT::InverseTransform(name1##Reals, name1##Imags, name0##Reals, name0##Imags, log2OfSize)
+#define SCANFFT_TRANSFORM_N(name1, name0, size) \
+    ScanFFT::TransformN(name1##Reals, name1##Imags, name0##Reals, name0##Imags, size)
+#define SCANFFT_INVERSE_TRANSFORM_N(name1, name0, size) \
+    ScanFFT::InverseTransformN(name1##Reals, name1##Imags, name0##Reals, name0##Imags, size)
+#define SCANFFT_BATCH_TRANSFORM(name1, name0, size, batchCount) \
+    ScanFFT::BatchTransform(name1##Reals, name1##Imags, name0##Reals, name0##Imags, size, batchCount)
+#define SCANFFT_BATCH_INVERSE_TRANSFORM(name1, name0, size, batchCount) \
+    ScanFFT::BatchInverseTransform(name1##Reals, name1##Imags, name0##Reals, name0##Imags, size, batchCount)
 
 
 namespace ScanFFT {
@@ -22,6 +30,26 @@ void Transform(Float *destReals, Float *destImags, Float const *srcReals, Float
 void InverseTransform(Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, uint8_t log2OfSize);
 void Cleanup();
 
+
+// Any size of the form 2^a * 3^b * 5^c. The kernel for a size (the power of two FFTs above, mixed radix
+// Stockham, or six-step on all threads for sizes beyond L2) is chosen by the planner on the first call
+// and cached until Cleanup(). All transforms are out of place on 64 byte aligned arrays, like Transform.
+enum class PlannerMode { Estimate, Measure };
+void SetPlannerMode(PlannerMode mode);
+bool IsSupportedSize(size_t size);
+
+void TransformN(Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, size_t size);
+void InverseTransformN(Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, size_t size);
+
+// Real input of an even size, through a complex transform of size / 2 which must be supported.
+// Only the size / 2 + 1 non-negative frequencies are stored, the rest are their conjugates.
+void RealTransform(Float *destReals, Float *destImags, Float const *src, size_t size);
+void InverseRealTransform(Float *dest, Float const *srcReals, Float const *srcImags, size_t size);
+
+// batchCount transforms of size stored one after another, spread over all threads.
+void BatchTransform(Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, size_t size, size_t batchCount);
+void BatchInverseTransform(Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, size_t size, size_t batchCount);
+
 }
 
 
@@ -0,0 +1,394 @@
+#ifndef SCANFFTIMPL_MIXEDRADIXFFT_H
+#define SCANFFTIMPL_MIXEDRADIXFFT_H
+
+
+#include <cassert>
+#include <cstdint>
+
+
+#include <vector>
+#include <complex>
+
+
+#include <ScanFFT_Config.h>
+#include <ScanFFT_Utils.h>
+
+
+#if SCANFFT_SIMD
+#include <immintrin.h>
+#endif
+
+
+namespace ScanFFT {
+
+
+//----------------------------------------------------------------------
+// Lanes: the same butterfly code runs on one Float or on one AVX register of them
+
+struct ScalarLanes {
+    using V = Float;
+    static size_t const kWidth = 1;
+
+    static V Load(Float const *p) { return *p; }
+    static V LoadStrided(Float const *p, size_t) { return *p; }
+    static void Store(Float *p, V v) { *p = v; }
+    static V Set1(Float f) { return f; }
+    static V Add(V a, V b) { return a + b; }
+    static V Sub(V a, V b) { return a - b; }
+    static V Mul(V a, V b) { return a * b; }
+};
+
+
+#if SCANFFT_SIMD && SCANFFT_SINGLE_PRECISION_FLOAT
+
+struct VectorLanes {
+    using V = __m256;
+    static size_t const kWidth = 8;
+
+    static V Load(float const *p) { return _mm256_load_ps(p); }
+    static V LoadStrided(float const *p, size_t stride) {
+        return _mm256_set_ps(p[7 * stride], p[6 * stride], p[5 * stride], p[4 * stride], p[3 * stride], p[2 * stride], p[stride], p[0]);
+    }
+    static void Store(float *p, V v) { _mm256_store_ps(p, v); }
+    static V Set1(float f) { return _mm256_set1_ps(f); }
+    static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+};
+
+#elif SCANFFT_SIMD
+
+struct VectorLanes {
+    using V = __m256d;
+    static size_t const kWidth = 4;
+
+    static V Load(double const *p) { return _mm256_load_pd(p); }
+    static V LoadStrided(double const *p, size_t stride) { return _mm256_set_pd(p[3 * stride], p[2 * stride], p[stride], p[0]); }
+    static void Store(double *p, V v) { _mm256_store_pd(p, v); }
+    static V Set1(double f) { return _mm256_set1_pd(f); }
+    static V Add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V Sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V Mul(V a, V b) { return _mm256_mul_pd(a, b); }
+};
+
+#else
+
+using VectorLanes = ScalarLanes;
+
+#endif
+
+
+template<typename L>
+struct ComplexLanes {
+    typename L::V re, im;
+};
+
+
+template<typename L>
+SCANFFT_FORCEINLINE inline ComplexLanes<L> CLoad(Float const *reals, Float const *imags, size_t i) {
+    return { L::Load(reals + i), L::Load(imags + i) };
+}
+
+template<typename L>
+SCANFFT_FORCEINLINE inline void CStore(Float *reals, Float *imags, size_t i, ComplexLanes<L> const &a) {
+    L::Store(reals + i, a.re);
+    L::Store(imags + i, a.im);
+}
+
+template<typename L>
+SCANFFT_FORCEINLINE inline ComplexLanes<L> CAdd(ComplexLanes<L> const &a, ComplexLanes<L> const &b) {
+    return { L::Add(a.re, b.re), L::Add(a.im, b.im) };
+}
+
+template<typename L>
+SCANFFT_FORCEINLINE inline ComplexLanes<L> CSub(ComplexLanes<L> const &a, ComplexLanes<L> const &b) {
+    return { L::Sub(a.re, b.re), L::Sub(a.im, b.im) };
+}
+
+template<typename L>
+SCANFFT_FORCEINLINE inline ComplexLanes<L> CScale(ComplexLanes<L> const &a, typename L::V s) {
+    return { L::Mul(a.re, s), L::Mul(a.im, s) };
+}
+
+// a + i * b
+template<typename L>
+SCANFFT_FORCEINLINE inline ComplexLanes<L> CAddTimesI(ComplexLanes<L> const &a, ComplexLanes<L> const &b) {
+    return { L::Sub(a.re, b.im), L::Add(a.im, b.re) };
+}
+
+// a - i * b
+template<typename L>
+SCANFFT_FORCEINLINE inline ComplexLanes<L> CSubTimesI(ComplexLanes<L> const &a, ComplexLanes<L> const &b) {
+    return { L::Add(a.re, b.im), L::Sub(a.im, b.re) };
+}
+
+// a * w, or a * conj(w) for the inverse transform
+template<typename L, bool Inverse>
+SCANFFT_FORCEINLINE inline ComplexLanes<L> CMul(ComplexLanes<L> const &a, ComplexLanes<L> const &w) {
+    if (Inverse)
+        return { L::Add(L::Mul(a.re, w.re), L::Mul(a.im, w.im)), L::Sub(L::Mul(a.im, w.re), L::Mul(a.re, w.im)) };
+    else
+        return { L::Sub(L::Mul(a.re, w.re), L::Mul(a.im, w.im)), L::Add(L::Mul(a.im, w.re), L::Mul(a.re, w.im)) };
+}
+
+
+//----------------------------------------------------------------------
+// Small DFTs with the library's sign convention: the forward transform uses exp(+2 pi i / p)
+
+template<typename L, size_t P, bool Inverse>
+struct Butterfly;
+
+template<typename L, bool Inverse>
+struct Butterfly<L, 2, Inverse> {
+    SCANFFT_FORCEINLINE static void Run(ComplexLanes<L> *a) {
+        auto a0 = a[0];
+        a[0] = CAdd(a0, a[1]);
+        a[1] = CSub(a0, a[1]);
+    }
+};
+
+template<typename L, bool Inverse>
+struct Butterfly<L, 3, Inverse> {
+    SCANFFT_FORCEINLINE static void Run(ComplexLanes<L> *a) {
+        auto const kHalf = L::Set1(Float(0.5));
+        auto const kSin = L::Set1(Float(Inverse ? -0.86602540378443864676 : 0.86602540378443864676));
+        auto t1 = CAdd(a[1], a[2]);
+        auto m = CSub(a[0], CScale(t1, kHalf));
+        auto d = CScale(CSub(a[1], a[2]), kSin);
+        a[0] = CAdd(a[0], t1);
+        a[1] = CAddTimesI(m, d);
+        a[2] = CSubTimesI(m, d);
+    }
+};
+
+template<typename L, bool Inverse>
+struct Butterfly<L, 4, Inverse> {
+    SCANFFT_FORCEINLINE static void Run(ComplexLanes<L> *a) {
+        auto s02 = CAdd(a[0], a[2]), d02 = CSub(a[0], a[2]);
+        auto s13 = CAdd(a[1], a[3]), d13 = CSub(a[1], a[3]);
+        a[0] = CAdd(s02, s13);
+        a[2] = CSub(s02, s13);
+        if (Inverse) {
+            a[1] = CSubTimesI(d02, d13);
+            a[3] = CAddTimesI(d02, d13);
+        } else {
+            a[1] = CAddTimesI(d02, d13);
+            a[3] = CSubTimesI(d02, d13);
+        }
+    }
+};
+
+template<typename L, bool Inverse>
+struct Butterfly<L, 5, Inverse> {
+    SCANFFT_FORCEINLINE static void Run(ComplexLanes<L> *a) {
+        auto const kCos1 = L::Set1(Float(0.30901699437494742410)), kCos2 = L::Set1(Float(-0.80901699437494742410));
+        auto const kSin1 = L::Set1(Float(Inverse ? -0.95105651629515357212 : 0.95105651629515357212));
+        auto const kSin2 = L::Set1(Float(Inverse ? -0.58778525229247312917 : 0.58778525229247312917));
+        auto t1 = CAdd(a[1], a[4]), t2 = CAdd(a[2], a[3]);
+        auto d1 = CSub(a[1], a[4]), d2 = CSub(a[2], a[3]);
+        auto m1 = CAdd(a[0], CAdd(CScale(t1, kCos1), CScale(t2, kCos2)));
+        auto m2 = CAdd(a[0], CAdd(CScale(t1, kCos2), CScale(t2, kCos1)));
+        auto n1 = CAdd(CScale(d1, kSin1), CScale(d2, kSin2));
+        auto n2 = CSub(CScale(d1, kSin2), CScale(d2, kSin1));
+        a[0] = CAdd(a[0], CAdd(t1, t2));
+        a[1] = CAddTimesI(m1, n1);
+        a[4] = CSubTimesI(m1, n1);
+        a[2] = CAddTimesI(m2, n2);
+        a[3] = CSubTimesI(m2, n2);
+    }
+};
+
+
+// f(0), ..., f(N - 1) without relying on the compiler to unroll, so that the
+// per-radix arrays of registers below stay in registers
+template<size_t N>
+struct StaticFor {
+    template<typename TFunc>
+    SCANFFT_FORCEINLINE static void Run(TFunc const &f) {
+        StaticFor<N - 1>::Run(f);
+        f(N - 1);
+    }
+};
+
+template<>
+struct StaticFor<0> {
+    template<typename TFunc>
+    SCANFFT_FORCEINLINE static void Run(TFunc const &) {}
+};
+
+
+//----------------------------------------------------------------------
+// Stockham autosort pass, decimation in frequency.
+// The input is viewed as [l1][P][ido] and the output as [P][l1][ido]; output q of the butterfly
+// is multiplied by w^(q*i) with w = exp(2 pi i / (P * ido)). Starting from l1 = 1, the passes leave
+// the result in natural order without a bit reversal.
+
+template<typename L, size_t P, bool Inverse>
+static void StockhamPass(
+    Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags,
+    Float const *twiddleReals, Float const *twiddleImags, size_t l1, size_t ido, Float scale) {
+
+    auto const scaled = scale != 1;
+    auto const scaler = L::Set1(scale);
+    for (size_t k = 0; k < l1; ++k) {
+        auto src = k * P * ido;
+        auto dest = k * ido;
+        for (size_t i = 0; i < ido; i += L::kWidth) {
+            ComplexLanes<L> a[P];
+            StaticFor<P>::Run([&](size_t s) {
+                a[s] = CLoad<L>(srcReals, srcImags, src + s * ido + i);
+                if (scaled)
+                    a[s] = CScale(a[s], scaler);
+            });
+
+            Butterfly<L, P, Inverse>::Run(a);
+
+            StaticFor<P>::Run([&](size_t q) {
+                if (q > 0 && ido > 1)
+                    a[q] = CMul<L, Inverse>(a[q], CLoad<L>(twiddleReals, twiddleImags, (q - 1) * ido + i));
+                CStore(destReals, destImags, dest + q * l1 * ido + i, a[q]);
+            });
+        }
+    }
+}
+
+
+// The last pass (ido = 1) has no twiddles and nothing contiguous to vectorize over inside a
+// butterfly, so the lanes run over k instead: strided loads, contiguous stores.
+template<typename L, size_t P, bool Inverse>
+static void StockhamLastPass(
+    Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, size_t l1, Float scale) {
+
+    auto const scaled = scale != 1;
+    auto const scaler = L::Set1(scale);
+    for (size_t k = 0; k < l1; k += L::kWidth) {
+        ComplexLanes<L> a[P];
+        StaticFor<P>::Run([&](size_t s) {
+            a[s] = { L::LoadStrided(srcReals + k * P + s, P), L::LoadStrided(srcImags + k * P + s, P) };
+            if (scaled)
+                a[s] = CScale(a[s], scaler);
+        });
+
+        Butterfly<L, P, Inverse>::Run(a);
+
+        StaticFor<P>::Run([&](size_t q) {
+            CStore(destReals, destImags, k + q * l1, a[q]);
+        });
+    }
+}
+
+
+inline bool IsAligned(void const *p) {
+    return reinterpret_cast<uintptr_t>(p) % 64 == 0;
+}
+
+
+template<size_t P, bool Inverse>
+static void StockhamPass(
+    Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags,
+    Float const *twiddleReals, Float const *twiddleImags, size_t l1, size_t ido, Float scale) {
+    if (ido == 1 && l1 % VectorLanes::kWidth == 0 && IsAligned(destReals) && IsAligned(destImags))
+        StockhamLastPass<VectorLanes, P, Inverse>(destReals, destImags, srcReals, srcImags, l1, scale);
+    else if (ido % VectorLanes::kWidth == 0
+        && IsAligned(destReals) && IsAligned(destImags) && IsAligned(srcReals) && IsAligned(srcImags))
+        StockhamPass<VectorLanes, P, Inverse>(destReals, destImags, srcReals, srcImags, twiddleReals, twiddleImags, l1, ido, scale);
+    else
+        StockhamPass<ScalarLanes, P, Inverse>(destReals, destImags, srcReals, srcImags, twiddleReals, twiddleImags, l1, ido, scale);
+}
+
+
+//----------------------------------------------------------------------
+
+// Splits size into radices 4, 2, 3 and 5, returns false if anything else remains.
+// fourFirst chooses between {4.., 2, 3.., 5..} and {5.., 3.., 2, 4..}.
+static bool FactorizeMixedRadix(size_t size, bool fourFirst, std::vector<uint8_t> &factors) {
+    factors.clear();
+    if (size == 0)
+        return false;
+
+    size_t counts[6] = {};
+    for (auto p : { 4, 2, 3, 5 }) {
+        while (size % p == 0) {
+            size /= p;
+            ++counts[p];
+        }
+    }
+    if (size != 1)
+        return false;
+
+    auto const order = fourFirst ? std::vector<uint8_t>{ 4, 2, 3, 5 } : std::vector<uint8_t>{ 5, 3, 2, 4 };
+    for (auto p : order)
+        factors.insert(factors.end(), counts[p], p);
+    return true;
+}
+
+
+// Twiddles of all passes, one aligned array per pass: (p - 1) * ido entries, q-major.
+static void SetupMixedRadixTwiddles(
+    size_t size, std::vector<uint8_t> const &factors,
+    std::vector<Float*> &twiddleReal2DArray, std::vector<Float*> &twiddleImag2DArray) {
+
+    auto const kPi = acos(-1.0);
+
+    size_t l1 = 1;
+    for (auto p : factors) {
+        auto ido = size / (l1 * p);
+        auto count = std::max<size_t>((p - 1) * ido, 1);
+        auto twiddleReals = Alloc<Float>(count), twiddleImags = Alloc<Float>(count);
+        for (size_t q = 1; q < p; ++q) {
+            for (size_t i = 0; i < ido; ++i) {
+                auto w = std::polar<double>(1, 2 * kPi * double(q * i) / double(p * ido));
+                twiddleReals[(q - 1) * ido + i] = Float(w.real());
+                twiddleImags[(q - 1) * ido + i] = Float(w.imag());
+            }
+        }
+        twiddleReal2DArray.push_back(twiddleReals);
+        twiddleImag2DArray.push_back(twiddleImags);
+        l1 *= p;
+    }
+}
+
+
+// Out of place; workReals/workImags must hold size elements. Inverse transforms are scaled by 1 / size.
+template<bool Inverse>
+static void MixedRadixFFT(
+    Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags,
+    Float *workReals, Float *workImags, size_t size, std::vector<uint8_t> const &factors,
+    std::vector<Float*> const &twiddleReal2DArray, std::vector<Float*> const &twiddleImag2DArray) {
+
+    if (factors.empty()) {
+        std::copy(srcReals, srcReals + size, destReals);
+        std::copy(srcImags, srcImags + size, destImags);
+        return;
+    }
+
+    // Ping-pong between dest and work so that the last pass writes dest
+    Float *outReals[] = { destReals, workReals }, *outImags[] = { destImags, workImags };
+    auto out = factors.size() % 2 == 0 ? 1 : 0;
+    auto inReals = srcReals, inImags = srcImags;
+    auto scale = Inverse ? Float(1) / size : Float(1);
+
+    size_t l1 = 1;
+    for (size_t pass = 0; pass < factors.size(); ++pass) {
+        auto p = factors[pass];
+        auto ido = size / (l1 * p);
+        auto twiddleReals = twiddleReal2DArray[pass], twiddleImags = twiddleImag2DArray[pass];
+        auto passScale = pass == 0 ? scale : Float(1);
+        switch (p) {
+        case 2: StockhamPass<2, Inverse>(outReals[out], outImags[out], inReals, inImags, twiddleReals, twiddleImags, l1, ido, passScale); break;
+        case 3: StockhamPass<3, Inverse>(outReals[out], outImags[out], inReals, inImags, twiddleReals, twiddleImags, l1, ido, passScale); break;
+        case 4: StockhamPass<4, Inverse>(outReals[out], outImags[out], inReals, inImags, twiddleReals, twiddleImags, l1, ido, passScale); break;
+        case 5: StockhamPass<5, Inverse>(outReals[out], outImags[out], inReals, inImags, twiddleReals, twiddleImags, l1, ido, passScale); break;
+        default: assert(0); break;
+        }
+        inReals = outReals[out], inImags = outImags[out];
+        out ^= 1;
+        l1 *= p;
+    }
+}
+
+
+}
+
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SCANFFTIMPL_PLANNER_H
+#define SCANFFTIMPL_PLANNER_H
+
+
+#include <cstddef>
+
+
+namespace ScanFFT {
+
+// Called from Setup/Cleanup: the planner may only use the power of two FFTs up to log2OfMaxSize,
+// and cached plans are freed on cleanup.
+void SetupPlanner(size_t log2OfMaxSize);
+void CleanupPlanner();
+
+}
+
+
+#endif
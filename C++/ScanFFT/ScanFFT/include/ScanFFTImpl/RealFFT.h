@@ -0,0 +1,99 @@
+#ifndef SCANFFTIMPL_REALFFT_H
+#define SCANFFTIMPL_REALFFT_H
+
+
+#include <vector>
+#include <complex>
+
+
+#include <ScanFFT_Config.h>
+#include <ScanFFT_Utils.h>
+
+
+namespace ScanFFT {
+
+
+// A real transform of size = 2 * halfSize packs the even samples into the reals and the odd ones
+// into the imags of a complex transform of halfSize: Z = E + i O. With w = exp(2 pi i / size),
+// X[k] = E[k] + w^k O[k], where E[k] = (Z[k] + conj(Z[halfSize - k])) / 2
+// and O[k] = (Z[k] - conj(Z[halfSize - k])) / 2i.
+
+
+// w^k for k in [0, halfSize / 2]
+static void SetupRealFFTTwiddles(size_t size, Float *&twiddleReals, Float *&twiddleImags) {
+    auto const kPi = acos(-1.0);
+    auto count = size / 4 + 1;
+    twiddleReals = Alloc<Float>(count), twiddleImags = Alloc<Float>(count);
+    for (size_t k = 0; k < count; ++k) {
+        auto w = std::polar<double>(1, 2 * kPi * double(k) / double(size));
+        twiddleReals[k] = Float(w.real()), twiddleImags[k] = Float(w.imag());
+    }
+}
+
+
+static void RealFFTDeinterleave(Float *zReals, Float *zImags, Float const *src, size_t halfSize) {
+    for (size_t i = 0; i < halfSize; ++i) {
+        zReals[i] = src[2 * i];
+        zImags[i] = src[2 * i + 1];
+    }
+}
+
+
+static void RealFFTInterleave(Float *dest, Float const *zReals, Float const *zImags, size_t halfSize) {
+    for (size_t i = 0; i < halfSize; ++i) {
+        dest[2 * i] = zReals[i];
+        dest[2 * i + 1] = zImags[i];
+    }
+}
+
+
+// In place: the first halfSize bins hold Z, all halfSize + 1 bins hold X afterwards.
+// Bins k and halfSize - k are done together: X[halfSize - k] = conj(E[k] - w^k O[k]).
+static void RealFFTPostProcess(
+    Float *reals, Float *imags, Float const *twiddleReals, Float const *twiddleImags, size_t halfSize) {
+
+    for (size_t k = 0; k <= halfSize / 2; ++k) {
+        auto j = halfSize - k;
+        auto jj = k == 0 ? 0 : j;
+        std::complex<Float> zk(reals[k], imags[k]), zj(reals[jj], imags[jj]);
+        std::complex<Float> w(twiddleReals[k], twiddleImags[k]);
+
+        auto e = (zk + std::conj(zj)) * Float(0.5);
+        auto d = zk - std::conj(zj);
+        auto wo = w * std::complex<Float>(d.imag() * Float(0.5), -d.real() * Float(0.5));
+
+        auto xk = e + wo, xj = std::conj(e - wo);
+        reals[k] = xk.real(), imags[k] = xk.imag();
+        reals[j] = xj.real(), imags[j] = xj.imag();
+    }
+}
+
+
+// The inverse of RealFFTPostProcess: halfSize + 1 bins of X to halfSize bins of Z = E + i O,
+// with E[k] = (X[k] + conj(X[halfSize - k])) / 2 and O[k] = (X[k] - conj(X[halfSize - k])) / 2 * w^-k.
+static void RealFFTPreProcess(
+    Float *zReals, Float *zImags, Float const *srcReals, Float const *srcImags,
+    Float const *twiddleReals, Float const *twiddleImags, size_t halfSize) {
+
+    for (size_t k = 0; k <= halfSize / 2; ++k) {
+        auto j = halfSize - k;
+        std::complex<Float> xk(srcReals[k], srcImags[k]), xj(srcReals[j], srcImags[j]);
+        std::complex<Float> w(twiddleReals[k], -twiddleImags[k]);
+
+        auto e = (xk + std::conj(xj)) * Float(0.5);
+        auto o = (xk - std::conj(xj)) * Float(0.5) * w;
+
+        auto zk = e + std::complex<Float>(-o.imag(), o.real());
+        zReals[k] = zk.real(), zImags[k] = zk.imag();
+        if (k != 0 && k != j) {
+            auto zj = std::conj(e) + std::complex<Float>(o.imag(), o.real());
+            zReals[j] = zj.real(), zImags[j] = zj.imag();
+        }
+    }
+}
+
+
+}
+
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef SCANFFTIMPL_SIXSTEPFFT_H
+#define SCANFFTIMPL_SIXSTEPFFT_H
+
+
+#include <cstdint>
+
+
+#include <vector>
+#include <complex>
+
+
+#include <ScanFFT_Config.h>
+#include <ScanFFT_Utils.h>
+#include <ScanFFTImpl\MixedRadixFFT.h>
+
+
+namespace ScanFFT {
+
+
+// exp(2 pi i * e / size) for e < size, as coarse[e >> shift] * fine[e & mask]: two tables of about
+// sqrt(size) instead of one of size, which would not fit in cache for the sizes six-step is used for.
+struct SixStepTwiddles {
+    size_t shift;
+    Float *coarseReals, *coarseImags;
+    Float *fineReals, *fineImags;
+};
+
+
+static void SetupSixStepTwiddles(size_t size, SixStepTwiddles &twiddles) {
+    auto const kPi = acos(-1.0);
+
+    size_t shift = 0;
+    while ((1ULL << (2 * shift)) < size)
+        ++shift;
+    size_t fineCount = 1ULL << shift, coarseCount = (size >> shift) + 1;
+
+    twiddles.shift = shift;
+    twiddles.fineReals = Alloc<Float>(fineCount), twiddles.fineImags = Alloc<Float>(fineCount);
+    twiddles.coarseReals = Alloc<Float>(coarseCount), twiddles.coarseImags = Alloc<Float>(coarseCount);
+    for (size_t i = 0; i < fineCount; ++i) {
+        auto w = std::polar<double>(1, 2 * kPi * double(i) / double(size));
+        twiddles.fineReals[i] = Float(w.real()), twiddles.fineImags[i] = Float(w.imag());
+    }
+    for (size_t i = 0; i < coarseCount; ++i) {
+        auto w = std::polar<double>(1, 2 * kPi * double(i << shift) / double(size));
+        twiddles.coarseReals[i] = Float(w.real()), twiddles.coarseImags[i] = Float(w.imag());
+    }
+}
+
+
+static void CleanupSixStepTwiddles(SixStepTwiddles &twiddles) {
+    Free(twiddles.fineReals), Free(twiddles.fineImags);
+    Free(twiddles.coarseReals), Free(twiddles.coarseImags);
+}
+
+
+// exp(2 pi i * e / size), or its conjugate
+template<bool Inverse>
+inline std::complex<Float> SixStepTwiddle(SixStepTwiddles const &twiddles, size_t e) {
+    size_t hi = e >> twiddles.shift, lo = e & ((size_t(1) << twiddles.shift) - 1);
+    auto w = std::complex<Float>(twiddles.coarseReals[hi], twiddles.coarseImags[hi])
+        * std::complex<Float>(twiddles.fineReals[lo], twiddles.fineImags[lo]);
+    return Inverse ? std::conj(w) : w;
+}
+
+
+// Row r of the transformed rows times exp(+-2 pi i * r * c / size) for column c, while the row is still in cache.
+// Every kWidth columns start again from the tables, the lanes in between are one multiply away.
+template<typename L, bool Inverse>
+static void SixStepTwiddleRow(
+    Float *reals, Float *imags, size_t r, size_t rowSize, SixStepTwiddles const &twiddles) {
+
+    alignas(64) Float stepReals[L::kWidth], stepImags[L::kWidth];
+    for (size_t m = 0; m < L::kWidth; ++m) {
+        auto w = SixStepTwiddle<Inverse>(twiddles, r * m);
+        stepReals[m] = w.real(), stepImags[m] = w.imag();
+    }
+    ComplexLanes<L> step = CLoad<L>(stepReals, stepImags, 0);
+
+    for (size_t c = 0; c < rowSize; c += L::kWidth) {
+        auto base = SixStepTwiddle<Inverse>(twiddles, r * c);
+        ComplexLanes<L> w = CMul<L, false>(step, ComplexLanes<L>{ L::Set1(base.real()), L::Set1(base.imag()) });
+        CStore(reals, imags, c, CMul<L, false>(CLoad<L>(reals, imags, c), w));
+    }
+}
+
+
+#if SCANFFT_SIMD && !SCANFFT_SINGLE_PRECISION_FLOAT
+
+SCANFFT_FORCEINLINE inline void SixStepTranspose4x4(double *dest, size_t destStride, double const *src, size_t srcStride) {
+    auto row0 = _mm256_load_pd(src), row1 = _mm256_load_pd(src + srcStride);
+    auto row2 = _mm256_load_pd(src + 2 * srcStride), row3 = _mm256_load_pd(src + 3 * srcStride);
+    auto t0 = _mm256_unpacklo_pd(row0, row1), t1 = _mm256_unpackhi_pd(row0, row1);
+    auto t2 = _mm256_unpacklo_pd(row2, row3), t3 = _mm256_unpackhi_pd(row2, row3);
+    _mm256_store_pd(dest, _mm256_permute2f128_pd(t0, t2, 0x20));
+    _mm256_store_pd(dest + destStride, _mm256_permute2f128_pd(t1, t3, 0x20));
+    _mm256_store_pd(dest + 2 * destStride, _mm256_permute2f128_pd(t0, t2, 0x31));
+    _mm256_store_pd(dest + 3 * destStride, _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+
+#endif
+
+
+// dest (cols x rows) = transpose of src (rows x cols), in tiles; 4x4 blocks in registers when they line up.
+static void SixStepTranspose(
+    Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags,
+    size_t rows, size_t cols, bool threaded) {
+
+    size_t const kTile = 16;
+    auto const tileRows = int((rows + kTile - 1) / kTile);
+#if SCANFFT_SIMD && !SCANFFT_SINGLE_PRECISION_FLOAT
+    auto const blocked = rows % 4 == 0 && cols % 4 == 0
+        && IsAligned(destReals) && IsAligned(destImags) && IsAligned(srcReals) && IsAligned(srcImags);
+#endif
+
+#pragma omp parallel for if (threaded) schedule(static)
+    for (int tileRow = 0; tileRow < tileRows; ++tileRow) {
+        size_t r0 = tileRow * kTile, r1 = std::min(r0 + kTile, rows);
+        for (size_t c0 = 0; c0 < cols; c0 += kTile) {
+            auto c1 = std::min(c0 + kTile, cols);
+#if SCANFFT_SIMD && !SCANFFT_SINGLE_PRECISION_FLOAT
+            if (blocked) {
+                for (auto r = r0; r < r1; r += 4) {
+                    for (auto c = c0; c < c1; c += 4) {
+                        SixStepTranspose4x4(destReals + c * rows + r, rows, srcReals + r * cols + c, cols);
+                        SixStepTranspose4x4(destImags + c * rows + r, rows, srcImags + r * cols + c, cols);
+                    }
+                }
+                continue;
+            }
+#endif
+            for (auto r = r0; r < r1; ++r) {
+                for (auto c = c0; c < c1; ++c) {
+                    destReals[c * rows + r] = srcReals[r * cols + c];
+                    destImags[c * rows + r] = srcImags[r * cols + c];
+                }
+            }
+        }
+    }
+}
+
+
+// rowFFT(destReals, destImags, srcReals, srcImags, rowSize) transforms one contiguous row out of place;
+// it is called from several threads at once when threaded. With twiddles the rows are multiplied
+// by them right after their FFT.
+template<bool Inverse, typename TRowFFT>
+static void SixStepRows(
+    Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags,
+    size_t rows, size_t rowSize, TRowFFT const &rowFFT, SixStepTwiddles const *twiddles, bool threaded) {
+
+    auto const vectorized = rowSize % VectorLanes::kWidth == 0 && IsAligned(destReals) && IsAligned(destImags);
+
+#pragma omp parallel for if (threaded) schedule(static)
+    for (int r = 0; r < int(rows); ++r) {
+        auto offset = r * rowSize;
+        rowFFT(destReals + offset, destImags + offset, srcReals + offset, srcImags + offset, rowSize);
+        if (twiddles != nullptr) {
+            if (vectorized)
+                SixStepTwiddleRow<VectorLanes, Inverse>(destReals + offset, destImags + offset, r, rowSize, *twiddles);
+            else
+                SixStepTwiddleRow<ScalarLanes, Inverse>(destReals + offset, destImags + offset, r, rowSize, *twiddles);
+        }
+    }
+}
+
+
+// size = n1 * n2, with x[n2 * j1 + j2] and X[k1 + n1 * k2]:
+// X = sum_j2 w_n2^(j2 k2) w_size^(j2 k1) sum_j1 w_n1^(j1 k1) x
+// 1. transpose to n2 rows of n1, 2. row FFTs of n1, 3. twiddles, 4. transpose to n1 rows of n2,
+// 5. row FFTs of n2, 6. transpose back. Every FFT is on a contiguous row that fits in cache,
+// and the rows are independent so they run on all threads. dest is used as one of the buffers,
+// work must hold size elements.
+template<bool Inverse, typename TRowFFT1, typename TRowFFT2>
+static void SixStepFFT(
+    Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags,
+    Float *workReals, Float *workImags, size_t n1, size_t n2,
+    SixStepTwiddles const &twiddles, TRowFFT1 const &rowFFT1, TRowFFT2 const &rowFFT2, bool threaded) {
+
+    SixStepTranspose(destReals, destImags, srcReals, srcImags, n1, n2, threaded);
+    SixStepRows<Inverse>(workReals, workImags, destReals, destImags, n2, n1, rowFFT1, &twiddles, threaded);
+    SixStepTranspose(destReals, destImags, workReals, workImags, n2, n1, threaded);
+    SixStepRows<Inverse>(workReals, workImags, destReals, destImags, n1, n2, rowFFT2, nullptr, threaded);
+    SixStepTranspose(destReals, destImags, workReals, workImags, n1, n2, threaded);
+}
+
+
+}
+
+
+#endif
@@ -1,6 +1,7 @@
 #include "ScanFFT.h"
 #include "ScanFFTImpl\UnrolledFFT.h"
 #include "ScanFFTImpl\DefaultFFT.h"
+#include "ScanFFTImpl\Planner.h"
 
 
 namespace ScanFFT {
@@ -8,10 +9,12 @@ namespace ScanFFT {
 
 void Setup(size_t log2OfMaxSize) {
     SetupDefaultFFT(log2OfMaxSize);
+    SetupPlanner(log2OfMaxSize);
 }
 
 
 void Cleanup() {
+    CleanupPlanner();
     CleanupDefaultFFT();
 }
 
@@ -0,0 +1,384 @@
+#include <cmath>
+
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+#include "ScanFFT.h"
+#include "ScanFFTImpl\Planner.h"
+#include "ScanFFTImpl\MixedRadixFFT.h"
+#include "ScanFFTImpl\SixStepFFT.h"
+#include "ScanFFTImpl\RealFFT.h"
+
+
+namespace ScanFFT {
+
+
+// Below this six-step is not even measured: the whole transform fits in L2
+static size_t const kSixStepMinSize = 1 << 14;
+// Estimate mode picks six-step on all threads from here
+static size_t const kSixStepEstimateSize = 1 << 18;
+
+
+enum class Algorithm { Default, MixedRadix, SixStep };
+
+
+struct Plan {
+    size_t size = 0;
+    Algorithm algorithm = Algorithm::Default;
+
+    // Default
+    uint8_t log2OfSize = 0;
+
+    // MixedRadix
+    std::vector<uint8_t> factors;
+    std::vector<Float*> twiddleReal2DArray, twiddleImag2DArray;
+
+    // SixStep
+    size_t n1 = 0, n2 = 0;
+    Plan const *rowPlan1 = nullptr, *rowPlan2 = nullptr;
+    SixStepTwiddles sixStepTwiddles = {};
+    bool threaded = false;
+
+    ~Plan() {
+        for (auto p : twiddleReal2DArray) Free(p);
+        for (auto p : twiddleImag2DArray) Free(p);
+        if (algorithm == Algorithm::SixStep)
+            CleanupSixStepTwiddles(sixStepTwiddles);
+    }
+};
+
+
+struct RealPlan {
+    Plan const *halfPlan = nullptr;
+    Float *twiddleReals = nullptr, *twiddleImags = nullptr;
+
+    ~RealPlan() {
+        Free(twiddleReals), Free(twiddleImags);
+    }
+};
+
+
+static size_t gLog2OfMaxSize = 0;
+static PlannerMode gPlannerMode = PlannerMode::Measure;
+static std::recursive_mutex gPlansMutex;
+// Keyed by size and whether six-step may be used: the rows of a six-step plan never are
+static std::map<std::pair<size_t, bool>, std::unique_ptr<Plan>> gPlans;
+static std::map<size_t, std::unique_ptr<RealPlan>> gRealPlans;
+
+
+//----------------------------------------------------------------------
+// Per thread work buffers, one slot per level that may be active at the same time on a thread
+
+enum ScratchSlot { kMixedRadixScratch, kSixStepScratch, kRealScratch, kRealScratch2, kScratchSlotCount };
+
+struct Scratch {
+    size_t size = 0;
+    Float *reals = nullptr, *imags = nullptr;
+
+    ~Scratch() {
+        Free(reals), Free(imags);
+    }
+};
+
+static thread_local Scratch tScratches[kScratchSlotCount];
+
+static Scratch& GetScratch(ScratchSlot slot, size_t size) {
+    auto &scratch = tScratches[slot];
+    if (scratch.size < size) {
+        Free(scratch.reals), Free(scratch.imags);
+        scratch.reals = Alloc<Float>(size), scratch.imags = Alloc<Float>(size);
+        scratch.size = size;
+    }
+    return scratch;
+}
+
+
+//----------------------------------------------------------------------
+
+template<bool Inverse>
+static void Execute(Plan const &plan, Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags) {
+    switch (plan.algorithm) {
+    case Algorithm::Default:
+        if (Inverse)
+            InverseTransform(destReals, destImags, srcReals, srcImags, plan.log2OfSize);
+        else
+            Transform(destReals, destImags, srcReals, srcImags, plan.log2OfSize);
+        break;
+    case Algorithm::MixedRadix:
+    {
+        auto &work = GetScratch(kMixedRadixScratch, plan.size);
+        MixedRadixFFT<Inverse>(
+            destReals, destImags, srcReals, srcImags, work.reals, work.imags,
+            plan.size, plan.factors, plan.twiddleReal2DArray, plan.twiddleImag2DArray);
+        break;
+    }
+    case Algorithm::SixStep:
+    {
+        auto &work = GetScratch(kSixStepScratch, plan.size);
+        auto rowFFT1 = [&plan](Float *dr, Float *di, Float const *sr, Float const *si, size_t) {
+            Execute<Inverse>(*plan.rowPlan1, dr, di, sr, si);
+        };
+        auto rowFFT2 = [&plan](Float *dr, Float *di, Float const *sr, Float const *si, size_t) {
+            Execute<Inverse>(*plan.rowPlan2, dr, di, sr, si);
+        };
+        SixStepFFT<Inverse>(
+            destReals, destImags, srcReals, srcImags, work.reals, work.imags,
+            plan.n1, plan.n2, plan.sixStepTwiddles, rowFFT1, rowFFT2, plan.threaded);
+        break;
+    }
+    }
+}
+
+
+//----------------------------------------------------------------------
+// Planner
+
+static Plan const* GetPlan(size_t size, bool allowSixStep);
+
+
+static int MaxThreads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+
+static std::unique_ptr<Plan> CreateDefaultPlan(size_t size) {
+    uint8_t log2OfSize = 0;
+    while ((1ULL << log2OfSize) < size)
+        ++log2OfSize;
+    if ((1ULL << log2OfSize) != size || log2OfSize > gLog2OfMaxSize)
+        return nullptr;
+
+    std::unique_ptr<Plan> plan(new Plan());
+    plan->size = size;
+    plan->algorithm = Algorithm::Default;
+    plan->log2OfSize = log2OfSize;
+    return plan;
+}
+
+
+static std::unique_ptr<Plan> CreateMixedRadixPlan(size_t size, bool fourFirst) {
+    std::unique_ptr<Plan> plan(new Plan());
+    if (!FactorizeMixedRadix(size, fourFirst, plan->factors))
+        return nullptr;
+    plan->size = size;
+    plan->algorithm = Algorithm::MixedRadix;
+    SetupMixedRadixTwiddles(size, plan->factors, plan->twiddleReal2DArray, plan->twiddleImag2DArray);
+    return plan;
+}
+
+
+static std::unique_ptr<Plan> CreateSixStepPlan(size_t size, bool threaded) {
+    // The largest divisor not above sqrt(size); any divisor of a supported size is supported
+    size_t n1 = 1;
+    for (size_t d = 2; d * d <= size; ++d) {
+        if (size % d == 0)
+            n1 = d;
+    }
+    if (n1 == 1)
+        return nullptr;
+
+    std::unique_ptr<Plan> plan(new Plan());
+    plan->size = size;
+    plan->algorithm = Algorithm::SixStep;
+    plan->n1 = n1, plan->n2 = size / n1;
+    plan->rowPlan1 = GetPlan(plan->n1, false);
+    plan->rowPlan2 = GetPlan(plan->n2, false);
+    plan->threaded = threaded;
+    SetupSixStepTwiddles(size, plan->sixStepTwiddles);
+    return plan;
+}
+
+
+static double MeasurePlan(Plan const &plan) {
+    auto size = plan.size;
+    SCANFFT_ALLOC(in, size);
+    SCANFFT_ALLOC(out, size);
+    std::iota(inReals, inReals + size, Float(0));
+    std::fill(inImags, inImags + size, Float(0));
+
+    // Warm up first: the work buffers are allocated and faulted in on the first call
+    Execute<false>(plan, outReals, outImags, inReals, inImags);
+    auto loop = std::max<size_t>(1, (1 << 16) / size);
+    auto t = Timing([&]() {
+        for (size_t i = 0; i < loop; ++i)
+            Execute<false>(plan, outReals, outImags, inReals, inImags);
+    }, size >= (1 << 20) ? 2 : 3);
+
+    SCANFFT_FREE(out);
+    SCANFFT_FREE(in);
+    return t;
+}
+
+
+static std::unique_ptr<Plan> CreatePlan(size_t size, bool allowSixStep) {
+    auto useSixStep = allowSixStep && size >= kSixStepMinSize;
+
+    if (gPlannerMode == PlannerMode::Estimate) {
+        if (useSixStep && size >= kSixStepEstimateSize && MaxThreads() > 1) {
+            if (auto plan = CreateSixStepPlan(size, true))
+                return plan;
+        }
+        if (auto plan = CreateDefaultPlan(size))
+            return plan;
+        return CreateMixedRadixPlan(size, true);
+    }
+
+    std::vector<std::unique_ptr<Plan>> candidates;
+    candidates.push_back(CreateDefaultPlan(size));
+    candidates.push_back(CreateMixedRadixPlan(size, true));
+    candidates.push_back(CreateMixedRadixPlan(size, false));
+    if (candidates[1] && candidates[2] && candidates[1]->factors == candidates[2]->factors)
+        candidates[2].reset();
+    if (useSixStep) {
+        candidates.push_back(CreateSixStepPlan(size, false));
+        if (MaxThreads() > 1)
+            candidates.push_back(CreateSixStepPlan(size, true));
+    }
+
+    std::unique_ptr<Plan> best;
+    auto bestTime = std::numeric_limits<double>::max();
+    for (auto &candidate : candidates) {
+        if (!candidate)
+            continue;
+        auto t = MeasurePlan(*candidate);
+        if (t < bestTime) {
+            bestTime = t;
+            best = std::move(candidate);
+        }
+    }
+    return best;
+}
+
+
+static Plan const* GetPlan(size_t size, bool allowSixStep) {
+    std::lock_guard<std::recursive_mutex> lock(gPlansMutex);
+
+    auto key = std::make_pair(size, allowSixStep);
+    auto it = gPlans.find(key);
+    if (it != gPlans.end())
+        return it->second.get();
+
+    auto plan = CreatePlan(size, allowSixStep);
+    assert(plan != nullptr);
+    return (gPlans[key] = std::move(plan)).get();
+}
+
+
+static RealPlan const* GetRealPlan(size_t size) {
+    std::lock_guard<std::recursive_mutex> lock(gPlansMutex);
+
+    auto it = gRealPlans.find(size);
+    if (it != gRealPlans.end())
+        return it->second.get();
+
+    std::unique_ptr<RealPlan> plan(new RealPlan());
+    plan->halfPlan = GetPlan(size / 2, true);
+    SetupRealFFTTwiddles(size, plan->twiddleReals, plan->twiddleImags);
+    return (gRealPlans[size] = std::move(plan)).get();
+}
+
+
+//----------------------------------------------------------------------
+
+void SetupPlanner(size_t log2OfMaxSize) {
+    gLog2OfMaxSize = log2OfMaxSize;
+}
+
+
+void CleanupPlanner() {
+    std::lock_guard<std::recursive_mutex> lock(gPlansMutex);
+    gRealPlans.clear();
+    gPlans.clear();
+}
+
+
+void SetPlannerMode(PlannerMode mode) {
+    gPlannerMode = mode;
+}
+
+
+bool IsSupportedSize(size_t size) {
+    std::vector<uint8_t> factors;
+    return FactorizeMixedRadix(size, true, factors);
+}
+
+
+void TransformN(Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, size_t size) {
+    assert(IsSupportedSize(size));
+    Execute<false>(*GetPlan(size, true), destReals, destImags, srcReals, srcImags);
+}
+
+
+void InverseTransformN(Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, size_t size) {
+    assert(IsSupportedSize(size));
+    Execute<true>(*GetPlan(size, true), destReals, destImags, srcReals, srcImags);
+}
+
+
+void RealTransform(Float *destReals, Float *destImags, Float const *src, size_t size) {
+    assert(size % 2 == 0 && IsSupportedSize(size / 2));
+    auto halfSize = size / 2;
+    auto plan = GetRealPlan(size);
+
+    auto &z = GetScratch(kRealScratch, halfSize);
+    RealFFTDeinterleave(z.reals, z.imags, src, halfSize);
+    Execute<false>(*plan->halfPlan, destReals, destImags, z.reals, z.imags);
+    RealFFTPostProcess(destReals, destImags, plan->twiddleReals, plan->twiddleImags, halfSize);
+}
+
+
+void InverseRealTransform(Float *dest, Float const *srcReals, Float const *srcImags, size_t size) {
+    assert(size % 2 == 0 && IsSupportedSize(size / 2));
+    auto halfSize = size / 2;
+    auto plan = GetRealPlan(size);
+
+    auto &spectrum = GetScratch(kRealScratch, halfSize);
+    auto &z = GetScratch(kRealScratch2, halfSize);
+    RealFFTPreProcess(spectrum.reals, spectrum.imags, srcReals, srcImags, plan->twiddleReals, plan->twiddleImags, halfSize);
+    Execute<true>(*plan->halfPlan, z.reals, z.imags, spectrum.reals, spectrum.imags);
+    RealFFTInterleave(dest, z.reals, z.imags, halfSize);
+}
+
+
+template<bool Inverse>
+static void ExecuteBatch(
+    Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, size_t size, size_t batchCount) {
+    assert(IsSupportedSize(size));
+    auto plan = GetPlan(size, true);
+    // Small batches are not worth waking the other threads for
+    auto threaded = size * batchCount >= kSixStepMinSize;
+
+#pragma omp parallel for if (threaded) schedule(static)
+    for (int i = 0; i < int(batchCount); ++i) {
+        auto offset = i * size;
+        Execute<Inverse>(*plan, destReals + offset, destImags + offset, srcReals + offset, srcImags + offset);
+    }
+}
+
+
+void BatchTransform(Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, size_t size, size_t batchCount) {
+    ExecuteBatch<false>(destReals, destImags, srcReals, srcImags, size, batchCount);
+}
+
+
+void BatchInverseTransform(Float *destReals, Float *destImags, Float const *srcReals, Float const *srcImags, size_t size, size_t batchCount) {
+    ExecuteBatch<true>(destReals, destImags, srcReals, srcImags, size, batchCount);
+}
+
+
+}
@@ -1,6 +1,9 @@
 
 #include <numeric>
 #include <cassert>
+#include <cmath>
+#include <complex>
+#include <vector>
 
 #include <ScanFFT.h>
 
@@ -47,6 +50,139 @@ static void TestFFT() {
     }
 }
 
+#if SCANFFT_SINGLE_PRECISION_FLOAT
+static ScanFFT::Float const kNEpsilon = 1e-2f;
+#else
+static ScanFFT::Float const kNEpsilon = 1e-8;
+#endif
+
+// O(n^2) reference with the library's sign convention, error relative to the largest bin
+static void CheckAgainstDFT(
+    ScanFFT::Float const *outReals, ScanFFT::Float const *outImags,
+    ScanFFT::Float const *inReals, ScanFFT::Float const *inImags, size_t size, size_t count) {
+    using namespace ScanFFT;
+
+    auto const kPi = acos(-1.0);
+    std::vector<std::complex<double>> expected(count);
+    double maxAbs = 1;
+    for (size_t k = 0; k < count; ++k) {
+        for (size_t j = 0; j < size; ++j)
+            expected[k] += std::complex<double>(inReals[j], inImags[j]) * std::polar(1.0, 2 * kPi * double(j * k % size) / double(size));
+        maxAbs = std::max(maxAbs, std::abs(expected[k]));
+    }
+    for (size_t k = 0; k < count; ++k) {
+        if (!FEquals(outReals[k] / maxAbs, expected[k].real() / maxAbs, kNEpsilon) || !FEquals(outImags[k] / maxAbs, expected[k].imag() / maxAbs, kNEpsilon))
+            assert(0);
+    }
+}
+
+static void TestFFTN() {
+    using namespace ScanFFT;
+
+    for (auto mode : { PlannerMode::Estimate, PlannerMode::Measure }) {
+        SetPlannerMode(mode);
+        for (size_t size : { 1, 2, 3, 4, 5, 6, 9, 10, 12, 15, 25, 30, 45, 60, 64, 81, 100, 125, 240, 243, 256, 360, 625, 1000, 1024, 1536, 3000, 20000, 46875, 65536 }) {
+            assert(IsSupportedSize(size));
+            SCANFFT_ALLOC(in, size);
+            SCANFFT_ALLOC(out, size);
+            SCANFFT_ALLOC(out2, size);
+
+            for (size_t i = 0; i < size; ++i) {
+                inReals[i] = Float(i % 7) - 3;
+                inImags[i] = Float(i % 5) * Float(0.5);
+            }
+            SCANFFT_TRANSFORM_N(out, in, size);
+            CheckAgainstDFT(outReals, outImags, inReals, inImags, size, std::min<size_t>(size, 64));
+            SCANFFT_INVERSE_TRANSFORM_N(out2, out, size);
+
+            for (size_t i = 0; i < size; ++i) {
+                if (!FEquals(inReals[i], out2Reals[i], kNEpsilon * 10) || !FEquals(inImags[i], out2Imags[i], kNEpsilon * 10))
+                    assert(0);
+            }
+
+            SCANFFT_FREE(out2);
+            SCANFFT_FREE(out);
+            SCANFFT_FREE(in);
+        }
+        Cleanup();
+        Setup(FFT_LOG2_OF_MAX_SIZE);
+    }
+    assert(!IsSupportedSize(0) && !IsSupportedSize(7) && !IsSupportedSize(2 * 3 * 5 * 11));
+}
+
+static void TestRealFFT() {
+    using namespace ScanFFT;
+
+    for (size_t size : { 2, 4, 6, 8, 10, 18, 30, 64, 96, 250, 1024, 4000, 32768 }) {
+        auto halfSize = size / 2;
+        auto src = Alloc<Float>(size), out = Alloc<Float>(size);
+        SCANFFT_ALLOC(in, size);
+        SCANFFT_ALLOC(expected, size);
+        SCANFFT_ALLOC(spectrum, halfSize + 1);
+
+        for (size_t i = 0; i < size; ++i) {
+            src[i] = inReals[i] = Float(i % 11) - Float(i % 3) * 2;
+            inImags[i] = 0;
+        }
+        SCANFFT_TRANSFORM_N(expected, in, size);
+        RealTransform(spectrumReals, spectrumImags, src, size);
+        for (size_t k = 0; k <= halfSize; ++k) {
+            if (!FEquals(spectrumReals[k], expectedReals[k], kNEpsilon * size) || !FEquals(spectrumImags[k], expectedImags[k], kNEpsilon * size))
+                assert(0);
+        }
+
+        InverseRealTransform(out, spectrumReals, spectrumImags, size);
+        for (size_t i = 0; i < size; ++i) {
+            if (!FEquals(src[i], out[i], kNEpsilon * 10))
+                assert(0);
+        }
+
+        SCANFFT_FREE(spectrum);
+        SCANFFT_FREE(expected);
+        SCANFFT_FREE(in);
+        Free(out);
+        Free(src);
+    }
+}
+
+static void TestBatchFFT() {
+    using namespace ScanFFT;
+
+    for (size_t size : { 2, 4, 8, 12, 16, 60, 256, 1024 }) {
+        size_t const batchCount = 37;
+        SCANFFT_ALLOC(in, size * batchCount);
+        SCANFFT_ALLOC(out, size * batchCount);
+        SCANFFT_ALLOC(out2, size * batchCount);
+        SCANFFT_ALLOC(expected, size);
+
+        for (size_t i = 0; i < size * batchCount; ++i) {
+            inReals[i] = Float(i % 13);
+            inImags[i] = Float(i % 3) - 1;
+        }
+        SCANFFT_BATCH_TRANSFORM(out, in, size, batchCount);
+        SCANFFT_BATCH_INVERSE_TRANSFORM(out2, out, size, batchCount);
+
+        // each transform of the batch has to match TransformN on its own, and the DFT
+        for (size_t b = 0; b < batchCount; ++b) {
+            TransformN(expectedReals, expectedImags, inReals + b * size, inImags + b * size, size);
+            for (size_t k = 0; k < size; ++k) {
+                if (!FEquals(outReals[b * size + k], expectedReals[k], kNEpsilon * size) || !FEquals(outImags[b * size + k], expectedImags[k], kNEpsilon * size))
+                    assert(0);
+            }
+            CheckAgainstDFT(outReals + b * size, outImags + b * size, inReals + b * size, inImags + b * size, size, size);
+        }
+        for (size_t i = 0; i < size * batchCount; ++i) {
+            if (!FEquals(inReals[i], out2Reals[i], kNEpsilon * 10) || !FEquals(inImags[i], out2Imags[i], kNEpsilon * 10))
+                assert(0);
+        }
+
+        SCANFFT_FREE(expected);
+        SCANFFT_FREE(out2);
+        SCANFFT_FREE(out);
+        SCANFFT_FREE(in);
+    }
+}
+
 static void BenchmarkFFT() {
     using namespace ScanFFT;
 
@@ -70,6 +206,63 @@ static void BenchmarkFFT() {
     }
 }
 
+static void BenchmarkFFTN() {
+    using namespace ScanFFT;
+
+    // Plans are measured on the first call, so every size is run once before timing
+    puts("\nScanFFT mixed radix / real / batch\n");
+    for (size_t size : { 60, 1000, 3 * 1024, 2 * 15625, 1 << 16, 3 * 5 * (1 << 14), 1 << 20, 3 * 5 * 5 * (1 << 16) }) {
+        if (size > (1ULL << FFT_LOG2_OF_MAX_SIZE))
+            continue;
+        SCANFFT_ALLOC(in, size);
+        std::iota(inReals, inReals + size, Float(0));
+        std::fill(inImags, inImags + size, Float(0));
+        SCANFFT_ALLOC(out, size);
+
+        auto loop = std::max<size_t>(1, (1ULL << FFT_LOG2_OF_MAX_SIZE) / size / 16);
+        TransformN(outReals, outImags, inReals, inImags, size);
+        auto complexTime = Timing([&]()
+        {
+            for (size_t i = 0; i < loop; ++i)
+                TransformN(outReals, outImags, inReals, inImags, size);
+        }) * 1000000 / loop;
+        RealTransform(outReals, outImags, inReals, size);
+        auto realTime = Timing([&]()
+        {
+            for (size_t i = 0; i < loop; ++i)
+                RealTransform(outReals, outImags, inReals, size);
+        }) * 1000000 / loop;
+        printf("\t%d: complex %f us, real %f us\n", int(size), complexTime, realTime);
+
+        SCANFFT_FREE(out);
+        SCANFFT_FREE(in);
+    }
+
+    for (size_t size : { 16, 64, 256 }) {
+        auto batchCount = (1ULL << FFT_LOG2_OF_MAX_SIZE) / 16 / size;
+        SCANFFT_ALLOC(in, size * batchCount);
+        std::iota(inReals, inReals + size * batchCount, Float(0));
+        std::fill(inImags, inImags + size * batchCount, Float(0));
+        SCANFFT_ALLOC(out, size * batchCount);
+
+        auto log2OfSize = uint8_t(log2(double(size)));
+        auto loopTime = Timing([&]()
+        {
+            for (size_t i = 0; i < batchCount; ++i)
+                Transform(outReals + i * size, outImags + i * size, inReals + i * size, inImags + i * size, log2OfSize);
+        });
+        SCANFFT_BATCH_TRANSFORM(out, in, size, batchCount);
+        auto batchTime = Timing([&]()
+        {
+            SCANFFT_BATCH_TRANSFORM(out, in, size, batchCount);
+        });
+        printf("\t%d x %d: loop %f us, batch %f us\n", int(batchCount), int(size), loopTime * 1000000, batchTime * 1000000);
+
+        SCANFFT_FREE(out);
+        SCANFFT_FREE(in);
+    }
+}
+
 //----------------------------------------------------------------------
 
 int main()
@@ -77,8 +270,12 @@ int main()
     ScanFFT::Setup(FFT_LOG2_OF_MAX_SIZE);
 
     TestFFT();
+    TestFFTN();
+    TestRealFFT();
+    TestBatchFFT();
 #ifdef NDEBUG
     BenchmarkFFT();
+    BenchmarkFFTN();
 #endif
 
     ScanFFT::Cleanup();
@@ -53,13 +53,15 @@ struct ASTNode_Lambda: public IASTNode {
     int formalCount;
     vector<string> locals;
     ASTNodePtr body;
+    // false if no closure can capture the env of a call
+    bool envEscapes;
 
     ASTNode_Lambda(int _formalCount, const vector<string> &_locals, ASTNodePtr _body):
-        formalCount(_formalCount), locals(_locals), body(_body) {
+        formalCount(_formalCount), locals(_locals), body(_body), envEscapes(true) {
     }
 
     ASTNode_Lambda(int _formalCount, vector<string> &&_locals, ASTNodePtr _body):
-        formalCount(_formalCount), locals(_locals), body(_body) {
+        formalCount(_formalCount), locals(_locals), body(_body), envEscapes(true) {
     }
 
     virtual void acceptVisitor(IASTVisitor *v) { v->visit(this); }
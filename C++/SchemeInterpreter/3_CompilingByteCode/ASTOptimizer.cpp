@@ -0,0 +1,545 @@
+#include "pch.h"
+#include "ASTOptimizer.h"
+#include "STypes.h"
+#include "SStack.h"
+
+static const int INLINE_NODE_LIMIT = 32;
+static const int INLINE_DEPTH_LIMIT = 4;
+static const int VOID_LITERAL_INDEX = 0;
+
+static int getLiteralIndex(vector<SValue> *literals, SValue exp) {
+    auto iter = find_if(literals->begin(), literals->end(), [exp](SValue lit){ return lit.equal(exp); });
+    if (iter == literals->end()) {
+        iter = literals->insert(literals->end(), exp);
+    }
+    return int(iter - literals->begin());
+}
+
+static VarAddress createAddress(int envIndex, int varIndex) {
+    return envIndex == 0 ? VarAddress::createLocal(varIndex) : VarAddress::createFree(envIndex, varIndex);
+}
+
+static int getEnvIndex(VarAddress address) {
+    return address.isLocal() ? 0 : address.getEnvIndex();
+}
+
+//----------------------------------------------------------------------
+// Walks the body of a lambda, counting the accesses to the vars of the env which is 'baseDepth' levels above it
+class ASTNodeVisitor_VarUsage: public IASTVisitor {
+public:
+    vector<int> reads;
+    vector<int> writes;
+    int nodeCount;
+    bool hasLambda;
+
+    ASTNodeVisitor_VarUsage(int varCount, int baseDepth, IASTNode *body):
+        reads(varCount, 0), writes(varCount, 0), nodeCount(0), hasLambda(false), mDepth(baseDepth) {
+        body->acceptVisitor(this);
+    }
+
+    virtual void visit(ASTNode_Literal *node) {
+        ++nodeCount;
+    }
+
+    virtual void visit(ASTNode_If *node) {
+        ++nodeCount;
+        node->predNode->acceptVisitor(this);
+        node->thenNode->acceptVisitor(this);
+        node->elseNode->acceptVisitor(this);
+    }
+
+    virtual void visit(ASTNode_Lambda *node) {
+        ++nodeCount;
+        hasLambda = true;
+        ++mDepth;
+        node->body->acceptVisitor(this);
+        --mDepth;
+    }
+
+    virtual void visit(ASTNode_Begin *node) {
+        ++nodeCount;
+        for (auto &n : node->nodes) n->acceptVisitor(this);
+    }
+
+    virtual void visit(ASTNode_GetVar *node) {
+        ++nodeCount;
+        if (isTarget(node->address)) ++reads[node->address.getVarIndex()];
+    }
+
+    virtual void visit(ASTNode_SetVar *node) {
+        ++nodeCount;
+        if (isTarget(node->address)) ++writes[node->address.getVarIndex()];
+        node->rightNode->acceptVisitor(this);
+    }
+
+    virtual void visit(ASTNode_Application *node) {
+        ++nodeCount;
+        node->func->acceptVisitor(this);
+        for (auto &n : node->actuals) n->acceptVisitor(this);
+    }
+
+private:
+    bool isTarget(VarAddress address) const {
+        return !address.isGlobal() && getEnvIndex(address) == mDepth;
+    }
+
+private:
+    int mDepth;
+};
+
+//----------------------------------------------------------------------
+// Script redefining a primitive turns off folding of it from now on
+class ASTNodeVisitor_PrimitiveRedefinition: public IASTVisitor {
+public:
+    ASTNodeVisitor_PrimitiveRedefinition(vector<ASTPrimitiveInfo> *primitives, IASTNode *body):
+        mPrimitives(primitives) {
+        body->acceptVisitor(this);
+    }
+
+    virtual void visit(ASTNode_Literal *node) {
+    }
+
+    virtual void visit(ASTNode_If *node) {
+        node->predNode->acceptVisitor(this);
+        node->thenNode->acceptVisitor(this);
+        node->elseNode->acceptVisitor(this);
+    }
+
+    virtual void visit(ASTNode_Lambda *node) {
+        node->body->acceptVisitor(this);
+    }
+
+    virtual void visit(ASTNode_Begin *node) {
+        for (auto &n : node->nodes) n->acceptVisitor(this);
+    }
+
+    virtual void visit(ASTNode_GetVar *node) {
+    }
+
+    virtual void visit(ASTNode_SetVar *node) {
+        int index = node->address.getVarIndex();
+        if (node->address.isGlobal() && index < (int)mPrimitives->size()) {
+            // forgetRedefinedPrimitives has seen the rest, this is code built by eval at run time
+            if ((*mPrimitives)[index].folded) {
+                throw AssertFailedException("eval can't redefine a primitive folded into compiled code");
+            }
+            (*mPrimitives)[index].kind = APK_None;
+        }
+        node->rightNode->acceptVisitor(this);
+    }
+
+    virtual void visit(ASTNode_Application *node) {
+        node->func->acceptVisitor(this);
+        for (auto &n : node->actuals) n->acceptVisitor(this);
+    }
+
+private:
+    vector<ASTPrimitiveInfo> *mPrimitives;
+};
+
+//----------------------------------------------------------------------
+// Copies the body of a lambda which is inlined into its parent, whose new locals start from 'localOffset'
+class ASTNodeVisitor_InlineCloner: public IASTVisitor {
+public:
+    ASTNodeVisitor_InlineCloner(int localOffset):
+        mLocalOffset(localOffset), mDepth(0) {
+    }
+
+    ASTNodePtr clone(ASTNodePtr node) {
+        node->acceptVisitor(this);
+        return mResult;
+    }
+
+    virtual void visit(ASTNode_Literal *node) {
+        mResult = make_shared<ASTNode_Literal>(node->index);
+    }
+
+    virtual void visit(ASTNode_If *node) {
+        auto predNode = clone(node->predNode);
+        auto thenNode = clone(node->thenNode);
+        auto elseNode = clone(node->elseNode);
+        mResult = make_shared<ASTNode_If>(predNode, thenNode, elseNode);
+    }
+
+    virtual void visit(ASTNode_Lambda *node) {
+        ++mDepth;
+        auto body = clone(node->body);
+        --mDepth;
+
+        auto lambda = make_shared<ASTNode_Lambda>(node->formalCount, node->locals, body);
+        lambda->envEscapes = node->envEscapes;
+        mResult = lambda;
+    }
+
+    virtual void visit(ASTNode_Begin *node) {
+        auto beginNode = make_shared<ASTNode_Begin>();
+        for (auto &n : node->nodes) beginNode->nodes.push_back(clone(n));
+        mResult = beginNode;
+    }
+
+    virtual void visit(ASTNode_GetVar *node) {
+        mResult = make_shared<ASTNode_GetVar>(remap(node->address));
+    }
+
+    virtual void visit(ASTNode_SetVar *node) {
+        auto rightNode = clone(node->rightNode);
+        mResult = make_shared<ASTNode_SetVar>(remap(node->address), rightNode);
+    }
+
+    virtual void visit(ASTNode_Application *node) {
+        auto func = clone(node->func);
+        vector<ASTNodePtr> actuals;
+        for (auto &n : node->actuals) actuals.push_back(clone(n));
+        mResult = make_shared<ASTNode_Application>(func, move(actuals));
+    }
+
+private:
+    VarAddress remap(VarAddress address) const {
+        if (address.isGlobal()) return address;
+
+        int envIndex = getEnvIndex(address);
+        if (envIndex == mDepth) {
+            // the inlined lambda's own env is merged into the parent
+            return createAddress(envIndex, address.getVarIndex() + mLocalOffset);
+        } else if (envIndex > mDepth) {
+            return createAddress(envIndex - 1, address.getVarIndex());
+        } else {
+            return address;
+        }
+    }
+
+private:
+    int mLocalOffset;
+    int mDepth;
+    ASTNodePtr mResult;
+};
+
+//----------------------------------------------------------------------
+class ASTNodeVisitor_Optimizer: public IASTVisitor {
+public:
+    ASTNodeVisitor_Optimizer(ASTOptimizerContext *ctx, ASTNode_Lambda *lambda):
+        mCtx(ctx), mLambda(lambda), mRemovedStores(0), mInlineDepth(0) {
+
+        {
+            ASTNodeVisitor_VarUsage usage((int)mLambda->locals.size(), 0, mLambda->body.get());
+            mWrites = usage.writes;
+        }
+        mKnownLambdas.resize(mLambda->locals.size());
+
+        mLambda->body = optimize(mLambda->body);
+
+        eliminateDeadStores();
+
+        ASTNodeVisitor_VarUsage usage((int)mLambda->locals.size(), 0, mLambda->body.get());
+        // nothing but a closure can hold the env after return
+        mLambda->envEscapes = usage.hasLambda;
+    }
+
+    virtual void visit(ASTNode_Literal *node) {
+    }
+
+    virtual void visit(ASTNode_If *node) {
+        node->predNode = optimize(node->predNode);
+
+        if (auto lit = dynamic_cast<ASTNode_Literal*>(node->predNode.get())) {
+            mResult = optimize((*mCtx->literals)[lit->index] == SValue::TRUE ? node->thenNode : node->elseNode);
+            return;
+        }
+
+        node->thenNode = optimize(node->thenNode);
+        node->elseNode = optimize(node->elseNode);
+    }
+
+    virtual void visit(ASTNode_Lambda *node) {
+        ASTNodeVisitor_Optimizer optimizer(mCtx, node);
+    }
+
+    virtual void visit(ASTNode_Begin *node) {
+        auto knownLambdas = mKnownLambdas;
+
+        vector<ASTNodePtr> nodes;
+        for (auto &n : node->nodes) {
+            ASTNodePtr newNode = optimize(n);
+
+            if (auto setNode = dynamic_cast<ASTNode_SetVar*>(newNode.get())) {
+                int index = setNode->address.getVarIndex();
+                if (setNode->address.isLocal() && mWrites[index] == 1 && dynamic_cast<ASTNode_Lambda*>(setNode->rightNode.get())) {
+                    mKnownLambdas[index] = setNode->rightNode;
+                }
+            }
+
+            appendStatement(&nodes, newNode);
+        }
+
+        // a define inside the block doesn't dominate the code after it
+        mKnownLambdas = knownLambdas;
+
+        mResult = makeSequence(move(nodes));
+    }
+
+    virtual void visit(ASTNode_GetVar *node) {
+        auto primitive = getPrimitive(node->address);
+        if (primitive != nullptr && primitive->kind == APK_Constant) {
+            primitive->folded = true;
+            mResult = make_shared<ASTNode_Literal>(getLiteralIndex(mCtx->literals, (*mCtx->globals)[node->address.getVarIndex()]));
+        }
+    }
+
+    virtual void visit(ASTNode_SetVar *node) {
+        node->rightNode = optimize(node->rightNode);
+    }
+
+    virtual void visit(ASTNode_Application *node) {
+        node->func = optimize(node->func);
+        for (auto &n : node->actuals) n = optimize(n);
+
+        if (auto getNode = dynamic_cast<ASTNode_GetVar*>(node->func.get())) {
+            if (getNode->address.isGlobal()) {
+                tryFold(getNode, node->actuals);
+            } else if (getNode->address.isLocal()) {
+                auto callee = static_cast<ASTNode_Lambda*>(mKnownLambdas[getNode->address.getVarIndex()].get());
+                if (callee != nullptr && isInlinable(callee, getNode->address.getVarIndex(), (int)node->actuals.size())) {
+                    mResult = inlineLambda(callee, node->actuals);
+                }
+            }
+        } else if (auto callee = dynamic_cast<ASTNode_Lambda*>(node->func.get())) {
+            // ((lambda (a b) ...) x y), the lambda is used only once, so move it without size limit
+            if (callee->formalCount == (int)node->actuals.size()) {
+                mResult = inlineLambda(callee, node->actuals);
+            }
+        }
+    }
+
+private:
+    // a visit leaves the replacement of the node in mResult, or nullptr to keep it
+    ASTNodePtr optimize(ASTNodePtr node) {
+        mResult = nullptr;
+        node->acceptVisitor(this);
+
+        ASTNodePtr result = mResult != nullptr ? mResult : node;
+        mResult = nullptr;
+        return result;
+    }
+
+    ASTPrimitiveInfo* getPrimitive(VarAddress address) const {
+        if (!address.isGlobal() || address.getVarIndex() >= (int)mCtx->primitives->size()) return nullptr;
+        auto primitive = &(*mCtx->primitives)[address.getVarIndex()];
+        return primitive->kind == APK_None ? nullptr : primitive;
+    }
+
+    void tryFold(ASTNode_GetVar *funcNode, const vector<ASTNodePtr> &actuals) {
+        auto primitive = getPrimitive(funcNode->address);
+        if (primitive == nullptr || primitive->kind == APK_Constant || primitive->arity != (int)actuals.size()) return;
+
+        SValue f = (*mCtx->globals)[funcNode->address.getVarIndex()];
+        if (f.getType() != SCFunction::TYPE) return;
+
+        vector<int> literalIndices;
+        for (int i = 0; i < (int)actuals.size(); ++i) {
+            auto lit = dynamic_cast<ASTNode_Literal*>(actuals[i].get());
+            if (lit == nullptr) return;
+
+            SValue v = (*mCtx->literals)[lit->index];
+            int type = v.getType();
+            bool isNumber = type == SVT_Int || type == SDouble::TYPE || type == SBigInt::TYPE;
+            switch (primitive->kind) {
+                case APK_Pure:
+                    break;
+                case APK_Numeric:
+                    if (!isNumber) return;
+                    break;
+                case APK_Division:
+                    if (!isNumber) return;
+                    if (i == 1 && (type != SVT_Int || v.getInt() == 0)) return;
+                    break;
+                default:
+                    ASSERT(0);
+                    break;
+            }
+
+            literalIndices.push_back(lit->index);
+        }
+
+        // evaluate it just like the ByteCode_Call does
+        auto estack = mCtx->evalStack;
+        estack->push(f);
+        for (auto index : literalIndices) estack->push((*mCtx->literals)[index]);
+        f.getExternalObject()->staticCast<SCFunction>()->func(mCtx->objMgr, estack, (int)literalIndices.size());
+        estack->pop((int)literalIndices.size());
+
+        primitive->folded = true;
+        mResult = make_shared<ASTNode_Literal>(getLiteralIndex(mCtx->literals, estack->pop()));
+    }
+
+    bool isInlinable(ASTNode_Lambda *callee, int varIndex, int actualCount) const {
+        if (callee->formalCount != actualCount || mInlineDepth >= INLINE_DEPTH_LIMIT) return false;
+
+        ASTNodeVisitor_VarUsage usage((int)mLambda->locals.size(), 1, callee->body.get());
+        // recursion can't be unrolled
+        return usage.nodeCount <= INLINE_NODE_LIMIT && usage.reads[varIndex] == 0;
+    }
+
+    ASTNodePtr inlineLambda(ASTNode_Lambda *callee, const vector<ASTNodePtr> &actuals) {
+        int localOffset = (int)mLambda->locals.size();
+        mLambda->locals.insert(mLambda->locals.end(), callee->locals.begin(), callee->locals.end());
+        mWrites.resize(mLambda->locals.size(), 1);
+        mKnownLambdas.resize(mLambda->locals.size());
+
+        vector<ASTNodePtr> nodes;
+        for (int i = 0; i < (int)actuals.size(); ++i) {
+            nodes.push_back(make_shared<ASTNode_SetVar>(VarAddress::createLocal(localOffset + i), actuals[i]));
+        }
+
+        ASTNodeVisitor_InlineCloner cloner(localOffset);
+        appendStatement(&nodes, cloner.clone(callee->body));
+
+        // the body may fold further in its new context
+        ++mInlineDepth;
+        ASTNodePtr result = optimize(makeSequence(move(nodes)));
+        --mInlineDepth;
+        return result;
+    }
+
+    void eliminateDeadStores() {
+        // removing a store may make the vars read by its value dead too
+        for (;;) {
+            ASTNodeVisitor_VarUsage usage((int)mLambda->locals.size(), 0, mLambda->body.get());
+            mReads = usage.reads;
+
+            mRemovedStores = 0;
+            mLambda->body = removeDeadStores(mLambda->body);
+            if (mRemovedStores == 0) break;
+        }
+    }
+
+    ASTNodePtr removeDeadStores(ASTNodePtr node) {
+        if (auto setNode = dynamic_cast<ASTNode_SetVar*>(node.get())) {
+            setNode->rightNode = removeDeadStores(setNode->rightNode);
+            if (setNode->address.isLocal() && mReads[setNode->address.getVarIndex()] == 0) {
+                ++mRemovedStores;
+                vector<ASTNodePtr> nodes;
+                appendStatement(&nodes, setNode->rightNode);
+                appendStatement(&nodes, make_shared<ASTNode_Literal>(VOID_LITERAL_INDEX));
+                return makeSequence(move(nodes));
+            }
+        } else if (auto beginNode = dynamic_cast<ASTNode_Begin*>(node.get())) {
+            vector<ASTNodePtr> nodes;
+            for (auto &n : beginNode->nodes) appendStatement(&nodes, removeDeadStores(n));
+            return makeSequence(move(nodes));
+        } else if (auto ifNode = dynamic_cast<ASTNode_If*>(node.get())) {
+            ifNode->predNode = removeDeadStores(ifNode->predNode);
+            ifNode->thenNode = removeDeadStores(ifNode->thenNode);
+            ifNode->elseNode = removeDeadStores(ifNode->elseNode);
+        } else if (auto appNode = dynamic_cast<ASTNode_Application*>(node.get())) {
+            appNode->func = removeDeadStores(appNode->func);
+            for (auto &n : appNode->actuals) n = removeDeadStores(n);
+        }
+        return node;
+    }
+
+    // evaluating these nodes has no side effect
+    bool isPure(IASTNode *node) const {
+        if (dynamic_cast<ASTNode_Literal*>(node) != nullptr
+                || dynamic_cast<ASTNode_GetVar*>(node) != nullptr
+                || dynamic_cast<ASTNode_Lambda*>(node) != nullptr) {
+            return true;
+        }
+
+        if (auto appNode = dynamic_cast<ASTNode_Application*>(node)) {
+            auto getNode = dynamic_cast<ASTNode_GetVar*>(appNode->func.get());
+            auto primitive = getNode != nullptr ? getPrimitive(getNode->address) : nullptr;
+            if (primitive == nullptr || primitive->kind == APK_Constant || primitive->arity != (int)appNode->actuals.size()) return false;
+            // dropping a division that may divide by zero would drop its runtime error
+            if (primitive->kind == APK_Division) {
+                auto lit = dynamic_cast<ASTNode_Literal*>(appNode->actuals[1].get());
+                if (lit == nullptr) return false;
+                SValue v = (*mCtx->literals)[lit->index];
+                if (v.getType() != SVT_Int || v.getInt() == 0) return false;
+            }
+
+            return all_of(appNode->actuals.begin(), appNode->actuals.end(), [this](ASTNodePtr n){ return isPure(n.get()); });
+        }
+
+        return false;
+    }
+
+    // flattens nested blocks, and drops the pure statements whose value is discarded
+    void appendStatement(vector<ASTNodePtr> *nodes, ASTNodePtr node) {
+        if (!nodes->empty() && isPure(nodes->back().get())) {
+            nodes->pop_back();
+        }
+
+        if (auto beginNode = dynamic_cast<ASTNode_Begin*>(node.get())) {
+            for (auto &n : beginNode->nodes) appendStatement(nodes, n);
+        } else {
+            nodes->push_back(node);
+        }
+    }
+
+    static ASTNodePtr makeSequence(vector<ASTNodePtr> &&nodes) {
+        ASSERT(!nodes.empty());
+        if (nodes.size() == 1) return nodes[0];
+
+        auto beginNode = make_shared<ASTNode_Begin>();
+        beginNode->nodes = move(nodes);
+        return beginNode;
+    }
+
+private:
+    ASTOptimizerContext *mCtx;
+    ASTNode_Lambda *mLambda;
+    ASTNodePtr mResult;
+    vector<int> mWrites;
+    vector<int> mReads;
+    int mRemovedStores;
+    vector<ASTNodePtr> mKnownLambdas;
+    int mInlineDepth;
+};
+
+void optimizeAST(ASTOptimizerContext *ctx, ASTNode_Lambda *lambda) {
+    ASTNodeVisitor_PrimitiveRedefinition redefinition(ctx->primitives, lambda->body.get());
+    ASTNodeVisitor_Optimizer optimizer(ctx, lambda);
+}
+
+static void findRedefinitions(SValue exp, unordered_set<string> *names, bool *usesEval) {
+    if (exp.getType() == SVT_Symbol) {
+        if (strcmp(exp.getSymbol()->c_str(), "eval") == 0) *usesEval = true;
+        return;
+    }
+    if (exp.getType() != SPair::TYPE) return;
+
+    SPair *pair = exp.getObject()->staticCast<SPair>();
+    if (pair->car.getType() == SVT_Symbol && pair->cdr.getType() == SPair::TYPE) {
+        int formID = pair->car.getSymbol()->getID();
+        if (formID == SSymbol::ID_Define || formID == SSymbol::ID_Set) {
+            SValue target = pair->cdr.getObject()->staticCast<SPair>()->car;
+            // (define (name args...) body)
+            if (target.getType() == SPair::TYPE) target = target.getObject()->staticCast<SPair>()->car;
+            if (target.getType() == SVT_Symbol) names->insert(target.getSymbol()->c_str());
+        }
+    }
+
+    for (; exp.getType() == SPair::TYPE; exp = exp.getObject()->staticCast<SPair>()->cdr) {
+        findRedefinitions(exp.getObject()->staticCast<SPair>()->car, names, usesEval);
+    }
+    findRedefinitions(exp, names, usesEval);
+}
+
+void forgetRedefinedPrimitives(ASTOptimizerContext *ctx, SymbolTable *symTable, SValue program) {
+    unordered_set<string> names;
+    bool usesEval = false;
+    findRedefinitions(program, &names, &usesEval);
+
+    for (int index = 0; index < (int)ctx->primitives->size(); ++index) {
+        auto &primitive = (*ctx->primitives)[index];
+        if (primitive.kind == APK_None) continue;
+
+        string name = symTable->getSymbolByIndex(index);
+        if (names.count(name) && primitive.folded) {
+            throw AssertFailedException(format("%s is folded into code compiled by an earlier program, it can't be redefined", name.c_str()));
+        }
+        if (usesEval || names.count(name)) {
+            primitive.kind = APK_None;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef ASTOPTIMIZER_H
+#define ASTOPTIMIZER_H
+
+#include "AST.h"
+#include "SValue.h"
+
+class SObjectManager;
+class SEvalStack;
+
+enum ASTPrimitiveKind {
+    APK_None,
+    APK_Constant,   // a global holding a constant, e.g. true, empty
+    APK_Pure,       // a side effect free cfunction of any literals
+    APK_Numeric,    // a side effect free cfunction of numbers
+    APK_Division,   // like APK_Numeric, but the divisor must be a nonzero int
+};
+
+struct ASTPrimitiveInfo {
+    int kind;
+    int arity;
+    // compiled code has a call of it folded, or its value inlined
+    bool folded;
+};
+
+struct ASTOptimizerContext {
+    SObjectManager *objMgr;
+    SEvalStack *evalStack;
+    vector<SValue> *globals;
+    vector<SValue> *literals;
+    // indexed by global index, a primitive is forgotten once a script redefines it
+    vector<ASTPrimitiveInfo> *primitives;
+};
+
+// constant folding, inlining of small known lambdas, dead store elimination and env escape analysis
+void optimizeAST(ASTOptimizerContext *ctx, ASTNode_Lambda *lambda);
+
+// Called with a whole program before any form of it runs: a primitive the program may redefine
+// (any define or set! of its name, even a local or quoted one) is never folded, and neither is any
+// primitive if the program uses eval, since code folded earlier would keep the old definition.
+void forgetRedefinedPrimitives(ASTOptimizerContext *ctx, SymbolTable *symTable, SValue program);
+
+#endif
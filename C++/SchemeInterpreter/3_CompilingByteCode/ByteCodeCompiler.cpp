@@ -13,6 +13,7 @@ public:
         mProto = make_shared<SScriptFunctionProto>(parent);
         mProto->formalCount = lambda->formalCount;
         mProto->locals = lambda->locals;
+        mProto->envEscapes = lambda->envEscapes;
 
         mTailFlags.push_back(true);
         lambda->body->acceptVisitor(this);
@@ -54,10 +55,14 @@ public:
     virtual void visit(ASTNode_Begin *node) {
         for (int i = 0; i < (int)node->nodes.size() - 1; ++i) {
             mTailFlags.push_back(false);
-            node->nodes[i]->acceptVisitor(this);
+            if (auto setNode = dynamic_cast<ASTNode_SetVar*>(node->nodes[i].get())) {
+                // the value of a set is discarded, don't push it
+                emitSetVar(setNode);
+            } else {
+                node->nodes[i]->acceptVisitor(this);
+                emit(ByteCode_Pop());
+            }
             mTailFlags.pop_back();
-
-            emit(ByteCode_Pop());
         }
 
         mTailFlags.push_back(true);
@@ -78,20 +83,7 @@ public:
     }
 
     virtual void visit(ASTNode_SetVar *node) {
-        mTailFlags.push_back(false);
-        node->rightNode->acceptVisitor(this);
-        mTailFlags.pop_back();
-
-        if (node->address.isLocal()) {
-            emit(ByteCode_StoreLocal(node->address.getVarIndex()));
-        } else if (node->address.isFree()) {
-            int freeIndex = getFreeIndex(node->address);
-            emit(ByteCode_StoreFree(freeIndex));
-        } else {
-            ASSERT(node->address.isGlobal());
-            emit(ByteCode_StoreGlobal(node->address.getVarIndex()));
-        }
-
+        emitSetVar(node);
         emit(ByteCode_LoadLiteral(0));
     }
 
@@ -114,6 +106,22 @@ public:
     }
 
 private:
+    void emitSetVar(ASTNode_SetVar *node) {
+        mTailFlags.push_back(false);
+        node->rightNode->acceptVisitor(this);
+        mTailFlags.pop_back();
+
+        if (node->address.isLocal()) {
+            emit(ByteCode_StoreLocal(node->address.getVarIndex()));
+        } else if (node->address.isFree()) {
+            int freeIndex = getFreeIndex(node->address);
+            emit(ByteCode_StoreFree(freeIndex));
+        } else {
+            ASSERT(node->address.isGlobal());
+            emit(ByteCode_StoreGlobal(node->address.getVarIndex()));
+        }
+    }
+
     template<typename ByteCodeT>
     void emit(ByteCodeT v) {
         int off = preEmit<ByteCodeT>();
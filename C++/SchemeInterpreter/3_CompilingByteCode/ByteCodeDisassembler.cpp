@@ -123,3 +123,61 @@ void disassembleByteCode(
 
     so.flush();
 }
+
+int countByteCodeInstructions(
+        const SScriptFunctionProto *proto,
+        const vector<SScriptFunctionProtoPtr> &protos) {
+
+    int count = 0;
+
+    const uint8_t *bytes = &proto->bytes[0];
+    for (int i = 0; i < (int)proto->bytes.size(); ++count) {
+        switch (bytes[i]) {
+            case ByteCode_LoadLiteral::CODE:
+                i += sizeof(ByteCode_LoadLiteral);
+                break;
+            case ByteCode_LoadLocal::CODE:
+                i += sizeof(ByteCode_LoadLocal);
+                break;
+            case ByteCode_StoreLocal::CODE:
+                i += sizeof(ByteCode_StoreLocal);
+                break;
+            case ByteCode_LoadGlobal::CODE:
+                i += sizeof(ByteCode_LoadGlobal);
+                break;
+            case ByteCode_StoreGlobal::CODE:
+                i += sizeof(ByteCode_StoreGlobal);
+                break;
+            case ByteCode_LoadFree::CODE:
+                i += sizeof(ByteCode_LoadFree);
+                break;
+            case ByteCode_StoreFree::CODE:
+                i += sizeof(ByteCode_StoreFree);
+                break;
+            case ByteCode_LoadLambda::CODE:
+                count += countByteCodeInstructions(protos[static_cast<const ByteCode_LoadLambda*>((void*)&bytes[i])->protoIndex].get(), protos);
+                i += sizeof(ByteCode_LoadLambda);
+                break;
+            case ByteCode_Jmp::CODE:
+                i += sizeof(ByteCode_Jmp);
+                break;
+            case ByteCode_TrueJmp::CODE:
+                i += sizeof(ByteCode_TrueJmp);
+                break;
+            case ByteCode_Tail::CODE:
+                i += sizeof(ByteCode_Tail);
+                break;
+            case ByteCode_Call::CODE:
+                i += sizeof(ByteCode_Call);
+                break;
+            case ByteCode_Pop::CODE:
+                i += sizeof(ByteCode_Pop);
+                break;
+            default:
+                ASSERT(0);
+                break;
+        }
+    }
+
+    return count;
+}
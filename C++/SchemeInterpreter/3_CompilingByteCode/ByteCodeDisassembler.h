@@ -13,4 +13,9 @@ void disassembleByteCode(
         const vector<SValue> &literals, 
         int indent = 0);
 
+// instructions of proto and all lambdas loaded by it
+int countByteCodeInstructions(
+        const SScriptFunctionProto *proto,
+        const vector<SScriptFunctionProtoPtr> &protos);
+
 #endif
@@ -15,7 +15,13 @@ static void setupFrame(
     frame->func = estack->top(-actualCount - 1).getObject()->staticCast<SScriptFunction>();
     auto proto = frame->func->proto;
     int localCount = (int)proto->locals.size();
-    frame->localEnv = objMgr->createEnv(ScopedValue<SObject*>(frame->func->env), localCount);
+    frame->localEnv = nullptr;
+    if (!proto->envEscapes) {
+        frame->localEnv = objMgr->pushStackEnv(ScopedValue<SObject*>(frame->func->env), localCount);
+    }
+    if (frame->localEnv == nullptr) {
+        frame->localEnv = objMgr->createEnv(ScopedValue<SObject*>(frame->func->env), localCount);
+    }
 
     ASSERT(actualCount == proto->formalCount && "Argument count mistmatch");
     for (int i = 0; i < actualCount; ++i) {
@@ -28,8 +34,17 @@ static void setupFrame(
     estack->pop(actualCount + 1);
 }
 
-void executeByteCode(
-        int actualCount,
+static void popFrame(SFrameStack *fstack, SObjectManager *objMgr) {
+    SEnv *env = fstack->top()->localEnv;
+    if (objMgr->isStackEnv(env)) {
+        objMgr->popStackEnv(env);
+    }
+
+    fstack->pop();
+}
+
+static void runFrames(
+        int frameOff,
         SEvalStack *estack,
         SFrameStack *fstack,
         SObjectManager *objMgr,
@@ -37,10 +52,6 @@ void executeByteCode(
         vector<SValue> *literals,
         vector<SScriptFunctionProtoPtr> *protos) {
 
-    int frameOff = fstack->size();
-
-    setupFrame(actualCount, estack, fstack, objMgr);
-
 Label_PeekFrame:
     while (fstack->size() > frameOff) {
         // every pointer here will not be redirect after compaction GC
@@ -62,9 +73,12 @@ Label_PeekFrame:
                     estack->push(frame->localEnv->getLocal(static_cast<ByteCode_LoadLocal*>((void*)&bytes[pc])->localIndex));
                     pc += sizeof(ByteCode_LoadLocal);
                     break;
-                case ByteCode_StoreLocal::CODE:
-                    frame->localEnv->setLocal(static_cast<ByteCode_StoreLocal*>((void*)&bytes[pc])->localIndex, estack->pop());
+                case ByteCode_StoreLocal::CODE: {
+                    SValue *slot = frame->localEnv->getLocalAddress(static_cast<ByteCode_StoreLocal*>((void*)&bytes[pc])->localIndex);
+                    *slot = estack->pop();
+                    objMgr->writeBarrier(slot);
                     pc += sizeof(ByteCode_StoreLocal);
+                  }
                     break;
                 case ByteCode_LoadGlobal::CODE:
                     estack->push(pGlobals[static_cast<ByteCode_LoadGlobal*>((void*)&bytes[pc])->globalIndex]);
@@ -78,9 +92,12 @@ Label_PeekFrame:
                     estack->push(frame->func->getFree(static_cast<ByteCode_LoadFree*>((void*)&bytes[pc])->freeIndex));
                     pc += sizeof(ByteCode_LoadFree);
                     break;
-                case ByteCode_StoreFree::CODE:
-                    frame->func->setFree(static_cast<ByteCode_StoreFree*>((void*)&bytes[pc])->freeIndex, estack->pop());
+                case ByteCode_StoreFree::CODE: {
+                    SValue *slot = frame->func->getFreeAddress(static_cast<ByteCode_StoreFree*>((void*)&bytes[pc])->freeIndex);
+                    *slot = estack->pop();
+                    objMgr->writeBarrier(slot);
                     pc += sizeof(ByteCode_StoreFree);
+                  }
                     break;
                 case ByteCode_LoadLambda::CODE:
                     estack->push(SValue(
@@ -100,7 +117,7 @@ Label_PeekFrame:
                     }
                     break;
                 case ByteCode_Tail::CODE:
-                    fstack->pop();
+                    popFrame(fstack, objMgr);
                     frame = nullptr;
                     pc += sizeof(ByteCode_Tail);
                     break;
@@ -138,6 +155,29 @@ Label_PeekFrame:
             }
         }
 
-        fstack->pop();
+        popFrame(fstack, objMgr);
+    }
+}
+
+void executeByteCode(
+        int actualCount,
+        SEvalStack *estack,
+        SFrameStack *fstack,
+        SObjectManager *objMgr,
+        vector<SValue> *globals,
+        vector<SValue> *literals,
+        vector<SScriptFunctionProtoPtr> *protos) {
+
+    int frameOff = fstack->size();
+
+    try {
+        setupFrame(actualCount, estack, fstack, objMgr);
+        runFrames(frameOff, estack, fstack, objMgr, globals, literals, protos);
+    } catch (...) {
+        // the env stack is LIFO with the frames, popping them leaves it as it was before the call
+        while (fstack->size() > frameOff) {
+            popFrame(fstack, objMgr);
+        }
+        throw;
     }
 }
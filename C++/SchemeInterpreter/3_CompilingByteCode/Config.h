@@ -11,4 +11,12 @@
 
 #define DEBUG_ONLY_ASSERT
 
+// debug builds print the gc pause histogram when the heap is destroyed
+#ifndef NDEBUG
+#define GC_PAUSE_HISTOGRAM
+#endif
+
+#define ENABLE_AST_OPTIMIZER
+//#define BYTECODE_OPT_STATS
+
 #endif
@@ -7,6 +7,7 @@
 #include "SymbolTable.h"
 #include "SParser.h"
 #include "ASTCompiler.h"
+#include "ASTOptimizer.h"
 #include "ByteCodeCompiler.h"
 #include "ByteCodeExecuter.h"
 #include "SNumeric.h"
@@ -24,6 +25,7 @@ private:
     void eval();
 
     void setupBuiltin();
+    void setupPrimitives();
 
     void defineBuiltin(const char *name, CFunction f);
     void defineBuiltin(const char *name, SValue v);
@@ -37,12 +39,18 @@ private:
     vector<SValue> mGlobals;
     vector<SValue> mLiterals;
     vector<SScriptFunctionProtoPtr> mProtos;
+    vector<ASTPrimitiveInfo> mPrimitives;
+
+    int mInstructionsBeforeOpt;
+    int mInstructionsAfterOpt;
+    double mExecuteSeconds;
 };
 
 SInterpreterImpl::SInterpreterImpl(): 
-    mObjMgr(nullptr), mEvalStack(nullptr), mFrameStack(nullptr), mGSymTable(nullptr) {
+    mObjMgr(nullptr), mEvalStack(nullptr), mFrameStack(nullptr), mGSymTable(nullptr),
+    mInstructionsBeforeOpt(0), mInstructionsAfterOpt(0), mExecuteSeconds(0) {
 
-    mObjMgr = new SObjectManager(8 * 1024 * 1024, 1024);
+    mObjMgr = new SObjectManager(2 * 1024 * 1024, 8 * 1024 * 1024, 1024);
     mFrameStack = new SFrameStack();
     mEvalStack = new SEvalStack(64 * 1024);
     mGSymTable = new SymbolTable(nullptr);
@@ -75,6 +83,7 @@ SInterpreterImpl::SInterpreterImpl():
     });
 
     setupBuiltin();
+    setupPrimitives();
 
     mLiterals.push_back(SValue::VOID);
 }
@@ -83,6 +92,11 @@ SInterpreterImpl::~SInterpreterImpl() {
     ASSERT(mEvalStack->size() == 0);
     ASSERT(mFrameStack->size() == 0);
 
+#ifdef BYTECODE_OPT_STATS
+    cerr << format("bytecode: %d instructions before optimization, %d after, executed in %.3fs", 
+            mInstructionsBeforeOpt, mInstructionsAfterOpt, mExecuteSeconds) << endl;
+#endif
+
     mLiterals.clear();
     mGlobals.clear();
 
@@ -224,6 +238,30 @@ void SInterpreterImpl::setupBuiltin() {
     });
 }
 
+void SInterpreterImpl::setupPrimitives() {
+    static const struct {
+        const char *name;
+        int kind;
+        int arity;
+    } primitives[] = {
+        {"true", APK_Constant, 0}, {"false", APK_Constant, 0}, {"else", APK_Constant, 0}, {"empty", APK_Constant, 0},
+        {"+", APK_Numeric, 2}, {"-", APK_Numeric, 2}, {"*", APK_Numeric, 2},
+        {"/", APK_Division, 2}, {"quotient", APK_Division, 2}, {"remainder", APK_Division, 2},
+        {"=", APK_Numeric, 2}, {"<", APK_Numeric, 2}, {"<=", APK_Numeric, 2}, {">", APK_Numeric, 2}, {">=", APK_Numeric, 2},
+        {"sqr", APK_Numeric, 1}, {"sqrt", APK_Numeric, 1},
+        {"not", APK_Pure, 1}, {"identity", APK_Pure, 1}, {"eq?", APK_Pure, 2}, {"equal?", APK_Pure, 2}, {"empty?", APK_Pure, 1},
+    };
+
+    for (auto &primitive : primitives) {
+        auto address = mGSymTable->lookup(primitive.name);
+        ASSERT(address.isGlobal());
+
+        int index = address.getVarIndex();
+        mPrimitives.resize(max((int)mPrimitives.size(), index + 1), ASTPrimitiveInfo{APK_None, 0});
+        mPrimitives[index] = ASTPrimitiveInfo{primitive.kind, primitive.arity};
+    }
+}
+
 void SInterpreterImpl::interpret(istream &si) {
     ASSERT(mEvalStack->size() == 0 && mFrameStack->size() == 0);
 
@@ -231,6 +269,11 @@ void SInterpreterImpl::interpret(istream &si) {
     for (string line; getline(si, line); source += line + '\n');
     mEvalStack->push(parse(mObjMgr, source));
 
+#ifdef ENABLE_AST_OPTIMIZER
+    ASTOptimizerContext optCtx = {mObjMgr, mEvalStack, &mGlobals, &mLiterals, &mPrimitives};
+    forgetRedefinedPrimitives(&optCtx, mGSymTable, mEvalStack->top(-1));
+#endif
+
     while (mEvalStack->top(-1) != SValue::EMPTY) {
         SPair *l = mEvalStack->top(-1).getObject()->staticCast<SPair>();
         mEvalStack->push(l->car);
@@ -244,7 +287,7 @@ void SInterpreterImpl::interpret(istream &si) {
         }
 
         mEvalStack->pop();
-        mObjMgr->performFullGC();
+        mObjMgr->performMinorGC();
     }
     mEvalStack->pop();
 }
@@ -256,7 +299,9 @@ void SInterpreterImpl::callScriptFunction(int actualCount) {
         func->func(mObjMgr, mEvalStack, actualCount);
         mEvalStack->pop(actualCount);
     } else {
+        clock_t start = clock();
         executeByteCode(actualCount, mEvalStack, mFrameStack, mObjMgr, &mGlobals, &mLiterals, &mProtos);
+        mExecuteSeconds += double(clock() - start) / CLOCKS_PER_SEC;
     }
 }
 
@@ -265,8 +310,26 @@ void SInterpreterImpl::eval() {
     mGlobals.resize(mGSymTable->getSymbolCount());
 
     ASTNode_Lambda lambda = {0, {}, body};
+
+#ifdef BYTECODE_OPT_STATS
+    {
+        vector<SScriptFunctionProtoPtr> protos;
+        compileToByteCode(nullptr, &lambda, &protos);
+        mInstructionsBeforeOpt += countByteCodeInstructions(protos.back().get(), protos);
+    }
+#endif
+
+#ifdef ENABLE_AST_OPTIMIZER
+    ASTOptimizerContext optCtx = {mObjMgr, mEvalStack, &mGlobals, &mLiterals, &mPrimitives};
+    optimizeAST(&optCtx, &lambda);
+#endif
+
     compileToByteCode(nullptr, &lambda, &mProtos);
 
+#ifdef BYTECODE_OPT_STATS
+    mInstructionsAfterOpt += countByteCodeInstructions(mProtos.back().get(), mProtos);
+#endif
+
     // disassembleByteCode(cout, mProtos.back().get(), mGSymTable, mProtos, mLiterals);
 
     mEvalStack->top(-1).setObject(mObjMgr->createScriptFunction(mProtos.back().get(), ScopedValue<SObject*>(nullptr)));
@@ -30,6 +30,28 @@ public:
         *reinterpret_cast<void**>(&this[1]) = p;
     }
 
+    bool isMarked() const {
+        return mMarked == 1;
+    }
+
+    bool mark() {
+        bool b = mMarked == 0;
+        mMarked = 1;
+        return b;
+    }
+
+    void unmark() {
+        mMarked = 0;
+    }
+
+    int getAge() const {
+        return mAge;
+    }
+
+    void setAge(int age) {
+        mAge = min(age, int(MAX_AGE));
+    }
+
     template<typename DerivedT>
     DerivedT* staticCast() {
         ASSERT(getType() == DerivedT::TYPE);
@@ -56,12 +78,13 @@ public:
     SObject& operator = (const SObject&) = delete;
 
     static const int ALIGNMENT = PTR_ALIGNMENT;
+    static const int MAX_AGE = 3;
     static int objectSizeToAlignedSize(int bytes) {
         return roundUp<ALIGNMENT>(max(bytes, int(sizeof(SObject) + sizeof(void*)))) / ALIGNMENT;
     }
 
     SObject(int type, int alignedSize):
-        mType(type), mForwarded(0), mAlignedSize(alignedSize) {
+        mType(type), mForwarded(0), mMarked(0), mAge(0), mAlignedSize(alignedSize) {
     }
 
     bool equal(const SObject &o) const;
@@ -71,7 +94,9 @@ public:
 private:
     uint32_t mType : 5;
     uint32_t mForwarded : 1;
-    uint32_t mAlignedSize : 26;
+    uint32_t mMarked : 1;
+    uint32_t mAge : 2;
+    uint32_t mAlignedSize : 23;
 };
 
 class SExternalObject {
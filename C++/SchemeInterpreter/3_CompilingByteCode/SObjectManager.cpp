@@ -1,10 +1,10 @@
 #include "pch.h"
 #include "SObjectManager.h"
 
-SObjectManager::SObjectManager(int initObjHeapSize, int initExternalObjThreshold): 
-    mExternalObjCount(0), mExternalObjThreshold(initExternalObjThreshold), mFirstExternalObj(nullptr), 
-    mWorkingHeap(initObjHeapSize, 0), mFreeHeap(initObjHeapSize, 0), mFreeOfWorkingHeap(0), mFreeOfFreeHeap(0),
-    mSymbolMgr(nullptr) {
+SObjectManager::SObjectManager(int nurserySize, int initOldHeapSize, int initExternalObjThreshold):
+    GenerationalHeap(nurserySize, initOldHeapSize),
+    mExternalObjCount(0), mExternalObjThreshold(initExternalObjThreshold), mFirstExternalObj(nullptr),
+    mStackEnvs(STACK_ENV_SIZE, 0), mFreeOfStackEnvs(0), mSymbolMgr(nullptr) {
     mSymbolMgr = new SSymbolManager();
 }
 
@@ -12,30 +12,22 @@ SObjectManager::~SObjectManager() {
     DELETE(mSymbolMgr);
 
     performFullGC();
-}
-
-SObject* SObjectManager::getForwardedObject(SObject *obj) {
-    if (obj == nullptr) return nullptr;
-    if (obj->isForwarded()) {
-        return static_cast<SObject*>(obj->getForwardedPtr());
-    }
-
-    int bytes = obj->getAlignedSize() * SObject::ALIGNMENT;
-
-    ASSERT((char*)obj >= &mWorkingHeap[0] && (char*)obj + bytes <= &mWorkingHeap[0] + mWorkingHeap.size());
-
-    void *newAddress = &mFreeHeap[mFreeOfFreeHeap];
-    memcpy(newAddress, obj, bytes);
-    obj->forward(newAddress);
 
-    mFreeOfFreeHeap += bytes;
+#ifdef GC_PAUSE_HISTOGRAM
+    printGCStats(cerr);
+#endif
+}
 
-    return static_cast<SObject*>(newAddress);
+SObject* SObjectManager::mark(SObject *obj) {
+    // never moved, its fields are scanned by markRoots
+    if (isStackEnv(obj)) return obj;
+    return markObject(obj);
 }
 
 void SObjectManager::mark(SExternalObject *obj) {
-    if (obj && obj->mark()) {
-        mMarkedExternalObjs.push(obj);
+    // external objects are only marked and swept by full gc, they hold no references
+    if (getPhase() == GCP_Mark && obj) {
+        obj->mark();
     }
 }
 
@@ -43,7 +35,7 @@ void SObjectManager::mark(SValue *v) {
     switch (v->getType()) {
         case SVT_Undefined:
         case SVT_Reserved:
-        case SVT_Bool: 
+        case SVT_Bool:
         case SVT_Int:
         case SVT_Symbol:
             break;
@@ -53,7 +45,7 @@ void SObjectManager::mark(SValue *v) {
         case SPair::TYPE:
         case SEnv::TYPE:
         case SScriptFunction::TYPE:
-            v->setObject(getForwardedObject(v->getObject()));
+            v->setObject(mark(v->getObject()));
             break;
 
         case SCFunction::TYPE:
@@ -67,77 +59,66 @@ void SObjectManager::mark(SValue *v) {
     }
 }
 
-void SObjectManager::performFullGC() {
-    mFreeHeap.resize(max((int)mFreeHeap.size(), mFreeOfWorkingHeap * 2));
-    ASSERT(mFreeOfFreeHeap == 0);
-
+void SObjectManager::markRoots() {
     for (auto p = ScopedValue<SValue>::getFirst(); p != nullptr; p = p->getNext()) mark(&p->value);
-    for (auto p = ScopedValue<SObject*>::getFirst(); p != nullptr; p = p->getNext()) p->value = getForwardedObject(p->value);
+    for (auto p = ScopedValue<SObject*>::getFirst(); p != nullptr; p = p->getNext()) p->value = mark(p->value);
     for (auto p = ScopedValue<SExternalObject*>::getFirst(); p != nullptr; p = p->getNext()) mark(p->value);
 
     if (mGCRootCollector != nullptr) {
         mGCRootCollector(this);
     }
 
-    int scannedFree = 0;
-    while (scannedFree < mFreeOfFreeHeap || !mMarkedExternalObjs.empty()) {
-
-        while (!mMarkedExternalObjs.empty()) {
-            SExternalObject *obj = mMarkedExternalObjs.front();
-            mMarkedExternalObjs.pop();
+    for (int off = 0; off < mFreeOfStackEnvs; ) {
+        SObject *obj = static_cast<SObject*>(static_cast<void*>(&mStackEnvs[off]));
+        scanFields(obj);
+        off += getObjectBytes(obj);
+    }
+}
 
-            // mark obj's children
-            switch (obj->getType()) {
-                case SCFunction::TYPE:
-                    break;
-                case SBigInt::TYPE:
-                    break;
-                default:
-                    ASSERT(0);
-                    break;
+void SObjectManager::scanFields(SObject *obj) {
+    switch (obj->getType()) {
+        case SDouble::TYPE:
+            break;
+        case SString::TYPE:
+            break;
+        case SPair::TYPE: {
+            SPair *pair = obj->staticCast<SPair>();
+            markField(&pair->car);
+            markField(&pair->cdr);
+          }
+            break;
+        case SEnv::TYPE: {
+            SEnv *env = obj->staticCast<SEnv>();
+            if (env->prevEnv != nullptr) {
+                markField(&env->prevEnv);
             }
-        }
-
-        while (scannedFree < mFreeOfFreeHeap) {
-            SObject *obj = static_cast<SObject*>(static_cast<void*>(&mFreeHeap[scannedFree]));
-            switch (obj->getType()) {
-                case SDouble::TYPE:
-                    break;
-                case SString::TYPE:
-                    break;
-                case SPair::TYPE: {
-                    SPair *pair = obj->staticCast<SPair>();
-                    mark(&pair->car);
-                    mark(&pair->cdr);
-                  }
-                    break;
-                case SEnv::TYPE: {
-                    SEnv *env = obj->staticCast<SEnv>();
-                    if (env->prevEnv != nullptr) {
-                        mark(&env->prevEnv);
-                    }
-                    for (int i = 0; i < env->localCount; ++i) {
-                        mark(&env->locals[i]);
-                    }
-                 }
-                    break;
-                case SScriptFunction::TYPE: {
-                    SScriptFunction *func = obj->staticCast<SScriptFunction>();
-                    if (func->env != nullptr) {
-                        mark(&func->env);
-                    }
-                    func->freeVarsReady = false;
-                    }
-                    break;
-                default:
-                    ASSERT(0);
-                    break;
+            for (int i = 0; i < env->localCount; ++i) {
+                markField(&env->locals[i]);
             }
+         }
+            break;
+        case SScriptFunction::TYPE: {
+            SScriptFunction *func = obj->staticCast<SScriptFunction>();
+            if (func->env != nullptr) {
+                markField(&func->env);
+            }
+            }
+            break;
+        default:
+            ASSERT(0);
+            break;
+    }
+}
 
-            scannedFree += obj->getAlignedSize() * SObject::ALIGNMENT;
-        }
+void SObjectManager::onGCFinished(bool full) {
+    if (full) {
+        sweepExternalObjects();
     }
+    // closures cache the envs of their free variables, which may have moved
+    ++SScriptFunction::sEnvEpoch;
+}
 
+void SObjectManager::sweepExternalObjects() {
     mExternalObjCount = 0;
     SExternalObject **p = &mFirstExternalObj;
     while (*p != nullptr) {
@@ -165,9 +146,5 @@ void SObjectManager::performFullGC() {
         }
     }
 
-    swap(mWorkingHeap, mFreeHeap);
-    mFreeOfWorkingHeap = mFreeOfFreeHeap;
-    mFreeOfFreeHeap = 0;
-
     mExternalObjThreshold = max(mExternalObjThreshold, mExternalObjCount * 2);
 }
@@ -4,10 +4,16 @@
 #include "SValue.h"
 #include "STypes.h"
 #include "SSymbol.h"
+#include "../Common/GenerationalHeap.h"
 
-class SObjectManager {
+// The gc heap is a GenerationalHeap of SObject; SExternalObjects (non-POD objects) are kept in a list
+// and swept by full gc only.
+// Any store of an SValue into a heap object must be followed by writeBarrier(slot).
+
+class SObjectManager: public GenerationalHeap<SObjectManager, SObject> {
+    friend class GenerationalHeap<SObjectManager, SObject>;
 public:
-    SObjectManager(int initObjHeapSize, int initExternalObjThreshold);
+    SObjectManager(int nurserySize, int initOldHeapSize, int initExternalObjThreshold);
     ~SObjectManager();
 
     SObjectManager(const SObjectManager&) = delete;
@@ -50,6 +56,27 @@ public:
         return createExternalObject<SBigInt>(n);
     }
 
+    // envs which can't escape their call are allocated LIFO here instead of in the gc heap, returns
+    // nullptr if the env stack is full
+    SEnv* pushStackEnv(const ScopedValue<SObject*> &prevEnv, int localCount) {
+        int requireBytes = SEnv::estimateAlignedSize(prevEnv, localCount) * SObject::ALIGNMENT;
+        if (mFreeOfStackEnvs + requireBytes > (int)mStackEnvs.size()) return nullptr;
+
+        SEnv *env = new (&mStackEnvs[mFreeOfStackEnvs]) SEnv(prevEnv, localCount);
+        mFreeOfStackEnvs += requireBytes;
+        return env;
+    }
+
+    void popStackEnv(SEnv *env) {
+        ASSERT(isStackEnv(env));
+        mFreeOfStackEnvs = int((char*)env - &mStackEnvs[0]);
+    }
+
+    bool isStackEnv(const void *p) const {
+        PtrValue off = (const char*)p - &mStackEnvs[0];
+        return off >= 0 && off < mFreeOfStackEnvs;
+    }
+
 private:
     template<typename DerivedT, typename ...ArgT>
     DerivedT* createExternalObject(ArgT&& ...args) {
@@ -71,14 +98,7 @@ private:
     template<typename DerivedT, typename ...ArgT>
     DerivedT* createObject(ArgT&& ...args) {
         int requireBytes = DerivedT::estimateAlignedSize(forward<ArgT>(args)...) * SObject::ALIGNMENT;
-
-        if (mFreeOfWorkingHeap + requireBytes > (int)mWorkingHeap.size()) {
-            performFullGC();
-            return createObject<DerivedT>(forward<ArgT>(args)...);
-        }
-
-        DerivedT *p = new (&mWorkingHeap[mFreeOfWorkingHeap]) DerivedT(forward<ArgT>(args)...);
-        mFreeOfWorkingHeap += requireBytes;
+        DerivedT *p = new (allocate(requireBytes)) DerivedT(forward<ArgT>(args)...);
 
         ASSERT(force_cast<PtrValue>(p) % PTR_ALIGNMENT == 0);
         return p;
@@ -96,29 +116,54 @@ public:
     template<typename DerivedT>
     void mark(DerivedT **obj, typename enable_if<is_base_of<SObject, DerivedT>::value, void>::type* =0) {
         if (*obj) {
-            *obj = getForwardedObject(static_cast<SObject*>(*obj))->staticCast<DerivedT>();
+            // the object may not have been moved to its new address yet during full gc
+            *obj = static_cast<DerivedT*>(mark(static_cast<SObject*>(*obj)));
         }
     }
 
-    void performFullGC();
-
 private:
-    SObject* getForwardedObject(SObject *obj);
+    static const int STACK_ENV_SIZE = 256 * 1024;
+
+    static int getObjectBytes(const SObject *obj) {
+        return obj->getAlignedSize() * SObject::ALIGNMENT;
+    }
+
+    static SObject* getForwarded(SObject *obj) {
+        return static_cast<SObject*>(obj->getForwardedPtr());
+    }
+
+    SObject* mark(SObject *obj);
+
+    void markRoots();
+    void scanFields(SObject *obj);
+    void onGCFinished(bool full);
+
+    void markField(SValue *slot) {
+        mark(slot);
+        if (slot->get<SValue::TAG_MASK>() == SValue::TV_Object) {
+            rememberSurvivor(slot, slot->getObject());
+        }
+    }
+
+    template<typename DerivedT>
+    void markField(DerivedT **slot) {
+        mark(slot);
+        rememberSurvivor(slot, *slot);
+    }
+
+    void sweepExternalObjects();
 
 private:
     int mExternalObjCount;
     int mExternalObjThreshold;
     SExternalObject *mFirstExternalObj;
 
-    vector<char> mWorkingHeap;
-    vector<char> mFreeHeap;
-    int mFreeOfWorkingHeap;
-    int mFreeOfFreeHeap;
+    vector<char> mStackEnvs;
+    int mFreeOfStackEnvs;
 
     SSymbolManager *mSymbolMgr;
 
     function<void(SObjectManager*)> mGCRootCollector;
-    queue<SExternalObject*> mMarkedExternalObjs;
 };
 
 #endif
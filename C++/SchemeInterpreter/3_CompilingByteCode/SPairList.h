@@ -34,7 +34,10 @@ public:
             mList.value.setObject(newPair);
             mLastPair.value = newPair;
         } else {
-            mLastPair.value->staticCast<SPair>()->cdr.setObject(newPair);
+            // the last pair may have been promoted while allocating the new one
+            SValue *slot = &mLastPair.value->staticCast<SPair>()->cdr;
+            slot->setObject(newPair);
+            mMgr->writeBarrier(slot);
             mLastPair.value = newPair;
         }
         return *this;
@@ -43,7 +46,9 @@ public:
     void concat(SValue v) {
         if (mList.value == SValue::EMPTY) mList.value = v;
         else {
-            mLastPair.value->staticCast<SPair>()->cdr = v;
+            SValue *slot = &mLastPair.value->staticCast<SPair>()->cdr;
+            *slot = v;
+            mMgr->writeBarrier(slot);
         }
     }
 
@@ -9,9 +9,11 @@ struct SScriptFunctionProto {
     vector<string> locals;
     vector<uint8_t> bytes;
     vector<VarAddress> freeAddresses;
+    // if false, the env of a call is allocated on SObjectManager's env stack
+    bool envEscapes;
 
     SScriptFunctionProto(SScriptFunctionProto *_parent): 
-        parent(_parent) {
+        parent(_parent), envEscapes(true) {
     }
 };
 typedef shared_ptr<SScriptFunctionProto> SScriptFunctionProtoPtr;
@@ -21,6 +21,8 @@ ostream& SPair::_writeToStream(ostream& so) const {
     return so;
 }
 
+int SScriptFunction::sEnvEpoch = 0;
+
 double SBigInt::toDouble() const {
     double r = 0;
 
@@ -116,9 +116,13 @@ struct SEnv: public SObject {
     }
 
     void setLocal(int index, SValue v) {
+        *getLocalAddress(index) = v;
+    }
+
+    SValue* getLocalAddress(int index) {
         ASSERT(index >= 0 && index < localCount);
 
-        locals[index] = v;
+        return &locals[index];
     }
 
     bool _equal(const SEnv &o) const {
@@ -149,9 +153,12 @@ struct SScriptFunction: public SObject {
 
     SScriptFunctionProto *proto;
     SEnv *env;
-    bool freeVarsReady;
+    // freeVars point into the locals of the env chain, they must be resolved again once the collector moved envs
+    int freeVarsEpoch;
     SValue *freeVars[1];
 
+    static int sEnvEpoch;
+
     SValue getFree(int freeIndex) const {
         ASSERT(freeIndex >= 0 && freeIndex < (int)proto->freeAddresses.size());
         const_cast<SScriptFunction*>(this)->checkFreeVarsReady();
@@ -160,10 +167,14 @@ struct SScriptFunction: public SObject {
     }
 
     void setFree(int freeIndex, SValue v) {
+        *getFreeAddress(freeIndex) = v;
+    }
+
+    SValue* getFreeAddress(int freeIndex) {
         ASSERT(freeIndex >= 0 && freeIndex < (int)proto->freeAddresses.size());
         checkFreeVarsReady();
 
-        *freeVars[freeIndex] = v;
+        return freeVars[freeIndex];
     }
 
     bool _equal(const SScriptFunction &o) const {
@@ -176,7 +187,7 @@ struct SScriptFunction: public SObject {
 
 private:
     void checkFreeVarsReady() {
-        if (freeVarsReady) return;
+        if (freeVarsEpoch == sEnvEpoch) return;
         
         int freeIndex = 0;
         for (auto address : proto->freeAddresses) {
@@ -190,7 +201,7 @@ private:
             freeVars[freeIndex++] = &curEnv->locals[index];
         }
 
-        freeVarsReady = true;
+        freeVarsEpoch = sEnvEpoch;
     }
 
     friend class SObjectManager;
@@ -198,7 +209,7 @@ private:
     explicit SScriptFunction(SScriptFunctionProto *_proto, const ScopedValue<SObject*> &_env): 
         SObject(TYPE, estimateAlignedSize(_proto, _env)), 
         proto(_proto), 
-        env(_env.value ? _env.value->staticCast<SEnv>() : nullptr), freeVarsReady(false) {
+        env(_env.value ? _env.value->staticCast<SEnv>() : nullptr), freeVarsEpoch(sEnvEpoch - 1) {
     }
 };
 
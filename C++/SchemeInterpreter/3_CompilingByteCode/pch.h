@@ -6,6 +6,7 @@
 #include <time.h>
 #include <assert.h>
 #include <stdint.h>
+#include <math.h>
 
 #include <iostream>
 #include <string>
@@ -13,4 +13,9 @@
 
 #define DEBUG_ONLY_ASSERT
 
+// debug builds print the gc pause histogram when the heap is destroyed
+#ifndef NDEBUG
+#define GC_PAUSE_HISTOGRAM
+#endif
+
 #endif
@@ -7,6 +7,11 @@
 #include "SProto.h"
 #include "SStack.h"
 
+static inline void storeEnvValue(SObjectManager *objMgr, SEnv *env, int i, SValue v) {
+    env->setValue(i, v);
+    objMgr->writeBarrier(&env->values[i]);
+}
+
 static void setupFrame(
         int actualCount,
         SEvalStack *evalStack,
@@ -91,7 +96,7 @@ Label_PeekFrame:
                     pc += sizeof(ByteCode<BCE_LoadLocal2>);
                     break;
                 case BCE_StoreLocal:
-                    frame->localEnv->setValue(reinterpret_cast<ByteCode<BCE_StoreLocal>*>(&codes[pc])->lindex, evalStack->pop());
+                    storeEnvValue(objMgr, frame->localEnv, reinterpret_cast<ByteCode<BCE_StoreLocal>*>(&codes[pc])->lindex, evalStack->pop());
                     pc += sizeof(ByteCode<BCE_StoreLocal>);
                     break;
                 case BCE_LoadFree: {
@@ -114,22 +119,22 @@ Label_PeekFrame:
                     break;
                 case BCE_StoreFree: {
                     auto ins = reinterpret_cast<ByteCode<BCE_StoreFree>*>(&codes[pc]);
-                    frame->localEnv->getUpEnv(ins->envIndex)->setValue(ins->index, evalStack->pop());
+                    storeEnvValue(objMgr, frame->localEnv->getUpEnv(ins->envIndex), ins->index, evalStack->pop());
                     pc += sizeof(ByteCode<BCE_StoreFree>);
                 }
                     break;
                 case BCE_StoreFree1: {
-                    frame->localEnv->prevEnv->setValue(reinterpret_cast<ByteCode<BCE_StoreFree1>*>(&codes[pc])->index, evalStack->pop());
+                    storeEnvValue(objMgr, frame->localEnv->prevEnv, reinterpret_cast<ByteCode<BCE_StoreFree1>*>(&codes[pc])->index, evalStack->pop());
                     pc += sizeof(ByteCode<BCE_StoreFree1>);
                  }
                     break;
                 case BCE_StoreFree2: {
-                    frame->localEnv->prevEnv->prevEnv->setValue(reinterpret_cast<ByteCode<BCE_StoreFree2>*>(&codes[pc])->index, evalStack->pop());
+                    storeEnvValue(objMgr, frame->localEnv->prevEnv->prevEnv, reinterpret_cast<ByteCode<BCE_StoreFree2>*>(&codes[pc])->index, evalStack->pop());
                     pc += sizeof(ByteCode<BCE_StoreFree2>);
                  }
                     break;
                 case BCE_StoreFree3: {
-                    frame->localEnv->prevEnv->prevEnv->prevEnv->setValue(reinterpret_cast<ByteCode<BCE_StoreFree3>*>(&codes[pc])->index, evalStack->pop());
+                    storeEnvValue(objMgr, frame->localEnv->prevEnv->prevEnv->prevEnv, reinterpret_cast<ByteCode<BCE_StoreFree3>*>(&codes[pc])->index, evalStack->pop());
                     pc += sizeof(ByteCode<BCE_StoreFree3>);
                  }
                     break;
@@ -34,8 +34,33 @@ struct SObject {
         return (int)mSize;
     }
 
+    bool isMarked() const {
+        return mMarked == 1;
+    }
+
+    // returns false if already marked
+    bool mark() {
+        if (mMarked) return false;
+        mMarked = 1;
+        return true;
+    }
+
+    void unmark() {
+        mMarked = 0;
+    }
+
+    int getAge() const {
+        return (int)mAge;
+    }
+
+    void setAge(int age) {
+        mAge = min(age, int(MAX_AGE));
+    }
+
+    static const int MAX_AGE = 3;
+
 protected:
-    SObject(int type): mType(type), mForwarded(0), mSize(0) {
+    SObject(int type): mType(type), mForwarded(0), mMarked(0), mAge(0), mSize(0) {
     }
 
     static int toAlignedSize(int bytes) {
@@ -44,7 +69,9 @@ protected:
 
     uint32_t mType : 5;
     uint32_t mForwarded : 1;
-    uint32_t mSize : 20;
+    uint32_t mMarked : 1;
+    uint32_t mAge : 2;
+    uint32_t mSize : 23;
 };
 
 
@@ -2,13 +2,16 @@
 #include "SObjectManager.h"
 #include "ScopedValue.h"
 
-SObjectManager::SObjectManager(): mFreeOfWorkingHeap(0) {
-    mWorkingHeap.resize(512 * 1024);
-    mFreeHeap.resize(512 * 1024);
+SObjectManager::SObjectManager(int nurserySize, int initOldHeapSize):
+    GenerationalHeap(nurserySize, initOldHeapSize) {
 }
 
 SObjectManager::~SObjectManager() {
     performFullGC();
+
+#ifdef GC_PAUSE_HISTOGRAM
+    printGCStats(cerr);
+#endif
 }
 
 void SObjectManager::mark(SValue *v) {
@@ -18,42 +21,37 @@ void SObjectManager::mark(SValue *v) {
 }
 
 SObject* SObjectManager::mark(SObject *obj) {
-    if (obj == nullptr) return obj;
-
-    ASSERT((uint8_t*)obj >= &mFreeHeap[0] && (uint8_t*)obj + obj->getSize() <= &mFreeHeap[0] + mFreeHeap.size());
+    return markObject(obj);
+}
 
-    if (obj->isForwarded()) {
-        return obj->getForwardPtr();
+void SObjectManager::markRoots() {
+    if (mRootCollector) {
+        mRootCollector(this);
     }
 
-    auto newPtr = reinterpret_cast<SObject*>(&mWorkingHeap[mFreeOfWorkingHeap]);
-    memcpy(newPtr, obj, obj->getSize());
-    mFreeOfWorkingHeap += obj->getSize();
-
-    obj->forward(newPtr);
-
-    return newPtr;
+    for (auto p = ScopedValue<SValue>::getFirst(); p != nullptr; p = p->getNext()) mark(&p->value);
+    for (auto p = ScopedValue<SObject*>::getFirst(); p != nullptr; p = p->getNext()) mark(&p->value);
 }
 
-static void updateFields(SObjectManager *mgr, SObject *obj) {
+void SObjectManager::scanFields(SObject *obj) {
     switch (obj->getType()) {
         case SVT_Pair: {
             auto p = static_cast<SPair*>(obj);
-            mgr->mark(&p->car);
-            mgr->mark(&p->cdr);
+            markField(&p->car);
+            markField(&p->cdr);
            }
             break;
         case SVT_Env: {
             auto p = static_cast<SEnv*>(obj);
-            mgr->mark(&p->prevEnv);
+            markField(&p->prevEnv);
             for (int i = 0; i < p->vCount; ++i) {
-                mgr->mark(&p->values[i]);
+                markField(&p->values[i]);
             }
           }
             break;
         case SVT_Func: {
             auto p = static_cast<SFunc*>(obj);
-            mgr->mark(&p->env);
+            markField(&p->env);
            }
             break;
         case SVT_NativeFunc: {
@@ -61,7 +59,7 @@ static void updateFields(SObjectManager *mgr, SObject *obj) {
             break;
         case SVT_Class: {
             auto p = static_cast<SClass*>(obj);
-            mgr->mark(&p->env);
+            markField(&p->env);
         }
             break;
         default:
@@ -69,23 +67,3 @@ static void updateFields(SObjectManager *mgr, SObject *obj) {
             break;
     }
 }
-
-void SObjectManager::performFullGC() {
-    swap(mWorkingHeap, mFreeHeap);
-
-    mFreeOfWorkingHeap = 0;
-
-    if (mRootCollector) {
-        mRootCollector(this);
-    }
-
-    for (auto p = ScopedValue<SValue>::getFirst(); p != nullptr; p = p->getNext()) mark(&p->value);
-    for (auto p = ScopedValue<SObject*>::getFirst(); p != nullptr; p = p->getNext()) mark(&p->value);
-
-    int scanned = 0;
-    while (scanned < mFreeOfWorkingHeap) {
-        SObject *obj = reinterpret_cast<SObject*>(&mWorkingHeap[scanned]);
-        updateFields(this, obj);
-        scanned += obj->getSize();
-    }
-}
@@ -3,29 +3,25 @@
 
 #include "SValue.h"
 #include "STypes.h"
+#include "../../Common/GenerationalHeap.h"
 
 struct SFuncProto;
 struct SClassProto;
 
-class SObjectManager {
+// The gc heap is a GenerationalHeap of SObject.
+// Any store of an SValue into a heap object must be followed by writeBarrier(slot).
+
+class SObjectManager: public GenerationalHeap<SObjectManager, SObject> {
+    friend class GenerationalHeap<SObjectManager, SObject>;
 public:
-    SObjectManager();
+    SObjectManager(int nurserySize = 512 * 1024, int initOldHeapSize = 2 * 1024 * 1024);
     ~SObjectManager();
 
     template<typename T, typename ...ArgT>
     T* createObject(ArgT && ...args) {
-
         int size = T::estimateSize(forward<ArgT>(args)...);
 
-        if (mFreeOfWorkingHeap + size > (int)mWorkingHeap.size()) {
-            mFreeHeap.resize(max((mFreeOfWorkingHeap + size) * 3 / 2, (int)mFreeHeap.size()));
-            performFullGC();
-        }
-        ASSERT(mFreeOfWorkingHeap + size <= (int)mWorkingHeap.size());
-
-        T *p = new (&mWorkingHeap[mFreeOfWorkingHeap]) T(forward<ArgT>(args)...);
-        mFreeOfWorkingHeap += size;
-
+        T *p = new (allocate(size)) T(forward<ArgT>(args)...);
         p->setSize(size);
 
         return p;
@@ -42,18 +38,38 @@ public:
     void mark(SValue *v);
     SObject* mark(SObject *obj);
 
-    template<typename T> 
+    template<typename T>
     void mark(T ** p) {
-        *p = static_cast<T*>(mark(*p));
+        *p = static_cast<T*>(mark(static_cast<SObject*>(*p)));
+    }
+
+private:
+    static int getObjectBytes(const SObject *obj) {
+        return obj->getSize();
     }
 
-    void performFullGC();
+    static SObject* getForwarded(SObject *obj) {
+        return obj->getForwardPtr();
+    }
+
+    void markRoots();
+    void scanFields(SObject *obj);
+
+    void markField(SValue *slot) {
+        mark(slot);
+        if (slot->isObject()) {
+            rememberSurvivor(slot, slot->getObject());
+        }
+    }
+
+    template<typename T>
+    void markField(T **slot) {
+        mark(slot);
+        rememberSurvivor(slot, *slot);
+    }
 
 private:
     function<void(SObjectManager*)> mRootCollector;
-    vector<uint8_t> mWorkingHeap;
-    int mFreeOfWorkingHeap;
-    vector<uint8_t> mFreeHeap;
 };
 
 #endif
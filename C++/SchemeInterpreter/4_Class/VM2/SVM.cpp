@@ -107,10 +107,12 @@ static void setupGlobals(SExpression e, vector<SValue> &globals, SObjectManager
                     firstList.value = nextPair;
                     auto newPair = mgr->createObject<SPair>(ScopedValue<SValue>(nextPair->getCar()));
                     static_cast<SPair*>(lastPair.value)->setCdr(SValue(newPair));
+                    mgr->writeBarrier(&static_cast<SPair*>(lastPair.value)->cdr);
                     lastPair.value = newPair;
                 }
 
                 static_cast<SPair*>(lastPair.value)->setCdr(ret[2]);
+                mgr->writeBarrier(&static_cast<SPair*>(lastPair.value)->cdr);
             }
         }},
 
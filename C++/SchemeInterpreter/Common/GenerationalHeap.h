@@ -0,0 +1,442 @@
+#ifndef GENERATIONAL_HEAP_H
+#define GENERATIONAL_HEAP_H
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+// Generational heap shared by the scheme VMs:
+//  - young generation: a semispace nursery, survivors are copied between mNursery and mSurvivor and
+//    promoted into the old generation once they reach PROMOTION_AGE
+//  - old generation: bump allocated, pointers from old to young objects are remembered by card marking,
+//    and it is mark-compacted by performFullGC
+// Any store of a reference into a heap object must be followed by writeBarrier(slot).
+//
+// ManagerT derives from GenerationalHeap<ManagerT, ObjectT> and provides:
+//  - static int getObjectBytes(const ObjectT *obj)
+//  - static ObjectT* getForwarded(ObjectT *obj)
+//  - void markRoots(), calling markObject on every root
+//  - void scanFields(ObjectT *obj), calling markObject on every field and rememberSurvivor after it
+//  - optionally void onGCFinished(bool full), called at the end of every collection
+// ObjectT provides isForwarded/forward, mark/isMarked/unmark and getAge/setAge.
+
+template<typename ManagerT, typename ObjectT>
+class GenerationalHeap {
+public:
+    GenerationalHeap(int nurserySize, int initOldHeapSize):
+        mNursery(nurserySize, 0), mSurvivor(nurserySize, 0), mFreeOfNursery(0), mFreeOfSurvivor(0),
+        mOldHeap(std::max(initOldHeapSize, nurserySize), 0), mFreeOfOldHeap(0),
+        mPhase(GCP_None), mCompactBase(nullptr), mPromotedBytes(0) {
+
+        resetOldHeapCards();
+
+        memset(mPauseHistogram, 0, sizeof(mPauseHistogram));
+        memset(mPauseTotal, 0, sizeof(mPauseTotal));
+        memset(mPauseMax, 0, sizeof(mPauseMax));
+    }
+
+    GenerationalHeap(const GenerationalHeap&) = delete;
+    GenerationalHeap& operator = (const GenerationalHeap&) = delete;
+
+    void writeBarrier(const void *slot) {
+        PtrValue off = (const char*)slot - &mOldHeap[0];
+        if (off >= 0 && off < mFreeOfOldHeap) {
+            mCards[off >> LOG_CARD_SIZE] = 1;
+        }
+    }
+
+    void performMinorGC();
+    void performFullGC(int requireOldBytes = 0);
+
+    void printGCStats(std::ostream &so) const;
+
+protected:
+    enum GCPhase {
+        GCP_None,
+        GCP_Evacuate,
+        GCP_Mark,
+        GCP_Relocate,
+    };
+
+    // collects until there is room, the caller constructs the object at the returned address
+    void* allocate(int bytes) {
+        if (bytes > (int)mNursery.size() / 2) {
+            // too big for the nursery, the object is born old, and its cards stay dirty because the
+            // constructor may store young pointers without barrier
+            if (mFreeOfOldHeap + bytes > (int)mOldHeap.size()) {
+                performFullGC(bytes);
+            }
+            void *address = allocOld(bytes);
+            for (int off = mFreeOfOldHeap - bytes; off < mFreeOfOldHeap; off += CARD_SIZE) {
+                mCards[off >> LOG_CARD_SIZE] = 1;
+            }
+            return address;
+        }
+
+        while (mFreeOfNursery + bytes > (int)mNursery.size()) {
+            performMinorGC();
+        }
+        void *address = &mNursery[mFreeOfNursery];
+        mFreeOfNursery += bytes;
+        return address;
+    }
+
+    ObjectT* markObject(ObjectT *obj) {
+        if (obj == nullptr) return nullptr;
+
+        switch (mPhase) {
+            case GCP_Evacuate:
+                return evacuate(obj);
+            case GCP_Mark:
+                if (obj->mark()) {
+                    mMarkStack.push_back(obj);
+                }
+                return obj;
+            case GCP_Relocate:
+                return relocate(obj);
+            default:
+                ASSERT(0);
+                return obj;
+        }
+    }
+
+    // after a young object was evacuated, a slot living in old heap must be remembered again
+    void rememberSurvivor(const void *slot, const void *target) {
+        if (mPhase == GCP_Evacuate && isInSurvivor(target)) {
+            writeBarrier(slot);
+        }
+    }
+
+    void onGCFinished(bool) {}
+
+    GCPhase getPhase() const {
+        return mPhase;
+    }
+
+private:
+    static const int PROMOTION_AGE = 2;
+    static const int LOG_CARD_SIZE = 9;
+    static const int CARD_SIZE = 1 << LOG_CARD_SIZE;
+    static const int HISTOGRAM_BUCKETS = 16;
+
+    ManagerT* manager() {
+        return static_cast<ManagerT*>(this);
+    }
+
+    ObjectT* objectAt(char *p) {
+        return static_cast<ObjectT*>(static_cast<void*>(p));
+    }
+
+    void scanDirtyCards(int oldHeapEnd);
+
+    ObjectT* evacuate(ObjectT *obj);
+    ObjectT* relocate(ObjectT *obj);
+
+    void* allocOld(int bytes);
+    void resetOldHeapCards();
+
+    bool isInNursery(const void *p) const {
+        PtrValue off = (const char*)p - &mNursery[0];
+        return off >= 0 && off < (PtrValue)mNursery.size();
+    }
+
+    bool isInSurvivor(const void *p) const {
+        PtrValue off = (const char*)p - &mSurvivor[0];
+        return off >= 0 && off < (PtrValue)mSurvivor.size();
+    }
+
+    bool isInOldHeap(const void *p) const {
+        PtrValue off = (const char*)p - &mOldHeap[0];
+        return off >= 0 && off < (PtrValue)mOldHeap.size();
+    }
+
+    void recordPause(int kind, double us);
+
+private:
+    std::vector<char> mNursery;
+    std::vector<char> mSurvivor;
+    int mFreeOfNursery;
+    int mFreeOfSurvivor;
+
+    std::vector<char> mOldHeap;
+    int mFreeOfOldHeap;
+    std::vector<uint8_t> mCards;
+    std::vector<int> mCardFirstObject;
+
+    GCPhase mPhase;
+    std::vector<ObjectT*> mMarkStack;
+    std::vector<ObjectT*> mLiveOldObjs;
+    std::vector<ObjectT*> mLiveYoungObjs;
+    std::vector<int> mLiveOldOffsets;
+    std::vector<int> mLiveYoungOffsets;
+    char *mCompactBase;
+
+    // [0] minor, [1] full; bucket i counts pauses in [2^(i-1), 2^i) us
+    int mPauseHistogram[2][HISTOGRAM_BUCKETS];
+    double mPauseTotal[2];
+    double mPauseMax[2];
+    int mPromotedBytes;
+};
+
+template<typename ManagerT, typename ObjectT>
+void* GenerationalHeap<ManagerT, ObjectT>::allocOld(int bytes) {
+    int off = mFreeOfOldHeap;
+    ASSERT(off + bytes <= (int)mOldHeap.size());
+    mFreeOfOldHeap += bytes;
+
+    for (int card = (off + CARD_SIZE - 1) >> LOG_CARD_SIZE; (card << LOG_CARD_SIZE) < mFreeOfOldHeap; ++card) {
+        mCardFirstObject[card] = off;
+    }
+
+    return &mOldHeap[off];
+}
+
+template<typename ManagerT, typename ObjectT>
+void GenerationalHeap<ManagerT, ObjectT>::resetOldHeapCards() {
+    int cardCount = ((int)mOldHeap.size() + CARD_SIZE - 1) >> LOG_CARD_SIZE;
+    mCards.assign(cardCount, 0);
+    mCardFirstObject.assign(cardCount, 0);
+
+    int end = mFreeOfOldHeap;
+    mFreeOfOldHeap = 0;
+    while (mFreeOfOldHeap < end) {
+        allocOld(ManagerT::getObjectBytes(objectAt(&mOldHeap[mFreeOfOldHeap])));
+    }
+}
+
+template<typename ManagerT, typename ObjectT>
+ObjectT* GenerationalHeap<ManagerT, ObjectT>::evacuate(ObjectT *obj) {
+    if (!isInNursery(obj)) return obj;
+    if (obj->isForwarded()) {
+        return ManagerT::getForwarded(obj);
+    }
+
+    int bytes = ManagerT::getObjectBytes(obj);
+    int age = obj->getAge() + 1;
+
+    void *newAddress;
+    if (age >= PROMOTION_AGE) {
+        newAddress = allocOld(bytes);
+        mPromotedBytes += bytes;
+    } else {
+        ASSERT(mFreeOfSurvivor + bytes <= (int)mSurvivor.size());
+        newAddress = &mSurvivor[mFreeOfSurvivor];
+        mFreeOfSurvivor += bytes;
+    }
+
+    memcpy(newAddress, obj, bytes);
+    ObjectT *newObj = static_cast<ObjectT*>(newAddress);
+    newObj->setAge(age);
+
+    obj->forward(newObj);
+    return newObj;
+}
+
+template<typename ManagerT, typename ObjectT>
+ObjectT* GenerationalHeap<ManagerT, ObjectT>::relocate(ObjectT *obj) {
+    if (isInOldHeap(obj)) {
+        auto iter = std::lower_bound(mLiveOldObjs.begin(), mLiveOldObjs.end(), obj);
+        ASSERT(iter != mLiveOldObjs.end() && *iter == obj);
+        return objectAt(mCompactBase + mLiveOldOffsets[iter - mLiveOldObjs.begin()]);
+    } else {
+        ASSERT(isInNursery(obj));
+        auto iter = std::lower_bound(mLiveYoungObjs.begin(), mLiveYoungObjs.end(), obj);
+        ASSERT(iter != mLiveYoungObjs.end() && *iter == obj);
+        return objectAt(mCompactBase + mLiveYoungOffsets[iter - mLiveYoungObjs.begin()]);
+    }
+}
+
+template<typename ManagerT, typename ObjectT>
+void GenerationalHeap<ManagerT, ObjectT>::scanDirtyCards(int oldHeapEnd) {
+    // clear first: scanning an object may remember slots of the following cards again
+    std::vector<int> dirtyCards;
+    int cardCount = (oldHeapEnd + CARD_SIZE - 1) >> LOG_CARD_SIZE;
+    for (int card = 0; card < cardCount; ++card) {
+        if (mCards[card]) {
+            mCards[card] = 0;
+            dirtyCards.push_back(card);
+        }
+    }
+
+    int scanned = 0;
+    for (int card : dirtyCards) {
+        int off = std::max(scanned, mCardFirstObject[card]);
+        int end = std::min((card + 1) << LOG_CARD_SIZE, oldHeapEnd);
+        while (off < end) {
+            ObjectT *obj = objectAt(&mOldHeap[off]);
+            manager()->scanFields(obj);
+            off += ManagerT::getObjectBytes(obj);
+        }
+        scanned = std::max(scanned, off);
+    }
+}
+
+template<typename ManagerT, typename ObjectT>
+void GenerationalHeap<ManagerT, ObjectT>::performMinorGC() {
+    // in the worst case every young object is promoted
+    if (mFreeOfOldHeap + mFreeOfNursery > (int)mOldHeap.size()) {
+        performFullGC();
+        return;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    ASSERT(mFreeOfSurvivor == 0);
+    mPhase = GCP_Evacuate;
+
+    int oldHeapEnd = mFreeOfOldHeap;
+
+    manager()->markRoots();
+    scanDirtyCards(oldHeapEnd);
+
+    int scannedSurvivor = 0;
+    int scannedOld = oldHeapEnd;
+    while (scannedSurvivor < mFreeOfSurvivor || scannedOld < mFreeOfOldHeap) {
+        while (scannedSurvivor < mFreeOfSurvivor) {
+            ObjectT *obj = objectAt(&mSurvivor[scannedSurvivor]);
+            manager()->scanFields(obj);
+            scannedSurvivor += ManagerT::getObjectBytes(obj);
+        }
+
+        while (scannedOld < mFreeOfOldHeap) {
+            ObjectT *obj = objectAt(&mOldHeap[scannedOld]);
+            manager()->scanFields(obj);
+            scannedOld += ManagerT::getObjectBytes(obj);
+        }
+    }
+
+    std::swap(mNursery, mSurvivor);
+    mFreeOfNursery = mFreeOfSurvivor;
+    mFreeOfSurvivor = 0;
+
+    mPhase = GCP_None;
+    manager()->onGCFinished(false);
+
+    recordPause(0, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+template<typename ManagerT, typename ObjectT>
+void GenerationalHeap<ManagerT, ObjectT>::performFullGC(int requireOldBytes) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    mPhase = GCP_Mark;
+
+    manager()->markRoots();
+    while (!mMarkStack.empty()) {
+        ObjectT *obj = mMarkStack.back();
+        mMarkStack.pop_back();
+        manager()->scanFields(obj);
+    }
+
+    // compute new addresses: live old objects slide down, live young objects are appended behind them
+    int liveBytes = 0;
+    mLiveOldObjs.clear();
+    mLiveOldOffsets.clear();
+    for (int off = 0; off < mFreeOfOldHeap; ) {
+        ObjectT *obj = objectAt(&mOldHeap[off]);
+        int bytes = ManagerT::getObjectBytes(obj);
+        if (obj->isMarked()) {
+            mLiveOldObjs.push_back(obj);
+            mLiveOldOffsets.push_back(liveBytes);
+            liveBytes += bytes;
+        }
+        off += bytes;
+    }
+    mLiveYoungObjs.clear();
+    mLiveYoungOffsets.clear();
+    for (int off = 0; off < mFreeOfNursery; ) {
+        ObjectT *obj = objectAt(&mNursery[off]);
+        int bytes = ManagerT::getObjectBytes(obj);
+        if (obj->isMarked()) {
+            mLiveYoungObjs.push_back(obj);
+            mLiveYoungOffsets.push_back(liveBytes);
+            liveBytes += bytes;
+        }
+        off += bytes;
+    }
+
+    // keep room for promoting a full nursery, otherwise compact into a bigger heap
+    std::vector<char> newHeap;
+    int requireBytes = liveBytes + requireOldBytes + (int)mNursery.size();
+    if (requireBytes > (int)mOldHeap.size()) {
+        newHeap.resize(std::max((int)mOldHeap.size() * 2, requireBytes * 2), 0);
+        mCompactBase = &newHeap[0];
+    } else {
+        mCompactBase = &mOldHeap[0];
+    }
+
+    mPhase = GCP_Relocate;
+
+    manager()->markRoots();
+    for (auto obj : mLiveOldObjs) manager()->scanFields(obj);
+    for (auto obj : mLiveYoungObjs) manager()->scanFields(obj);
+
+    for (int i = 0; i < (int)mLiveOldObjs.size(); ++i) {
+        ObjectT *obj = mLiveOldObjs[i];
+        memmove(mCompactBase + mLiveOldOffsets[i], obj, ManagerT::getObjectBytes(obj));
+    }
+    for (int i = 0; i < (int)mLiveYoungObjs.size(); ++i) {
+        ObjectT *obj = mLiveYoungObjs[i];
+        memcpy(mCompactBase + mLiveYoungOffsets[i], obj, ManagerT::getObjectBytes(obj));
+    }
+
+    if (!newHeap.empty()) {
+        std::swap(mOldHeap, newHeap);
+    }
+    mFreeOfOldHeap = liveBytes;
+    mFreeOfNursery = 0;
+
+    for (int off = 0; off < mFreeOfOldHeap; ) {
+        ObjectT *obj = objectAt(&mOldHeap[off]);
+        obj->unmark();
+        off += ManagerT::getObjectBytes(obj);
+    }
+    // no young object left, so nothing to remember
+    resetOldHeapCards();
+
+    mLiveOldObjs.clear();
+    mLiveYoungObjs.clear();
+    mCompactBase = nullptr;
+
+    mPhase = GCP_None;
+    manager()->onGCFinished(true);
+
+    recordPause(1, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+template<typename ManagerT, typename ObjectT>
+void GenerationalHeap<ManagerT, ObjectT>::recordPause(int kind, double us) {
+    int bucket = 0;
+    for (double limit = 1; bucket < HISTOGRAM_BUCKETS - 1 && us >= limit; limit *= 2) ++bucket;
+
+    ++mPauseHistogram[kind][bucket];
+    mPauseTotal[kind] += us;
+    mPauseMax[kind] = std::max(mPauseMax[kind], us);
+}
+
+template<typename ManagerT, typename ObjectT>
+void GenerationalHeap<ManagerT, ObjectT>::printGCStats(std::ostream &so) const {
+    const char *names[] = {"minor", "full"};
+
+    so << "gc pause histogram:" << std::endl;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket) {
+        if (mPauseHistogram[0][bucket] == 0 && mPauseHistogram[1][bucket] == 0) continue;
+
+        std::string range = bucket == 0 ? std::string("< 1us") :
+            (bucket == HISTOGRAM_BUCKETS - 1 ? format(">= %dus", 1 << (bucket - 1)) : format("%d~%dus", 1 << (bucket - 1), 1 << bucket));
+        so << format("  %-14s minor %-6d full %-6d", range.c_str(), mPauseHistogram[0][bucket], mPauseHistogram[1][bucket]) << std::endl;
+    }
+
+    for (int kind = 0; kind < 2; ++kind) {
+        int count = 0;
+        for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket) count += mPauseHistogram[kind][bucket];
+
+        so << format("  %s: count=%d, total=%.3fms, max=%.3fms", names[kind], count, mPauseTotal[kind] / 1000, mPauseMax[kind] / 1000) << std::endl;
+    }
+    so << format("  promoted=%dKB, old heap=%dKB/%dKB", mPromotedBytes / 1024, mFreeOfOldHeap / 1024, (int)mOldHeap.size() / 1024) << std::endl;
+}
+
+#endif
@@ -0,0 +1,448 @@
+#include "pch.h"
+
+#include <string.h>
+#include <assert.h>
+
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FMIndex.h"
+#include "SuffixArray.h"
+
+//------------------------------
+// BitVector
+
+void BitVector::buildRanks(const uint64_t *words, uint64_t size, uint32_t *ranks) {
+    size_t wordCount = getWordCount(size);
+    uint32_t sum = 0;
+    for (size_t w = 0; w < wordCount; ++w) {
+        if (w % BLOCK_WORDS == 0) ranks[w / BLOCK_WORDS] = sum;
+        sum += __builtin_popcountll(words[w]);
+    }
+    if (wordCount % BLOCK_WORDS == 0) ranks[wordCount / BLOCK_WORDS] = sum;
+}
+
+uint64_t BitVector::rank1(uint64_t i) const {
+    uint64_t w = i / 64, r = m_ranks[w / BLOCK_WORDS];
+    for (uint64_t j = w / BLOCK_WORDS * BLOCK_WORDS; j < w; ++j) r += __builtin_popcountll(m_words[j]);
+    if (i % 64 != 0) r += __builtin_popcountll(m_words[w] & ((1ULL << (i % 64)) - 1));
+    return r;
+}
+
+uint64_t BitVector::select1(uint64_t k) const {
+    // the last block with fewer than k + 1 ones before it
+    size_t lo = 0, hi = getBlockCount(m_size);
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (m_ranks[mid] <= k) lo = mid;
+        else hi = mid;
+    }
+    k -= m_ranks[lo];
+    for (size_t w = lo * BLOCK_WORDS; ; ++w) {
+        uint64_t word = m_words[w];
+        uint64_t count = __builtin_popcountll(word);
+        if (k < count) {
+            for (; k > 0; --k) word &= word - 1;
+            return w * 64 + __builtin_ctzll(word);
+        }
+        k -= count;
+    }
+}
+
+//------------------------------
+// File layout
+
+static const char MAGIC[8] = {'F', 'M', 'I', 'N', 'D', 'E', 'X', '2'};
+static const int MAX_LEVELS = 16;
+// '\0' is the smallest byte, so it is always symbol 1 after the sentinel
+static const int SEPARATOR = 1;
+
+struct FMIndex::Header {
+    char magic[8];
+    uint64_t fileSize;
+    uint64_t textLength;    // bytes of text with the '\0' after every string; the BWT has one more row
+    uint64_t stringCount;
+    uint32_t sigma;         // symbols, the sentinel 0 included
+    uint32_t levelCount;
+    uint32_t sampleStep;
+    uint32_t reserved;
+    uint64_t sourceSize;    // what build was told about the file the strings came from
+    uint64_t sourceTime;
+
+    uint64_t symbolsOffset;
+    uint64_t countsOffset;
+    uint64_t levelZerosOffset;
+    uint64_t symbolStartsOffset;
+    uint64_t levelWordsOffset[MAX_LEVELS];
+    uint64_t levelRanksOffset[MAX_LEVELS];
+    uint64_t sampledWordsOffset, sampledRanksOffset;
+    uint64_t samplesOffset;
+    uint64_t startsWordsOffset, startsRanksOffset;
+    uint64_t separatorStringsOffset;
+    uint64_t textOffset;
+};
+
+// Appends 8-byte aligned sections and hands back their offsets
+class SectionWriter {
+public:
+    SectionWriter(FILE *f): m_file(f), m_offset(0), m_failed(false) {}
+    template<typename T>
+    uint64_t write(const T *data, size_t count) {
+        uint64_t offset = m_offset;
+        size_t bytes = count * sizeof(T);
+        if (bytes > 0 && fwrite(data, 1, bytes, m_file) != bytes) m_failed = true;
+        static const char ZEROS[8] = {0};
+        size_t pad = (8 - bytes % 8) % 8;
+        if (pad > 0 && fwrite(ZEROS, 1, pad, m_file) != pad) m_failed = true;
+        m_offset += bytes + pad;
+        return offset;
+    }
+    uint64_t getOffset() const { return m_offset; }
+    bool failed() const { return m_failed; }
+private:
+    FILE *m_file;
+    uint64_t m_offset;
+    bool m_failed;
+};
+
+struct BitVectorData {
+    vector<uint64_t> words;
+    vector<uint32_t> ranks;
+    uint64_t size;
+
+    void init(uint64_t _size) {
+        size = _size;
+        words.assign(BitVector::getWordCount(size), 0);
+    }
+    void set(uint64_t i) { words[i / 64] |= 1ULL << (i % 64); }
+    void finish() {
+        ranks.resize(BitVector::getBlockCount(size));
+        BitVector::buildRanks(words.data(), size, ranks.data());
+    }
+    void attachTo(BitVector &bv) const { bv.attach(words.data(), ranks.data(), size); }
+};
+
+//------------------------------
+// Build
+
+bool FMIndex::build(const vector<string> &strs, const char *path, int sampleStep,
+        uint64_t sourceSize, uint64_t sourceTime) {
+    if (sampleStep <= 0) return false;
+
+    string text;
+    for (int i = 0; i < (int)strs.size(); ++i) {
+        assert(strs[i].find('\0') == string::npos);
+        text += strs[i];
+        text += '\0';
+    }
+    uint64_t n = text.size(), rows = n + 1;
+    if (rows > 0x7fffffff) return false;
+
+    // the bytes in use become 1..sigma-1 in byte order, the sentinel is 0
+    uint16_t symbols[256] = {0};
+    for (uint64_t i = 0; i < n; ++i) symbols[(unsigned char)text[i]] = 1;
+    int sigma = 1;
+    for (int c = 0; c < 256; ++c) {
+        if (symbols[c]) symbols[c] = (uint16_t)sigma++;
+    }
+    int levelCount = 1;
+    while ((1 << levelCount) < sigma) ++levelCount;
+
+    // suffix array, then the BWT and the samples from it
+    vector<uint16_t> bwt(rows);
+    vector<uint64_t> counts(sigma + 1, 0);
+    BitVectorData sampled;
+    vector<uint32_t> samples;
+    vector<uint32_t> separatorStrings;
+    {
+        vector<int> s(rows), sa(rows);
+        for (uint64_t i = 0; i < n; ++i) s[i] = symbols[(unsigned char)text[i]];
+        s[n] = 0;
+        buildSuffixArray(s.data(), sa.data(), (int)rows, sigma);
+
+        sampled.init(rows);
+        for (uint64_t i = 0; i < rows; ++i) {
+            bwt[i] = (uint16_t)(sa[i] == 0 ? 0 : s[sa[i] - 1]);
+            ++counts[s[i] + 1];
+            if (sa[i] % sampleStep == 0) {
+                sampled.set(i);
+                samples.push_back(sa[i] / sampleStep);
+            }
+        }
+        sampled.finish();
+        for (int c = 0; c < sigma; ++c) counts[c + 1] += counts[c];
+
+        // the '\0' rows are sorted by the string after them; the last '\0' has none, it is
+        // followed by the sentinel
+        vector<uint64_t> stringStarts(strs.size());
+        for (uint64_t i = 0, pos = 0; i < strs.size(); pos += strs[i].size() + 1, ++i) stringStarts[i] = pos;
+        for (uint64_t i = counts[SEPARATOR]; i < rows && s[sa[i]] == SEPARATOR; ++i) {
+            uint64_t next = sa[i] + 1;
+            separatorStrings.push_back((uint32_t)(lower_bound(stringStarts.begin(), stringStarts.end(), next)
+                        - stringStarts.begin()));
+        }
+    }
+
+    // wavelet matrix: level l holds bit (levelCount - 1 - l) of every symbol, and the next level
+    // sees them stably partitioned by that bit, zeros first
+    vector<BitVectorData> levels(levelCount);
+    vector<uint64_t> levelZeros(levelCount);
+    {
+        vector<uint16_t> next(rows);
+        for (int l = 0; l < levelCount; ++l) {
+            int shift = levelCount - 1 - l;
+            BitVectorData &level = levels[l];
+            level.init(rows);
+            uint64_t zeros = 0;
+            for (uint64_t i = 0; i < rows; ++i) {
+                if ((bwt[i] >> shift) & 1) level.set(i);
+                else ++zeros;
+            }
+            level.finish();
+            levelZeros[l] = zeros;
+
+            uint64_t z = 0, o = zeros;
+            for (uint64_t i = 0; i < rows; ++i) {
+                if ((bwt[i] >> shift) & 1) next[o++] = bwt[i];
+                else next[z++] = bwt[i];
+            }
+            bwt.swap(next);
+        }
+    }
+    vector<uint64_t> symbolStarts(sigma);
+    for (int c = 0; c < sigma; ++c) {
+        uint64_t p = 0;
+        for (int l = 0; l < levelCount; ++l) {
+            BitVector bv;
+            levels[l].attachTo(bv);
+            uint64_t r1 = bv.rank1(p);
+            p = (c >> (levelCount - 1 - l)) & 1 ? levelZeros[l] + r1 : p - r1;
+        }
+        symbolStarts[c] = p;
+    }
+
+    BitVectorData starts;
+    starts.init(n);
+    for (uint64_t i = 0; i < n; ++i) {
+        if (i == 0 || text[i - 1] == '\0') starts.set(i);
+    }
+    starts.finish();
+
+    // Written beside the target and renamed over it, so a process that has the old file mapped
+    // keeps reading the old inode instead of getting SIGBUS when it is truncated
+    string tmpPath = string(path) + ".tmp";
+    FILE *f = fopen(tmpPath.c_str(), "wb");
+    if (f == NULL) return false;
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    SectionWriter writer(f);
+    writer.write(&header, 1);
+
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.textLength = n;
+    header.stringCount = strs.size();
+    header.sigma = sigma;
+    header.levelCount = levelCount;
+    header.sampleStep = sampleStep;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.symbolsOffset = writer.write(symbols, 256);
+    header.countsOffset = writer.write(counts.data(), counts.size());
+    header.levelZerosOffset = writer.write(levelZeros.data(), levelZeros.size());
+    header.symbolStartsOffset = writer.write(symbolStarts.data(), symbolStarts.size());
+    for (int l = 0; l < levelCount; ++l) {
+        header.levelWordsOffset[l] = writer.write(levels[l].words.data(), levels[l].words.size());
+        header.levelRanksOffset[l] = writer.write(levels[l].ranks.data(), levels[l].ranks.size());
+    }
+    header.sampledWordsOffset = writer.write(sampled.words.data(), sampled.words.size());
+    header.sampledRanksOffset = writer.write(sampled.ranks.data(), sampled.ranks.size());
+    header.samplesOffset = writer.write(samples.data(), samples.size());
+    header.startsWordsOffset = writer.write(starts.words.data(), starts.words.size());
+    header.startsRanksOffset = writer.write(starts.ranks.data(), starts.ranks.size());
+    header.separatorStringsOffset = writer.write(separatorStrings.data(), separatorStrings.size());
+    header.textOffset = writer.write(text.data(), text.size());
+    header.fileSize = writer.getOffset();
+
+    bool ok = !writer.failed() && fseek(f, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, f) == 1
+        && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok && rename(tmpPath.c_str(), path) == 0;
+    if (!ok) unlink(tmpPath.c_str());
+    return ok;
+}
+
+//------------------------------
+// Load
+
+FMIndex::FMIndex(): m_file(NULL), m_fileSize(0), m_header(NULL) {
+}
+
+FMIndex::~FMIndex() {
+    unload();
+}
+
+bool FMIndex::load(const char *path) {
+    unload();
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return false;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Header)) {
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) return false;
+
+    m_file = (const char*)p;
+    m_fileSize = st.st_size;
+    m_header = (const Header*)m_file;
+    if (memcmp(m_header->magic, MAGIC, sizeof(MAGIC)) != 0 || m_header->fileSize != m_fileSize
+            || m_header->levelCount > MAX_LEVELS) {
+        unload();
+        return false;
+    }
+
+    const Header &h = *m_header;
+    uint64_t rows = h.textLength + 1;
+    m_symbols = (const uint16_t*)(m_file + h.symbolsOffset);
+    m_counts = (const uint64_t*)(m_file + h.countsOffset);
+    m_levelZeros = (const uint64_t*)(m_file + h.levelZerosOffset);
+    m_symbolStarts = (const uint64_t*)(m_file + h.symbolStartsOffset);
+    m_levels.resize(h.levelCount);
+    for (int l = 0; l < (int)h.levelCount; ++l) {
+        m_levels[l].attach((const uint64_t*)(m_file + h.levelWordsOffset[l]),
+                (const uint32_t*)(m_file + h.levelRanksOffset[l]), rows);
+    }
+    m_sampled.attach((const uint64_t*)(m_file + h.sampledWordsOffset),
+            (const uint32_t*)(m_file + h.sampledRanksOffset), rows);
+    m_samples = (const uint32_t*)(m_file + h.samplesOffset);
+    m_starts.attach((const uint64_t*)(m_file + h.startsWordsOffset),
+            (const uint32_t*)(m_file + h.startsRanksOffset), h.textLength);
+    m_separatorStrings = (const uint32_t*)(m_file + h.separatorStringsOffset);
+    m_text = m_file + h.textOffset;
+    return true;
+}
+
+void FMIndex::unload() {
+    if (m_file != NULL) munmap((void*)m_file, m_fileSize);
+    m_file = NULL;
+    m_fileSize = 0;
+    m_header = NULL;
+    m_levels.clear();
+}
+
+int FMIndex::getStringCount() const {
+    return (int)m_header->stringCount;
+}
+
+uint64_t FMIndex::getSourceSize() const {
+    return m_header->sourceSize;
+}
+
+uint64_t FMIndex::getSourceTime() const {
+    return m_header->sourceTime;
+}
+
+uint64_t FMIndex::getTextLength() const {
+    return m_header->textLength;
+}
+
+//------------------------------
+// Queries
+
+// occurrences of c in BWT rows [0, i): follow c's bits down the levels
+uint64_t FMIndex::_rank(int c, uint64_t i) const {
+    int levelCount = (int)m_header->levelCount;
+    for (int l = 0; l < levelCount; ++l) {
+        uint64_t r1 = m_levels[l].rank1(i);
+        i = (c >> (levelCount - 1 - l)) & 1 ? m_levelZeros[l] + r1 : i - r1;
+    }
+    return i - m_symbolStarts[c];
+}
+
+// the symbol in row i and its occurrences before it, in one walk down the levels
+int FMIndex::_accessRank(uint64_t i, uint64_t &rank) const {
+    int c = 0;
+    for (int l = 0; l < (int)m_header->levelCount; ++l) {
+        int bit = m_levels[l].get(i);
+        uint64_t r1 = m_levels[l].rank1(i);
+        c = (c << 1) | bit;
+        i = bit ? m_levelZeros[l] + r1 : i - r1;
+    }
+    rank = i - m_symbolStarts[c];
+    return c;
+}
+
+// The rows [sp, ep) whose suffixes start with pattern. Row 0 is the sentinel's empty suffix,
+// which nothing but the empty pattern would match, so it is left out from the start.
+bool FMIndex::_backwardSearch(const char *pattern, uint64_t &sp, uint64_t &ep) const {
+    sp = 1, ep = m_header->textLength + 1;
+    for (int i = (int)strlen(pattern) - 1; i >= 0 && sp < ep; --i) {
+        int c = m_symbols[(unsigned char)pattern[i]];
+        if (c == 0) return false;
+        sp = m_counts[c] + _rank(c, sp);
+        ep = m_counts[c] + _rank(c, ep);
+    }
+    return sp < ep;
+}
+
+// LF steps back to a sampled row; the sentinel's row is sampled (its suffix starts at 0), so
+// the walk never has to step over it
+uint64_t FMIndex::_locate(uint64_t row) const {
+    uint64_t steps = 0;
+    while (!m_sampled.get(row)) {
+        uint64_t rank;
+        int c = _accessRank(row, rank);
+        row = m_counts[c] + rank;
+        ++steps;
+    }
+    return (uint64_t)m_samples[m_sampled.rank1(row)] * m_header->sampleStep + steps;
+}
+
+uint64_t FMIndex::count(const char *pattern) const {
+    uint64_t sp, ep;
+    return _backwardSearch(pattern, sp, ep) ? ep - sp : 0;
+}
+
+void FMIndex::locate(const char *pattern, vector<uint64_t> &positions) const {
+    positions.clear();
+    uint64_t sp, ep;
+    if (!_backwardSearch(pattern, sp, ep)) return;
+    positions.reserve(ep - sp);
+    for (uint64_t row = sp; row < ep; ++row) positions.push_back(_locate(row));
+}
+
+// Like _locate, but it only needs the string: the walk also stops when it is about to step back
+// over the '\0' in front of it, and that '\0' row's rank says which string follows.
+int FMIndex::_locateString(uint64_t row) const {
+    uint64_t steps = 0;
+    while (!m_sampled.get(row)) {
+        uint64_t rank;
+        int c = _accessRank(row, rank);
+        if (c == SEPARATOR) return (int)m_separatorStrings[rank];
+        row = m_counts[c] + rank;
+        ++steps;
+    }
+    uint64_t pos = (uint64_t)m_samples[m_sampled.rank1(row)] * m_header->sampleStep + steps;
+    return (int)m_starts.rank1(pos + 1) - 1;
+}
+
+void FMIndex::findStrings(const char *pattern, vector<int> &ids) const {
+    ids.clear();
+    if (*pattern == '\0') {
+        for (int i = 0; i < getStringCount(); ++i) ids.push_back(i);
+        return;
+    }
+
+    uint64_t sp, ep;
+    if (!_backwardSearch(pattern, sp, ep)) return;
+    ids.reserve(ep - sp);
+    for (uint64_t row = sp; row < ep; ++row) ids.push_back(_locateString(row));
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+}
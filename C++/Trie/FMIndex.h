@@ -0,0 +1,101 @@
+#ifndef FM_INDEX_H
+#define FM_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+// Read-only bit vector over words and a rank directory that live elsewhere (an mmap'd file):
+// a 32 bit count of the ones before every 256 bits, 1/8 on top of the bits.
+class BitVector {
+public:
+    static const int BLOCK_WORDS = 4;
+
+    static size_t getWordCount(uint64_t size) { return (size_t)((size + 63) / 64); }
+    static size_t getBlockCount(uint64_t size) { return getWordCount(size) / BLOCK_WORDS + 1; }
+    static void buildRanks(const uint64_t *words, uint64_t size, uint32_t *ranks);
+
+    BitVector(): m_words(NULL), m_ranks(NULL), m_size(0) {}
+    void attach(const uint64_t *words, const uint32_t *ranks, uint64_t size) {
+        m_words = words, m_ranks = ranks, m_size = size;
+    }
+
+    uint64_t size() const { return m_size; }
+    bool get(uint64_t i) const { return (m_words[i / 64] >> (i % 64)) & 1; }
+    // ones in [0, i)
+    uint64_t rank1(uint64_t i) const;
+    // position of the one with rank k, k < rank1(size())
+    uint64_t select1(uint64_t k) const;
+
+private:
+    const uint64_t *m_words;
+    const uint32_t *m_ranks;
+    uint64_t m_size;
+};
+
+// FM-index of a set of strings: the BWT of "s0\0s1\0...\0" plus a sentinel in a wavelet matrix,
+// the suffix array sampled every sampleStep text positions, a bit vector of string starts, the
+// string after each '\0' and the text itself. A count is |pattern| rank pairs, a locate up to
+// sampleStep LF steps more per occurrence (findStrings stops at the string start instead), and
+// the whole index is 2.5-3 bytes per input character for names of around 10 characters.
+//
+// The index is built straight into a file and only ever used from the file mmap'd read-only,
+// so loading costs nothing up front and several processes share the pages. The file is
+// native-endian: a header, then 8-byte aligned sections at the offsets it records.
+class FMIndex {
+public:
+    // Strings may not contain '\0' and sampleStep must be positive. sourceSize and sourceTime are
+    // only stored, for the caller to tell whether the file the strings came from changed since (see
+    // getSourceSize). The file is replaced by a rename, so an FMIndex loaded from the old one keeps
+    // working.
+    static bool build(const std::vector<std::string> &strs, const char *path, int sampleStep = 32,
+            uint64_t sourceSize = 0, uint64_t sourceTime = 0);
+
+    FMIndex();
+    ~FMIndex();
+    bool load(const char *path);
+    void unload();
+
+    // occurrences of pattern in the strings; an empty pattern matches everywhere
+    uint64_t count(const char *pattern) const;
+    // text offsets of the occurrences, in no particular order
+    void locate(const char *pattern, std::vector<uint64_t> &positions) const;
+    // ids of the strings containing pattern, ascending and each once
+    void findStrings(const char *pattern, std::vector<int> &ids) const;
+
+    int getStringCount() const;
+    const char* getString(int id) const { return m_text + m_starts.select1(id); }
+    uint64_t getTextLength() const;
+    uint64_t getSourceSize() const;
+    uint64_t getSourceTime() const;
+    size_t getFileSize() const { return m_fileSize; }
+
+private:
+    struct Header;
+
+    bool _backwardSearch(const char *pattern, uint64_t &sp, uint64_t &ep) const;
+    uint64_t _rank(int c, uint64_t i) const;
+    int _accessRank(uint64_t i, uint64_t &rank) const;
+    uint64_t _locate(uint64_t row) const;
+    int _locateString(uint64_t row) const;
+
+private:
+    const char *m_file;
+    size_t m_fileSize;
+    const Header *m_header;
+
+    const uint16_t *m_symbols;      // byte -> symbol, 0 for bytes that aren't in the text
+    const uint64_t *m_counts;       // symbols smaller than c, sigma + 1 entries
+    const uint64_t *m_levelZeros;   // zeros on each wavelet level
+    const uint64_t *m_symbolStarts; // where each symbol's run starts after the last level
+    std::vector<BitVector> m_levels;
+    BitVector m_sampled;            // BWT rows whose suffix array value is sampled
+    const uint32_t *m_samples;      // their values / sampleStep, by row
+    BitVector m_starts;             // text positions that start a string
+    const uint32_t *m_separatorStrings; // the string after each '\0' row of the BWT's first column
+    const char *m_text;
+};
+
+#endif // #ifndef FM_INDEX_H
@@ -0,0 +1,103 @@
+#include "pch.h"
+
+#include <vector>
+#include <algorithm>
+
+#include "SuffixArray.h"
+
+// The start (or one past the end) of every character's bucket in the suffix array
+static void getBuckets(const int *s, int n, int k, vector<int> &bkt, bool end) {
+    fill(bkt.begin(), bkt.end(), 0);
+    for (int i = 0; i < n; ++i) ++bkt[s[i]];
+    for (int c = 0, sum = 0; c < k; ++c) {
+        sum += bkt[c];
+        bkt[c] = end ? sum : sum - bkt[c];
+    }
+}
+
+// From the LMS suffixes at their bucket ends: L-type suffixes left to right from the bucket
+// starts, then S-type suffixes right to left from the bucket ends.
+static void induce(const int *s, int *sa, const vector<char> &stype, int n, int k, vector<int> &bkt) {
+    getBuckets(s, n, k, bkt, false);
+    for (int i = 0; i < n; ++i) {
+        int j = sa[i] - 1;
+        if (sa[i] > 0 && !stype[j]) sa[bkt[s[j]]++] = j;
+    }
+    getBuckets(s, n, k, bkt, true);
+    for (int i = n - 1; i >= 0; --i) {
+        int j = sa[i] - 1;
+        if (sa[i] > 0 && stype[j]) sa[--bkt[s[j]]] = j;
+    }
+}
+
+void buildSuffixArray(const int *s, int *sa, int n, int k) {
+    if (n == 1) {
+        sa[0] = 0;
+        return;
+    }
+
+    // suffix i is S-type if it is smaller than suffix i + 1; LMS if S-type after an L-type
+    vector<char> stype(n);
+    stype[n - 1] = 1;
+    for (int i = n - 2; i >= 0; --i) {
+        stype[i] = s[i] < s[i + 1] || (s[i] == s[i + 1] && stype[i + 1]);
+    }
+    auto isLMS = [&](int i) { return i > 0 && stype[i] && !stype[i - 1]; };
+
+    // 1. sort the LMS substrings by one induction from their unsorted positions
+    vector<int> bkt(k);
+    getBuckets(s, n, k, bkt, true);
+    fill(sa, sa + n, -1);
+    for (int i = 1; i < n; ++i) {
+        if (isLMS(i)) sa[--bkt[s[i]]] = i;
+    }
+    induce(s, sa, stype, n, k, bkt);
+
+    int n1 = 0;
+    for (int i = 0; i < n; ++i) {
+        if (isLMS(sa[i])) sa[n1++] = sa[i];
+    }
+
+    // 2. name them, equal substrings getting equal names; no two LMS positions are adjacent,
+    // so pos / 2 is a free slot in the upper half
+    fill(sa + n1, sa + n, -1);
+    int name = 0;
+    for (int i = 0, prev = -1; i < n1; ++i) {
+        int pos = sa[i];
+        bool diff = prev < 0;
+        for (int d = 0; !diff; ++d) {
+            if (s[pos + d] != s[prev + d] || stype[pos + d] != stype[prev + d]) diff = true;
+            else if (d > 0 && (isLMS(pos + d) || isLMS(prev + d))) break;
+        }
+        if (diff) {
+            ++name;
+            prev = pos;
+        }
+        sa[n1 + pos / 2] = name - 1;
+    }
+    for (int i = n - 1, j = n - 1; i >= n1; --i) {
+        if (sa[i] >= 0) sa[j--] = sa[i];
+    }
+
+    // 3. sort the LMS suffixes: recursively if the names aren't unique yet
+    int *s1 = sa + n - n1, *sa1 = sa;
+    if (name < n1) {
+        buildSuffixArray(s1, sa1, n1, name);
+    } else {
+        for (int i = 0; i < n1; ++i) sa1[s1[i]] = i;
+    }
+
+    // 4. induce every suffix from the sorted LMS suffixes
+    for (int i = 1, j = 0; i < n; ++i) {
+        if (isLMS(i)) s1[j++] = i;
+    }
+    for (int i = 0; i < n1; ++i) sa1[i] = s1[sa1[i]];
+    fill(sa + n1, sa + n, -1);
+    getBuckets(s, n, k, bkt, true);
+    for (int i = n1 - 1; i >= 0; --i) {
+        int j = sa[i];
+        sa[i] = -1;
+        sa[--bkt[s[j]]] = j;
+    }
+    induce(s, sa, stype, n, k, bkt);
+}
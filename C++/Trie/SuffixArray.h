@@ -0,0 +1,9 @@
+#ifndef SUFFIX_ARRAY_H
+#define SUFFIX_ARRAY_H
+
+// Suffix array of s[0, n) over the alphabet [0, k) by SA-IS (Nong, Zhang & Chan, 2009), in
+// linear time. s[n - 1] must be 0 and the only 0. sa needs n ints; the recursion reuses it, so
+// the extra memory is the n bytes of suffix types and the buckets.
+void buildSuffixArray(const int *s, int *sa, int n, int k);
+
+#endif // #ifndef SUFFIX_ARRAY_H
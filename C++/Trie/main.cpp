@@ -1,101 +1,126 @@
-#include "pch.h" 
+#include "pch.h"
 
 #include <string.h>
 #include <time.h>
+#include <ctype.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <string>
 #include <vector>
-#include <unordered_set>
 #include <fstream>
 #include <iostream>
 #include <algorithm>
-#include <iterator>
 using namespace std;
 
-class Trie {
-public:
-    void insert(const string &str) {
-        for (int i = 0; i < (int)str.size(); ++i) {
-            _insert(_getStrPtr(str), str.c_str() + i, (int)str.size() - i);
+#include "FMIndex.h"
+
+#ifndef NDEBUG
+
+// count, locate and findStrings against string::find over random strings of a small alphabet,
+// so matches repeat and overlap; 'e' is in the patterns but never in the text
+static void testFMIndex() {
+    const char *path = "fm_index_test.fm";
+    vector<string> strs;
+    assert(!FMIndex::build(strs, path, 0));
+
+    srand(1);
+    int sampleSteps[] = {1, 3, 32};
+    for (int round = 0; round < 30; ++round) {
+        strs.assign(rand() % 50, string());
+        for (int i = 0; i < (int)strs.size(); ++i) {
+            for (int len = rand() % 20; len > 0; --len) strs[i] += "abcd"[rand() % (round % 3 + 2)];
         }
-    }
-    unordered_set<const char*>* get(const char* s) const {
-        Node *n = m_root;
-        for (; n && *s; n = n->getChild(*s), ++s);
-        return n ? &n->strs : NULL;
-    }
-    Trie(): m_root(new Node(0)){}
-    ~Trie() { m_root->destroy();}
-    int getNodeCount() const { return m_root->getNodeCount(); }
-private:
-    struct Node {
-        vector<Node*> childs;
-        unordered_set<const char*> strs;
-        int value;
-        Node(int v): value(v) {}
-        Node* getOrCreateChild(unsigned char c) {
-            Node *p = getChild(c);
-            if (p) return p;
-            childs.push_back(p = new Node(c));
-            return p;
+        string text;
+        vector<int> owners;
+        for (int i = 0; i < (int)strs.size(); ++i) {
+            text += strs[i];
+            text += '\0';
+            owners.resize(text.size(), i);
         }
-        Node* getChild(unsigned char c) {
-            for (int i = 0; i < (int)childs.size(); ++i) {
-                if (childs[i]->value == c) return childs[i];
+
+        FMIndex index;
+        assert(FMIndex::build(strs, path, sampleSteps[round % 3]) && index.load(path));
+        assert(index.getStringCount() == (int)strs.size() && index.getTextLength() == text.size());
+        for (int i = 0; i < (int)strs.size(); ++i) assert(strs[i] == index.getString(i));
+
+        vector<uint64_t> positions;
+        vector<int> ids;
+        for (int q = 0; q < 100; ++q) {
+            string pattern;
+            for (int len = rand() % 5 + 1; len > 0; --len) pattern += "abcde"[rand() % 5];
+
+            vector<uint64_t> expectedPositions;
+            vector<int> expectedIds;
+            for (size_t p = text.find(pattern); p != string::npos; p = text.find(pattern, p + 1)) {
+                expectedPositions.push_back(p);
+                if (expectedIds.empty() || expectedIds.back() != owners[p]) expectedIds.push_back(owners[p]);
             }
-            return NULL;
-        }
-        void destroy() {
-            for (int i = 0; i < (int)childs.size(); ++i) childs[i]->destroy();
-            delete this;
+            assert(index.count(pattern.c_str()) == expectedPositions.size());
+            index.locate(pattern.c_str(), positions);
+            sort(positions.begin(), positions.end());
+            assert(positions == expectedPositions);
+            index.findStrings(pattern.c_str(), ids);
+            assert(ids == expectedIds);
         }
-        int getNodeCount() {
-            int sum = 1;
-            for (int i = 0; i < (int)childs.size(); ++i) sum += childs[i]->getNodeCount();
-            return sum;
-        }
-    };
-private:
-    void _insert(const char* src, const char *s, int len) {
-        Node *n = m_root;
-        for (int i = 0; i <= len; ++i) {
-            if (i > 0) n->strs.insert(src);
-            if (i < len) n = n->getOrCreateChild(s[i]);
-        }
-    }
-    const char* _getStrPtr(const string& src) {
-        return m_strPool.insert(src).first->c_str();
     }
-private:
-    Node *m_root;
-    unordered_set<string> m_strPool;
-};
+    unlink(path);
+}
+
+#endif
 
-int main() {
-    Trie t;
+// usage: main [words file, 1.txt by default]
+// The index of the words goes next to it as <file>.fm and is reused while the words file keeps
+// the size and modification time recorded in it.
+int main(int argc, char *argv[]) {
+#ifndef NDEBUG
+    testFMIndex();
+#endif
 
-    getchar();
+    string wordsPath = argc > 1 ? argv[1] : "1.txt";
+    string indexPath = wordsPath + ".fm";
 
-    {
+    uint64_t wordsSize = 0, wordsTime = 0;
+    struct stat st;
+    if (stat(wordsPath.c_str(), &st) == 0) {
+        wordsSize = st.st_size;
+        wordsTime = st.st_mtime;
+    }
+
+    FMIndex index;
+    if (!index.load(indexPath.c_str()) || index.getSourceSize() != wordsSize || index.getSourceTime() != wordsTime) {
         clock_t start = clock();
-        ifstream fi("1.txt");
+        ifstream fi(wordsPath.c_str());
         int n = 0;
+        vector<string> words;
         for (string w; fi >> w; ) {
             int i = 0;
             for (; i < (int)w.size() && !isalnum(w[i]); ++i);
             int j = i;
             for (; j < (int)w.size() && isalnum(w[j]); ++j);
             ++n;
-            t.insert(w.substr(i, j - i));
+            if (j > i) words.push_back(w.substr(i, j - i));
+        }
+        sort(words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
+
+        if (!FMIndex::build(words, indexPath.c_str(), 32, wordsSize, wordsTime) || !index.load(indexPath.c_str())) {
+            printf("failed to build %s\n", indexPath.c_str());
+            return 1;
         }
-        printf("read %d words, cose %fs, %d nodes\n", n, float(clock() - start) / CLOCKS_PER_SEC, t.getNodeCount());
+        printf("read %d words, cost %fs\n", n, float(clock() - start) / CLOCKS_PER_SEC);
     }
+    printf("%d strings, %llu chars, index %llu bytes (%.2f bytes/char)\n",
+            index.getStringCount(), (unsigned long long)index.getTextLength(),
+            (unsigned long long)index.getFileSize(), index.getFileSize() / double(max<uint64_t>(1, index.getTextLength())));
 
+    vector<int> ids;
     for (string line; getline(cin, line); ) {
-        unordered_set<const char*> *res = t.get(line.c_str());
-        if (res != NULL) {
-            copy(res->begin(), res->end(), ostream_iterator<string>(cout, ","));
+        if (!line.empty()) {
+            index.findStrings(line.c_str(), ids);
+            for (int i = 0; i < (int)ids.size(); ++i) printf("%s,", index.getString(ids[i]));
         }
         puts("");
     }
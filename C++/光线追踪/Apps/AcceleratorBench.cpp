@@ -0,0 +1,191 @@
+// vim: fileencoding=gbk
+#include "pch.h"
+
+#include <cassert>
+#include <cmath>
+#include <ctime>
+
+#include <vector>
+#include <string>
+#include <sstream>
+
+#include "Mesh.h"
+#include "Matrix.h"
+#include "Geometry.h"
+#include "Traceable.h"
+#include "TriTraceAccelerator.h"
+
+// Scene.txtдٽṹ
+static const char *g_acceleratorConfigs[] = {
+    "TriTraceAccelerator {\n"
+    "    type: KDTree\n"
+    "    KDTree {\n"
+    "        maxDepth: 18\n"
+    "        minTriCntPerNode: 1\n"
+    "        splitTest: 128\n"
+    "    }\n"
+    "}\n",
+    "TriTraceAccelerator {\n"
+    "    type: BVH\n"
+    "    BVH {\n"
+    "        maxLeafTriCnt: 4\n"
+    "        binCnt: 16\n"
+    "    }\n"
+    "}\n",
+};
+static const int PACKET_SIZE = 64;
+
+static float getSeconds(clock_t c)
+{
+    return float(clock() - c) / CLOCKS_PER_SEC;
+}
+
+// бϷģĵ͸
+static void genCameraRays(std::vector<Ray>& rays, const AABB& bounds, int w, int h)
+{
+    Vector3 center(bounds.minPt);
+    (center += bounds.maxPt) *= 0.5f;
+    float radius = (bounds.maxPt - bounds.minPt).length() * 0.5f;
+    Vector3 eye(center);
+    eye += Vector3(0.6f, 0.5f, -2.f) *= radius;
+    Vector3 forward((center - eye).normalize());
+    Vector3 right(Vector3::AXIS_Y.crossProduct(forward).normalize());
+    Vector3 up(forward.crossProduct(right));
+
+    float tanHalfFov = tan(degree2Radian(30));
+    rays.clear();
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            Vector3 dir(forward);
+            dir += Vector3(right) *= (2 * (x + 0.5f) / w - 1) * tanHalfFov;
+            dir += Vector3(up) *= (1 - 2 * (y + 0.5f) / h) * tanHalfFov;
+            rays.push_back(Ray(eye, dir.normalize()));
+        }
+    }
+}
+
+static void benchAccelerator(const Mesh *mesh, const char *config, const std::vector<Ray>& cameraRays, std::vector<float>& refTs)
+{
+    std::vector<TriTraceAccelerator_Base*> accs;
+    int triCnt = 0;
+    clock_t c = clock();
+    for (int i = 0; i < mesh->getSubCount(); ++i) {
+        std::istringstream si(config);
+        TriTraceAccelerator_Base *p = NULL;
+        si >> p;
+        p->rebuild(mesh->sub(i), Matrix4x4::IDENTITY);
+        triCnt += mesh->sub(i)->indexBuffer.getTriangleCount();
+        accs.push_back(p);
+    }
+    float buildTime = getSeconds(c);
+    {
+        std::ostringstream so;
+        so << accs[0];
+        std::string type = so.str();
+        type = type.substr(type.find("type:") + 5);
+        type = type.substr(0, type.find('\n'));
+        cout << "accelerator" << type << ":" << endl;
+    }
+    cout << "    build: " << buildTime << "s, " << triCnt / std::max(buildTime, 1e-6f) / 1e6f << "M triangles/s" << endl;
+
+    int rayCnt = (int)cameraRays.size();
+    std::vector<float> ts(rayCnt);
+    std::vector<TraceFragment> frags(rayCnt);
+    std::vector<char> hits(rayCnt);
+
+    // 
+    c = clock();
+    for (int i = 0; i < rayCnt; ++i) {
+        ts[i] = MAX_FLOAT;
+        hits[i] = 0;
+        for (int j = 0; j < (int)accs.size(); ++j) {
+            if (accs[j]->intersect(cameraRays[i], EIC_front, ts[i], frags[i])) hits[i] = 1;
+        }
+    }
+    float cameraTime = getSeconds(c);
+
+    // ߰
+    std::vector<float> packetTs(rayCnt, MAX_FLOAT);
+    std::vector<TraceFragment> packetFrags(rayCnt);
+    bool packetHits[PACKET_SIZE];
+    c = clock();
+    for (int i = 0; i < rayCnt; i += PACKET_SIZE) {
+        int n = std::min(PACKET_SIZE, rayCnt - i);
+        for (int j = 0; j < (int)accs.size(); ++j) {
+            accs[j]->intersectPacket(&cameraRays[i], n, EIC_front, &packetTs[i], &packetFrags[i], packetHits);
+        }
+    }
+    float cameraPacketTime = getSeconds(c);
+
+    // е㳯ԴӰ
+    Vector3 lightDir(Vector3(1, 1, -1).normalize());
+    bool isFirst = refTs.empty();
+    std::vector<Ray> shadowRays;
+    int hitCnt = 0, packetDiffCnt = 0, refDiffCnt = 0;
+    for (int i = 0; i < rayCnt; ++i) {
+        if (!fequal(ts[i], packetTs[i], 1e-3f)) ++packetDiffCnt;
+        if (!isFirst && !fequal(ts[i], refTs[i], 1e-3f)) ++refDiffCnt;
+        if (!hits[i]) continue;
+        ++hitCnt;
+        shadowRays.push_back(Ray(frags[i].pos, lightDir));
+    }
+    if (isFirst) refTs = ts;
+
+    int shadowCnt = (int)shadowRays.size(), blockedCnt = 0, packetBlockedCnt = 0;
+    c = clock();
+    for (int i = 0; i < shadowCnt; ++i) {
+        for (int j = 0; j < (int)accs.size(); ++j) {
+            if (accs[j]->intersectTest(shadowRays[i])) {
+                ++blockedCnt;
+                break;
+            }
+        }
+    }
+    float shadowTime = getSeconds(c);
+
+    std::vector<char> blocked(shadowCnt);
+    c = clock();
+    for (int i = 0; i < shadowCnt; i += PACKET_SIZE) {
+        int n = std::min(PACKET_SIZE, shadowCnt - i);
+        for (int j = 0; j < (int)accs.size(); ++j) {
+            accs[j]->intersectTestPacket(&shadowRays[i], n, packetHits);
+            for (int k = 0; k < n; ++k) blocked[i + k] |= packetHits[k];
+        }
+    }
+    float shadowPacketTime = getSeconds(c);
+    for (int i = 0; i < shadowCnt; ++i) packetBlockedCnt += blocked[i];
+
+    cout << "    camera rays: " << rayCnt / std::max(cameraTime, 1e-6f) / 1e6f << "M rays/s, packet: "
+        << rayCnt / std::max(cameraPacketTime, 1e-6f) / 1e6f << "M rays/s, hit: " << hitCnt
+        << ", packet mismatch: " << packetDiffCnt;
+    if (!isFirst) cout << ", mismatch with the first: " << refDiffCnt;
+    cout << endl;
+    cout << "    shadow rays: " << shadowCnt / std::max(shadowTime, 1e-6f) / 1e6f << "M rays/s, packet: "
+        << shadowCnt / std::max(shadowPacketTime, 1e-6f) / 1e6f << "M rays/s, blocked: " << blockedCnt
+        << ", packet blocked: " << packetBlockedCnt << endl;
+
+    for (int i = 0; i < (int)accs.size(); ++i) delete accs[i];
+}
+
+// ڳĿ¼УAcceleratorBench [ģ...]ȽϸٽṹĹʱٶ
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> meshNames;
+    for (int i = 1; i < argc; ++i) meshNames.push_back(argv[i]);
+    if (meshNames.empty()) {
+        meshNames.push_back("mesh_teapot.txt");
+        meshNames.push_back("MengerSponge");
+    }
+
+    for (int i = 0; i < (int)meshNames.size(); ++i) {
+        const Mesh *mesh = MeshManager::instance()->getMesh(meshNames[i]);
+        std::vector<Ray> cameraRays;
+        genCameraRays(cameraRays, mesh->getBoundAABB(), 512, 512);
+        cout << meshNames[i] << ":" << endl;
+
+        std::vector<float> refTs;
+        for (int j = 0; j < sizeof(g_acceleratorConfigs) / sizeof(g_acceleratorConfigs[0]); ++j) {
+            benchAccelerator(mesh, g_acceleratorConfigs[j], cameraRays, refTs);
+        }
+    }
+}
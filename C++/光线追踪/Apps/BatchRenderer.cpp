@@ -0,0 +1,50 @@
+// vim: fileencoding=gbk
+#include "pch.h"
+
+#include <cassert>
+#include <cstdlib>
+
+#include <vector>
+#include <fstream>
+
+#include "VirtualPlatform.h"
+#include "TileRenderer.h"
+#include "Renderer.h"
+
+extern SceneManager* g_sceneMgr;
+extern Renderer* g_renderer;
+
+// ڳĿ¼УҪڣ
+// BatchRenderer [  [.png|.ppm [С [ [Աȶֵ [ÿͳ.csv]]]]]]
+// ÿһ͸дһͼƬԱ߻߿
+int main(int argc, char *argv[])
+{
+    int w = argc > 2 ? atoi(argv[1]) : 400;
+    int h = argc > 2 ? atoi(argv[2]) : 300;
+    const char *outFile = argc > 3 ? argv[3] : "scene.png";
+    assert(w > 0 && h > 0);
+
+    std::vector<char> buf(w * h * 4);
+
+    setupScene();
+    {
+        TileRenderer tileRenderer(g_renderer);
+        if (argc > 4) tileRenderer.setTileSize(atoi(argv[4]));
+        if (argc > 5) tileRenderer.setSuperSampleLevel(atoi(argv[5]));
+        if (argc > 6) tileRenderer.setContrastThreshold((float)atof(argv[6]));
+
+        tileRenderer.beginFrame(g_sceneMgr, &buf[0], w, h, w * 4);
+        while (tileRenderer.renderNextPass()) {
+            if (!saveImage(outFile, &buf[0], w, h, w * 4)) {
+                cout << "failed to save " << outFile << endl;
+            }
+        }
+        tileRenderer.printStats(cout);
+
+        if (argc > 7) {
+            std::ofstream fo(argv[7]);
+            tileRenderer.printTileStats(fo);
+        }
+    }
+    cleanupScene();
+}
@@ -21,7 +21,7 @@ class Entity:
 {
 public:
     Entity(E_SceneObjType t, const std::string& name);
-    virtual ~Entity() = 0{}
+    virtual ~Entity() = 0;
 
     const std::string name() const;
 
@@ -34,6 +34,7 @@ public:
 private:
     std::string m_name;
 };
+inline Entity::~Entity() {}
 
 class StaticEntity:
     public Entity
@@ -10,11 +10,12 @@ class Entity;
 
 struct IEntityController
 {
-    virtual ~IEntityController() = 0 {}
+    virtual ~IEntityController() = 0;
     virtual void onMouseButtonDown(int btn, float x, float y) = 0;
     virtual void onMouseButtonUp(int btn, float x, float y) = 0;
     virtual void onMouseMove(float x, float y) = 0;
 };
+inline IEntityController::~IEntityController() {}
 
 class EntityController_Rotator:
     public IEntityController
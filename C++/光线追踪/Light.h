@@ -23,7 +23,7 @@ public:
             const Vector3& specular,
             const Vector3& attenuation,
             float range);
-    virtual ~Light() = 0 {}
+    virtual ~Light() = 0;
 
     virtual Vector3 getLightDirection(const Vector3& point) const = 0;
     virtual void notifyCameraSpaceChanged(const Matrix4x4& viewMat) = 0;
@@ -48,6 +48,7 @@ protected:
     Vector3 m_attenuation;
     float m_range;
 };
+inline Light::~Light() {}
 
 class PointLight:
     public Light
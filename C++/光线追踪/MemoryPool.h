@@ -42,16 +42,16 @@ public:
     {
         if (m_freeList == NULL) allocBlock();
         assert(m_freeList != NULL);
-        Node *n = m_freeList;
+        Node *node = m_freeList;
         m_freeList = m_freeList->next;
         ++m_allocCnt;
-        return n;
+        return node;
     }
     void free(void* p)
     {
-        Node *n = (Node*)p;
-        n->next = m_freeList;
-        m_freeList = n;
+        Node *node = (Node*)p;
+        node->next = m_freeList;
+        m_freeList = node;
         --m_allocCnt;
     }
     void swap(FixSizeMemoryPool &o)
@@ -1,6 +1,7 @@
 // vim: fileencoding=gbk
 #include "pch.h"
 
+#include <cstring>
 #include <ctime>
 
 #include <fstream>
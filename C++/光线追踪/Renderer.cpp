@@ -30,15 +30,12 @@ static Vector3 getSkyColor(
         if (skybox->getTraceable()->intersect(r, EIC_front, _t, frag)) {
             const Texture * tex = TextureManager::instance()->find(
                     frag.mat->texture.c_str());
-            assert(tex != NULL && tex->valid());
+            // ûжӦƽ̨ͼ(Linuxµjpg)û
+            if (tex == NULL || !tex->valid()) return Vector3::ZERO;
             sampler.setTexture(tex);
             sampler.setAddressingMode(ETAM_clamp);
             sampler.setFilterType(ETFT_point);
-            sampler.beginSample();
-            Vector3 clr = sampler.sample(frag.uv.multiplyInplace(
-                        sampler.textureSize()));
-            sampler.endSample();
-            return clr;
+            return sampler.sampleLod(frag.uv.multiplyInplace(sampler.maxTextureSize()), 0);
         }
     }
     return Vector3::ZERO;
@@ -73,10 +70,10 @@ static void adjustNormalWithBumpMap(
     assert(frag.mat->texFilter != ETFT_null);
     sampler.setFilterType(frag.mat->texFilter);
     sampler.setAddressingMode(frag.mat->texAddressMode);
-    sampler.beginSample();
-    Vector3 tsScale = sampler.sample(
-            Vector2(frag.uv).multiplyInplace(sampler.textureSize()));
-    sampler.endSample();
+    // beginSample()һԹ̶ȡ0͵13:1
+    float lod = frag.mat->texFilter == ETFT_trilinear ? 0.25f : 0;
+    Vector3 tsScale = sampler.sampleLod(
+            Vector2(frag.uv).multiplyInplace(sampler.maxTextureSize()), lod);
 
     tsScale *= 2;
     tsScale -= Vector3::UNIT_SCALE;
@@ -422,7 +419,7 @@ void Renderer::render(SceneManager* sceneMgr, char *buf, int w, int h, int pitch
     m_cameraRayCache->update(sceneMgr->getCamera(), w, h);
 
 #if USE_OMP
-#pragma omp parallel for
+#pragma omp parallel for schedule(dynamic)
 #endif
     for (int y = 0; y < h; ++y) {
         Sampler sampler;
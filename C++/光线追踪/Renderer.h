@@ -12,6 +12,8 @@ class CameraRayCache;
 class Sampler;
 struct Ray;
 
+int color2Int(const Vector3& color);
+
 class Renderer
 {
 public:
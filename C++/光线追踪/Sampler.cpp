@@ -3,9 +3,14 @@
 
 #include <cassert>
 
+#include <algorithm>
+
+#include <emmintrin.h>
+
 #include "Sampler.h"
 #include "Vector.h"
 #include "Texture.h"
+#include "../RenderCommon/TextureFixed.h"
 
 struct AddressingMethod_Clamp
 {
@@ -221,6 +226,15 @@ Sampler::Sampler():
     m_uAddressingMode(ETAM_clamp), m_vAddressingMode(ETAM_clamp),
     m_filterMethod(NULL)
 {
+    // ÿֹ˷Ҫŵým_memBufҲܳѰַʽǿ࣬ӰС
+    typedef PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat> Point;
+    typedef BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat> Bilinear;
+    typedef TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat> Trilinear;
+    static_assert(sizeof(Point) <= sizeof(MemBuf) && alignof(Point) <= alignof(MemBuf), "PointFilterMethod");
+    static_assert(sizeof(Bilinear) <= sizeof(MemBuf) && alignof(Bilinear) <= alignof(MemBuf), "BilinearFilterMethod");
+    static_assert(sizeof(Trilinear) <= sizeof(MemBuf) && alignof(Trilinear) <= alignof(MemBuf), "TrilinearFilterMethod");
+    static_assert(sizeof(ConstColorFilterMethod) <= sizeof(MemBuf) &&
+            alignof(ConstColorFilterMethod) <= alignof(MemBuf), "ConstColorFilterMethod");
 }
 
 void Sampler::beginSample(
@@ -316,45 +330,45 @@ void Sampler::beginSample(
     if (filterMethodType == 1) {
         if (m_uAddressingMode == ETAM_clamp) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Clamp, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Clamp, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Clamp, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_repeat) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_mirror) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Mirror, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Mirror, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Mirror, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
@@ -363,45 +377,45 @@ void Sampler::beginSample(
     else if (filterMethodType == 2) {
         if (m_uAddressingMode == ETAM_clamp) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_repeat) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_mirror) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
@@ -410,45 +424,45 @@ void Sampler::beginSample(
     else if (filterMethodType == 3) {
         if (m_uAddressingMode == ETAM_clamp) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Clamp>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Repeat>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Mirror>(data0, data1, w, h, weight0);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_repeat) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Clamp>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Mirror>(data0, data1, w, h, weight0);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_mirror) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Clamp>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Repeat>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Mirror>(data0, data1, w, h, weight0);
             }
             else assert(0);
@@ -461,7 +475,7 @@ void Sampler::beginSample(
             Vector3(0, 0, 0.5f), Vector3(0, 0.5f, 0.5f), Vector3(0.5f, 0, 0.5f), Vector3(0.5f, 0.5f, 0), 
         };
         int idx = std::min(std::max((int)level, 0), arraySize(constColorTable) - 1);
-        m_filterMethod = new (m_memBuf) ConstColorFilterMethod(constColorTable[idx]);
+        m_filterMethod = new (&m_memBuf) ConstColorFilterMethod(constColorTable[idx]);
     }
     else assert(0);
 
@@ -503,45 +517,45 @@ void Sampler::beginSample()
     if (filterMethodType == 1) {
         if (m_uAddressingMode == ETAM_clamp) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Clamp, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Clamp, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Clamp, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_repeat) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_mirror) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Mirror, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Mirror, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Mirror, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
@@ -550,45 +564,45 @@ void Sampler::beginSample()
     else if (filterMethodType == 2) {
         if (m_uAddressingMode == ETAM_clamp) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_repeat) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_mirror) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
@@ -597,45 +611,45 @@ void Sampler::beginSample()
     else if (filterMethodType == 3) {
         if (m_uAddressingMode == ETAM_clamp) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Clamp>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Repeat>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Mirror>(data0, data1, w, h, weight0);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_repeat) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Clamp>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Mirror>(data0, data1, w, h, weight0);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_mirror) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Clamp>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Repeat>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (m_memBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Mirror>(data0, data1, w, h, weight0);
             }
             else assert(0);
@@ -645,3 +659,10 @@ void Sampler::beginSample()
 
     assert(m_filterMethod != NULL);
 }
+Vector3 Sampler::sampleLod(const Vector2& uv, float lod) const
+{
+    assert(m_tex != NULL);
+    FixedSamplePlan plan;
+    planFixedSample(m_tex, m_minFilterType, m_maxFilterType, m_uAddressingMode, m_vAddressingMode, lod, plan);
+    return fixed2Color(sampleFixed(plan, uv.x, uv.y));
+}
@@ -9,10 +9,11 @@
 
 struct ITextureFilterMethod
 {
-    virtual ~ITextureFilterMethod() = 0 {};
+    virtual ~ITextureFilterMethod() = 0;
     virtual Vector3 sample(const Vector2& uv) const = 0;
     virtual Vector2 textureSize() const = 0;
 };
+inline ITextureFilterMethod::~ITextureFilterMethod() {}
 
 class Sampler
 {
@@ -36,6 +37,9 @@ public:
     Vector2 textureSize() const;
     Vector3 sample(const Vector2& uv) const;
     void endSample();
+    // ҪbeginSampleuvǵ0꣬lodѡڶswizzledLevelϹˡ
+    // û΢֣lodɵ߸
+    Vector3 sampleLod(const Vector2& uv, float lod) const;
 
 private:
     const Texture* m_tex;
@@ -45,7 +49,13 @@ private:
     E_TextureAddressingMode m_vAddressingMode;
 
     ITextureFilterMethod *m_filterMethod;
-    char m_memBuf[64];
+    // m_filterMethodĴ洢ԱֻΪ
+    union MemBuf
+    {
+        char data[64];
+        void *p;
+        double d;
+    } m_memBuf;
 };
 
 inline Vector3 Sampler::sample(const Vector2& uv) const
@@ -2,6 +2,7 @@
 #include "pch.h"
 
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 
 #include "Serialize.h"
@@ -12,6 +13,17 @@ static char g_buf[1024];
 static char g_buf2[1024];
 static std::string g_nestedWriterPrefix;
 
+// һУ׵ĿհףWindows´ĳļβ'\r'Ҳȥ
+static char* readLine(std::istream& si)
+{
+    si.getline(g_buf, sizeof(g_buf));
+    char *end = g_buf + strlen(g_buf);
+    if (end > g_buf && end[-1] == '\r') *--end = 0;
+    char *p = g_buf;
+    while (isspace(*p)) ++p;
+    return p;
+}
+
 StreamBlockWriter::StreamBlockWriter(const char *blockName, std::ostream& so):
     m_so(so)
 {
@@ -68,17 +80,13 @@ void StreamBlockWriter::write(const char *fieldName, const char * val)
 StreamBlockReader::StreamBlockReader(const char *blockName, std::istream& si):
     m_si(si)
 {
-    m_si.getline(g_buf, sizeof(g_buf));
-    char *p = g_buf;
-    while (isspace(*p)) ++p;
+    char *p = readLine(m_si);
     sprintf(g_buf2, "%s {", blockName);
     assert(strcmp(p, g_buf2) == 0);
 }
 StreamBlockReader::~StreamBlockReader()
 {
-    m_si.getline(g_buf, sizeof(g_buf));
-    char *p = g_buf;
-    while (isspace(*p)) ++p;
+    char *p = readLine(m_si);
     assert(strcmp(p, "}") == 0);
 }
 bool StreamBlockReader::read(const char *fieldName, int* val)
@@ -94,9 +102,7 @@ bool StreamBlockReader::read(const char *fieldName, bool* val)
 }
 bool StreamBlockReader::read(const char *fieldName, int *begin,  int *end)
 {
-    m_si.getline(g_buf, sizeof(g_buf));
-    char *p = g_buf;
-    while (isspace(*p)) ++p;
+    char *p = readLine(m_si);
     int off = sprintf(g_buf2, "%s: ", fieldName);
     if (strncmp(p, g_buf2, off)) return false;
     p += off;
@@ -115,9 +121,7 @@ bool StreamBlockReader::read(const char *fieldName, float* val)
 }
 bool StreamBlockReader::read(const char *fieldName, float *begin,  float *end)
 {
-    m_si.getline(g_buf, sizeof(g_buf));
-    char *p = g_buf;
-    while (isspace(*p)) ++p;
+    char *p = readLine(m_si);
     int off = sprintf(g_buf2, "%s: ", fieldName);
     if (strncmp(p, g_buf2, off)) return false;
     p += off;
@@ -132,9 +136,7 @@ bool StreamBlockReader::read(const char *fieldName, float *begin,  float *end)
 }
 bool StreamBlockReader::read(const char *fieldName, char * buf, int len)
 {
-    m_si.getline(g_buf, sizeof(g_buf));
-    char *p = g_buf;
-    while (isspace(*p)) ++p;
+    char *p = readLine(m_si);
     int off = sprintf(g_buf2, "%s: ", fieldName);
     if (strncmp(p, g_buf2, off)) return false;
     p += off;
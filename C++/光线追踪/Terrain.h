@@ -7,9 +7,10 @@
 
 struct ITerrain
 {
-    virtual ~ITerrain() = 0 {}
+    virtual ~ITerrain() = 0;
     virtual float getHeight(float x, float z) const = 0;
 };
+inline ITerrain::~ITerrain() {}
 
 class FlatTerrain:
     public ITerrain
@@ -3,6 +3,8 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <cassert>
+
 #include <map>
 #include <string>
 #include <vector>
@@ -24,14 +26,37 @@ public:
     int width(int level) const;
     int height(int level) const;
     const float* data(int level) const;
+
+    // ÿ8λ㸱ÿ4ֽڣͨ˳dataһ
+    // 8x8һ飬鰴ţڰMorton˫Ե4شͬһ
+    struct SwizzledLevel
+    {
+        const unsigned int *data;
+        int w, h;
+        int tileCntX;
+    };
+    const SwizzledLevel& swizzledLevel(int level) const
+    {
+        assert(level >= 0 && level < (int)m_swizzledLevels.size());
+        return m_swizzledLevels[level];
+    }
 private:
     void genMipmap();
+    void genSwizzled();
 
 private:
     std::vector<float*> m_bufs;
+    std::vector<SwizzledLevel> m_swizzledLevels;
     int m_w, m_h;
 };
 
+inline int swizzledTexelIndex(int u, int v, int tileCntX)
+{
+    // 3λMorton룺iλƵ2iλ
+    static const int s_spread[8] = {0, 1, 4, 5, 16, 17, 20, 21};
+    return (((v >> 3) * tileCntX + (u >> 3)) << 6) + s_spread[u & 7] + (s_spread[v & 7] << 1);
+}
+
 class TextureManager
 {
 public:
@@ -0,0 +1,297 @@
+// vim: fileencoding=gbk
+#include "pch.h"
+
+#include <cassert>
+#include <cmath>
+
+#include <algorithm>
+#include <deque>
+
+#include <omp.h>
+
+#include "TileRenderer.h"
+#include "Renderer.h"
+#include "SceneManager.h"
+#include "Camera.h"
+#include "Geometry.h"
+#include "Sampler.h"
+#include "Util.h"
+
+static const char *g_passNames[] = {"coarse", "full", "adaptive"};
+
+// ÿ߳һ˫˶Уʼʱÿзһο飬ڵĿе
+// ԼĶдͷȡԺӱĶβ͵
+class TileQueue
+{
+public:
+    TileQueue(int queueCnt, int tileCnt);
+    ~TileQueue();
+    bool pop(int thread, int &tile, bool &stolen);
+private:
+    struct Queue
+    {
+        std::deque<int> tiles;
+        omp_lock_t lock;
+    };
+private:
+    std::vector<Queue*> m_queues;
+};
+
+TileQueue::TileQueue(int queueCnt, int tileCnt)
+{
+    for (int i = 0; i < queueCnt; ++i) {
+        Queue *q = new Queue();
+        omp_init_lock(&q->lock);
+        int begin = tileCnt * i / queueCnt, end = tileCnt * (i + 1) / queueCnt;
+        for (int j = begin; j < end; ++j) q->tiles.push_back(j);
+        m_queues.push_back(q);
+    }
+}
+TileQueue::~TileQueue()
+{
+    for (int i = 0; i < (int)m_queues.size(); ++i) {
+        omp_destroy_lock(&m_queues[i]->lock);
+        delete m_queues[i];
+    }
+}
+bool TileQueue::pop(int thread, int &tile, bool &stolen)
+{
+    int n = (int)m_queues.size();
+    for (int i = 0; i < n; ++i) {
+        Queue *q = m_queues[(thread + i) % n];
+        omp_set_lock(&q->lock);
+        bool found = !q->tiles.empty();
+        if (found) {
+            if (i == 0) {
+                tile = q->tiles.front();
+                q->tiles.pop_front();
+            }
+            else {
+                tile = q->tiles.back();
+                q->tiles.pop_back();
+            }
+        }
+        omp_unset_lock(&q->lock);
+        if (found) {
+            stolen = i > 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+TileRenderer::TileRenderer(Renderer *renderer):
+    m_renderer(renderer), m_sceneMgr(NULL),
+    m_buf(NULL), m_w(0), m_h(0), m_pitch(0),
+    m_tileSize(32), m_coarseStep(4),
+    m_superSampleLevel(4), m_contrastThreshold(0.1f)
+{
+}
+
+void TileRenderer::setTileSize(int size)
+{
+    assert(size > 0);
+    m_tileSize = size;
+}
+void TileRenderer::setCoarseStep(int step)
+{
+    assert(step > 0);
+    m_coarseStep = step;
+}
+void TileRenderer::setSuperSampleLevel(int level)
+{
+    assert(level > 0);
+    m_superSampleLevel = level;
+}
+void TileRenderer::setContrastThreshold(float threshold)
+{
+    m_contrastThreshold = threshold;
+}
+
+void TileRenderer::beginFrame(SceneManager *sceneMgr, char *buf, int w, int h, int pitch)
+{
+    assert(sceneMgr != NULL && buf != NULL && w > 0 && h > 0);
+    m_sceneMgr = sceneMgr;
+    m_buf = buf;
+    m_w = w, m_h = h, m_pitch = pitch;
+    m_colors.assign(w * h, Vector3::ZERO);
+    m_fullColors.clear();
+    m_exact.assign(w * h, 0);
+    m_tileStats.clear();
+    m_passStats.clear();
+}
+
+bool TileRenderer::renderNextPass()
+{
+    assert(m_sceneMgr != NULL);
+    int pass = (int)m_passStats.size();
+    // ÿֻһʱû
+    if (pass == EP_adaptive && m_superSampleLevel == 1) return false;
+    if (pass >= EP_count) return false;
+
+    if (pass == EP_adaptive) m_fullColors = m_colors;
+    renderPass(pass);
+    return true;
+}
+
+int TileRenderer::getFinishedPassCount() const
+{
+    return (int)m_passStats.size();
+}
+
+void TileRenderer::renderPass(int pass)
+{
+    int tileCntX = (m_w + m_tileSize - 1) / m_tileSize;
+    int tileCnt = tileCntX * ((m_h + m_tileSize - 1) / m_tileSize);
+    std::vector<TileStat> stats(tileCnt);
+    TileQueue queue(omp_get_max_threads(), tileCnt);
+
+    double start = omp_get_wtime();
+#pragma omp parallel
+    {
+        int thread = omp_get_thread_num();
+        Sampler sampler;
+        int tile;
+        bool stolen;
+        while (queue.pop(thread, tile, stolen)) {
+            TileStat &stat = stats[tile];
+            stat.x = tile % tileCntX * m_tileSize;
+            stat.y = tile / tileCntX * m_tileSize;
+            stat.w = std::min(m_tileSize, m_w - stat.x);
+            stat.h = std::min(m_tileSize, m_h - stat.y);
+            stat.pass = pass;
+            stat.thread = thread;
+            stat.stolen = stolen;
+
+            double tileStart = omp_get_wtime();
+            stat.rayCnt = renderTile(pass, stat.x, stat.y, stat.x + stat.w, stat.y + stat.h, sampler);
+            stat.seconds = omp_get_wtime() - tileStart;
+        }
+    }
+
+    PassStat passStat = {omp_get_wtime() - start, 0};
+    for (int i = 0; i < tileCnt; ++i) passStat.rayCnt += stats[i].rayCnt;
+    m_passStats.push_back(passStat);
+    m_tileStats.insert(m_tileStats.end(), stats.begin(), stats.end());
+}
+
+int TileRenderer::renderTile(int pass, int x0, int y0, int x1, int y1, Sampler& sampler)
+{
+    int rayCnt = 0;
+    if (pass == EP_coarse) {
+        // Ͻزͬһɫ
+        for (int by = y0; by < y1; by += m_coarseStep) {
+            for (int bx = x0; bx < x1; bx += m_coarseStep) {
+                Vector3 clr(tracePixel((float)bx, (float)by, sampler));
+                ++rayCnt;
+                m_exact[by * m_w + bx] = 1;
+                int ex = std::min(bx + m_coarseStep, x1), ey = std::min(by + m_coarseStep, y1);
+                for (int y = by; y < ey; ++y) {
+                    for (int x = bx; x < ex; ++x) writePixel(x, y, clr);
+                }
+            }
+        }
+    }
+    else if (pass == EP_full) {
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                if (m_exact[y * m_w + x]) continue;
+                writePixel(x, y, tracePixel((float)x, (float)y, sampler));
+                ++rayCnt;
+            }
+        }
+    }
+    else {
+        // ΧһؿķΧھȲԭĲ
+        int level = m_superSampleLevel;
+        float invLevel = 1.f / level;
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                if (!needSuperSample(x, y)) continue;
+                Vector3 clr(Vector3::ZERO);
+                for (int i = 0; i < level; ++i) {
+                    for (int j = 0; j < level; ++j) {
+                        clr += tracePixel(
+                                x + (j + 0.5f) * invLevel - 0.5f,
+                                y + (i + 0.5f) * invLevel - 0.5f,
+                                sampler);
+                    }
+                }
+                rayCnt += level * level;
+                writePixel(x, y, clr *= invLevel * invLevel);
+            }
+        }
+    }
+    return rayCnt;
+}
+
+// CameraRayCacheһx/wy/hӿ
+Vector3 TileRenderer::tracePixel(float x, float y, Sampler& sampler)
+{
+    Ray r(m_sceneMgr->getCamera()->getRayFromViewport(x / m_w, y / m_h));
+    return m_renderer->getColorViaRay(r, m_sceneMgr, sampler, 1);
+}
+
+void TileRenderer::writePixel(int x, int y, const Vector3& clr)
+{
+    m_colors[y * m_w + x] = clr;
+    ((int*)(m_buf + y * m_pitch))[x] = color2Int(clr);
+}
+
+bool TileRenderer::needSuperSample(int x, int y) const
+{
+    static const int s_offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    const Vector3 &clr = m_fullColors[y * m_w + x];
+    for (int i = 0; i < 4; ++i) {
+        int nx = x + s_offsets[i][0], ny = y + s_offsets[i][1];
+        if (nx < 0 || nx >= m_w || ny < 0 || ny >= m_h) continue;
+        const Vector3 &n = m_fullColors[ny * m_w + nx];
+        float diff = std::max(fabs(clr.x - n.x), std::max(fabs(clr.y - n.y), fabs(clr.z - n.z)));
+        if (diff > m_contrastThreshold) return true;
+    }
+    return false;
+}
+
+const std::vector<TileStat>& TileRenderer::getTileStats() const
+{
+    return m_tileStats;
+}
+
+void TileRenderer::printStats(std::ostream& so) const
+{
+    int tileBegin = 0;
+    for (int pass = 0; pass < (int)m_passStats.size(); ++pass) {
+        const PassStat &passStat = m_passStats[pass];
+        double minTime = MAX_FLOAT, maxTime = 0, sumTime = 0;
+        int tileCnt = 0, stolenCnt = 0;
+        for (int i = tileBegin; i < (int)m_tileStats.size() && m_tileStats[i].pass == pass; ++i) {
+            const TileStat &stat = m_tileStats[i];
+            minTime = std::min(minTime, stat.seconds);
+            maxTime = std::max(maxTime, stat.seconds);
+            sumTime += stat.seconds;
+            stolenCnt += stat.stolen;
+            ++tileCnt;
+        }
+        tileBegin += tileCnt;
+
+        so << "pass " << g_passNames[pass] << ": " << passStat.seconds << "s, "
+            << tileCnt << " tiles (" << stolenCnt << " stolen), "
+            << passStat.rayCnt << " camera rays, "
+            << passStat.rayCnt / std::max(passStat.seconds, 1e-6) / 1e6 << "M rays/s, tile time min/avg/max: "
+            << (tileCnt > 0 ? minTime : 0) * 1000 << "/"
+            << (tileCnt > 0 ? sumTime / tileCnt : 0) * 1000 << "/"
+            << maxTime * 1000 << "ms" << endl;
+    }
+}
+
+void TileRenderer::printTileStats(std::ostream& so) const
+{
+    so << "pass,x,y,w,h,thread,stolen,rays,seconds,raysPerSecond" << endl;
+    for (int i = 0; i < (int)m_tileStats.size(); ++i) {
+        const TileStat &stat = m_tileStats[i];
+        so << g_passNames[stat.pass] << ',' << stat.x << ',' << stat.y << ','
+            << stat.w << ',' << stat.h << ',' << stat.thread << ',' << stat.stolen << ','
+            << stat.rayCnt << ',' << stat.seconds << ','
+            << stat.rayCnt / std::max(stat.seconds, 1e-9) << endl;
+    }
+}
@@ -0,0 +1,84 @@
+// vim: fileencoding=gbk
+
+#ifndef TILERENDERER_H
+#define TILERENDERER_H
+
+#include <iostream>
+#include <vector>
+
+#include "Vector.h"
+
+class SceneManager;
+class Renderer;
+class Sampler;
+
+struct TileStat
+{
+    int x, y, w, h;
+    int pass;
+    int thread;
+    bool stolen;
+    int rayCnt; // ֻߣ䡢䡢ӰAO߲
+    double seconds;
+};
+
+// Ⱦÿ߳һĶ߳Լȥ͵˵ġ
+// 齥ÿstep*stepزһεĴͼٲأ
+// Ժɫö
+class TileRenderer
+{
+public:
+    enum E_Pass
+    {
+        EP_coarse,
+        EP_full,
+        EP_adaptive,
+        EP_count,
+    };
+public:
+    TileRenderer(Renderer *renderer);
+
+    void setTileSize(int size);
+    void setCoarseStep(int step);
+    void setSuperSampleLevel(int level); // ʱÿlevel*level
+    void setContrastThreshold(float threshold);
+
+    void beginFrame(SceneManager *sceneMgr, char *buf, int w, int h, int pitch);
+    bool renderNextPass(); // б󷵻false
+    int getFinishedPassCount() const;
+
+    const std::vector<TileStat>& getTileStats() const;
+    void printStats(std::ostream& so) const;
+    void printTileStats(std::ostream& so) const; // csv
+
+private:
+    struct PassStat
+    {
+        double seconds;
+        int rayCnt;
+    };
+private:
+    void renderPass(int pass);
+    int renderTile(int pass, int x0, int y0, int x1, int y1, Sampler& sampler);
+    Vector3 tracePixel(float x, float y, Sampler& sampler);
+    void writePixel(int x, int y, const Vector3& clr);
+    bool needSuperSample(int x, int y) const;
+
+private:
+    Renderer *m_renderer;
+    SceneManager *m_sceneMgr;
+    char *m_buf;
+    int m_w, m_h, m_pitch;
+    int m_tileSize;
+    int m_coarseStep;
+    int m_superSampleLevel;
+    float m_contrastThreshold;
+
+    std::vector<Vector3> m_colors;
+    std::vector<Vector3> m_fullColors; // ǰɫж϶Աȶ
+    std::vector<char> m_exact; // ԱѾ׼ȷ
+    std::vector<TileStat> m_tileStats;
+    std::vector<PassStat> m_passStats;
+};
+
+#endif // #ifndef TILERENDERER_H
@@ -1,4 +1,4 @@
-r// vim: fileencoding=gbk
+// vim: fileencoding=gbk
 #include "pch.h"
 
 #include <cassert>
@@ -26,7 +26,7 @@ struct TraceFragment
 
 struct ITraceable
 {
-    virtual ~ITraceable() = 0 {}
+    virtual ~ITraceable() = 0;
     virtual bool intersect(const Ray& r, int intersectFace, float &t, TraceFragment& frag) = 0;
     virtual bool intersectTest(const Ray& r) = 0;
     virtual bool intersectSimply(const Ray& r, int intersectFace, float &t) = 0;
@@ -35,6 +35,7 @@ struct ITraceable
     virtual void printStream(std::ostream& so) const = 0;
     virtual void scanStream(std::istream& si) = 0;
 };
+inline ITraceable::~ITraceable() {}
 std::istream& operator >> (std::istream& si, ITraceable*& p);
 std::ostream& operator << (std::ostream& so, const ITraceable* p);
 
@@ -4,21 +4,27 @@
 #include <cassert>
 
 #include <string>
+#include <vector>
 
 #include "Serialize.h"
 #include "TriTraceAccelerator.h"
 #include "TriTraceAccelerator_KDTree.h"
+#include "TriTraceAccelerator_BVH.h"
 #include "Mesh.h"
 #include "Matrix.h"
 #include "Vector.h"
 #include "Geometry.h"
 #include "Traceable.h"
+#include "../RenderCommon/SimdMath.h"
 
 static std::string getTriTraceAcceleratorType(const TriTraceAccelerator_Base* p)
 {
     if (dynamic_cast<const TriTraceAccelerator_KDTree*>(p)) {
         return "KDTree";
     }
+    if (dynamic_cast<const TriTraceAccelerator_BVH*>(p)) {
+        return "BVH";
+    }
     if (dynamic_cast<const TriTraceAccelerator_Base*>(p)) {
         return "Base";
     }
@@ -30,6 +36,7 @@ static TriTraceAccelerator_Base* createTriTraceAcceleratorByType(
 {
     if (s == "Base") return new TriTraceAccelerator_Base();
     if (s == "KDTree") return new TriTraceAccelerator_KDTree();
+    if (s == "BVH") return new TriTraceAccelerator_BVH();
     assert(0);
     return NULL;
 }
@@ -68,26 +75,25 @@ void TriTraceAccelerator_Base::rebuild(const SubMesh* sub, const Matrix4x4& worl
     const Vector3* nbuf = &sub->vertexBuffer.getElementList3<EVEI_normal>()[0];
     const Vector2* uvBuf = (sub->vertexBuffer.getVertexType() & EVET_texCoord) ? 
         &sub->vertexBuffer.getElementList2<EVEI_texCoord>()[0]: NULL;
-    Vector4 v4;
+
+    // 任һ飬ÿֻһΣٰ±ȡ
+    int vCnt = sub->vertexBuffer.getVertexCount();
+    std::vector<Vector3> posInCS(vCnt), normInCS(vCnt);
+    transformPoints(pbuf, &posInCS[0], vCnt, worldView);
+    transformNormals(nbuf, &normInCS[0], vCnt, worldView);
     for (int i = 0; i < tCnt; ++i) {
         const IndexTriangle& itri = sub->indexBuffer.triangle(i);
         Triangle& tri = m_tris[i];
 
         // pos
-        tri.p0 = pbuf[itri.v0];
-        transformPoint(tri.p0, worldView);
-        tri.p1 = pbuf[itri.v1];
-        transformPoint(tri.p1, worldView);
-        tri.p2 = pbuf[itri.v2];
-        transformPoint(tri.p2, worldView);
+        tri.p0 = posInCS[itri.v0];
+        tri.p1 = posInCS[itri.v1];
+        tri.p2 = posInCS[itri.v2];
 
         // norm
-        tri.n0 = nbuf[itri.v0];
-        transformDirection(tri.n0, worldView);
-        tri.n1 = nbuf[itri.v1];
-        transformDirection(tri.n1, worldView);
-        tri.n2 = nbuf[itri.v2];
-        transformDirection(tri.n2, worldView);
+        tri.n0 = normInCS[itri.v0];
+        tri.n1 = normInCS[itri.v1];
+        tri.n2 = normInCS[itri.v2];
 
         // uv
         if (uvBuf != NULL) {
@@ -185,6 +191,15 @@ bool TriTraceAccelerator_Base::intersectTest(const Ray& r)
     }
     return false;
 }
+void TriTraceAccelerator_Base::intersectPacket(
+        const Ray* rs, int n, int intersectFace, float *ts, TraceFragment* frags, bool *hits)
+{
+    for (int i = 0; i < n; ++i) hits[i] = intersect(rs[i], intersectFace, ts[i], frags[i]);
+}
+void TriTraceAccelerator_Base::intersectTestPacket(const Ray* rs, int n, bool *hits)
+{
+    for (int i = 0; i < n; ++i) hits[i] = intersectTest(rs[i]);
+}
 TriTraceAccelerator_Base* TriTraceAccelerator_Base::clone() const
 {
     TriTraceAccelerator_Base *p = new TriTraceAccelerator_Base();
@@ -24,6 +24,9 @@ public:
     virtual bool intersect(const Ray& r, int intersectFace, float &t, TraceFragment& frag);
     virtual bool intersectTest(const Ray& r);
     virtual bool intersectSimply(const Ray& r, int intersectFace, float &t);
+    // һɵĹ(ߡӰ)Ĭ
+    virtual void intersectPacket(const Ray* rs, int n, int intersectFace, float *ts, TraceFragment* frags, bool *hits);
+    virtual void intersectTestPacket(const Ray* rs, int n, bool *hits);
     virtual TriTraceAccelerator_Base* clone() const;
     virtual void printStream(std::ostream& so) const;
     virtual void scanStream(std::istream& si);
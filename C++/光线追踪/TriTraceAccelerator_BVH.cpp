@@ -0,0 +1,815 @@
+// vim: fileencoding=gbk
+#include "pch.h"
+
+#include <cmath>
+#include <ctime>
+
+#include <algorithm>
+#include <vector>
+
+#include <xmmintrin.h>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#include "TriTraceAccelerator_BVH.h"
+#include "TriGeometry.h"
+#include "Traceable.h"
+#include "Serialize.h"
+
+//----------------------------------------
+// SIMDͨ
+//----------------------------------------
+// ߰ıдͨȵģ壺SSEһ4ߣʱAVXһ8
+struct LanesSSE
+{
+    enum { WIDTH = 4 };
+    typedef __m128 F;
+    static F set1(float f) { return _mm_set1_ps(f); }
+    static F load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, F v) { _mm_storeu_ps(p, v); }
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm_div_ps(a, b); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+    static F max(F a, F b) { return _mm_max_ps(a, b); }
+    static F less(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static F lessEqual(F a, F b) { return _mm_cmple_ps(a, b); }
+    static F and_(F a, F b) { return _mm_and_ps(a, b); }
+    static F or_(F a, F b) { return _mm_or_ps(a, b); }
+    static F zero() { return _mm_setzero_ps(); }
+    static int mask(F v) { return _mm_movemask_ps(v); }
+};
+#ifdef __AVX__
+struct LanesAVX
+{
+    enum { WIDTH = 8 };
+    typedef __m256 F;
+    static F set1(float f) { return _mm256_set1_ps(f); }
+    static F load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, F v) { _mm256_storeu_ps(p, v); }
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm256_div_ps(a, b); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static F less(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static F lessEqual(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static F and_(F a, F b) { return _mm256_and_ps(a, b); }
+    static F or_(F a, F b) { return _mm256_or_ps(a, b); }
+    static F zero() { return _mm256_setzero_ps(); }
+    static int mask(F v) { return _mm256_movemask_ps(v); }
+};
+typedef LanesAVX PacketLanes;
+#else
+typedef LanesSSE PacketLanes;
+#endif
+
+// Ϊ0ʱһܴĵ0 * inf
+static float safeInverse(float f)
+{
+    if (fabs(f) < 1e-12f) return f < 0 ? -1e30f : 1e30f;
+    return 1 / f;
+}
+
+//----------------------------------------
+// BVH4
+//----------------------------------------
+// 4BVHӽڵΧаSoAţһSSEһκ4Χ
+struct BVH4Node
+{
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+    int children[4]; // ڲڵ±꣬Ҷӵĵһ
+    int counts[4]; // 0-ڲڵ㣬>0-Ҷӵ-1-
+};
+
+// ҶеΣΪMoller-TrumboreԤñߣ;밴ƽ㣬::intersect(Ray, Plane)һ£
+// ӱӰ߲Լ
+struct BVHTriangle
+{
+    Vector3 p0, e1, e2;
+    Plane plane;
+    int idx;
+};
+
+template<typename L>
+struct RayPacket
+{
+    typename L::F ox, oy, oz;
+    typename L::F dx, dy, dz;
+    typename L::F ix, iy, iz;
+};
+
+class BVH4
+{
+public:
+    BVH4(int maxLeafTriCnt, int binCnt);
+    void build(const std::vector<Triangle>& tris);
+    void destroy();
+    bool intersect(const Ray& r, int intersectFace, float &t, int &triIdx, Vector2& ab) const;
+    bool intersectTest(const Ray& r) const;
+    void intersectPacket(const Ray* rs, int n, int intersectFace, float *ts, int *triIdxs, Vector2 *abs) const;
+    void intersectTestPacket(const Ray* rs, int n, bool *hits) const;
+    int maxLeafTriCnt() const { return m_maxLeafTriCnt; }
+    int binCnt() const { return m_binCnt; }
+    int getNodeCount() const { return (int)m_nodes.size(); }
+
+private:
+    struct Range
+    {
+        int begin, end, depth;
+        AABB bounds;
+    };
+    struct BuildTask
+    {
+        Range range;
+        int parent, slot;
+        std::vector<BVH4Node> nodes;
+    };
+    struct CenterLess
+    {
+        const Vector3 *centers;
+        int axis;
+        CenterLess(const Vector3 *_centers, int _axis): centers(_centers), axis(_axis){}
+        bool operator () (int a, int b) const { return centers[a][axis] < centers[b][axis]; }
+    };
+    struct BinLess
+    {
+        const Vector3 *centers;
+        int axis, bin;
+        float minVal, scale;
+        int binCnt;
+        bool operator () (int i) const { return getBin(centers[i][axis], minVal, scale, binCnt) <= bin; }
+    };
+    enum
+    {
+        STACK_SIZE = 320,
+        MAX_SAH_DEPTH = 64, // Ͱλ֣ߺͱջ
+        MAX_BIN_CNT = 64,
+        PARALLEL_BUILD_MIN_TRI_CNT = 20000,
+    };
+
+private:
+    int _build(std::vector<BVH4Node>& nodes, const Range& range, std::vector<BuildTask>* tasks, int taskTriCnt);
+    int split(const Range& range);
+    AABB getBounds(int begin, int end) const;
+    static int getBin(float val, float minVal, float scale, int binCnt)
+    {
+        int b = int((val - minVal) * scale);
+        return b < 0 ? 0 : (b >= binCnt ? binCnt - 1 : b);
+    }
+    // ȵ㣬AABB::merge
+    static void merge(AABB& a, const AABB& b)
+    {
+        a.minPt.x = std::min(a.minPt.x, b.minPt.x), a.maxPt.x = std::max(a.maxPt.x, b.maxPt.x);
+        a.minPt.y = std::min(a.minPt.y, b.minPt.y), a.maxPt.y = std::max(a.maxPt.y, b.maxPt.y);
+        a.minPt.z = std::min(a.minPt.z, b.minPt.z), a.maxPt.z = std::max(a.maxPt.z, b.maxPt.z);
+    }
+    static float halfArea(const AABB& b)
+    {
+        Vector3 d(b.maxPt - b.minPt);
+        if (d.x < 0 || d.y < 0 || d.z < 0) return 0;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+    bool intersectLeaf(const Ray& r, int intersectFace, int first, int cnt, float &t, int &triIdx, Vector2& ab) const;
+    template<typename L>
+    void _intersectPacket(const Ray* rs, int n, int intersectFace, float *ts, int *triIdxs, Vector2 *abs) const;
+    template<typename L>
+    void _intersectTestPacket(const Ray* rs, int n, bool *hits) const;
+
+private:
+    std::vector<BVH4Node> m_nodes;
+    std::vector<BVHTriangle> m_tris;
+
+    // ʱʱ
+    std::vector<int> m_triIdxs;
+    std::vector<AABB> m_triBounds;
+    std::vector<Vector3> m_triCenters;
+
+    const int m_maxLeafTriCnt;
+    const int m_binCnt;
+};
+BVH4::BVH4(int maxLeafTriCnt, int binCnt):
+    m_maxLeafTriCnt(std::max(1, maxLeafTriCnt)), m_binCnt(std::min(std::max(2, binCnt), (int)MAX_BIN_CNT))
+{
+}
+void BVH4::destroy()
+{
+    m_nodes.clear();
+    m_tris.clear();
+}
+AABB BVH4::getBounds(int begin, int end) const
+{
+    AABB r(Vector3(MAX_FLOAT), Vector3(-MAX_FLOAT));
+    for (int i = begin; i < end; ++i) merge(r, m_triBounds[m_triIdxs[i]]);
+    return r;
+}
+void BVH4::build(const std::vector<Triangle>& tris)
+{
+    destroy();
+    int triCnt = (int)tris.size();
+    if (triCnt == 0) return;
+
+    m_triIdxs.resize(triCnt);
+    m_triBounds.resize(triCnt);
+    m_triCenters.resize(triCnt);
+    for (int i = 0; i < triCnt; ++i) {
+        const Triangle& tri = tris[i];
+        AABB b(tri.p0, tri.p0);
+        b.merge(tri.p1);
+        b.merge(tri.p2);
+        m_triIdxs[i] = i;
+        m_triBounds[i] = b;
+        m_triCenters[i] = b.minPt;
+        (m_triCenters[i] += b.maxPt) *= 0.5f;
+    }
+
+    Range root;
+    root.begin = 0, root.end = triCnt, root.depth = 0;
+    root.bounds = getBounds(0, triCnt);
+
+    // ϲ㴮еط֣㹻СΪйӵϲڵ
+    std::vector<BuildTask> tasks;
+    bool parallel = triCnt >= PARALLEL_BUILD_MIN_TRI_CNT;
+    _build(m_nodes, root, parallel ? &tasks : NULL, triCnt / 32);
+
+    int taskCnt = (int)tasks.size();
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < taskCnt; ++i) {
+        _build(tasks[i].nodes, tasks[i].range, NULL, 0);
+    }
+    for (int i = 0; i < taskCnt; ++i) {
+        BuildTask& task = tasks[i];
+        int base = (int)m_nodes.size();
+        for (int j = 0; j < (int)task.nodes.size(); ++j) {
+            BVH4Node& n = task.nodes[j];
+            for (int k = 0; k < 4; ++k) {
+                if (n.counts[k] == 0) n.children[k] += base;
+            }
+        }
+        m_nodes.insert(m_nodes.end(), task.nodes.begin(), task.nodes.end());
+        m_nodes[task.parent].children[task.slot] = base;
+    }
+
+    m_tris.resize(triCnt);
+    for (int i = 0; i < triCnt; ++i) {
+        const Triangle& tri = tris[m_triIdxs[i]];
+        BVHTriangle& bt = m_tris[i];
+        bt.p0 = tri.p0;
+        bt.e1 = tri.p1 - tri.p0;
+        bt.e2 = tri.p2 - tri.p0;
+        bt.plane = tri.plane;
+        bt.idx = m_triIdxs[i];
+    }
+
+    m_triIdxs.clear();
+    m_triBounds.clear();
+    m_triCenters.clear();
+}
+int BVH4::_build(std::vector<BVH4Node>& nodes, const Range& range, std::vector<BuildTask>* tasks, int taskTriCnt)
+{
+    int nodeIdx = (int)nodes.size();
+    nodes.push_back(BVH4Node());
+
+    // ÿηֿǸΧֱ4ӽڵ
+    Range ranges[4];
+    ranges[0] = range;
+    int rangeCnt = 1;
+    while (rangeCnt < 4) {
+        int best = -1;
+        float bestArea = -1;
+        for (int i = 0; i < rangeCnt; ++i) {
+            if (ranges[i].end - ranges[i].begin <= m_maxLeafTriCnt) continue;
+            float area = halfArea(ranges[i].bounds);
+            if (area > bestArea) {
+                bestArea = area;
+                best = i;
+            }
+        }
+        if (best == -1) break;
+
+        Range& r = ranges[best];
+        int mid = split(r);
+        Range& r2 = ranges[rangeCnt++];
+        r2.begin = mid, r2.end = r.end, r2.depth = ++r.depth;
+        r.end = mid;
+        r.bounds = getBounds(r.begin, r.end);
+        r2.bounds = getBounds(r2.begin, r2.end);
+    }
+
+    BVH4Node node;
+    for (int i = 0; i < 4; ++i) {
+        if (i >= rangeCnt) {
+            node.minX[i] = node.minY[i] = node.minZ[i] = 0;
+            node.maxX[i] = node.maxY[i] = node.maxZ[i] = 0;
+            node.children[i] = 0;
+            node.counts[i] = -1;
+            continue;
+        }
+        const Range& r = ranges[i];
+        node.minX[i] = r.bounds.minPt.x, node.minY[i] = r.bounds.minPt.y, node.minZ[i] = r.bounds.minPt.z;
+        node.maxX[i] = r.bounds.maxPt.x, node.maxY[i] = r.bounds.maxPt.y, node.maxZ[i] = r.bounds.maxPt.z;
+        int triCnt = r.end - r.begin;
+        if (triCnt <= m_maxLeafTriCnt) {
+            node.children[i] = r.begin;
+            node.counts[i] = triCnt;
+        }
+        else if (tasks != NULL && triCnt <= taskTriCnt) {
+            tasks->push_back(BuildTask());
+            BuildTask &task = tasks->back();
+            task.range = r;
+            task.parent = nodeIdx;
+            task.slot = i;
+            node.children[i] = -1;
+            node.counts[i] = 0;
+        }
+        else {
+            node.children[i] = _build(nodes, r, tasks, taskTriCnt);
+            node.counts[i] = 0;
+        }
+    }
+    nodes[nodeIdx] = node;
+    return nodeIdx;
+}
+// ķSAHСķָطָλ
+int BVH4::split(const Range& range)
+{
+    int begin = range.begin, end = range.end;
+    AABB cb(m_triCenters[m_triIdxs[begin]], m_triCenters[m_triIdxs[begin]]);
+    for (int i = begin + 1; i < end; ++i) {
+        const Vector3& c = m_triCenters[m_triIdxs[i]];
+        merge(cb, AABB(c, c));
+    }
+
+    float bestCost = MAX_FLOAT;
+    int bestAxis = -1, bestBin = 0;
+    if (range.depth < MAX_SAH_DEPTH) {
+        int binCnts[MAX_BIN_CNT];
+        AABB binBounds[MAX_BIN_CNT];
+        float rightAreas[MAX_BIN_CNT];
+        int rightCnts[MAX_BIN_CNT];
+        for (int axis = 0; axis < 3; ++axis) {
+            float extent = cb.maxPt[axis] - cb.minPt[axis];
+            if (extent <= 0) continue;
+            float scale = m_binCnt / extent;
+            for (int b = 0; b < m_binCnt; ++b) {
+                binCnts[b] = 0;
+                binBounds[b] = AABB(Vector3(MAX_FLOAT), Vector3(-MAX_FLOAT));
+            }
+            for (int i = begin; i < end; ++i) {
+                int tri = m_triIdxs[i];
+                int b = getBin(m_triCenters[tri][axis], cb.minPt[axis], scale, m_binCnt);
+                ++binCnts[b];
+                merge(binBounds[b], m_triBounds[tri]);
+            }
+
+            AABB acc(Vector3(MAX_FLOAT), Vector3(-MAX_FLOAT));
+            int cnt = 0;
+            for (int b = m_binCnt - 1; b > 0; --b) {
+                merge(acc, binBounds[b]);
+                cnt += binCnts[b];
+                rightAreas[b] = halfArea(acc);
+                rightCnts[b] = cnt;
+            }
+            acc = AABB(Vector3(MAX_FLOAT), Vector3(-MAX_FLOAT));
+            cnt = 0;
+            for (int b = 0; b < m_binCnt - 1; ++b) {
+                merge(acc, binBounds[b]);
+                cnt += binCnts[b];
+                if (cnt == 0 || rightCnts[b + 1] == 0) continue;
+                float cost = halfArea(acc) * cnt + rightAreas[b + 1] * rightCnts[b + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+    }
+
+    if (bestAxis != -1) {
+        BinLess pred;
+        pred.centers = &m_triCenters[0];
+        pred.axis = bestAxis;
+        pred.bin = bestBin;
+        pred.minVal = cb.minPt[bestAxis];
+        pred.scale = m_binCnt / (cb.maxPt[bestAxis] - cb.minPt[bestAxis]);
+        pred.binCnt = m_binCnt;
+        int mid = int(std::partition(&m_triIdxs[0] + begin, &m_triIdxs[0] + end, pred) - &m_triIdxs[0]);
+        if (mid > begin && mid < end) return mid;
+    }
+
+    // غϻ̫ˣλ
+    Vector3 d(cb.maxPt - cb.minPt);
+    int axis = d.x > d.y ? (d.x > d.z ? 0 : 2) : (d.y > d.z ? 1 : 2);
+    int mid = (begin + end) / 2;
+    std::nth_element(&m_triIdxs[0] + begin, &m_triIdxs[0] + mid, &m_triIdxs[0] + end,
+            CenterLess(&m_triCenters[0], axis));
+    return mid;
+}
+bool BVH4::intersectLeaf(const Ray& r, int intersectFace, int first, int cnt, float &t, int &triIdx, Vector2& ab) const
+{
+    bool b = false;
+    for (int i = first; i < first + cnt; ++i) {
+        const BVHTriangle& tri = m_tris[i];
+        float n0n1 = r.dir.dotProduct(tri.plane.normal);
+        if (fequal(n0n1, 0)) continue;
+        if (!(intersectFace & (n0n1 < 0 ? EIC_front : EIC_back))) continue;
+
+        Vector3 pvec(r.dir.crossProduct(tri.e2));
+        float invDet = 1 / tri.e1.dotProduct(pvec);
+        Vector3 tvec(r.pt - tri.p0);
+        float u = tvec.dotProduct(pvec) * invDet;
+        if (u < 0 || u > 1) continue;
+        Vector3 qvec(tvec.crossProduct(tri.e1));
+        float v = r.dir.dotProduct(qvec) * invDet;
+        if (v < 0 || u + v > 1) continue;
+        float _t = (tri.plane.d - r.pt.dotProduct(tri.plane.normal)) / n0n1;
+        if (_t < EPSILON || _t >= t) continue;
+
+        t = _t;
+        triIdx = tri.idx;
+        ab = Vector2(u, v);
+        b = true;
+    }
+    return b;
+}
+bool BVH4::intersect(const Ray& r, int intersectFace, float &t, int &triIdx, Vector2& ab) const
+{
+    if (m_nodes.empty()) return false;
+
+    __m128 ox = _mm_set1_ps(r.pt.x), oy = _mm_set1_ps(r.pt.y), oz = _mm_set1_ps(r.pt.z);
+    __m128 ix = _mm_set1_ps(safeInverse(r.dir.x));
+    __m128 iy = _mm_set1_ps(safeInverse(r.dir.y));
+    __m128 iz = _mm_set1_ps(safeInverse(r.dir.z));
+    __m128 tmin = _mm_set1_ps(EPSILON);
+
+    // ҶҲջӽԶ
+    int stackRefs[STACK_SIZE], stackCnts[STACK_SIZE];
+    float stackDists[STACK_SIZE];
+    int top = 0;
+    stackRefs[top] = 0, stackCnts[top] = 0, stackDists[top] = 0;
+    ++top;
+
+    bool b = false;
+    while (top > 0) {
+        --top;
+        if (stackDists[top] >= t) continue;
+        if (stackCnts[top] > 0) {
+            if (intersectLeaf(r, intersectFace, stackRefs[top], stackCnts[top], t, triIdx, ab)) b = true;
+            continue;
+        }
+
+        const BVH4Node& n = m_nodes[stackRefs[top]];
+        __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.minX), ox), ix);
+        __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.maxX), ox), ix);
+        __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.minY), oy), iy);
+        __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.maxY), oy), iy);
+        __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.minZ), oz), iz);
+        __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.maxZ), oz), iz);
+        __m128 tnear = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                _mm_max_ps(_mm_min_ps(z0, z1), tmin));
+        __m128 tfar = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(t)));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(tnear, tfar));
+        if (mask == 0) continue;
+
+        float dists[4];
+        _mm_storeu_ps(dists, tnear);
+        int first = top;
+        for (int i = 0; i < 4; ++i) {
+            if (!(mask & (1 << i)) || n.counts[i] < 0) continue;
+            // Զջ
+            int j = top++;
+            for (; j > first && stackDists[j - 1] < dists[i]; --j) {
+                stackRefs[j] = stackRefs[j - 1], stackCnts[j] = stackCnts[j - 1], stackDists[j] = stackDists[j - 1];
+            }
+            stackRefs[j] = n.children[i], stackCnts[j] = n.counts[i], stackDists[j] = dists[i];
+        }
+        assert(top <= STACK_SIZE);
+    }
+    return b;
+}
+bool BVH4::intersectTest(const Ray& r) const
+{
+    if (m_nodes.empty()) return false;
+
+    __m128 ox = _mm_set1_ps(r.pt.x), oy = _mm_set1_ps(r.pt.y), oz = _mm_set1_ps(r.pt.z);
+    __m128 ix = _mm_set1_ps(safeInverse(r.dir.x));
+    __m128 iy = _mm_set1_ps(safeInverse(r.dir.y));
+    __m128 iz = _mm_set1_ps(safeInverse(r.dir.z));
+    __m128 tmin = _mm_set1_ps(EPSILON), tmax = _mm_set1_ps(MAX_FLOAT);
+
+    int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BVH4Node& n = m_nodes[stack[--top]];
+        __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.minX), ox), ix);
+        __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.maxX), ox), ix);
+        __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.minY), oy), iy);
+        __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.maxY), oy), iy);
+        __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.minZ), oz), iz);
+        __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.maxZ), oz), iz);
+        __m128 tnear = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                _mm_max_ps(_mm_min_ps(z0, z1), tmin));
+        __m128 tfar = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                _mm_min_ps(_mm_max_ps(z0, z1), tmax));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(tnear, tfar));
+
+        for (int i = 0; i < 4; ++i) {
+            if (!(mask & (1 << i)) || n.counts[i] < 0) continue;
+            if (n.counts[i] == 0) {
+                stack[top++] = n.children[i];
+                continue;
+            }
+            float t = MAX_FLOAT;
+            int triIdx;
+            Vector2 ab;
+            if (intersectLeaf(r, EIC_front | EIC_back, n.children[i], n.counts[i], t, triIdx, ab)) return true;
+        }
+        assert(top <= STACK_SIZE);
+    }
+    return false;
+}
+// һκһ󽻣еͨ
+template<typename L>
+static int intersectTrianglePacket(const BVHTriangle& tri, const RayPacket<L>& p, int intersectFace,
+        typename L::F tmax, typename L::F& t, typename L::F& u, typename L::F& v)
+{
+    typedef typename L::F F;
+    F nx = L::set1(tri.plane.normal.x), ny = L::set1(tri.plane.normal.y), nz = L::set1(tri.plane.normal.z);
+    F n0n1 = L::add(L::add(L::mul(p.dx, nx), L::mul(p.dy, ny)), L::mul(p.dz, nz));
+    F eps = L::set1(EPSILON);
+    F faceOk = L::zero();
+    if (intersectFace & EIC_front) faceOk = L::or_(faceOk, L::less(n0n1, L::set1(-EPSILON)));
+    if (intersectFace & EIC_back) faceOk = L::or_(faceOk, L::less(eps, n0n1));
+    if (L::mask(faceOk) == 0) return 0;
+
+    F e1x = L::set1(tri.e1.x), e1y = L::set1(tri.e1.y), e1z = L::set1(tri.e1.z);
+    F e2x = L::set1(tri.e2.x), e2y = L::set1(tri.e2.y), e2z = L::set1(tri.e2.z);
+    F px = L::sub(L::mul(p.dy, e2z), L::mul(p.dz, e2y));
+    F py = L::sub(L::mul(p.dz, e2x), L::mul(p.dx, e2z));
+    F pz = L::sub(L::mul(p.dx, e2y), L::mul(p.dy, e2x));
+    F det = L::add(L::add(L::mul(e1x, px), L::mul(e1y, py)), L::mul(e1z, pz));
+    F one = L::set1(1);
+    F invDet = L::div(one, det);
+    F tx = L::sub(p.ox, L::set1(tri.p0.x));
+    F ty = L::sub(p.oy, L::set1(tri.p0.y));
+    F tz = L::sub(p.oz, L::set1(tri.p0.z));
+    u = L::mul(L::add(L::add(L::mul(tx, px), L::mul(ty, py)), L::mul(tz, pz)), invDet);
+    F qx = L::sub(L::mul(ty, e1z), L::mul(tz, e1y));
+    F qy = L::sub(L::mul(tz, e1x), L::mul(tx, e1z));
+    F qz = L::sub(L::mul(tx, e1y), L::mul(ty, e1x));
+    v = L::mul(L::add(L::add(L::mul(p.dx, qx), L::mul(p.dy, qy)), L::mul(p.dz, qz)), invDet);
+    F p0n1 = L::add(L::add(L::mul(p.ox, nx), L::mul(p.oy, ny)), L::mul(p.oz, nz));
+    t = L::div(L::sub(L::set1(tri.plane.d), p0n1), n0n1);
+
+    F zero = L::zero();
+    F ok = L::and_(faceOk, L::and_(L::lessEqual(zero, u), L::lessEqual(zero, v)));
+    ok = L::and_(ok, L::lessEqual(L::add(u, v), one));
+    ok = L::and_(ok, L::and_(L::lessEqual(eps, t), L::less(t, tmax)));
+    return L::mask(ok);
+}
+// һߺͽڵһӰΧ󽻣еͨ
+template<typename L>
+static int intersectBoxPacket(const BVH4Node& n, int i, const RayPacket<L>& p, typename L::F tmax, typename L::F& tnear)
+{
+    typedef typename L::F F;
+    F x0 = L::mul(L::sub(L::set1(n.minX[i]), p.ox), p.ix);
+    F x1 = L::mul(L::sub(L::set1(n.maxX[i]), p.ox), p.ix);
+    F y0 = L::mul(L::sub(L::set1(n.minY[i]), p.oy), p.iy);
+    F y1 = L::mul(L::sub(L::set1(n.maxY[i]), p.oy), p.iy);
+    F z0 = L::mul(L::sub(L::set1(n.minZ[i]), p.oz), p.iz);
+    F z1 = L::mul(L::sub(L::set1(n.maxZ[i]), p.oz), p.iz);
+    tnear = L::max(L::max(L::min(x0, x1), L::min(y0, y1)), L::max(L::min(z0, z1), L::set1(EPSILON)));
+    F tfar = L::min(L::min(L::max(x0, x1), L::max(y0, y1)), L::min(L::max(z0, z1), tmax));
+    return L::mask(L::lessEqual(tnear, tfar));
+}
+template<typename L>
+static void loadRayPacket(RayPacket<L>& p, const Ray* rs, int n)
+{
+    float buf[9][L::WIDTH];
+    for (int i = 0; i < L::WIDTH; ++i) {
+        // һʱظһߣЩͨᱻ
+        const Ray& r = rs[i < n ? i : n - 1];
+        buf[0][i] = r.pt.x, buf[1][i] = r.pt.y, buf[2][i] = r.pt.z;
+        buf[3][i] = r.dir.x, buf[4][i] = r.dir.y, buf[5][i] = r.dir.z;
+        buf[6][i] = safeInverse(r.dir.x), buf[7][i] = safeInverse(r.dir.y), buf[8][i] = safeInverse(r.dir.z);
+    }
+    p.ox = L::load(buf[0]), p.oy = L::load(buf[1]), p.oz = L::load(buf[2]);
+    p.dx = L::load(buf[3]), p.dy = L::load(buf[4]), p.dz = L::load(buf[5]);
+    p.ix = L::load(buf[6]), p.iy = L::load(buf[7]), p.iz = L::load(buf[8]);
+}
+template<typename L>
+void BVH4::_intersectPacket(const Ray* rs, int n, int intersectFace, float *ts, int *triIdxs, Vector2 *abs) const
+{
+    typedef typename L::F F;
+    RayPacket<L> p;
+    loadRayPacket(p, rs, n);
+    float tmaxs[L::WIDTH];
+    for (int i = 0; i < L::WIDTH; ++i) tmaxs[i] = i < n ? ts[i] : 0;
+    int active = (1 << n) - 1;
+
+    int stackRefs[STACK_SIZE], stackCnts[STACK_SIZE];
+    float stackDists[STACK_SIZE];
+    int top = 0;
+    stackRefs[top] = 0, stackCnts[top] = 0, stackDists[top] = 0;
+    ++top;
+
+    while (top > 0) {
+        --top;
+        float maxT = 0;
+        for (int i = 0; i < n; ++i) maxT = std::max(maxT, tmaxs[i]);
+        if (stackDists[top] >= maxT) continue;
+        F tmax = L::load(tmaxs);
+
+        if (stackCnts[top] > 0) {
+            for (int i = stackRefs[top]; i < stackRefs[top] + stackCnts[top]; ++i) {
+                F t, u, v;
+                int mask = intersectTrianglePacket<L>(m_tris[i], p, intersectFace, tmax, t, u, v) & active;
+                if (mask == 0) continue;
+                float _ts[L::WIDTH], _us[L::WIDTH], _vs[L::WIDTH];
+                L::store(_ts, t), L::store(_us, u), L::store(_vs, v);
+                for (int j = 0; j < n; ++j) {
+                    if (!(mask & (1 << j))) continue;
+                    tmaxs[j] = _ts[j];
+                    triIdxs[j] = m_tris[i].idx;
+                    abs[j] = Vector2(_us[j], _vs[j]);
+                }
+                tmax = L::load(tmaxs);
+            }
+            continue;
+        }
+
+        const BVH4Node& node = m_nodes[stackRefs[top]];
+        int first = top;
+        for (int i = 0; i < 4; ++i) {
+            if (node.counts[i] < 0) continue;
+            F tnear;
+            int mask = intersectBoxPacket<L>(node, i, p, tmax, tnear) & active;
+            if (mask == 0) continue;
+            float nears[L::WIDTH];
+            L::store(nears, tnear);
+            float dist = MAX_FLOAT;
+            for (int j = 0; j < n; ++j) {
+                if (mask & (1 << j)) dist = std::min(dist, nears[j]);
+            }
+            int j = top++;
+            for (; j > first && stackDists[j - 1] < dist; --j) {
+                stackRefs[j] = stackRefs[j - 1], stackCnts[j] = stackCnts[j - 1], stackDists[j] = stackDists[j - 1];
+            }
+            stackRefs[j] = node.children[i], stackCnts[j] = node.counts[i], stackDists[j] = dist;
+        }
+        assert(top <= STACK_SIZE);
+    }
+    for (int i = 0; i < n; ++i) ts[i] = tmaxs[i];
+}
+template<typename L>
+void BVH4::_intersectTestPacket(const Ray* rs, int n, bool *hits) const
+{
+    typedef typename L::F F;
+    RayPacket<L> p;
+    loadRayPacket(p, rs, n);
+    int active = (1 << n) - 1;
+    F tmax = L::set1(MAX_FLOAT);
+
+    int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    // еĹ˳ȫоͽ
+    while (top > 0 && active != 0) {
+        const BVH4Node& node = m_nodes[stack[--top]];
+        for (int i = 0; i < 4 && active != 0; ++i) {
+            if (node.counts[i] < 0) continue;
+            F tnear;
+            if ((intersectBoxPacket<L>(node, i, p, tmax, tnear) & active) == 0) continue;
+            if (node.counts[i] == 0) {
+                stack[top++] = node.children[i];
+                continue;
+            }
+            for (int j = node.children[i]; j < node.children[i] + node.counts[i]; ++j) {
+                F t, u, v;
+                active &= ~intersectTrianglePacket<L>(m_tris[j], p, EIC_front | EIC_back, tmax, t, u, v);
+                if (active == 0) break;
+            }
+        }
+        assert(top <= STACK_SIZE);
+    }
+    for (int i = 0; i < n; ++i) hits[i] = !(active & (1 << i));
+}
+void BVH4::intersectPacket(const Ray* rs, int n, int intersectFace, float *ts, int *triIdxs, Vector2 *abs) const
+{
+    if (m_nodes.empty()) return;
+    for (int i = 0; i < n; i += PacketLanes::WIDTH) {
+        int cnt = std::min(n - i, (int)PacketLanes::WIDTH);
+        _intersectPacket<PacketLanes>(rs + i, cnt, intersectFace, ts + i, triIdxs + i, abs + i);
+    }
+}
+void BVH4::intersectTestPacket(const Ray* rs, int n, bool *hits) const
+{
+    if (m_nodes.empty()) {
+        for (int i = 0; i < n; ++i) hits[i] = false;
+        return;
+    }
+    for (int i = 0; i < n; i += PacketLanes::WIDTH) {
+        int cnt = std::min(n - i, (int)PacketLanes::WIDTH);
+        _intersectTestPacket<PacketLanes>(rs + i, cnt, hits + i);
+    }
+}
+//----------------------------------------
+// TriTraceAccelerator_BVH
+//----------------------------------------
+TriTraceAccelerator_BVH::TriTraceAccelerator_BVH():
+    m_bvh(new BVH4(4, 16))
+{
+}
+TriTraceAccelerator_BVH::~TriTraceAccelerator_BVH()
+{
+    sdelete(m_bvh);
+}
+void TriTraceAccelerator_BVH::rebuild(const SubMesh* sub, const Matrix4x4& worldView)
+{
+    TriTraceAccelerator_Base::rebuild(sub, worldView);
+
+    clock_t c = clock();
+    m_bvh->build(m_tris);
+    if (m_tris.size() > 10000) // kd-treeһζʱ
+    {
+        cout << "build bvh :"  << endl
+            << "    time: " << float(clock() - c) / CLOCKS_PER_SEC << endl
+            << "    triangle count: " << m_tris.size() << endl
+            << "    node count: " << m_bvh->getNodeCount() << endl;
+    }
+}
+bool TriTraceAccelerator_BVH::intersect(const Ray& r, int intersectFace, float &t, TraceFragment& frag)
+{
+    int triIdx;
+    Vector2 ab;
+    if (!m_bvh->intersect(r, intersectFace, t, triIdx, ab)) return false;
+    frag.mat = m_mat;
+    frag.pos = r.getPoint(t);
+    interpolateNormUV(frag, m_tris[triIdx], ab);
+    updateTangentSpace(frag, m_tris[triIdx]);
+    return true;
+}
+bool TriTraceAccelerator_BVH::intersectSimply(const Ray& r, int intersectFace, float &t)
+{
+    int triIdx;
+    Vector2 ab;
+    return m_bvh->intersect(r, intersectFace, t, triIdx, ab);
+}
+bool TriTraceAccelerator_BVH::intersectTest(const Ray& r)
+{
+    return m_bvh->intersectTest(r);
+}
+void TriTraceAccelerator_BVH::intersectPacket(
+        const Ray* rs, int n, int intersectFace, float *ts, TraceFragment* frags, bool *hits)
+{
+    std::vector<int> triIdxs(n, -1);
+    std::vector<Vector2> abs(n);
+    if (n > 0) m_bvh->intersectPacket(rs, n, intersectFace, ts, &triIdxs[0], &abs[0]);
+    for (int i = 0; i < n; ++i) {
+        hits[i] = triIdxs[i] != -1;
+        if (!hits[i]) continue;
+        TraceFragment& frag = frags[i];
+        frag.mat = m_mat;
+        frag.pos = rs[i].getPoint(ts[i]);
+        interpolateNormUV(frag, m_tris[triIdxs[i]], abs[i]);
+        updateTangentSpace(frag, m_tris[triIdxs[i]]);
+    }
+}
+void TriTraceAccelerator_BVH::intersectTestPacket(const Ray* rs, int n, bool *hits)
+{
+    m_bvh->intersectTestPacket(rs, n, hits);
+}
+TriTraceAccelerator_Base* TriTraceAccelerator_BVH::clone() const
+{
+    TriTraceAccelerator_BVH *p = new TriTraceAccelerator_BVH();
+    sdelete(p->m_bvh);
+    p->m_bvh = new BVH4(m_bvh->maxLeafTriCnt(), m_bvh->binCnt());
+    return p;
+}
+void TriTraceAccelerator_BVH::printStream(std::ostream& so) const
+{
+    StreamBlockWriter w("BVH", so);
+    w.write("maxLeafTriCnt", m_bvh->maxLeafTriCnt());
+    w.write("binCnt", m_bvh->binCnt());
+}
+void TriTraceAccelerator_BVH::scanStream(std::istream& si)
+{
+    StreamBlockReader r("BVH", si);
+    int maxLeafTriCnt = 4, binCnt = 16;
+    if (!r.read("maxLeafTriCnt", &maxLeafTriCnt)) assert(0);
+    if (!r.read("binCnt", &binCnt)) assert(0);
+
+    sdelete(m_bvh);
+    m_bvh = new BVH4(maxLeafTriCnt, binCnt);
+}
+int TriTraceAccelerator_BVH::getNodeCount() const
+{
+    return m_bvh->getNodeCount();
+}
@@ -0,0 +1,35 @@
+// vim: fileencoding=gbk
+
+#ifndef TRITRACEACCELERATOR_BVH_H
+#define TRITRACEACCELERATOR_BVH_H
+
+#include <iostream>
+
+#include "TriTraceAccelerator.h"
+
+struct SubMesh;
+struct TraceFragment;
+struct Ray;
+
+class BVH4;
+class TriTraceAccelerator_BVH:
+    public TriTraceAccelerator_Base
+{
+public:
+    TriTraceAccelerator_BVH();
+    ~TriTraceAccelerator_BVH();
+    virtual void rebuild(const SubMesh* sub, const Matrix4x4& worldView);
+    virtual bool intersect(const Ray& r, int intersectFace, float &t, TraceFragment& frag);
+    virtual bool intersectTest(const Ray& r);
+    virtual bool intersectSimply(const Ray& r, int intersectFace, float &t);
+    virtual void intersectPacket(const Ray* rs, int n, int intersectFace, float *ts, TraceFragment* frags, bool *hits);
+    virtual void intersectTestPacket(const Ray* rs, int n, bool *hits);
+    virtual TriTraceAccelerator_Base* clone() const;
+    virtual void printStream(std::ostream& so) const;
+    virtual void scanStream(std::istream& si);
+    int getNodeCount() const;
+private:
+    BVH4 *m_bvh;
+};
+
+#endif // #ifndef TRITRACEACCELERATOR_BVH_H
@@ -2,6 +2,7 @@
 #include "pch.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include <limits>
 
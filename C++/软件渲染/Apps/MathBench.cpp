@@ -0,0 +1,141 @@
+// vim: fileencoding=gbk
+#include "pch.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+#include <algorithm>
+#include <vector>
+
+#include <omp.h>
+
+#include "Vector.h"
+#include "Matrix.h"
+#include "Geometry.h"
+#include "../RenderCommon/SimdMath.h"
+
+static float randFloat(float minV, float maxV)
+{
+    return minV + (maxV - minV) * rand() / RAND_MAX;
+}
+static Vector3 randVector3(float minV, float maxV)
+{
+    return Vector3(randFloat(minV, maxV), randFloat(minV, maxV), randFloat(minV, maxV));
+}
+
+static float maxDiff(const float *a, const float *b, int n)
+{
+    float r = 0;
+    for (int i = 0; i < n; ++i) r = std::max(r, (float)fabs(a[i] - b[i]));
+    return r;
+}
+
+static void printResult(const char *name, int n, int repeat, double scalarTime, double simdTime, float diff)
+{
+    double scale = 1e9 / ((double)n * repeat);
+    cout << name << ": scalar " << scalarTime * scale << " ns, simd " << simdTime * scale
+        << " ns, speedup " << scalarTime / simdTime << ", max diff " << diff << endl;
+}
+
+// ҪMathBench [Ԫظ [ظ]]
+// Ƚtransform/intersectSimdMathӿڵĺʱһ
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 10000;
+    int repeat = argc > 2 ? atoi(argv[2]) : 200;
+    assert(n > 0 && repeat > 0);
+
+    srand(1);
+    Matrix4x4 mat = Matrix4x4::fromYawPitchRoll(30, 20, 10) *
+        Matrix4x4::fromTranslate(1, 2, 50) *
+        Matrix4x4::fromPerspectiveProj(60, 4.f / 3, 1, 1000);
+    Matrix4x4 rotMat = Matrix4x4::fromYawPitchRoll(30, 20, 10);
+
+    std::vector<Vector3> pts(n), norms(n);
+    std::vector<Vector4> pts4(n);
+    for (int i = 0; i < n; ++i) {
+        pts[i] = randVector3(-10, 10);
+        norms[i] = randVector3(-1, 1).normalize();
+        pts4[i] = Vector4(pts[i], 1);
+    }
+
+    double start, scalarTime, simdTime;
+    {
+        std::vector<Vector4> a(n), b(n);
+        start = omp_get_wtime();
+        for (int k = 0; k < repeat; ++k) {
+            for (int i = 0; i < n; ++i) {
+                a[i] = pts4[i];
+                transform(a[i], mat);
+            }
+        }
+        scalarTime = omp_get_wtime() - start;
+        start = omp_get_wtime();
+        for (int k = 0; k < repeat; ++k) transformPoints(&pts4[0], &b[0], n, mat);
+        simdTime = omp_get_wtime() - start;
+        printResult("transformPoints(Vector4)", n, repeat, scalarTime, simdTime, maxDiff(a[0].data(), b[0].data(), n * 4));
+    }
+    {
+        std::vector<Vector4> a(n), b(n);
+        start = omp_get_wtime();
+        for (int k = 0; k < repeat; ++k) {
+            for (int i = 0; i < n; ++i) {
+                a[i] = Vector4(pts[i], 1);
+                transform(a[i], mat);
+            }
+        }
+        scalarTime = omp_get_wtime() - start;
+        start = omp_get_wtime();
+        for (int k = 0; k < repeat; ++k) transformPoints(&pts[0], &b[0], n, mat);
+        simdTime = omp_get_wtime() - start;
+        printResult("transformPoints(Vector3->Vector4)", n, repeat, scalarTime, simdTime, maxDiff(a[0].data(), b[0].data(), n * 4));
+    }
+    {
+        std::vector<Vector3> a(n), b(n);
+        start = omp_get_wtime();
+        for (int k = 0; k < repeat; ++k) {
+            for (int i = 0; i < n; ++i) {
+                Vector4 v(norms[i], 0);
+                transform(v, rotMat);
+                a[i] = Vector3(v.x, v.y, v.z).normalize();
+            }
+        }
+        scalarTime = omp_get_wtime() - start;
+        start = omp_get_wtime();
+        for (int k = 0; k < repeat; ++k) transformNormals(&norms[0], &b[0], n, rotMat);
+        simdTime = omp_get_wtime() - start;
+        printResult("transformNormals", n, repeat, scalarTime, simdTime, maxDiff(a[0].data(), b[0].data(), n * 3));
+    }
+    {
+        // ͼռڷŵAABBһƽͷ
+        PlaneList planes = Frustum(60, 4.f / 3, 1, 100).getPlanes(EPID_all);
+        std::vector<AABB> aabbs;
+        for (int i = 0; i < n; ++i) {
+            Vector3 center(randFloat(-100, 100), randFloat(-100, 100), randFloat(-20, 120));
+            Vector3 extent(randVector3(0.1f, 5));
+            aabbs.push_back(AABB(center - extent, center + extent));
+        }
+        int aabbRepeat = std::max(repeat / 10, 1);
+        std::vector<char> a(n), b(n);
+        start = omp_get_wtime();
+        for (int k = 0; k < aabbRepeat; ++k) {
+            for (int i = 0; i < n; ++i) {
+                a[i] = intersect(planes, aabbs[i].getCorners()) == EIC_front;
+            }
+        }
+        scalarTime = omp_get_wtime() - start;
+        start = omp_get_wtime();
+        for (int k = 0; k < aabbRepeat; ++k) {
+            frustumCullAABBs(&aabbs[0], n, &planes.planes[0], (int)planes.planes.size(), &b[0]);
+        }
+        simdTime = omp_get_wtime() - start;
+        int diffCnt = 0, culledCnt = 0;
+        for (int i = 0; i < n; ++i) {
+            diffCnt += a[i] != b[i];
+            culledCnt += b[i];
+        }
+        printResult("frustumCullAABBs", n, aabbRepeat, scalarTime, simdTime, (float)diffCnt);
+        cout << "    culled " << culledCnt << "/" << n << endl;
+    }
+}
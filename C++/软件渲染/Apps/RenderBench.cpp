@@ -0,0 +1,87 @@
+// vim: fileencoding=gbk
+#include "pch.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "VirtualPlatform.h"
+#include "Renderer.h"
+#include "RenderStateEnums.h"
+#include "Util.h"
+
+extern Renderer* g_renderer;
+extern bool saveImage(const char *fname, const char *buf, int w, int h, int pitch);
+
+struct RenderConfig
+{
+    const char *name;
+    E_ShadeMode shadeMode;
+    E_TextureFilterType filterType;
+    E_ZBufferType zbufType;
+};
+static const RenderConfig g_configs[] = {
+    {"const_zbuf", ESM_const, ETFT_null, EZBT_zbuf},
+    {"gouraud_bilinear_zbuf", ESM_gouraud, ETFT_bilinear, EZBT_zbuf},
+    {"phong_trilinear_1zbuf", ESM_phong, ETFT_trilinear, EZBT_1zbuf},
+    {"gouraud_anisotropic_1zbuf", ESM_gouraud, ETFT_anisotropic, EZBT_1zbuf},
+};
+
+static double renderFrames(std::vector<char>& buf, int w, int h, int frameCnt)
+{
+    double start = omp_get_wtime();
+    for (int i = 0; i < frameCnt; ++i) {
+        memset(&buf[0], 0, buf.size());
+        g_renderer->render(&buf[0], w, h, w * 4);
+    }
+    return omp_get_wtime() - start;
+}
+
+// ڳĿ¼УҪڣRenderBench [  [֡ [ͼƬǰ׺]]]
+// ÿȾ״̬·ֱɨߺͷֿդ֡Ƚ֡ʺͽֿĽ
+int main(int argc, char *argv[])
+{
+    int w = argc > 2 ? atoi(argv[1]) : 800;
+    int h = argc > 2 ? atoi(argv[2]) : 600;
+    int frameCnt = argc > 3 ? atoi(argv[3]) : 20;
+    std::string prefix = argc > 4 ? argv[4] : "bench_";
+    assert(w > 0 && h > 0 && frameCnt > 0);
+
+    std::vector<char> scanlineBuf(w * h * 4), tiledBuf(w * h * 4);
+
+    setupScene();
+    g_renderer->setCullFace(ECF_back);
+    for (int i = 0; i < arraySize(g_configs); ++i) {
+        const RenderConfig& config = g_configs[i];
+        g_renderer->setShadeMode(config.shadeMode);
+        g_renderer->setTextureFilterType(config.filterType);
+        g_renderer->setZbufferType(config.zbufType);
+
+        g_renderer->setRasterizeMode(ERM_scanline);
+        renderFrames(scanlineBuf, w, h, 1);
+        double scanlineTime = renderFrames(scanlineBuf, w, h, frameCnt);
+
+        g_renderer->setRasterizeMode(ERM_tiled);
+        renderFrames(tiledBuf, w, h, 1);
+        double tiledTime = renderFrames(tiledBuf, w, h, frameCnt);
+
+        int diffCnt = 0;
+        const int *a = (const int*)&scanlineBuf[0], *b = (const int*)&tiledBuf[0];
+        for (int j = 0; j < w * h; ++j) diffCnt += a[j] != b[j];
+
+        cout << config.name << ": scanline " << frameCnt / scanlineTime << " fps, tiled "
+            << frameCnt / tiledTime << " fps (" << omp_get_max_threads() << " threads), "
+            << "different pixels: " << diffCnt << "/" << w * h << endl;
+
+        std::string fname = prefix + config.name + ".png";
+        if (!saveImage(fname.c_str(), &tiledBuf[0], w, h, w * 4)) {
+            cout << "failed to save " << fname << endl;
+        }
+    }
+    cleanupScene();
+}
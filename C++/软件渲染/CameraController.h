@@ -11,7 +11,7 @@ struct ITerrain;
 
 struct ICameraController
 {
-    virtual ~ICameraController() = 0 {}
+    virtual ~ICameraController() = 0;
     virtual void onUpdate(float elapse) = 0;
     virtual void onKeyDown(int k) = 0;
     virtual void onKeyUp(int k) = 0;
@@ -19,6 +19,7 @@ struct ICameraController
     virtual void onMouseButtonUp(int btn, float x, float y) = 0;
     virtual void onMouseMove(float x, float y) = 0;
 };
+inline ICameraController::~ICameraController() {}
 
 class FPSCameraController:
     public ICameraController
@@ -23,7 +23,7 @@ public:
     Entity(E_SceneObjType t, const std::string& name);
     const std::string name() const;
 
-    virtual ~Entity() = 0{}
+    virtual ~Entity() = 0;
     virtual AABB getBoundAABB() const = 0;
     virtual Sphere getBoundSphere() const = 0;
     
@@ -32,6 +32,7 @@ public:
 private:
     std::string m_name;
 };
+inline Entity::~Entity() {}
 
 class StaticEntity:
     public Entity
@@ -23,7 +23,7 @@ public:
             const Vector3& specular,
             const Vector3& attenuation,
             float range);
-    virtual ~Light() = 0 {}
+    virtual ~Light() = 0;
 
     virtual void beginLighting(
             const Matrix4x4& modelSpaceMat,
@@ -44,6 +44,7 @@ protected:
     Vector3 m_attenuation;
     float m_range;
 };
+inline Light::~Light() {}
 
 class PointLight:
     public Light
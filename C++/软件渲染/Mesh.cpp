@@ -10,6 +10,7 @@
 #include "Serialize.h"
 #include "Matrix.h"
 #include "Geometry.h"
+#include "../RenderCommon/SimdMath.h"
 
 void VertexBuffer::resizeElementList(int n) const
 {
@@ -79,10 +80,13 @@ void SubMesh::genVertexNormals()
 void SubMesh::genTexcoords(const Matrix4x4& mat)
 {
     if (vertexBuffer.getVertexType() & EVET_texCoord) return;
-    for (int i = 0; i < vertexBuffer.getVertexCount(); ++i) {
-        Vector4 v(vertexBuffer.element3<EVEI_position>(i));
-        transform(v, mat);
-        vertexBuffer.addElement<EVEI_texCoord>((Vector2&)v);
+    int vCnt = vertexBuffer.getVertexCount();
+    std::vector<Vector4> uvs(vCnt);
+    if (vCnt > 0) {
+        transformPoints(&vertexBuffer.getElementList3<EVEI_position>()[0], &uvs[0], vCnt, mat);
+    }
+    for (int i = 0; i < vCnt; ++i) {
+        vertexBuffer.addElement<EVEI_texCoord>((Vector2&)uvs[i]);
     }
     vertexBuffer.setVertexType(vertexBuffer.getVertexType() | EVET_texCoord);
 }
@@ -16,10 +16,22 @@ int Rasterizer::pitch() const { return m_pitch; }
 
 Rasterizer::Rasterizer(char *buf, int w, int h, int pitch,
         float *zbuf, Sampler* sampler):
-    m_buf(buf), m_w(w), m_h(h), m_pitch(pitch), m_zbuf(zbuf), m_sampler(sampler)
+    m_buf(buf), m_w(w), m_h(h), m_pitch(pitch), m_zbuf(zbuf), m_sampler(sampler),
+    m_halfSpace(false), m_clipX0(0), m_clipY0(0), m_clipX1(w), m_clipY1(h), m_hizBuf(NULL)
 {
     assert(m_buf != NULL && m_w > 0 && m_h > 0 && m_pitch >= 4);
 }
+void Rasterizer::setClipRect(int x0, int y0, int x1, int y1, float *hizBuf)
+{
+    assert(x0 >= 0 && y0 >= 0 && x1 <= m_w && y1 <= m_h && x0 < x1 && y0 < y1);
+    m_halfSpace = true;
+    m_clipX0 = x0, m_clipY0 = y0, m_clipX1 = x1, m_clipY1 = y1;
+    m_hizBuf = hizBuf;
+}
+void Rasterizer::setSampler(Sampler *sampler)
+{
+    m_sampler = sampler;
+}
 void Rasterizer::drawLine(int x0, int y0, int x1, int y1, int rgb)
 {
     // ü
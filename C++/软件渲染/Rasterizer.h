@@ -4,9 +4,12 @@
 #define RASTERIZER_H
 
 #include <cassert>
+#include <cmath>
 
 #include <algorithm>
 
+#include <xmmintrin.h>
+
 #include "Vector.h"
 #include "Sampler.h"
 #include "VectorT.h"
@@ -41,6 +44,7 @@ inline int color255Vector2Int(const Vector3& clr)
 
 struct PixelShader_Flat
 {
+    enum { TEXTURED = 0 };
     int operator () (
             float v, int color, const Sampler* sampler) const
     {
@@ -49,24 +53,39 @@ struct PixelShader_Flat
 };
 struct PixelShader_TexturedFlat
 {
+    enum { TEXTURED = 1 };
+    static const Vector2& texCoord(const Vector2& uv) { return uv; }
     int operator () (
             const Vector2& uv, const Vector3& color, const Sampler* sampler) const
     {
-        return color255Vector2Int(color.multiply(sampler->sample(uv)));
+        return (*this)(uv, color, sampler->sample(uv));
+    }
+    int operator () (
+            const Vector2& uv, const Vector3& color, const Vector3& texel) const
+    {
+        return color255Vector2Int(color.multiply(texel));
     }
 };
 struct PixelShader_TexturedFlatWithSpecular
 {
+    enum { TEXTURED = 1 };
+    static const Vector2& texCoord(const Vector2& uv) { return uv; }
     int operator () (
             const Vector2& uv, const std::pair<Vector3, Vector3>& clrs, const Sampler* sampler) const
+    {
+        return (*this)(uv, clrs, sampler->sample(uv));
+    }
+    int operator () (
+            const Vector2& uv, const std::pair<Vector3, Vector3>& clrs, const Vector3& texel) const
     {
         Vector3 clr(clrs.first);
-        clr.multiplyInplace(sampler->sample(uv)) += clrs.second;
+        clr.multiplyInplace(texel) += clrs.second;
         return color255Vector2Int(clr);
     }
 };
 struct PixelShader_Gouraud
 {
+    enum { TEXTURED = 0 };
     int operator () (
             const Vector3& clr, int _, const Sampler* sampler) const
     {
@@ -75,29 +94,42 @@ struct PixelShader_Gouraud
 };
 struct PixelShader_TexturedGouraud
 {
+    enum { TEXTURED = 1 };
+    static const Vector2& texCoord(const Vector2T<Vector3, Vector2>& v) { return v.t1; }
     int operator () (
             const Vector2T<Vector3, Vector2>& v, int _, const Sampler* sampler) const
+    {
+        return (*this)(v, _, sampler->sample(texCoord(v)));
+    }
+    int operator () (
+            const Vector2T<Vector3, Vector2>& v, int _, const Vector3& texel) const
     {
         const Vector3& clr = v.t0;
-        const Vector2& uv = v.t1;
-        return color255Vector2Int(clr.multiply(sampler->sample(uv)));
+        return color255Vector2Int(clr.multiply(texel));
     }
 };
 struct PixelShader_TexturedGouraudWithSpecular
 {
+    enum { TEXTURED = 1 };
+    static const Vector2& texCoord(const Vector3T<Vector3, Vector3, Vector2>& v) { return v.t2; }
     int operator () (
             const Vector3T<Vector3, Vector3, Vector2>& v, int _, const Sampler* sampler) const
+    {
+        return (*this)(v, _, sampler->sample(texCoord(v)));
+    }
+    int operator () (
+            const Vector3T<Vector3, Vector3, Vector2>& v, int _, const Vector3& texel) const
     {
         const Vector3& clr = v.t0;
         const Vector3& clr2 = v.t1;
-        const Vector2& uv = v.t2;
         Vector3 r(clr);
-        r.multiplyInplace(sampler->sample(uv)) += clr2;
+        r.multiplyInplace(texel) += clr2;
         return color255Vector2Int(r);
     }
 };
 struct PixelShader_Phong
 {
+    enum { TEXTURED = 0 };
     // ʵ˶ɫһ򶥵ɫãټһֵ
     // ̫
     int operator () (
@@ -110,6 +142,7 @@ struct PixelShader_Phong
 };
 struct PixelShader_PhongWithSpecular
 {
+    enum { TEXTURED = 0 };
     // ʵ˶ɫһ򶥵ɫãټһֵ
     // ̫
     int operator () (
@@ -122,28 +155,40 @@ struct PixelShader_PhongWithSpecular
 };
 struct PixelShader_TexturedPhong
 {
+    enum { TEXTURED = 1 };
+    static const Vector2& texCoord(const Vector3T<Vector3, Vector3, Vector2>& v) { return v.t2; }
     int operator () (
             const Vector3T<Vector3, Vector3, Vector2>& v, const Light* l, const Sampler* sampler) const
+    {
+        return (*this)(v, l, sampler->sample(texCoord(v)));
+    }
+    int operator () (
+            const Vector3T<Vector3, Vector3, Vector2>& v, const Light* l, const Vector3& texel) const
     {
         const Vector3& pos = v.t0;
         const Vector3& norm = v.t1;
-        const Vector2& uv = v.t2;
         Vector3 r(l->illuminate(pos, norm));
-        r.multiplyInplace(sampler->sample(uv));
+        r.multiplyInplace(texel);
         return colorVector2Int(r);
     }
 };
 struct PixelShader_TexturedPhongWithSpecular
 {
+    enum { TEXTURED = 1 };
+    static const Vector2& texCoord(const Vector3T<Vector3, Vector3, Vector2>& v) { return v.t2; }
     int operator () (
             const Vector3T<Vector3, Vector3, Vector2>& v, const Light* l, const Sampler* sampler) const
+    {
+        return (*this)(v, l, sampler->sample(texCoord(v)));
+    }
+    int operator () (
+            const Vector3T<Vector3, Vector3, Vector2>& v, const Light* l, const Vector3& texel) const
     {
         const Vector3& pos = v.t0;
         const Vector3& norm = v.t1;
-        const Vector2& uv = v.t2;
         Vector3 specular(Vector3::ZERO);
         Vector3 r = l->illuminateWithSeparateSpecular(pos, norm, specular);
-        r.multiplyInplace(sampler->sample(uv)) += specular;
+        r.multiplyInplace(texel) += specular;
         return colorVector2Int(r);
     }
 };
@@ -172,6 +217,13 @@ public:
     int height() const;
     int pitch() const;
 
+    // ֿȾã֮drawTriangleֻ[x0,x1)x[y0,y1)أðƽԣ
+    // hizBufÿBLOCK_SIZE*BLOCK_SIZEһԶȣΪNULL
+    void setClipRect(int x0, int y0, int x1, int y1, float *hizBuf);
+    void setSampler(Sampler *sampler);
+
+    static const int BLOCK_SIZE = 8;
+
 private:
     template<E_ZBufferType zbufT, typename PixelShader, typename VectorN, typename ConstT>
     void drawTriangle_Top(
@@ -185,11 +237,20 @@ private:
             const Vector3& p1, const VectorN& d1,
             const Vector3& p2, const VectorN& d2,
             const ConstT& c);
+    template<E_ZBufferType zbufT, typename PixelShader, typename VectorN, typename ConstT>
+    void drawTriangle_HalfSpace(
+            const Vector3& p0, const VectorN& d0, 
+            const Vector3& p1, const VectorN& d1,
+            const Vector3& p2, const VectorN& d2,
+            const ConstT& c);
 private:
     char *m_buf;
     float *m_zbuf;
     int m_w, m_h, m_pitch;
     Sampler *m_sampler;
+    bool m_halfSpace;
+    int m_clipX0, m_clipY0, m_clipX1, m_clipY1;
+    float *m_hizBuf;
 };
 
 template<E_ZBufferType zbufT, typename PixelShader, typename VectorN, typename ConstT>
@@ -208,6 +269,11 @@ void Rasterizer::drawTriangle(
         p2.z = 1 / p2.z; d2 *= p2.z;
     }
 
+    if (m_halfSpace) {
+        drawTriangle_HalfSpace<zbufT, PixelShader, VectorN, ConstT>(p0, d0, p1, d1, p2, d2, c);
+        return;
+    }
+
     if (p0.y > p1.y) {
         std::swap(p0, p1);
         std::swap(d0, d1);
@@ -425,4 +491,232 @@ void Rasterizer::drawTriangle_Bottom(
     }
 }
 
+// ĳڵǷ񶼱zzbufzʱԽСԽ1/zʱԽԽ
+// 2x2һɫɫsampleQuadһLOD4صõ
+template<bool textured>
+struct QuadShading
+{
+    template<typename PixelShader, typename VectorN, typename ConstT>
+    static void shade(
+            const PixelShader& pshader, const VectorN* const* ds, const ConstT& c,
+            const Sampler* sampler, int mask, int *clrs)
+    {
+        for (int k = 0; k < 4; ++k) {
+            if (mask & (1 << k)) clrs[k] = pshader(*ds[k], c, sampler);
+        }
+    }
+};
+template<>
+struct QuadShading<true>
+{
+    template<typename PixelShader, typename VectorN, typename ConstT>
+    static void shade(
+            const PixelShader& pshader, const VectorN* const* ds, const ConstT& c,
+            const Sampler* sampler, int mask, int *clrs)
+    {
+        Vector2 uvs[4];
+        Vector3 texels[4];
+        for (int k = 0; k < 4; ++k) uvs[k] = PixelShader::texCoord(*ds[k]);
+        sampler->sampleQuad(uvs, texels, mask);
+        for (int k = 0; k < 4; ++k) {
+            if (mask & (1 << k)) clrs[k] = pshader(*ds[k], c, texels[k]);
+        }
+    }
+};
+
+template<E_ZBufferType zbufT>
+inline bool depthNearer(float a, float b)
+{
+    return zbufT == EZBT_zbuf ? a < b : a > b;
+}
+template<E_ZBufferType zbufT>
+inline __m128 depthNearer(__m128 a, __m128 b)
+{
+    return zbufT == EZBT_zbuf ? _mm_cmplt_ps(a, b) : _mm_cmpgt_ps(a, b);
+}
+
+// ƽԣÿBLOCK_SIZE*BLOCK_SIZEĿÿϵıߺֵ޳ܣ
+// ÷ֲz޳ÿ2x2һSSEߺȲԣɫһһ
+// ǹɨ߰һȡ꣬ߺϱ߰ұߺ±߲
+template<E_ZBufferType zbufT, typename PixelShader, typename VectorN, typename ConstT>
+void Rasterizer::drawTriangle_HalfSpace(
+        const Vector3& _p0, const VectorN& d0, 
+        const Vector3& _p1, const VectorN& _d1,
+        const Vector3& _p2, const VectorN& _d2,
+        const ConstT& c)
+{
+    const Vector3 &p0 = _p0;
+    float area = (_p1.x - p0.x) * (_p2.y - p0.y) - (_p2.x - p0.x) * (_p1.y - p0.y);
+    if (fequal(area, 0)) return; // ˻
+    bool flip = area < 0;
+    const Vector3 &p1 = flip ? _p2 : _p1, &p2 = flip ? _p1 : _p2;
+    const VectorN &d1 = flip ? _d2 : _d1, &d2 = flip ? _d1 : _d2;
+    if (flip) area = -area;
+
+    // ΧУڸضϣֹӿԶĶתintʱ
+    float minX = std::max(std::min(p0.x, std::min(p1.x, p2.x)), (float)m_clipX0 - 1);
+    float maxX = std::min(std::max(p0.x, std::max(p1.x, p2.x)), (float)m_clipX1 + 1);
+    float minY = std::max(std::min(p0.y, std::min(p1.y, p2.y)), (float)m_clipY0 - 1);
+    float maxY = std::min(std::max(p0.y, std::max(p1.y, p2.y)), (float)m_clipY1 + 1);
+    int xfirst = std::max((int)ceil(minX), m_clipX0);
+    int xlast = std::min((int)ceil(maxX) - 1, m_clipX1 - 1);
+    int yfirst = std::max((int)ceil(minY), m_clipY0);
+    int ylast = std::min((int)ceil(maxY) - 1, m_clipY1 - 1);
+    if (xfirst > xlast || yfirst > ylast) return;
+
+    // iĶԽǶiߺΪԭȡڰΧϽԼС
+    const Vector3* vs[3] = {&p0, &p1, &p2};
+    float ea[3], eb[3], e0[3];
+    bool inclusive[3];
+    for (int i = 0; i < 3; ++i) {
+        const Vector3 &a = *vs[(i + 1) % 3], &b = *vs[(i + 2) % 3];
+        ea[i] = a.y - b.y;
+        eb[i] = b.x - a.x;
+        e0[i] = (b.x - a.x) * (yfirst - a.y) - (b.y - a.y) * (xfirst - a.x);
+        inclusive[i] = ea[i] > 0 || (ea[i] == 0 && eb[i] > 0);
+    }
+
+    // xyĵֵȺ
+    float invArea = 1 / area;
+    float l1x = ea[1] * invArea, l1y = eb[1] * invArea, l10 = e0[1] * invArea;
+    float l2x = ea[2] * invArea, l2y = eb[2] * invArea, l20 = e0[2] * invArea;
+    float za = (p1.z - p0.z) * l1x + (p2.z - p0.z) * l2x;
+    float zb = (p1.z - p0.z) * l1y + (p2.z - p0.z) * l2y;
+    float z0 = p0.z + (p1.z - p0.z) * l10 + (p2.z - p0.z) * l20;
+    VectorN dd1(d1 - d0), dd2(d2 - d0);
+    VectorN ddx(dd1 * l1x + dd2 * l2x);
+    VectorN ddy(dd1 * l1y + dd2 * l2y);
+    VectorN dOrigin(d0 + dd1 * l10 + dd2 * l20);
+
+    // ȣֲz޳
+    float triNearest = zbufT == EZBT_zbuf ?
+        std::min(p0.z, std::min(p1.z, p2.z)) : std::max(p0.z, std::max(p1.z, p2.z));
+    int hizPitch = (m_w + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    const __m128 quadX = _mm_set_ps(1, 0, 1, 0), quadY = _mm_set_ps(1, 1, 0, 0);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 allOnes = _mm_cmpeq_ps(zero, zero);
+    __m128 eQuad[3], inclusiveMask[3];
+    for (int i = 0; i < 3; ++i) {
+        eQuad[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ea[i]), quadX), _mm_mul_ps(_mm_set1_ps(eb[i]), quadY));
+        inclusiveMask[i] = inclusive[i] ? allOnes : zero;
+    }
+    __m128 zQuad = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), quadX), _mm_mul_ps(_mm_set1_ps(zb), quadY));
+
+    PixelShader pshader;
+    int bxfirst = xfirst / BLOCK_SIZE * BLOCK_SIZE, byfirst = yfirst / BLOCK_SIZE * BLOCK_SIZE;
+    for (int by = byfirst; by <= ylast; by += BLOCK_SIZE) {
+        for (int bx = bxfirst; bx <= xlast; bx += BLOCK_SIZE) {
+            // ޳ÿڿڵĽ
+            float rx = float(bx - xfirst), ry = float(by - yfirst);
+            bool covered = true;
+            bool outside = false;
+            for (int i = 0; i < 3 && !outside; ++i) {
+                float eMin = e0[i] + ea[i] * rx + eb[i] * ry;
+                float eMax = eMin;
+                (ea[i] > 0 ? eMax : eMin) += ea[i] * (BLOCK_SIZE - 1);
+                (eb[i] > 0 ? eMax : eMin) += eb[i] * (BLOCK_SIZE - 1);
+                if (eMax < 0) outside = true;
+                if (eMin <= 0) covered = false;
+            }
+            if (outside) continue;
+
+            float *hiz = NULL;
+            if (zbufT != EZBT_null && m_hizBuf != NULL) {
+                hiz = m_hizBuf + (by / BLOCK_SIZE) * hizPitch + bx / BLOCK_SIZE;
+                if (!depthNearer<zbufT>(triNearest, *hiz)) continue;
+            }
+
+            int x0 = std::max(bx, xfirst), x1 = std::min(bx + BLOCK_SIZE - 1, xlast);
+            int y0 = std::max(by, yfirst), y1 = std::min(by + BLOCK_SIZE - 1, ylast);
+            covered = covered && x1 - x0 == BLOCK_SIZE - 1 && y1 - y0 == BLOCK_SIZE - 1;
+
+            // 2x2һ飺(qx,qy)(qx+1,qy)(qx,qy+1)(qx+1,qy+1)
+            // ˷ΧزֵLOD
+            for (int qy = y0 & ~1; qy <= y1; qy += 2) {
+                float fy = float(qy - yfirst);
+                for (int qx = x0 & ~1; qx <= x1; qx += 2) {
+                    float fx = float(qx - xfirst);
+                    int mask = 0xf;
+                    if (qx < x0) mask &= ~0x5;
+                    if (qx + 1 > x1) mask &= ~0xa;
+                    if (qy < y0) mask &= ~0x3;
+                    if (qy + 1 > y1) mask &= ~0xc;
+                    if (!covered) {
+                        __m128 inside = allOnes;
+                        for (int i = 0; i < 3; ++i) {
+                            __m128 e = _mm_add_ps(_mm_set1_ps(e0[i] + ea[i] * fx + eb[i] * fy), eQuad[i]);
+                            __m128 edgeInside = _mm_or_ps(
+                                    _mm_cmpgt_ps(e, zero),
+                                    _mm_and_ps(_mm_cmpeq_ps(e, zero), inclusiveMask[i]));
+                            inside = _mm_and_ps(inside, edgeInside);
+                        }
+                        mask &= _mm_movemask_ps(inside);
+                        if (mask == 0) continue;
+                    }
+
+                    __m128 z = _mm_add_ps(_mm_set1_ps(z0 + za * fx + zb * fy), zQuad);
+                    float zs[4];
+                    _mm_storeu_ps(zs, z);
+                    if (zbufT != EZBT_null) {
+                        float *zrows[2] = {m_zbuf + qy * m_w + qx, m_zbuf + (qy + 1) * m_w + qx};
+                        if (mask == 0xf) {
+                            __m128 oldZ = _mm_loadh_pi(
+                                    _mm_loadl_pi(zero, (const __m64*)zrows[0]), (const __m64*)zrows[1]);
+                            __m128 writeMask = depthNearer<zbufT>(z, oldZ);
+                            mask = _mm_movemask_ps(writeMask);
+                            __m128 newZ = _mm_or_ps(_mm_and_ps(writeMask, z), _mm_andnot_ps(writeMask, oldZ));
+                            _mm_storel_pi((__m64*)zrows[0], newZ);
+                            _mm_storeh_pi((__m64*)zrows[1], newZ);
+                        }
+                        else {
+                            for (int k = 0; k < 4; ++k) {
+                                if (!(mask & (1 << k))) continue;
+                                float &oldZ = zrows[k >> 1][k & 1];
+                                if (depthNearer<zbufT>(zs[k], oldZ)) oldZ = zs[k];
+                                else mask &= ~(1 << k);
+                            }
+                        }
+                        if (mask == 0) continue;
+                    }
+
+                    VectorN d0(dOrigin + ddx * fx + ddy * fy);
+                    VectorN d1(d0 + ddx), d2(d0 + ddy);
+                    VectorN d3(d1 + ddy);
+                    if (zbufT == EZBT_1zbuf) {
+                        // Ƴ1/zܲһҪص
+                        float zInside = zs[mask & 1 ? 0 : (mask & 2 ? 1 : (mask & 4 ? 2 : 3))];
+                        d0 = d0 / (zs[0] > 0 ? zs[0] : zInside);
+                        d1 = d1 / (zs[1] > 0 ? zs[1] : zInside);
+                        d2 = d2 / (zs[2] > 0 ? zs[2] : zInside);
+                        d3 = d3 / (zs[3] > 0 ? zs[3] : zInside);
+                    }
+                    const VectorN* ds[4] = {&d0, &d1, &d2, &d3};
+                    int clrs[4];
+                    QuadShading<PixelShader::TEXTURED != 0>::shade(pshader, ds, c, m_sampler, mask, clrs);
+                    for (int k = 0; k < 4; ++k) {
+                        if (mask & (1 << k)) ((int*)(m_buf + (qy + (k >> 1)) * m_pitch))[qx + (k & 1)] = clrs[k];
+                    }
+                }
+            }
+
+            // 鶼ʱڵԶȿܱˣһ
+            if (hiz != NULL && covered) {
+                __m128 farthest = _mm_loadu_ps(m_zbuf + by * m_w + bx);
+                for (int y = by; y < by + BLOCK_SIZE; ++y) {
+                    for (int x = bx; x < bx + BLOCK_SIZE; x += 4) {
+                        __m128 v = _mm_loadu_ps(m_zbuf + y * m_w + x);
+                        farthest = zbufT == EZBT_zbuf ? _mm_max_ps(farthest, v) : _mm_min_ps(farthest, v);
+                    }
+                }
+                float fs[4];
+                _mm_storeu_ps(fs, farthest);
+                *hiz = zbufT == EZBT_zbuf ?
+                    std::max(std::max(fs[0], fs[1]), std::max(fs[2], fs[3])) :
+                    std::min(std::min(fs[0], fs[1]), std::min(fs[2], fs[3]));
+            }
+        }
+    }
+}
+
 #endif // #ifndef RASTERIZER_H
@@ -1,6 +1,8 @@
 // vim: fileencoding=gbk
 #include "pch.h"
 
+#include <cstring>
+
 #include "SceneManager.h"
 #include "Renderer.h"
 #include "RenderStateEnums.h"
@@ -16,7 +18,7 @@ SceneManager* g_sceneMgr;
 Renderer* g_renderer;
 bool g_outputLog;
 bool g_printScreen;
-int g_renderState[7];
+int g_renderState[8];
 
 bool saveImage(const char *fname, const char *buf, int w, int h, int pitch);
 
@@ -35,7 +37,7 @@ void switchRenderState(int i)
         case 1:
             {
                 E_TextureFilterType states[] = { 
-                    ETFT_null, ETFT_point, ETFT_bilinear, ETFT_trilinear, ETFT_mipmapDbg,
+                    ETFT_null, ETFT_point, ETFT_bilinear, ETFT_trilinear, ETFT_anisotropic, ETFT_mipmapDbg,
                 };
                 g_renderState[i] = (g_renderState[i] + 1) % arraySize(states);
                 g_renderer->setTextureFilterType(states[g_renderState[i]]);
@@ -86,6 +88,15 @@ void switchRenderState(int i)
                 g_renderer->setTextureAddressingMode(states[g_renderState[i]]);
             }
             break;
+        case 7:
+            {
+                E_RasterizeMode states[] = {
+                    ERM_scanline, ERM_tiled,
+                };
+                g_renderState[i] = (g_renderState[i] + 1) % arraySize(states);
+                g_renderer->setRasterizeMode(states[g_renderState[i]]);
+            }
+            break;
         default: break;
     }
 }
@@ -165,7 +176,7 @@ void onKeyUp(int k)
     if(g_sceneMgr != NULL) g_sceneMgr->onKeyUp(k);
     if (k == 'O') g_outputLog = true;
     if (k == 'P') g_printScreen = true;
-    if (k >= '1' && k <= '7') switchRenderState(k - '1');
+    if (k >= '1' && k <= '8') switchRenderState(k - '1');
     if (k == 'C') setClipPlane();
 }
 
@@ -32,6 +32,7 @@ const char* enum2Str(E_TextureFilterType t)
         case ETFT_bilinear: return "TextureFilterType_bilinear";
         case ETFT_trilinear: return "TextureFilterType_trilinear";
         case ETFT_mipmapDbg: return "TextureFilterType_mipmapDbg";
+        case ETFT_anisotropic: return "TextureFilterType_anisotropic";
         default: break;
     }
     return "";
@@ -77,3 +78,13 @@ const char* enum2Str(E_SpecularLight t)
     }
     return "";
 }
+
+const char* enum2Str(E_RasterizeMode t)
+{
+    switch (t) {
+        case ERM_scanline: return "RasterizeMode_scanline";
+        case ERM_tiled: return "RasterizeMode_tiled";
+        default: break;
+    }
+    return "";
+}
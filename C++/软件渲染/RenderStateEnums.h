@@ -22,6 +22,7 @@ enum E_TextureFilterType
     ETFT_bilinear,
     ETFT_trilinear,
     ETFT_mipmapDbg,
+    ETFT_anisotropic,
 };
 enum E_TextureAddressingMode
 {
@@ -46,6 +47,11 @@ enum E_SpecularLight
     ESL_disable,
     ESL_enbale,
 };
+enum E_RasterizeMode
+{
+    ERM_scanline,
+    ERM_tiled,
+};
 
 const char* enum2Str(E_ZBufferType t);
 const char* enum2Str(E_ShadeMode t);
@@ -54,5 +60,6 @@ const char* enum2Str(E_TextureAddressingMode t);
 const char* enum2Str(E_CullFace t);
 const char* enum2Str(E_ZSortType t);
 const char* enum2Str(E_SpecularLight t);
+const char* enum2Str(E_RasterizeMode t);
 
 #endif // #ifndef RENDERSTATEENUMS_H
@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 
 #include <vector>
 
@@ -19,6 +20,7 @@
 #include "Rasterizer.h"
 #include "Mesh.h"
 #include "SceneManager.h"
+#include "../RenderCommon/SimdMath.h"
 
 #define RGB(r, g, b) ((r << 16) | (g << 8) | b)
 
@@ -86,6 +88,8 @@ public:
     int* vertexCullBuffer() { return &m_vertexCullBuf[0];}
     int* triangleCullBuffer() { return &m_triangleCullBuf[0];}
     std::pair<float, int>* triangleZDis2IdxBuffer() { return &m_triangleZDis2IdxBuf[0]; }
+    std::pair<int, int>* drawListBuffer() { return &m_drawListBuf[0]; }
+    std::vector<int>* tileBinBuffer(int tileCnt);
 private:
     std::vector<Vector4> m_posBuf;
     std::vector<Vector4> m_normBuf;
@@ -95,6 +99,8 @@ private:
     std::vector<int> m_vertexCullBuf;
     std::vector<int> m_triangleCullBuf;
     std::vector<std::pair<float, int> > m_triangleZDis2IdxBuf;
+    std::vector<std::pair<int, int> > m_drawListBuf;
+    std::vector<std::vector<int> > m_tileBinBuf;
 };
 void PipelineCache::notifyVertexCount(int vCnt)
 {
@@ -109,6 +115,13 @@ void PipelineCache::notifyTriangleCount(int tCnt)
 {
     m_triangleCullBuf.resize(tCnt);
     m_triangleZDis2IdxBuf.resize(tCnt);
+    m_drawListBuf.resize(tCnt);
+}
+std::vector<int>* PipelineCache::tileBinBuffer(int tileCnt)
+{
+    m_tileBinBuf.resize(tileCnt);
+    for (int i = 0; i < tileCnt; ++i) m_tileBinBuf[i].clear();
+    return &m_tileBinBuf[0];
 }
 
 class Renderer_Impl
@@ -140,6 +153,9 @@ public:
     E_SpecularLight getSpecularLight() const;
     void setSpecularLight(E_SpecularLight t);
 
+    E_RasterizeMode getRasterizeMode() const;
+    void setRasterizeMode(E_RasterizeMode t);
+
     void addClipPlane(const Plane& p);
     void clearClipPlane();
 
@@ -152,12 +168,22 @@ private:
             const Vector4* posBuf, const Vector3* clrBuf, const Vector2* texBuf,
             const Vector3* srcPosBuf, const Vector3* srcNormBuf,
             const Vector3* clrBuf2);
+    void drawTrianglesTiled(
+            Rasterizer &rasterizer, const Light* l,
+            const std::pair<int, int>* drawList, int drawCnt,
+            const IndexTriangle* triBuf,
+            const Vector4* posBuf, const Vector3* clrBuf, const Vector2* texBuf,
+            const Vector3* srcPosBuf, const Vector3* srcNormBuf,
+            const Vector3* clrBuf2);
 
 private:
+    static const int TILE_SIZE = 64; // Rasterizer::BLOCK_SIZEı
+
     const SceneManager *m_sceneMgr;
     PipelineCache   *m_pipeCache;
     Sampler m_sampler;
     std::vector<float> m_zbuf;
+    std::vector<float> m_hizBuf; // ÿRasterizer::BLOCK_SIZEĿһԶ
     std::vector<Plane> m_clipPlanes;
 
     E_CullFace m_cullFace;
@@ -167,12 +193,16 @@ private:
     E_ShadeMode m_shadeMode;
     E_ZSortType m_zsortType;
     E_SpecularLight m_specularLight;
+    E_RasterizeMode m_rasterizeMode;
 };
 Renderer_Impl::Renderer_Impl(const SceneManager* sceneMgr):
     m_sceneMgr(sceneMgr), m_pipeCache(new PipelineCache()),
     m_cullFace(ECF_back), m_texFilterType(ETFT_null), m_zbufType(EZBT_null),
     m_shadeMode(ESM_frame), m_zsortType(EZST_null), m_specularLight(ESL_disable),
-    m_texAddressingMode(ETAM_clamp)
+    m_texAddressingMode(ETAM_clamp),
+    // ֿդֻжʱŻ㣺߳640x480Ĳconst_zbufɨ1304֡/롢ֿ440֡/룬
+    // ģʽ1.7-3ʱҪڰƽϣСΰΧĿԺ2x2أɨеĿ
+    m_rasterizeMode(ERM_scanline)
 {
 }
 Renderer_Impl::~Renderer_Impl()
@@ -194,6 +224,8 @@ E_SpecularLight Renderer_Impl::getSpecularLight() const { return m_specularLight
 void Renderer_Impl::setSpecularLight(E_SpecularLight t) { m_specularLight = t; }
 E_TextureAddressingMode Renderer_Impl::getTextureAddressingMode() const { return m_texAddressingMode;}
 void Renderer_Impl::setTextureAddressingMode(E_TextureAddressingMode t) { m_texAddressingMode = t;}
+E_RasterizeMode Renderer_Impl::getRasterizeMode() const { return m_rasterizeMode; }
+void Renderer_Impl::setRasterizeMode(E_RasterizeMode t) { m_rasterizeMode = t; }
 
 void Renderer_Impl::addClipPlane(const Plane& p) { m_clipPlanes.push_back(p); }
 void Renderer_Impl::clearClipPlane() { m_clipPlanes.clear(); }
@@ -207,6 +239,12 @@ void Renderer_Impl::render(char *buf, int w, int h, int pitch)
         m_zbuf.resize(w * h);
         memset(&m_zbuf[0], 0, w * h * sizeof(m_zbuf[0]));
     }
+    if (m_zbufType != EZBT_null) {
+        int blockCnt = 
+            ((w + Rasterizer::BLOCK_SIZE - 1) / Rasterizer::BLOCK_SIZE) * 
+            ((h + Rasterizer::BLOCK_SIZE - 1) / Rasterizer::BLOCK_SIZE);
+        m_hizBuf.assign(blockCnt, m_zbufType == EZBT_zbuf ? 1.f : 0.f);
+    }
 
     Rasterizer rasterizer(buf, w, h, pitch, 
             m_zbufType == EZBT_null ? NULL : &m_zbuf[0],
@@ -588,11 +626,8 @@ void Renderer_Impl::renderSubMesh(Rasterizer &rasterizer,
         }
     }
 
-    // ͼͶӰ任
-    for (int i = 0; i < vCnt; ++i) {
-        if (vertexRefBuf[i] == 0) continue;
-        transform(posBuf[i], worldViewProjMat);
-    }
+    // ͼͶӰ任ûõĶҲһ任ʡж
+    transformPoints(posBuf, posBuf, vCnt, worldViewProjMat);
 
     // ͶӰü
     for (int i = 0; i < vCnt; ++i) {
@@ -668,15 +703,13 @@ void Renderer_Impl::renderSubMesh(Rasterizer &rasterizer,
         }
     }
 
-    // 
+    // ȷ˳(α, ±)
+    std::pair<int, int> *drawList = m_pipeCache->drawListBuffer();
+    int drawCnt = 0;
     if (m_zsortType == EZST_null) { // z
         for (int i = 0; i < tCnt; ++i) {
             if (triCullBuf[i]) continue;
-            const IndexTriangle& tri(triBuf[i]);
-            drawTriangle(
-                    rasterizer, &m_sampler, light, i, 
-                    tri,
-                    posBuf, clrBuf, texBuf, srcPosBuf, srcNormBuf, clrBuf2);
+            drawList[drawCnt++] = std::pair<int, int>(i, i);
         }
     }
     else 
@@ -698,10 +731,21 @@ void Renderer_Impl::renderSubMesh(Rasterizer &rasterizer,
             std::sort(triZ2IdxBuf, triZ2IdxBuf + tri2IdxBufLen, PairFirstGreater<std::pair<float, int> >());
         }
         for (int i = 0; i < tri2IdxBufLen; ++i) {
-            const IndexTriangle& tri(triBuf[triZ2IdxBuf[i].second]);
+            drawList[drawCnt++] = std::pair<int, int>(i, triZ2IdxBuf[i].second);
+        }
+    }
+
+    // 
+    if (m_rasterizeMode == ERM_tiled && m_shadeMode != ESM_frame) {
+        drawTrianglesTiled(
+                rasterizer, light, drawList, drawCnt, triBuf,
+                posBuf, clrBuf, texBuf, srcPosBuf, srcNormBuf, clrBuf2);
+    }
+    else {
+        for (int i = 0; i < drawCnt; ++i) {
             drawTriangle(
-                    rasterizer, &m_sampler, light, i, 
-                    tri,
+                    rasterizer, &m_sampler, light, drawList[i].first, 
+                    triBuf[drawList[i].second],
                     posBuf, clrBuf, texBuf, srcPosBuf, srcNormBuf, clrBuf2);
         }
     }
@@ -989,6 +1033,65 @@ void Renderer_Impl::drawTriangle(
         sampler->endSample();
     }
 }
+// ȰΧаηֵĻڱԭĻ˳ٶ̸߳Ŀ飬
+// ֮䲻غzλһ
+void Renderer_Impl::drawTrianglesTiled(
+        Rasterizer &rasterizer, const Light* l,
+        const std::pair<int, int>* drawList, int drawCnt,
+        const IndexTriangle* triBuf,
+        const Vector4* posBuf, const Vector3* clrBuf, const Vector2* texBuf,
+        const Vector3* srcPosBuf, const Vector3* srcNormBuf,
+        const Vector3* clrBuf2)
+{
+    int w = rasterizer.width(), h = rasterizer.height();
+    int tileCntX = (w + TILE_SIZE - 1) / TILE_SIZE;
+    int tileCnt = tileCntX * ((h + TILE_SIZE - 1) / TILE_SIZE);
+    std::vector<int> *bins = m_pipeCache->tileBinBuffer(tileCnt);
+
+    int binEntryCnt = 0;
+    for (int i = 0; i < drawCnt; ++i) {
+        const IndexTriangle& tri(triBuf[drawList[i].second]);
+        const Vector4 &p0 = posBuf[tri.v0], &p1 = posBuf[tri.v1], &p2 = posBuf[tri.v2];
+        float minX = std::max(std::min(p0.x, std::min(p1.x, p2.x)), -1.f);
+        float maxX = std::min(std::max(p0.x, std::max(p1.x, p2.x)), w + 1.f);
+        float minY = std::max(std::min(p0.y, std::min(p1.y, p2.y)), -1.f);
+        float maxY = std::min(std::max(p0.y, std::max(p1.y, p2.y)), h + 1.f);
+        // ͹դһ[ceil(min), ceil(max) - 1]
+        int x0 = std::max((int)ceil(minX), 0), x1 = std::min((int)ceil(maxX) - 1, w - 1);
+        int y0 = std::max((int)ceil(minY), 0), y1 = std::min((int)ceil(maxY) - 1, h - 1);
+        if (x0 > x1 || y0 > y1) continue;
+        for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ++ty) {
+            for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; ++tx) {
+                bins[ty * tileCntX + tx].push_back(i);
+                ++binEntryCnt;
+            }
+        }
+    }
+    Log::instance()->addMsg("tile bin entries : %d, triangles : %d", binEntryCnt, drawCnt);
+
+    float *hizBuf = m_zbufType == EZBT_null ? NULL : &m_hizBuf[0];
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < tileCnt; ++t) {
+        const std::vector<int>& bin = bins[t];
+        if (bin.empty()) continue;
+
+        // SamplerbeginSampleʱص״̬ÿ߳һ
+        Sampler sampler(m_sampler);
+        Rasterizer tileRasterizer(rasterizer);
+        int x0 = t % tileCntX * TILE_SIZE, y0 = t / tileCntX * TILE_SIZE;
+        tileRasterizer.setClipRect(
+                x0, y0, std::min(x0 + TILE_SIZE, w), std::min(y0 + TILE_SIZE, h), hizBuf);
+        if (m_texFilterType != ETFT_null) tileRasterizer.setSampler(&sampler);
+
+        for (int i = 0; i < (int)bin.size(); ++i) {
+            const std::pair<int, int>& item = drawList[bin[i]];
+            drawTriangle(
+                    tileRasterizer, &sampler, l, item.first, 
+                    triBuf[item.second],
+                    posBuf, clrBuf, texBuf, srcPosBuf, srcNormBuf, clrBuf2);
+        }
+    }
+}
 //----------------------------------------
 // Renderer
 //----------------------------------------
@@ -1053,5 +1156,12 @@ void Renderer::setSpecularLight(E_SpecularLight t)
     m_impl->setSpecularLight(t);
 }
 
+E_RasterizeMode Renderer::getRasterizeMode() const { return m_impl->getRasterizeMode(); }
+void Renderer::setRasterizeMode(E_RasterizeMode t)
+{
+    printf("change render state: %s -> %s\n", enum2Str(getRasterizeMode()), enum2Str(t));
+    m_impl->setRasterizeMode(t);
+}
+
 void Renderer::addClipPlane(const Plane& p) { m_impl->addClipPlane(p); }
 void Renderer::clearClipPlane() { m_impl->clearClipPlane(); }
@@ -37,6 +37,9 @@ public:
     E_SpecularLight getSpecularLight() const;
     void setSpecularLight(E_SpecularLight t);
 
+    E_RasterizeMode getRasterizeMode() const;
+    void setRasterizeMode(E_RasterizeMode t);
+
     void addClipPlane(const Plane& p);
     void clearClipPlane();
 private:
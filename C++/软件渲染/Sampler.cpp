@@ -2,10 +2,17 @@
 #include "pch.h"
 
 #include <cassert>
+#include <cmath>
+
+#include <algorithm>
+
+#include <emmintrin.h>
 
 #include "Sampler.h"
 #include "Vector.h"
 #include "Texture.h"
+#include "Util.h"
+#include "../RenderCommon/TextureFixed.h"
 
 struct AddressingMethod_Clamp
 {
@@ -216,11 +223,32 @@ private:
     Vector3 m_color;
 };
 
+// LODú׼ָβĶνƣ0.01
+static inline float fastLog2(float f)
+{
+    assert(f > 0);
+    union { float f; int i; } bits;
+    bits.f = f;
+    int exponent = ((bits.i >> 23) & 255) - 128;
+    bits.i = (bits.i & ~(255 << 23)) | (127 << 23);
+    float m = bits.f;
+    return exponent + ((-1.f / 3) * m + 2) * m - 2.f / 3;
+}
+
 Sampler::Sampler():
     m_tex(NULL), m_minFilterType(ETFT_point), m_maxFilterType(ETFT_point),
     m_uAddressingMode(ETAM_clamp), m_vAddressingMode(ETAM_clamp),
-    m_filterMethod(NULL)
+    m_filterMethod(NULL), m_quadUVScale(0)
 {
+    // ÿֹ˷Ҫŵým_memBufҲܳѰַʽǿ࣬ӰС
+    typedef PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat> Point;
+    typedef BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat> Bilinear;
+    typedef TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat> Trilinear;
+    static_assert(sizeof(Point) <= sizeof(MemBuf) && alignof(Point) <= alignof(MemBuf), "PointFilterMethod");
+    static_assert(sizeof(Bilinear) <= sizeof(MemBuf) && alignof(Bilinear) <= alignof(MemBuf), "BilinearFilterMethod");
+    static_assert(sizeof(Trilinear) <= sizeof(MemBuf) && alignof(Trilinear) <= alignof(MemBuf), "TrilinearFilterMethod");
+    static_assert(sizeof(ConstColorFilterMethod) <= sizeof(MemBuf) &&
+            alignof(ConstColorFilterMethod) <= alignof(MemBuf), "ConstColorFilterMethod");
 }
 void Sampler::setTexture(const Texture* tex) { m_tex = tex; }
 void Sampler::setMinFilterType(E_TextureFilterType t) { m_minFilterType = t; }
@@ -239,8 +267,6 @@ void Sampler::beginSample(
         const Vector2& p2, const Vector2& uv2)
 {
     assert(m_tex != NULL);
-    
-    static char s_objCacheBuf[512];
 
     int filterMethodType = 0; // 1-point, 2-bilinear, 3-trilinear, 4-mipmapdbg
     const float *data0 = NULL, *data1 = NULL;
@@ -291,6 +317,7 @@ void Sampler::beginSample(
                     case ETFT_point: filterMethodType = 1; break;
                     case ETFT_bilinear: filterMethodType = 2; break;
                     case ETFT_trilinear:
+                    case ETFT_anisotropic: // زûأ
                         {
                             if (fequal(level, float(ilevel))) {
                                 filterMethodType = 2;
@@ -328,45 +355,45 @@ void Sampler::beginSample(
     if (filterMethodType == 1) {
         if (m_uAddressingMode == ETAM_clamp) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Clamp, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Clamp, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Clamp, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_repeat) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Repeat, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_mirror) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Mirror, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Mirror, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     PointFilterMethod<AddressingMethod_Mirror, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
@@ -375,45 +402,45 @@ void Sampler::beginSample(
     else if (filterMethodType == 2) {
         if (m_uAddressingMode == ETAM_clamp) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_repeat) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_mirror) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Clamp>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Repeat>(data0, w, h);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     BilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Mirror>(data0, w, h);
             }
             else assert(0);
@@ -422,45 +449,45 @@ void Sampler::beginSample(
     else if (filterMethodType == 3) {
         if (m_uAddressingMode == ETAM_clamp) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Clamp>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Repeat>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Clamp, AddressingMethod_Mirror>(data0, data1, w, h, weight0);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_repeat) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Clamp>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Repeat>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Repeat, AddressingMethod_Mirror>(data0, data1, w, h, weight0);
             }
             else assert(0);
         }
         else if (m_uAddressingMode == ETAM_mirror) {
             if (m_vAddressingMode == ETAM_clamp) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Clamp>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_repeat) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Repeat>(data0, data1, w, h, weight0);
             }
             else if (m_vAddressingMode == ETAM_mirror) {
-                m_filterMethod = new (s_objCacheBuf) 
+                m_filterMethod = new (&m_memBuf) 
                     TrilinearFilterMethod<AddressingMethod_Mirror, AddressingMethod_Mirror>(data0, data1, w, h, weight0);
             }
             else assert(0);
@@ -473,16 +500,94 @@ void Sampler::beginSample(
             Vector3(0, 0, 0.5f), Vector3(0, 0.5f, 0.5f), Vector3(0.5f, 0, 0.5f), Vector3(0.5f, 0.5f, 0), 
         };
         int idx = std::min(std::max((int)level, 0), arraySize(constColorTable) - 1);
-        m_filterMethod = new (s_objCacheBuf) ConstColorFilterMethod(constColorTable[idx]);
+        m_filterMethod = new (&m_memBuf) ConstColorFilterMethod(constColorTable[idx]);
     }
     else assert(0);
 
     assert(m_filterMethod != NULL);
+    // mipmapʱǷģһ͹
+    m_quadUVScale = filterMethodType == 4 ? 0 : float(m_tex->width(0)) / w;
 }
 Vector2 Sampler::textureSize() const
 {
     return m_filterMethod->textureSize();
 }
+Vector3 Sampler::sampleLod(const Vector2& uv, float lod) const
+{
+    assert(m_tex != NULL);
+    FixedSamplePlan plan;
+    planFixedSample(m_tex, m_minFilterType, m_maxFilterType, m_uAddressingMode, m_vAddressingMode, lod, plan);
+    return fixed2Color(sampleFixed(plan, uv.x, uv.y));
+}
+void Sampler::sampleQuad(const Vector2* uvs, Vector3* clrs, int mask) const
+{
+    // ˫ԲҪصLODbeginSampleѡõĸ˸
+    if (m_quadUVScale == 0 ||
+            (m_minFilterType != ETFT_trilinear && m_minFilterType != ETFT_anisotropic)) {
+        for (int i = 0; i < 4; ++i) {
+            if (mask & (1 << i)) clrs[i] = sample(uvs[i]);
+        }
+        return;
+    }
+
+    float scale = m_quadUVScale;
+    Vector2 ddx(uvs[1].x - uvs[0].x, uvs[1].y - uvs[0].y);
+    Vector2 ddy(uvs[2].x - uvs[0].x, uvs[2].y - uvs[0].y);
+    ddx *= scale, ddy *= scale;
+    float lenX2 = ddx.lengthSqr(), lenY2 = ddy.lengthSqr();
+    float major2 = std::max(lenX2, lenY2), minor2 = std::min(lenX2, lenY2);
+    const Vector2 &majorAxis = lenX2 > lenY2 ? ddx : ddy;
+
+    // ԣ֮ȡ2ΪسȾ
+    // ÿβǳ1/probeCntLOD
+    int probeCnt = 1, probeShift = 0;
+    if (m_minFilterType == ETFT_anisotropic) {
+        while (probeCnt < MAX_ANISOTROPY && minor2 * (probeCnt * 2) * (probeCnt * 2) <= major2) {
+            probeCnt *= 2, ++probeShift;
+        }
+    }
+    float lod = major2 > 0 ? 0.5f * fastLog2(major2) - probeShift : 0;
+    FixedSamplePlan plan;
+    planFixedSample(m_tex, m_minFilterType, m_maxFilterType, m_uAddressingMode, m_vAddressingMode, lod, plan);
+
+    if (plan.filter4 == NULL) {
+        for (int i = 0; i < 4; ++i) {
+            if (!(mask & (1 << i))) continue;
+            float u = uvs[i].x * scale, v = uvs[i].y * scale;
+            __m128i sum = _mm_setzero_si128();
+            for (int j = 0; j < probeCnt; ++j) {
+                float t = (j + 0.5f) / probeCnt - 0.5f;
+                sum = _mm_add_epi16(sum, sampleFixed(plan, u + majorAxis.x * t, v + majorAxis.y * t));
+            }
+            clrs[i] = fixed2Color(_mm_srli_epi16(sum, probeShift));
+        }
+        return;
+    }
+
+    // 4һɣmaskҲ㣬ʡ÷֧
+    __m128 scaleV = _mm_set1_ps(scale);
+    __m128 u = _mm_mul_ps(_mm_set_ps(uvs[3].x, uvs[2].x, uvs[1].x, uvs[0].x), scaleV);
+    __m128 v = _mm_mul_ps(_mm_set_ps(uvs[3].y, uvs[2].y, uvs[1].y, uvs[0].y), scaleV);
+    __m128i lo, hi;
+    if (probeCnt == 1) {
+        sampleFixed4(plan, u, v, lo, hi);
+    }
+    else {
+        lo = hi = _mm_setzero_si128();
+        for (int j = 0; j < probeCnt; ++j) {
+            __m128 t = _mm_set1_ps((j + 0.5f) / probeCnt - 0.5f);
+            __m128i probeLo, probeHi;
+            sampleFixed4(plan,
+                    _mm_add_ps(u, _mm_mul_ps(_mm_set1_ps(majorAxis.x), t)),
+                    _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(majorAxis.y), t)), probeLo, probeHi);
+            lo = _mm_add_epi16(lo, probeLo);
+            hi = _mm_add_epi16(hi, probeHi);
+        }
+        lo = _mm_srli_epi16(lo, probeShift);
+        hi = _mm_srli_epi16(hi, probeShift);
+    }
+    fixed2Color4(lo, hi, clrs);
+}
 void Sampler::endSample()
 {
     m_filterMethod->~ITextureFilterMethod();
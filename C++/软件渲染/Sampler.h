@@ -10,13 +10,17 @@ class Texture;
 
 struct ITextureFilterMethod
 {
-    virtual ~ITextureFilterMethod() = 0 {};
+    virtual ~ITextureFilterMethod() = 0;
     virtual Vector3 sample(const Vector2& uv) const = 0;
     virtual Vector2 textureSize() const = 0;
 };
+inline ITextureFilterMethod::~ITextureFilterMethod() {}
 
 class Sampler
 {
+public:
+    static const int MAX_ANISOTROPY = 4; // Թسɼ
+
 public:
     Sampler();
 
@@ -33,6 +37,12 @@ public:
             const Vector2& p2, const Vector2& vu2);
     Vector2 textureSize() const;
     Vector3 sample(const Vector2& uv) const;
+    // һβ2x2أuvs(x,y)(x+1,y)(x,y+1)(x+1,y+1)ţλsampleһ
+    // Ժ͸صLODڶswizzledLevelϹˣֻmaskأ
+    // 㡢˫Ժmipmapģʽ˻sample
+    void sampleQuad(const Vector2* uvs, Vector3* clrs, int mask) const;
+    // ҪbeginSampleuvǵ0꣬lodѡ
+    Vector3 sampleLod(const Vector2& uv, float lod) const;
     void endSample();
 
 private:
@@ -43,6 +53,14 @@ private:
     E_TextureAddressingMode m_vAddressingMode;
 
     ITextureFilterMethod *m_filterMethod;
+    float m_quadUVScale; // beginSampleѡļ껻ɵ0ģ0ʾsampleQuadҪ˻sample
+    // m_filterMethodĴ洢ÿSamplerһݣ̸߳øģԱֻΪ
+    union MemBuf
+    {
+        char data[64];
+        void *p;
+        double d;
+    } m_memBuf;
 };
 
 inline Vector3 Sampler::sample(const Vector2& uv) const
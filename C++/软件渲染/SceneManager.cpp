@@ -18,6 +18,7 @@
 #include "Entity.h"
 #include "Camera.h"
 #include "Light.h"
+#include "../RenderCommon/SimdMath.h"
 #include "Geometry.h"
 
 SceneManager::SceneManager(const std::string& fname):
@@ -244,17 +245,27 @@ std::vector<Entity*> SceneManager::clipEntityWithPortal(
 std::vector<Entity*> SceneManager::clipEntityWithFrustum(
         const std::vector<Entity*>& ents) const
 {
+    if (ents.empty()) return ents;
     PlaneList frustumPlanes = getCamera()->getVolumePlanes(EPID_all);
 
+    // ȰAABB任ͼռ䣬һƽͷ
+    std::vector<AABB> aabbs;
+    aabbs.reserve(ents.size());
+    for (int i = 0; i < (int)ents.size(); ++i) {
+        Matrix4x4 worldViewMat = ents[i]->getSceneNode()->getWorldMatrix() * getCamera()->getViewMatrix();
+        aabbs.push_back(ents[i]->getBoundAABB());
+        transform(aabbs.back(), worldViewMat);
+    }
+    std::vector<char> culled(ents.size());
+    frustumCullAABBs(&aabbs[0], (int)aabbs.size(),
+            &frustumPlanes.planes[0], (int)frustumPlanes.planes.size(), &culled[0]);
+
     std::vector<Entity*> rents;
     for (int i = 0; i < (int)ents.size(); ++i) {
         Entity* ent = ents[i];
+        if (culled[i]) continue;
         Matrix4x4 worldViewMat = ent->getSceneNode()->getWorldMatrix() * getCamera()->getViewMatrix();
 
-        AABB aabb = ent->getBoundAABB();
-        transform(aabb, worldViewMat);
-        if (intersect(frustumPlanes, aabb.getCorners()) == EIC_front) continue;
-
         Sphere sphere = ent->getBoundSphere();
         transform(sphere, worldViewMat);
         if (intersect(frustumPlanes, sphere) == EIC_front) continue;
@@ -2,6 +2,8 @@
 #include "pch.h"
 
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 
 #include "Texture.h"
 #include "Util.h"
@@ -71,6 +73,10 @@ void Texture::clear()
         free(m_bufs[i]);
     }
     m_bufs.clear();
+    for (int i = 0; i < (int)m_swizzledLevels.size(); ++i) {
+        free((void*)m_swizzledLevels[i].data);
+    }
+    m_swizzledLevels.clear();
     m_w = m_h = 0;
 }
 
@@ -97,6 +103,7 @@ bool Texture::load(const char *fname)
     m_bufs.push_back(p);
     m_w = w, m_h = h;
     if (m_w == m_h && isPower2(m_w)) genMipmap();
+    genSwizzled();
     return true;
 }
 bool Texture::save(const char *fname) const
@@ -128,6 +135,31 @@ void Texture::genMipmap()
     }
 }
 
+void Texture::genSwizzled()
+{
+    assert(m_swizzledLevels.empty());
+    for (int level = 0; level < (int)m_bufs.size(); ++level) {
+        int w = width(level), h = height(level);
+        int tileCntX = (w + 7) >> 3, tileCntY = (h + 7) >> 3;
+        unsigned int *buf = (unsigned int*)malloc(tileCntX * tileCntY * 64 * sizeof(unsigned int));
+        // 뵽8ıĲֲᱻֻΪȷ
+        memset(buf, 0, tileCntX * tileCntY * 64 * sizeof(unsigned int));
+        const float *src = m_bufs[level];
+        for (int v = 0; v < h; ++v) {
+            for (int u = 0; u < w; ++u) {
+                unsigned int texel = 0;
+                for (int i = 3; i >= 0; --i) {
+                    texel = (texel << 8) | (int)(src[i] * 255 + 0.5f);
+                }
+                buf[swizzledTexelIndex(u, v, tileCntX)] = texel;
+                src += 4;
+            }
+        }
+        SwizzledLevel swizzled = {buf, w, h, tileCntX};
+        m_swizzledLevels.push_back(swizzled);
+    }
+}
+
 int Texture::width(int level) const 
 { 
     assert(level >= 0 && level < (int)m_bufs.size());
@@ -1,5 +1,7 @@
 #include "pch.h"
 
+#ifdef _WIN32
+
 #include <cstring>
 
 #include <io.h>
@@ -129,3 +131,5 @@ bool saveImage(const char *fname, const char *buf, int w, int h, int pitch)
     if (GetEncoderClsid(L"image/png", &pngClsid) == -1) return false;
     return bm.Save(getNotExistFileName(fname).c_str(), &pngClsid, NULL) == Ok;
 }
+
+#endif // #ifdef _WIN32
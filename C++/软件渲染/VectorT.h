@@ -5,6 +5,15 @@
 
 #include <cassert>
 
+template<typename T> 
+inline T zero() { return T::ZERO; }
+template<>
+inline char zero() { return 0; }
+template<>
+inline int zero() { return 0; }
+template<>
+inline float zero() { return 0.f; }
+
 template<typename T0, typename T1>
 struct Vector2T
 {
@@ -123,13 +132,4 @@ Vector3T<T0, T1, T2> operator / (const Vector3T<T0, T1, T2>& a, const T& val)
     return Vector3T<T0, T1, T2>(a) /= val;
 }
 
-template<typename T> 
-inline T zero() { return T::ZERO; }
-template<>
-inline char zero() { return 0; }
-template<>
-inline int zero() { return 0; }
-template<>
-inline float zero() { return 0.f; }
-
 #endif // #ifndef VECTORT_H